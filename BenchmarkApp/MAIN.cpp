@@ -0,0 +1,183 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: MAIN.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpucache_benchmark.h"
+#include "gpucache_benchmarkGeometry.h"
+#include "gpucache_benchmarkTextures.h"
+#include "gpucache_benchmarkRender.h"
+
+/*
+	Headless host of the cache benchmarks and tests, no window and no gl context is created
+
+	BenchmarkApp [options] [cache.xml]
+		-models N		number of synthetic models (default 1000)
+		-vertices N		vertices per model (default 4096)
+		-textures N		number of textures (default 16)
+		-size N			texture size (default 256)
+		-iterations N	load iterations (default 5)
+		-pipelined		use the pipelined loader
+		-picking N		cast N rays instead of the save / load benchmark
+		-test [name]	run the tests (all or the one with the name), exit code is the number of failed tests
+*/
+
+#define DEFAULT_CACHE_FILENAME		"benchmark_cache.xml"
+
+//////////////////////////////////////////////////////////////////////////
+// tests
+
+struct BenchmarkTest
+{
+	const char		*name;
+	bool			(*func)();
+};
+
+static const BenchmarkTest gTests[] = {
+	{ "loaders_checksum", TestLoadersChecksum },
+	{ "ray_picking", TestRayPicking },
+	{ "pack_access", TestPackAccess },
+	{ "pipelined_models_begin", TestPipelinedModelsBegin },
+	{ "manifest", TestManifest },
+	{ "quantization", TestQuantization },
+	{ "index_optimization", TestIndexOptimization },
+	{ "vertex_merge", TestVertexMerge },
+	{ "instances", TestInstances },
+	{ "texture_export", TestTextureExport },
+	{ "texture_compression", TestTextureCompression },
+	{ "mipmap_filters", TestMipmapFilters },
+	{ "sequence_stream", TestSequenceStream },
+	{ "sequence_delta", TestSequenceDelta },
+	{ "clusters", TestClusters },
+	{ "lods", TestLods },
+	{ "partial_load", TestPartialLoad },
+	{ "textures_sharing", TestTexturesSharing },
+	{ "frustum_culling", TestFrustumCulling },
+	{ "hierarchy", TestHierarchy },
+	{ "normal_matrices", TestNormalMatrices },
+	{ "dirty_ranges", TestDirtyRanges },
+	{ "ring_buffer", TestRingBuffer },
+	{ "tlsf", TestTLSF },
+	{ "geometry_batch", TestGeometryBatch }
+};
+
+static int RunTests(const char *name)
+{
+	int numberOfFailed = 0;
+	int numberOfRun = 0;
+	const int numberOfTests = (int) (sizeof(gTests) / sizeof(BenchmarkTest));
+
+	for (int i=0; i<numberOfTests; ++i)
+	{
+		if (name != nullptr && 0 != strcmp(name, gTests[i].name) )
+			continue;
+
+		printf( "[ RUN  ] %s\n", gTests[i].name );
+		const bool result = gTests[i].func();
+		printf( "[ %s ] %s\n", (result) ? " OK " : "FAIL", gTests[i].name );
+
+		if (false == result)
+			numberOfFailed += 1;
+		numberOfRun += 1;
+	}
+
+	if (numberOfRun == 0)
+	{
+		printf( "> ERROR: unknown test %s\n", name );
+		return 1;
+	}
+
+	return numberOfFailed;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// main
+
+int main(int argc, char **argv)
+{
+	const char *filename = DEFAULT_CACHE_FILENAME;
+	int numberOfModels = 1000;
+	int numberOfVertices = 4096;
+	int numberOfTextures = 16;
+	int textureSize = 256;
+	int numberOfIterations = 5;
+	int numberOfRays = 0;
+	bool pipelined = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		const bool hasValue = (i+1 < argc);
+
+		if (0 == strcmp(argv[i], "-test") )
+		{
+			const char *name = (hasValue) ? argv[i+1] : nullptr;
+			return RunTests(name);
+		}
+		else if (0 == strcmp(argv[i], "-pipelined") )
+			pipelined = true;
+		else if (0 == strcmp(argv[i], "-models") && hasValue)
+			numberOfModels = atoi(argv[++i]);
+		else if (0 == strcmp(argv[i], "-vertices") && hasValue)
+			numberOfVertices = atoi(argv[++i]);
+		else if (0 == strcmp(argv[i], "-textures") && hasValue)
+			numberOfTextures = atoi(argv[++i]);
+		else if (0 == strcmp(argv[i], "-size") && hasValue)
+			textureSize = atoi(argv[++i]);
+		else if (0 == strcmp(argv[i], "-iterations") && hasValue)
+			numberOfIterations = atoi(argv[++i]);
+		else if (0 == strcmp(argv[i], "-picking") && hasValue)
+			numberOfRays = atoi(argv[++i]);
+		else if (argv[i][0] != '-')
+			filename = argv[i];
+		else
+		{
+			printf( "> ERROR: unknown option %s\n", argv[i] );
+			return 1;
+		}
+	}
+
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(numberOfModels, numberOfVertices, 16, numberOfTextures, textureSize, options);
+
+	if (numberOfRays > 0)
+	{
+		GPUCachePickingReport report;
+		GPUCachePickingReport::Clear(report);
+
+		if (false == BenchmarkRayPicking( options, numberOfRays, 0, report ) )
+			return 1;
+
+		PrintPickingReport(report);
+		return 0;
+	}
+
+	CGPUCacheSaver saver;
+	GPUCacheBenchmarkReport report;
+	GPUCacheBenchmarkReport::Clear(report);
+
+	if (false == GenerateSyntheticCache( filename, options, saver, &report ) )
+	{
+		printf( "> ERROR: failed to write %s\n", filename );
+		return 1;
+	}
+
+	if (false == BenchmarkCacheLoad( filename, numberOfIterations, pipelined, nullptr, report ) )
+	{
+		printf( "> ERROR: failed to load %s\n", filename );
+		return 1;
+	}
+
+	PrintBenchmarkReport(report);
+	return 0;
+}
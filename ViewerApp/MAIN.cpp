@@ -28,6 +28,7 @@
 #include "gpucache_model.h"
 #include "gpucache_loader.h"
 #include "shared_lights.h"
+#include "graphics\RingBuffer.h"
 
 /*
 	TODO:
@@ -135,6 +136,9 @@ void draw(float time)
 	mCameraCache.pos = m_cameraPos.vec_array;
 
 	mLightManager.Prep( mCameraCache, nullptr );
+	// lights and clusters go into the ring every frame
+	mLightManager.MapOnGPU();
+	mLightManager.PrepGPUPtr();
 
 	if (mCacheModel && mShaderFX)
 	{
@@ -323,6 +327,9 @@ int main(int argc, char** argv)
         exit(EXIT_FAILURE);
     }
 
+	// per frame buffers, they use own buffers when persistent mapping is not supported
+	CGPURingBuffer::GetInstance().Init();
+
 #ifdef _DEBUG
 	glEnable(GL_DEBUG_OUTPUT);
 	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
@@ -349,6 +356,7 @@ int main(int argc, char** argv)
 	{
 		printf( "[ERROR] Failed to load a shader ! \n" );
 
+		CGPURingBuffer::GetInstance().Free();
         glfwTerminate();
         exit(EXIT_FAILURE);
 	}
@@ -368,10 +376,15 @@ int main(int argc, char** argv)
 
         draw(time);
 
+		// fence of the frame, ring space is reused when the gpu is done with it
+		CGPURingBuffer::GetInstance().EndFrame();
+
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+	// waits for the frames in flight, the context is still alive
+	CGPURingBuffer::GetInstance().Free();
     glfwTerminate();
     exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,100 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: FileIO.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+//////////////////////////////////////////////////////////////////////////
+// low level file calls of the cache writers and the benchmark
+//	on Win32 these are the CRT calls (io.h), other platforms get the same names on top of POSIX,
+//	so the saver keeps one code path and could be run from a headless tool
+
+#ifdef _WIN32
+
+#include <io.h>
+#include <share.h>
+
+#else
+
+#include <unistd.h>
+#include <errno.h>
+
+typedef int errno_t;
+
+#define _O_BINARY			0
+#define _O_RDONLY			O_RDONLY
+#define _O_WRONLY			O_WRONLY
+#define _O_RDWR				O_RDWR
+#define _O_CREAT			O_CREAT
+#define _O_TRUNC			O_TRUNC
+
+#define _SH_DENYRW			0			// no share modes, the file is locked by nobody
+#define _SH_DENYWR			0
+#define _SH_DENYNO			0
+
+#define _S_IREAD			S_IRUSR
+#define _S_IWRITE			S_IWUSR
+
+#define sprintf_s			snprintf
+
+inline errno_t _sopen_s(int *fh, const char *filename, const int oflag, const int shflag, const int pmode)
+{
+	*fh = open(filename, oflag, pmode);
+	return (*fh < 0) ? errno : 0;
+}
+
+inline int _close(const int fh)
+{
+	return close(fh);
+}
+
+inline int _write(const int fh, const void *buffer, const unsigned int count)
+{
+	return (int) write(fh, buffer, count);
+}
+
+inline int _read(const int fh, void *buffer, const unsigned int count)
+{
+	return (int) read(fh, buffer, count);
+}
+
+inline long long _lseeki64(const int fh, const long long offset, const int origin)
+{
+	return (long long) lseek(fh, (off_t) offset, origin);
+}
+
+inline long long _telli64(const int fh)
+{
+	return (long long) lseek(fh, 0, SEEK_CUR);
+}
+
+inline errno_t fopen_s(FILE **fp, const char *filename, const char *mode)
+{
+	*fp = fopen(filename, mode);
+	return (*fp == nullptr) ? errno : 0;
+}
+
+inline int _fseeki64(FILE *fp, const long long offset, const int origin)
+{
+	return fseeko(fp, (off_t) offset, origin);
+}
+
+inline long long _ftelli64(FILE *fp)
+{
+	return (long long) ftello(fp);
+}
+
+#endif
@@ -0,0 +1,237 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: FileMapping.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FileMapping.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// CFileMapping
+
+CFileMapping::CFileMapping()
+{
+	mData = nullptr;
+	mSize = 0;
+	mIsMapped = false;
+
+#ifdef _WIN32
+	mFileHandle = INVALID_HANDLE_VALUE;
+	mMappingHandle = nullptr;
+#else
+	mFileHandle = -1;
+#endif
+}
+
+CFileMapping::~CFileMapping()
+{
+	Close();
+}
+
+bool CFileMapping::Open(const char *filename, const bool useMapping)
+{
+	Close();
+
+	if (filename == nullptr)
+		return false;
+
+	if (useMapping && OpenMapping(filename) )
+		return true;
+
+	// could be a network share or a file system without mapping support
+	return OpenLocalCopy(filename);
+}
+
+#ifdef _WIN32
+
+bool CFileMapping::OpenMapping(const char *filename)
+{
+	mFileHandle = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+
+	if (mFileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (FALSE == GetFileSizeEx( mFileHandle, &fileSize ) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mMappingHandle = CreateFileMappingA( mFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if (mMappingHandle == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mData = (const unsigned char*) MapViewOfFile( mMappingHandle, FILE_MAP_READ, 0, 0, 0 );
+	if (mData == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mSize = (size_t) fileSize.QuadPart;
+	mIsMapped = true;
+
+	return true;
+}
+
+void CFileMapping::Close()
+{
+	if (mIsMapped && mData != nullptr)
+		UnmapViewOfFile( mData );
+
+	if (mMappingHandle != nullptr)
+	{
+		CloseHandle( mMappingHandle );
+		mMappingHandle = nullptr;
+	}
+	if (mFileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle( mFileHandle );
+		mFileHandle = INVALID_HANDLE_VALUE;
+	}
+
+	mLocalCopy.clear();
+	mLocalCopy.shrink_to_fit();
+
+	mData = nullptr;
+	mSize = 0;
+	mIsMapped = false;
+}
+
+void CFileMapping::Prefetch(const size_t offset, const size_t size) const
+{
+	// PrefetchVirtualMemory is not available on all supported systems,
+	//  sequential scan flag on the file handle does the read-ahead for us
+}
+
+#else
+
+bool CFileMapping::OpenMapping(const char *filename)
+{
+	mFileHandle = open( filename, O_RDONLY );
+	if (mFileHandle < 0)
+		return false;
+
+	struct stat st;
+	if (fstat( mFileHandle, &st ) != 0 || st.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	void *ptr = mmap( nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, mFileHandle, 0 );
+	if (ptr == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	mData = (const unsigned char*) ptr;
+	mSize = (size_t) st.st_size;
+	mIsMapped = true;
+
+	madvise( ptr, mSize, MADV_SEQUENTIAL );
+
+	return true;
+}
+
+void CFileMapping::Close()
+{
+	if (mIsMapped && mData != nullptr)
+		munmap( (void*) mData, mSize );
+
+	if (mFileHandle >= 0)
+	{
+		close( mFileHandle );
+		mFileHandle = -1;
+	}
+
+	mLocalCopy.clear();
+	mLocalCopy.shrink_to_fit();
+
+	mData = nullptr;
+	mSize = 0;
+	mIsMapped = false;
+}
+
+void CFileMapping::Prefetch(const size_t offset, const size_t size) const
+{
+	if (false == mIsMapped || offset >= mSize)
+		return;
+
+	// madvise wants a page aligned start
+	const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+	const size_t alignedOffset = offset - (offset % pageSize);
+	size_t len = size + (offset - alignedOffset);
+	if (alignedOffset + len > mSize)
+		len = mSize - alignedOffset;
+
+	madvise( (void*) (mData + alignedOffset), len, MADV_WILLNEED );
+}
+
+#endif
+
+bool CFileMapping::OpenLocalCopy(const char *filename)
+{
+	FILE *fp = fopen( filename, "rb" );
+	if (fp == nullptr)
+		return false;
+
+	bool result = false;
+
+	if (0 == fseek(fp, 0, SEEK_END) )
+	{
+		const long long fileLen =
+#ifdef _WIN32
+			_ftelli64(fp);
+#else
+			ftello(fp);
+#endif
+		if (fileLen > 0)
+		{
+			fseek(fp, 0, SEEK_SET);
+			mLocalCopy.resize( (size_t) fileLen );
+
+			if ( (size_t) fileLen == fread( mLocalCopy.data(), sizeof(unsigned char), (size_t) fileLen, fp ) )
+			{
+				mData = mLocalCopy.data();
+				mSize = mLocalCopy.size();
+				result = true;
+			}
+			else
+			{
+				mLocalCopy.clear();
+			}
+		}
+	}
+
+	fclose(fp);
+
+	if (false == result)
+		printf( "failed to read file - %s\n", filename );
+
+	return result;
+}
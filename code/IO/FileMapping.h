@@ -0,0 +1,79 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: FileMapping.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// read-only view of a whole file
+//	uses a memory mapping (Win32 or POSIX), so pointers go straight into the page cache
+//	if a mapping can't be created, the file is read into a local heap buffer instead
+
+class CFileMapping
+{
+public:
+
+	//! a constructor
+	CFileMapping();
+
+	//! a destructor
+	~CFileMapping();
+
+	// useMapping - false to read the file into the heap buffer anyway (compare with the mapped view)
+	bool	Open(const char *filename, const bool useMapping=true);
+	void	Close();
+
+	const unsigned char *GetData() const
+	{
+		return mData;
+	}
+
+	const size_t GetSize() const
+	{
+		return mSize;
+	}
+
+	// true when data points into a mapped view, false for the heap fallback
+	const bool IsMapped() const
+	{
+		return mIsMapped;
+	}
+
+	// hint to the OS that the range is going to be read soon (ignored for the heap fallback)
+	void	Prefetch(const size_t offset, const size_t size) const;
+
+protected:
+
+	const unsigned char			*mData;
+	size_t						mSize;
+	bool						mIsMapped;
+
+#ifdef _WIN32
+	void						*mFileHandle;
+	void						*mMappingHandle;
+#else
+	int							mFileHandle;
+#endif
+
+	std::vector<unsigned char>	mLocalCopy;
+
+	bool	OpenMapping(const char *filename);
+	bool	OpenLocalCopy(const char *filename);
+
+private:
+
+	// non-copyable, the view is owned by one object
+	CFileMapping(const CFileMapping &);
+	CFileMapping &operator=(const CFileMapping &);
+};
@@ -0,0 +1,96 @@
+
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "BlockDelta.h"
+#include <string.h>
+#include <stdint.h>
+
+static inline bool IsBlockEqual(const unsigned char *a, const unsigned char *b, const int blockSize)
+{
+	// 8 bytes words, blocks are not aligned in the frame records
+	uint64_t wa, wb;
+
+	for (int i=0; i<blockSize; i+=8)
+	{
+		memcpy( &wa, a + i, 8 );
+		memcpy( &wb, b + i, 8 );
+
+		if (wa != wb)
+			return false;
+	}
+	return true;
+}
+
+int FindChangedBlocks(const unsigned char *prev, const unsigned char *curr, const int blockSize, const int blocksPerRow,
+	const int numberOfRows, const int maxGap, std::vector<BlockDeltaRun> &runs)
+{
+	runs.clear();
+	int numberOfBlocks = 0;
+
+	const size_t pitch = (size_t) blockSize * blocksPerRow;
+
+	for (int row=0; row<numberOfRows; ++row)
+	{
+		const unsigned char *prevRow = prev + row * pitch;
+		const unsigned char *currRow = curr + row * pitch;
+
+		int runStart = -1;
+		int lastChanged = -1;
+
+		for (int column=0; column<blocksPerRow; ++column)
+		{
+			if (IsBlockEqual( prevRow + column * blockSize, currRow + column * blockSize, blockSize ) )
+				continue;
+
+			if (runStart >= 0 && column - lastChanged - 1 > maxGap)
+			{
+				BlockDeltaRun run = { row * blocksPerRow + runStart, lastChanged - runStart + 1 };
+				runs.push_back(run);
+				numberOfBlocks += run.count;
+
+				runStart = -1;
+			}
+
+			if (runStart < 0)
+				runStart = column;
+			lastChanged = column;
+		}
+
+		if (runStart >= 0)
+		{
+			BlockDeltaRun run = { row * blocksPerRow + runStart, lastChanged - runStart + 1 };
+			runs.push_back(run);
+			numberOfBlocks += run.count;
+		}
+	}
+
+	return numberOfBlocks;
+}
+
+void GatherRunBlocks(const unsigned char *image, const BlockDeltaRun *runs, const int numberOfRuns, const int blockSize, unsigned char *dst)
+{
+	for (int i=0; i<numberOfRuns; ++i)
+	{
+		const size_t size = (size_t) runs[i].count * blockSize;
+
+		memcpy( dst, image + (size_t) runs[i].firstBlock * blockSize, size );
+		dst += size;
+	}
+}
+
+void ApplyRunBlocks(const BlockDeltaRun *runs, const int numberOfRuns, const unsigned char *blocks, const int blockSize, unsigned char *image)
+{
+	for (int i=0; i<numberOfRuns; ++i)
+	{
+		const size_t size = (size_t) runs[i].count * blockSize;
+
+		memcpy( image + (size_t) runs[i].firstBlock * blockSize, blocks, size );
+		blocks += size;
+	}
+}
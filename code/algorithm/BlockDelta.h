@@ -0,0 +1,34 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include <vector>
+
+//
+// block level difference of two compressed images (BC / DXT blocks of 8 or 16 bytes)
+//	changed blocks are grouped into runs, a run never crosses a row of blocks,
+//	so every run is a rectangle which could be uploaded with glCompressedTexSubImage2D
+//
+
+struct BlockDeltaRun
+{
+	int		firstBlock;		// index of the block in the image (row * blocksPerRow + column)
+	int		count;
+};
+
+// compare two images of the same size, returns number of blocks in the runs
+//	blockSize is 8 or 16 bytes, it comes from the image format of the caller
+//	runs which are separated by maxGap or less unchanged blocks are merged
+int FindChangedBlocks(const unsigned char *prev, const unsigned char *curr, const int blockSize, const int blocksPerRow,
+	const int numberOfRows, const int maxGap, std::vector<BlockDeltaRun> &runs);
+
+// copy blocks of the runs from the image into dst one by one
+void GatherRunBlocks(const unsigned char *image, const BlockDeltaRun *runs, const int numberOfRuns, const int blockSize, unsigned char *dst);
+
+// patch the image with the blocks of the runs
+void ApplyRunBlocks(const BlockDeltaRun *runs, const int numberOfRuns, const unsigned char *blocks, const int blockSize, unsigned char *image);
@@ -0,0 +1,699 @@
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "BoundingVolumeHierarchy.h"
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static float BoxArea(const float *bmin, const float *bmax)
+{
+	const float dx = bmax[0] - bmin[0];
+	const float dy = bmax[1] - bmin[1];
+	const float dz = bmax[2] - bmin[2];
+
+	return 2.0f * (dx*dy + dy*dz + dz*dx);
+}
+
+static void BoxEmpty(float *bmin, float *bmax)
+{
+	bmin[0] = bmin[1] = bmin[2] = FLT_MAX;
+	bmax[0] = bmax[1] = bmax[2] = -FLT_MAX;
+}
+
+static void BoxAddSphere(float *bmin, float *bmax, const vec4 &sphere)
+{
+	bmin[0] = std::min(bmin[0], sphere.x - sphere.w);
+	bmin[1] = std::min(bmin[1], sphere.y - sphere.w);
+	bmin[2] = std::min(bmin[2], sphere.z - sphere.w);
+	bmax[0] = std::max(bmax[0], sphere.x + sphere.w);
+	bmax[1] = std::max(bmax[1], sphere.y + sphere.w);
+	bmax[2] = std::max(bmax[2], sphere.z + sphere.w);
+}
+
+static void BoxAddBox(float *bmin, float *bmax, const float *otherMin, const float *otherMax)
+{
+	for (int k=0; k<3; ++k)
+	{
+		bmin[k] = std::min(bmin[k], otherMin[k]);
+		bmax[k] = std::max(bmax[k], otherMax[k]);
+	}
+}
+
+// squared distance from the point to the box, 0 for the point inside
+static float BoxDistanceSq(const float *bmin, const float *bmax, const float x, const float y, const float z)
+{
+	const float dx = std::max( 0.0f, std::max(bmin[0] - x, x - bmax[0]) );
+	const float dy = std::max( 0.0f, std::max(bmin[1] - y, y - bmax[1]) );
+	const float dz = std::max( 0.0f, std::max(bmin[2] - z, z - bmax[2]) );
+
+	return dx*dx + dy*dy + dz*dz;
+}
+
+// entry distance of the ray into the box, returns false for no hit in the range [0, maxDistance]
+static bool RayBox(const float *bmin, const float *bmax, const float *origin, const float *invDir, const float maxDistance, float &tEnter)
+{
+	float tmin = 0.0f;
+	float tmax = maxDistance;
+
+	for (int k=0; k<3; ++k)
+	{
+		float t1 = (bmin[k] - origin[k]) * invDir[k];
+		float t2 = (bmax[k] - origin[k]) * invDir[k];
+
+		if (t1 > t2)
+			std::swap(t1, t2);
+
+		// nan (origin on the slab of a parallel ray) doesn't reject the box
+		tmin = (t1 > tmin) ? t1 : tmin;
+		tmax = (t2 < tmax) ? t2 : tmax;
+
+		if (tmin > tmax)
+			return false;
+	}
+
+	tEnter = tmin;
+	return true;
+}
+
+// distance to the sphere surface, 0 for the origin inside
+static bool RaySphere(const vec4 &sphere, const vec3 &origin, const vec3 &dir, const float maxDistance, float &distance)
+{
+	const float ox = origin.x - sphere.x;
+	const float oy = origin.y - sphere.y;
+	const float oz = origin.z - sphere.z;
+
+	const float c = ox*ox + oy*oy + oz*oz - sphere.w * sphere.w;
+	if (c <= 0.0f)
+	{
+		distance = 0.0f;
+		return true;
+	}
+
+	const float b = ox*dir.x + oy*dir.y + oz*dir.z;
+	const float disc = b*b - c;
+
+	// sphere is behind or missed
+	if (b > 0.0f || disc < 0.0f)
+		return false;
+
+	distance = -b - sqrtf(disc);
+	return (distance <= maxDistance);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CBoundingVolumeHierarchy::CBoundingVolumeHierarchy()
+{
+	mBuildCost = 0.0f;
+}
+
+void CBoundingVolumeHierarchy::Clear()
+{
+	mSpheres.clear();
+	mNodes.clear();
+	mItems.clear();
+	mParents.clear();
+	mItemLeaf.clear();
+	mDirtyLeaves.clear();
+	mLeafDirty.clear();
+	mBuildCost = 0.0f;
+}
+
+void CBoundingVolumeHierarchy::Build(const vec4 *spheres, const int count)
+{
+	Clear();
+
+	if (count <= 0)
+		return;
+
+	mSpheres.assign(spheres, spheres + count);
+
+	mItems.resize(count);
+	for (int i=0; i<count; ++i)
+		mItems[i] = i;
+
+	mItemLeaf.resize(count, 0);
+
+	// binary tree with leaves of one item at least
+	mNodes.reserve( 2 * count );
+	mParents.reserve( 2 * count );
+
+	BVHNode root;
+	memset( &root, 0, sizeof(BVHNode) );
+	mNodes.push_back(root);
+	mParents.push_back(-1);
+
+	BuildNode( 0, 0, count );
+
+	mLeafDirty.resize( mNodes.size(), false );
+	mBuildCost = ComputeCost();
+}
+
+void CBoundingVolumeHierarchy::ComputeLeafBounds(BVHNode &node) const
+{
+	BoxEmpty(node.bmin, node.bmax);
+
+	for (int i=node.first; i<node.first+node.count; ++i)
+		BoxAddSphere(node.bmin, node.bmax, mSpheres[mItems[i]]);
+}
+
+void CBoundingVolumeHierarchy::BuildNode(const int nodeIndex, const int first, const int count)
+{
+	float bmin[3], bmax[3];
+	float cmin[3], cmax[3];
+
+	BoxEmpty(bmin, bmax);
+	BoxEmpty(cmin, cmax);
+
+	for (int i=first; i<first+count; ++i)
+	{
+		const vec4 &sphere = mSpheres[mItems[i]];
+		BoxAddSphere(bmin, bmax, sphere);
+		BoxAddSphere(cmin, cmax, vec4(sphere.x, sphere.y, sphere.z, 0.0f) );
+	}
+
+	{
+		BVHNode &node = mNodes[nodeIndex];
+		memcpy( node.bmin, bmin, sizeof(float) * 3 );
+		memcpy( node.bmax, bmax, sizeof(float) * 3 );
+	}
+
+	if (count <= BVH_MAX_LEAF_ITEMS)
+	{
+		BVHNode &node = mNodes[nodeIndex];
+		node.first = first;
+		node.count = count;
+
+		for (int i=first; i<first+count; ++i)
+			mItemLeaf[mItems[i]] = nodeIndex;
+		return;
+	}
+
+	// split along the longest axis of the centroids
+	int axis = 0;
+	for (int k=1; k<3; ++k)
+		if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis])
+			axis = k;
+
+	const float extent = cmax[axis] - cmin[axis];
+	int middle = first + count / 2;
+
+	if (extent > 0.0f)
+	{
+		int		binCount[BVH_NUMBER_OF_BINS];
+		float	binMin[BVH_NUMBER_OF_BINS][3];
+		float	binMax[BVH_NUMBER_OF_BINS][3];
+
+		for (int b=0; b<BVH_NUMBER_OF_BINS; ++b)
+		{
+			binCount[b] = 0;
+			BoxEmpty(binMin[b], binMax[b]);
+		}
+
+		const float binScale = (float) BVH_NUMBER_OF_BINS / extent;
+
+		for (int i=first; i<first+count; ++i)
+		{
+			const vec4 &sphere = mSpheres[mItems[i]];
+			const int b = std::min( BVH_NUMBER_OF_BINS - 1, (int) ((sphere.vec_array[axis] - cmin[axis]) * binScale) );
+
+			binCount[b] += 1;
+			BoxAddSphere(binMin[b], binMax[b], sphere);
+		}
+
+		// sweep from the right side, then choose the plane with the lowest area * count sum
+		float	rightCost[BVH_NUMBER_OF_BINS];
+		float	accMin[3], accMax[3];
+		int		accCount = 0;
+
+		BoxEmpty(accMin, accMax);
+		for (int b=BVH_NUMBER_OF_BINS-1; b>0; --b)
+		{
+			accCount += binCount[b];
+			if (binCount[b] > 0)
+				BoxAddBox(accMin, accMax, binMin[b], binMax[b]);
+
+			rightCost[b] = (accCount > 0) ? BoxArea(accMin, accMax) * (float) accCount : 0.0f;
+		}
+
+		float bestCost = FLT_MAX;
+		int bestPlane = -1;
+
+		BoxEmpty(accMin, accMax);
+		accCount = 0;
+
+		for (int b=0; b<BVH_NUMBER_OF_BINS-1; ++b)
+		{
+			accCount += binCount[b];
+			if (binCount[b] > 0)
+				BoxAddBox(accMin, accMax, binMin[b], binMax[b]);
+
+			if (accCount == 0 || accCount == count)
+				continue;
+
+			const float cost = BoxArea(accMin, accMax) * (float) accCount + rightCost[b+1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestPlane = b;
+			}
+		}
+
+		if (bestPlane >= 0)
+		{
+			int *itemsBegin = mItems.data() + first;
+			int *itemsEnd = itemsBegin + count;
+			const float minValue = cmin[axis];
+			const std::vector<vec4> &spheres = mSpheres;
+
+			int *split = std::partition( itemsBegin, itemsEnd, [&spheres, axis, minValue, binScale, bestPlane](const int item) {
+				const int b = std::min( BVH_NUMBER_OF_BINS - 1, (int) ((spheres[item].vec_array[axis] - minValue) * binScale) );
+				return (b <= bestPlane);
+			} );
+
+			middle = first + (int) (split - itemsBegin);
+		}
+	}
+
+	// all centroids in one point or one bin, split in half
+	if (middle == first || middle == first + count)
+		middle = first + count / 2;
+
+	const int left = (int) mNodes.size();
+
+	BVHNode child;
+	memset( &child, 0, sizeof(BVHNode) );
+	mNodes.push_back(child);
+	mNodes.push_back(child);
+	mParents.push_back(nodeIndex);
+	mParents.push_back(nodeIndex);
+
+	mNodes[nodeIndex].first = left;
+	mNodes[nodeIndex].count = 0;
+
+	BuildNode( left, first, middle - first );
+	BuildNode( left + 1, middle, first + count - middle );
+}
+
+void CBoundingVolumeHierarchy::UpdateItem(const int index, const vec4 &sphere)
+{
+	mSpheres[index] = sphere;
+
+	const int leaf = mItemLeaf[index];
+	if (false == mLeafDirty[leaf])
+	{
+		mLeafDirty[leaf] = true;
+		mDirtyLeaves.push_back(leaf);
+	}
+}
+
+int CBoundingVolumeHierarchy::Refit()
+{
+	int numberOfUpdated = 0;
+
+	// most of the leaves are moved, one pass from the bottom is cheaper than the walks up (children go after the parent)
+	if (mDirtyLeaves.size() * 8 > mNodes.size() )
+	{
+		for (int i=(int) mNodes.size()-1; i>=0; --i)
+		{
+			BVHNode &node = mNodes[i];
+
+			if (node.count > 0)
+			{
+				ComputeLeafBounds(node);
+			}
+			else
+			{
+				memcpy( node.bmin, mNodes[node.first].bmin, sizeof(float) * 3 );
+				memcpy( node.bmax, mNodes[node.first].bmax, sizeof(float) * 3 );
+				BoxAddBox( node.bmin, node.bmax, mNodes[node.first + 1].bmin, mNodes[node.first + 1].bmax );
+			}
+		}
+
+		for (auto iter=begin(mDirtyLeaves); iter!=end(mDirtyLeaves); ++iter)
+			mLeafDirty[*iter] = false;
+
+		mDirtyLeaves.clear();
+		return (int) mNodes.size();
+	}
+
+	for (auto iter=begin(mDirtyLeaves); iter!=end(mDirtyLeaves); ++iter)
+	{
+		const int leaf = *iter;
+		mLeafDirty[leaf] = false;
+
+		ComputeLeafBounds( mNodes[leaf] );
+		numberOfUpdated += 1;
+
+		// go up while the boxes are changed
+		int nodeIndex = mParents[leaf];
+		while (nodeIndex >= 0)
+		{
+			BVHNode &node = mNodes[nodeIndex];
+			const BVHNode &left = mNodes[node.first];
+			const BVHNode &right = mNodes[node.first + 1];
+
+			float bmin[3], bmax[3];
+			memcpy( bmin, left.bmin, sizeof(float) * 3 );
+			memcpy( bmax, left.bmax, sizeof(float) * 3 );
+			BoxAddBox( bmin, bmax, right.bmin, right.bmax );
+
+			if (0 == memcmp(bmin, node.bmin, sizeof(float) * 3) && 0 == memcmp(bmax, node.bmax, sizeof(float) * 3) )
+				break;
+
+			memcpy( node.bmin, bmin, sizeof(float) * 3 );
+			memcpy( node.bmax, bmax, sizeof(float) * 3 );
+			numberOfUpdated += 1;
+
+			nodeIndex = mParents[nodeIndex];
+		}
+	}
+
+	mDirtyLeaves.clear();
+	return numberOfUpdated;
+}
+
+float CBoundingVolumeHierarchy::ComputeCost() const
+{
+	if (mNodes.size() == 0)
+		return 0.0f;
+
+	const float rootArea = BoxArea(mNodes[0].bmin, mNodes[0].bmax);
+	if (rootArea <= 0.0f)
+		return 0.0f;
+
+	// traversal step of the internal node, sphere test for every leaf item
+	double cost = 0.0;
+	for (auto iter=begin(mNodes); iter!=end(mNodes); ++iter)
+	{
+		const double area = (double) BoxArea(iter->bmin, iter->bmax);
+		cost += area * (double) ((iter->count > 0) ? iter->count : 1);
+	}
+
+	return (float) (cost / (double) rootArea);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// queries
+
+int CBoundingVolumeHierarchy::QueryFrustum(const CFrustum &frustum, std::vector<int> &items) const
+{
+	if (mNodes.size() == 0)
+		return 0;
+
+	const size_t numberOfItems = items.size();
+
+	float planes[6][4];
+	for (int j=0; j<6; ++j)
+		memcpy( planes[j], frustum.GetFrustumPlane(j), sizeof(float) * 4 );
+
+	// node index and bits of the planes which still cross the node
+	std::vector<std::pair<int, int>>	stack;
+	stack.reserve(64);
+	stack.push_back( std::make_pair(0, 63) );
+
+	while (stack.size() > 0)
+	{
+		const int nodeIndex = stack.back().first;
+		int mask = stack.back().second;
+		stack.pop_back();
+
+		const BVHNode &node = mNodes[nodeIndex];
+
+		if (mask != 0)
+		{
+			const float cx = 0.5f * (node.bmin[0] + node.bmax[0]);
+			const float cy = 0.5f * (node.bmin[1] + node.bmax[1]);
+			const float cz = 0.5f * (node.bmin[2] + node.bmax[2]);
+			const float ex = 0.5f * (node.bmax[0] - node.bmin[0]);
+			const float ey = 0.5f * (node.bmax[1] - node.bmin[1]);
+			const float ez = 0.5f * (node.bmax[2] - node.bmin[2]);
+
+			bool outside = false;
+
+			for (int j=0; j<6; ++j)
+			{
+				if (0 == (mask & (1 << j)) )
+					continue;
+
+				const float *p = planes[j];
+				const float d = p[0] * cx + p[1] * cy + p[2] * cz + p[3];
+				const float r = fabsf(p[0]) * ex + fabsf(p[1]) * ey + fabsf(p[2]) * ez;
+
+				if (d <= -r)
+				{
+					outside = true;
+					break;
+				}
+				// the whole box is on the inner side
+				if (d > r)
+					mask &= ~(1 << j);
+			}
+
+			if (outside)
+				continue;
+		}
+
+		if (node.count == 0)
+		{
+			stack.push_back( std::make_pair(node.first + 1, mask) );
+			stack.push_back( std::make_pair(node.first, mask) );
+			continue;
+		}
+
+		for (int i=node.first; i<node.first+node.count; ++i)
+		{
+			const int item = mItems[i];
+			const vec4 &sphere = mSpheres[item];
+			bool inside = true;
+
+			// centers of the leaf spheres are in the box, so the passed planes are passed by the spheres as well
+			for (int j=0; j<6 && inside; ++j)
+			{
+				if (mask & (1 << j) )
+					inside = (planes[j][0] * sphere.x + planes[j][1] * sphere.y + planes[j][2] * sphere.z + planes[j][3] > -sphere.w);
+			}
+
+			if (inside)
+				items.push_back(item);
+		}
+	}
+
+	return (int) (items.size() - numberOfItems);
+}
+
+int CBoundingVolumeHierarchy::QuerySphere(const vec3 &center, const float radius, std::vector<int> &items) const
+{
+	if (mNodes.size() == 0)
+		return 0;
+
+	const size_t numberOfItems = items.size();
+	const float radiusSq = radius * radius;
+
+	std::vector<int>	stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (stack.size() > 0)
+	{
+		const BVHNode &node = mNodes[stack.back()];
+		stack.pop_back();
+
+		if (BoxDistanceSq(node.bmin, node.bmax, center.x, center.y, center.z) > radiusSq)
+			continue;
+
+		if (node.count == 0)
+		{
+			stack.push_back(node.first + 1);
+			stack.push_back(node.first);
+			continue;
+		}
+
+		for (int i=node.first; i<node.first+node.count; ++i)
+		{
+			const int item = mItems[i];
+			const vec4 &sphere = mSpheres[item];
+
+			const float dx = sphere.x - center.x;
+			const float dy = sphere.y - center.y;
+			const float dz = sphere.z - center.z;
+			const float sumRadius = sphere.w + radius;
+
+			if (dx*dx + dy*dy + dz*dz <= sumRadius * sumRadius)
+				items.push_back(item);
+		}
+	}
+
+	return (int) (items.size() - numberOfItems);
+}
+
+int CBoundingVolumeHierarchy::QueryBox(const vec3 &bmin, const vec3 &bmax, std::vector<int> &items) const
+{
+	if (mNodes.size() == 0)
+		return 0;
+
+	const size_t numberOfItems = items.size();
+
+	std::vector<int>	stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (stack.size() > 0)
+	{
+		const BVHNode &node = mNodes[stack.back()];
+		stack.pop_back();
+
+		if (node.bmin[0] > bmax.x || node.bmin[1] > bmax.y || node.bmin[2] > bmax.z
+			|| node.bmax[0] < bmin.x || node.bmax[1] < bmin.y || node.bmax[2] < bmin.z)
+			continue;
+
+		if (node.count == 0)
+		{
+			stack.push_back(node.first + 1);
+			stack.push_back(node.first);
+			continue;
+		}
+
+		for (int i=node.first; i<node.first+node.count; ++i)
+		{
+			const int item = mItems[i];
+			const vec4 &sphere = mSpheres[item];
+
+			if (BoxDistanceSq(bmin.vec_array, bmax.vec_array, sphere.x, sphere.y, sphere.z) <= sphere.w * sphere.w)
+				items.push_back(item);
+		}
+	}
+
+	return (int) (items.size() - numberOfItems);
+}
+
+int CBoundingVolumeHierarchy::QueryRay(const vec3 &origin, const vec3 &dir, const float maxDistance, std::vector<int> &items, std::vector<float> *distances) const
+{
+	if (mNodes.size() == 0)
+		return 0;
+
+	const size_t numberOfItems = items.size();
+	const float invDir[3] = { 1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z };
+
+	std::vector<int>	stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (stack.size() > 0)
+	{
+		const BVHNode &node = mNodes[stack.back()];
+		stack.pop_back();
+
+		float tEnter;
+		if (false == RayBox(node.bmin, node.bmax, origin.vec_array, invDir, maxDistance, tEnter) )
+			continue;
+
+		if (node.count == 0)
+		{
+			stack.push_back(node.first + 1);
+			stack.push_back(node.first);
+			continue;
+		}
+
+		for (int i=node.first; i<node.first+node.count; ++i)
+		{
+			const int item = mItems[i];
+			float distance;
+
+			if (RaySphere(mSpheres[item], origin, dir, maxDistance, distance) )
+			{
+				items.push_back(item);
+				if (distances)
+					distances->push_back(distance);
+			}
+		}
+	}
+
+	return (int) (items.size() - numberOfItems);
+}
+
+int CBoundingVolumeHierarchy::IntersectRay(const vec3 &origin, const vec3 &dir, const float maxDistance, float &distance) const
+{
+	int result = -1;
+	distance = maxDistance;
+
+	if (mNodes.size() == 0)
+		return result;
+
+	const float invDir[3] = { 1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z };
+
+	// nodes with their entry distance, nearer child is visited first
+	std::vector<std::pair<int, float>>	stack;
+	stack.reserve(64);
+
+	float tRoot;
+	if (RayBox(mNodes[0].bmin, mNodes[0].bmax, origin.vec_array, invDir, maxDistance, tRoot) )
+		stack.push_back( std::make_pair(0, tRoot) );
+
+	while (stack.size() > 0)
+	{
+		const BVHNode &node = mNodes[stack.back().first];
+		const float tNode = stack.back().second;
+		stack.pop_back();
+
+		if (tNode > distance)
+			continue;
+
+		if (node.count == 0)
+		{
+			float tLeft, tRight;
+			const bool hitLeft = RayBox(mNodes[node.first].bmin, mNodes[node.first].bmax, origin.vec_array, invDir, distance, tLeft);
+			const bool hitRight = RayBox(mNodes[node.first+1].bmin, mNodes[node.first+1].bmax, origin.vec_array, invDir, distance, tRight);
+
+			if (hitLeft && hitRight)
+			{
+				if (tLeft <= tRight)
+				{
+					stack.push_back( std::make_pair(node.first + 1, tRight) );
+					stack.push_back( std::make_pair(node.first, tLeft) );
+				}
+				else
+				{
+					stack.push_back( std::make_pair(node.first, tLeft) );
+					stack.push_back( std::make_pair(node.first + 1, tRight) );
+				}
+			}
+			else if (hitLeft)
+			{
+				stack.push_back( std::make_pair(node.first, tLeft) );
+			}
+			else if (hitRight)
+			{
+				stack.push_back( std::make_pair(node.first + 1, tRight) );
+			}
+			continue;
+		}
+
+		for (int i=node.first; i<node.first+node.count; ++i)
+		{
+			const int item = mItems[i];
+			float itemDistance;
+
+			// the lowest index wins for equal distances, so the result doesn't depend on the tree
+			if (RaySphere(mSpheres[item], origin, dir, distance, itemDistance)
+				&& (itemDistance < distance || (itemDistance == distance && (result < 0 || item < result))) )
+			{
+				distance = itemDistance;
+				result = item;
+			}
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include "nv_math.h"
+#include "math3d.h"
+
+#include <vector>
+
+//
+// bounding volume hierarchy over a set of bounding spheres
+//	tree of axis aligned boxes is built by the binned surface area heuristic, moved items are refitted in place,
+//	so only the leaf and its parents are updated until the tree quality drops and a new build is needed
+//
+
+#define BVH_MAX_LEAF_ITEMS		4
+#define BVH_NUMBER_OF_BINS		16
+
+struct BVHNode
+{
+	float		bmin[3];
+	int			first;		// first item of the leaf or the left child, right child is next to it
+	float		bmax[3];
+	int			count;		// number of leaf items, 0 for the internal node
+};
+
+class CBoundingVolumeHierarchy
+{
+public:
+
+	//! a constructor
+	CBoundingVolumeHierarchy();
+
+	// xyz center and radius in w, items are indices in this array
+	void	Build(const vec4 *spheres, const int count);
+	void	Clear();
+
+	const int GetNumberOfItems() const
+	{
+		return (int) mSpheres.size();
+	}
+	const int GetNumberOfNodes() const
+	{
+		return (int) mNodes.size();
+	}
+	const vec4 &GetItemSphere(const int index) const
+	{
+		return mSpheres[index];
+	}
+
+	// move an item, the tree is updated by a next Refit call
+	void	UpdateItem(const int index, const vec4 &sphere);
+
+	// update boxes of the changed leaves and their parents, returns the number of updated nodes
+	int		Refit();
+	const bool IsRefitNeeded() const
+	{
+		return (mDirtyLeaves.size() > 0);
+	}
+
+	// surface area cost of the tree, it grows with refits and shows when to build the tree again
+	float	ComputeCost() const;
+	const float GetBuildCost() const
+	{
+		return mBuildCost;
+	}
+
+	//
+	// queries add item indices into the vector and return the number of added items
+
+	// the same test as CFrustum::SphereInFrustum
+	int		QueryFrustum(const CFrustum &frustum, std::vector<int> &items) const;
+	// items intersecting the sphere
+	int		QuerySphere(const vec3 &center, const float radius, std::vector<int> &items) const;
+	// items intersecting the box
+	int		QueryBox(const vec3 &bmin, const vec3 &bmax, std::vector<int> &items) const;
+	// all items hit by the ray in the range [0, maxDistance], dir is normalized
+	//	distances - optional, distance to the sphere surface of each added item
+	int		QueryRay(const vec3 &origin, const vec3 &dir, const float maxDistance, std::vector<int> &items, std::vector<float> *distances=nullptr) const;
+
+	// the nearest item hit by the ray, distance is to the sphere surface (0 for the origin inside), returns -1 for no hit
+	int		IntersectRay(const vec3 &origin, const vec3 &dir, const float maxDistance, float &distance) const;
+
+protected:
+
+	std::vector<vec4>		mSpheres;
+	std::vector<BVHNode>	mNodes;			// root is the first one
+	std::vector<int>		mItems;			// leaf items go one after another
+	std::vector<int>		mParents;		// for each node, -1 for the root
+	std::vector<int>		mItemLeaf;		// leaf node of each item
+
+	std::vector<int>		mDirtyLeaves;
+	std::vector<bool>		mLeafDirty;
+
+	float					mBuildCost;
+
+	void	BuildNode(const int nodeIndex, const int first, const int count);
+	void	ComputeLeafBounds(BVHNode &node) const;
+};
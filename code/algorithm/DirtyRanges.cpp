@@ -0,0 +1,158 @@
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "DirtyRanges.h"
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CDirtyRanges::CDirtyRanges()
+{
+	mFull = false;
+
+	mMergeGap = DIRTY_RANGES_MERGE_GAP;
+	mMaxRanges = DIRTY_RANGES_MAX_RANGES;
+	mFullFraction = DIRTY_RANGES_FULL_FRACTION;
+}
+
+void CDirtyRanges::Add(const int first, const int count)
+{
+	if (mFull || first < 0 || count <= 0)
+		return;
+
+	// sequential edits are extended in place
+	if (mRanges.size() > 0)
+	{
+		DirtyRange &last = mRanges.back();
+
+		if (first >= last.first && first <= last.first + last.count + mMergeGap)
+		{
+			last.count = std::max(last.count, first + count - last.first);
+			return;
+		}
+	}
+
+	DirtyRange range;
+	DirtyRange::Set(first, count, range);
+	mRanges.push_back(range);
+}
+
+void CDirtyRanges::AddAll()
+{
+	mFull = true;
+	mRanges.clear();
+}
+
+void CDirtyRanges::Clear()
+{
+	mFull = false;
+	mRanges.clear();
+}
+
+int CDirtyRanges::GetNumberOfElements() const
+{
+	int count = 0;
+	for (auto iter=begin(mRanges); iter!=end(mRanges); ++iter)
+		count += iter->count;
+	return count;
+}
+
+int CDirtyRanges::Coalesce(const int numberOfItems)
+{
+	if (numberOfItems <= 0)
+	{
+		mRanges.clear();
+		return 0;
+	}
+
+	if (false == mFull && mRanges.size() > 0)
+	{
+		std::sort( begin(mRanges), end(mRanges), [] (const DirtyRange &a, const DirtyRange &b) {
+			return a.first < b.first;
+		} );
+
+		// merge overlapping and near ranges, clamp by the array size
+		int numberOfRanges = 0;
+
+		for (auto iter=begin(mRanges); iter!=end(mRanges); ++iter)
+		{
+			if (iter->first >= numberOfItems)
+				break;
+
+			const int last = std::min(iter->first + iter->count, numberOfItems);
+
+			if (numberOfRanges > 0)
+			{
+				DirtyRange &prev = mRanges[numberOfRanges-1];
+
+				if (iter->first <= prev.first + prev.count + mMergeGap)
+				{
+					prev.count = std::max(prev.count, last - prev.first);
+					continue;
+				}
+			}
+
+			DirtyRange::Set(iter->first, last - iter->first, mRanges[numberOfRanges]);
+			numberOfRanges += 1;
+		}
+
+		mRanges.resize(numberOfRanges);
+
+		// too many ranges, close the smallest gaps
+		if (mMaxRanges > 0 && numberOfRanges > mMaxRanges)
+		{
+			mGaps.resize(numberOfRanges - 1);
+			for (int i=0; i<numberOfRanges-1; ++i)
+				mGaps[i] = mRanges[i+1].first - (mRanges[i].first + mRanges[i].count);
+
+			const int numberToClose = numberOfRanges - mMaxRanges;
+			std::nth_element( begin(mGaps), begin(mGaps) + (numberToClose - 1), end(mGaps) );
+			const int maxGap = mGaps[numberToClose - 1];
+
+			// gaps equal to the threshold are closed while there are too many ranges
+			int equalToClose = numberToClose;
+			for (int i=0; i<numberOfRanges-1; ++i)
+				if (mGaps[i] < maxGap)
+					equalToClose -= 1;
+
+			int count = 1;
+			for (int i=1; i<numberOfRanges; ++i)
+			{
+				DirtyRange &prev = mRanges[count-1];
+				const int gap = mRanges[i].first - (prev.first + prev.count);
+
+				if (gap < maxGap || (gap == maxGap && equalToClose > 0) )
+				{
+					if (gap == maxGap)
+						equalToClose -= 1;
+
+					prev.count = mRanges[i].first + mRanges[i].count - prev.first;
+				}
+				else
+				{
+					mRanges[count] = mRanges[i];
+					count += 1;
+				}
+			}
+
+			mRanges.resize(count);
+		}
+
+		if ( (float) GetNumberOfElements() >= mFullFraction * (float) numberOfItems)
+			mFull = true;
+	}
+
+	if (mFull)
+	{
+		mRanges.resize(1);
+		DirtyRange::Set(0, numberOfItems, mRanges[0]);
+	}
+
+	return (int) mRanges.size();
+}
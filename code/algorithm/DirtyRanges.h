@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include <vector>
+
+//
+// changed element ranges of an array, so only the changed part of a gpu buffer is uploaded
+//	ranges are sorted and coalesced before the upload, ranges with a small gap are merged to save the driver calls,
+//	too many ranges or a large covered part turn into one upload of the whole array
+//
+
+#define DIRTY_RANGES_MERGE_GAP			8		// elements between two ranges to merge them
+#define DIRTY_RANGES_MAX_RANGES			64		// more ranges are merged by the smallest gaps
+#define DIRTY_RANGES_FULL_FRACTION		0.5f	// covered part of the array to upload it all
+
+struct DirtyRange
+{
+	int		first;
+	int		count;
+
+	static void Set(const int _first, const int _count, DirtyRange &range)
+	{
+		range.first = _first;
+		range.count = _count;
+	}
+};
+
+class CDirtyRanges
+{
+public:
+
+	//! a constructor
+	CDirtyRanges();
+
+	void SetMergeGap(const int elements)
+	{
+		mMergeGap = elements;
+	}
+	void SetMaxRanges(const int count)
+	{
+		mMaxRanges = count;
+	}
+	void SetFullFraction(const float fraction)
+	{
+		mFullFraction = fraction;
+	}
+
+	// mark elements as changed
+	void	Add(const int first, const int count=1);
+	// mark the whole array
+	void	AddAll();
+	void	Clear();
+
+	const bool IsEmpty() const
+	{
+		return (false == mFull && mRanges.size() == 0);
+	}
+	const bool IsFull() const
+	{
+		return mFull;
+	}
+
+	// sort and merge the ranges for the array of a given size, returns the number of ranges
+	//	the whole array comes as one range when it's full or the ranges cover a large part of it
+	int		Coalesce(const int numberOfItems);
+
+	const int GetNumberOfRanges() const
+	{
+		return (int) mRanges.size();
+	}
+	const DirtyRange *GetRanges() const
+	{
+		return mRanges.data();
+	}
+	// number of elements in the ranges
+	int		GetNumberOfElements() const;
+
+protected:
+
+	bool						mFull;
+	std::vector<DirtyRange>		mRanges;
+
+	int							mMergeGap;
+	int							mMaxRanges;
+	float						mFullFraction;
+
+	std::vector<int>			mGaps;		// temp for merging by the smallest gaps
+};
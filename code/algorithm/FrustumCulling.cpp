@@ -0,0 +1,452 @@
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "FrustumCulling.h"
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+// msvc compiles avx intrinsics without /arch:AVX, the path is chosen by the cpu at run time
+#if (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))) || defined(__AVX__)
+#define FRUSTUM_CULLING_AVX
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(FRUSTUM_CULLING_AVX)
+#include <intrin.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// chunk kernels, count is a multiple of 8, visible indices are written in the increasing order
+
+static int CullSpheresScalar( const float *x, const float *y, const float *z, const float *r, const int first, const int count,
+	const float planes[6][4], const float *eye, unsigned int *visible, float &farDistance )
+{
+	int numberOfVisible = 0;
+	float farMax = 0.0f;
+
+	for (int i=first; i<first+count; ++i)
+	{
+		bool inside = true;
+
+		for (int j=0; j<6 && inside; ++j)
+			inside = (planes[j][0] * x[i] + planes[j][1] * y[i] + planes[j][2] * z[i] + planes[j][3] > -r[i]);
+
+		if (false == inside)
+			continue;
+
+		const float dx = x[i] - eye[0];
+		const float dy = y[i] - eye[1];
+		const float dz = z[i] - eye[2];
+		farMax = std::max( farMax, sqrtf(dx*dx + dy*dy + dz*dz) + r[i] );
+
+		visible[numberOfVisible++] = (unsigned int) i;
+	}
+
+	farDistance = farMax;
+	return numberOfVisible;
+}
+
+#ifdef FRUSTUM_CULLING_SSE
+
+static int CullSpheresSSE( const float *x, const float *y, const float *z, const float *r, const int first, const int count,
+	const float planes[6][4], const float *eye, unsigned int *visible, float &farDistance )
+{
+	__m128 px[6], py[6], pz[6], pw[6];
+
+	for (int j=0; j<6; ++j)
+	{
+		px[j] = _mm_set1_ps(planes[j][0]);
+		py[j] = _mm_set1_ps(planes[j][1]);
+		pz[j] = _mm_set1_ps(planes[j][2]);
+		pw[j] = _mm_set1_ps(planes[j][3]);
+	}
+
+	const __m128 ex = _mm_set1_ps(eye[0]);
+	const __m128 ey = _mm_set1_ps(eye[1]);
+	const __m128 ez = _mm_set1_ps(eye[2]);
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 farMax = zero;
+	int numberOfVisible = 0;
+
+	for (int i=first; i<first+count; i+=4)
+	{
+		const __m128 cx = _mm_loadu_ps(x + i);
+		const __m128 cy = _mm_loadu_ps(y + i);
+		const __m128 cz = _mm_loadu_ps(z + i);
+		const __m128 cr = _mm_loadu_ps(r + i);
+		const __m128 negR = _mm_sub_ps(zero, cr);
+
+		__m128 inside = _mm_castsi128_ps( _mm_set1_epi32(-1) );
+
+		for (int j=0; j<6; ++j)
+		{
+			const __m128 d = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps(px[j], cx), _mm_mul_ps(py[j], cy) ), _mm_mul_ps(pz[j], cz) ), pw[j] );
+			inside = _mm_and_ps( inside, _mm_cmpgt_ps(d, negR) );
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		if (mask == 0)
+			continue;
+
+		const __m128 dx = _mm_sub_ps(cx, ex);
+		const __m128 dy = _mm_sub_ps(cy, ey);
+		const __m128 dz = _mm_sub_ps(cz, ez);
+		const __m128 len = _mm_add_ps( _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy) ), _mm_mul_ps(dz, dz) ) ), cr );
+		farMax = _mm_max_ps( farMax, _mm_and_ps(inside, len) );
+
+		// compaction without branches, index is written always and kept by the lane bit
+		for (int k=0; k<4; ++k)
+		{
+			visible[numberOfVisible] = (unsigned int) (i + k);
+			numberOfVisible += (mask >> k) & 1;
+		}
+	}
+
+	float values[4];
+	_mm_storeu_ps(values, farMax);
+	farDistance = std::max( std::max(values[0], values[1]), std::max(values[2], values[3]) );
+
+	return numberOfVisible;
+}
+
+#endif
+
+#ifdef FRUSTUM_CULLING_AVX
+
+static int CullSpheresAVX( const float *x, const float *y, const float *z, const float *r, const int first, const int count,
+	const float planes[6][4], const float *eye, unsigned int *visible, float &farDistance )
+{
+	__m256 px[6], py[6], pz[6], pw[6];
+
+	for (int j=0; j<6; ++j)
+	{
+		px[j] = _mm256_set1_ps(planes[j][0]);
+		py[j] = _mm256_set1_ps(planes[j][1]);
+		pz[j] = _mm256_set1_ps(planes[j][2]);
+		pw[j] = _mm256_set1_ps(planes[j][3]);
+	}
+
+	const __m256 ex = _mm256_set1_ps(eye[0]);
+	const __m256 ey = _mm256_set1_ps(eye[1]);
+	const __m256 ez = _mm256_set1_ps(eye[2]);
+	const __m256 zero = _mm256_setzero_ps();
+
+	__m256 farMax = zero;
+	int numberOfVisible = 0;
+
+	for (int i=first; i<first+count; i+=8)
+	{
+		const __m256 cx = _mm256_loadu_ps(x + i);
+		const __m256 cy = _mm256_loadu_ps(y + i);
+		const __m256 cz = _mm256_loadu_ps(z + i);
+		const __m256 cr = _mm256_loadu_ps(r + i);
+		const __m256 negR = _mm256_sub_ps(zero, cr);
+
+		__m256 inside = _mm256_cmp_ps( zero, zero, _CMP_EQ_OQ );
+
+		for (int j=0; j<6; ++j)
+		{
+			const __m256 d = _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps(px[j], cx), _mm256_mul_ps(py[j], cy) ), _mm256_mul_ps(pz[j], cz) ), pw[j] );
+			inside = _mm256_and_ps( inside, _mm256_cmp_ps(d, negR, _CMP_GT_OQ) );
+		}
+
+		const int mask = _mm256_movemask_ps(inside);
+		if (mask == 0)
+			continue;
+
+		const __m256 dx = _mm256_sub_ps(cx, ex);
+		const __m256 dy = _mm256_sub_ps(cy, ey);
+		const __m256 dz = _mm256_sub_ps(cz, ez);
+		const __m256 len = _mm256_add_ps( _mm256_sqrt_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy) ), _mm256_mul_ps(dz, dz) ) ), cr );
+		farMax = _mm256_max_ps( farMax, _mm256_and_ps(inside, len) );
+
+		for (int k=0; k<8; ++k)
+		{
+			visible[numberOfVisible] = (unsigned int) (i + k);
+			numberOfVisible += (mask >> k) & 1;
+		}
+	}
+
+	float values[8];
+	_mm256_storeu_ps(values, farMax);
+	_mm256_zeroupper();
+
+	float result = values[0];
+	for (int k=1; k<8; ++k)
+		result = std::max(result, values[k]);
+
+	farDistance = result;
+	return numberOfVisible;
+}
+
+#endif
+
+static bool IsAVXSupported()
+{
+#if defined(FRUSTUM_CULLING_AVX) && defined(_MSC_VER)
+	// cpu has avx and os saves the ymm registers
+	int info[4];
+	__cpuid(info, 1);
+
+	if ( (info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 )
+		return false;
+
+	return (_xgetbv(0) & 6) == 6;
+#elif defined(FRUSTUM_CULLING_AVX)
+	// built for avx
+	return true;
+#else
+	return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CFrustumCulling::CFrustumCulling()
+	: mNextChunk(0)
+{
+	mNumberOfSpheres = 0;
+	mSimd = GetSupportedSimd();
+	mNumberOfThreads = 0;
+
+	memset( mPlanes, 0, sizeof(float) * 24 );
+	mEye[0] = mEye[1] = mEye[2] = 0.0f;
+	mOutput = nullptr;
+
+	mGeneration = 0;
+	mWorkersBusy = 0;
+	mExit = false;
+}
+
+CFrustumCulling::~CFrustumCulling()
+{
+	StopWorkers();
+}
+
+EFrustumCullingSimd CFrustumCulling::GetSupportedSimd()
+{
+	if (IsAVXSupported() )
+		return eFrustumCullingAVX;
+#ifdef FRUSTUM_CULLING_SSE
+	return eFrustumCullingSSE;
+#else
+	return eFrustumCullingScalar;
+#endif
+}
+
+void CFrustumCulling::SetSimd(const EFrustumCullingSimd simd)
+{
+	mSimd = std::min(simd, GetSupportedSimd() );
+}
+
+void CFrustumCulling::SetNumberOfThreads(const int count)
+{
+	mNumberOfThreads = count;
+}
+
+void CFrustumCulling::SetSpheres(const vec4 *spheres, const int count)
+{
+	mNumberOfSpheres = count;
+
+	const int paddedCount = (count + 7) & ~7;
+
+	// padding spheres have a negative infinite radius, so they are outside of any plane
+	mX.assign( paddedCount, 0.0f );
+	mY.assign( paddedCount, 0.0f );
+	mZ.assign( paddedCount, 0.0f );
+	mRadius.assign( paddedCount, -FLT_MAX );
+
+	for (int i=0; i<count; ++i)
+	{
+		mX[i] = spheres[i].x;
+		mY[i] = spheres[i].y;
+		mZ[i] = spheres[i].z;
+		mRadius[i] = spheres[i].w;
+	}
+}
+
+void CFrustumCulling::ClearSpheres()
+{
+	mNumberOfSpheres = 0;
+	mX.clear();
+	mY.clear();
+	mZ.clear();
+	mRadius.clear();
+}
+
+int CFrustumCulling::Cull(const CFrustum &frustum, const vec3 &eyePos, CFrustumCullingOutput *output, float &farDistance)
+{
+	farDistance = 0.0f;
+
+	const int numberOfChunks = GetNumberOfChunks();
+	if (numberOfChunks == 0)
+		return 0;
+
+	for (int i=0; i<6; ++i)
+		memcpy( mPlanes[i], frustum.GetFrustumPlane(i), sizeof(float) * 4 );
+
+	mEye[0] = eyePos.x;
+	mEye[1] = eyePos.y;
+	mEye[2] = eyePos.z;
+	mOutput = output;
+
+	if ( (int) mResults.size() < numberOfChunks)
+		mResults.resize(numberOfChunks);
+
+	int numberOfThreads = (mNumberOfThreads > 0) ? mNumberOfThreads : (int) std::thread::hardware_concurrency();
+	numberOfThreads = std::max( 1, std::min(numberOfThreads, numberOfChunks) );
+
+	mNextChunk = 0;
+
+	if (numberOfThreads > 1)
+	{
+		// calling thread takes chunks as well
+		StartWorkers( numberOfThreads - 1 );
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mGeneration += 1;
+			mWorkersBusy = (int) mWorkers.size();
+		}
+		mStartCondition.notify_all();
+
+		ProcessChunks();
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		while (mWorkersBusy > 0)
+			mDoneCondition.wait(lock);
+	}
+	else
+	{
+		ProcessChunks();
+	}
+
+	int numberOfVisible = 0;
+
+	for (int i=0; i<numberOfChunks; ++i)
+	{
+		numberOfVisible += mResults[i].numberOfVisible;
+		farDistance = std::max( farDistance, mResults[i].farDistance );
+	}
+
+	mOutput = nullptr;
+	return numberOfVisible;
+}
+
+void CFrustumCulling::ProcessChunks()
+{
+	const int numberOfChunks = GetNumberOfChunks();
+
+	for (;;)
+	{
+		const int chunk = mNextChunk.fetch_add(1);
+		if (chunk >= numberOfChunks)
+			break;
+
+		ProcessChunk(chunk);
+	}
+}
+
+void CFrustumCulling::ProcessChunk( const int chunk )
+{
+	const int first = chunk * FRUSTUM_CULLING_CHUNK_SIZE;
+	const int count = std::min( FRUSTUM_CULLING_CHUNK_SIZE, (int) mX.size() - first );
+
+	ChunkResult &result = mResults[chunk];
+	result.visible.resize(FRUSTUM_CULLING_CHUNK_SIZE);
+
+	const float *x = mX.data();
+	const float *y = mY.data();
+	const float *z = mZ.data();
+	const float *r = mRadius.data();
+	unsigned int *visible = result.visible.data();
+
+	switch(mSimd)
+	{
+#ifdef FRUSTUM_CULLING_AVX
+	case eFrustumCullingAVX:
+		result.numberOfVisible = CullSpheresAVX( x, y, z, r, first, count, mPlanes, mEye, visible, result.farDistance );
+		break;
+#endif
+#ifdef FRUSTUM_CULLING_SSE
+	case eFrustumCullingSSE:
+		result.numberOfVisible = CullSpheresSSE( x, y, z, r, first, count, mPlanes, mEye, visible, result.farDistance );
+		break;
+#endif
+	default:
+		result.numberOfVisible = CullSpheresScalar( x, y, z, r, first, count, mPlanes, mEye, visible, result.farDistance );
+	}
+
+	// empty chunks are passed as well, so the output could reset its chunk storage
+	if (mOutput)
+		mOutput->OnVisibleChunk( chunk, visible, result.numberOfVisible );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// workers
+
+void CFrustumCulling::StartWorkers( const int count )
+{
+	if ( (int) mWorkers.size() == count)
+		return;
+
+	StopWorkers();
+
+	mExit = false;
+	for (int i=0; i<count; ++i)
+		mWorkers.push_back( std::thread( &CFrustumCulling::WorkerThread, this, mGeneration ) );
+}
+
+void CFrustumCulling::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mExit = true;
+	}
+	mStartCondition.notify_all();
+
+	for (auto iter=begin(mWorkers); iter!=end(mWorkers); ++iter)
+		iter->join();
+
+	mWorkers.clear();
+}
+
+void CFrustumCulling::WorkerThread( int generation )
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+
+			while (false == mExit && mGeneration == generation)
+				mStartCondition.wait(lock);
+
+			if (mExit)
+				return;
+
+			generation = mGeneration;
+		}
+
+		ProcessChunks();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mWorkersBusy -= 1;
+		}
+		mDoneCondition.notify_one();
+	}
+}
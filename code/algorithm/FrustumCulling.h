@@ -0,0 +1,129 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include "nv_math.h"
+#include "math3d.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//
+// cpu frustum culling of the bounding spheres
+//	spheres are stored in the SoA layout and tested by 4 (SSE) or 8 (AVX) at once against the frustum planes,
+//	the set is split into chunks which are tested by the worker threads in parallel
+//
+
+#define FRUSTUM_CULLING_CHUNK_SIZE		4096	// spheres in one job, multiple of 8
+
+enum EFrustumCullingSimd
+{
+	eFrustumCullingScalar,
+	eFrustumCullingSSE,
+	eFrustumCullingAVX
+};
+
+// receives the visible spheres of each chunk, it's called from the worker threads
+//	chunks are independent, so the output could be written into a chunk own storage without a lock
+class CFrustumCullingOutput
+{
+public:
+	virtual ~CFrustumCullingOutput()
+	{}
+
+	// visible - increasing sphere indices of the chunk
+	virtual void OnVisibleChunk(const int chunk, const unsigned int *visible, const int count) = 0;
+};
+
+class CFrustumCulling
+{
+public:
+
+	//! a constructor
+	CFrustumCulling();
+	//! a destructor
+	~CFrustumCulling();
+
+	// xyz center and radius in w
+	void SetSpheres(const vec4 *spheres, const int count);
+	void ClearSpheres();
+
+	const int GetNumberOfSpheres() const
+	{
+		return mNumberOfSpheres;
+	}
+	const int GetNumberOfChunks() const
+	{
+		return (mNumberOfSpheres + FRUSTUM_CULLING_CHUNK_SIZE - 1) / FRUSTUM_CULLING_CHUNK_SIZE;
+	}
+
+	// 0 - use the hardware threads, 1 - cull in the calling thread only
+	void SetNumberOfThreads(const int count);
+
+	// the best supported one is used by default
+	void SetSimd(const EFrustumCullingSimd simd);
+	const EFrustumCullingSimd GetSimd() const
+	{
+		return mSimd;
+	}
+	static EFrustumCullingSimd GetSupportedSimd();
+
+	// test spheres with the frustum planes (the same test as CFrustum::SphereInFrustum), output could be nullptr
+	//	farDistance - the farthest point of the visible spheres from the eye, 0 if nothing is visible
+	//	returns the number of visible spheres
+	int Cull(const CFrustum &frustum, const vec3 &eyePos, CFrustumCullingOutput *output, float &farDistance);
+
+protected:
+
+	int						mNumberOfSpheres;
+
+	// padded to 8, padding spheres are never visible
+	std::vector<float>		mX;
+	std::vector<float>		mY;
+	std::vector<float>		mZ;
+	std::vector<float>		mRadius;
+
+	EFrustumCullingSimd		mSimd;
+	int						mNumberOfThreads;
+
+	// state of the current Cull call
+	float					mPlanes[6][4];
+	float					mEye[3];
+	CFrustumCullingOutput	*mOutput;
+
+	struct ChunkResult
+	{
+		int					numberOfVisible;
+		float				farDistance;
+		std::vector<unsigned int>	visible;
+	};
+	std::vector<ChunkResult>	mResults;
+
+	//
+	// persistent workers, they wait for a next Cull call
+
+	std::vector<std::thread>	mWorkers;
+	std::mutex					mMutex;
+	std::condition_variable		mStartCondition;
+	std::condition_variable		mDoneCondition;
+	int							mGeneration;
+	int							mWorkersBusy;
+	bool						mExit;
+	std::atomic<int>			mNextChunk;
+
+	void		StartWorkers( const int count );
+	void		StopWorkers();
+	void		WorkerThread( int generation );
+
+	// take chunks until all of them are done
+	void		ProcessChunks();
+	void		ProcessChunk( const int chunk );
+};
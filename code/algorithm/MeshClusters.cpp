@@ -0,0 +1,361 @@
+
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "MeshClusters.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+// triangles with a wider normals spread don't get a cone (cos of the widest angle to the axis)
+#define CLUSTER_CONE_MIN_DOT		0.1f
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// bounds
+
+static inline const float *GetPosition(const float *positions, const int positionStride, const unsigned int index)
+{
+	return (const float*) ((const unsigned char*) positions + (size_t) index * positionStride);
+}
+
+void ComputeMeshClusterBounds(const unsigned int *indices, const int indexCount, const float *positions, const int positionStride, MeshCluster &cluster)
+{
+	memset( &cluster, 0, sizeof(MeshCluster) );
+	cluster.coneCutoff = 1.0f;
+
+	if (indexCount < 3)
+		return;
+
+	// sphere around the box center
+	float bmin[3] = { 1e32f, 1e32f, 1e32f };
+	float bmax[3] = { -1e32f, -1e32f, -1e32f };
+
+	for (int i=0; i<indexCount; ++i)
+	{
+		const float *p = GetPosition(positions, positionStride, indices[i]);
+		for (int k=0; k<3; ++k)
+		{
+			bmin[k] = std::min(bmin[k], p[k]);
+			bmax[k] = std::max(bmax[k], p[k]);
+		}
+	}
+
+	for (int k=0; k<3; ++k)
+		cluster.center[k] = 0.5f * (bmin[k] + bmax[k]);
+
+	float radius2 = 0.0f;
+	for (int i=0; i<indexCount; ++i)
+	{
+		const float *p = GetPosition(positions, positionStride, indices[i]);
+		const float dx = p[0] - cluster.center[0];
+		const float dy = p[1] - cluster.center[1];
+		const float dz = p[2] - cluster.center[2];
+		radius2 = std::max(radius2, dx*dx + dy*dy + dz*dz);
+	}
+	cluster.radius = sqrtf(radius2);
+
+	// normal cone, axis is the average of the unit triangle normals
+	std::vector<float>	normals;
+	normals.reserve(indexCount);
+
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (int i=0; i+2<indexCount; i+=3)
+	{
+		const float *p0 = GetPosition(positions, positionStride, indices[i]);
+		const float *p1 = GetPosition(positions, positionStride, indices[i+1]);
+		const float *p2 = GetPosition(positions, positionStride, indices[i+2]);
+
+		const float e1[3] = { p1[0]-p0[0], p1[1]-p0[1], p1[2]-p0[2] };
+		const float e2[3] = { p2[0]-p0[0], p2[1]-p0[1], p2[2]-p0[2] };
+
+		float n[3] = { e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0] };
+		const float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+
+		// degenerate triangles are never rasterized
+		if (len == 0.0f)
+			continue;
+
+		for (int k=0; k<3; ++k)
+		{
+			n[k] /= len;
+			axis[k] += n[k];
+			normals.push_back(n[k]);
+		}
+	}
+
+	const float axisLen = sqrtf(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+	if (normals.size() == 0 || axisLen == 0.0f)
+		return;
+
+	float mindp = 1.0f;
+	for (size_t i=0; i<normals.size(); i+=3)
+	{
+		const float dp = (normals[i]*axis[0] + normals[i+1]*axis[1] + normals[i+2]*axis[2]) / axisLen;
+		mindp = std::min(mindp, dp);
+	}
+
+	for (int k=0; k<3; ++k)
+		cluster.coneAxis[k] = axis[k] / axisLen;
+
+	cluster.coneCutoff = (mindp <= CLUSTER_CONE_MIN_DOT) ? 1.0f : sqrtf(1.0f - mindp * mindp);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// builder
+
+int BuildMeshClusters(unsigned int *indices, const int firstIndex, const int indexCount, const float *positions, const int positionStride,
+	const int vertexCount, const int maxVertices, const int maxTriangles, std::vector<MeshCluster> &clusters)
+{
+	const int numberOfTriangles = indexCount / 3;
+
+	if (indices == nullptr || positions == nullptr || numberOfTriangles <= 0 || vertexCount <= 0 || maxVertices < 3 || maxTriangles < 1)
+		return 0;
+
+	unsigned int *src = indices + firstIndex;
+
+	for (int i=0; i<numberOfTriangles*3; ++i)
+	{
+		if (src[i] >= (unsigned int) vertexCount)
+			return 0;
+	}
+
+	// vertex -> triangles adjacency
+	std::vector<int>	offsets(vertexCount + 1, 0);
+	std::vector<int>	adjacency(numberOfTriangles * 3);
+
+	for (int i=0; i<numberOfTriangles*3; ++i)
+		offsets[src[i] + 1] += 1;
+	for (int i=0; i<vertexCount; ++i)
+		offsets[i+1] += offsets[i];
+
+	{
+		std::vector<int>	fill(offsets.begin(), offsets.end() - 1);
+		for (int i=0; i<numberOfTriangles*3; ++i)
+			adjacency[fill[src[i]]++] = i / 3;
+	}
+
+	std::vector<unsigned char>	emitted(numberOfTriangles, 0);
+	std::vector<int>			vertexCluster(vertexCount, -1);	// cluster which already has the vertex
+	std::vector<int>			candidates;
+	std::vector<unsigned int>	result;
+	result.reserve(numberOfTriangles * 3);
+
+	const int clustersBefore = (int) clusters.size();
+	int seed = 0;
+
+	auto fn_newVertices = [&] (const int tri, const int clusterId) -> int {
+		return (vertexCluster[src[tri*3]] != clusterId) + (vertexCluster[src[tri*3+1]] != clusterId) + (vertexCluster[src[tri*3+2]] != clusterId);
+	};
+
+	while (seed < numberOfTriangles)
+	{
+		if (emitted[seed])
+		{
+			seed += 1;
+			continue;
+		}
+
+		const int clusterId = (int) (clusters.size() - clustersBefore);
+		const int clusterFirst = (int) result.size();
+
+		int numVertices = 0;
+		int numTriangles = 0;
+		int tri = seed;
+
+		candidates.clear();
+
+		while (tri >= 0)
+		{
+			// add the triangle
+			emitted[tri] = 1;
+			numTriangles += 1;
+
+			for (int k=0; k<3; ++k)
+			{
+				const unsigned int v = src[tri*3+k];
+				result.push_back(v);
+
+				if (vertexCluster[v] != clusterId)
+				{
+					vertexCluster[v] = clusterId;
+					numVertices += 1;
+					candidates.insert( candidates.end(), adjacency.begin() + offsets[v], adjacency.begin() + offsets[v+1] );
+				}
+			}
+
+			if (numTriangles >= maxTriangles)
+				break;
+
+			// neighbours of the last triangle first, the ones which add less new vertices
+			int best = -1;
+			int bestNew = 4;
+
+			for (int k=0; k<3 && bestNew > 0; ++k)
+			{
+				const unsigned int v = src[tri*3+k];
+				for (int j=offsets[v]; j<offsets[v+1]; ++j)
+				{
+					const int t = adjacency[j];
+					if (emitted[t])
+						continue;
+
+					const int newVertices = fn_newVertices(t, clusterId);
+					if (newVertices < bestNew && numVertices + newVertices <= maxVertices)
+					{
+						best = t;
+						bestNew = newVertices;
+					}
+				}
+			}
+
+			// any triangle around the cluster, emitted ones are removed from the list
+			if (best < 0)
+			{
+				size_t count = 0;
+				for (size_t j=0; j<candidates.size(); ++j)
+				{
+					const int t = candidates[j];
+					if (emitted[t])
+						continue;
+
+					candidates[count++] = t;
+
+					const int newVertices = fn_newVertices(t, clusterId);
+					if (newVertices < bestNew && numVertices + newVertices <= maxVertices)
+					{
+						best = t;
+						bestNew = newVertices;
+					}
+				}
+				candidates.resize(count);
+			}
+
+			tri = best;
+		}
+
+		MeshCluster cluster;
+		ComputeMeshClusterBounds( result.data() + clusterFirst, (int) result.size() - clusterFirst, positions, positionStride, cluster );
+		cluster.firstIndex = firstIndex + clusterFirst;
+		cluster.numIndices = (int) result.size() - clusterFirst;
+
+		clusters.push_back(cluster);
+	}
+
+	memcpy( src, result.data(), sizeof(unsigned int) * result.size() );
+
+	return (int) clusters.size() - clustersBefore;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// culling
+
+struct ClusterTransform
+{
+	const float		*m;			// column major model matrix
+	float			scale;		// the biggest axis scale
+	bool			useCone;
+};
+
+static void PrepareClusterTransform(const mat4 &transform, ClusterTransform &data)
+{
+	const float *m = transform.mat_array;
+
+	const float sx = sqrtf(m[0]*m[0] + m[1]*m[1] + m[2]*m[2]);
+	const float sy = sqrtf(m[4]*m[4] + m[5]*m[5] + m[6]*m[6]);
+	const float sz = sqrtf(m[8]*m[8] + m[9]*m[9] + m[10]*m[10]);
+
+	const float det = m[0] * (m[5]*m[10] - m[6]*m[9]) - m[4] * (m[1]*m[10] - m[2]*m[9]) + m[8] * (m[1]*m[6] - m[2]*m[5]);
+
+	const float smin = std::min(sx, std::min(sy, sz));
+
+	data.m = m;
+	data.scale = std::max(sx, std::max(sy, sz));
+	// mirrored models have an opposite winding, non uniform scale bends the normals
+	data.useCone = (det > 0.0f && smin > 0.0f && data.scale <= 1.01f * smin);
+}
+
+static bool IsClusterVisible(const MeshCluster &cluster, const ClusterTransform &data, const CFrustum &frustum, const vec3 &eyePos)
+{
+	const float *m = data.m;
+	const float *c = cluster.center;
+
+	const float wx = m[0]*c[0] + m[4]*c[1] + m[8]*c[2] + m[12];
+	const float wy = m[1]*c[0] + m[5]*c[1] + m[9]*c[2] + m[13];
+	const float wz = m[2]*c[0] + m[6]*c[1] + m[10]*c[2] + m[14];
+	const float radius = cluster.radius * data.scale;
+
+	if (false == frustum.SphereInFrustum(wx, wy, wz, radius) )
+		return false;
+
+	if (data.useCone && cluster.coneCutoff < 1.0f)
+	{
+		const float *a = cluster.coneAxis;
+		const float ax = m[0]*a[0] + m[4]*a[1] + m[8]*a[2];
+		const float ay = m[1]*a[0] + m[5]*a[1] + m[9]*a[2];
+		const float az = m[2]*a[0] + m[6]*a[1] + m[10]*a[2];
+		const float alen = sqrtf(ax*ax + ay*ay + az*az);
+
+		const float dx = wx - eyePos.x;
+		const float dy = wy - eyePos.y;
+		const float dz = wz - eyePos.z;
+		const float dist = sqrtf(dx*dx + dy*dy + dz*dz);
+
+		// all triangles are back facing from any point of the bounding sphere
+		if (alen > 0.0f && (dx*ax + dy*ay + dz*az) / alen >= cluster.coneCutoff * dist + radius)
+			return false;
+	}
+
+	return true;
+}
+
+bool IsMeshClusterVisible(const MeshCluster &cluster, const mat4 &transform, const CFrustum &frustum, const vec3 &eyePos)
+{
+	ClusterTransform data;
+	PrepareClusterTransform(transform, data);
+
+	return IsClusterVisible(cluster, data, frustum, eyePos);
+}
+
+int CullMeshClusters(const MeshCluster *clusters, const int numberOfClusters, const unsigned int indexBase, const mat4 &transform,
+	const CFrustum &frustum, const vec3 &eyePos, std::vector<MeshClusterRange> &ranges)
+{
+	ClusterTransform data;
+	PrepareClusterTransform(transform, data);
+
+	int numberOfVisible = 0;
+	bool lastVisible = false;
+
+	for (int i=0; i<numberOfClusters; ++i)
+	{
+		const MeshCluster &cluster = clusters[i];
+
+		if (false == IsClusterVisible(cluster, data, frustum, eyePos) )
+		{
+			lastVisible = false;
+			continue;
+		}
+
+		const unsigned int first = indexBase + (unsigned int) cluster.firstIndex;
+		numberOfVisible += 1;
+
+		if (lastVisible && ranges.size() > 0 && ranges.back().firstIndex + ranges.back().count == first)
+		{
+			ranges.back().count += (unsigned int) cluster.numIndices;
+		}
+		else
+		{
+			MeshClusterRange range = { first, (unsigned int) cluster.numIndices };
+			ranges.push_back(range);
+		}
+		lastVisible = true;
+	}
+
+	return numberOfVisible;
+}
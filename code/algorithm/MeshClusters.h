@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include "math3d.h"
+#include <vector>
+
+//
+// triangle clusters (meshlets) for a culling finer than one sub mesh
+//	cluster is a range of neighbour triangles in the index buffer with a bounding sphere and a normal cone,
+//	clusters are built inside one sub patch, so all triangles of a cluster have the same material
+//
+
+#define MESH_CLUSTER_MAX_VERTICES			64
+#define MESH_CLUSTER_MAX_TRIANGLES			124
+
+// cluster record of the geometry pack (version 3), model local space
+struct MeshCluster
+{
+	float		center[3];		// bounding sphere
+	float		radius;
+
+	float		coneAxis[3];	// average direction of the triangle normals
+	float		coneCutoff;		// sin of the cone half angle, 1.0 - triangles are not in one hemisphere, cone is not used
+
+	int			firstIndex;		// in the model index buffer
+	int			numIndices;
+};
+
+// part of the index buffer to draw
+struct MeshClusterRange
+{
+	unsigned int	firstIndex;
+	unsigned int	count;
+};
+
+// reorder triangles of the index range [firstIndex, firstIndex+indexCount) into clusters of neighbour triangles,
+//	positions are xyz floats with a given stride in bytes, returns the number of clusters added to the vector
+int BuildMeshClusters(unsigned int *indices, const int firstIndex, const int indexCount, const float *positions, const int positionStride,
+	const int vertexCount, const int maxVertices, const int maxTriangles, std::vector<MeshCluster> &clusters);
+
+// bounding sphere and normal cone of the cluster triangles
+void ComputeMeshClusterBounds(const unsigned int *indices, const int indexCount, const float *positions, const int positionStride, MeshCluster &cluster);
+
+// frustum and back face test of the cluster, transform - model matrix (cone is skipped for mirrored and non uniform scaled models)
+bool IsMeshClusterVisible(const MeshCluster &cluster, const mat4 &transform, const CFrustum &frustum, const vec3 &eyePos);
+
+// add ranges of the visible clusters, clusters next to each other in the index buffer are merged into one range
+//	indexBase - first index of the model in the merged index buffer, returns the number of visible clusters
+int CullMeshClusters(const MeshCluster *clusters, const int numberOfClusters, const unsigned int indexBase, const mat4 &transform,
+	const CFrustum &frustum, const vec3 &eyePos, std::vector<MeshClusterRange> &ranges);
@@ -0,0 +1,475 @@
+
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "MeshOptimize.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// cache simulator
+
+void AnalyzeVertexCache(const unsigned int *indices, const int indexCount, const int vertexCount, const int cacheSize, VertexCacheStatistics &stats)
+{
+	VertexCacheStatistics::Clear(stats);
+
+	if (indices == nullptr || indexCount < 3 || vertexCount <= 0)
+		return;
+
+	// fifo, vertex is in the cache while it's not older than cacheSize misses
+	std::vector<unsigned int>	cacheTime(vertexCount, 0);
+	std::vector<unsigned char>	referenced(vertexCount, 0);
+
+	unsigned int timestamp = (unsigned int) cacheSize + 1;
+
+	const int count = indexCount - indexCount % 3;
+	for (int i=0; i<count; ++i)
+	{
+		const unsigned int v = indices[i];
+		if (v >= (unsigned int) vertexCount)
+			continue;
+
+		if (timestamp - cacheTime[v] > (unsigned int) cacheSize)
+		{
+			cacheTime[v] = timestamp;
+			timestamp += 1;
+			stats.verticesTransformed += 1;
+		}
+
+		if (referenced[v] == 0)
+		{
+			referenced[v] = 1;
+			stats.numberOfVertices += 1;
+		}
+	}
+
+	stats.numberOfTriangles = (unsigned int) (count / 3);
+	stats.acmr = (stats.numberOfTriangles > 0) ? (float) stats.verticesTransformed / (float) stats.numberOfTriangles : 0.0f;
+	stats.atvr = (stats.numberOfVertices > 0) ? (float) stats.verticesTransformed / (float) stats.numberOfVertices : 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// vertex cache optimization
+
+#define MESH_OPTIMIZE_MAX_VALENCE	32
+
+static float	gCachePositionScore[MESH_OPTIMIZE_CACHE_SIZE];
+static float	gValenceScore[MESH_OPTIMIZE_MAX_VALENCE];
+static bool		gScoreTablesReady = false;
+
+static void PrepareScoreTables()
+{
+	if (gScoreTablesReady)
+		return;
+
+	const float cacheDecayPower = 1.5f;
+	const float lastTriScore = 0.75f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+
+	for (int i=0; i<MESH_OPTIMIZE_CACHE_SIZE; ++i)
+	{
+		if (i < 3)
+		{
+			// vertices of the last triangle, the score is fixed to discourage using them straight away
+			gCachePositionScore[i] = lastTriScore;
+		}
+		else
+		{
+			const float scaler = 1.0f / (float) (MESH_OPTIMIZE_CACHE_SIZE - 3);
+			gCachePositionScore[i] = powf( 1.0f - (float) (i - 3) * scaler, cacheDecayPower );
+		}
+	}
+
+	gValenceScore[0] = 0.0f;
+	for (int i=1; i<MESH_OPTIMIZE_MAX_VALENCE; ++i)
+	{
+		// bonus for vertices with few triangles left, get rid of lone vertices quickly
+		gValenceScore[i] = valenceBoostScale * powf( (float) i, -valenceBoostPower );
+	}
+
+	gScoreTablesReady = true;
+}
+
+static float VertexScore(const int cachePosition, const int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = (cachePosition >= 0) ? gCachePositionScore[cachePosition] : 0.0f;
+	score += (remainingTriangles < MESH_OPTIMIZE_MAX_VALENCE) ? gValenceScore[remainingTriangles] : gValenceScore[MESH_OPTIMIZE_MAX_VALENCE-1];
+
+	return score;
+}
+
+void OptimizeVertexCache(unsigned int *dst, const unsigned int *indices, const int indexCount, const int vertexCount)
+{
+	if (dst == nullptr || indices == nullptr || indexCount < 3 || vertexCount <= 0)
+		return;
+
+	PrepareScoreTables();
+
+	const std::vector<unsigned int>	source(indices, indices + indexCount);
+	const int numberOfTriangles = indexCount / 3;
+
+	// triangles adjacency, live triangles of the vertex are at the beginning of the list
+	std::vector<int>	remaining(vertexCount, 0);
+	std::vector<int>	offsets(vertexCount + 1, 0);
+
+	for (int i=0; i<numberOfTriangles * 3; ++i)
+	{
+		if (source[i] >= (unsigned int) vertexCount)
+		{
+			// wrong index, keep the original order
+			if (dst != indices)
+				memcpy( dst, indices, sizeof(unsigned int) * indexCount );
+			return;
+		}
+		remaining[source[i]] += 1;
+	}
+
+	for (int i=0; i<vertexCount; ++i)
+		offsets[i+1] = offsets[i] + remaining[i];
+
+	std::vector<int>	adjacency(numberOfTriangles * 3);
+	std::vector<int>	filled(vertexCount, 0);
+
+	for (int i=0; i<numberOfTriangles; ++i)
+	{
+		for (int k=0; k<3; ++k)
+		{
+			const unsigned int v = source[i*3+k];
+			adjacency[offsets[v] + filled[v]] = i;
+			filled[v] += 1;
+		}
+	}
+
+	std::vector<int>	cachePosition(vertexCount, -1);
+	std::vector<float>	vertexScore(vertexCount);
+	std::vector<float>	triangleScore(numberOfTriangles, 0.0f);
+	std::vector<unsigned char>	emitted(numberOfTriangles, 0);
+
+	for (int i=0; i<vertexCount; ++i)
+		vertexScore[i] = VertexScore(-1, remaining[i]);
+
+	int bestTriangle = -1;
+	float bestScore = -1.0f;
+
+	for (int i=0; i<numberOfTriangles; ++i)
+	{
+		const float score = vertexScore[source[i*3]] + vertexScore[source[i*3+1]] + vertexScore[source[i*3+2]];
+		triangleScore[i] = score;
+
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestTriangle = i;
+		}
+	}
+
+	unsigned int cache[MESH_OPTIMIZE_CACHE_SIZE + 3];
+	unsigned int newCache[MESH_OPTIMIZE_CACHE_SIZE + 3];
+	int cacheCount = 0;
+
+	int cursor = 0;
+	unsigned int *out = dst;
+
+	for (int n=0; n<numberOfTriangles; ++n)
+	{
+		if (bestTriangle < 0)
+		{
+			// dead end, take the next triangle in the input order
+			while (emitted[cursor])
+				cursor += 1;
+			bestTriangle = cursor;
+		}
+
+		const unsigned int *tri = &source[bestTriangle * 3];
+
+		out[0] = tri[0];
+		out[1] = tri[1];
+		out[2] = tri[2];
+		out += 3;
+
+		emitted[bestTriangle] = 1;
+
+		// remove the triangle from live lists
+		for (int k=0; k<3; ++k)
+		{
+			const unsigned int v = tri[k];
+			int *list = &adjacency[offsets[v]];
+			const int last = remaining[v] - 1;
+
+			for (int j=0; j<=last; ++j)
+			{
+				if (list[j] == bestTriangle)
+				{
+					std::swap( list[j], list[last] );
+					break;
+				}
+			}
+			remaining[v] = last;
+		}
+
+		// put triangle vertices in front of the cache
+		int newCount = 0;
+		for (int k=0; k<3; ++k)
+		{
+			if (newCount == 0 || (newCache[0] != tri[k] && (newCount < 2 || newCache[1] != tri[k])) )
+				newCache[newCount++] = tri[k];
+		}
+
+		for (int i=0; i<cacheCount; ++i)
+		{
+			const unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// update vertex and triangles scores, evicted vertices as well
+		for (int i=0; i<newCount; ++i)
+		{
+			const unsigned int v = newCache[i];
+			cachePosition[v] = (i < MESH_OPTIMIZE_CACHE_SIZE) ? i : -1;
+
+			const float score = VertexScore(cachePosition[v], remaining[v]);
+			const float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			const int *list = &adjacency[offsets[v]];
+			for (int j=0; j<remaining[v]; ++j)
+				triangleScore[list[j]] += delta;
+		}
+
+		cacheCount = (newCount < MESH_OPTIMIZE_CACHE_SIZE) ? newCount : MESH_OPTIMIZE_CACHE_SIZE;
+		memcpy( cache, newCache, sizeof(unsigned int) * cacheCount );
+
+		// next best triangle is one of the cached vertices triangles
+		bestTriangle = -1;
+		bestScore = -1.0f;
+
+		for (int i=0; i<cacheCount; ++i)
+		{
+			const unsigned int v = cache[i];
+			const int *list = &adjacency[offsets[v]];
+
+			for (int j=0; j<remaining[v]; ++j)
+			{
+				const int t = list[j];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	// tail of the list which is not a triangle
+	for (int i=numberOfTriangles*3; i<indexCount; ++i)
+		dst[i] = source[i];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// overdraw
+
+struct OverdrawCluster
+{
+	int		firstTriangle;
+	int		numberOfTriangles;
+	float	sortKey;
+};
+
+static bool CompareClusters(const OverdrawCluster &a, const OverdrawCluster &b)
+{
+	return a.sortKey > b.sortKey;
+}
+
+void OptimizeOverdraw(unsigned int *dst, const unsigned int *indices, const int indexCount, const float *positions, const int positionStride, const int vertexCount)
+{
+	if (dst == nullptr || indices == nullptr || positions == nullptr || indexCount < 3 || vertexCount <= 0)
+		return;
+
+	const std::vector<unsigned int>	source(indices, indices + indexCount);
+	const int numberOfTriangles = indexCount / 3;
+
+	for (int i=0; i<numberOfTriangles * 3; ++i)
+	{
+		if (source[i] >= (unsigned int) vertexCount)
+		{
+			if (dst != indices)
+				memcpy( dst, indices, sizeof(unsigned int) * indexCount );
+			return;
+		}
+	}
+
+	// split into clusters where all triangle vertices are missed in the cache
+	std::vector<OverdrawCluster>	clusters;
+	std::vector<unsigned int>		cacheTime(vertexCount, 0);
+	unsigned int timestamp = MESH_SIMULATE_CACHE_SIZE + 1;
+
+	for (int i=0; i<numberOfTriangles; ++i)
+	{
+		int misses = 0;
+		for (int k=0; k<3; ++k)
+		{
+			const unsigned int v = source[i*3+k];
+			if (timestamp - cacheTime[v] > MESH_SIMULATE_CACHE_SIZE)
+			{
+				cacheTime[v] = timestamp;
+				timestamp += 1;
+				misses += 1;
+			}
+		}
+
+		if (clusters.empty() || misses == 3)
+		{
+			OverdrawCluster cluster = { i, 0, 0.0f };
+			clusters.push_back(cluster);
+		}
+		clusters.back().numberOfTriangles += 1;
+	}
+
+	if (clusters.size() < 2)
+	{
+		if (dst != indices)
+			memcpy( dst, indices, sizeof(unsigned int) * indexCount );
+		return;
+	}
+
+	const unsigned char *ptr = (const unsigned char*) positions;
+
+	// area weighted centroid and normal of clusters and the whole mesh
+	std::vector<float>	clusterData(clusters.size() * 6, 0.0f);
+	double meshCentroid[3] = {0.0, 0.0, 0.0};
+	double meshArea = 0.0;
+
+	for (size_t c=0; c<clusters.size(); ++c)
+	{
+		float *data = &clusterData[c * 6];
+		double centroid[3] = {0.0, 0.0, 0.0};
+		double normal[3] = {0.0, 0.0, 0.0};
+		double area = 0.0;
+
+		const int first = clusters[c].firstTriangle;
+		const int last = first + clusters[c].numberOfTriangles;
+
+		for (int i=first; i<last; ++i)
+		{
+			const float *p0 = (const float*) (ptr + (size_t) source[i*3] * positionStride);
+			const float *p1 = (const float*) (ptr + (size_t) source[i*3+1] * positionStride);
+			const float *p2 = (const float*) (ptr + (size_t) source[i*3+2] * positionStride);
+
+			const double e1[3] = { p1[0]-p0[0], p1[1]-p0[1], p1[2]-p0[2] };
+			const double e2[3] = { p2[0]-p0[0], p2[1]-p0[1], p2[2]-p0[2] };
+			const double n[3] = { e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0] };
+
+			const double triArea = 0.5 * sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+
+			for (int k=0; k<3; ++k)
+			{
+				centroid[k] += triArea * (p0[k] + p1[k] + p2[k]) / 3.0;
+				normal[k] += n[k];
+			}
+			area += triArea;
+		}
+
+		for (int k=0; k<3; ++k)
+		{
+			meshCentroid[k] += centroid[k];
+			data[k] = (area > 0.0) ? (float) (centroid[k] / area) : 0.0f;
+			data[3+k] = (float) normal[k];
+		}
+		meshArea += area;
+	}
+
+	for (int k=0; k<3; ++k)
+		meshCentroid[k] = (meshArea > 0.0) ? meshCentroid[k] / meshArea : 0.0;
+
+	// clusters which are facing outside go first
+	for (size_t c=0; c<clusters.size(); ++c)
+	{
+		const float *data = &clusterData[c * 6];
+		const double len = sqrt( (double) data[3]*data[3] + (double) data[4]*data[4] + (double) data[5]*data[5] );
+
+		double dot = 0.0;
+		if (len > 0.0)
+		{
+			for (int k=0; k<3; ++k)
+				dot += (data[k] - meshCentroid[k]) * data[3+k] / len;
+		}
+		clusters[c].sortKey = (float) dot;
+	}
+
+	std::stable_sort( clusters.begin(), clusters.end(), CompareClusters );
+
+	unsigned int *out = dst;
+	for (auto iter=begin(clusters); iter!=end(clusters); ++iter)
+	{
+		const size_t count = (size_t) iter->numberOfTriangles * 3;
+		memcpy( out, &source[iter->firstTriangle * 3], sizeof(unsigned int) * count );
+		out += count;
+	}
+
+	for (int i=numberOfTriangles*3; i<indexCount; ++i)
+		dst[i] = source[i];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// vertex fetch
+
+int OptimizeVertexFetchRemap(unsigned int *remap, const unsigned int *indices, const int indexCount, const int vertexCount)
+{
+	if (remap == nullptr || vertexCount <= 0)
+		return 0;
+
+	const unsigned int unused = 0xFFFFFFFF;
+	for (int i=0; i<vertexCount; ++i)
+		remap[i] = unused;
+
+	unsigned int next = 0;
+	for (int i=0; i<indexCount; ++i)
+	{
+		const unsigned int v = indices[i];
+		if (v < (unsigned int) vertexCount && remap[v] == unused)
+		{
+			remap[v] = next;
+			next += 1;
+		}
+	}
+
+	const int numberOfReferenced = (int) next;
+
+	for (int i=0; i<vertexCount; ++i)
+	{
+		if (remap[i] == unused)
+		{
+			remap[i] = next;
+			next += 1;
+		}
+	}
+
+	return numberOfReferenced;
+}
+
+void RemapIndexBuffer(unsigned int *dst, const unsigned int *indices, const int indexCount, const unsigned int *remap)
+{
+	for (int i=0; i<indexCount; ++i)
+		dst[i] = remap[indices[i]];
+}
+
+void RemapVertexBuffer(void *dst, const void *vertices, const int vertexCount, const int vertexSize, const unsigned int *remap)
+{
+	const unsigned char *src = (const unsigned char*) vertices;
+	unsigned char *out = (unsigned char*) dst;
+
+	for (int i=0; i<vertexCount; ++i)
+		memcpy( out + (size_t) remap[i] * vertexSize, src + (size_t) i * vertexSize, vertexSize );
+}
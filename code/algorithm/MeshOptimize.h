@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+//
+// export time index buffer optimizations
+//	triangle lists only, all functions work on the 32 bit indices
+//
+
+#define MESH_OPTIMIZE_CACHE_SIZE			32		// vertex score cache size (Forsyth)
+#define MESH_SIMULATE_CACHE_SIZE			16		// post-transform fifo size for statistics
+
+// post-transform cache simulator results
+struct VertexCacheStatistics
+{
+	unsigned int	verticesTransformed;
+	unsigned int	numberOfTriangles;
+	unsigned int	numberOfVertices;		// unique referenced vertices
+
+	float			acmr;	// average cache miss ratio (transformed vertices per triangle), 0.5 .. 3.0
+	float			atvr;	// average transformed vertex ratio (transformed per unique vertex), 1.0 is ideal
+
+	static void Clear(VertexCacheStatistics &stats)
+	{
+		stats.verticesTransformed = 0;
+		stats.numberOfTriangles = 0;
+		stats.numberOfVertices = 0;
+		stats.acmr = 0.0f;
+		stats.atvr = 0.0f;
+	}
+
+	// sum counters and update ratios
+	static void Accumulate(VertexCacheStatistics &total, const VertexCacheStatistics &stats)
+	{
+		total.verticesTransformed += stats.verticesTransformed;
+		total.numberOfTriangles += stats.numberOfTriangles;
+		total.numberOfVertices += stats.numberOfVertices;
+		total.acmr = (total.numberOfTriangles > 0) ? (float) total.verticesTransformed / (float) total.numberOfTriangles : 0.0f;
+		total.atvr = (total.numberOfVertices > 0) ? (float) total.verticesTransformed / (float) total.numberOfVertices : 0.0f;
+	}
+};
+
+// fifo cache simulation of a triangle list
+void AnalyzeVertexCache(const unsigned int *indices, const int indexCount, const int vertexCount, const int cacheSize, VertexCacheStatistics &stats);
+
+// reorder triangles for the post-transform cache (linear-speed vertex cache optimization, T.Forsyth)
+//	dst and indices could be the same array
+void OptimizeVertexCache(unsigned int *dst, const unsigned int *indices, const int indexCount, const int vertexCount);
+
+// reorder clusters of triangles to draw outer surfaces first (view-independent, P.Sander "Fast triangle reordering")
+//	cluster borders are places where the simulated cache is flushed, so the cache efficiency is kept
+//	positions are xyz floats with a given stride in bytes, dst and indices could be the same array
+void OptimizeOverdraw(unsigned int *dst, const unsigned int *indices, const int indexCount, const float *positions, const int positionStride, const int vertexCount);
+
+// vertex order for fetch locality (order of the first use), unreferenced vertices go to the end
+//	remap[oldIndex] = newIndex, returns the number of referenced vertices
+int OptimizeVertexFetchRemap(unsigned int *remap, const unsigned int *indices, const int indexCount, const int vertexCount);
+
+// apply remap table to the indices (dst and indices could be the same array) and to a vertex stream (element size in bytes)
+void RemapIndexBuffer(unsigned int *dst, const unsigned int *indices, const int indexCount, const unsigned int *remap);
+void RemapVertexBuffer(void *dst, const void *vertices, const int vertexCount, const int vertexSize, const unsigned int *remap);
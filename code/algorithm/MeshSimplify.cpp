@@ -0,0 +1,357 @@
+
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "MeshSimplify.h"
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+// collapse is rejected if the triangle normal turns more than ~84 degrees
+#define SIMPLIFY_FLIP_MIN_DOT		0.1
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// quadrics
+
+// symmetric 4x4 matrix of the squared distances to the planes, weighted by the triangle area
+struct MeshQuadric
+{
+	double		xx, xy, xz, xw;
+	double		yy, yz, yw;
+	double		zz, zw;
+	double		ww;
+
+	double		weight;		// sum of the areas
+
+	static void Clear(MeshQuadric &q)
+	{
+		memset( &q, 0, sizeof(MeshQuadric) );
+	}
+
+	static void SetPlane(const double a, const double b, const double c, const double d, const double w, MeshQuadric &q)
+	{
+		q.xx = w*a*a;	q.xy = w*a*b;	q.xz = w*a*c;	q.xw = w*a*d;
+		q.yy = w*b*b;	q.yz = w*b*c;	q.yw = w*b*d;
+		q.zz = w*c*c;	q.zw = w*c*d;
+		q.ww = w*d*d;
+		q.weight = w;
+	}
+
+	static void Add(const MeshQuadric &src, MeshQuadric &dst)
+	{
+		dst.xx += src.xx;	dst.xy += src.xy;	dst.xz += src.xz;	dst.xw += src.xw;
+		dst.yy += src.yy;	dst.yz += src.yz;	dst.yw += src.yw;
+		dst.zz += src.zz;	dst.zw += src.zw;
+		dst.ww += src.ww;
+		dst.weight += src.weight;
+	}
+};
+
+// average distance from the point to the planes of two quadrics
+static double QuadricError(const MeshQuadric &q0, const MeshQuadric &q1, const float *p)
+{
+	const double x = p[0], y = p[1], z = p[2];
+
+	const double xx = q0.xx + q1.xx, xy = q0.xy + q1.xy, xz = q0.xz + q1.xz, xw = q0.xw + q1.xw;
+	const double yy = q0.yy + q1.yy, yz = q0.yz + q1.yz, yw = q0.yw + q1.yw;
+	const double zz = q0.zz + q1.zz, zw = q0.zw + q1.zw;
+	const double ww = q0.ww + q1.ww;
+	const double weight = q0.weight + q1.weight;
+
+	const double e = x*x*xx + y*y*yy + z*z*zz + ww
+		+ 2.0 * (x*y*xy + x*z*xz + y*z*yz + x*xw + y*yw + z*zw);
+
+	return (weight > 0.0) ? sqrt( std::max(0.0, e) / weight ) : 0.0;
+}
+
+static inline const float *GetPosition(const float *positions, const int positionStride, const unsigned int index)
+{
+	return (const float*) ((const unsigned char*) positions + (size_t) index * positionStride);
+}
+
+static void TriangleNormal(const float *p0, const float *p1, const float *p2, double *n)
+{
+	const double e1[3] = { (double) p1[0] - p0[0], (double) p1[1] - p0[1], (double) p1[2] - p0[2] };
+	const double e2[3] = { (double) p2[0] - p0[0], (double) p2[1] - p0[1], (double) p2[2] - p0[2] };
+
+	n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// simplification
+
+struct MeshCollapse
+{
+	unsigned int	v0;		// vertex to remove
+	unsigned int	v1;		// vertex to keep
+	float			error;
+
+	bool operator < (const MeshCollapse &other) const {
+		return error < other.error;
+	}
+};
+
+int SimplifyMesh(unsigned int *dst, const unsigned int *indices, const int indexCount, const float *positions, const int positionStride,
+	const int vertexCount, const int targetIndexCount, const float targetError, float *resultError)
+{
+	if (resultError)
+		*resultError = 0.0f;
+
+	if (indexCount < 3 || vertexCount <= 0)
+		return 0;
+
+	std::vector<unsigned int>	work(indices, indices + indexCount - indexCount % 3);
+	for (auto iter=begin(work); iter!=end(work); ++iter)
+		if (*iter >= (unsigned int) vertexCount)
+			return 0;
+
+	// plane quadrics of the vertices
+
+	std::vector<MeshQuadric>	quadrics(vertexCount);
+	for (auto iter=begin(quadrics); iter!=end(quadrics); ++iter)
+		MeshQuadric::Clear(*iter);
+
+	for (size_t i=0; i<work.size(); i+=3)
+	{
+		const float *p0 = GetPosition(positions, positionStride, work[i]);
+
+		double n[3];
+		TriangleNormal( p0, GetPosition(positions, positionStride, work[i+1]), GetPosition(positions, positionStride, work[i+2]), n );
+
+		const double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+		if (len <= 0.0)
+			continue;
+
+		n[0] /= len;	n[1] /= len;	n[2] /= len;
+
+		MeshQuadric q;
+		MeshQuadric::SetPlane( n[0], n[1], n[2], -(n[0]*p0[0] + n[1]*p0[1] + n[2]*p0[2]), 0.5 * len, q );
+
+		for (int k=0; k<3; ++k)
+			MeshQuadric::Add( q, quadrics[work[i+k]] );
+	}
+
+	// vertices of the border and non manifold edges are locked
+
+	std::vector<unsigned char>	locked(vertexCount, 0);
+	{
+		std::vector<uint64_t>	edges;
+		edges.reserve(work.size());
+
+		for (size_t i=0; i<work.size(); i+=3)
+			for (int k=0; k<3; ++k)
+			{
+				const unsigned int a = work[i+k];
+				const unsigned int b = work[i + (k+1)%3];
+				edges.push_back( ((uint64_t) std::min(a,b) << 32) | std::max(a,b) );
+			}
+
+		std::sort( begin(edges), end(edges) );
+
+		for (size_t i=0; i<edges.size(); )
+		{
+			size_t j = i+1;
+			while (j < edges.size() && edges[j] == edges[i])
+				++j;
+
+			if (j - i != 2)
+			{
+				locked[(unsigned int) (edges[i] >> 32)] = 1;
+				locked[(unsigned int) (edges[i] & 0xFFFFFFFF)] = 1;
+			}
+			i = j;
+		}
+	}
+
+	// passes of the independent collapses, cheapest first
+
+	std::vector<int>			triangleOffsets(vertexCount+1);
+	std::vector<unsigned int>	vertexTriangles;
+	std::vector<MeshCollapse>	collapses;
+	std::vector<unsigned int>	remap(vertexCount);
+	std::vector<unsigned char>	touched(vertexCount);
+
+	for (int i=0; i<vertexCount; ++i)
+		remap[i] = i;
+
+	const size_t targetCount = (size_t) std::max(0, targetIndexCount);
+	float maxError = 0.0f;
+
+	while (work.size() > targetCount)
+	{
+		const size_t numberOfTriangles = work.size() / 3;
+
+		// vertex to triangles adjacency
+		std::fill( begin(triangleOffsets), end(triangleOffsets), 0 );
+		for (size_t i=0; i<work.size(); ++i)
+			triangleOffsets[work[i]+1] += 1;
+		for (int i=0; i<vertexCount; ++i)
+			triangleOffsets[i+1] += triangleOffsets[i];
+
+		vertexTriangles.resize(work.size());
+		{
+			std::vector<int> fill(begin(triangleOffsets), end(triangleOffsets)-1);
+			for (size_t i=0; i<work.size(); ++i)
+				vertexTriangles[fill[work[i]]++] = (unsigned int) (i / 3);
+		}
+
+		// every manifold edge is listed by two triangles, take it once
+		collapses.clear();
+		for (size_t i=0; i<work.size(); i+=3)
+			for (int k=0; k<3; ++k)
+			{
+				const unsigned int a = work[i+k];
+				const unsigned int b = work[i + (k+1)%3];
+
+				if (a > b || (locked[a] && locked[b]))
+					continue;
+
+				const double errorAB = (locked[a]) ? 1e32 : QuadricError( quadrics[a], quadrics[b], GetPosition(positions, positionStride, b) );
+				const double errorBA = (locked[b]) ? 1e32 : QuadricError( quadrics[a], quadrics[b], GetPosition(positions, positionStride, a) );
+
+				MeshCollapse collapse;
+				collapse.v0 = (errorAB <= errorBA) ? a : b;
+				collapse.v1 = (errorAB <= errorBA) ? b : a;
+				collapse.error = (float) std::min(errorAB, errorBA);
+
+				if (collapse.error <= targetError)
+					collapses.push_back(collapse);
+			}
+
+		if (collapses.size() == 0)
+			break;
+
+		std::sort( begin(collapses), end(collapses) );
+		std::fill( begin(touched), end(touched), 0 );
+
+		size_t removed = 0;
+		const size_t maxRemoved = numberOfTriangles - targetCount / 3;
+
+		for (auto iter=begin(collapses); iter!=end(collapses) && removed < maxRemoved; ++iter)
+		{
+			const unsigned int v0 = iter->v0;
+			const unsigned int v1 = iter->v1;
+
+			if (touched[v0] || touched[v1])
+				continue;
+
+			// triangles around v0 must not flip after moving v0 into v1
+			const float *p1 = GetPosition(positions, positionStride, v1);
+			bool valid = true;
+			size_t collapsed = 0;
+
+			for (int t=triangleOffsets[v0]; t<triangleOffsets[v0+1] && valid; ++t)
+			{
+				const unsigned int *tri = work.data() + vertexTriangles[t] * 3;
+
+				if (tri[0] == v1 || tri[1] == v1 || tri[2] == v1)
+				{
+					collapsed += 1;
+					continue;
+				}
+
+				const float *p[3];
+				double n0[3], n1[3];
+
+				for (int k=0; k<3; ++k)
+					p[k] = GetPosition(positions, positionStride, tri[k]);
+				TriangleNormal( p[0], p[1], p[2], n0 );
+
+				for (int k=0; k<3; ++k)
+					if (tri[k] == v0)
+						p[k] = p1;
+				TriangleNormal( p[0], p[1], p[2], n1 );
+
+				const double dp = n0[0]*n1[0] + n0[1]*n1[1] + n0[2]*n1[2];
+				const double len = sqrt( (n0[0]*n0[0] + n0[1]*n0[1] + n0[2]*n0[2]) * (n1[0]*n1[0] + n1[1]*n1[1] + n1[2]*n1[2]) );
+
+				valid = (dp > SIMPLIFY_FLIP_MIN_DOT * len);
+			}
+
+			if (!valid || collapsed == 0)
+				continue;
+
+			remap[v0] = v1;
+			MeshQuadric::Add( quadrics[v0], quadrics[v1] );
+
+			// one ring of v0 is changed, neighbour collapses wait for the next pass
+			for (int t=triangleOffsets[v0]; t<triangleOffsets[v0+1]; ++t)
+			{
+				const unsigned int *tri = work.data() + vertexTriangles[t] * 3;
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+
+			removed += collapsed;
+			maxError = std::max(maxError, iter->error);
+		}
+
+		if (removed == 0)
+			break;
+
+		// apply the collapses and remove the degenerate triangles
+		size_t count = 0;
+		for (size_t i=0; i<work.size(); i+=3)
+		{
+			const unsigned int a = remap[work[i]];
+			const unsigned int b = remap[work[i+1]];
+			const unsigned int c = remap[work[i+2]];
+
+			if (a == b || b == c || a == c)
+				continue;
+
+			work[count++] = a;
+			work[count++] = b;
+			work[count++] = c;
+		}
+		work.resize(count);
+	}
+
+	if (work.size() > 0)
+		memmove( dst, work.data(), sizeof(unsigned int) * work.size() );
+
+	if (resultError)
+		*resultError = maxError;
+
+	return (int) work.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// lod selection
+
+int SelectMeshLod(const float *errors, const int numberOfLods, const float pixelsPerUnit, const float pixelError,
+	const float hysteresis, const int currentLod)
+{
+	int lod = 0;
+	for (int i=1; i<numberOfLods; ++i)
+		if (errors[i] * pixelsPerUnit <= pixelError)
+			lod = i;
+
+	if (currentLod < 0 || currentLod >= numberOfLods || lod == currentLod)
+		return lod;
+
+	if (lod > currentLod)
+	{
+		// go coarser only when the error is well under the threshold
+		int coarse = currentLod;
+		for (int i=currentLod+1; i<=lod; ++i)
+			if (errors[i] * pixelsPerUnit <= pixelError * (1.0f - hysteresis))
+				coarse = i;
+		lod = coarse;
+	}
+	else if (errors[currentLod] * pixelsPerUnit <= pixelError * (1.0f + hysteresis))
+	{
+		// keep the current level while it's inside the band
+		lod = currentLod;
+	}
+
+	return lod;
+}
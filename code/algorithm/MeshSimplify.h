@@ -0,0 +1,36 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+//
+// export time mesh simplification for the discrete lod chain and the run time lod selection
+//	triangle lists only, 32 bit indices
+//
+
+#define MESH_LOD_MAX_LEVELS				8		// including the source level
+
+// quadric edge collapse simplification (M.Garland, P.Heckbert), vertices are collapsed onto the other vertices,
+//	so the result indexes the same vertex streams, border and non manifold edges are kept (patch borders, uv seams)
+//	positions are xyz floats with a given stride in bytes, dst and indices could be the same array
+//	targetError - limit of the collapse error in the position units, resultError - the biggest error of the made collapses
+//	returns the number of indices written into dst
+int SimplifyMesh(unsigned int *dst, const unsigned int *indices, const int indexCount, const float *positions, const int positionStride,
+	const int vertexCount, const int targetIndexCount, const float targetError, float *resultError);
+
+// projected size of the unit length in pixels for a distance from the eye
+//	projScaleY - projection matrix [1][1] element, viewportHeight - in pixels
+inline float ComputePixelsPerUnit(const float distance, const float projScaleY, const float viewportHeight)
+{
+	return 0.5f * viewportHeight * projScaleY / ((distance > 1e-4f) ? distance : 1e-4f);
+}
+
+// the coarsest level which projected error is under the pixelError, errors are increasing with the level
+//	hysteresis (0..1) keeps the current level while its error is inside [pixelError * (1-h), pixelError * (1+h)]
+//	currentLod - the level of the previous frame, -1 if there is no one
+int SelectMeshLod(const float *errors, const int numberOfLods, const float pixelsPerUnit, const float pixelError,
+	const float hysteresis, const int currentLod);
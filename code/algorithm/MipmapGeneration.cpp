@@ -0,0 +1,305 @@
+
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "MipmapGeneration.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MIPMAP_GENERATION_SSE2
+#include <emmintrin.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// lookup tables, filled once on the module load
+
+struct MipmapTables
+{
+	unsigned short	srgbToLinear[256];			// linear light in 16 bit fixed point
+	unsigned char	linearToSRGB[65536];		// nearest sRGB code for the 16 bit linear value
+	float			normalDecode[256];			// [0; 255] -> [-1; 1]
+
+	//! a constructor
+	MipmapTables()
+	{
+		for (int i=0; i<256; ++i)
+		{
+			srgbToLinear[i] = (unsigned short) (DecodeSRGB( (double) i / 255.0 ) * 65535.0 + 0.5);
+			normalDecode[i] = (float) i * (2.0f / 255.0f) - 1.0f;
+		}
+
+		// code changes where the linear value crosses the middle of two neighbour codes
+		int value = 0;
+		for (int code=0; code<255; ++code)
+		{
+			const int threshold = (int) ceil( DecodeSRGB( ((double) code + 0.5) / 255.0 ) * 65535.0 );
+
+			for ( ; value < threshold && value < 65536; ++value)
+				linearToSRGB[value] = (unsigned char) code;
+		}
+		for ( ; value < 65536; ++value)
+			linearToSRGB[value] = 255;
+	}
+
+	static double DecodeSRGB(const double value)
+	{
+		return (value <= 0.04045) ? value / 12.92 : pow( (value + 0.055) / 1.055, 2.4 );
+	}
+};
+
+static const MipmapTables	gMipmapTables;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+int GetNumberOfMipLevels(const int width, const int height)
+{
+	int size = std::max(width, height);
+	int levels = 1;
+
+	while (size > 1)
+	{
+		size = size / 2;
+		levels += 1;
+	}
+	return levels;
+}
+
+void GetMipLevelSize(const int width, const int height, const int level, int &levelWidth, int &levelHeight)
+{
+	levelWidth = std::max(1, width >> level);
+	levelHeight = std::max(1, height >> level);
+}
+
+size_t GetMipChainSize(const int width, const int height, const int components)
+{
+	const int numberOfLevels = GetNumberOfMipLevels(width, height);
+	size_t size = 0;
+
+	for (int i=1; i<numberOfLevels; ++i)
+	{
+		int levelWidth, levelHeight;
+		GetMipLevelSize( width, height, i, levelWidth, levelHeight );
+
+		size += (size_t) levelWidth * levelHeight * components;
+	}
+	return size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// filters, one row of the next level from two source rows
+
+static void DownsampleRowLinear(const unsigned char *row0, const unsigned char *row1, const int width, const int dstWidth,
+	const int components, unsigned char *dst)
+{
+	int x = 0;
+
+#ifdef MIPMAP_GENERATION_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(2);
+
+	if (width >= 2 && components == 4)
+	{
+		// 4 source pixels -> 2 pixels
+		for ( ; x + 2 <= dstWidth; x += 2)
+		{
+			const __m128i a = _mm_loadu_si128( (const __m128i*) (row0 + x * 8) );
+			const __m128i b = _mm_loadu_si128( (const __m128i*) (row1 + x * 8) );
+
+			const __m128i sumLo = _mm_add_epi16( _mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero) );
+			const __m128i sumHi = _mm_add_epi16( _mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero) );
+
+			const __m128i pairLo = _mm_add_epi16( sumLo, _mm_srli_si128(sumLo, 8) );
+			const __m128i pairHi = _mm_add_epi16( sumHi, _mm_srli_si128(sumHi, 8) );
+
+			__m128i result = _mm_unpacklo_epi64( pairLo, pairHi );
+			result = _mm_srli_epi16( _mm_add_epi16(result, round), 2 );
+
+			_mm_storel_epi64( (__m128i*) (dst + x * 4), _mm_packus_epi16(result, result) );
+		}
+	}
+	else if (width >= 2 && components == 1)
+	{
+		const __m128i ones = _mm_set1_epi16(1);
+
+		// 16 source pixels -> 8 pixels
+		for ( ; x + 8 <= dstWidth; x += 8)
+		{
+			const __m128i a = _mm_loadu_si128( (const __m128i*) (row0 + x * 2) );
+			const __m128i b = _mm_loadu_si128( (const __m128i*) (row1 + x * 2) );
+
+			const __m128i sumLo = _mm_add_epi16( _mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero) );
+			const __m128i sumHi = _mm_add_epi16( _mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero) );
+
+			__m128i result = _mm_packs_epi32( _mm_madd_epi16(sumLo, ones), _mm_madd_epi16(sumHi, ones) );
+			result = _mm_srli_epi16( _mm_add_epi16(result, round), 2 );
+
+			_mm_storel_epi64( (__m128i*) (dst + x), _mm_packus_epi16(result, result) );
+		}
+	}
+#endif
+
+	for ( ; x < dstWidth; ++x)
+	{
+		const int x0 = std::min(2 * x, width - 1) * components;
+		const int x1 = std::min(2 * x + 1, width - 1) * components;
+
+		for (int i=0; i<components; ++i)
+		{
+			dst[x * components + i] = (unsigned char) ( (row0[x0 + i] + row0[x1 + i] + row1[x0 + i] + row1[x1 + i] + 2) >> 2 );
+		}
+	}
+}
+
+static void DownsampleRowSRGB(const unsigned char *row0, const unsigned char *row1, const int width, const int dstWidth,
+	const int components, unsigned char *dst)
+{
+	const unsigned short *toLinear = gMipmapTables.srgbToLinear;
+	const unsigned char *toSRGB = gMipmapTables.linearToSRGB;
+
+	// gray + alpha or rgb + alpha
+	const int colorComponents = (components >= 3) ? 3 : 1;
+
+	for (int x=0; x<dstWidth; ++x)
+	{
+		const int x0 = std::min(2 * x, width - 1) * components;
+		const int x1 = std::min(2 * x + 1, width - 1) * components;
+
+		int i=0;
+		for ( ; i<colorComponents; ++i)
+		{
+			const int sum = toLinear[row0[x0 + i]] + toLinear[row0[x1 + i]] + toLinear[row1[x0 + i]] + toLinear[row1[x1 + i]];
+			dst[x * components + i] = toSRGB[ (sum + 2) >> 2 ];
+		}
+		for ( ; i<components; ++i)
+		{
+			dst[x * components + i] = (unsigned char) ( (row0[x0 + i] + row0[x1 + i] + row1[x0 + i] + row1[x1 + i] + 2) >> 2 );
+		}
+	}
+}
+
+static void DownsampleRowNormalMap(const unsigned char *row0, const unsigned char *row1, const int width, const int dstWidth,
+	const int components, unsigned char *dst)
+{
+	const float *decode = gMipmapTables.normalDecode;
+
+	for (int x=0; x<dstWidth; ++x)
+	{
+		const int x0 = std::min(2 * x, width - 1) * components;
+		const int x1 = std::min(2 * x + 1, width - 1) * components;
+
+		float n[3];
+		for (int i=0; i<3; ++i)
+			n[i] = decode[row0[x0 + i]] + decode[row0[x1 + i]] + decode[row1[x0 + i]] + decode[row1[x1 + i]];
+
+		const float len = sqrtf( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+
+		if (len > 1.0e-6f)
+		{
+			const float scale = 1.0f / len;
+			for (int i=0; i<3; ++i)
+				n[i] *= scale;
+		}
+		else
+		{
+			// opposite normals, keep the surface facing up
+			n[0] = n[1] = 0.0f;
+			n[2] = 1.0f;
+		}
+
+		unsigned char *pixel = dst + x * components;
+		for (int i=0; i<3; ++i)
+			pixel[i] = (unsigned char) std::min( 255, std::max(0, (int) ((n[i] * 0.5f + 0.5f) * 255.0f + 0.5f)) );
+
+		if (components == 4)
+			pixel[3] = (unsigned char) ( (row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) >> 2 );
+	}
+}
+
+void DownsampleImage(const unsigned char *src, const int width, const int height, const int components,
+	const EMipmapFilter filter, unsigned char *dst)
+{
+	const int dstWidth = std::max(1, width / 2);
+	const int dstHeight = std::max(1, height / 2);
+	const size_t pitch = (size_t) width * components;
+
+	for (int y=0; y<dstHeight; ++y)
+	{
+		const unsigned char *row0 = src + std::min(2 * y, height - 1) * pitch;
+		const unsigned char *row1 = src + std::min(2 * y + 1, height - 1) * pitch;
+		unsigned char *dstRow = dst + (size_t) y * dstWidth * components;
+
+		if (filter == eMipmapFilterNormalMap && components >= 3)
+			DownsampleRowNormalMap( row0, row1, width, dstWidth, components, dstRow );
+		else if (filter == eMipmapFilterSRGB)
+			DownsampleRowSRGB( row0, row1, width, dstWidth, components, dstRow );
+		else
+			DownsampleRowLinear( row0, row1, width, dstWidth, components, dstRow );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// alpha coverage
+
+float ComputeAlphaCoverage(const unsigned char *src, const int width, const int height, const int components,
+	const int alphaReference, const float alphaScale)
+{
+	if (components != 2 && components != 4)
+		return 0.0f;
+
+	const size_t count = (size_t) width * height;
+	size_t covered = 0;
+
+	// scaled alpha above the reference
+	const float threshold = (float) alphaReference / alphaScale;
+	const unsigned char *alpha = src + components - 1;
+
+	for (size_t i=0; i<count; ++i, alpha += components)
+	{
+		if ( (float) *alpha > threshold )
+			covered += 1;
+	}
+
+	return (count > 0) ? (float) covered / (float) count : 0.0f;
+}
+
+void ScaleAlphaToCoverage(unsigned char *image, const int width, const int height, const int components,
+	const int alphaReference, const float coverage)
+{
+	if (components != 2 && components != 4)
+		return;
+
+	float minScale = 0.0f;
+	float maxScale = 4.0f;
+	float scale = 1.0f;
+
+	// coverage grows with the scale
+	for (int i=0; i<10; ++i)
+	{
+		const float levelCoverage = ComputeAlphaCoverage( image, width, height, components, alphaReference, scale );
+
+		if (levelCoverage < coverage)
+			minScale = scale;
+		else if (levelCoverage > coverage)
+			maxScale = scale;
+		else
+			break;
+
+		scale = 0.5f * (minScale + maxScale);
+	}
+
+	const size_t count = (size_t) width * height;
+	unsigned char *alpha = image + components - 1;
+
+	for (size_t i=0; i<count; ++i, alpha += components)
+	{
+		*alpha = (unsigned char) std::min( 255, (int) ((float) *alpha * scale + 0.5f) );
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include <stddef.h>
+
+//
+// mip chain generation of 8 bit images (1, 2, 3 or 4 components)
+//	every level is a 2x2 box filter of the previous one, odd sizes are rounded down like in OpenGL
+//	last component of 2 and 4 component images is alpha and it's always filtered in linear space
+//
+
+enum EMipmapFilter
+{
+	eMipmapFilterLinear,		// plain average, masks and data textures
+	eMipmapFilterSRGB,			// color components are averaged in linear light
+	eMipmapFilterNormalMap		// xyz are decoded from [0; 255], averaged and renormalized (3 or 4 components)
+};
+
+// number of levels including the base one
+int GetNumberOfMipLevels(const int width, const int height);
+void GetMipLevelSize(const int width, const int height, const int level, int &levelWidth, int &levelHeight);
+
+// size of levels 1..n in bytes (without the base level)
+size_t GetMipChainSize(const int width, const int height, const int components);
+
+// compute a next level, dst is max(1, width/2) x max(1, height/2)
+void DownsampleImage(const unsigned char *src, const int width, const int height, const int components,
+	const EMipmapFilter filter, unsigned char *dst);
+
+// fraction of pixels with an alpha above the reference value (0 - image has no alpha)
+float ComputeAlphaCoverage(const unsigned char *src, const int width, const int height, const int components,
+	const int alphaReference, const float alphaScale=1.0f);
+
+// scale alpha of the level in place to get the same coverage as on the base level
+//	keeps alpha tested foliage / fences from thinning out in the distance
+void ScaleAlphaToCoverage(unsigned char *image, const int width, const int height, const int components,
+	const int alphaReference, const float coverage);
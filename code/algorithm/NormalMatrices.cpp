@@ -0,0 +1,488 @@
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "NormalMatrices.h"
+#include <string.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define NORMAL_MATRICES_SSE
+#include <emmintrin.h>
+#endif
+
+// msvc compiles avx intrinsics without /arch:AVX, the path is chosen by the cpu at run time
+#if (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))) || defined(__AVX__)
+#define NORMAL_MATRICES_AVX
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(NORMAL_MATRICES_AVX)
+#include <intrin.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// block kernels, 8 models in the SoA layout
+//	m - upper 3x3 of the model transforms, n - normal matrices, both are column major (element [column*3+row])
+//	C = V * M, columns of the inverse transpose are the cross products of C columns divided by the determinant
+
+static void ComputeBlockScalar( const float *v, const float m[9][8], float n[9][8] )
+{
+	for (int i=0; i<8; ++i)
+	{
+		float c[9];
+
+		for (int col=0; col<3; ++col)
+			for (int row=0; row<3; ++row)
+				c[col*3+row] = v[row] * m[col*3][i] + v[3+row] * m[col*3+1][i] + v[6+row] * m[col*3+2][i];
+
+		const float *a = c;
+		const float *b = c + 3;
+		const float *d = c + 6;
+
+		const float bd[3] = { b[1]*d[2] - b[2]*d[1], b[2]*d[0] - b[0]*d[2], b[0]*d[1] - b[1]*d[0] };
+		const float da[3] = { d[1]*a[2] - d[2]*a[1], d[2]*a[0] - d[0]*a[2], d[0]*a[1] - d[1]*a[0] };
+		const float ab[3] = { a[1]*b[2] - a[2]*b[1], a[2]*b[0] - a[0]*b[2], a[0]*b[1] - a[1]*b[0] };
+
+		// unchecked for zero as in the nv_math invert
+		const float oodet = 1.0f / (a[0]*bd[0] + a[1]*bd[1] + a[2]*bd[2]);
+
+		for (int j=0; j<3; ++j)
+		{
+			n[j][i] = bd[j] * oodet;
+			n[3+j][i] = da[j] * oodet;
+			n[6+j][i] = ab[j] * oodet;
+		}
+	}
+}
+
+#ifdef NORMAL_MATRICES_SSE
+
+static void ComputeBlockSSE( const float *v, const float m[9][8], float n[9][8] )
+{
+	__m128 vv[9];
+	for (int j=0; j<9; ++j)
+		vv[j] = _mm_set1_ps(v[j]);
+
+	for (int half=0; half<8; half+=4)
+	{
+		__m128 c[9];
+
+		for (int col=0; col<3; ++col)
+		{
+			const __m128 m0 = _mm_loadu_ps( m[col*3] + half );
+			const __m128 m1 = _mm_loadu_ps( m[col*3+1] + half );
+			const __m128 m2 = _mm_loadu_ps( m[col*3+2] + half );
+
+			for (int row=0; row<3; ++row)
+				c[col*3+row] = _mm_add_ps( _mm_add_ps( _mm_mul_ps(vv[row], m0), _mm_mul_ps(vv[3+row], m1) ), _mm_mul_ps(vv[6+row], m2) );
+		}
+
+		const __m128 *a = c;
+		const __m128 *b = c + 3;
+		const __m128 *d = c + 6;
+
+		__m128 r[9];
+		r[0] = _mm_sub_ps( _mm_mul_ps(b[1], d[2]), _mm_mul_ps(b[2], d[1]) );
+		r[1] = _mm_sub_ps( _mm_mul_ps(b[2], d[0]), _mm_mul_ps(b[0], d[2]) );
+		r[2] = _mm_sub_ps( _mm_mul_ps(b[0], d[1]), _mm_mul_ps(b[1], d[0]) );
+		r[3] = _mm_sub_ps( _mm_mul_ps(d[1], a[2]), _mm_mul_ps(d[2], a[1]) );
+		r[4] = _mm_sub_ps( _mm_mul_ps(d[2], a[0]), _mm_mul_ps(d[0], a[2]) );
+		r[5] = _mm_sub_ps( _mm_mul_ps(d[0], a[1]), _mm_mul_ps(d[1], a[0]) );
+		r[6] = _mm_sub_ps( _mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]) );
+		r[7] = _mm_sub_ps( _mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]) );
+		r[8] = _mm_sub_ps( _mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]) );
+
+		const __m128 det = _mm_add_ps( _mm_add_ps( _mm_mul_ps(a[0], r[0]), _mm_mul_ps(a[1], r[1]) ), _mm_mul_ps(a[2], r[2]) );
+		const __m128 oodet = _mm_div_ps( _mm_set1_ps(1.0f), det );
+
+		for (int j=0; j<9; ++j)
+			_mm_storeu_ps( n[j] + half, _mm_mul_ps(r[j], oodet) );
+	}
+}
+
+#endif
+
+#ifdef NORMAL_MATRICES_AVX
+
+static void ComputeBlockAVX( const float *v, const float m[9][8], float n[9][8] )
+{
+	__m256 c[9];
+
+	for (int col=0; col<3; ++col)
+	{
+		const __m256 m0 = _mm256_loadu_ps( m[col*3] );
+		const __m256 m1 = _mm256_loadu_ps( m[col*3+1] );
+		const __m256 m2 = _mm256_loadu_ps( m[col*3+2] );
+
+		for (int row=0; row<3; ++row)
+			c[col*3+row] = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps(_mm256_set1_ps(v[row]), m0),
+				_mm256_mul_ps(_mm256_set1_ps(v[3+row]), m1) ), _mm256_mul_ps(_mm256_set1_ps(v[6+row]), m2) );
+	}
+
+	const __m256 *a = c;
+	const __m256 *b = c + 3;
+	const __m256 *d = c + 6;
+
+	__m256 r[9];
+	r[0] = _mm256_sub_ps( _mm256_mul_ps(b[1], d[2]), _mm256_mul_ps(b[2], d[1]) );
+	r[1] = _mm256_sub_ps( _mm256_mul_ps(b[2], d[0]), _mm256_mul_ps(b[0], d[2]) );
+	r[2] = _mm256_sub_ps( _mm256_mul_ps(b[0], d[1]), _mm256_mul_ps(b[1], d[0]) );
+	r[3] = _mm256_sub_ps( _mm256_mul_ps(d[1], a[2]), _mm256_mul_ps(d[2], a[1]) );
+	r[4] = _mm256_sub_ps( _mm256_mul_ps(d[2], a[0]), _mm256_mul_ps(d[0], a[2]) );
+	r[5] = _mm256_sub_ps( _mm256_mul_ps(d[0], a[1]), _mm256_mul_ps(d[1], a[0]) );
+	r[6] = _mm256_sub_ps( _mm256_mul_ps(a[1], b[2]), _mm256_mul_ps(a[2], b[1]) );
+	r[7] = _mm256_sub_ps( _mm256_mul_ps(a[2], b[0]), _mm256_mul_ps(a[0], b[2]) );
+	r[8] = _mm256_sub_ps( _mm256_mul_ps(a[0], b[1]), _mm256_mul_ps(a[1], b[0]) );
+
+	const __m256 det = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps(a[0], r[0]), _mm256_mul_ps(a[1], r[1]) ), _mm256_mul_ps(a[2], r[2]) );
+	const __m256 oodet = _mm256_div_ps( _mm256_set1_ps(1.0f), det );
+
+	for (int j=0; j<9; ++j)
+		_mm256_storeu_ps( n[j], _mm256_mul_ps(r[j], oodet) );
+}
+
+#endif
+
+static bool IsAVXSupported()
+{
+#if defined(NORMAL_MATRICES_AVX) && defined(_MSC_VER)
+	// cpu has avx and os saves the ymm registers
+	int info[4];
+	__cpuid(info, 1);
+
+	if ( (info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 )
+		return false;
+
+	return (_xgetbv(0) & 6) == 6;
+#elif defined(NORMAL_MATRICES_AVX)
+	// built for avx
+	return true;
+#else
+	return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CNormalMatrices::CNormalMatrices()
+	: mNextChunk(0)
+{
+	mNumberOfModels = 0;
+	mAllDirty = false;
+
+	memset( mView, 0, sizeof(float) * 9 );
+
+	mSimd = GetSupportedSimd();
+	mNumberOfThreads = 0;
+
+	mTransforms = nullptr;
+	mTransformStride = 0;
+	mRecords = nullptr;
+	mRecordStride = 0;
+	mLayout = eNormalMatricesLayout4x4;
+	mIndices = nullptr;
+	mCount = 0;
+
+	mGeneration = 0;
+	mWorkersBusy = 0;
+	mExit = false;
+}
+
+CNormalMatrices::~CNormalMatrices()
+{
+	StopWorkers();
+}
+
+ENormalMatricesSimd CNormalMatrices::GetSupportedSimd()
+{
+	if (IsAVXSupported() )
+		return eNormalMatricesAVX;
+#ifdef NORMAL_MATRICES_SSE
+	return eNormalMatricesSSE;
+#else
+	return eNormalMatricesScalar;
+#endif
+}
+
+void CNormalMatrices::SetSimd(const ENormalMatricesSimd simd)
+{
+	mSimd = std::min(simd, GetSupportedSimd() );
+}
+
+void CNormalMatrices::SetNumberOfThreads(const int count)
+{
+	mNumberOfThreads = count;
+}
+
+void CNormalMatrices::SetNumberOfModels(const int count)
+{
+	mNumberOfModels = count;
+	mDirtyModels.clear();
+	mModelDirty.assign( count, false );
+	mAllDirty = (count > 0);
+}
+
+void CNormalMatrices::SetModelDirty(const int index)
+{
+	if (mAllDirty || index < 0 || index >= mNumberOfModels || mModelDirty[index])
+		return;
+
+	mModelDirty[index] = true;
+	mDirtyModels.push_back(index);
+}
+
+void CNormalMatrices::SetAllDirty()
+{
+	for (auto iter=begin(mDirtyModels); iter!=end(mDirtyModels); ++iter)
+		mModelDirty[*iter] = false;
+
+	mDirtyModels.clear();
+	mAllDirty = (mNumberOfModels > 0);
+}
+
+int CNormalMatrices::Update(const mat4 &view, const float *transforms, const int transformStride,
+		float *records, const int recordStride, const ENormalMatricesLayout layout, CDirtyRanges *updated)
+{
+	if (mNumberOfModels == 0 || transforms == nullptr || records == nullptr)
+		return 0;
+
+	// normal matrices don't depend on the view translation
+	float view3[9];
+	for (int col=0; col<3; ++col)
+		for (int row=0; row<3; ++row)
+			view3[col*3+row] = view.mat_array[col*4+row];
+
+	if (memcmp(view3, mView, sizeof(float) * 9) != 0)
+	{
+		memcpy( mView, view3, sizeof(float) * 9 );
+		SetAllDirty();
+	}
+
+	const int count = GetNumberOfDirty();
+	if (count == 0)
+		return 0;
+
+	// dirty models are visited in the memory order
+	if (false == mAllDirty)
+		std::sort( begin(mDirtyModels), end(mDirtyModels) );
+
+	mTransforms = transforms;
+	mTransformStride = transformStride;
+	mRecords = records;
+	mRecordStride = recordStride;
+	mLayout = layout;
+	mIndices = (mAllDirty) ? nullptr : mDirtyModels.data();
+	mCount = count;
+
+	const int numberOfChunks = (count + NORMAL_MATRICES_CHUNK_SIZE - 1) / NORMAL_MATRICES_CHUNK_SIZE;
+
+	int numberOfThreads = (mNumberOfThreads > 0) ? mNumberOfThreads : (int) std::thread::hardware_concurrency();
+	numberOfThreads = std::max( 1, std::min(numberOfThreads, numberOfChunks) );
+
+	mNextChunk = 0;
+
+	if (numberOfThreads > 1)
+	{
+		// calling thread takes chunks as well
+		StartWorkers( numberOfThreads - 1 );
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mGeneration += 1;
+			mWorkersBusy = (int) mWorkers.size();
+		}
+		mStartCondition.notify_all();
+
+		ProcessChunks();
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		while (mWorkersBusy > 0)
+			mDoneCondition.wait(lock);
+	}
+	else
+	{
+		ProcessChunks();
+	}
+
+	if (updated)
+	{
+		if (mAllDirty)
+			updated->AddAll();
+
+		for (auto iter=begin(mDirtyModels); iter!=end(mDirtyModels); ++iter)
+			updated->Add(*iter);
+	}
+
+	// clear dirty flags
+	for (auto iter=begin(mDirtyModels); iter!=end(mDirtyModels); ++iter)
+		mModelDirty[*iter] = false;
+
+	mDirtyModels.clear();
+	mAllDirty = false;
+
+	mTransforms = nullptr;
+	mRecords = nullptr;
+	mIndices = nullptr;
+
+	return count;
+}
+
+void CNormalMatrices::ProcessChunks()
+{
+	const int numberOfChunks = (mCount + NORMAL_MATRICES_CHUNK_SIZE - 1) / NORMAL_MATRICES_CHUNK_SIZE;
+
+	for (;;)
+	{
+		const int chunk = mNextChunk.fetch_add(1);
+		if (chunk >= numberOfChunks)
+			break;
+
+		ProcessChunk(chunk);
+	}
+}
+
+void CNormalMatrices::ProcessChunk( const int chunk )
+{
+	const int first = chunk * NORMAL_MATRICES_CHUNK_SIZE;
+	const int last = std::min( first + NORMAL_MATRICES_CHUNK_SIZE, mCount );
+
+	float m[9][8];
+	float n[9][8];
+	int models[8];
+
+	for (int block=first; block<last; block+=8)
+	{
+		const int count = std::min( 8, last - block );
+
+		// gather into the SoA layout, padding lanes are the identity
+		for (int i=0; i<8; ++i)
+		{
+			if (i >= count)
+			{
+				for (int j=0; j<9; ++j)
+					m[j][i] = (j % 4 == 0) ? 1.0f : 0.0f;
+				continue;
+			}
+
+			models[i] = (mIndices) ? mIndices[block + i] : block + i;
+			const float *src = (const float*) ( (const char*) mTransforms + (size_t) models[i] * mTransformStride );
+
+			for (int col=0; col<3; ++col)
+				for (int row=0; row<3; ++row)
+					m[col*3+row][i] = src[col*4+row];
+		}
+
+		switch(mSimd)
+		{
+#ifdef NORMAL_MATRICES_AVX
+		case eNormalMatricesAVX:
+			ComputeBlockAVX( mView, m, n );
+			break;
+#endif
+#ifdef NORMAL_MATRICES_SSE
+		case eNormalMatricesSSE:
+			ComputeBlockSSE( mView, m, n );
+			break;
+#endif
+		default:
+			ComputeBlockScalar( mView, m, n );
+		}
+
+		// scatter into the records
+		for (int i=0; i<count; ++i)
+		{
+			float *dst = (float*) ( (char*) mRecords + (size_t) models[i] * mRecordStride );
+
+			if (mLayout == eNormalMatricesLayout3x4)
+			{
+				const float *src = (const float*) ( (const char*) mTransforms + (size_t) models[i] * mTransformStride );
+
+				for (int row=0; row<3; ++row)
+					for (int col=0; col<4; ++col)
+						dst[row*4+col] = src[col*4+row];
+
+				dst += 12;
+				for (int col=0; col<3; ++col)
+				{
+					dst[col*4] = n[col*3][i];
+					dst[col*4+1] = n[col*3+1][i];
+					dst[col*4+2] = n[col*3+2][i];
+					dst[col*4+3] = 0.0f;
+				}
+			}
+			else
+			{
+				for (int col=0; col<3; ++col)
+				{
+					dst[col*4] = n[col*3][i];
+					dst[col*4+1] = n[col*3+1][i];
+					dst[col*4+2] = n[col*3+2][i];
+					dst[col*4+3] = 0.0f;
+				}
+				dst[12] = dst[13] = dst[14] = 0.0f;
+				dst[15] = 1.0f;
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// workers
+
+void CNormalMatrices::StartWorkers( const int count )
+{
+	if ( (int) mWorkers.size() == count)
+		return;
+
+	StopWorkers();
+
+	mExit = false;
+	for (int i=0; i<count; ++i)
+		mWorkers.push_back( std::thread( &CNormalMatrices::WorkerThread, this, mGeneration ) );
+}
+
+void CNormalMatrices::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mExit = true;
+	}
+	mStartCondition.notify_all();
+
+	for (auto iter=begin(mWorkers); iter!=end(mWorkers); ++iter)
+		iter->join();
+
+	mWorkers.clear();
+}
+
+void CNormalMatrices::WorkerThread( int generation )
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+
+			while (false == mExit && mGeneration == generation)
+				mStartCondition.wait(lock);
+
+			if (mExit)
+				return;
+
+			generation = mGeneration;
+		}
+
+		ProcessChunks();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mWorkersBusy -= 1;
+		}
+		mDoneCondition.notify_one();
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include "nv_math.h"
+#include "DirtyRanges.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//
+// batched normal matrices of the model transforms
+//	normal matrix is the inverse transpose of the upper 3x3 of view * model, only the models marked as dirty are computed,
+//	they are copied into the SoA layout by 8 and processed by 4 (SSE) or 8 (AVX) at once in the parallel chunks
+//
+
+#define NORMAL_MATRICES_CHUNK_SIZE		2048	// models in one job, multiple of 8
+
+enum ENormalMatricesSimd
+{
+	eNormalMatricesScalar,
+	eNormalMatricesSSE,
+	eNormalMatricesAVX
+};
+
+// layout of the output records
+enum ENormalMatricesLayout
+{
+	eNormalMatricesLayout4x4,		// mat4 normal matrix with a zero translation
+	eNormalMatricesLayout3x4		// three rows of the affine transform, then three columns of the normal matrix (24 floats)
+};
+
+class CNormalMatrices
+{
+public:
+
+	//! a constructor
+	CNormalMatrices();
+	//! a destructor
+	~CNormalMatrices();
+
+	// all models are dirty after the resize
+	void SetNumberOfModels(const int count);
+	const int GetNumberOfModels() const
+	{
+		return mNumberOfModels;
+	}
+
+	void SetModelDirty(const int index);
+	void SetAllDirty();
+
+	const int GetNumberOfDirty() const
+	{
+		return (mAllDirty) ? mNumberOfModels : (int) mDirtyModels.size();
+	}
+
+	// 0 - use the hardware threads, 1 - compute in the calling thread only
+	void SetNumberOfThreads(const int count);
+
+	// the best supported one is used by default
+	void SetSimd(const ENormalMatricesSimd simd);
+	const ENormalMatricesSimd GetSimd() const
+	{
+		return mSimd;
+	}
+	static ENormalMatricesSimd GetSupportedSimd();
+
+	// compute normal matrices of the dirty models, every model is dirty when the view rotation or scale is changed
+	//	transforms - affine column major matrices, records - output of the layout, both strides are in bytes
+	//	updated - optional, updated models are added to the ranges
+	//	returns the number of updated models, dirty flags are cleared
+	int Update(const mat4 &view, const float *transforms, const int transformStride,
+		float *records, const int recordStride, const ENormalMatricesLayout layout, CDirtyRanges *updated=nullptr);
+
+protected:
+
+	int						mNumberOfModels;
+	bool					mAllDirty;
+	std::vector<int>		mDirtyModels;
+	std::vector<bool>		mModelDirty;
+
+	float					mView[9];		// upper 3x3 of the last view matrix, column major
+
+	ENormalMatricesSimd		mSimd;
+	int						mNumberOfThreads;
+
+	// state of the current Update call
+	const float				*mTransforms;
+	int						mTransformStride;
+	float					*mRecords;
+	int						mRecordStride;
+	ENormalMatricesLayout	mLayout;
+	const int				*mIndices;		// nullptr when all models are updated
+	int						mCount;
+
+	//
+	// persistent workers, they wait for a next Update call
+
+	std::vector<std::thread>	mWorkers;
+	std::mutex					mMutex;
+	std::condition_variable		mStartCondition;
+	std::condition_variable		mDoneCondition;
+	int							mGeneration;
+	int							mWorkersBusy;
+	bool						mExit;
+	std::atomic<int>			mNextChunk;
+
+	void		StartWorkers( const int count );
+	void		StopWorkers();
+	void		WorkerThread( int generation );
+
+	// take chunks until all of them are done
+	void		ProcessChunks();
+	void		ProcessChunk( const int chunk );
+};
@@ -0,0 +1,112 @@
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "RingAllocator.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CRingAllocator::CRingAllocator()
+{
+	Init(0);
+}
+
+void CRingAllocator::Init(const size_t capacity)
+{
+	mCapacity = capacity;
+	Clear();
+}
+
+void CRingAllocator::Clear()
+{
+	mHead = 0;
+	mTail = 0;
+	mUsed = 0;
+	mFrameBytes = 0;
+
+	mFrames.clear();
+}
+
+bool CRingAllocator::Allocate(const size_t size, const size_t alignment, size_t &offset)
+{
+	if (size == 0 || size > mCapacity)
+		return false;
+
+	// nothing in flight, start from the beginning to get the longest free block
+	//	empty frames which are not retired yet end there as well
+	if (mUsed == 0)
+	{
+		mHead = 0;
+		mTail = 0;
+
+		for (auto iter=begin(mFrames); iter!=end(mFrames); ++iter)
+			iter->end = 0;
+	}
+	else if (mHead == mTail)
+	{
+		return false;
+	}
+
+	const size_t mask = (alignment > 1) ? alignment - 1 : 0;
+	const size_t aligned = (mHead + mask) & ~mask;
+
+	size_t consumed = 0;
+
+	if (mHead < mTail)
+	{
+		// free block is between the head and the tail
+		if (aligned + size > mTail)
+			return false;
+
+		offset = aligned;
+		consumed = aligned - mHead + size;
+	}
+	else if (aligned + size <= mCapacity)
+	{
+		offset = aligned;
+		consumed = aligned - mHead + size;
+	}
+	else if (size <= mTail)
+	{
+		// the end of the ring is skipped, it goes back with the frame
+		offset = 0;
+		consumed = mCapacity - mHead + size;
+	}
+	else
+	{
+		return false;
+	}
+
+	mHead = offset + size;
+	mUsed += consumed;
+	mFrameBytes += consumed;
+
+	return true;
+}
+
+void CRingAllocator::EndFrame(void *fence)
+{
+	RingFrame frame;
+	RingFrame::Set(mHead, mFrameBytes, fence, frame);
+	mFrames.push_back(frame);
+
+	mFrameBytes = 0;
+}
+
+void CRingAllocator::RetireOldestFrame()
+{
+	if (mFrames.size() == 0)
+		return;
+
+	const RingFrame &frame = mFrames.front();
+
+	mTail = frame.end;
+	mUsed -= frame.bytes;
+
+	mFrames.pop_front();
+}
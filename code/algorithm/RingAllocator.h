@@ -0,0 +1,85 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include <stddef.h>
+#include <deque>
+
+//
+// bookkeeping of a ring of bytes shared by the frames in flight
+//	allocations of a frame go one after another from the head, a closed frame keeps its end offset and a fence,
+//	the space is given back when the oldest frame is retired (its fence is signaled), no gpu calls here
+//
+
+struct RingFrame
+{
+	size_t		end;		// head offset when the frame was closed
+	size_t		bytes;		// allocated bytes of the frame with the alignment and the wrap padding
+	void		*fence;		// user tag, GLsync of the frame
+
+	static void Set(const size_t _end, const size_t _bytes, void *_fence, RingFrame &frame)
+	{
+		frame.end = _end;
+		frame.bytes = _bytes;
+		frame.fence = _fence;
+	}
+};
+
+class CRingAllocator
+{
+public:
+
+	//! a constructor
+	CRingAllocator();
+
+	// capacity in bytes, all frames are forgotten
+	void	Init(const size_t capacity);
+	void	Clear();
+
+	// alignment is a power of two, returns false when there is no space until some frames are retired
+	bool	Allocate(const size_t size, const size_t alignment, size_t &offset);
+
+	// close allocations of the current frame
+	void	EndFrame(void *fence);
+
+	// closed frames which are not retired yet, the oldest goes first
+	const int GetNumberOfFrames() const
+	{
+		return (int) mFrames.size();
+	}
+	void	*GetOldestFence() const
+	{
+		return (mFrames.size() > 0) ? mFrames.front().fence : nullptr;
+	}
+	// give the space of the oldest closed frame back
+	void	RetireOldestFrame();
+
+	const size_t GetCapacity() const
+	{
+		return mCapacity;
+	}
+	// bytes of the frames in flight and of the current frame
+	const size_t GetUsed() const
+	{
+		return mUsed;
+	}
+	const size_t GetFrameBytes() const
+	{
+		return mFrameBytes;
+	}
+
+protected:
+
+	size_t					mCapacity;
+	size_t					mHead;			// next free byte
+	size_t					mTail;			// first byte of the oldest frame in flight
+	size_t					mUsed;
+	size_t					mFrameBytes;	// bytes of the current frame
+
+	std::deque<RingFrame>	mFrames;
+};
@@ -0,0 +1,514 @@
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "TLSFAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// bit scan helpers, value is not zero
+
+static int FindLowestBit(const unsigned int value)
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward(&index, value);
+	return (int) index;
+#else
+	return __builtin_ctz(value);
+#endif
+}
+
+static int FindHighestBit(const unsigned int value)
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanReverse(&index, value);
+	return (int) index;
+#else
+	return 31 - __builtin_clz(value);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CTLSFAllocator::CTLSFAllocator()
+{
+	Init(0);
+}
+
+void CTLSFAllocator::Init(const unsigned int capacity)
+{
+	mCapacity = capacity;
+	mUsed = 0;
+	mNumberOfAllocations = 0;
+
+	mBlocks.clear();
+	mUnusedBlocks.clear();
+	mFirstPhys = TLSF_INVALID;
+	mLastPhys = TLSF_INVALID;
+
+	mFLBitmap = 0;
+	for (int i=0; i<TLSF_FL_COUNT; ++i)
+	{
+		mSLBitmap[i] = 0;
+		for (int j=0; j<TLSF_SL_COUNT; ++j)
+			mFreeLists[i][j] = TLSF_INVALID;
+	}
+
+	if (capacity > 0)
+	{
+		const int index = NewBlock(0, capacity);
+		mFirstPhys = index;
+		mLastPhys = index;
+		InsertFree(index);
+	}
+}
+
+void CTLSFAllocator::Grow(const unsigned int capacity)
+{
+	if (capacity <= mCapacity)
+		return;
+
+	const unsigned int extra = capacity - mCapacity;
+
+	if (mLastPhys != TLSF_INVALID && mBlocks[mLastPhys].free)
+	{
+		RemoveFree(mLastPhys);
+		mBlocks[mLastPhys].size += extra;
+		InsertFree(mLastPhys);
+	}
+	else
+	{
+		const int index = NewBlock(mCapacity, extra);
+		mBlocks[index].prevPhys = mLastPhys;
+
+		if (mLastPhys != TLSF_INVALID)
+			mBlocks[mLastPhys].nextPhys = index;
+		else
+			mFirstPhys = index;
+
+		mLastPhys = index;
+		InsertFree(index);
+	}
+
+	mCapacity = capacity;
+}
+
+int CTLSFAllocator::Allocate(const unsigned int size)
+{
+	if (size == 0 || size > mCapacity - mUsed)
+		return TLSF_INVALID;
+
+	int fl, sl;
+	MappingSearch(size, fl, sl);
+
+	if (fl >= TLSF_FL_COUNT)
+		return TLSF_INVALID;
+
+	const int index = FindSuitable(fl, sl);
+	if (index == TLSF_INVALID)
+		return TLSF_INVALID;
+
+	RemoveFree(index);
+
+	// the rest goes back as a free block right after the allocation
+	if (mBlocks[index].size > size)
+	{
+		const int rest = NewBlock(mBlocks[index].offset + size, mBlocks[index].size - size);
+		const int next = mBlocks[index].nextPhys;
+
+		mBlocks[rest].prevPhys = index;
+		mBlocks[rest].nextPhys = next;
+		mBlocks[index].nextPhys = rest;
+		mBlocks[index].size = size;
+
+		if (next != TLSF_INVALID)
+			mBlocks[next].prevPhys = rest;
+		else
+			mLastPhys = rest;
+
+		InsertFree(rest);
+	}
+
+	mBlocks[index].free = false;
+	mUsed += size;
+	mNumberOfAllocations += 1;
+
+	return index;
+}
+
+void CTLSFAllocator::Free(const int handle)
+{
+	if (handle < 0 || handle >= (int) mBlocks.size() )
+		return;
+	if (false == mBlocks[handle].used || mBlocks[handle].free)
+		return;
+
+	mUsed -= mBlocks[handle].size;
+	mNumberOfAllocations -= 1;
+
+	int index = handle;
+	mBlocks[index].free = true;
+
+	const int prev = mBlocks[index].prevPhys;
+	if (prev != TLSF_INVALID && mBlocks[prev].free)
+	{
+		RemoveFree(prev);
+		Merge(prev, index);
+		index = prev;
+	}
+
+	const int next = mBlocks[index].nextPhys;
+	if (next != TLSF_INVALID && mBlocks[next].free)
+	{
+		RemoveFree(next);
+		Merge(index, next);
+	}
+
+	InsertFree(index);
+}
+
+int CTLSFAllocator::Defragment(std::vector<TLSFMove> &moves)
+{
+	moves.clear();
+
+	// used blocks are packed in the offset order, free records go to the pool
+	unsigned int cursor = 0;
+	int prevUsed = TLSF_INVALID;
+	int index = mFirstPhys;
+
+	mFirstPhys = TLSF_INVALID;
+
+	while (index != TLSF_INVALID)
+	{
+		const int next = mBlocks[index].nextPhys;
+		Block &block = mBlocks[index];
+
+		if (block.free)
+		{
+			DeleteBlock(index);
+		}
+		else
+		{
+			if (block.offset != cursor)
+			{
+				TLSFMove move;
+				TLSFMove::Set(index, block.offset, cursor, block.size, move);
+				moves.push_back(move);
+
+				block.offset = cursor;
+			}
+
+			block.prevPhys = prevUsed;
+			block.nextPhys = TLSF_INVALID;
+
+			if (prevUsed != TLSF_INVALID)
+				mBlocks[prevUsed].nextPhys = index;
+			else
+				mFirstPhys = index;
+
+			prevUsed = index;
+			cursor += block.size;
+		}
+
+		index = next;
+	}
+
+	mLastPhys = prevUsed;
+
+	mFLBitmap = 0;
+	for (int i=0; i<TLSF_FL_COUNT; ++i)
+	{
+		mSLBitmap[i] = 0;
+		for (int j=0; j<TLSF_SL_COUNT; ++j)
+			mFreeLists[i][j] = TLSF_INVALID;
+	}
+
+	// one free block at the end
+	if (cursor < mCapacity)
+	{
+		const int tail = NewBlock(cursor, mCapacity - cursor);
+		mBlocks[tail].prevPhys = mLastPhys;
+
+		if (mLastPhys != TLSF_INVALID)
+			mBlocks[mLastPhys].nextPhys = tail;
+		else
+			mFirstPhys = tail;
+
+		mLastPhys = tail;
+		InsertFree(tail);
+	}
+
+	return (int) moves.size();
+}
+
+int CTLSFAllocator::GetNumberOfFreeBlocks() const
+{
+	int count = 0;
+	for (int index=mFirstPhys; index!=TLSF_INVALID; index=mBlocks[index].nextPhys)
+	{
+		if (mBlocks[index].free)
+			count += 1;
+	}
+	return count;
+}
+
+unsigned int CTLSFAllocator::GetLargestFreeBlock() const
+{
+	if (mFLBitmap == 0)
+		return 0;
+
+	// the biggest block is in the highest non empty list
+	const int fl = FindHighestBit(mFLBitmap);
+	const int sl = FindHighestBit(mSLBitmap[fl]);
+
+	unsigned int largest = 0;
+	for (int index=mFreeLists[fl][sl]; index!=TLSF_INVALID; index=mBlocks[index].nextFree)
+	{
+		if (mBlocks[index].size > largest)
+			largest = mBlocks[index].size;
+	}
+	return largest;
+}
+
+float CTLSFAllocator::GetFragmentation() const
+{
+	const unsigned int totalFree = mCapacity - mUsed;
+	if (totalFree == 0)
+		return 0.0f;
+
+	return 1.0f - (float) GetLargestFreeBlock() / (float) totalFree;
+}
+
+bool CTLSFAllocator::Validate() const
+{
+	unsigned int offset = 0;
+	unsigned int used = 0;
+	int numberOfAllocations = 0;
+	int numberOfFree = 0;
+	int prev = TLSF_INVALID;
+
+	for (int index=mFirstPhys; index!=TLSF_INVALID; index=mBlocks[index].nextPhys)
+	{
+		const Block &block = mBlocks[index];
+
+		if (false == block.used || block.size == 0 || block.offset != offset || block.prevPhys != prev)
+			return false;
+
+		if (block.free)
+		{
+			// neighbours have to be merged
+			if (prev != TLSF_INVALID && mBlocks[prev].free)
+				return false;
+			numberOfFree += 1;
+		}
+		else
+		{
+			used += block.size;
+			numberOfAllocations += 1;
+		}
+
+		offset += block.size;
+		prev = index;
+	}
+
+	if (offset != mCapacity || prev != mLastPhys || used != mUsed || numberOfAllocations != mNumberOfAllocations)
+		return false;
+
+	// every free block is in the list of its size class
+	int numberInLists = 0;
+	for (int i=0; i<TLSF_FL_COUNT; ++i)
+	{
+		for (int j=0; j<TLSF_SL_COUNT; ++j)
+		{
+			const int head = mFreeLists[i][j];
+			const bool bit = ( (mSLBitmap[i] >> j) & 1 ) != 0;
+
+			if (bit != (head != TLSF_INVALID) )
+				return false;
+
+			int prevFree = TLSF_INVALID;
+			for (int index=head; index!=TLSF_INVALID; index=mBlocks[index].nextFree)
+			{
+				int fl, sl;
+				MappingInsert(mBlocks[index].size, fl, sl);
+
+				if (false == mBlocks[index].free || fl != i || sl != j || mBlocks[index].prevFree != prevFree)
+					return false;
+
+				prevFree = index;
+				numberInLists += 1;
+			}
+		}
+
+		if ( ( (mFLBitmap >> i) & 1 ) != (mSLBitmap[i] != 0 ? 1U : 0U) )
+			return false;
+	}
+
+	return (numberInLists == numberOfFree);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+int CTLSFAllocator::NewBlock(const unsigned int offset, const unsigned int size)
+{
+	int index;
+
+	if (mUnusedBlocks.size() > 0)
+	{
+		index = mUnusedBlocks.back();
+		mUnusedBlocks.pop_back();
+	}
+	else
+	{
+		index = (int) mBlocks.size();
+		mBlocks.push_back(Block() );
+	}
+
+	Block &block = mBlocks[index];
+	block.offset = offset;
+	block.size = size;
+	block.prevPhys = TLSF_INVALID;
+	block.nextPhys = TLSF_INVALID;
+	block.prevFree = TLSF_INVALID;
+	block.nextFree = TLSF_INVALID;
+	block.free = true;
+	block.used = true;
+
+	return index;
+}
+
+void CTLSFAllocator::DeleteBlock(const int index)
+{
+	mBlocks[index].used = false;
+	mBlocks[index].free = false;
+	mUnusedBlocks.push_back(index);
+}
+
+void CTLSFAllocator::InsertFree(const int index)
+{
+	int fl, sl;
+	MappingInsert(mBlocks[index].size, fl, sl);
+
+	const int head = mFreeLists[fl][sl];
+
+	mBlocks[index].free = true;
+	mBlocks[index].prevFree = TLSF_INVALID;
+	mBlocks[index].nextFree = head;
+
+	if (head != TLSF_INVALID)
+		mBlocks[head].prevFree = index;
+
+	mFreeLists[fl][sl] = index;
+	mFLBitmap |= (1U << fl);
+	mSLBitmap[fl] |= (1U << sl);
+}
+
+void CTLSFAllocator::RemoveFree(const int index)
+{
+	int fl, sl;
+	MappingInsert(mBlocks[index].size, fl, sl);
+
+	const int prev = mBlocks[index].prevFree;
+	const int next = mBlocks[index].nextFree;
+
+	if (next != TLSF_INVALID)
+		mBlocks[next].prevFree = prev;
+
+	if (prev != TLSF_INVALID)
+	{
+		mBlocks[prev].nextFree = next;
+	}
+	else
+	{
+		mFreeLists[fl][sl] = next;
+
+		if (next == TLSF_INVALID)
+		{
+			mSLBitmap[fl] &= ~(1U << sl);
+			if (mSLBitmap[fl] == 0)
+				mFLBitmap &= ~(1U << fl);
+		}
+	}
+
+	mBlocks[index].prevFree = TLSF_INVALID;
+	mBlocks[index].nextFree = TLSF_INVALID;
+}
+
+void CTLSFAllocator::Merge(const int a, const int b)
+{
+	const int next = mBlocks[b].nextPhys;
+
+	mBlocks[a].size += mBlocks[b].size;
+	mBlocks[a].nextPhys = next;
+
+	if (next != TLSF_INVALID)
+		mBlocks[next].prevPhys = a;
+	else
+		mLastPhys = a;
+
+	DeleteBlock(b);
+}
+
+void CTLSFAllocator::MappingInsert(const unsigned int size, int &fl, int &sl)
+{
+	if (size < TLSF_SL_COUNT)
+	{
+		// small sizes are in the first list, one size per slot
+		fl = 0;
+		sl = (int) size;
+	}
+	else
+	{
+		const int bit = FindHighestBit(size);
+		sl = (int) (size >> (bit - TLSF_SL_BITS)) ^ TLSF_SL_COUNT;
+		fl = bit - TLSF_SL_BITS + 1;
+	}
+}
+
+void CTLSFAllocator::MappingSearch(const unsigned int size, int &fl, int &sl)
+{
+	// round up to the next size class, so any block of the list fits
+	unsigned int rounded = size;
+	if (size >= TLSF_SL_COUNT)
+	{
+		const unsigned int round = (1U << (FindHighestBit(size) - TLSF_SL_BITS)) - 1;
+		if (size > 0xFFFFFFFFU - round)
+		{
+			fl = TLSF_FL_COUNT;
+			sl = 0;
+			return;
+		}
+		rounded = size + round;
+	}
+	MappingInsert(rounded, fl, sl);
+}
+
+int CTLSFAllocator::FindSuitable(int &fl, int &sl) const
+{
+	unsigned int slMap = mSLBitmap[fl] & (0xFFFFFFFFU << sl);
+
+	if (slMap == 0)
+	{
+		// next first level with any free block
+		const unsigned int flMap = (fl + 1 < 32) ? mFLBitmap & (0xFFFFFFFFU << (fl + 1)) : 0;
+		if (flMap == 0)
+			return TLSF_INVALID;
+
+		fl = FindLowestBit(flMap);
+		slMap = mSLBitmap[fl];
+	}
+
+	sl = FindLowestBit(slMap);
+	return mFreeLists[fl][sl];
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include <vector>
+
+//
+// two level segregated fit (TLSF) sub-allocator of a range of elements (vertices, indices), no memory behind it
+//	free blocks are kept in the lists by the size class (power of two and 16 linear steps inside),
+//	two bitmaps give a suitable list in constant time, a freed block is merged with its free neighbours
+//	handles are stable, defragmentation packs the used blocks to the beginning and returns the moves
+//
+
+#define TLSF_SL_BITS			4							// linear subdivisions of a power of two
+#define TLSF_SL_COUNT			(1 << TLSF_SL_BITS)
+#define TLSF_FL_COUNT			(32 - TLSF_SL_BITS + 1)
+#define TLSF_INVALID			-1
+
+struct TLSFMove
+{
+	int			handle;
+	unsigned int	from;
+	unsigned int	to;
+	unsigned int	size;
+
+	static void Set(const int _handle, const unsigned int _from, const unsigned int _to, const unsigned int _size, TLSFMove &move)
+	{
+		move.handle = _handle;
+		move.from = _from;
+		move.to = _to;
+		move.size = _size;
+	}
+};
+
+class CTLSFAllocator
+{
+public:
+
+	//! a constructor
+	CTLSFAllocator();
+
+	// capacity in elements, all allocations are forgotten
+	void	Init(const unsigned int capacity);
+	// add elements to the end, offsets of the allocations stay the same
+	void	Grow(const unsigned int capacity);
+
+	// returns a handle or TLSF_INVALID when there is no free block of the size
+	int		Allocate(const unsigned int size);
+	void	Free(const int handle);
+
+	const unsigned int GetOffset(const int handle) const
+	{
+		return mBlocks[handle].offset;
+	}
+	const unsigned int GetSize(const int handle) const
+	{
+		return mBlocks[handle].size;
+	}
+
+	// pack the used blocks, moves are in the order of the offsets (each goes to a lower offset)
+	//	returns the number of moves
+	int		Defragment(std::vector<TLSFMove> &moves);
+
+	const unsigned int GetCapacity() const
+	{
+		return mCapacity;
+	}
+	const unsigned int GetUsed() const
+	{
+		return mUsed;
+	}
+	const int GetNumberOfAllocations() const
+	{
+		return mNumberOfAllocations;
+	}
+	int		GetNumberOfFreeBlocks() const;
+	unsigned int GetLargestFreeBlock() const;
+	// 0 - all free space is in one block, close to 1 - free space is split into small blocks
+	float	GetFragmentation() const;
+
+	// physical chain and free lists are consistent, for the tests
+	bool	Validate() const;
+
+protected:
+
+	struct Block
+	{
+		unsigned int	offset;
+		unsigned int	size;
+		int				prevPhys;		// neighbours in the offset order
+		int				nextPhys;
+		int				prevFree;		// neighbours in the free list
+		int				nextFree;
+		bool			free;
+		bool			used;			// false for the unused pool records
+	};
+
+	unsigned int		mCapacity;
+	unsigned int		mUsed;
+	int					mNumberOfAllocations;
+
+	std::vector<Block>	mBlocks;
+	std::vector<int>	mUnusedBlocks;	// pool records to reuse
+	int					mFirstPhys;
+	int					mLastPhys;
+
+	unsigned int		mFLBitmap;
+	unsigned int		mSLBitmap[TLSF_FL_COUNT];
+	int					mFreeLists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+	int		NewBlock(const unsigned int offset, const unsigned int size);
+	void	DeleteBlock(const int index);
+
+	void	InsertFree(const int index);
+	void	RemoveFree(const int index);
+
+	// merge two physical neighbours, b goes away
+	void	Merge(const int a, const int b);
+
+	static void	MappingInsert(const unsigned int size, int &fl, int &sl);
+	static void	MappingSearch(const unsigned int size, int &fl, int &sl);
+	int		FindSuitable(int &fl, int &sl) const;
+};
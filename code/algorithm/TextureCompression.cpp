@@ -0,0 +1,907 @@
+
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "TextureCompression.h"
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TEXTURE_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// helpers
+
+static inline int ClampInt(const int value, const int minValue, const int maxValue)
+{
+	return (value < minValue) ? minValue : ((value > maxValue) ? maxValue : value);
+}
+
+static inline float ClampFloat(const float value, const float minValue, const float maxValue)
+{
+	return (value < minValue) ? minValue : ((value > maxValue) ? maxValue : value);
+}
+
+static inline unsigned short PackColor565(const float *color)
+{
+	const int r = ClampInt( (int) (color[0] * (31.0f / 255.0f) + 0.5f), 0, 31 );
+	const int g = ClampInt( (int) (color[1] * (63.0f / 255.0f) + 0.5f), 0, 63 );
+	const int b = ClampInt( (int) (color[2] * (31.0f / 255.0f) + 0.5f), 0, 31 );
+
+	return (unsigned short) ( (r << 11) | (g << 5) | b );
+}
+
+static inline void UnpackColor565(const unsigned short value, int *color)
+{
+	const int r = (value >> 11) & 31;
+	const int g = (value >> 5) & 63;
+	const int b = value & 31;
+
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// fourColors - c0 > c1 or the color block of BC3
+static void BuildColorPalette(const unsigned short c0, const unsigned short c1, const bool fourColors, int palette[4][3])
+{
+	UnpackColor565( c0, palette[0] );
+	UnpackColor565( c1, palette[1] );
+
+	for (int i=0; i<3; ++i)
+	{
+		if (fourColors)
+		{
+			palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+			palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+		}
+		else
+		{
+			palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+			palette[3][i] = 0;
+		}
+	}
+}
+
+// a0 > a1 - 8 interpolated values, otherwise 6 values plus 0 and 255
+static void BuildAlphaPalette(const int a0, const int a1, int *palette)
+{
+	palette[0] = a0;
+	palette[1] = a1;
+
+	if (a0 > a1)
+	{
+		for (int i=1; i<7; ++i)
+			palette[i+1] = ( (7-i) * a0 + i * a1 + 3 ) / 7;
+	}
+	else
+	{
+		for (int i=1; i<5; ++i)
+			palette[i+1] = ( (5-i) * a0 + i * a1 + 2 ) / 5;
+
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// color block
+
+struct ColorBlock
+{
+	float	r[16];
+	float	g[16];
+	float	b[16];
+};
+
+static void LoadColorBlock(const unsigned char *rgba, ColorBlock &block)
+{
+	for (int i=0; i<16; ++i)
+	{
+		block.r[i] = (float) rgba[i*4];
+		block.g[i] = (float) rgba[i*4+1];
+		block.b[i] = (float) rgba[i*4+2];
+	}
+}
+
+// nearest palette entry for each pixel, returns the total squared error
+static float FindColorIndices(const ColorBlock &block, const int palette[4][3], unsigned char *indices)
+{
+	float error = 0.0f;
+
+#ifdef TEXTURE_COMPRESSION_SSE2
+
+	__m128 paletteR[4], paletteG[4], paletteB[4];
+
+	for (int k=0; k<4; ++k)
+	{
+		paletteR[k] = _mm_set1_ps( (float) palette[k][0] );
+		paletteG[k] = _mm_set1_ps( (float) palette[k][1] );
+		paletteB[k] = _mm_set1_ps( (float) palette[k][2] );
+	}
+
+	__m128 totalError = _mm_setzero_ps();
+
+	for (int i=0; i<16; i+=4)
+	{
+		const __m128 r = _mm_loadu_ps( block.r + i );
+		const __m128 g = _mm_loadu_ps( block.g + i );
+		const __m128 b = _mm_loadu_ps( block.b + i );
+
+		__m128 best = _mm_set1_ps( FLT_MAX );
+		__m128i index = _mm_setzero_si128();
+
+		for (int k=0; k<4; ++k)
+		{
+			const __m128 dr = _mm_sub_ps( r, paletteR[k] );
+			const __m128 dg = _mm_sub_ps( g, paletteG[k] );
+			const __m128 db = _mm_sub_ps( b, paletteB[k] );
+
+			const __m128 distance = _mm_add_ps( _mm_add_ps( _mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg) ), _mm_mul_ps(db, db) );
+			const __m128i closer = _mm_castps_si128( _mm_cmplt_ps(distance, best) );
+
+			best = _mm_min_ps( distance, best );
+			index = _mm_or_si128( _mm_andnot_si128(closer, index), _mm_and_si128(closer, _mm_set1_epi32(k)) );
+		}
+
+		totalError = _mm_add_ps( totalError, best );
+
+		int lanes[4];
+		_mm_storeu_si128( (__m128i*) lanes, index );
+
+		for (int j=0; j<4; ++j)
+			indices[i+j] = (unsigned char) lanes[j];
+	}
+
+	float lanesError[4];
+	_mm_storeu_ps( lanesError, totalError );
+	error = lanesError[0] + lanesError[1] + lanesError[2] + lanesError[3];
+
+#else
+
+	for (int i=0; i<16; ++i)
+	{
+		float best = FLT_MAX;
+		indices[i] = 0;
+
+		for (int k=0; k<4; ++k)
+		{
+			const float dr = block.r[i] - (float) palette[k][0];
+			const float dg = block.g[i] - (float) palette[k][1];
+			const float db = block.b[i] - (float) palette[k][2];
+			const float distance = dr*dr + dg*dg + db*db;
+
+			if (distance < best)
+			{
+				best = distance;
+				indices[i] = (unsigned char) k;
+			}
+		}
+
+		error += best;
+	}
+#endif
+
+	return error;
+}
+
+static void ComputeColorEndpoints(const ColorBlock &block, const ETextureCompressionQuality quality, float *start, float *end)
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	float minColor[3] = { 255.0f, 255.0f, 255.0f };
+	float maxColor[3] = { 0.0f, 0.0f, 0.0f };
+
+	const float *channels[3] = { block.r, block.g, block.b };
+
+	for (int c=0; c<3; ++c)
+	{
+		for (int i=0; i<16; ++i)
+		{
+			const float value = channels[c][i];
+			mean[c] += value;
+			minColor[c] = std::min( minColor[c], value );
+			maxColor[c] = std::max( maxColor[c], value );
+		}
+		mean[c] *= (1.0f / 16.0f);
+	}
+
+	if (quality == eTextureCompressionFast)
+	{
+		// bounding box with an inset, the diagonal is flipped for channels which go against the widest one
+		int widest = 0;
+		for (int c=1; c<3; ++c)
+		{
+			if (maxColor[c] - minColor[c] > maxColor[widest] - minColor[widest])
+				widest = c;
+		}
+
+		for (int c=0; c<3; ++c)
+		{
+			const float inset = (maxColor[c] - minColor[c]) / 16.0f;
+			start[c] = maxColor[c] - inset;
+			end[c] = minColor[c] + inset;
+
+			if (c == widest)
+				continue;
+
+			float covariance = 0.0f;
+			for (int i=0; i<16; ++i)
+				covariance += (channels[widest][i] - mean[widest]) * (channels[c][i] - mean[c]);
+
+			if (covariance < 0.0f)
+				std::swap( start[c], end[c] );
+		}
+		return;
+	}
+
+	// principal axis of the colors, power iterations from the box diagonal
+	float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+	for (int i=0; i<16; ++i)
+	{
+		const float r = block.r[i] - mean[0];
+		const float g = block.g[i] - mean[1];
+		const float b = block.b[i] - mean[2];
+
+		covariance[0] += r*r;
+		covariance[1] += r*g;
+		covariance[2] += r*b;
+		covariance[3] += g*g;
+		covariance[4] += g*b;
+		covariance[5] += b*b;
+	}
+
+	float axis[3] = { maxColor[0] - minColor[0], maxColor[1] - minColor[1], maxColor[2] - minColor[2] };
+
+	for (int iter=0; iter<8; ++iter)
+	{
+		const float x = axis[0] * covariance[0] + axis[1] * covariance[1] + axis[2] * covariance[2];
+		const float y = axis[0] * covariance[1] + axis[1] * covariance[3] + axis[2] * covariance[4];
+		const float z = axis[0] * covariance[2] + axis[1] * covariance[4] + axis[2] * covariance[5];
+
+		const float norm = std::max( fabsf(x), std::max(fabsf(y), fabsf(z)) );
+		if (norm < FLT_EPSILON)
+			break;
+
+		axis[0] = x / norm;
+		axis[1] = y / norm;
+		axis[2] = z / norm;
+	}
+
+	const float length = sqrtf( axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2] );
+
+	if (length < FLT_EPSILON)
+	{
+		// solid color block
+		for (int c=0; c<3; ++c)
+			start[c] = end[c] = mean[c];
+		return;
+	}
+
+	for (int c=0; c<3; ++c)
+		axis[c] /= length;
+
+	float minProjection = FLT_MAX;
+	float maxProjection = -FLT_MAX;
+
+	for (int i=0; i<16; ++i)
+	{
+		const float projection = (block.r[i] - mean[0]) * axis[0] + (block.g[i] - mean[1]) * axis[1] + (block.b[i] - mean[2]) * axis[2];
+		minProjection = std::min( minProjection, projection );
+		maxProjection = std::max( maxProjection, projection );
+	}
+
+	for (int c=0; c<3; ++c)
+	{
+		start[c] = ClampFloat( mean[c] + axis[c] * maxProjection, 0.0f, 255.0f );
+		end[c] = ClampFloat( mean[c] + axis[c] * minProjection, 0.0f, 255.0f );
+	}
+}
+
+// least squares endpoints for the given indices (palette weights of the four color mode)
+static bool RefineColorEndpoints(const ColorBlock &block, const unsigned char *indices, float *start, float *end)
+{
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+	float ax[3] = { 0.0f, 0.0f, 0.0f };
+	float bx[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (int i=0; i<16; ++i)
+	{
+		const float a = weights[indices[i]];
+		const float b = 1.0f - a;
+
+		aa += a*a;
+		bb += b*b;
+		ab += a*b;
+
+		ax[0] += a * block.r[i];
+		ax[1] += a * block.g[i];
+		ax[2] += a * block.b[i];
+
+		bx[0] += b * block.r[i];
+		bx[1] += b * block.g[i];
+		bx[2] += b * block.b[i];
+	}
+
+	const float det = aa * bb - ab * ab;
+	if (fabsf(det) < 1e-6f)
+		return false;
+
+	const float invDet = 1.0f / det;
+
+	for (int c=0; c<3; ++c)
+	{
+		start[c] = ClampFloat( (ax[c] * bb - bx[c] * ab) * invDet, 0.0f, 255.0f );
+		end[c] = ClampFloat( (bx[c] * aa - ax[c] * ab) * invDet, 0.0f, 255.0f );
+	}
+	return true;
+}
+
+// quantize endpoints, write the four color block, returns the squared error
+static float EncodeColorBlock(const ColorBlock &block, const float *start, const float *end, unsigned char *dst, unsigned char *indices)
+{
+	unsigned short c0 = PackColor565(start);
+	unsigned short c1 = PackColor565(end);
+
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	// equal endpoints - three color mode, all pixels use the first color
+	int palette[4][3];
+	BuildColorPalette( c0, c1, true, palette );
+
+	if (c0 == c1)
+	{
+		for (int k=1; k<4; ++k)
+			memcpy( palette[k], palette[0], sizeof(int) * 3 );
+	}
+
+	const float error = FindColorIndices( block, palette, indices );
+
+	unsigned int bits = 0;
+	for (int i=0; i<16; ++i)
+		bits |= (unsigned int) indices[i] << (2*i);
+
+	dst[0] = (unsigned char) (c0 & 0xFF);
+	dst[1] = (unsigned char) (c0 >> 8);
+	dst[2] = (unsigned char) (c1 & 0xFF);
+	dst[3] = (unsigned char) (c1 >> 8);
+	dst[4] = (unsigned char) (bits & 0xFF);
+	dst[5] = (unsigned char) ((bits >> 8) & 0xFF);
+	dst[6] = (unsigned char) ((bits >> 16) & 0xFF);
+	dst[7] = (unsigned char) (bits >> 24);
+
+	return error;
+}
+
+void CompressBlockBC1(const unsigned char *rgba, const ETextureCompressionQuality quality, unsigned char *dst)
+{
+	ColorBlock block;
+	LoadColorBlock( rgba, block );
+
+	float start[3], end[3];
+	ComputeColorEndpoints( block, quality, start, end );
+
+	unsigned char indices[16];
+	float error = EncodeColorBlock( block, start, end, dst, indices );
+
+	if (quality == eTextureCompressionFast || error == 0.0f)
+		return;
+
+	unsigned char candidate[8];
+	unsigned char candidateIndices[16];
+
+	// principal axis could lose to the box diagonal on blocks with a few distinct colors
+	ComputeColorEndpoints( block, eTextureCompressionFast, start, end );
+
+	const float boxError = EncodeColorBlock( block, start, end, candidate, candidateIndices );
+	if (boxError < error)
+	{
+		error = boxError;
+		memcpy( dst, candidate, 8 );
+		memcpy( indices, candidateIndices, 16 );
+	}
+
+	if (quality == eTextureCompressionHigh)
+	{
+		for (int iter=0; iter<2 && error > 0.0f; ++iter)
+		{
+			if (false == RefineColorEndpoints( block, indices, start, end ) )
+				break;
+
+			const float candidateError = EncodeColorBlock( block, start, end, candidate, candidateIndices );
+			if (candidateError >= error)
+				break;
+
+			error = candidateError;
+			memcpy( dst, candidate, 8 );
+			memcpy( indices, candidateIndices, 16 );
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// alpha / single channel block
+
+// nearest palette entry for each value, returns the total squared error
+static int FindAlphaIndices(const unsigned char *values, const int *palette, unsigned char *indices)
+{
+#ifdef TEXTURE_COMPRESSION_SSE2
+
+	const __m128i v = _mm_loadu_si128( (const __m128i*) values );
+
+	__m128i best = _mm_set1_epi8( (char) 0xFF );
+	__m128i index = _mm_setzero_si128();
+
+	for (int k=0; k<8; ++k)
+	{
+		const __m128i p = _mm_set1_epi8( (char) palette[k] );
+		const __m128i distance = _mm_or_si128( _mm_subs_epu8(v, p), _mm_subs_epu8(p, v) );
+
+		const __m128i newBest = _mm_min_epu8( distance, best );
+		const __m128i closer = _mm_andnot_si128( _mm_cmpeq_epi8(newBest, best), _mm_set1_epi8((char) 0xFF) );
+
+		index = _mm_or_si128( _mm_andnot_si128(closer, index), _mm_and_si128(closer, _mm_set1_epi8((char) k)) );
+		best = newBest;
+	}
+
+	_mm_storeu_si128( (__m128i*) indices, index );
+
+	// sum of squares of the absolute differences
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i lo = _mm_unpacklo_epi8( best, zero );
+	const __m128i hi = _mm_unpackhi_epi8( best, zero );
+	const __m128i squares = _mm_add_epi32( _mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi) );
+
+	int lanes[4];
+	_mm_storeu_si128( (__m128i*) lanes, squares );
+
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+#else
+
+	int error = 0;
+
+	for (int i=0; i<16; ++i)
+	{
+		int best = 256;
+		indices[i] = 0;
+
+		for (int k=0; k<8; ++k)
+		{
+			const int distance = abs( (int) values[i] - palette[k] );
+			if (distance < best)
+			{
+				best = distance;
+				indices[i] = (unsigned char) k;
+			}
+		}
+
+		error += best * best;
+	}
+
+	return error;
+#endif
+}
+
+static int EncodeAlphaBlock(const unsigned char *values, const int a0, const int a1, unsigned char *dst, unsigned char *indices)
+{
+	int palette[8];
+	BuildAlphaPalette( a0, a1, palette );
+
+	const int error = FindAlphaIndices( values, palette, indices );
+
+	unsigned long long bits = 0;
+	for (int i=0; i<16; ++i)
+		bits |= (unsigned long long) indices[i] << (3*i);
+
+	dst[0] = (unsigned char) a0;
+	dst[1] = (unsigned char) a1;
+
+	for (int i=0; i<6; ++i)
+		dst[2+i] = (unsigned char) ((bits >> (8*i)) & 0xFF);
+
+	return error;
+}
+
+// least squares endpoints of the eight values mode for the given indices
+static bool RefineAlphaEndpoints(const unsigned char *values, const unsigned char *indices, int &a0, int &a1)
+{
+	static const float weights[8] = { 1.0f, 0.0f, 6.0f / 7.0f, 5.0f / 7.0f, 4.0f / 7.0f, 3.0f / 7.0f, 2.0f / 7.0f, 1.0f / 7.0f };
+
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax = 0.0f, bx = 0.0f;
+
+	for (int i=0; i<16; ++i)
+	{
+		const float a = weights[indices[i]];
+		const float b = 1.0f - a;
+
+		aa += a*a;
+		bb += b*b;
+		ab += a*b;
+		ax += a * (float) values[i];
+		bx += b * (float) values[i];
+	}
+
+	const float det = aa * bb - ab * ab;
+	if (fabsf(det) < 1e-6f)
+		return false;
+
+	a0 = ClampInt( (int) ((ax * bb - bx * ab) / det + 0.5f), 0, 255 );
+	a1 = ClampInt( (int) ((bx * aa - ax * ab) / det + 0.5f), 0, 255 );
+
+	return (a0 > a1);
+}
+
+void CompressBlockBC4(const unsigned char *values, const ETextureCompressionQuality quality, unsigned char *dst)
+{
+	int minValue = 255;
+	int maxValue = 0;
+
+	// range without the extremes for the six values mode
+	int minInner = 255;
+	int maxInner = 0;
+	bool hasExtremes = false;
+
+	for (int i=0; i<16; ++i)
+	{
+		const int value = values[i];
+
+		minValue = std::min( minValue, value );
+		maxValue = std::max( maxValue, value );
+
+		if (value == 0 || value == 255)
+		{
+			hasExtremes = true;
+		}
+		else
+		{
+			minInner = std::min( minInner, value );
+			maxInner = std::max( maxInner, value );
+		}
+	}
+
+	// eight values mode
+	unsigned char indices[16];
+	int error = EncodeAlphaBlock( values, maxValue, minValue, dst, indices );
+
+	if (error == 0 || quality == eTextureCompressionFast)
+		return;
+
+	unsigned char candidate[8];
+	unsigned char candidateIndices[16];
+
+	if (quality == eTextureCompressionHigh)
+	{
+		int a0 = maxValue;
+		int a1 = minValue;
+
+		for (int iter=0; iter<2 && error > 0; ++iter)
+		{
+			if (false == RefineAlphaEndpoints( values, indices, a0, a1 ) )
+				break;
+
+			const int candidateError = EncodeAlphaBlock( values, a0, a1, candidate, candidateIndices );
+			if (candidateError >= error)
+				break;
+
+			error = candidateError;
+			memcpy( dst, candidate, 8 );
+			memcpy( indices, candidateIndices, 16 );
+		}
+	}
+
+	// six values mode has exact 0 and 255, interpolation covers the rest
+	if (hasExtremes && error > 0)
+	{
+		const int a0 = (minInner <= maxInner) ? minInner : 0;
+		const int a1 = (minInner <= maxInner) ? maxInner : 0;
+
+		const int candidateError = EncodeAlphaBlock( values, a0, a1, candidate, candidateIndices );
+		if (candidateError < error)
+		{
+			error = candidateError;
+			memcpy( dst, candidate, 8 );
+		}
+	}
+}
+
+void CompressBlockBC3(const unsigned char *rgba, const ETextureCompressionQuality quality, unsigned char *dst)
+{
+	unsigned char alpha[16];
+	for (int i=0; i<16; ++i)
+		alpha[i] = rgba[i*4+3];
+
+	CompressBlockBC4( alpha, quality, dst );
+	CompressBlockBC1( rgba, quality, dst + 8 );
+}
+
+static void CompressBlockBC5(const unsigned char *rgba, const ETextureCompressionQuality quality, unsigned char *dst)
+{
+	unsigned char red[16];
+	unsigned char green[16];
+
+	for (int i=0; i<16; ++i)
+	{
+		red[i] = rgba[i*4];
+		green[i] = rgba[i*4+1];
+	}
+
+	CompressBlockBC4( red, quality, dst );
+	CompressBlockBC4( green, quality, dst + 8 );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// decode
+
+static void DecompressColorBlock(const unsigned char *src, const bool fourColors, unsigned char *rgba)
+{
+	const unsigned short c0 = (unsigned short) (src[0] | (src[1] << 8));
+	const unsigned short c1 = (unsigned short) (src[2] | (src[3] << 8));
+	const unsigned int bits = (unsigned int) src[4] | ((unsigned int) src[5] << 8) | ((unsigned int) src[6] << 16) | ((unsigned int) src[7] << 24);
+
+	int palette[4][3];
+	BuildColorPalette( c0, c1, fourColors || c0 > c1, palette );
+
+	for (int i=0; i<16; ++i)
+	{
+		const int index = (bits >> (2*i)) & 3;
+
+		rgba[i*4] = (unsigned char) palette[index][0];
+		rgba[i*4+1] = (unsigned char) palette[index][1];
+		rgba[i*4+2] = (unsigned char) palette[index][2];
+	}
+}
+
+static void DecompressAlphaBlock(const unsigned char *src, unsigned char *values, const int stride)
+{
+	int palette[8];
+	BuildAlphaPalette( src[0], src[1], palette );
+
+	unsigned long long bits = 0;
+	for (int i=0; i<6; ++i)
+		bits |= (unsigned long long) src[2+i] << (8*i);
+
+	for (int i=0; i<16; ++i)
+		values[i*stride] = (unsigned char) palette[ (bits >> (3*i)) & 7 ];
+}
+
+void DecompressBlock(const ETextureCompressionFormat format, const unsigned char *src, unsigned char *rgba)
+{
+	for (int i=0; i<16; ++i)
+	{
+		rgba[i*4] = rgba[i*4+1] = rgba[i*4+2] = 0;
+		rgba[i*4+3] = 255;
+	}
+
+	switch(format)
+	{
+	case eTextureCompressionBC1:
+		DecompressColorBlock( src, false, rgba );
+		break;
+	case eTextureCompressionBC3:
+		DecompressAlphaBlock( src, rgba + 3, 4 );
+		DecompressColorBlock( src + 8, true, rgba );
+		break;
+	case eTextureCompressionBC4:
+		DecompressAlphaBlock( src, rgba, 4 );
+		break;
+	case eTextureCompressionBC5:
+		DecompressAlphaBlock( src, rgba, 4 );
+		DecompressAlphaBlock( src + 8, rgba + 1, 4 );
+		break;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// images
+
+int GetCompressedBlockSize(const ETextureCompressionFormat format)
+{
+	return (format == eTextureCompressionBC1 || format == eTextureCompressionBC4) ? 8 : 16;
+}
+
+size_t GetCompressedImageSize(const ETextureCompressionFormat format, const int width, const int height)
+{
+	if (width <= 0 || height <= 0)
+		return 0;
+
+	const size_t blocksX = (size_t) (width + TEXTURE_COMPRESSION_BLOCK_SIZE - 1) / TEXTURE_COMPRESSION_BLOCK_SIZE;
+	const size_t blocksY = (size_t) (height + TEXTURE_COMPRESSION_BLOCK_SIZE - 1) / TEXTURE_COMPRESSION_BLOCK_SIZE;
+
+	return blocksX * blocksY * GetCompressedBlockSize(format);
+}
+
+// source pixel as rgba, 1 component - gray, 2 components - red and green
+static inline void LoadPixel(const unsigned char *pixel, const int components, const bool bgr, unsigned char *rgba)
+{
+	switch(components)
+	{
+	case 1:
+		rgba[0] = rgba[1] = rgba[2] = pixel[0];
+		rgba[3] = 255;
+		break;
+	case 2:
+		rgba[0] = pixel[0];
+		rgba[1] = pixel[1];
+		rgba[2] = 0;
+		rgba[3] = 255;
+		break;
+	default:
+		rgba[0] = (bgr) ? pixel[2] : pixel[0];
+		rgba[1] = pixel[1];
+		rgba[2] = (bgr) ? pixel[0] : pixel[2];
+		rgba[3] = (components == 4) ? pixel[3] : 255;
+	}
+}
+
+// 4x4 pixels, border pixels are repeated outside of the image
+static void LoadBlock(const unsigned char *src, const int width, const int height, const int components, const bool bgr,
+	const int blockX, const int blockY, unsigned char *rgba)
+{
+	for (int y=0; y<TEXTURE_COMPRESSION_BLOCK_SIZE; ++y)
+	{
+		const int sy = std::min( blockY * TEXTURE_COMPRESSION_BLOCK_SIZE + y, height - 1 );
+
+		for (int x=0; x<TEXTURE_COMPRESSION_BLOCK_SIZE; ++x)
+		{
+			const int sx = std::min( blockX * TEXTURE_COMPRESSION_BLOCK_SIZE + x, width - 1 );
+			LoadPixel( src + ((size_t) sy * width + sx) * components, components, bgr, rgba + (y * TEXTURE_COMPRESSION_BLOCK_SIZE + x) * 4 );
+		}
+	}
+}
+
+static void CompressBlockRows(const unsigned char *src, const int width, const int height, const int components, const bool bgr,
+	const ETextureCompressionFormat format, const ETextureCompressionQuality quality, unsigned char *dst, const int firstRow, const int lastRow)
+{
+	const int blocksX = (width + TEXTURE_COMPRESSION_BLOCK_SIZE - 1) / TEXTURE_COMPRESSION_BLOCK_SIZE;
+	const int blockSize = GetCompressedBlockSize(format);
+
+	unsigned char rgba[64];
+	unsigned char red[16];
+
+	for (int by=firstRow; by<lastRow; ++by)
+	{
+		unsigned char *dstBlock = dst + (size_t) by * blocksX * blockSize;
+
+		for (int bx=0; bx<blocksX; ++bx, dstBlock += blockSize)
+		{
+			LoadBlock( src, width, height, components, bgr, bx, by, rgba );
+
+			switch(format)
+			{
+			case eTextureCompressionBC1:
+				CompressBlockBC1( rgba, quality, dstBlock );
+				break;
+			case eTextureCompressionBC3:
+				CompressBlockBC3( rgba, quality, dstBlock );
+				break;
+			case eTextureCompressionBC4:
+				for (int i=0; i<16; ++i)
+					red[i] = rgba[i*4];
+				CompressBlockBC4( red, quality, dstBlock );
+				break;
+			case eTextureCompressionBC5:
+				CompressBlockBC5( rgba, quality, dstBlock );
+				break;
+			}
+		}
+	}
+}
+
+size_t CompressImage(const unsigned char *src, const int width, const int height, const int components, const bool bgr,
+	const ETextureCompressionFormat format, const ETextureCompressionQuality quality, unsigned char *dst, const int numberOfThreads)
+{
+	if (src == nullptr || dst == nullptr || width <= 0 || height <= 0 || components < 1 || components > 4)
+		return 0;
+
+	const int blocksY = (height + TEXTURE_COMPRESSION_BLOCK_SIZE - 1) / TEXTURE_COMPRESSION_BLOCK_SIZE;
+	const int threads = ClampInt( numberOfThreads, 1, blocksY );
+
+	if (threads == 1)
+	{
+		CompressBlockRows( src, width, height, components, bgr, format, quality, dst, 0, blocksY );
+	}
+	else
+	{
+		// equal ranges of block rows, the last one is compressed in the calling thread
+		const int rowsPerThread = (blocksY + threads - 1) / threads;
+		std::vector<std::thread>	workers;
+
+		int firstRow = 0;
+		for (int i=0; i<threads-1 && firstRow + rowsPerThread < blocksY; ++i, firstRow += rowsPerThread)
+		{
+			workers.push_back( std::thread( CompressBlockRows, src, width, height, components, bgr, format, quality, dst,
+				firstRow, firstRow + rowsPerThread ) );
+		}
+
+		CompressBlockRows( src, width, height, components, bgr, format, quality, dst, firstRow, blocksY );
+
+		for (auto iter=begin(workers); iter!=end(workers); ++iter)
+			iter->join();
+	}
+
+	return GetCompressedImageSize( format, width, height );
+}
+
+void DecompressImage(const unsigned char *src, const int width, const int height, const ETextureCompressionFormat format, unsigned char *rgba)
+{
+	const int blocksX = (width + TEXTURE_COMPRESSION_BLOCK_SIZE - 1) / TEXTURE_COMPRESSION_BLOCK_SIZE;
+	const int blocksY = (height + TEXTURE_COMPRESSION_BLOCK_SIZE - 1) / TEXTURE_COMPRESSION_BLOCK_SIZE;
+	const int blockSize = GetCompressedBlockSize(format);
+
+	unsigned char block[64];
+
+	for (int by=0; by<blocksY; ++by)
+	{
+		for (int bx=0; bx<blocksX; ++bx)
+		{
+			DecompressBlock( format, src + ((size_t) by * blocksX + bx) * blockSize, block );
+
+			for (int y=0; y<TEXTURE_COMPRESSION_BLOCK_SIZE; ++y)
+			{
+				const int dy = by * TEXTURE_COMPRESSION_BLOCK_SIZE + y;
+				if (dy >= height)
+					break;
+
+				const int count = std::min( TEXTURE_COMPRESSION_BLOCK_SIZE, width - bx * TEXTURE_COMPRESSION_BLOCK_SIZE );
+				memcpy( rgba + ((size_t) dy * width + bx * TEXTURE_COMPRESSION_BLOCK_SIZE) * 4, block + y * TEXTURE_COMPRESSION_BLOCK_SIZE * 4, count * 4 );
+			}
+		}
+	}
+}
+
+double ComputeCompressionPSNR(const unsigned char *src, const int width, const int height, const int components, const bool bgr,
+	const ETextureCompressionFormat format, const unsigned char *compressed)
+{
+	if (src == nullptr || compressed == nullptr || width <= 0 || height <= 0)
+		return 0.0;
+
+	std::vector<unsigned char>	decoded( (size_t) width * height * 4 );
+	DecompressImage( compressed, width, height, format, decoded.data() );
+
+	// channels stored by the format
+	int numberOfChannels = 3;
+	switch(format)
+	{
+	case eTextureCompressionBC3: numberOfChannels = 4; break;
+	case eTextureCompressionBC4: numberOfChannels = 1; break;
+	case eTextureCompressionBC5: numberOfChannels = 2; break;
+	default: break;
+	}
+
+	double sum = 0.0;
+	unsigned char rgba[4];
+
+	for (size_t i=0, count=(size_t) width * height; i<count; ++i)
+	{
+		LoadPixel( src + i * components, components, bgr, rgba );
+
+		for (int c=0; c<numberOfChannels; ++c)
+		{
+			const double diff = (double) rgba[c] - (double) decoded[i*4+c];
+			sum += diff * diff;
+		}
+	}
+
+	const double mse = sum / ((double) width * height * numberOfChannels);
+
+	// identical images
+	if (mse <= 0.0)
+		return 100.0;
+
+	return 10.0 * log10( 255.0 * 255.0 / mse );
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include <stddef.h>
+
+//
+// offline block compression of 8 bit images
+//	BC1 (rgb), BC3 (rgba), BC4 (one channel masks), BC5 (two channels, normal map xy)
+//	source pixels have 1, 2, 3 or 4 components, edge blocks are padded with the border pixels
+//	hot loops use SSE2 when it's available (x86 / x64), a scalar path otherwise
+//
+
+#define TEXTURE_COMPRESSION_BLOCK_SIZE		4		// block is 4x4 pixels
+
+enum ETextureCompressionFormat
+{
+	eTextureCompressionBC1,		// 8 bytes per block, rgb
+	eTextureCompressionBC3,		// 16 bytes per block, rgb + interpolated alpha
+	eTextureCompressionBC4,		// 8 bytes per block, red channel
+	eTextureCompressionBC5		// 16 bytes per block, red and green channels
+};
+
+enum ETextureCompressionQuality
+{
+	eTextureCompressionFast,	// bounding box endpoints
+	eTextureCompressionNormal,	// principal axis endpoints, alpha/mask blocks try both interpolation modes
+	eTextureCompressionHigh		// plus least squares (color) and brute force (alpha/mask) endpoints refinement
+};
+
+// bytes in one compressed block
+int GetCompressedBlockSize(const ETextureCompressionFormat format);
+// compressed image size in bytes, partial blocks are rounded up
+size_t GetCompressedImageSize(const ETextureCompressionFormat format, const int width, const int height);
+
+// compress 4x4 blocks, rgba - 16 pixels with 4 components each
+void CompressBlockBC1(const unsigned char *rgba, const ETextureCompressionQuality quality, unsigned char *dst);
+void CompressBlockBC3(const unsigned char *rgba, const ETextureCompressionQuality quality, unsigned char *dst);
+// values - 16 single channel values
+void CompressBlockBC4(const unsigned char *values, const ETextureCompressionQuality quality, unsigned char *dst);
+
+// decode a block into 16 rgba pixels (BC4 - value goes into r, BC5 - into r and g, other channels are 0, alpha is 255)
+void DecompressBlock(const ETextureCompressionFormat format, const unsigned char *src, unsigned char *rgba);
+
+// compress a whole image, bgr - source has a blue component first (GL_BGR, GL_BGRA)
+//	rows of blocks are split between numberOfThreads (1 - compress in the calling thread)
+//	returns the compressed size or 0 if the source is not supported
+size_t CompressImage(const unsigned char *src, const int width, const int height, const int components, const bool bgr,
+	const ETextureCompressionFormat format, const ETextureCompressionQuality quality, unsigned char *dst, const int numberOfThreads);
+
+// decode a compressed image into rgba pixels (width * height * 4)
+void DecompressImage(const unsigned char *src, const int width, const int height, const ETextureCompressionFormat format, unsigned char *rgba);
+
+// peak signal-to-noise ratio (dB) of the compressed image against the source, only the channels stored by the format are compared
+double ComputeCompressionPSNR(const unsigned char *src, const int width, const int height, const int components, const bool bgr,
+	const ETextureCompressionFormat format, const unsigned char *compressed);
@@ -0,0 +1,443 @@
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "TriangleHierarchy.h"
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#define TRIANGLE_BVH_NUMBER_OF_BINS		16
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static float BoxArea(const float *bmin, const float *bmax)
+{
+	const float dx = bmax[0] - bmin[0];
+	const float dy = bmax[1] - bmin[1];
+	const float dz = bmax[2] - bmin[2];
+
+	return 2.0f * (dx*dy + dy*dz + dz*dx);
+}
+
+static void BoxEmpty(float *bmin, float *bmax)
+{
+	bmin[0] = bmin[1] = bmin[2] = FLT_MAX;
+	bmax[0] = bmax[1] = bmax[2] = -FLT_MAX;
+}
+
+static void BoxAddBox(float *bmin, float *bmax, const float *otherMin, const float *otherMax)
+{
+	for (int k=0; k<3; ++k)
+	{
+		bmin[k] = std::min(bmin[k], otherMin[k]);
+		bmax[k] = std::max(bmax[k], otherMax[k]);
+	}
+}
+
+static void BoxAddPoint(float *bmin, float *bmax, const float *p)
+{
+	for (int k=0; k<3; ++k)
+	{
+		bmin[k] = std::min(bmin[k], p[k]);
+		bmax[k] = std::max(bmax[k], p[k]);
+	}
+}
+
+// entry distance of the ray into the box in the range [0, maxDistance]
+static bool RayBox(const float *bmin, const float *bmax, const float *origin, const float *invDir, const float maxDistance, float &tEnter)
+{
+	float tmin = 0.0f;
+	float tmax = maxDistance;
+
+	for (int k=0; k<3; ++k)
+	{
+		float t1 = (bmin[k] - origin[k]) * invDir[k];
+		float t2 = (bmax[k] - origin[k]) * invDir[k];
+
+		if (t1 > t2)
+			std::swap(t1, t2);
+
+		tmin = (t1 > tmin) ? t1 : tmin;
+		tmax = (t2 < tmax) ? t2 : tmax;
+
+		if (tmin > tmax)
+			return false;
+	}
+
+	tEnter = tmin;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CTriangleHierarchy::CTriangleHierarchy()
+{
+}
+
+void CTriangleHierarchy::Clear()
+{
+	mNodes.clear();
+	mTriangles.clear();
+}
+
+bool CTriangleHierarchy::Build(const TriangleMeshSource &source)
+{
+	Clear();
+
+	const int numberOfTriangles = source.indexCount / 3;
+	if (source.positions == nullptr || source.indices == nullptr || numberOfTriangles == 0)
+		return false;
+
+	const unsigned char *positions = (const unsigned char*) source.positions;
+	const unsigned int *indices = source.indices + source.firstIndex;
+
+	std::vector<BuildTriangle>	triangles(numberOfTriangles);
+	std::vector<int>			order(numberOfTriangles);
+
+	for (int i=0; i<numberOfTriangles; ++i)
+	{
+		BuildTriangle &tri = triangles[i];
+		BoxEmpty(tri.bmin, tri.bmax);
+
+		for (int k=0; k<3; ++k)
+			BoxAddPoint(tri.bmin, tri.bmax, (const float*) (positions + source.positionStride * indices[3*i+k]) );
+
+		for (int k=0; k<3; ++k)
+			tri.center[k] = 0.5f * (tri.bmin[k] + tri.bmax[k]);
+
+		order[i] = i;
+	}
+
+	mNodes.reserve( 2 * numberOfTriangles / TRIANGLE_BVH_MAX_LEAF_TRIANGLES + 1 );
+
+	BVHNode root;
+	memset( &root, 0, sizeof(BVHNode) );
+	mNodes.push_back(root);
+
+	BuildNode( 0, 0, numberOfTriangles, 0, triangles, order );
+
+	// leaves point into the triangles array
+	mTriangles.resize(numberOfTriangles);
+
+	for (int i=0; i<numberOfTriangles; ++i)
+	{
+		const int tri = order[i];
+		const float *p0 = (const float*) (positions + source.positionStride * indices[3*tri]);
+		const float *p1 = (const float*) (positions + source.positionStride * indices[3*tri+1]);
+		const float *p2 = (const float*) (positions + source.positionStride * indices[3*tri+2]);
+
+		TriangleRecord &record = mTriangles[i];
+
+		for (int k=0; k<3; ++k)
+		{
+			record.v0[k] = p0[k];
+			record.e1[k] = p1[k] - p0[k];
+			record.e2[k] = p2[k] - p0[k];
+		}
+		record.firstIndex = source.firstIndex + 3 * tri;
+	}
+
+	return true;
+}
+
+void CTriangleHierarchy::BuildNode(const int nodeIndex, const int first, const int count, const int depth,
+		const std::vector<BuildTriangle> &triangles, std::vector<int> &order)
+{
+	float bmin[3], bmax[3];
+	float cmin[3], cmax[3];
+
+	BoxEmpty(bmin, bmax);
+	BoxEmpty(cmin, cmax);
+
+	for (int i=first; i<first+count; ++i)
+	{
+		const BuildTriangle &tri = triangles[order[i]];
+		BoxAddBox(bmin, bmax, tri.bmin, tri.bmax);
+		BoxAddPoint(cmin, cmax, tri.center);
+	}
+
+	{
+		BVHNode &node = mNodes[nodeIndex];
+		memcpy( node.bmin, bmin, sizeof(float) * 3 );
+		memcpy( node.bmax, bmax, sizeof(float) * 3 );
+	}
+
+	if (count <= TRIANGLE_BVH_MAX_LEAF_TRIANGLES)
+	{
+		mNodes[nodeIndex].first = first;
+		mNodes[nodeIndex].count = count;
+		return;
+	}
+
+	int axis = 0;
+	for (int k=1; k<3; ++k)
+		if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis])
+			axis = k;
+
+	const float extent = cmax[axis] - cmin[axis];
+	int middle = first;
+
+	if (extent > 0.0f && depth < TRIANGLE_BVH_MAX_DEPTH)
+	{
+		int		binCount[TRIANGLE_BVH_NUMBER_OF_BINS];
+		float	binMin[TRIANGLE_BVH_NUMBER_OF_BINS][3];
+		float	binMax[TRIANGLE_BVH_NUMBER_OF_BINS][3];
+
+		for (int b=0; b<TRIANGLE_BVH_NUMBER_OF_BINS; ++b)
+		{
+			binCount[b] = 0;
+			BoxEmpty(binMin[b], binMax[b]);
+		}
+
+		const float minValue = cmin[axis];
+		const float binScale = (float) TRIANGLE_BVH_NUMBER_OF_BINS / extent;
+
+		for (int i=first; i<first+count; ++i)
+		{
+			const BuildTriangle &tri = triangles[order[i]];
+			const int b = std::min( TRIANGLE_BVH_NUMBER_OF_BINS - 1, (int) ((tri.center[axis] - minValue) * binScale) );
+
+			binCount[b] += 1;
+			BoxAddBox(binMin[b], binMax[b], tri.bmin, tri.bmax);
+		}
+
+		float	rightCost[TRIANGLE_BVH_NUMBER_OF_BINS];
+		float	accMin[3], accMax[3];
+		int		accCount = 0;
+
+		BoxEmpty(accMin, accMax);
+		for (int b=TRIANGLE_BVH_NUMBER_OF_BINS-1; b>0; --b)
+		{
+			accCount += binCount[b];
+			if (binCount[b] > 0)
+				BoxAddBox(accMin, accMax, binMin[b], binMax[b]);
+
+			rightCost[b] = (accCount > 0) ? BoxArea(accMin, accMax) * (float) accCount : 0.0f;
+		}
+
+		float bestCost = FLT_MAX;
+		int bestPlane = -1;
+
+		BoxEmpty(accMin, accMax);
+		accCount = 0;
+
+		for (int b=0; b<TRIANGLE_BVH_NUMBER_OF_BINS-1; ++b)
+		{
+			accCount += binCount[b];
+			if (binCount[b] > 0)
+				BoxAddBox(accMin, accMax, binMin[b], binMax[b]);
+
+			if (accCount == 0 || accCount == count)
+				continue;
+
+			const float cost = BoxArea(accMin, accMax) * (float) accCount + rightCost[b+1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestPlane = b;
+			}
+		}
+
+		if (bestPlane >= 0)
+		{
+			int *itemsBegin = order.data() + first;
+
+			int *split = std::partition( itemsBegin, itemsBegin + count, [&triangles, axis, minValue, binScale, bestPlane](const int tri) {
+				const int b = std::min( TRIANGLE_BVH_NUMBER_OF_BINS - 1, (int) ((triangles[tri].center[axis] - minValue) * binScale) );
+				return (b <= bestPlane);
+			} );
+
+			middle = first + (int) (split - itemsBegin);
+		}
+	}
+
+	// too deep or no good plane, split by the median of the centers
+	if (middle == first || middle == first + count)
+	{
+		middle = first + count / 2;
+
+		std::nth_element( order.begin() + first, order.begin() + middle, order.begin() + first + count, [&triangles, axis](const int a, const int b) {
+			return triangles[a].center[axis] < triangles[b].center[axis];
+		} );
+	}
+
+	const int left = (int) mNodes.size();
+
+	BVHNode child;
+	memset( &child, 0, sizeof(BVHNode) );
+	mNodes.push_back(child);
+	mNodes.push_back(child);
+
+	mNodes[nodeIndex].first = left;
+	mNodes[nodeIndex].count = 0;
+
+	BuildNode( left, first, middle - first, depth + 1, triangles, order );
+	BuildNode( left + 1, middle, first + count - middle, depth + 1, triangles, order );
+}
+
+bool CTriangleHierarchy::IntersectRay(const vec3 &origin, const vec3 &dir, const float maxDistance, TriangleRayHit &hit) const
+{
+	TriangleRayHit::Clear(hit);
+
+	if (mNodes.size() == 0)
+		return false;
+
+	const float *o = origin.vec_array;
+	const float *d = dir.vec_array;
+	const float invDir[3] = { 1.0f / d[0], 1.0f / d[1], 1.0f / d[2] };
+
+	float best = maxDistance;
+
+	// median splits below the depth limit keep the tree depth under the stack size
+	int		stackNode[2 * TRIANGLE_BVH_MAX_DEPTH];
+	float	stackDistance[2 * TRIANGLE_BVH_MAX_DEPTH];
+	int		stackSize = 0;
+
+	float tRoot;
+	if (RayBox(mNodes[0].bmin, mNodes[0].bmax, o, invDir, best, tRoot) )
+	{
+		stackNode[0] = 0;
+		stackDistance[0] = tRoot;
+		stackSize = 1;
+	}
+
+	while (stackSize > 0)
+	{
+		stackSize -= 1;
+		if (stackDistance[stackSize] > best)
+			continue;
+
+		const BVHNode &node = mNodes[stackNode[stackSize]];
+
+		if (node.count == 0)
+		{
+			const BVHNode &left = mNodes[node.first];
+			const BVHNode &right = mNodes[node.first + 1];
+
+			float tLeft, tRight;
+			const bool hitLeft = RayBox(left.bmin, left.bmax, o, invDir, best, tLeft);
+			const bool hitRight = RayBox(right.bmin, right.bmax, o, invDir, best, tRight);
+
+			// the nearer child is on the top
+			if (hitLeft && hitRight && tLeft > tRight)
+			{
+				stackNode[stackSize] = node.first;
+				stackDistance[stackSize++] = tLeft;
+				stackNode[stackSize] = node.first + 1;
+				stackDistance[stackSize++] = tRight;
+			}
+			else
+			{
+				if (hitRight)
+				{
+					stackNode[stackSize] = node.first + 1;
+					stackDistance[stackSize++] = tRight;
+				}
+				if (hitLeft)
+				{
+					stackNode[stackSize] = node.first;
+					stackDistance[stackSize++] = tLeft;
+				}
+			}
+			continue;
+		}
+
+		for (int i=node.first; i<node.first+node.count; ++i)
+		{
+			const TriangleRecord &tri = mTriangles[i];
+
+			// Moller - Trumbore
+			const float px = d[1] * tri.e2[2] - d[2] * tri.e2[1];
+			const float py = d[2] * tri.e2[0] - d[0] * tri.e2[2];
+			const float pz = d[0] * tri.e2[1] - d[1] * tri.e2[0];
+
+			const float det = tri.e1[0] * px + tri.e1[1] * py + tri.e1[2] * pz;
+			if (det == 0.0f)
+				continue;
+
+			const float invDet = 1.0f / det;
+
+			const float sx = o[0] - tri.v0[0];
+			const float sy = o[1] - tri.v0[1];
+			const float sz = o[2] - tri.v0[2];
+
+			const float u = (sx * px + sy * py + sz * pz) * invDet;
+			if (u < 0.0f || u > 1.0f)
+				continue;
+
+			const float qx = sy * tri.e1[2] - sz * tri.e1[1];
+			const float qy = sz * tri.e1[0] - sx * tri.e1[2];
+			const float qz = sx * tri.e1[1] - sy * tri.e1[0];
+
+			const float v = (d[0] * qx + d[1] * qy + d[2] * qz) * invDet;
+			if (v < 0.0f || u + v > 1.0f)
+				continue;
+
+			const float t = (tri.e2[0] * qx + tri.e2[1] * qy + tri.e2[2] * qz) * invDet;
+			if (t < 0.0f || t > best)
+				continue;
+
+			// the lowest index wins for equal distances, so the result doesn't depend on the tree
+			if (t == best && hit.triangle >= 0 && tri.firstIndex > hit.triangle)
+				continue;
+
+			best = t;
+			hit.triangle = tri.firstIndex;
+			hit.u = u;
+			hit.v = v;
+			hit.distance = t;
+		}
+	}
+
+	return (hit.triangle >= 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+void BuildTriangleHierarchies(const TriangleMeshSource *sources, CTriangleHierarchy * const *hierarchies, const int count, const int numberOfThreads)
+{
+	int threads = (numberOfThreads > 0) ? numberOfThreads : (int) std::thread::hardware_concurrency();
+	threads = std::max( 1, std::min(threads, count) );
+
+	// bigger meshes go first, so the threads finish at the same time
+	std::vector<int>	order(count);
+	for (int i=0; i<count; ++i)
+		order[i] = i;
+
+	std::sort( begin(order), end(order), [sources](const int a, const int b) {
+		return sources[a].indexCount > sources[b].indexCount;
+	} );
+
+	std::atomic<int>	nextMesh(0);
+
+	auto fn_build = [sources, hierarchies, count, &order, &nextMesh] () {
+		for (;;)
+		{
+			const int index = nextMesh.fetch_add(1);
+			if (index >= count)
+				break;
+
+			hierarchies[order[index]]->Build( sources[order[index]] );
+		}
+	};
+
+	std::vector<std::thread>	workers;
+	for (int i=1; i<threads; ++i)
+		workers.push_back( std::thread(fn_build) );
+
+	fn_build();
+
+	for (auto iter=begin(workers); iter!=end(workers); ++iter)
+		iter->join();
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include "nv_math.h"
+#include "BoundingVolumeHierarchy.h"
+
+#include <vector>
+
+//
+// triangle level hierarchy of one mesh for the ray casting (picking and snapping)
+//	binned SAH tree over the triangles of an index range, triangles are copied into the leaf order,
+//	so a ray doesn't touch the source vertex and index arrays
+//
+
+#define TRIANGLE_BVH_MAX_LEAF_TRIANGLES		4
+#define TRIANGLE_BVH_MAX_DEPTH				64	// deeper nodes are split in half, traversal stack is limited by it
+
+struct TriangleRayHit
+{
+	int			triangle;		// first index of the triangle in the index buffer
+	float		u;				// barycentric weights of the second and the third vertex
+	float		v;
+	float		distance;		// in the units of the ray direction length
+
+	static void Clear(TriangleRayHit &hit)
+	{
+		hit.triangle = -1;
+		hit.u = hit.v = 0.0f;
+		hit.distance = 0.0f;
+	}
+};
+
+// index range of the source arrays, positions are xyz floats with a given stride in bytes
+struct TriangleMeshSource
+{
+	const float				*positions;
+	int						positionStride;
+	const unsigned int		*indices;
+	int						firstIndex;
+	int						indexCount;
+
+	static void Set(const float *_positions, const int _stride, const unsigned int *_indices, const int _firstIndex, const int _indexCount,
+		TriangleMeshSource &source)
+	{
+		source.positions = _positions;
+		source.positionStride = _stride;
+		source.indices = _indices;
+		source.firstIndex = _firstIndex;
+		source.indexCount = _indexCount;
+	}
+};
+
+class CTriangleHierarchy
+{
+public:
+
+	//! a constructor
+	CTriangleHierarchy();
+
+	bool	Build(const TriangleMeshSource &source);
+	void	Clear();
+
+	const int GetNumberOfTriangles() const
+	{
+		return (int) mTriangles.size();
+	}
+	const int GetNumberOfNodes() const
+	{
+		return (int) mNodes.size();
+	}
+	const size_t GetMemorySize() const
+	{
+		return sizeof(BVHNode) * mNodes.size() + sizeof(TriangleRecord) * mTriangles.size();
+	}
+
+	// nearest triangle (both sides) hit in the range [0, maxDistance], dir doesn't have to be normalized
+	bool	IntersectRay(const vec3 &origin, const vec3 &dir, const float maxDistance, TriangleRayHit &hit) const;
+
+protected:
+
+	// first vertex and two edges
+	struct TriangleRecord
+	{
+		float			v0[3];
+		float			e1[3];
+		float			e2[3];
+		int				firstIndex;
+	};
+
+	std::vector<BVHNode>			mNodes;
+	std::vector<TriangleRecord>		mTriangles;		// in the leaf order
+
+	// build data
+	struct BuildTriangle
+	{
+		float		bmin[3];
+		float		bmax[3];
+		float		center[3];
+	};
+
+	void	BuildNode(const int nodeIndex, const int first, const int count, const int depth,
+		const std::vector<BuildTriangle> &triangles, std::vector<int> &order);
+};
+
+// build hierarchies of a number of meshes in parallel, 0 - use the hardware threads
+void BuildTriangleHierarchies(const TriangleMeshSource *sources, CTriangleHierarchy * const *hierarchies, const int count, const int numberOfThreads);
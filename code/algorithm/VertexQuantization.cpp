@@ -0,0 +1,305 @@
+
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+
+*/
+
+#include "VertexQuantization.h"
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// half float
+
+unsigned short FloatToHalf(const float value)
+{
+	unsigned int f;
+	memcpy( &f, &value, sizeof(float) );
+
+	const unsigned int sign = (f >> 16) & 0x8000;
+	const unsigned int exponent = (f >> 23) & 0xff;
+	unsigned int mantissa = f & 0x7fffff;
+
+	// inf or nan
+	if (exponent == 0xff)
+		return (unsigned short) (sign | 0x7c00 | ((mantissa) ? (0x200 | (mantissa >> 13)) : 0));
+
+	const int e = (int) exponent - 127 + 15;
+
+	// overflow
+	if (e >= 0x1f)
+		return (unsigned short) (sign | 0x7c00);
+
+	// denormal or zero
+	if (e <= 0)
+	{
+		if (e < -10)
+			return (unsigned short) sign;
+
+		mantissa |= 0x800000;
+
+		const unsigned int shift = (unsigned int) (14 - e);
+		unsigned int h = mantissa >> shift;
+		const unsigned int rem = mantissa & ((1U << shift) - 1);
+		const unsigned int halfway = 1U << (shift - 1);
+
+		if (rem > halfway || (rem == halfway && (h & 1)))
+			h += 1;
+
+		return (unsigned short) (sign | h);
+	}
+
+	unsigned int h = ((unsigned int) e << 10) | (mantissa >> 13);
+	const unsigned int rem = mantissa & 0x1fff;
+
+	// rounding could carry into the exponent, that is correct (up to inf)
+	if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+		h += 1;
+
+	return (unsigned short) (sign | h);
+}
+
+float HalfToFloat(const unsigned short value)
+{
+	const unsigned int sign = ((unsigned int) value & 0x8000) << 16;
+	const unsigned int exponent = ((unsigned int) value >> 10) & 0x1f;
+	unsigned int mantissa = (unsigned int) value & 0x3ff;
+
+	unsigned int f;
+
+	if (exponent == 0)
+	{
+		if (mantissa == 0)
+		{
+			f = sign;
+		}
+		else
+		{
+			// normalize the denormal
+			int e = -1;
+			do {
+				e += 1;
+				mantissa <<= 1;
+			} while ( 0 == (mantissa & 0x400) );
+
+			mantissa &= 0x3ff;
+			f = sign | ((unsigned int) (127 - 15 - e) << 23) | (mantissa << 13);
+		}
+	}
+	else if (exponent == 0x1f)
+	{
+		f = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else
+	{
+		f = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy( &result, &f, sizeof(float) );
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// octahedral mapping
+
+static float SignNotZero(const float value)
+{
+	return (value >= 0.0f) ? 1.0f : -1.0f;
+}
+
+static short FloatToSnorm16(const float value)
+{
+	float v = (value < -1.0f) ? -1.0f : ( (value > 1.0f) ? 1.0f : value );
+	v = v * 32767.0f;
+	return (short) ( (v >= 0.0f) ? floorf(v + 0.5f) : ceilf(v - 0.5f) );
+}
+
+static float Snorm16ToFloat(const short value)
+{
+	const float v = (float) value / 32767.0f;
+	return (v < -1.0f) ? -1.0f : v;
+}
+
+void OctEncode(const float *v, short *oct)
+{
+	const float l1 = fabsf(v[0]) + fabsf(v[1]) + fabsf(v[2]);
+
+	if (l1 < FLT_MIN)
+	{
+		oct[0] = 0;
+		oct[1] = 0;
+		return;
+	}
+
+	float x = v[0] / l1;
+	float y = v[1] / l1;
+
+	// fold the lower hemisphere
+	if (v[2] < 0.0f)
+	{
+		const float tx = (1.0f - fabsf(y)) * SignNotZero(x);
+		const float ty = (1.0f - fabsf(x)) * SignNotZero(y);
+		x = tx;
+		y = ty;
+	}
+
+	oct[0] = FloatToSnorm16(x);
+	oct[1] = FloatToSnorm16(y);
+}
+
+void OctDecode(const short *oct, float *v)
+{
+	float x = Snorm16ToFloat(oct[0]);
+	float y = Snorm16ToFloat(oct[1]);
+	const float z = 1.0f - fabsf(x) - fabsf(y);
+
+	if (z < 0.0f)
+	{
+		const float tx = (1.0f - fabsf(y)) * SignNotZero(x);
+		const float ty = (1.0f - fabsf(x)) * SignNotZero(y);
+		x = tx;
+		y = ty;
+	}
+
+	const float len = sqrtf(x*x + y*y + z*z);
+	const float invlen = (len > 0.0f) ? 1.0f / len : 0.0f;
+
+	v[0] = x * invlen;
+	v[1] = y * invlen;
+	v[2] = z * invlen;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// streams
+
+void ComputePointsBounds(const float *points, const int stride, const int count, float *bmin, float *bsize)
+{
+	if (points == nullptr || count <= 0)
+	{
+		for (int k=0; k<3; ++k)
+		{
+			bmin[k] = 0.0f;
+			bsize[k] = 0.0f;
+		}
+		return;
+	}
+
+	float bmax[3];
+	for (int k=0; k<3; ++k)
+	{
+		bmin[k] = points[k];
+		bmax[k] = points[k];
+	}
+
+	const unsigned char *ptr = (const unsigned char*) points;
+	for (int i=1; i<count; ++i)
+	{
+		const float *p = (const float*) (ptr + (size_t) i * stride);
+		for (int k=0; k<3; ++k)
+		{
+			if (p[k] < bmin[k]) bmin[k] = p[k];
+			if (p[k] > bmax[k]) bmax[k] = p[k];
+		}
+	}
+
+	for (int k=0; k<3; ++k)
+		bsize[k] = bmax[k] - bmin[k];
+}
+
+void QuantizePositions(const float *points, const int stride, const int count, const float *bmin, const float *bsize, unsigned short *dst)
+{
+	float scale[3];
+	for (int k=0; k<3; ++k)
+		scale[k] = (bsize[k] > 0.0f) ? 65535.0f / bsize[k] : 0.0f;
+
+	const unsigned char *ptr = (const unsigned char*) points;
+	for (int i=0; i<count; ++i, dst += 4)
+	{
+		const float *p = (const float*) (ptr + (size_t) i * stride);
+		for (int k=0; k<3; ++k)
+		{
+			float q = floorf( (p[k] - bmin[k]) * scale[k] + 0.5f );
+			q = (q < 0.0f) ? 0.0f : ( (q > 65535.0f) ? 65535.0f : q );
+			dst[k] = (unsigned short) q;
+		}
+		dst[3] = 0;
+	}
+}
+
+void QuantizeNormals(const float *normals, const int stride, const int count, short *dst)
+{
+	const unsigned char *ptr = (const unsigned char*) normals;
+	for (int i=0; i<count; ++i, dst += 2)
+	{
+		OctEncode( (const float*) (ptr + (size_t) i * stride), dst );
+	}
+}
+
+void QuantizeTangents(const float *tangents, const int stride, const int count, short *dst)
+{
+	const unsigned char *ptr = (const unsigned char*) tangents;
+	for (int i=0; i<count; ++i, dst += 2)
+	{
+		const float *t = (const float*) (ptr + (size_t) i * stride);
+		OctEncode( t, dst );
+
+		const short flip = (stride >= 4 * (int) sizeof(float) && t[3] < 0.0f) ? 1 : 0;
+		dst[1] = (short) ( (dst[1] & ~1) | flip );
+	}
+}
+
+void QuantizeUVs(const float *uvs, const int stride, const int count, unsigned short *dst)
+{
+	const unsigned char *ptr = (const unsigned char*) uvs;
+	for (int i=0; i<count; ++i, dst += 2)
+	{
+		const float *uv = (const float*) (ptr + (size_t) i * stride);
+		dst[0] = FloatToHalf(uv[0]);
+		dst[1] = FloatToHalf(uv[1]);
+	}
+}
+
+void DequantizePositions(const unsigned short *src, const int count, const float *bmin, const float *bsize, float *dst)
+{
+	const float scale[3] = { bsize[0] / 65535.0f, bsize[1] / 65535.0f, bsize[2] / 65535.0f };
+
+	for (int i=0; i<count; ++i, src += 4, dst += 4)
+	{
+		dst[0] = bmin[0] + scale[0] * (float) src[0];
+		dst[1] = bmin[1] + scale[1] * (float) src[1];
+		dst[2] = bmin[2] + scale[2] * (float) src[2];
+		dst[3] = 1.0f;
+	}
+}
+
+void DequantizeNormals(const short *src, const int count, float *dst)
+{
+	for (int i=0; i<count; ++i, src += 2, dst += 4)
+	{
+		OctDecode( src, dst );
+		dst[3] = 0.0f;
+	}
+}
+
+void DequantizeTangents(const short *src, const int count, float *dst)
+{
+	for (int i=0; i<count; ++i, src += 2, dst += 4)
+	{
+		OctDecode( src, dst );
+		dst[3] = (src[1] & 1) ? -1.0f : 1.0f;
+	}
+}
+
+void DequantizeUVs(const unsigned short *src, const int count, float *dst)
+{
+	for (int i=0; i<count; ++i, src += 2, dst += 2)
+	{
+		dst[0] = HalfToFloat(src[0]);
+		dst[1] = HalfToFloat(src[1]);
+	}
+}
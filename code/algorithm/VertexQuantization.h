@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+	Author Sergey Solokhin (Neill3d)
+
+    GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+//
+// compact vertex streams
+//	positions - 16 bit unorm per component, normalized to the model bounding box
+//	normals, tangents - octahedral mapping into two 16 bit snorm components
+//	uvs - two half floats
+//
+
+// half float <-> float (round to nearest even, inf/nan and denormals are kept)
+unsigned short FloatToHalf(const float value);
+float HalfToFloat(const unsigned short value);
+
+// unit vector -> 2 snorm16 components
+void OctEncode(const float *v, short *oct);
+// 2 snorm16 components -> unit vector (xyz)
+void OctDecode(const short *oct, float *v);
+
+// compute min and size (max - min) of xyz for an array of points with a given stride in bytes
+void ComputePointsBounds(const float *points, const int stride, const int count, float *bmin, float *bsize);
+
+// streams encode, source arrays are with a given stride in bytes
+
+// 4 unsigned shorts per point (xyz + unused w)
+void QuantizePositions(const float *points, const int stride, const int count, const float *bmin, const float *bsize, unsigned short *dst);
+// 2 shorts per normal
+void QuantizeNormals(const float *normals, const int stride, const int count, short *dst);
+// 2 shorts per tangent, sign of w (handedness) goes into the lowest bit of the second component
+void QuantizeTangents(const float *tangents, const int stride, const int count, short *dst);
+// 2 half floats per uv
+void QuantizeUVs(const float *uvs, const int stride, const int count, unsigned short *dst);
+
+// streams decode into float4 (w = 1.0 for points, 0.0 for normals, +-1.0 for tangents) and float2 arrays
+
+void DequantizePositions(const unsigned short *src, const int count, const float *bmin, const float *bsize, float *dst);
+void DequantizeNormals(const short *src, const int count, float *dst);
+void DequantizeTangents(const short *src, const int count, float *dst);
+void DequantizeUVs(const unsigned short *src, const int count, float *dst);
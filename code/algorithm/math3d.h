@@ -43,7 +43,7 @@ public:
 	bool SphereInFrustum( float f_x, float f_y, float f_z, float f_radius ) const;
 	bool BoxInFrustum( float f_min_x, float f_min_y, float f_min_z, float f_max_x, float f_max_y, float f_max_z);
 
-	const float *GetFrustumPlane(const int index)
+	const float *GetFrustumPlane(const int index) const
 	{
 		return &m_ppfFrustum[index][0];
 	}
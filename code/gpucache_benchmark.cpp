@@ -0,0 +1,1657 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_benchmark.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_benchmark.h"
+#include "gpucache_loaderPipelined.h"
+#include "gpucache_vertexMerge.h"
+#include "gpucache_manifest.h"
+#include "algorithm/BoundingVolumeHierarchy.h"
+#include "algorithm/TriangleHierarchy.h"
+#include "IO/FileIO.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// read one byte from each page of the image and vertex data
+#define BENCHMARK_PAGE_STEP		4096
+
+// distance between the model grids
+#define SYNTHETIC_MODEL_SPACING	12.0f
+#define SYNTHETIC_MODEL_SIZE	10.0f
+
+typedef std::chrono::high_resolution_clock	BenchmarkClock;
+
+static double ElapsedMs( const BenchmarkClock::time_point &start )
+{
+	return std::chrono::duration<double, std::milli>( BenchmarkClock::now() - start ).count();
+}
+
+static unsigned int TouchPages( const BYTE *data, const size_t size )
+{
+	unsigned int sum = 0;
+	for (size_t i=0; i<size; i+=BENCHMARK_PAGE_STEP)
+		sum += data[i];
+
+	if (size > 0)
+		sum += data[size-1];
+
+	return sum;
+}
+
+size_t GetBenchmarkFileSize( const char *filename )
+{
+	FILE *fp = nullptr;
+	if (0 != fopen_s( &fp, filename, "rb" ) || fp == nullptr)
+		return 0;
+
+	_fseeki64( fp, 0, SEEK_END );
+	const int64_t size = _ftelli64( fp );
+	fclose(fp);
+
+	return (size > 0) ? (size_t) size : 0;
+}
+
+std::string MakeBenchmarkPackFilename( const char *filename, const char *suffix )
+{
+	std::string packFilename( filename );
+
+	auto iter = packFilename.find_last_of( "." );
+	if (iter != std::string::npos)
+		packFilename.erase( iter );
+	packFilename.append( suffix );
+
+	return packFilename;
+}
+
+void MakeBenchmarkView( const GPUCacheSyntheticOptions &options, const bool lowView, unsigned int &state, float *projection, float *modelview, float *eye )
+{
+	const int modelsPerRow = std::max(1, (int) ceil( sqrt( (double) options.numberOfModels ) ) );
+	const float sceneSize = (float) modelsPerRow * SYNTHETIC_MODEL_SPACING;
+
+	float rnd[5];
+	for (int i=0; i<5; ++i)
+	{
+		state = state * 1664525u + 1013904223u;
+		rnd[i] = (float) (state >> 8) / 16777216.0f;
+	}
+
+	eye[0] = rnd[0] * sceneSize;
+	eye[1] = (lowView) ? 0.3f + rnd[1] * 1.5f : 5.0f + rnd[1] * 30.0f;
+	eye[2] = rnd[2] * sceneSize;
+
+	const float target[3] = { rnd[3] * sceneSize, 0.0f, rnd[4] * sceneSize };
+
+	// perspective, 57 degrees vertical fov, 16:9
+	const float zNear = 0.1f;
+	const float zFar = 1000.0f;
+	const float t = 1.0f / tanf(0.5f);
+
+	memset( projection, 0, sizeof(float) * 16 );
+	projection[0] = t * 9.0f / 16.0f;
+	projection[5] = t;
+	projection[10] = (zFar + zNear) / (zNear - zFar);
+	projection[11] = -1.0f;
+	projection[14] = 2.0f * zFar * zNear / (zNear - zFar);
+
+	// look at with the y up
+	vec3 f( target[0]-eye[0], target[1]-eye[1], target[2]-eye[2] );
+	normalize(f);
+	vec3 s;
+	cross( s, f, vec3(0.0f, 1.0f, 0.0f) );
+	normalize(s);
+	vec3 u;
+	cross( u, s, f );
+
+	memset( modelview, 0, sizeof(float) * 16 );
+	modelview[0] = s.x;		modelview[4] = s.y;		modelview[8] = s.z;
+	modelview[1] = u.x;		modelview[5] = u.y;		modelview[9] = u.z;
+	modelview[2] = -f.x;	modelview[6] = -f.y;	modelview[10] = -f.z;
+	modelview[12] = -(s.x*eye[0] + s.y*eye[1] + s.z*eye[2]);
+	modelview[13] = -(u.x*eye[0] + u.y*eye[1] + u.z*eye[2]);
+	modelview[14] = f.x*eye[0] + f.y*eye[1] + f.z*eye[2];
+	modelview[15] = 1.0f;
+}
+
+size_t GetPeakProcessMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS		counters;
+	if (GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof(counters) ) )
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	if (0 == getrusage( RUSAGE_SELF, &usage ) )
+		return (size_t) usage.ru_maxrss * 1024;	// kilobytes on linux
+	return 0;
+#endif
+}
+
+size_t GetCurrentProcessMemory(size_t *privateMemory)
+{
+	size_t workingSet = 0;
+	size_t privateSet = 0;
+
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS_EX	counters;
+	if (GetProcessMemoryInfo( GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*) &counters, sizeof(counters) ) )
+	{
+		workingSet = counters.WorkingSetSize;
+		privateSet = counters.PrivateUsage;
+	}
+#else
+	FILE *fp = fopen( "/proc/self/statm", "r" );
+	if (fp != nullptr)
+	{
+		unsigned long totalPages = 0;
+		unsigned long residentPages = 0;
+		unsigned long sharedPages = 0;		// file backed
+
+		if (3 == fscanf( fp, "%lu %lu %lu", &totalPages, &residentPages, &sharedPages ) )
+		{
+			const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+			workingSet = (size_t) residentPages * pageSize;
+			privateSet = (size_t) (residentPages - std::min(residentPages, sharedPages)) * pageSize;
+		}
+		fclose(fp);
+	}
+#endif
+
+	if (privateMemory)
+		*privateMemory = privateSet;
+	return workingSet;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// CGPUCacheSyntheticQuery
+
+CGPUCacheSyntheticQuery::CGPUCacheSyntheticQuery(const GPUCacheSyntheticOptions &options)
+	: CGPUCacheSaverQuery()
+	, mOptions(options)
+{
+	mOptions.numberOfModels = std::max(0, mOptions.numberOfModels);
+	mOptions.patchesPerModel = std::max(1, mOptions.patchesPerModel);
+	mOptions.numberOfMaterials = std::max(0, mOptions.numberOfMaterials);
+	mOptions.numberOfTextures = std::max(0, mOptions.numberOfTextures);
+	mOptions.numberOfSequences = std::max(0, mOptions.numberOfSequences);
+	mOptions.textureSize = std::max(1, mOptions.textureSize);
+	mOptions.sequenceSize = std::max(1, mOptions.sequenceSize);
+	mOptions.sequenceFrames = std::max(1, mOptions.sequenceFrames);
+
+	mGridSide = std::max(2, (int) (sqrt( (double) mOptions.verticesPerModel ) + 0.5) );
+}
+
+CGPUCacheSyntheticQuery::~CGPUCacheSyntheticQuery()
+{
+}
+
+bool CGPUCacheSyntheticQuery::Init(const char *filename)
+{
+	const int numberOfVideos = GetVideoCount();
+	char name[64];
+
+	// models, videos, video files, samplers, materials
+	mNames.resize( mOptions.numberOfModels + numberOfVideos * 3 + mOptions.numberOfMaterials );
+
+	std::vector<std::string>::iterator iter = mNames.begin();
+
+	for (int i=0; i<mOptions.numberOfModels; ++i, ++iter)
+	{
+		sprintf_s( name, sizeof(name), "model_%d", i );
+		*iter = name;
+	}
+	for (int i=0; i<numberOfVideos; ++i, ++iter)
+	{
+		sprintf_s( name, sizeof(name), (IsSequenceVideo(i)) ? "sequence_%d" : "video_%d", i );
+		*iter = name;
+	}
+	for (int i=0; i<numberOfVideos; ++i, ++iter)
+	{
+		sprintf_s( name, sizeof(name), (IsSequenceVideo(i)) ? "sequence_%d_0000.tga" : "image_%d.tga", i );
+		*iter = name;
+	}
+	for (int i=0; i<numberOfVideos; ++i, ++iter)
+	{
+		sprintf_s( name, sizeof(name), "sampler_%d", i );
+		*iter = name;
+	}
+	for (int i=0; i<mOptions.numberOfMaterials; ++i, ++iter)
+	{
+		sprintf_s( name, sizeof(name), "material_%d", i );
+		*iter = name;
+	}
+
+	// gradients with a checker and a noise, so the images don't compress into nothing
+	mImages.resize( numberOfVideos );
+
+	for (int i=0; i<numberOfVideos; ++i)
+	{
+		const int side = GetVideoSide(i);
+		std::vector<unsigned char> &image = mImages[i];
+
+		image.resize( (size_t) side * side * 4 );
+
+		// repeated still images have the same content
+		const int content = (mOptions.textureVariations > 0 && false == IsSequenceVideo(i)) ? i % mOptions.textureVariations : i;
+
+		unsigned int state = mOptions.seed * 2654435761u + (unsigned int) content * 40503u + 1;
+		unsigned char *pixel = image.data();
+
+		for (int y=0; y<side; ++y)
+		{
+			for (int x=0; x<side; ++x, pixel += 4)
+			{
+				state = state * 1664525u + 1013904223u;
+				const int checker = ( ((x >> 4) ^ (y >> 4)) & 1 ) * 64;
+
+				pixel[0] = (unsigned char) (x * 255 / side);
+				pixel[1] = (unsigned char) (y * 255 / side);
+				pixel[2] = (unsigned char) (checker + content * 37);
+				pixel[3] = (unsigned char) (192 + (state >> 26));
+			}
+		}
+	}
+
+	return true;
+}
+
+// textures
+
+const int CGPUCacheSyntheticQuery::GetVideoCount()
+{
+	return mOptions.numberOfTextures + mOptions.numberOfSequences;
+}
+
+const char *CGPUCacheSyntheticQuery::GetVideoName(const int index)
+{
+	return mNames[mOptions.numberOfModels + index].c_str();
+}
+
+const int CGPUCacheSyntheticQuery::GetVideoWidth(const int index)
+{
+	return GetVideoSide(index);
+}
+
+const int CGPUCacheSyntheticQuery::GetVideoHeight(const int index)
+{
+	return GetVideoSide(index);
+}
+
+const int CGPUCacheSyntheticQuery::GetVideoFormat(const int index, GLint &internalFormat, GLint &format)
+{
+	internalFormat = GL_RGBA8;
+	format = GL_RGBA;
+	return format;
+}
+
+const bool CGPUCacheSyntheticQuery::IsVideoImageSequence(const int index)
+{
+	return IsSequenceVideo(index);
+}
+
+const int CGPUCacheSyntheticQuery::GetVideoStartFrame(const int index)
+{
+	return 0;
+}
+
+const int CGPUCacheSyntheticQuery::GetVideoStopFrame(const int index)
+{
+	return (IsSequenceVideo(index)) ? mOptions.sequenceFrames - 1 : 0;
+}
+
+const int CGPUCacheSyntheticQuery::GetVideoFrameRate(const int index)
+{
+	return (IsSequenceVideo(index)) ? 30 : 0;
+}
+
+const char *CGPUCacheSyntheticQuery::GetVideoFilename(const int index)
+{
+	return mNames[mOptions.numberOfModels + GetVideoCount() + index].c_str();
+}
+
+const double CGPUCacheSyntheticQuery::GetVideoSize(const int index)
+{
+	const double side = (double) GetVideoSide(index);
+	return side * side * 4.0;
+}
+
+const bool CGPUCacheSyntheticQuery::IsVideoUsedMipmaps(const int index)
+{
+	return true;
+}
+
+const unsigned char *CGPUCacheSyntheticQuery::GetVideoData(const int index)
+{
+	return (index >= 0 && index < (int) mImages.size() ) ? mImages[index].data() : nullptr;
+}
+
+double CGPUCacheSyntheticQuery::GetTotalUncompressedSize()
+{
+	double size = 0.0;
+	for (int i=0, count=GetVideoCount(); i<count; ++i)
+		size += GetVideoSize(i);
+	return size;
+}
+
+const int CGPUCacheSyntheticQuery::GetSamplersCount()
+{
+	return GetVideoCount();
+}
+
+const char *CGPUCacheSyntheticQuery::GetSamplerName(const int index)
+{
+	return mNames[mOptions.numberOfModels + GetVideoCount() * 2 + index].c_str();
+}
+
+const int CGPUCacheSyntheticQuery::GetSamplerVideoIndex(const int index)
+{
+	return index;
+}
+
+void CGPUCacheSyntheticQuery::GetSamplerMatrix( const int index, mat4 &mat )
+{
+	mat.identity();
+}
+
+// materials and shaders
+
+const int CGPUCacheSyntheticQuery::GetMaterialsCount()
+{
+	return mOptions.numberOfMaterials;
+}
+
+const char *CGPUCacheSyntheticQuery::GetMaterialName(const int index)
+{
+	return mNames[mOptions.numberOfModels + GetVideoCount() * 3 + index].c_str();
+}
+
+void CGPUCacheSyntheticQuery::ConvertMaterial(const int index, MaterialGLSL &data)
+{
+	memset( &data, 0, sizeof(MaterialGLSL) );
+
+	data.ambient = data.specular = data.emissive = data.transparency = data.normalmap = data.reflect = -1;
+	data.diffuse = (GetSamplersCount() > 0) ? index % GetSamplersCount() : -1;
+	data.useDiffuse = (data.diffuse >= 0) ? 1.0f : 0.0f;
+	data.specexp = 16.0f;
+
+	data.diffuseColor = vec4( (float) (index % 7) / 6.0f, (float) (index % 5) / 4.0f, (float) (index % 3) / 2.0f, 1.0f );
+}
+
+const int CGPUCacheSyntheticQuery::GetShadersCount()
+{
+	return (mOptions.numberOfModels > 0) ? 1 : 0;
+}
+
+const char *CGPUCacheSyntheticQuery::GetShaderName(const int index)
+{
+	return "shader";
+}
+
+const int CGPUCacheSyntheticQuery::GetShaderAlphaSource(const int index)
+{
+	return 0;
+}
+
+void CGPUCacheSyntheticQuery::ConvertShader(const int index, ShaderGLSL &data)
+{
+	memset( &data, 0, sizeof(ShaderGLSL) );
+	data.transparency = 1.0f;
+}
+
+// models
+
+const int CGPUCacheSyntheticQuery::GetNumberOfIndices() const
+{
+	return (mGridSide - 1) * (mGridSide - 1) * 6;
+}
+
+const int CGPUCacheSyntheticQuery::GetModelsCount()
+{
+	return mOptions.numberOfModels;
+}
+
+const int CGPUCacheSyntheticQuery::GetSubMeshesCount()
+{
+	return mOptions.numberOfModels * mOptions.patchesPerModel;
+}
+
+const unsigned int CGPUCacheSyntheticQuery::GetTotalCounts(unsigned int &vertices, unsigned int &indices)
+{
+	vertices = (unsigned int) (mOptions.numberOfModels * mGridSide * mGridSide);
+	indices = (unsigned int) (mOptions.numberOfModels * GetNumberOfIndices() );
+	return vertices;
+}
+
+void CGPUCacheSyntheticQuery::GetBoundingBox(vec4 &bmin, vec4 &bmax)
+{
+	if (mOptions.numberOfModels == 0)
+	{
+		bmin = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		bmax = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		return;
+	}
+
+	for (int i=0; i<mOptions.numberOfModels; ++i)
+	{
+		vec4 modelMin, modelMax;
+		GetModelBoundingBox( i, modelMin, modelMax );
+
+		for (int j=0; j<3; ++j)
+		{
+			bmin[j] = (i == 0) ? modelMin[j] : std::min(bmin[j], modelMin[j]);
+			bmax[j] = (i == 0) ? modelMax[j] : std::max(bmax[j], modelMax[j]);
+		}
+	}
+	bmin[3] = bmax[3] = 1.0f;
+}
+
+const char *CGPUCacheSyntheticQuery::GetModelName(const int modelId)
+{
+	return mNames[modelId].c_str();
+}
+
+const int CGPUCacheSyntheticQuery::GetModelVisible(const int modelId)
+{
+	return 1;
+}
+
+const int CGPUCacheSyntheticQuery::GetModelCastsShadows(const int modelId)
+{
+	return 1;
+}
+
+const int CGPUCacheSyntheticQuery::GetModelReceiveShadows(const int modelId)
+{
+	return 1;
+}
+
+void CGPUCacheSyntheticQuery::GetModelMatrix(const int modelId, mat4 &mat)
+{
+	vec4 pos;
+	GetModelTranslation( modelId, pos );
+
+	mat.identity();
+	mat.set_translation( vec3(pos.x, pos.y, pos.z) );
+}
+
+void CGPUCacheSyntheticQuery::GetModelTranslation(const int modelId, vec4 &pos)
+{
+	// models are placed on a square grid in the xz plane
+	const int modelsPerRow = std::max(1, (int) ceil( sqrt( (double) mOptions.numberOfModels ) ) );
+
+	pos = vec4( (float) (modelId % modelsPerRow) * SYNTHETIC_MODEL_SPACING, 0.0f,
+		(float) (modelId / modelsPerRow) * SYNTHETIC_MODEL_SPACING, 1.0f );
+}
+
+void CGPUCacheSyntheticQuery::GetModelRotation(const int modelId, vec4 &rot)
+{
+	rot = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+void CGPUCacheSyntheticQuery::GetModelScaling(const int modelId, vec4 &scaling)
+{
+	scaling = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+void CGPUCacheSyntheticQuery::GetModelBoundingBox(const int modelId, vec4 &bmin, vec4 &bmax)
+{
+	vec4 pos;
+	GetModelTranslation( modelId, pos );
+
+	// grid heights are in [-1; 1]
+	bmin = vec4( pos.x, pos.y - 1.0f, pos.z, 1.0f );
+	bmax = vec4( pos.x + SYNTHETIC_MODEL_SIZE, pos.y + 1.0f, pos.z + SYNTHETIC_MODEL_SIZE, 1.0f );
+}
+
+const int CGPUCacheSyntheticQuery::GetModelVertexCount(const int modelId)
+{
+	return mGridSide * mGridSide;
+}
+
+const int CGPUCacheSyntheticQuery::GetModelUVCount(const int modelId)
+{
+	return 1;
+}
+
+void CGPUCacheSyntheticQuery::ModelVertexArrayRequest(const int modelId)
+{
+	const int side = mGridSide;
+	const int numberOfVertices = side * side;
+
+	mPoints.resize( numberOfVertices * 4 );
+	mNormals.resize( numberOfVertices * 4 );
+	mTangents.resize( numberOfVertices * 4 );
+	mUVs.resize( numberOfVertices * 2 );
+
+	// a height field with a different wave for each model shape
+	const int variation = (mOptions.meshVariations > 0) ? modelId % mOptions.meshVariations : modelId;
+	const float frequency = 1.0f + (float) ((variation + mOptions.seed) % 7);
+	const float phase = 0.1f * (float) (variation / 7);
+	const float step = SYNTHETIC_MODEL_SIZE / (float) (side - 1);
+
+	for (int y=0; y<side; ++y)
+	{
+		for (int x=0; x<side; ++x)
+		{
+			const int index = y * side + x;
+
+			const float u = (float) x / (float) (side - 1);
+			const float v = (float) y / (float) (side - 1);
+			const float height = 0.5f * sinf( frequency * 6.2831853f * u + phase ) * cosf( frequency * 6.2831853f * v );
+
+			// height derivatives along x and z, normal and tangent follow the waves
+			const float scale = 0.5f * frequency * 6.2831853f / SYNTHETIC_MODEL_SIZE;
+			const float dx = scale * cosf( frequency * 6.2831853f * u + phase ) * cosf( frequency * 6.2831853f * v );
+			const float dz = -scale * sinf( frequency * 6.2831853f * u + phase ) * sinf( frequency * 6.2831853f * v );
+			const float normalLen = sqrtf( dx * dx + 1.0f + dz * dz );
+			const float tangentLen = sqrtf( 1.0f + dx * dx );
+
+			float *point = &mPoints[index * 4];
+			point[0] = (float) x * step;
+			point[1] = height;
+			point[2] = (float) y * step;
+			point[3] = 1.0f;
+
+			float *normal = &mNormals[index * 4];
+			normal[0] = -dx / normalLen;
+			normal[1] = 1.0f / normalLen;
+			normal[2] = -dz / normalLen;
+			normal[3] = 0.0f;
+
+			float *tangent = &mTangents[index * 4];
+			tangent[0] = 1.0f / tangentLen;
+			tangent[1] = dx / tangentLen;
+			tangent[2] = 0.0f;
+			tangent[3] = 0.0f;
+
+			mUVs[index * 2] = u;
+			mUVs[index * 2 + 1] = v;
+		}
+	}
+
+	mIndices.resize( GetNumberOfIndices() );
+	int *indices = mIndices.data();
+
+	for (int y=0; y<side-1; ++y)
+	{
+		for (int x=0; x<side-1; ++x)
+		{
+			const int index = y * side + x;
+
+			*indices++ = index;
+			*indices++ = index + side;
+			*indices++ = index + 1;
+
+			*indices++ = index + 1;
+			*indices++ = index + side;
+			*indices++ = index + side + 1;
+		}
+	}
+
+	if (mOptions.shuffleTriangles)
+	{
+		// Fisher-Yates inside each patch range, patches keep their own triangles
+		unsigned int state = (mOptions.seed + (unsigned int) modelId) * 2654435761u + 1;
+
+		for (int patchId=0; patchId<mOptions.patchesPerModel; ++patchId)
+		{
+			int offset, size, materialId;
+			GetModelSubPatchInfo( modelId, patchId, offset, size, materialId );
+
+			int *triangles = mIndices.data() + offset;
+			
+			for (int i=size/3-1; i>0; --i)
+			{
+				state = state * 1664525u + 1013904223u;
+				const int j = (int) ((state >> 8) % (unsigned int) (i + 1));
+
+				for (int k=0; k<3; ++k)
+					std::swap( triangles[i*3+k], triangles[j*3+k] );
+			}
+		}
+	}
+}
+
+const float *CGPUCacheSyntheticQuery::GetModelVertexArrayPoint( const bool afterDeform )
+{
+	return mPoints.data();
+}
+
+const float *CGPUCacheSyntheticQuery::GetModelVertexArrayNormal( const bool afterDeform )
+{
+	return mNormals.data();
+}
+
+const float *CGPUCacheSyntheticQuery::GetModelVertexArrayTangent( const bool afterDeform )
+{
+	return mTangents.data();
+}
+
+const float *CGPUCacheSyntheticQuery::GetModelVertexArrayUV( const int uvset, const bool afterDeform )
+{
+	return mUVs.data();
+}
+
+const int *CGPUCacheSyntheticQuery::GetModelIndexArray()
+{
+	return mIndices.data();
+}
+
+void CGPUCacheSyntheticQuery::ModelVertexArrayRelease()
+{
+	// NOTE: the saver reads arrays after the release, keep them until the next request
+}
+
+const int CGPUCacheSyntheticQuery::GetModelVertexArrayPointStride(const int modelId)
+{
+	return gPointStride;
+}
+
+const int CGPUCacheSyntheticQuery::GetModelVertexArrayNormalStride(const int modelId)
+{
+	return gNormalStride;
+}
+
+const int CGPUCacheSyntheticQuery::GetModelVertexArrayTangentStride(const int modelId)
+{
+	return gTangentStride;
+}
+
+const int CGPUCacheSyntheticQuery::GetModelVertexArrayUVStride(const int modelId)
+{
+	return gUVStride;
+}
+
+const int CGPUCacheSyntheticQuery::GetModelSubPatchCount(const int index)
+{
+	return mOptions.patchesPerModel;
+}
+
+void CGPUCacheSyntheticQuery::GetModelSubPatchInfo(const int modelid, const int patchid, int &offset, int &size, int &materialId)
+{
+	// triangles are split between the patches
+	const int numberOfTriangles = GetNumberOfIndices() / 3;
+	const int first = numberOfTriangles * patchid / mOptions.patchesPerModel;
+	const int last = numberOfTriangles * (patchid + 1) / mOptions.patchesPerModel;
+
+	offset = first * 3;
+	size = (last - first) * 3;
+	materialId = (mOptions.numberOfMaterials > 0) ? (modelid * mOptions.patchesPerModel + patchid) % mOptions.numberOfMaterials : -1;
+}
+
+const unsigned int CGPUCacheSyntheticQuery::GetModelShadersCount(const int index)
+{
+	return 1;
+}
+
+const int CGPUCacheSyntheticQuery::GetModelShaderId(const int index, const int nshader)
+{
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// CGPUCacheNullVisitor
+
+CGPUCacheNullVisitor::CGPUCacheNullVisitor(const bool touchData)
+	: CGPUCacheLoaderVisitor()
+	, mTouchData(touchData)
+	, mChecksum(0)
+{
+}
+
+void CGPUCacheNullVisitor::OnReadTexturesImage1(const ImageHeader *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData)
+{
+	if (mTouchData)
+		mChecksum += TouchPages( imageData, imageSize );
+}
+
+void CGPUCacheNullVisitor::OnReadTexturesImage2(const BYTE type, const ImageHeader2 *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData)
+{
+	if (mTouchData)
+		mChecksum += TouchPages( imageData, imageSize );
+}
+
+void CGPUCacheNullVisitor::OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data )
+{
+	if (mTouchData)
+		mChecksum += TouchPages( data, CalculateGeometryPackSize(data) );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// visitor which measures loader phases and time spent in the wrapped visitor
+
+enum EBenchmarkPhase
+{
+	eBenchmarkPhaseManifest,
+	eBenchmarkPhaseTextures,
+	eBenchmarkPhaseMaterials,
+	eBenchmarkPhaseGeometry,
+	eBenchmarkPhaseCount
+};
+
+class CGPUCacheTimingVisitor : public CGPUCacheLoaderVisitor
+{
+public:
+	//! a constructor
+	CGPUCacheTimingVisitor(CGPUCacheLoaderVisitor *visitor)
+		: CGPUCacheLoaderVisitor()
+		, mVisitor(visitor)
+	{
+		Begin();
+	}
+
+	void Begin()
+	{
+		mStart = BenchmarkClock::now();
+		mCurrentPhase = eBenchmarkPhaseManifest;
+		mNumberOfImages = 0;
+		mNumberOfModels = 0;
+
+		for (int i=0; i<eBenchmarkPhaseCount; ++i)
+		{
+			mPhaseEnd[i] = -1.0;
+			mCallbacks[i] = 0.0;
+		}
+	}
+	// last phase ends when the loader returns
+	void Finish()
+	{
+		EndPhase( eBenchmarkPhaseGeometry );
+	}
+
+	// phase duration with the visitor callbacks
+	double GetPhaseTime( const int phase ) const
+	{
+		return mPhaseEnd[phase] - ( (phase > 0) ? mPhaseEnd[phase-1] : 0.0 );
+	}
+	double GetCallbacksTime( const int phase ) const
+	{
+		return mCallbacks[phase];
+	}
+
+	int		mNumberOfImages;
+	int		mNumberOfModels;
+
+	// main header
+	virtual void OnReadHeader(const char *xmlFilename, const char *sourceFilename) override
+	{
+		EndPhase( eBenchmarkPhaseManifest );
+		CallbackTimer timer(this);
+		mVisitor->OnReadHeader( xmlFilename, sourceFilename );
+	}
+
+	// textures
+	virtual bool OnReadTexturesBegin( const char *textures_filename, const int numberOfSamplers, const int numberOfImages ) override
+	{
+		mNumberOfImages = numberOfImages;
+		CallbackTimer timer(this);
+		return mVisitor->OnReadTexturesBegin( textures_filename, numberOfSamplers, numberOfImages );
+	}
+	virtual void OnReadTexturesImage1(const ImageHeader *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadTexturesImage1( header, fileImageOffset, imageSize, imageData );
+	}
+	virtual void OnReadTexturesImage2(const BYTE type, const ImageHeader2 *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadTexturesImage2( type, header, fileImageOffset, imageSize, imageData );
+	}
+	virtual void OnReadEmptyImage() override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadEmptyImage();
+	}
+	virtual void OnReadTexturesSampler(const char *samplerName, const char *clipFile, const SamplerHeader *header, const size_t fileSamplerOffset, const size_t samplerSize, const BYTE *samplerData) override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadTexturesSampler( samplerName, clipFile, header, fileSamplerOffset, samplerSize, samplerData );
+	}
+	virtual void OnReadTexturesError(const char *what) override
+	{
+		{
+			CallbackTimer timer(this);
+			mVisitor->OnReadTexturesError( what );
+		}
+		EndPhase( eBenchmarkPhaseTextures );
+	}
+	virtual void OnReadTexturesEnd() override
+	{
+		{
+			CallbackTimer timer(this);
+			mVisitor->OnReadTexturesEnd();
+		}
+		EndPhase( eBenchmarkPhaseTextures );
+	}
+
+	// materials, shaders, etc.
+	virtual bool OnReadMaterialsBegin(const int numberOfMaterials) override
+	{
+		EndPhase( eBenchmarkPhaseTextures );
+		CallbackTimer timer(this);
+		return mVisitor->OnReadMaterialsBegin( numberOfMaterials );
+	}
+	virtual void OnReadMaterial(const char *material_name, const MaterialGLSL &material ) override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadMaterial( material_name, material );
+	}
+	virtual void OnReadMaterialsEnd() override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadMaterialsEnd();
+	}
+
+	virtual bool OnReadShadersBegin(const int numberOfShaders) override
+	{
+		EndPhase( eBenchmarkPhaseTextures );
+		CallbackTimer timer(this);
+		return mVisitor->OnReadShadersBegin( numberOfShaders );
+	}
+	virtual void OnReadShader(const char *shader_name, const int alphatype, const ShaderGLSL &shaderData ) override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadShader( shader_name, alphatype, shaderData );
+	}
+	virtual void OnReadShadersEnd() override
+	{
+		{
+			CallbackTimer timer(this);
+			mVisitor->OnReadShadersEnd();
+		}
+		EndPhase( eBenchmarkPhaseMaterials );
+	}
+
+	// geometry, models
+	virtual bool OnReadModelsBegin(const int numberOfModels, const int numberOfMeshes, const double *bounding_min, const double *bounding_max) override
+	{
+		EndPhase( eBenchmarkPhaseMaterials );
+		mNumberOfModels = numberOfModels;
+		CallbackTimer timer(this);
+		return mVisitor->OnReadModelsBegin( numberOfModels, numberOfMeshes, bounding_min, bounding_max );
+	}
+	virtual void OnPrepareVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnPrepareVertexData( pHeader, data );
+	}
+	virtual void OnTakeMergedVertexData( const FileGeometryHeader *pHeader, const BYTE *data, VertexMergeStaging &staging ) override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnTakeMergedVertexData( pHeader, data, staging );
+	}
+	virtual void OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadVertexData( pHeader, data );
+	}
+	virtual void OnReadModel(const char *name, const double *translation, const double *rotation, const double *scaling,
+		const double *bounding_min, const double *bounding_max, const int numberOfShaders, const int *shaders,
+		const VertexDataHeader *pheader, const BYTE *data) override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadModel( name, translation, rotation, scaling, bounding_min, bounding_max, numberOfShaders, shaders, pheader, data );
+	}
+	virtual void OnReadModelPatch(const int offset, const int size, const int materialId) override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadModelPatch( offset, size, materialId );
+	}
+	virtual void OnReadModelFinish() override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadModelFinish();
+	}
+	virtual void OnReadModelsEnd() override
+	{
+		CallbackTimer timer(this);
+		mVisitor->OnReadModelsEnd();
+	}
+
+protected:
+
+	// time of the callback goes to the current phase
+	struct CallbackTimer
+	{
+		CGPUCacheTimingVisitor			*visitor;
+		BenchmarkClock::time_point		start;
+
+		CallbackTimer(CGPUCacheTimingVisitor *_visitor)
+			: visitor(_visitor)
+			, start(BenchmarkClock::now())
+		{}
+		~CallbackTimer()
+		{
+			visitor->mCallbacks[visitor->mCurrentPhase] += ElapsedMs(start);
+		}
+	};
+
+	CGPUCacheLoaderVisitor			*mVisitor;
+
+	BenchmarkClock::time_point		mStart;
+	int								mCurrentPhase;
+
+	double		mPhaseEnd[eBenchmarkPhaseCount];	// ms from the start, -1 - not finished yet
+	double		mCallbacks[eBenchmarkPhaseCount];
+
+	// skipped phases (no textures, no materials) end at the same time
+	void EndPhase( const int phase )
+	{
+		if (mPhaseEnd[phase] >= 0.0)
+			return;
+
+		const double time = ElapsedMs(mStart);
+		for (int i=0; i<=phase; ++i)
+		{
+			if (mPhaseEnd[i] < 0.0)
+				mPhaseEnd[i] = time;
+		}
+		mCurrentPhase = std::min(phase + 1, (int) eBenchmarkPhaseGeometry);
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+bool GenerateSyntheticCache( const char *filename, const GPUCacheSyntheticOptions &options, CGPUCacheSaver &saver, GPUCacheBenchmarkReport *report )
+{
+	CGPUCacheSyntheticQuery		query(options);
+
+	const BenchmarkClock::time_point start = BenchmarkClock::now();
+	const bool result = saver.Save( filename, &query );
+
+	if (report)
+	{
+		report->saveTime = ElapsedMs(start);
+		report->peakMemory = GetPeakProcessMemory();
+	}
+	return result;
+}
+
+bool BenchmarkCacheLoad( const char *filename, const int numberOfIterations, const bool pipelined, CGPUCacheLoaderVisitor *visitor,
+	GPUCacheBenchmarkReport &report )
+{
+	const double saveTime = report.saveTime;
+	GPUCacheBenchmarkReport::Clear(report);
+	report.saveTime = saveTime;
+
+	const size_t manifestSize = GetBenchmarkFileSize( MakeManifestFilename(filename).c_str() );
+
+	report.manifestSize = (manifestSize > 0) ? manifestSize : GetBenchmarkFileSize(filename);
+	report.texturesSize = GetBenchmarkFileSize( MakeBenchmarkPackFilename(filename, "_Textures.pck").c_str() );
+	report.geometrySize = GetBenchmarkFileSize( MakeBenchmarkPackFilename(filename, "_Geometry.pck").c_str() );
+
+	CGPUCacheNullVisitor		nullVisitor;
+	CGPUCacheTimingVisitor		timingVisitor( (visitor) ? visitor : &nullVisitor );
+
+	const int iterations = std::max(1, numberOfIterations);
+
+	for (int i=0; i<iterations; ++i)
+	{
+		timingVisitor.Begin();
+		const BenchmarkClock::time_point start = BenchmarkClock::now();
+
+		bool result = false;
+
+		if (pipelined)
+		{
+			CGPUCacheLoaderPipelined	loader;
+			result = loader.Load( filename, &timingVisitor );
+
+			const GPUCacheLoaderTimings &timings = loader.GetTimings();
+
+			report.manifestRead += timings.manifestRead;
+			report.texturesWalk += timings.texturesRead;
+			report.materialsWalk += timings.materialsRead;
+			report.geometryWalk += timings.geometryRead;
+			report.visitorCallbacks += timings.submitTextures + timings.submitMaterials + timings.submitModels;
+		}
+		else
+		{
+			CGPUCacheLoader		loader;
+			result = loader.Load( filename, &timingVisitor );
+			timingVisitor.Finish();
+
+			report.manifestRead += timingVisitor.GetPhaseTime(eBenchmarkPhaseManifest) - timingVisitor.GetCallbacksTime(eBenchmarkPhaseManifest);
+			report.texturesWalk += timingVisitor.GetPhaseTime(eBenchmarkPhaseTextures) - timingVisitor.GetCallbacksTime(eBenchmarkPhaseTextures);
+			report.materialsWalk += timingVisitor.GetPhaseTime(eBenchmarkPhaseMaterials) - timingVisitor.GetCallbacksTime(eBenchmarkPhaseMaterials);
+			report.geometryWalk += timingVisitor.GetPhaseTime(eBenchmarkPhaseGeometry) - timingVisitor.GetCallbacksTime(eBenchmarkPhaseGeometry);
+
+			for (int j=0; j<eBenchmarkPhaseCount; ++j)
+				report.visitorCallbacks += timingVisitor.GetCallbacksTime(j);
+		}
+
+		report.loadTime += ElapsedMs(start);
+
+		if (false == result)
+		{
+			printf( "benchmark - failed to load %s\n", filename );
+			return false;
+		}
+	}
+
+	const double scale = 1.0 / (double) iterations;
+
+	report.manifestRead *= scale;
+	report.texturesWalk *= scale;
+	report.materialsWalk *= scale;
+	report.geometryWalk *= scale;
+	report.visitorCallbacks *= scale;
+	report.loadTime *= scale;
+
+	report.numberOfIterations = iterations;
+	report.numberOfImages = timingVisitor.mNumberOfImages;
+	report.numberOfModels = timingVisitor.mNumberOfModels;
+
+	const double totalSize = (double) (report.manifestSize + report.texturesSize + report.geometrySize);
+	report.throughput = (report.loadTime > 0.0) ? totalSize / (1024.0 * 1024.0) / (report.loadTime * 0.001) : 0.0;
+	report.peakMemory = GetPeakProcessMemory();
+
+	return true;
+}
+
+void PrintBenchmarkReport( const GPUCacheBenchmarkReport &report )
+{
+	printf( "gpu cache benchmark (ms, average of %d loads)\n", report.numberOfIterations );
+	printf( "  save               %10.2f\n", report.saveTime );
+	printf( "  manifest read      %10.2f  (%.2f KB)\n", report.manifestRead, (double) report.manifestSize / 1024.0 );
+	printf( "  textures walk      %10.2f  (%d images, %.2f MB)\n", report.texturesWalk, report.numberOfImages, (double) report.texturesSize / (1024.0 * 1024.0) );
+	printf( "  materials walk     %10.2f\n", report.materialsWalk );
+	printf( "  geometry walk      %10.2f  (%d models, %.2f MB)\n", report.geometryWalk, report.numberOfModels, (double) report.geometrySize / (1024.0 * 1024.0) );
+	printf( "  visitor callbacks  %10.2f\n", report.visitorCallbacks );
+	printf( "  load               %10.2f  (%.1f MB/s)\n", report.loadTime, report.throughput );
+	printf( "  peak memory        %10.2f MB\n", (double) report.peakMemory / (1024.0 * 1024.0) );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// pack access, the null visitor with the time of the first data callback and the working set samples
+
+class CGPUCacheAccessVisitor : public CGPUCacheNullVisitor
+{
+public:
+	//! a constructor
+	CGPUCacheAccessVisitor()
+		: CGPUCacheNullVisitor(true)
+	{
+		Begin();
+	}
+
+	void Begin()
+	{
+		mStart = BenchmarkClock::now();
+		mFirstCallback = -1.0;
+		mBaseMemory = GetCurrentProcessMemory(&mBasePrivate);
+		mPeakMemory = 0;
+		mPeakPrivate = 0;
+		mChecksum = 0;
+	}
+
+	BenchmarkClock::time_point		mStart;
+	double							mFirstCallback;
+	size_t							mPeakMemory;
+	size_t							mPeakPrivate;
+
+	virtual void OnReadTexturesImage1(const ImageHeader *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override
+	{
+		FirstCallback();
+		CGPUCacheNullVisitor::OnReadTexturesImage1( header, fileImageOffset, imageSize, imageData );
+	}
+	virtual void OnReadTexturesImage2(const BYTE type, const ImageHeader2 *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override
+	{
+		FirstCallback();
+		CGPUCacheNullVisitor::OnReadTexturesImage2( type, header, fileImageOffset, imageSize, imageData );
+	}
+	// the whole pack (or its touched pages) is in the working set at the end of each phase
+	virtual void OnReadTexturesEnd() override
+	{
+		SampleMemory();
+	}
+	virtual void OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) override
+	{
+		FirstCallback();
+		CGPUCacheNullVisitor::OnReadVertexData( pHeader, data );
+		SampleMemory();
+	}
+
+protected:
+
+	size_t							mBaseMemory;
+	size_t							mBasePrivate;
+
+	void FirstCallback()
+	{
+		if (mFirstCallback < 0.0)
+			mFirstCallback = ElapsedMs(mStart);
+	}
+	void SampleMemory()
+	{
+		size_t privateMemory = 0;
+		const size_t memory = GetCurrentProcessMemory(&privateMemory);
+
+		if (memory > mBaseMemory)
+			mPeakMemory = std::max( mPeakMemory, memory - mBaseMemory );
+		if (privateMemory > mBasePrivate)
+			mPeakPrivate = std::max( mPeakPrivate, privateMemory - mBasePrivate );
+	}
+};
+
+bool BenchmarkPackAccess( const char *filename, const int numberOfIterations, GPUCacheMappingReport &report )
+{
+	GPUCacheMappingReport::Clear(report);
+
+	report.packsSize = GetBenchmarkFileSize( MakeBenchmarkPackFilename(filename, "_Textures.pck").c_str() ) 
+		+ GetBenchmarkFileSize( MakeBenchmarkPackFilename(filename, "_Geometry.pck").c_str() );
+
+	const int iterations = std::max(1, numberOfIterations);
+	CGPUCacheAccessVisitor	visitor;
+
+	for (int i=0; i<iterations; ++i)
+	{
+		for (int mode=0; mode<eBenchmarkPackAccessCount; ++mode)
+		{
+			visitor.Begin();
+
+			CGPUCacheLoader		loader;
+			loader.SetUseFileMapping( mode == eBenchmarkPackMapped );
+
+			const bool result = loader.Load( filename, &visitor );
+			report.loadTime[mode] += ElapsedMs(visitor.mStart);
+
+			if (false == result)
+			{
+				printf( "benchmark - failed to load %s\n", filename );
+				return false;
+			}
+
+			report.firstCallback[mode] += visitor.mFirstCallback;
+			report.peakMemory[mode] = std::max( report.peakMemory[mode], visitor.mPeakMemory );
+			report.peakPrivate[mode] = std::max( report.peakPrivate[mode], visitor.mPeakPrivate );
+			report.checksum[mode] = visitor.GetChecksum();
+		}
+	}
+
+	const double scale = 1.0 / (double) iterations;
+
+	for (int mode=0; mode<eBenchmarkPackAccessCount; ++mode)
+	{
+		report.firstCallback[mode] *= scale;
+		report.loadTime[mode] *= scale;
+	}
+	report.numberOfIterations = iterations;
+
+	return true;
+}
+
+void PrintMappingReport( const GPUCacheMappingReport &report )
+{
+	const char *names[eBenchmarkPackAccessCount] = { "mapped", "copy  " };
+
+	printf( "pack access benchmark (ms, average of %d loads, packs %.2f MB)\n", report.numberOfIterations, (double) report.packsSize / (1024.0 * 1024.0) );
+	for (int mode=0; mode<eBenchmarkPackAccessCount; ++mode)
+	{
+		printf( "  %s  first callback %10.2f  load %10.2f  peak working set %8.2f MB (private %8.2f MB)\n", names[mode], 
+			report.firstCallback[mode], report.loadTime[mode], (double) report.peakMemory[mode] / (1024.0 * 1024.0), 
+			(double) report.peakPrivate[mode] / (1024.0 * 1024.0) );
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+bool BenchmarkRayPicking( const GPUCacheSyntheticOptions &options, const int numberOfRays, const int numberOfThreads, GPUCachePickingReport &report )
+{
+	GPUCachePickingReport::Clear(report);
+
+	CGPUCacheSyntheticQuery		query(options);
+
+	const int numberOfModels = query.GetModelsCount();
+	if (numberOfModels == 0)
+		return false;
+
+	// the same layout as the merged vertex data, index ranges of the models in one buffer
+	std::vector<vec4>				positions;
+	std::vector<unsigned int>		indices;
+	std::vector<TriangleMeshSource>	sources(numberOfModels);
+	std::vector<mat4>				transforms(numberOfModels);
+	std::vector<mat4>				inverses(numberOfModels);
+	std::vector<vec4>				spheres(numberOfModels);
+
+	unsigned int totalVertices = 0;
+	unsigned int totalIndices = 0;
+	query.GetTotalCounts( totalVertices, totalIndices );
+
+	const unsigned int numberOfIndices = totalIndices / (unsigned int) numberOfModels;
+
+	positions.reserve( totalVertices );
+	indices.reserve( totalIndices );
+
+	for (int i=0; i<numberOfModels; ++i)
+	{
+		query.ModelVertexArrayRequest(i);
+
+		const int numberOfVertices = query.GetModelVertexCount(i);
+		const int stride = query.GetModelVertexArrayPointStride(i);
+		const unsigned char *points = (const unsigned char*) query.GetModelVertexArrayPoint(false);
+		const int *modelIndices = query.GetModelIndexArray();
+
+		const unsigned int baseVertex = (unsigned int) positions.size();
+		const int firstIndex = (int) indices.size();
+
+		for (int j=0; j<numberOfVertices; ++j)
+		{
+			const float *point = (const float*) (points + stride * j);
+			positions.push_back( vec4(point[0], point[1], point[2], 1.0f) );
+		}
+		for (unsigned int j=0; j<numberOfIndices; ++j)
+			indices.push_back( baseVertex + (unsigned int) modelIndices[j] );
+
+		query.ModelVertexArrayRelease();
+
+		TriangleMeshSource::Set( nullptr, sizeof(vec4), nullptr, firstIndex, (int) numberOfIndices, sources[i] );
+
+		query.GetModelMatrix( i, transforms[i] );
+		invert( inverses[i], transforms[i] );
+
+		vec4 bmin, bmax;
+		query.GetModelBoundingBox( i, bmin, bmax );
+
+		const vec3 half( 0.5f * (bmax.x - bmin.x), 0.5f * (bmax.y - bmin.y), 0.5f * (bmax.z - bmin.z) );
+		spheres[i] = vec4( bmin.x + half.x, bmin.y + half.y, bmin.z + half.z, sqrtf(half.x*half.x + half.y*half.y + half.z*half.z) );
+	}
+
+	for (int i=0; i<numberOfModels; ++i)
+	{
+		sources[i].positions = (const float*) positions.data();
+		sources[i].indices = indices.data();
+	}
+
+	std::vector<CTriangleHierarchy>		hierarchies(numberOfModels);
+	std::vector<CTriangleHierarchy*>	pointers(numberOfModels);
+
+	for (int i=0; i<numberOfModels; ++i)
+		pointers[i] = &hierarchies[i];
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	BuildTriangleHierarchies( sources.data(), pointers.data(), numberOfModels, 1 );
+	report.buildTimeSingle = ElapsedMs(start);
+
+	start = BenchmarkClock::now();
+	BuildTriangleHierarchies( sources.data(), pointers.data(), numberOfModels, numberOfThreads );
+	report.buildTime = ElapsedMs(start);
+
+	CBoundingVolumeHierarchy	modelsHierarchy;
+	modelsHierarchy.Build( spheres.data(), numberOfModels );
+
+	report.numberOfModels = numberOfModels;
+	report.numberOfThreads = numberOfThreads;
+	report.numberOfTriangles = (int) indices.size() / 3;
+
+	for (int i=0; i<numberOfModels; ++i)
+		report.memorySize += hierarchies[i].GetMemorySize();
+
+	// rays from a plane above the scene into the random points of the models
+	vec4 sceneMin, sceneMax;
+	query.GetBoundingBox( sceneMin, sceneMax );
+
+	unsigned int state = options.seed * 2654435761u + 1;
+	auto fn_random = [&state] () -> float {
+		state = state * 1664525u + 1013904223u;
+		return (float) (state >> 8) / 16777216.0f;
+	};
+
+	std::vector<vec3>	origins(numberOfRays);
+	std::vector<vec3>	dirs(numberOfRays);
+
+	for (int i=0; i<numberOfRays; ++i)
+	{
+		const int model = (int) (fn_random() * (float) numberOfModels) % numberOfModels;
+		const vec4 &sphere = spheres[model];
+
+		const vec3 target( sphere.x + (fn_random() - 0.5f) * SYNTHETIC_MODEL_SIZE, 0.0f, sphere.z + (fn_random() - 0.5f) * SYNTHETIC_MODEL_SIZE );
+		const vec3 origin( sceneMin.x + fn_random() * (sceneMax.x - sceneMin.x), sceneMax.y + 20.0f, sceneMin.z + fn_random() * (sceneMax.z - sceneMin.z) );
+
+		vec3 dir( target.x - origin.x, target.y - origin.y, target.z - origin.z );
+		dir.normalize();
+
+		origins[i] = origin;
+		dirs[i] = dir;
+	}
+
+	// the same two levels as CGPUModelRenderCached::PickTriangle
+	std::vector<int>					candidates;
+	std::vector<float>					distances;
+	std::vector<std::pair<float, int>>	order;
+
+	start = BenchmarkClock::now();
+
+	for (int i=0; i<numberOfRays; ++i)
+	{
+		candidates.clear();
+		distances.clear();
+		modelsHierarchy.QueryRay( origins[i], dirs[i], FLT_MAX, candidates, &distances );
+
+		order.resize(candidates.size());
+		for (size_t j=0; j<candidates.size(); ++j)
+			order[j] = std::make_pair(distances[j], candidates[j]);
+		std::sort( begin(order), end(order) );
+
+		float best = FLT_MAX;
+		bool hit = false;
+
+		for (auto iter=begin(order); iter!=end(order) && iter->first <= best; ++iter)
+		{
+			const float *m = inverses[iter->second].mat_array;
+			const vec3 &o = origins[i];
+			const vec3 &d = dirs[i];
+
+			const vec3 localOrigin( m[0]*o.x + m[4]*o.y + m[8]*o.z + m[12], m[1]*o.x + m[5]*o.y + m[9]*o.z + m[13], m[2]*o.x + m[6]*o.y + m[10]*o.z + m[14] );
+			const vec3 localDir( m[0]*d.x + m[4]*d.y + m[8]*d.z, m[1]*d.x + m[5]*d.y + m[9]*d.z, m[2]*d.x + m[6]*d.y + m[10]*d.z );
+
+			TriangleRayHit triangleHit;
+			if (hierarchies[iter->second].IntersectRay( localOrigin, localDir, best, triangleHit ) )
+			{
+				best = triangleHit.distance;
+				hit = true;
+			}
+		}
+
+		if (hit)
+			report.numberOfHits += 1;
+	}
+
+	report.castTime = ElapsedMs(start);
+	report.numberOfRays = numberOfRays;
+	report.raysPerSecond = (report.castTime > 0.0) ? (double) numberOfRays / (report.castTime * 0.001) : 0.0;
+
+	return true;
+}
+
+void PrintPickingReport( const GPUCachePickingReport &report )
+{
+	printf( "triangle picking benchmark - %d models, %d triangles\n", report.numberOfModels, report.numberOfTriangles );
+	printf( "  build, 1 thread    %10.2f ms\n", report.buildTimeSingle );
+	printf( "  build, %d threads  %10.2f ms\n", report.numberOfThreads, report.buildTime );
+	printf( "  memory             %10.2f MB\n", (double) report.memorySize / (1024.0 * 1024.0) );
+	printf( "  rays               %10d (%d hits)\n", report.numberOfRays, report.numberOfHits );
+	printf( "  cast               %10.2f ms (%.2f M rays/s)\n", report.castTime, report.raysPerSecond * 0.000001 );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// manifest
+
+static bool CompareManifests( const CGPUCacheManifest &a, const CGPUCacheManifest &b )
+{
+	const std::vector<ManifestModel> &modelsA = a.GetModels();
+	const std::vector<ManifestModel> &modelsB = b.GetModels();
+
+	if (modelsA.size() != modelsB.size() || a.GetPatches().size() != b.GetPatches().size() 
+		|| a.GetTextures().size() != b.GetTextures().size() || a.GetMaterials().size() != b.GetMaterials().size()
+		|| a.GetShaders().size() != b.GetShaders().size() )
+	{
+		return false;
+	}
+
+	for (size_t i=0; i<modelsA.size(); ++i)
+	{
+		const ManifestModel &ma = modelsA[i];
+		const ManifestModel &mb = modelsB[i];
+
+		if (0 != strcmp( a.GetString(ma.name), b.GetString(mb.name) ) || ma.numberOfPatches != mb.numberOfPatches
+			|| ma.firstPatch != mb.firstPatch || ma.numberOfShaders != mb.numberOfShaders)
+		{
+			return false;
+		}
+
+		for (int j=0; j<3; ++j)
+		{
+			if (fabs(ma.translation[j] - mb.translation[j]) > 0.001 || fabs(ma.boundingMax[j] - mb.boundingMax[j]) > 0.001)
+				return false;
+		}
+	}
+
+	const std::vector<ManifestPatch> &patchesA = a.GetPatches();
+	const std::vector<ManifestPatch> &patchesB = b.GetPatches();
+
+	for (size_t i=0; i<patchesA.size(); ++i)
+	{
+		if (patchesA[i].offset != patchesB[i].offset || patchesA[i].size != patchesB[i].size || patchesA[i].materialId != patchesB[i].materialId)
+			return false;
+	}
+
+	return true;
+}
+
+bool BenchmarkManifest( const char *filename, const int numberOfIterations, GPUCacheManifestReport &report )
+{
+	GPUCacheManifestReport::Clear(report);
+
+	const std::string binaryFilename = MakeManifestFilename(filename);
+	report.xmlSize = GetBenchmarkFileSize(filename);
+	report.binarySize = GetBenchmarkFileSize(binaryFilename.c_str() );
+
+	const int iterations = std::max(1, numberOfIterations);
+
+	CGPUCacheManifest	xmlManifest;
+	CGPUCacheManifest	binaryManifest;
+
+	for (int i=0; i<iterations; ++i)
+	{
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		if (false == xmlManifest.LoadFromXML(filename) )
+			return false;
+		report.xmlTime += ElapsedMs(start);
+
+		start = BenchmarkClock::now();
+		if (false == binaryManifest.LoadBinary(binaryFilename.c_str() ) )
+			return false;
+		report.binaryTime += ElapsedMs(start);
+	}
+
+	report.numberOfIterations = iterations;
+	report.xmlTime /= (double) iterations;
+	report.binaryTime /= (double) iterations;
+	report.numberOfModels = (int) binaryManifest.GetModels().size();
+	report.numberOfPatches = (int) binaryManifest.GetPatches().size();
+	report.equal = CompareManifests( xmlManifest, binaryManifest );
+
+	return true;
+}
+
+void PrintManifestReport( const GPUCacheManifestReport &report )
+{
+	printf( "manifest benchmark (ms, average of %d loads) - %d models, %d patches\n", report.numberOfIterations, report.numberOfModels, report.numberOfPatches );
+	printf( "  xml                %10.2f  (%.2f MB)\n", report.xmlTime, (double) report.xmlSize / (1024.0 * 1024.0) );
+	printf( "  binary             %10.2f  (%.2f MB)\n", report.binaryTime, (double) report.binarySize / (1024.0 * 1024.0) );
+	printf( "  speedup            %10.2f  (records are %s)\n", (report.binaryTime > 0.0) ? report.xmlTime / report.binaryTime : 0.0, 
+		(report.equal) ? "equal" : "DIFFERENT" );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tests
+
+bool TestLoadersChecksum()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(64, 1024, 8, 8, 64, options);
+	options.patchesPerModel = 3;
+	options.numberOfSequences = 2;
+	options.sequenceFrames = 8;
+	options.sequenceSize = 64;
+
+	CGPUCacheSaver saver;
+	GPUCacheBenchmarkReport report;
+	GPUCacheBenchmarkReport::Clear(report);
+
+	if (false == GenerateSyntheticCache( BENCHMARK_TEST_FILENAME, options, saver, &report ) )
+		return false;
+
+	CGPUCacheNullVisitor serialVisitor(true);
+	CGPUCacheNullVisitor pipelinedVisitor(true);
+
+	if (false == BenchmarkCacheLoad( BENCHMARK_TEST_FILENAME, 1, false, &serialVisitor, report ) )
+		return false;
+	if (false == BenchmarkCacheLoad( BENCHMARK_TEST_FILENAME, 1, true, &pipelinedVisitor, report ) )
+		return false;
+
+	printf( "  checksum serial %u, pipelined %u, models %d\n", serialVisitor.GetChecksum(), pipelinedVisitor.GetChecksum(), report.numberOfModels );
+	return (serialVisitor.GetChecksum() == pipelinedVisitor.GetChecksum() && report.numberOfModels == options.numberOfModels);
+}
+
+bool TestRayPicking()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(256, 1024, 1, 0, 0, options);
+
+	GPUCachePickingReport report;
+	if (false == BenchmarkRayPicking( options, 10000, 0, report ) )
+		return false;
+
+	PrintPickingReport(report);
+
+	// targets are on the model squares, only a few rays could pass by the shapes
+	return (report.numberOfHits * 10 >= report.numberOfRays * 9);
+}
+
+// counts the geometry callbacks, models could be rejected
+class CGPUCacheModelsBeginVisitor : public CGPUCacheNullVisitor
+{
+public:
+	//! a constructor
+	CGPUCacheModelsBeginVisitor(const bool acceptModels)
+		: CGPUCacheNullVisitor(false)
+		, mAcceptModels(acceptModels)
+		, mNumberOfBegins(0)
+		, mNumberOfTakes(0)
+		, mNumberOfEarlyTakes(0)
+		, mNumberOfFullTakes(0)
+		, mNumberOfVertexData(0)
+	{}
+
+	bool	mAcceptModels;
+	int		mNumberOfBegins;
+	int		mNumberOfTakes;
+	int		mNumberOfEarlyTakes;		// merged staging before the models begin
+	int		mNumberOfFullTakes;			// staging has the pack totals
+	int		mNumberOfVertexData;
+
+	// slow textures replay keeps the geometry worker well ahead of the gl thread
+	virtual void OnReadTexturesEnd() override
+	{
+		std::this_thread::sleep_for( std::chrono::milliseconds(50) );
+	}
+	virtual bool OnReadModelsBegin(const int numberOfModels, const int numberOfMeshes, const double *bounding_min, const double *bounding_max) override
+	{
+		mNumberOfBegins += 1;
+		return mAcceptModels;
+	}
+	virtual void OnTakeMergedVertexData( const FileGeometryHeader *pHeader, const BYTE *data, VertexMergeStaging &staging ) override
+	{
+		mNumberOfTakes += 1;
+		if (mNumberOfBegins == 0)
+			mNumberOfEarlyTakes += 1;
+		if ((int) staging.positions.size() == pHeader->totalNumberOfVertices && (int) staging.normals.size() == pHeader->totalNumberOfVertices
+			&& (int) staging.indices.size() == pHeader->totalNumberOfIndices)
+		{
+			mNumberOfFullTakes += 1;
+		}
+	}
+	virtual void OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) override
+	{
+		mNumberOfVertexData += 1;
+	}
+};
+
+bool TestPipelinedModelsBegin()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(256, 1024, 4, 8, 256, options);
+
+	CGPUCacheSaver saver;
+	if (false == GenerateSyntheticCache( BENCHMARK_TEST_FILENAME, options, saver ) )
+		return false;
+
+	bool result = true;
+
+	for (int i=0; i<2; ++i)
+	{
+		const bool accept = (i == 0);
+		CGPUCacheModelsBeginVisitor		visitor(accept);
+
+		CGPUCacheLoaderPipelined		loader;
+		if (false == loader.Load( BENCHMARK_TEST_FILENAME, &visitor ) )
+			return false;
+
+		// the worker merges without waiting for the models begin, so the merge starts during the slow textures replay
+		//	(a worker which waits for the replayed models begin has no overlap at all)
+		const GPUCacheLoaderTimings &timings = loader.GetTimings();
+
+		printf( "  %s - begins %d, takes %d (early %d, full %d), vertex data %d, merge %.2f ms (%.2f ms during the textures replay)\n", 
+			(accept) ? "accepted" : "rejected", visitor.mNumberOfBegins, visitor.mNumberOfTakes, visitor.mNumberOfEarlyTakes, 
+			visitor.mNumberOfFullTakes, visitor.mNumberOfVertexData, timings.geometryMerge, timings.mergeOverlap );
+
+		result = result && (visitor.mNumberOfBegins == 1) && (visitor.mNumberOfEarlyTakes == 0)
+			&& (visitor.mNumberOfTakes == ((accept) ? 1 : 0) ) && (visitor.mNumberOfFullTakes == visitor.mNumberOfTakes)
+			&& (visitor.mNumberOfVertexData == ((accept) ? 1 : 0) )
+			&& (timings.geometryMerge > 0.0) && (timings.mergeOverlap > 0.0);
+	}
+
+	return result;
+}
+
+bool TestManifest()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(100000, 4, 32, 0, 0, options);
+	options.patchesPerModel = 2;
+
+	CGPUCacheSaver saver;
+	if (false == GenerateSyntheticCache( BENCHMARK_TEST_FILENAME, options, saver ) )
+		return false;
+
+	GPUCacheManifestReport report;
+	if (false == BenchmarkManifest( BENCHMARK_TEST_FILENAME, 3, report ) )
+		return false;
+
+	PrintManifestReport(report);
+	return (report.equal && report.numberOfModels == options.numberOfModels && report.binaryTime < report.xmlTime);
+}
+
+bool TestPackAccess()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(1000, 4096, 16, 16, 512, options);
+
+	CGPUCacheSaver saver;
+	if (false == GenerateSyntheticCache( BENCHMARK_TEST_FILENAME, options, saver ) )
+		return false;
+
+	GPUCacheMappingReport report;
+	if (false == BenchmarkPackAccess( BENCHMARK_TEST_FILENAME, 3, report ) )
+		return false;
+
+	PrintMappingReport(report);
+	return (report.checksum[eBenchmarkPackMapped] == report.checksum[eBenchmarkPackCopy]);
+}
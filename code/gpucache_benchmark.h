@@ -0,0 +1,439 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_benchmark.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_saver.h"
+#include "gpucache_loader.h"
+
+#include <string.h>
+#include <vector>
+#include <string>
+
+//
+// saver / loader benchmark
+//	a synthetic scene is written through the saver query and loaded back with a null visitor,
+//	no gl calls are made on both sides, so it could be run without a window (build machine, tools)
+//
+
+//////////////////////////////////////////////////////////////////////////
+// synthetic scene description
+
+struct GPUCacheSyntheticOptions
+{
+	int			numberOfModels;
+	int			verticesPerModel;		// grid of quads, rounded to the square side
+	int			patchesPerModel;		// index ranges with a different material
+	int			numberOfMaterials;
+	int			meshVariations;			// different model shapes, models repeat them in order, 0 - each model is unique
+
+	int			numberOfTextures;		// still images, one sampler for each
+	int			textureSize;			// RGBA8 width and height
+	int			textureVariations;		// different images, textures repeat them in order, 0 - each texture is unique
+
+	int			numberOfSequences;		// image sequences, one sampler for each
+	int			sequenceFrames;
+	int			sequenceSize;
+
+	bool		shuffleTriangles;		// random triangle order inside each patch, like an unoptimized export
+
+	unsigned int	seed;
+
+	static void Set(const int _models, const int _vertices, const int _materials, const int _textures, const int _textureSize,
+		GPUCacheSyntheticOptions &options)
+	{
+		options.numberOfModels = _models;
+		options.verticesPerModel = _vertices;
+		options.patchesPerModel = 1;
+		options.numberOfMaterials = _materials;
+		options.meshVariations = 7;
+		options.numberOfTextures = _textures;
+		options.textureSize = _textureSize;
+		options.textureVariations = 0;
+		options.numberOfSequences = 0;
+		options.sequenceFrames = 0;
+		options.sequenceSize = 0;
+		options.shuffleTriangles = false;
+		options.seed = 1;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+// saver query which generates the scene content, images are generated in Init
+//	and stay in memory until the query is destroyed
+
+class CGPUCacheSyntheticQuery : public CGPUCacheSaverQuery
+{
+public:
+	//! a constructor
+	CGPUCacheSyntheticQuery(const GPUCacheSyntheticOptions &options);
+	//! a destructor
+	virtual ~CGPUCacheSyntheticQuery();
+
+	virtual bool Init(const char *filename) override;
+
+	virtual const char *GetSourceFilename() override
+	{
+		return "synthetic";
+	}
+
+	// lights
+
+	virtual const char *GetLightName(const int index) override
+	{
+		return "";
+	}
+	virtual void GetLightPosition(const int index, vec4 &pos) override
+	{}
+	virtual void GetLightDirection(const int index, vec4 &dir) override
+	{}
+	virtual void GetLightColor(const int index, vec4 &color) override
+	{}
+	virtual void GetLightAttenuation(const int index, vec4 &att) override
+	{}
+	virtual void GetLightShadowing(const int index, bool &castshadow) override
+	{}
+
+	// textures
+
+	virtual const int GetVideoCount() override;
+	virtual const char *GetVideoName(const int index) override;
+	virtual const int GetVideoWidth(const int index) override;
+	virtual const int GetVideoHeight(const int index) override;
+	virtual const int GetVideoFormat(const int index, GLint &internalFormat, GLint &format) override;
+	virtual const bool IsVideoImageSequence(const int index) override;
+	virtual const int GetVideoStartFrame(const int index) override;
+	virtual const int GetVideoStopFrame(const int index) override;
+	virtual const int GetVideoFrameRate(const int index) override;
+	virtual const char *GetVideoFilename(const int index) override;
+	virtual const double GetVideoSize(const int index) override;
+	virtual const bool IsVideoUsedMipmaps(const int index) override;
+	virtual const unsigned char *GetVideoData(const int index) override;
+	virtual const bool IsVideoDataThreadSafe() override
+	{
+		return true;
+	}
+	virtual double GetTotalUncompressedSize() override;
+
+	virtual const int GetSamplersCount() override;
+	virtual const char *GetSamplerName(const int index) override;
+	virtual const int GetSamplerVideoIndex(const int index) override;
+	virtual void GetSamplerMatrix( const int index, mat4 &mat ) override;
+
+	// materials and shaders
+
+	virtual const int GetMaterialsCount() override;
+	virtual const char *GetMaterialName(const int index) override;
+	virtual void ConvertMaterial(const int index, MaterialGLSL &data) override;
+
+	virtual const int GetShadersCount() override;
+	virtual const char *GetShaderName(const int index) override;
+	virtual const int GetShaderAlphaSource(const int index) override;
+	virtual void ConvertShader(const int index, ShaderGLSL &data) override;
+
+	// models
+
+	virtual const int GetModelsCount() override;
+	virtual const int GetSubMeshesCount() override;
+	virtual const unsigned int GetTotalCounts(unsigned int &vertices, unsigned int &indices) override;
+	virtual void GetBoundingBox(vec4 &bmin, vec4 &bmax) override;
+
+	virtual const char *GetModelName(const int modelId) override;
+	virtual const int GetModelVisible(const int modelId) override;
+	virtual const int GetModelCastsShadows(const int modelId) override;
+	virtual const int GetModelReceiveShadows(const int modelId) override;
+	virtual void GetModelMatrix(const int modelId, mat4 &mat) override;
+	virtual void GetModelTranslation(const int modelId, vec4 &pos) override;
+	virtual void GetModelRotation(const int modelId, vec4 &rot) override;
+	virtual void GetModelScaling(const int modelId, vec4 &scaling) override;
+	virtual void GetModelBoundingBox(const int modelId, vec4 &bmin, vec4 &bmax) override;
+
+	virtual const int GetModelVertexCount(const int modelId) override;
+	virtual const int GetModelUVCount(const int modelId) override;
+
+	virtual void ModelVertexArrayRequest(const int modelId) override;
+	virtual const float *GetModelVertexArrayPoint( const bool afterDeform ) override;
+	virtual const float *GetModelVertexArrayNormal( const bool afterDeform ) override;
+	virtual const float *GetModelVertexArrayTangent( const bool afterDeform ) override;
+	virtual const float *GetModelVertexArrayUV( const int uvset, const bool afterDeform ) override;
+	virtual const int *GetModelIndexArray() override;
+	virtual void ModelVertexArrayRelease() override;
+
+	virtual const int GetModelVertexArrayPointStride(const int modelId) override;
+	virtual const int GetModelVertexArrayNormalStride(const int modelId) override;
+	virtual const int GetModelVertexArrayTangentStride(const int modelId) override;
+	virtual const int GetModelVertexArrayUVStride(const int modelId) override;
+
+	virtual const int GetModelSubPatchCount(const int index) override;
+	virtual void GetModelSubPatchInfo(const int modelid, const int patchid, int &offset, int &size, int &materialId) override;
+
+	virtual const unsigned int GetModelShadersCount(const int index) override;
+	virtual const int GetModelShaderId(const int index, const int nshader) override;
+
+protected:
+
+	GPUCacheSyntheticOptions				mOptions;
+
+	int										mGridSide;		// vertices in one row of the model grid
+	std::vector<std::vector<unsigned char>>	mImages;
+	std::vector<std::string>				mNames;			// models, videos and materials names
+
+	// vertex arrays of the requested model, they are valid until the next request
+	std::vector<float>		mPoints;
+	std::vector<float>		mNormals;
+	std::vector<float>		mTangents;
+	std::vector<float>		mUVs;
+	std::vector<int>		mIndices;
+
+	const int GetNumberOfIndices() const;
+	const bool IsSequenceVideo(const int index) const
+	{
+		return index >= mOptions.numberOfTextures;
+	}
+	const int GetVideoSide(const int index) const
+	{
+		return (IsSequenceVideo(index)) ? mOptions.sequenceSize : mOptions.textureSize;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+// visitor which doesn't upload anything, data could be touched to page in the mapped packs
+
+class CGPUCacheNullVisitor : public CGPUCacheLoaderVisitor
+{
+public:
+	//! a constructor
+	CGPUCacheNullVisitor(const bool touchData=true);
+
+	virtual void OnReadHeader(const char *xmlFilename, const char *sourceFilename) override
+	{}
+
+	virtual bool OnReadTexturesBegin( const char *textures_filename, const int numberOfSamplers, const int numberOfImages ) override
+	{
+		return true;
+	}
+	virtual void OnReadTexturesImage1(const ImageHeader *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override;
+	virtual void OnReadTexturesImage2(const BYTE type, const ImageHeader2 *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override;
+	virtual void OnReadEmptyImage() override
+	{}
+	virtual void OnReadTexturesSampler(const char *samplerName, const char *clipFile, const SamplerHeader *header, const size_t fileSamplerOffset, const size_t samplerSize, const BYTE *samplerData) override
+	{}
+	virtual void OnReadTexturesError(const char *what) override
+	{}
+	virtual void OnReadTexturesEnd() override
+	{}
+
+	virtual bool OnReadMaterialsBegin(const int numberOfMaterials) override
+	{
+		return true;
+	}
+	virtual void OnReadMaterial(const char *material_name, const MaterialGLSL &material ) override
+	{}
+	virtual void OnReadMaterialsEnd() override
+	{}
+
+	virtual bool OnReadShadersBegin(const int numberOfShaders) override
+	{
+		return true;
+	}
+	virtual void OnReadShader(const char *shader_name, const int alphatype, const ShaderGLSL &shaderData ) override
+	{}
+	virtual void OnReadShadersEnd() override
+	{}
+
+	virtual bool OnReadModelsBegin(const int numberOfModels, const int numberOfMeshes, const double *bounding_min, const double *bounding_max) override
+	{
+		return true;
+	}
+	virtual void OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) override;
+	virtual void OnReadModel(const char *name, const double *translation, const double *rotation, const double *scaling,
+		const double *bounding_min, const double *bounding_max, const int numberOfShaders, const int *shaders,
+		const VertexDataHeader *pheader, const BYTE *data) override
+	{}
+	virtual void OnReadModelPatch(const int offset, const int size, const int materialId) override
+	{}
+	virtual void OnReadModelFinish() override
+	{}
+	virtual void OnReadModelsEnd() override
+	{}
+
+	// sum of the touched bytes, keeps the reads from being optimized out
+	const unsigned int GetChecksum() const
+	{
+		return mChecksum;
+	}
+
+protected:
+
+	bool			mTouchData;
+	unsigned int	mChecksum;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// benchmark report, times are in milliseconds
+
+struct GPUCacheBenchmarkReport
+{
+	double		saveTime;
+
+	double		manifestRead;		// binary manifest or xml parse
+	double		texturesWalk;		// textures pack, without the visitor callbacks
+	double		materialsWalk;		// materials and shaders
+	double		geometryWalk;		// geometry pack, without the visitor callbacks
+	double		visitorCallbacks;	// time spent inside the visitor
+	double		loadTime;			// average of all iterations
+
+	int			numberOfIterations;
+	int			numberOfImages;
+	int			numberOfModels;
+
+	size_t		texturesSize;		// bytes of the packs
+	size_t		geometrySize;
+	size_t		manifestSize;		// binary manifest or xml
+
+	double		throughput;			// MB/s of the packs in the load time
+	size_t		peakMemory;			// peak working set of the process
+
+	static void Clear(GPUCacheBenchmarkReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheBenchmarkReport) );
+	}
+};
+
+// write a synthetic cache (xml, binary manifest and packs), saver is configured by the caller
+bool GenerateSyntheticCache( const char *filename, const GPUCacheSyntheticOptions &options, CGPUCacheSaver &saver, GPUCacheBenchmarkReport *report=nullptr );
+
+// load the cache a number of times, visitor - nullptr to use the null visitor
+//	pipelined - use CGPUCacheLoaderPipelined, phases come from its timings then
+bool BenchmarkCacheLoad( const char *filename, const int numberOfIterations, const bool pipelined, CGPUCacheLoaderVisitor *visitor,
+	GPUCacheBenchmarkReport &report );
+
+void PrintBenchmarkReport( const GPUCacheBenchmarkReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// triangle picking benchmark, hierarchies are built from the synthetic models in memory (no cache files, no gl)
+
+struct GPUCachePickingReport
+{
+	int			numberOfModels;
+	int			numberOfTriangles;
+	int			numberOfThreads;
+
+	double		buildTimeSingle;	// one thread
+	double		buildTime;			// with the given number of threads
+	size_t		memorySize;			// nodes and triangle records
+
+	int			numberOfRays;
+	int			numberOfHits;
+	double		castTime;
+	double		raysPerSecond;
+
+	static void Clear(GPUCachePickingReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCachePickingReport) );
+	}
+};
+
+// rays go from above the scene to the random points of the models, numberOfThreads - 0 to use the hardware threads
+bool BenchmarkRayPicking( const GPUCacheSyntheticOptions &options, const int numberOfRays, const int numberOfThreads, GPUCachePickingReport &report );
+
+void PrintPickingReport( const GPUCachePickingReport &report );
+
+// size of a file in bytes, 0 if it doesn't exist
+size_t GetBenchmarkFileSize( const char *filename );
+// <cache>_Textures.pck, <cache>_Geometry.pck for the <cache>.xml
+std::string MakeBenchmarkPackFilename( const char *filename, const char *suffix );
+
+// random camera over the synthetic scene grid, low views are at the model height, others look from above
+//	projection and modelview are column major, state is the lcg state of the caller
+void MakeBenchmarkView( const GPUCacheSyntheticOptions &options, const bool lowView, unsigned int &state, float *projection, float *modelview, float *eye );
+
+// peak working set of the process in bytes, 0 if it's not supported
+size_t GetPeakProcessMemory();
+// current working set (resident pages, mapped files included), 0 if it's not supported
+//	privateMemory - resident pages which are not backed by files (heap)
+size_t GetCurrentProcessMemory(size_t *privateMemory=nullptr);
+
+//////////////////////////////////////////////////////////////////////////
+// mapped packs vs packs read into the heap buffers (CGPUCacheLoader::SetUseFileMapping)
+
+enum EBenchmarkPackAccess
+{
+	eBenchmarkPackMapped,
+	eBenchmarkPackCopy,
+	eBenchmarkPackAccessCount
+};
+
+struct GPUCacheMappingReport
+{
+	int			numberOfIterations;
+	size_t		packsSize;
+
+	double		firstCallback[eBenchmarkPackAccessCount];	// ms from the Load call to the first image or vertex data callback
+	double		loadTime[eBenchmarkPackAccessCount];
+	size_t		peakMemory[eBenchmarkPackAccessCount];		// max working set in the callbacks above the one before the load
+	size_t		peakPrivate[eBenchmarkPackAccessCount];		// the same for the pages not backed by files
+	unsigned int	checksum[eBenchmarkPackAccessCount];	// touched data of one load
+
+	static void Clear(GPUCacheMappingReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheMappingReport) );
+	}
+};
+
+// serial loader with the null visitor (data pages are touched), modes go one after another in each iteration
+bool BenchmarkPackAccess( const char *filename, const int numberOfIterations, GPUCacheMappingReport &report );
+
+void PrintMappingReport( const GPUCacheMappingReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// xml manifest vs binary manifest of the same cache
+
+struct GPUCacheManifestReport
+{
+	int			numberOfIterations;
+	int			numberOfModels;
+	int			numberOfPatches;
+
+	size_t		xmlSize;
+	size_t		binarySize;
+
+	double		xmlTime;		// LoadFromXML (document parse and records), average
+	double		binaryTime;		// LoadBinary, average
+
+	bool		equal;			// both give the same records
+
+	static void Clear(GPUCacheManifestReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheManifestReport) );
+	}
+};
+
+bool BenchmarkManifest( const char *filename, const int numberOfIterations, GPUCacheManifestReport &report );
+
+void PrintManifestReport( const GPUCacheManifestReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// tests of the benchmark host, each returns false on a failed check, numbers go to the stdout
+
+#define BENCHMARK_TEST_FILENAME		"benchmark_test.xml"
+
+// serial and pipelined loaders pass the same data to the visitor
+bool TestLoadersChecksum();
+// most of the rays hit the synthetic models
+bool TestRayPicking();
+// mapped and copied packs give the same data, time to the first callback and working set are printed
+bool TestPackAccess();
+// pipelined loader prepares the vertex data only after the visitor has accepted the models
+bool TestPipelinedModelsBegin();
+// 100k models, binary manifest gives the xml records and is read faster
+bool TestManifest();
@@ -0,0 +1,1604 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_benchmarkGeometry.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_benchmarkGeometry.h"
+#include "gpucache_vertexMerge.h"
+#include "algorithm/VertexQuantization.h"
+#include "algorithm/MeshOptimize.h"
+#include "algorithm/MeshClusters.h"
+#include "IO/FileMapping.h"
+#include "IO/FileIO.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+#include <chrono>
+#include <thread>
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#define QUANTIZED_TEST_FILENAME		"benchmark_test_quantized.xml"
+#define OPTIMIZED_TEST_FILENAME		"benchmark_test_optimized.xml"
+#define INSTANCED_TEST_FILENAME		"benchmark_test_instanced.xml"
+#define CLUSTERS_TEST_FILENAME		"benchmark_test_clusters.xml"
+#define LODS_TEST_FILENAME			"benchmark_test_lods.xml"
+#define PARTIAL_TEST_FILENAME		"benchmark_test_partial.xml"
+#define NOTOC_TEST_FILENAME			"benchmark_test_notoc.xml"
+
+#define MERGE_STREAM_BYTES			(gPointStride + gNormalStride + gTangentStride + gUVStride)
+
+typedef std::chrono::high_resolution_clock	BenchmarkClock;
+
+static double ElapsedMs( const BenchmarkClock::time_point &start )
+{
+	return std::chrono::duration<double, std::milli>( BenchmarkClock::now() - start ).count();
+}
+
+static double AngleDegrees( const float *a, const float *b )
+{
+	const double la = sqrt( (double) a[0]*a[0] + (double) a[1]*a[1] + (double) a[2]*a[2] );
+	const double lb = sqrt( (double) b[0]*b[0] + (double) b[1]*b[1] + (double) b[2]*b[2] );
+
+	if (la == 0.0 || lb == 0.0)
+		return 0.0;
+
+	const double d = ((double) a[0]*b[0] + (double) a[1]*b[1] + (double) a[2]*b[2]) / (la * lb);
+	return acos( std::max(-1.0, std::min(1.0, d)) ) * 180.0 / 3.14159265358979323846;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// merged streams of a geometry pack
+
+struct MergedGeometry
+{
+	int						numberOfVertices;
+	int						numberOfIndices;
+
+	std::vector<float>		positions;
+	std::vector<float>		normals;
+	std::vector<float>		tangents;
+	std::vector<float>		uvs;
+	std::vector<unsigned int>	indices;
+};
+
+// average time of the merge in ms, -1.0 on a failure
+static double MergeGeometryPack( const char *filename, const int numberOfIterations, MergedGeometry &geometry, size_t &packSize )
+{
+	CFileMapping	mapping;
+
+	const std::string packFilename = MakeBenchmarkPackFilename( filename, "_Geometry.pck" );
+	if (false == mapping.Open(packFilename.c_str() ) || mapping.GetSize() < sizeof(FileGeometryHeader) )
+		return -1.0;
+
+	packSize = mapping.GetSize();
+
+	const FileGeometryHeader *header = (const FileGeometryHeader*) mapping.GetData();
+
+	geometry.numberOfVertices = header->totalNumberOfVertices;
+	geometry.numberOfIndices = header->totalNumberOfIndices;
+
+	geometry.positions.resize( 4 * geometry.numberOfVertices );
+	geometry.normals.resize( 4 * geometry.numberOfVertices );
+	geometry.tangents.resize( 4 * geometry.numberOfVertices );
+	geometry.uvs.resize( 2 * geometry.numberOfVertices );
+	geometry.indices.resize( geometry.numberOfIndices );
+
+	VertexMergeTarget	target;
+	VertexMergeTarget::Set( geometry.positions.data(), geometry.normals.data(), geometry.tangents.data(), geometry.uvs.data(), 
+		geometry.indices.data(), target );
+
+	const int iterations = std::max(1, numberOfIterations);
+	const BenchmarkClock::time_point start = BenchmarkClock::now();
+
+	for (int i=0; i<iterations; ++i)
+	{
+		if (false == MergeGeometryStreams( mapping.GetData(), target ) )
+			return -1.0;
+	}
+
+	return ElapsedMs(start) / (double) iterations;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// quantization
+
+bool BenchmarkQuantization( const GPUCacheSyntheticOptions &options, const int numberOfIterations, GPUCacheQuantizationReport &report )
+{
+	GPUCacheQuantizationReport::Clear(report);
+
+	CGPUCacheSaver	floatSaver;
+	CGPUCacheSaver	quantizedSaver;
+	quantizedSaver.SetQuantizeVertices(true);
+
+	if (false == GenerateSyntheticCache( BENCHMARK_TEST_FILENAME, options, floatSaver ) 
+		|| false == GenerateSyntheticCache( QUANTIZED_TEST_FILENAME, options, quantizedSaver ) )
+	{
+		return false;
+	}
+
+	MergedGeometry	floatGeometry;
+	MergedGeometry	quantizedGeometry;
+
+	report.floatMerge = MergeGeometryPack( BENCHMARK_TEST_FILENAME, numberOfIterations, floatGeometry, report.floatPackSize );
+	report.quantizedMerge = MergeGeometryPack( QUANTIZED_TEST_FILENAME, numberOfIterations, quantizedGeometry, report.quantizedPackSize );
+
+	if (report.floatMerge < 0.0 || report.quantizedMerge < 0.0 
+		|| floatGeometry.numberOfVertices != quantizedGeometry.numberOfVertices 
+		|| floatGeometry.indices != quantizedGeometry.indices)
+	{
+		return false;
+	}
+
+	const int numberOfVertices = floatGeometry.numberOfVertices;
+
+	report.numberOfVertices = numberOfVertices;
+	report.numberOfIterations = std::max(1, numberOfIterations);
+
+	for (int i=0; i<numberOfVertices; ++i)
+	{
+		const float *fp = &floatGeometry.positions[4*i];
+		const float *qp = &quantizedGeometry.positions[4*i];
+
+		const double dx = fp[0] - qp[0];
+		const double dy = fp[1] - qp[1];
+		const double dz = fp[2] - qp[2];
+		report.positionError = std::max( report.positionError, sqrt(dx*dx + dy*dy + dz*dz) );
+
+		report.normalError = std::max( report.normalError, AngleDegrees( &floatGeometry.normals[4*i], &quantizedGeometry.normals[4*i] ) );
+		report.tangentError = std::max( report.tangentError, AngleDegrees( &floatGeometry.tangents[4*i], &quantizedGeometry.tangents[4*i] ) );
+
+		if ( (floatGeometry.tangents[4*i+3] < 0.0f) != (quantizedGeometry.tangents[4*i+3] < 0.0f) )
+			report.tangentSignErrors += 1;
+
+		for (int j=0; j<2; ++j)
+			report.uvError = std::max( report.uvError, (double) fabs( floatGeometry.uvs[2*i+j] - quantizedGeometry.uvs[2*i+j] ) );
+	}
+
+	// codec alone, the whole merged stream is one array here (the saver does it per model)
+	float bmin[3], bsize[3];
+	ComputePointsBounds( floatGeometry.positions.data(), 16, numberOfVertices, bmin, bsize );
+
+	std::vector<unsigned short>	points(4 * numberOfVertices);
+	std::vector<short>			normals(2 * numberOfVertices);
+	std::vector<short>			tangents(2 * numberOfVertices);
+	std::vector<unsigned short>	uvs(2 * numberOfVertices);
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	for (int i=0; i<report.numberOfIterations; ++i)
+	{
+		QuantizePositions( floatGeometry.positions.data(), 16, numberOfVertices, bmin, bsize, points.data() );
+		QuantizeNormals( floatGeometry.normals.data(), 16, numberOfVertices, normals.data() );
+		QuantizeTangents( floatGeometry.tangents.data(), 16, numberOfVertices, tangents.data() );
+		QuantizeUVs( floatGeometry.uvs.data(), 8, numberOfVertices, uvs.data() );
+	}
+	const double encodeTime = ElapsedMs(start) / (double) report.numberOfIterations;
+
+	start = BenchmarkClock::now();
+	for (int i=0; i<report.numberOfIterations; ++i)
+	{
+		DequantizePositions( points.data(), numberOfVertices, bmin, bsize, quantizedGeometry.positions.data() );
+		DequantizeNormals( normals.data(), numberOfVertices, quantizedGeometry.normals.data() );
+		DequantizeTangents( tangents.data(), numberOfVertices, quantizedGeometry.tangents.data() );
+		DequantizeUVs( uvs.data(), numberOfVertices, quantizedGeometry.uvs.data() );
+	}
+	const double decodeTime = ElapsedMs(start) / (double) report.numberOfIterations;
+
+	report.encodeRate = (encodeTime > 0.0) ? 0.001 * (double) numberOfVertices / encodeTime : 0.0;
+	report.decodeRate = (decodeTime > 0.0) ? 0.001 * (double) numberOfVertices / decodeTime : 0.0;
+
+	return true;
+}
+
+void PrintQuantizationReport( const GPUCacheQuantizationReport &report )
+{
+	printf( "quantization benchmark - %d vertices, average of %d runs\n", report.numberOfVertices, report.numberOfIterations );
+	printf( "  geometry pack      %10.2f MB float, %.2f MB quantized (%.1f%%)\n", (double) report.floatPackSize / (1024.0 * 1024.0), 
+		(double) report.quantizedPackSize / (1024.0 * 1024.0), 
+		(report.floatPackSize > 0) ? 100.0 * (double) report.quantizedPackSize / (double) report.floatPackSize : 0.0 );
+	printf( "  position error     %10.6f max\n", report.positionError );
+	printf( "  normal error       %10.4f deg max\n", report.normalError );
+	printf( "  tangent error      %10.4f deg max, %d handedness errors\n", report.tangentError, report.tangentSignErrors );
+	printf( "  uv error           %10.6f max\n", report.uvError );
+	printf( "  merge              %10.2f ms float, %.2f ms quantized\n", report.floatMerge, report.quantizedMerge );
+	printf( "  codec              %10.1f M vertices/s encode, %.1f M vertices/s decode\n", report.encodeRate, report.decodeRate );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// index optimization
+
+// triangles by vertex positions, the smallest vertex goes first to keep the winding
+typedef std::array<float, 9>	PositionTriangle;
+
+static void CollectTriangles( const MergedGeometry &geometry, std::vector<PositionTriangle> &triangles )
+{
+	const int numberOfTriangles = geometry.numberOfIndices / 3;
+	triangles.resize(numberOfTriangles);
+
+	for (int i=0; i<numberOfTriangles; ++i)
+	{
+		const unsigned int *tri = &geometry.indices[i*3];
+		
+		int first = 0;
+		for (int k=1; k<3; ++k)
+		{
+			if (std::lexicographical_compare( &geometry.positions[4*tri[k]], &geometry.positions[4*tri[k]] + 3,
+				&geometry.positions[4*tri[first]], &geometry.positions[4*tri[first]] + 3 ) )
+			{
+				first = k;
+			}
+		}
+
+		PositionTriangle &triangle = triangles[i];
+		for (int k=0; k<3; ++k)
+		{
+			const float *point = &geometry.positions[4 * tri[(first + k) % 3]];
+			triangle[k*3] = point[0];
+			triangle[k*3+1] = point[1];
+			triangle[k*3+2] = point[2];
+		}
+	}
+
+	std::sort( begin(triangles), end(triangles) );
+}
+
+bool BenchmarkIndexOptimization( const GPUCacheSyntheticOptions &options, const int numberOfIterations, GPUCacheIndexReport &report )
+{
+	GPUCacheIndexReport::Clear(report);
+
+	GPUCacheSyntheticOptions shuffledOptions(options);
+	shuffledOptions.shuffleTriangles = true;
+
+	CGPUCacheSaver	plainSaver;
+	CGPUCacheSaver	optimizedSaver;
+	optimizedSaver.SetOptimizeIndices(true);
+
+	GPUCacheBenchmarkReport	plainReport, optimizedReport;
+	GPUCacheBenchmarkReport::Clear(plainReport);
+	GPUCacheBenchmarkReport::Clear(optimizedReport);
+
+	if (false == GenerateSyntheticCache( BENCHMARK_TEST_FILENAME, shuffledOptions, plainSaver, &plainReport ) 
+		|| false == GenerateSyntheticCache( OPTIMIZED_TEST_FILENAME, shuffledOptions, optimizedSaver, &optimizedReport ) )
+	{
+		return false;
+	}
+
+	report.plainSave = plainReport.saveTime;
+	report.optimizedSave = optimizedReport.saveTime;
+
+	VertexCacheStatistics before, after;
+	optimizedSaver.GetCacheStatistics( before, after );
+
+	report.numberOfModels = options.numberOfModels;
+	report.numberOfTriangles = (int) before.numberOfTriangles;
+	report.acmrBefore = before.acmr;
+	report.atvrBefore = before.atvr;
+	report.acmrAfter = after.acmr;
+	report.atvrAfter = after.atvr;
+
+	// the same triangles have to be in the packs, only the order and the vertex numbers are changed
+	MergedGeometry	plainGeometry;
+	MergedGeometry	optimizedGeometry;
+	size_t			packSize = 0;
+
+	if (MergeGeometryPack( BENCHMARK_TEST_FILENAME, 1, plainGeometry, packSize ) < 0.0 
+		|| MergeGeometryPack( OPTIMIZED_TEST_FILENAME, 1, optimizedGeometry, packSize ) < 0.0 )
+	{
+		return false;
+	}
+
+	std::vector<PositionTriangle>	plainTriangles;
+	std::vector<PositionTriangle>	optimizedTriangles;
+
+	CollectTriangles( plainGeometry, plainTriangles );
+	CollectTriangles( optimizedGeometry, optimizedTriangles );
+
+	report.trianglesPreserved = (plainTriangles == optimizedTriangles);
+
+	// the optimizer alone on the indices of the first model
+	CGPUCacheSyntheticQuery	query(shuffledOptions);
+	query.ModelVertexArrayRequest(0);
+
+	// patches split all the triangles of the model
+	int offset, size, materialId;
+	query.GetModelSubPatchInfo( 0, query.GetModelSubPatchCount(0) - 1, offset, size, materialId );
+	
+	const int numberOfIndices = offset + size;
+	const int numberOfVertices = query.GetModelVertexCount(0);
+	const unsigned int *modelIndices = (const unsigned int*) query.GetModelIndexArray();
+
+	std::vector<unsigned int>	indices(numberOfIndices);
+
+	report.numberOfIterations = std::max(1, numberOfIterations);
+
+	const BenchmarkClock::time_point start = BenchmarkClock::now();
+	for (int i=0; i<report.numberOfIterations; ++i)
+		OptimizeVertexCache( indices.data(), modelIndices, numberOfIndices, numberOfVertices );
+	const double optimizeTime = ElapsedMs(start) / (double) report.numberOfIterations;
+	
+	report.optimizeRate = (optimizeTime > 0.0) ? 0.001 * (double) (numberOfIndices / 3) / optimizeTime : 0.0;
+
+	return true;
+}
+
+void PrintIndexReport( const GPUCacheIndexReport &report )
+{
+	printf( "index optimization benchmark - %d models, %d triangles, fifo of %d\n", report.numberOfModels, report.numberOfTriangles, MESH_SIMULATE_CACHE_SIZE );
+	printf( "  acmr               %10.3f shuffled, %.3f optimized\n", report.acmrBefore, report.acmrAfter );
+	printf( "  atvr               %10.3f shuffled, %.3f optimized\n", report.atvrBefore, report.atvrAfter );
+	printf( "  save               %10.2f ms plain, %.2f ms optimized\n", report.plainSave, report.optimizedSave );
+	printf( "  optimize           %10.1f M triangles/s (average of %d runs)\n", report.optimizeRate, report.numberOfIterations );
+	printf( "  triangles          %10s\n", (report.trianglesPreserved) ? "preserved" : "CHANGED" );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// vertex merge
+
+// streams of the whole pack (UpdateFromCache before the merge) and then the copy into the client arrays (PrepCacheBuffers)
+//	returns the number of bytes which are read and written by the cpu
+static size_t CopyChainMerge( const BYTE *models_data, MergedGeometry &geometry )
+{
+	const FileGeometryHeader *fileHeader = (const FileGeometryHeader*) models_data;
+	const bool version2 = (fileHeader->version >= GEOMETRY_FILE_VERSION_2);
+
+	const int numberOfVertices = fileHeader->totalNumberOfVertices;
+	const int numberOfIndices = fileHeader->totalNumberOfIndices;
+
+	float *positions = new float[4 * numberOfVertices];
+	float *normals = new float[4 * numberOfVertices];
+	float *tangents = new float[4 * numberOfVertices];
+	float *uvs = new float[2 * numberOfVertices];
+	unsigned int *indices = new unsigned int[numberOfIndices];
+
+	size_t bytes = 0;
+	const BYTE *ptr = models_data + sizeof(FileGeometryHeader);
+	
+	unsigned int firstVertex = 0;
+	int firstIndex = 0;
+
+	for (int i=0; i<fileHeader->numberOfModels; ++i)
+	{
+		const VertexDataHeader *header = (const VertexDataHeader*) ptr;
+		const short indexStride = (version2) ? ((const VertexDataHeader2*) ptr)->indexStride : gIndexStride;
+		ptr = models_data + header->endOffset;
+
+		const size_t count = (size_t) header->numVertices;
+		memcpy( positions + 4 * firstVertex, models_data + header->positionOffset, gPointStride * count );
+		memcpy( normals + 4 * firstVertex, models_data + header->normalOffset, gNormalStride * count );
+		memcpy( tangents + 4 * firstVertex, models_data + header->tangentOffset, gTangentStride * count );
+		memcpy( uvs + 2 * firstVertex, models_data + header->uvOffset, gUVStride * count );
+
+		unsigned int *dst = indices + firstIndex;
+		
+		if (indexStride == gIndexStride16)
+		{
+			const unsigned short *src = (const unsigned short*) (models_data + header->indicesOffset);
+			for (int j=0; j<header->numIndices; ++j)
+				dst[j] = src[j] + firstVertex;
+		}
+		else
+		{
+			const unsigned int *src = (const unsigned int*) (models_data + header->indicesOffset);
+			for (int j=0; j<header->numIndices; ++j)
+				dst[j] = src[j] + firstVertex;
+		}
+
+		bytes += 2 * MERGE_STREAM_BYTES * count + (size_t) (indexStride + gIndexStride) * header->numIndices;
+
+		firstVertex += header->numVertices;
+		firstIndex += header->numIndices;
+	}
+
+	// positions, normals and indices are kept for ray casting
+	geometry.numberOfVertices = numberOfVertices;
+	geometry.numberOfIndices = numberOfIndices;
+
+	geometry.positions.assign( positions, positions + 4 * numberOfVertices );
+	geometry.normals.assign( normals, normals + 4 * numberOfVertices );
+	geometry.indices.assign( indices, indices + numberOfIndices );
+	geometry.tangents.assign( tangents, tangents + 4 * numberOfVertices );
+	geometry.uvs.assign( uvs, uvs + 2 * numberOfVertices );
+
+	bytes += 2 * (size_t) (gPointStride + gNormalStride) * numberOfVertices + 2 * (size_t) gIndexStride * numberOfIndices;
+
+	delete [] positions;
+	delete [] normals;
+	delete [] tangents;
+	delete [] uvs;
+	delete [] indices;
+
+	return bytes;
+}
+
+bool BenchmarkVertexMerge( const GPUCacheSyntheticOptions &options, const int numberOfIterations, GPUCacheVertexMergeReport &report )
+{
+	GPUCacheVertexMergeReport::Clear(report);
+
+	report.numberOfIterations = std::max(1, numberOfIterations);
+	report.numberOfThreads = std::max(1, (int) std::thread::hardware_concurrency() );
+	report.equal = true;
+
+	for (int config=0; config<VERTEX_MERGE_BENCHMARK_CONFIGS; ++config)
+	{
+		// index optimization stores 16 bit indices for the models under 64k vertices
+		CGPUCacheSaver	saver;
+		saver.SetOptimizeIndices( config == 1 );
+
+		if (false == GenerateSyntheticCache( BENCHMARK_TEST_FILENAME, options, saver ) )
+			return false;
+
+		CFileMapping	mapping;
+		const std::string packFilename = MakeBenchmarkPackFilename( BENCHMARK_TEST_FILENAME, "_Geometry.pck" );
+		
+		if (false == mapping.Open( packFilename.c_str() ) || mapping.GetSize() < sizeof(FileGeometryHeader) )
+			return false;
+
+		const BYTE *models_data = mapping.GetData();
+		const FileGeometryHeader *fileHeader = (const FileGeometryHeader*) models_data;
+		
+		const int numberOfVertices = fileHeader->totalNumberOfVertices;
+		const int numberOfIndices = fileHeader->totalNumberOfIndices;
+
+		report.numberOfVertices = numberOfVertices;
+		report.numberOfIndices = numberOfIndices;
+		report.indexStride[config] = (fileHeader->version >= GEOMETRY_FILE_VERSION_2) 
+			? ((const VertexDataHeader2*) (models_data + sizeof(FileGeometryHeader)))->indexStride : gIndexStride;
+
+		MergedGeometry	copied;
+		MergedGeometry	merged;
+		
+		merged.numberOfVertices = numberOfVertices;
+		merged.numberOfIndices = numberOfIndices;
+		merged.positions.resize( 4 * numberOfVertices );
+		merged.normals.resize( 4 * numberOfVertices );
+		merged.tangents.resize( 4 * numberOfVertices );		// stands for the mapped buffers
+		merged.uvs.resize( 2 * numberOfVertices );
+		merged.indices.resize( numberOfIndices );
+
+		// client arrays and the mapped tangents / uvs are two merges, like in UploadMergedData
+		VertexMergeTarget	clientTarget;
+		VertexMergeTarget	mappedTarget;
+		VertexMergeTarget::Set( merged.positions.data(), merged.normals.data(), nullptr, nullptr, merged.indices.data(), clientTarget );
+		VertexMergeTarget::Set( nullptr, nullptr, merged.tangents.data(), merged.uvs.data(), nullptr, mappedTarget );
+
+		report.copyChainTime[config] = report.mergeTime[config] = report.mergeThreadsTime[config] = DBL_MAX;
+
+		for (int i=0; i<report.numberOfIterations; ++i)
+		{
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+			report.copyChainBytes[config] = CopyChainMerge( models_data, copied );
+			report.copyChainTime[config] = std::min( report.copyChainTime[config], ElapsedMs(start) );
+
+			start = BenchmarkClock::now();
+			if (false == MergeGeometryStreams( models_data, clientTarget, 1 ) || false == MergeGeometryStreams( models_data, mappedTarget, 1 ) )
+				return false;
+			report.mergeTime[config] = std::min( report.mergeTime[config], ElapsedMs(start) );
+
+			start = BenchmarkClock::now();
+			if (false == MergeGeometryStreams( models_data, clientTarget, report.numberOfThreads ) 
+				|| false == MergeGeometryStreams( models_data, mappedTarget, report.numberOfThreads ) )
+				return false;
+			report.mergeThreadsTime[config] = std::min( report.mergeThreadsTime[config], ElapsedMs(start) );
+		}
+
+		// merge reads the pack streams and writes them once
+		report.mergeBytes[config] = 2 * MERGE_STREAM_BYTES * (size_t) numberOfVertices 
+			+ (size_t) (report.indexStride[config] + gIndexStride) * numberOfIndices;
+
+		// glBufferData reads the client arrays of positions, normals and indices, the copy chain uploaded tangents and uvs too
+		const size_t clientBytes = (size_t) (gPointStride + gNormalStride) * numberOfVertices + (size_t) gIndexStride * numberOfIndices;
+		const size_t allBytes = clientBytes + (size_t) (gTangentStride + gUVStride) * numberOfVertices;
+
+		report.copyChainBytes[config] += allBytes;
+		report.mergeBytes[config] += clientBytes;
+
+		// temporary arrays of all streams live together with the client arrays
+		report.copyChainHeap[config] = allBytes + clientBytes;
+		report.mergeHeap[config] = clientBytes;
+
+		if (copied.positions != merged.positions || copied.normals != merged.normals || copied.tangents != merged.tangents
+			|| copied.uvs != merged.uvs || copied.indices != merged.indices)
+		{
+			report.equal = false;
+		}
+	}
+
+	return true;
+}
+
+void PrintVertexMergeReport( const GPUCacheVertexMergeReport &report )
+{
+	printf( "vertex merge benchmark - %d vertices, %d indices, best of %d runs\n", report.numberOfVertices, report.numberOfIndices, 
+		report.numberOfIterations );
+
+	for (int i=0; i<VERTEX_MERGE_BENCHMARK_CONFIGS; ++i)
+	{
+		printf( "  %d bit pack indices\n", 8 * report.indexStride[i] );
+		printf( "  copy chain         %10.2f ms, %.2f MB moved, %.2f MB heap\n", report.copyChainTime[i], 
+			(double) report.copyChainBytes[i] / (1024.0 * 1024.0), (double) report.copyChainHeap[i] / (1024.0 * 1024.0) );
+		printf( "  merge              %10.2f ms (%.2f ms with %d threads), %.2f MB moved, %.2f MB heap\n", report.mergeTime[i], 
+			report.mergeThreadsTime[i], report.numberOfThreads, (double) report.mergeBytes[i] / (1024.0 * 1024.0), 
+			(double) report.mergeHeap[i] / (1024.0 * 1024.0) );
+	}
+	printf( "  streams            %10s\n", (report.equal) ? "equal" : "DIFFERENT" );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// instances
+
+bool BenchmarkInstances( const GPUCacheSyntheticOptions &options, const int numberOfIterations, GPUCacheInstancesReport &report )
+{
+	GPUCacheInstancesReport::Clear(report);
+
+	CGPUCacheSaver	plainSaver;
+	CGPUCacheSaver	instancedSaver;
+	instancedSaver.SetDetectInstances(true);
+
+	GPUCacheBenchmarkReport	plainReport, instancedReport;
+	GPUCacheBenchmarkReport::Clear(plainReport);
+	GPUCacheBenchmarkReport::Clear(instancedReport);
+
+	if (false == GenerateSyntheticCache( BENCHMARK_TEST_FILENAME, options, plainSaver, &plainReport ) 
+		|| false == GenerateSyntheticCache( INSTANCED_TEST_FILENAME, options, instancedSaver, &instancedReport ) )
+	{
+		return false;
+	}
+
+	report.numberOfModels = options.numberOfModels;
+	report.numberOfInstances = instancedSaver.GetNumberOfInstances();
+	report.numberOfIterations = std::max(1, numberOfIterations);
+
+	report.plainSave = plainReport.saveTime;
+	report.instancedSave = instancedReport.saveTime;
+
+	if (false == BenchmarkCacheLoad( BENCHMARK_TEST_FILENAME, report.numberOfIterations, false, nullptr, plainReport ) 
+		|| false == BenchmarkCacheLoad( INSTANCED_TEST_FILENAME, report.numberOfIterations, false, nullptr, instancedReport ) )
+	{
+		return false;
+	}
+
+	report.plainLoad = plainReport.loadTime;
+	report.instancedLoad = instancedReport.loadTime;
+
+	MergedGeometry	plainGeometry;
+	MergedGeometry	instancedGeometry;
+
+	report.plainMerge = MergeGeometryPack( BENCHMARK_TEST_FILENAME, report.numberOfIterations, plainGeometry, report.plainPackSize );
+	report.instancedMerge = MergeGeometryPack( INSTANCED_TEST_FILENAME, report.numberOfIterations, instancedGeometry, report.instancedPackSize );
+
+	if (report.plainMerge < 0.0 || report.instancedMerge < 0.0)
+		return false;
+
+	report.plainVertices = plainGeometry.numberOfVertices;
+	report.instancedVertices = instancedGeometry.numberOfVertices;
+
+	return true;
+}
+
+void PrintInstancesReport( const GPUCacheInstancesReport &report )
+{
+	printf( "instances benchmark - %d models, %d instance records, average of %d runs\n", report.numberOfModels, report.numberOfInstances, 
+		report.numberOfIterations );
+	printf( "  geometry pack      %10.2f MB plain, %.2f MB instanced\n", (double) report.plainPackSize / (1024.0 * 1024.0), 
+		(double) report.instancedPackSize / (1024.0 * 1024.0) );
+	printf( "  save               %10.2f ms plain, %.2f ms instanced\n", report.plainSave, report.instancedSave );
+	printf( "  load               %10.2f ms plain, %.2f ms instanced\n", report.plainLoad, report.instancedLoad );
+	printf( "  merge              %10.2f ms plain, %.2f ms instanced\n", report.plainMerge, report.instancedMerge );
+	printf( "  merged vertices    %10d plain, %d instanced\n", report.plainVertices, report.instancedVertices );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// clusters
+
+struct ClusterModel
+{
+	unsigned int				firstIndex;			// in the merged index buffer
+	int							numIndices;
+	mat4						transform;
+	float						sphere[4];			// world space bounds of the model
+	std::vector<MeshCluster>	clusters;
+};
+
+// cluster records of the models, instance records share the index range of the source record
+class CGPUCacheClustersVisitor : public CGPUCacheNullVisitor
+{
+public:
+	//! a constructor
+	CGPUCacheClustersVisitor()
+		: CGPUCacheNullVisitor(false)
+		, mIndexOffset(0)
+	{}
+
+	virtual void OnReadModel(const char *name, const double *translation, const double *rotation, const double *scaling, 
+		const double *bounding_min, const double *bounding_max, const int numberOfShaders, const int *shaders, 
+		const VertexDataHeader *pheader, const BYTE *data) override
+	{
+		const int instanceOf = VertexDataHeader3::GetInstanceOf( data, pheader );
+		const unsigned int firstIndex = (instanceOf >= 0) ? mRecordFirstIndex[instanceOf] : mIndexOffset;
+
+		mRecordFirstIndex.push_back(firstIndex);
+		if (instanceOf < 0)
+			mIndexOffset += pheader->numIndices + VertexDataHeader3::GetLodsNumberOfIndices( data, pheader );
+
+		const VertexDataHeader3 *header3 = (const VertexDataHeader3*) pheader;
+		const MeshCluster *clusters = (const MeshCluster*) (data + header3->clustersOffset);
+
+		ClusterModel model;
+		model.firstIndex = firstIndex;
+		model.numIndices = pheader->numIndices;
+		model.clusters.assign( clusters, clusters + header3->numberOfClusters );
+
+		// synthetic models are only translated
+		model.transform.identity();
+		model.transform.set_translation( vec3( (float) translation[0], (float) translation[1], (float) translation[2] ) );
+
+		double size = 0.0;
+		for (int i=0; i<3; ++i)
+		{
+			model.sphere[i] = (float) (0.5 * (bounding_min[i] + bounding_max[i]) );
+			size += (bounding_max[i] - bounding_min[i]) * (bounding_max[i] - bounding_min[i]);
+		}
+		model.sphere[3] = (float) (0.5 * sqrt(size) );
+
+		mModels.push_back(model);
+	}
+
+	const std::vector<ClusterModel> &GetModels() const
+	{
+		return mModels;
+	}
+
+protected:
+
+	unsigned int				mIndexOffset;
+	std::vector<unsigned int>	mRecordFirstIndex;
+	std::vector<ClusterModel>	mModels;
+};
+
+static bool CheckClusterBounds( const MergedGeometry &geometry, const std::vector<ClusterModel> &models, const float coneTolerance, 
+	int &sphereViolations, float &sphereWorst, int &coneViolations, bool &covered )
+{
+	sphereViolations = 0;
+	sphereWorst = 0.0f;
+	coneViolations = 0;
+	covered = true;
+
+	std::vector<int> references;
+
+	for (auto iter=begin(models); iter!=end(models); ++iter)
+	{
+		const unsigned int *indices = geometry.indices.data() + iter->firstIndex;
+		references.assign( iter->numIndices, 0 );
+
+		for (auto cluster=begin(iter->clusters); cluster!=end(iter->clusters); ++cluster)
+		{
+			if (cluster->firstIndex < 0 || cluster->firstIndex + cluster->numIndices > iter->numIndices)
+				return false;
+
+			for (int i=cluster->firstIndex; i<cluster->firstIndex + cluster->numIndices; ++i)
+			{
+				references[i] += 1;
+
+				const float *p = &geometry.positions[4 * indices[i]];
+				const float dx = p[0] - cluster->center[0];
+				const float dy = p[1] - cluster->center[1];
+				const float dz = p[2] - cluster->center[2];
+				const float d = sqrtf(dx*dx + dy*dy + dz*dz);
+
+				if (d > cluster->radius * (1.0f + 1e-6f) + 1e-6f)
+				{
+					sphereViolations += 1;
+					sphereWorst = std::max(sphereWorst, d - cluster->radius);
+				}
+			}
+
+			if (cluster->coneCutoff >= 1.0f)
+				continue;
+
+			// angle to the axis is in the cone when cos >= sin of the half angle complement
+			const float minDot = sqrtf( 1.0f - cluster->coneCutoff * cluster->coneCutoff );
+
+			for (int i=cluster->firstIndex; i<cluster->firstIndex + cluster->numIndices; i+=3)
+			{
+				const float *a = &geometry.positions[4 * indices[i]];
+				const float *b = &geometry.positions[4 * indices[i+1]];
+				const float *c = &geometry.positions[4 * indices[i+2]];
+
+				const vec3 e1( b[0]-a[0], b[1]-a[1], b[2]-a[2] );
+				const vec3 e2( c[0]-a[0], c[1]-a[1], c[2]-a[2] );
+				vec3 n;
+				cross( n, e1, e2 );
+
+				const float len = sqrtf( dot(n, n) );
+				if (len == 0.0f)
+					continue;
+
+				const float d = (n.x * cluster->coneAxis[0] + n.y * cluster->coneAxis[1] + n.z * cluster->coneAxis[2]) / len;
+				if (d < minDot - coneTolerance)
+					coneViolations += 1;
+			}
+		}
+
+		for (auto ref=begin(references); ref!=end(references); ++ref)
+		{
+			if (*ref != 1)
+				covered = false;
+		}
+	}
+
+	return true;
+}
+
+bool BenchmarkClusters( const GPUCacheSyntheticOptions &options, const int numberOfViews, GPUCacheClustersReport &report )
+{
+	GPUCacheClustersReport::Clear(report);
+
+	report.numberOfModels = options.numberOfModels;
+	report.numberOfViews = std::max(1, numberOfViews);
+
+	std::vector<ClusterModel>	models;
+	MergedGeometry				geometry;
+
+	for (int config=0; config<CLUSTERS_BENCHMARK_CONFIGS; ++config)
+	{
+		const bool quantized = (config == 1);
+
+		CGPUCacheSaver saver;
+		saver.SetBuildClusters(true);
+		saver.SetQuantizeVertices(quantized);
+
+		GPUCacheBenchmarkReport	saveReport;
+		GPUCacheBenchmarkReport::Clear(saveReport);
+
+		if (false == GenerateSyntheticCache( CLUSTERS_TEST_FILENAME, options, saver, &saveReport ) )
+			return false;
+
+		CGPUCacheClustersVisitor	visitor;
+		if (false == BenchmarkCacheLoad( CLUSTERS_TEST_FILENAME, 1, false, &visitor, saveReport ) )
+			return false;
+
+		size_t packSize = 0;
+		if (MergeGeometryPack( CLUSTERS_TEST_FILENAME, 1, geometry, packSize ) < 0.0)
+			return false;
+
+		// quantized normals are not used here, but the positions move inside of the quantization step
+		const float coneTolerance = (quantized) ? 0.02f : 1e-4f;
+
+		if (false == CheckClusterBounds( geometry, visitor.GetModels(), coneTolerance, report.sphereViolations[config], 
+			report.sphereWorst[config], report.coneViolations[config], report.covered[config] ) )
+		{
+			printf( "> ERROR: cluster is out of the model index range\n" );
+			return false;
+		}
+
+		if (false == quantized)
+			models = visitor.GetModels();
+	}
+
+	// culling of the float pack
+	double numberOfTriangles = 0.0;
+	for (auto iter=begin(models); iter!=end(models); ++iter)
+	{
+		report.numberOfClusters += (int) iter->clusters.size();
+		numberOfTriangles += (double) iter->numIndices / 3.0;
+	}
+
+	if (report.numberOfClusters > 0)
+		report.trianglesPerCluster = (float) (numberOfTriangles / (double) report.numberOfClusters);
+
+	std::vector<MeshClusterRange>	ranges;
+	unsigned int state = options.seed;
+
+	for (int view=0; view<report.numberOfViews; ++view)
+	{
+		float projection[16], modelview[16], eye[3];
+		MakeBenchmarkView( options, (view % 2) == 1, state, projection, modelview, eye );
+
+		CFrustum frustum;
+		frustum.CalculateFrustum( projection, modelview );
+		const vec3 eyePos(eye[0], eye[1], eye[2]);
+
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+
+		for (auto iter=begin(models); iter!=end(models); ++iter)
+		{
+			report.allTriangles += (double) iter->numIndices / 3.0;
+			if (frustum.SphereInFrustum( iter->sphere[0], iter->sphere[1], iter->sphere[2], iter->sphere[3] ) )
+				report.sphereTriangles += (double) iter->numIndices / 3.0;
+		}
+
+		report.sphereCullTime += ElapsedMs(start);
+		start = BenchmarkClock::now();
+
+		for (auto iter=begin(models); iter!=end(models); ++iter)
+		{
+			if (false == frustum.SphereInFrustum( iter->sphere[0], iter->sphere[1], iter->sphere[2], iter->sphere[3] ) )
+				continue;
+
+			ranges.clear();
+			CullMeshClusters( iter->clusters.data(), (int) iter->clusters.size(), iter->firstIndex, iter->transform, frustum, eyePos, ranges );
+
+			report.clusterRanges += (double) ranges.size();
+			for (auto range=begin(ranges); range!=end(ranges); ++range)
+				report.clusterTriangles += (double) (range->count / 3);
+		}
+
+		report.clusterCullTime += ElapsedMs(start);
+	}
+
+	const double views = (double) report.numberOfViews;
+	report.allTriangles /= views;
+	report.sphereTriangles /= views;
+	report.clusterTriangles /= views;
+	report.clusterRanges /= views;
+	report.sphereCullTime /= views;
+	report.clusterCullTime /= views;
+
+	return true;
+}
+
+void PrintClustersReport( const GPUCacheClustersReport &report )
+{
+	printf( "clusters benchmark - %d models, %d clusters (%.1f triangles average), %d views\n", report.numberOfModels, report.numberOfClusters, 
+		report.trianglesPerCluster, report.numberOfViews );
+
+	for (int i=0; i<CLUSTERS_BENCHMARK_CONFIGS; ++i)
+	{
+		printf( "  %s sphere     %10d vertices outside (worst %.2g), cone %d triangles outside, coverage %s\n", (i == 0) ? "float    " : "quantized", 
+			report.sphereViolations[i], report.sphereWorst[i], report.coneViolations[i], (report.covered[i]) ? "ok" : "FAILED" );
+	}
+
+	const double all = std::max(1.0, report.allTriangles);
+	printf( "  triangles per view %10.0f all, %.0f model spheres (%.1f%%), %.0f clusters (%.1f%%)\n", report.allTriangles, 
+		report.sphereTriangles, 100.0 * report.sphereTriangles / all, report.clusterTriangles, 100.0 * report.clusterTriangles / all );
+	printf( "  ranges per view    %10.0f\n", report.clusterRanges );
+	printf( "  cull per view      %10.3f ms model spheres, %.3f ms clusters\n", report.sphereCullTime, report.clusterCullTime );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// lods
+
+struct LodModel
+{
+	float			sphere[4];
+	int				numberOfLods;						// including the source level
+	float			errors[MESH_LOD_MAX_LEVELS];
+	int				triangles[MESH_LOD_MAX_LEVELS];
+};
+
+// merges the index stream and checks the lod index buffers of each record against the pack
+class CGPUCacheLodsVisitor : public CGPUCacheNullVisitor
+{
+public:
+	//! a constructor
+	CGPUCacheLodsVisitor()
+		: CGPUCacheNullVisitor(false)
+		, mIndexOffset(0)
+		, mVertexOffset(0)
+		, mOutOfRange(0)
+		, mMismatches(0)
+	{}
+
+	virtual void OnReadVertexData( const FileGeometryHeader *pheader, const BYTE *data ) override
+	{
+		mIndices.assign( pheader->totalNumberOfIndices, 0 );
+
+		VertexMergeTarget	target;
+		VertexMergeTarget::Set( nullptr, nullptr, nullptr, nullptr, mIndices.data(), target );
+		MergeGeometryStreams( data, target );
+	}
+
+	virtual void OnReadModel(const char *name, const double *translation, const double *rotation, const double *scaling, 
+		const double *bounding_min, const double *bounding_max, const int numberOfShaders, const int *shaders, 
+		const VertexDataHeader *pheader, const BYTE *data) override
+	{
+		const int instanceOf = VertexDataHeader3::GetInstanceOf( data, pheader );
+		
+		unsigned int firstIndex = mIndexOffset;
+		unsigned int firstVertex = mVertexOffset;
+
+		if (instanceOf >= 0)
+		{
+			firstIndex = mRecords[instanceOf].first;
+			firstVertex = mRecords[instanceOf].second;
+		}
+		else
+		{
+			mIndexOffset += pheader->numIndices + VertexDataHeader3::GetLodsNumberOfIndices( data, pheader );
+			mVertexOffset += pheader->numVertices;
+		}
+		mRecords.push_back( std::make_pair(firstIndex, firstVertex) );
+
+		const VertexDataHeader3 *header3 = (const VertexDataHeader3*) pheader;
+		const MeshLodHeader *lods = (const MeshLodHeader*) (data + header3->lodsOffset);
+
+		LodModel model;
+		model.numberOfLods = 1 + std::min(MESH_LOD_MAX_LEVELS - 1, header3->numberOfLods);
+		model.errors[0] = 0.0f;
+		model.triangles[0] = pheader->numIndices / 3;
+
+		unsigned int levelFirst = firstIndex + pheader->numIndices;
+
+		for (int i=1; i<model.numberOfLods; ++i)
+		{
+			const MeshLodHeader &lod = lods[i-1];
+			model.errors[i] = lod.error;
+			model.triangles[i] = lod.numIndices / 3;
+
+			const BYTE *src = data + lod.indicesOffset;
+
+			for (int j=0; j<lod.numIndices; ++j)
+			{
+				const unsigned int index = mIndices[levelFirst + j];
+				const unsigned int packIndex = (header3->indexStride == gIndexStride16) 
+					? ((const unsigned short*) src)[j] : ((const unsigned int*) src)[j];
+
+				if (index < firstVertex || index >= firstVertex + pheader->numVertices)
+					mOutOfRange += 1;
+				if (index != packIndex + firstVertex)
+					mMismatches += 1;
+			}
+
+			levelFirst += lod.numIndices;
+		}
+
+		double size = 0.0;
+		for (int i=0; i<3; ++i)
+		{
+			model.sphere[i] = (float) (0.5 * (bounding_min[i] + bounding_max[i]) );
+			size += (bounding_max[i] - bounding_min[i]) * (bounding_max[i] - bounding_min[i]);
+		}
+		model.sphere[3] = (float) (0.5 * sqrt(size) );
+
+		mModels.push_back(model);
+	}
+
+	const std::vector<LodModel> &GetModels() const
+	{
+		return mModels;
+	}
+	const int GetNumberOfOutOfRange() const
+	{
+		return mOutOfRange;
+	}
+	const int GetNumberOfMismatches() const
+	{
+		return mMismatches;
+	}
+
+protected:
+
+	unsigned int				mIndexOffset;
+	unsigned int				mVertexOffset;
+	int							mOutOfRange;
+	int							mMismatches;
+
+	std::vector<unsigned int>	mIndices;
+	std::vector<std::pair<unsigned int, unsigned int>>	mRecords;	// first index and first vertex
+	std::vector<LodModel>		mModels;
+};
+
+bool BenchmarkLods( const GPUCacheSyntheticOptions &options, const int numberOfLods, const int numberOfFrames, GPUCacheLodsReport &report )
+{
+	GPUCacheLodsReport::Clear(report);
+
+	report.numberOfModels = options.numberOfModels;
+	report.numberOfFrames = std::max(1, numberOfFrames);
+
+	CGPUCacheSaver	plainSaver;
+	CGPUCacheSaver	lodSaver;
+	lodSaver.SetBuildLods(true, numberOfLods, 0.5f, 0.05f);
+
+	GPUCacheBenchmarkReport	plainReport, lodReport;
+	GPUCacheBenchmarkReport::Clear(plainReport);
+	GPUCacheBenchmarkReport::Clear(lodReport);
+
+	if (false == GenerateSyntheticCache( BENCHMARK_TEST_FILENAME, options, plainSaver, &plainReport ) 
+		|| false == GenerateSyntheticCache( LODS_TEST_FILENAME, options, lodSaver, &lodReport ) )
+	{
+		return false;
+	}
+
+	report.plainSave = plainReport.saveTime;
+	report.lodSave = lodReport.saveTime;
+	report.plainPackSize = GetBenchmarkFileSize( MakeBenchmarkPackFilename( BENCHMARK_TEST_FILENAME, "_Geometry.pck" ).c_str() );
+	report.lodPackSize = GetBenchmarkFileSize( MakeBenchmarkPackFilename( LODS_TEST_FILENAME, "_Geometry.pck" ).c_str() );
+
+	CGPUCacheLodsVisitor	visitor;
+	if (false == BenchmarkCacheLoad( LODS_TEST_FILENAME, 1, false, &visitor, lodReport ) )
+		return false;
+
+	const std::vector<LodModel> &models = visitor.GetModels();
+	if (models.size() == 0)
+		return false;
+
+	report.outOfRange = visitor.GetNumberOfOutOfRange();
+	report.mismatches = visitor.GetNumberOfMismatches();
+	report.numberOfLods = models[0].numberOfLods;
+
+	for (auto iter=begin(models); iter!=end(models); ++iter)
+	{
+		for (int i=0; i<iter->numberOfLods; ++i)
+		{
+			report.levelTriangles[i] += iter->triangles[i];
+			report.levelError[i] = std::max(report.levelError[i], iter->errors[i]);
+		}
+	}
+
+	// simplifier on the first model of the plain pack, half of the triangles
+	MergedGeometry	geometry;
+	size_t			packSize = 0;
+
+	if (MergeGeometryPack( BENCHMARK_TEST_FILENAME, 1, geometry, packSize ) < 0.0)
+		return false;
+
+	const int numberOfVertices = geometry.numberOfVertices / std::max(1, options.numberOfModels);
+	const int numberOfIndices = models[0].triangles[0] * 3;
+	std::vector<unsigned int>	simplified(numberOfIndices);
+
+	report.simplifyTriangles = models[0].triangles[0];
+
+	const int iterations = 5;
+	const BenchmarkClock::time_point start = BenchmarkClock::now();
+
+	for (int i=0; i<iterations; ++i)
+	{
+		SimplifyMesh( simplified.data(), geometry.indices.data(), numberOfIndices, geometry.positions.data(), sizeof(float) * 4, 
+			numberOfVertices, numberOfIndices / 2, 0.05f, &report.simplifyError );
+	}
+
+	report.simplifyRate = (double) report.simplifyTriangles * iterations / (ElapsedMs(start) * 1000.0);
+
+	// camera flies over the middle row of the grid at 3 units with a hand-held shake
+	float sceneMax[2] = { 0.0f, 0.0f };
+	for (auto iter=begin(models); iter!=end(models); ++iter)
+	{
+		sceneMax[0] = std::max(sceneMax[0], iter->sphere[0]);
+		sceneMax[1] = std::max(sceneMax[1], iter->sphere[2]);
+	}
+
+	const float projScaleY = 1.0f / tanf(0.5f * 1.0471976f);
+	const float viewportHeight = 1080.0f;
+
+	std::vector<int> currentLods(models.size() );
+
+	for (int h=0; h<LODS_BENCHMARK_HYSTERESIS; ++h)
+	{
+		const float hysteresis = 0.25f * (float) h;
+		report.hysteresis[h] = hysteresis;
+
+		std::fill( begin(currentLods), end(currentLods), -1 );
+
+		double fullTriangles = 0.0;
+		double switches = 0.0;
+
+		for (int frame=0; frame<report.numberOfFrames; ++frame)
+		{
+			const float t = (float) frame / (float) report.numberOfFrames;
+			const float eye[3] = { t * sceneMax[0] + 0.6f * sinf(0.9f * (float) frame), 3.0f, 0.5f * sceneMax[1] };
+
+			const BenchmarkClock::time_point frameStart = BenchmarkClock::now();
+
+			for (size_t i=0; i<models.size(); ++i)
+			{
+				const LodModel &model = models[i];
+
+				const float dx = model.sphere[0] - eye[0];
+				const float dy = model.sphere[1] - eye[1];
+				const float dz = model.sphere[2] - eye[2];
+				const float distance = sqrtf(dx*dx + dy*dy + dz*dz) - model.sphere[3];
+
+				const int lod = SelectMeshLod( model.errors, model.numberOfLods, ComputePixelsPerUnit(distance, projScaleY, viewportHeight), 
+					1.0f, hysteresis, currentLods[i] );
+
+				if (currentLods[i] >= 0 && lod != currentLods[i])
+					switches += 1.0;
+				currentLods[i] = lod;
+
+				report.lodTriangles[h] += (double) model.triangles[lod];
+				fullTriangles += (double) model.triangles[0];
+			}
+
+			report.selectTime[h] += ElapsedMs(frameStart);
+		}
+
+		const double frames = (double) report.numberOfFrames;
+		report.fullTriangles = fullTriangles / frames;
+		report.lodTriangles[h] /= frames;
+		report.switches[h] = switches / frames;
+		report.selectTime[h] /= frames;
+	}
+
+	return true;
+}
+
+void PrintLodsReport( const GPUCacheLodsReport &report )
+{
+	printf( "lods benchmark - %d models, %d levels, %d frames\n", report.numberOfModels, report.numberOfLods, report.numberOfFrames );
+
+	for (int i=0; i<report.numberOfLods; ++i)
+		printf( "  level %d            %10d triangles, error %.4f\n", i, report.levelTriangles[i], report.levelError[i] );
+
+	printf( "  geometry pack      %10.2f MB plain, %.2f MB with lods\n", (double) report.plainPackSize / (1024.0 * 1024.0), 
+		(double) report.lodPackSize / (1024.0 * 1024.0) );
+	printf( "  save               %10.2f ms plain, %.2f ms with lods\n", report.plainSave, report.lodSave );
+	printf( "  simplify           %10.2f M triangles/s (%d triangles to half, error %.4f)\n", report.simplifyRate, 
+		report.simplifyTriangles, report.simplifyError );
+	printf( "  lod indices        %10d out of range, %d differ from the pack\n", report.outOfRange, report.mismatches );
+
+	const double full = std::max(1.0, report.fullTriangles);
+	for (int i=0; i<LODS_BENCHMARK_HYSTERESIS; ++i)
+	{
+		printf( "  hysteresis %.2f    %10.0f of %.0f triangles per frame (%.1f%%), %.2f switches per frame, select %.3f ms\n", 
+			report.hysteresis[i], report.lodTriangles[i], report.fullTriangles, 100.0 * report.lodTriangles[i] / full, 
+			report.switches[i], report.selectTime[i] );
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// partial loading
+
+struct PartialModel
+{
+	std::string		name;
+	int				instanceOf;			// record of the loaded pack, -1 - record has own streams
+	unsigned int	hash;				// positions, indices and lod indices of the record with the streams
+	double			bmin[3];			// manifest bounds
+	double			bmax[3];
+};
+
+// fnv-1a
+static unsigned int HashBytes( unsigned int hash, const BYTE *data, const size_t size )
+{
+	for (size_t i=0; i<size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// the record offsets are pack offsets, so the streams are hashed and not the record bytes
+static unsigned int HashRecordStreams( const int version, const BYTE *data, const VertexDataHeader *pheader )
+{
+	const size_t indexStride = (version >= GEOMETRY_FILE_VERSION_2) 
+		? (size_t) ((const VertexDataHeader2*) pheader)->indexStride : sizeof(unsigned int);
+
+	unsigned int hash = 2166136261u;
+	hash = HashBytes( hash, data + pheader->positionOffset, (size_t) pheader->numVertices * pheader->pointStride );
+	hash = HashBytes( hash, data + pheader->indicesOffset, (size_t) pheader->numIndices * indexStride );
+
+	if (version >= GEOMETRY_FILE_VERSION_3)
+	{
+		const VertexDataHeader3 *header3 = (const VertexDataHeader3*) pheader;
+		const MeshLodHeader *lods = (const MeshLodHeader*) (data + header3->lodsOffset);
+
+		for (int i=0; i<header3->numberOfLods; ++i)
+			hash = HashBytes( hash, data + lods[i].indicesOffset, (size_t) lods[i].numIndices * indexStride );
+	}
+	return hash;
+}
+
+// lods visitor which also keeps the name, the record and the streams hash of each model
+class CGPUCachePartialVisitor : public CGPUCacheLodsVisitor
+{
+public:
+	//! a constructor
+	CGPUCachePartialVisitor()
+		: CGPUCacheLodsVisitor()
+		, mVersion(0)
+	{}
+
+	virtual void OnReadVertexData( const FileGeometryHeader *pheader, const BYTE *data ) override
+	{
+		CGPUCacheLodsVisitor::OnReadVertexData(pheader, data);
+		mVersion = pheader->version;
+	}
+
+	virtual void OnReadModel(const char *name, const double *translation, const double *rotation, const double *scaling, 
+		const double *bounding_min, const double *bounding_max, const int numberOfShaders, const int *shaders, 
+		const VertexDataHeader *pheader, const BYTE *data) override
+	{
+		CGPUCacheLodsVisitor::OnReadModel( name, translation, rotation, scaling, bounding_min, bounding_max, numberOfShaders, shaders,
+			pheader, data );
+
+		PartialModel model;
+		model.name = name;
+		model.instanceOf = VertexDataHeader3::GetInstanceOf( data, pheader );
+
+		const VertexDataHeader *source = (model.instanceOf >= 0 && model.instanceOf < (int) mHeaders.size() ) 
+			? mHeaders[model.instanceOf] : pheader;
+
+		model.hash = HashRecordStreams( mVersion, data, source );
+		
+		for (int i=0; i<3; ++i)
+		{
+			model.bmin[i] = bounding_min[i];
+			model.bmax[i] = bounding_max[i];
+		}
+
+		mHeaders.push_back(pheader);
+		mPartialModels.push_back(model);
+	}
+
+	const std::vector<PartialModel> &GetPartialModels() const
+	{
+		return mPartialModels;
+	}
+
+protected:
+
+	int									mVersion;
+	std::vector<const VertexDataHeader*>	mHeaders;		// records of the pack, valid during the load
+	std::vector<PartialModel>			mPartialModels;
+};
+
+// loaded models have to be the expected ones with the streams of the full load, returns the number of mismatches
+static int ComparePartialModels( const std::vector<PartialModel> &full, const std::vector<int> &expected, 
+	const std::vector<PartialModel> &loaded )
+{
+	int mismatches = 0;
+
+	if (loaded.size() != expected.size() )
+		mismatches += std::abs( (int) loaded.size() - (int) expected.size() );
+
+	// partial pack keeps the pack order
+	const size_t count = std::min(loaded.size(), expected.size() );
+
+	for (size_t i=0; i<count; ++i)
+	{
+		const PartialModel &model = full[expected[i]];
+
+		if (loaded[i].name != model.name || loaded[i].hash != model.hash)
+			mismatches += 1;
+	}
+	return mismatches;
+}
+
+// drop the table of contents and the footer, like a pack of an older exporter
+static bool StripGeometryToc( const char *filename )
+{
+	const std::string packFilename = MakeBenchmarkPackFilename( filename, "_Geometry.pck" );
+	
+	FILE *fp = nullptr;
+	if (0 != fopen_s( &fp, packFilename.c_str(), "rb" ) || fp == nullptr)
+		return false;
+
+	_fseeki64( fp, 0, SEEK_END );
+	const int64_t size = _ftelli64( fp );
+	_fseeki64( fp, 0, SEEK_SET );
+
+	std::vector<BYTE> data( (size > 0) ? (size_t) size : 0 );
+	const bool read = (data.size() > sizeof(FileTocFooter) && 1 == fread( data.data(), data.size(), 1, fp ) );
+	fclose(fp);
+
+	if (false == read)
+		return false;
+
+	const FileTocFooter *footer = (const FileTocFooter*) (data.data() + data.size() - sizeof(FileTocFooter) );
+	if (footer->tag != CACHE_TOC_TAG || footer->tocOffset <= 0 || footer->tocOffset >= size)
+		return false;
+
+	if (0 != fopen_s( &fp, packFilename.c_str(), "wb" ) || fp == nullptr)
+		return false;
+
+	const bool written = (1 == fwrite( data.data(), (size_t) footer->tocOffset, 1, fp ) );
+	fclose(fp);
+
+	return written;
+}
+
+bool BenchmarkPartialLoad( const GPUCacheSyntheticOptions &options, GPUCachePartialLoadReport &report )
+{
+	GPUCachePartialLoadReport::Clear(report);
+
+	CGPUCacheSaver	saver;
+	saver.SetDetectInstances(true);
+	saver.SetBuildLods(true, 2, 0.5f, 0.05f);
+
+	if (false == GenerateSyntheticCache( PARTIAL_TEST_FILENAME, options, saver, nullptr ) )
+		return false;
+
+	report.numberOfInstances = saver.GetNumberOfInstances();
+
+	CGPUCachePartialVisitor		fullVisitor;
+	CGPUCacheLoader				fullLoader;
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	
+	if (false == fullLoader.Load( PARTIAL_TEST_FILENAME, &fullVisitor ) )
+		return false;
+
+	report.fullLoad = ElapsedMs(start);
+
+	const std::vector<PartialModel> &full = fullVisitor.GetPartialModels();
+	report.numberOfModels = (int) full.size();
+
+	// an instance without its source, another one with it and a model which is neither
+	int instance = -1;
+	int pairInstance = -1;
+	int other = -1;
+
+	for (int i=0; i<report.numberOfModels; ++i)
+	{
+		const int source = full[i].instanceOf;
+
+		if (source >= 0 && instance < 0)
+			instance = i;
+		else if (source >= 0 && pairInstance < 0 && source != full[instance].instanceOf)
+			pairInstance = i;
+	}
+
+	if (instance < 0 || pairInstance < 0)
+	{
+		printf( "> ERROR: partial load benchmark needs two instanced meshes\n" );
+		return false;
+	}
+
+	const int pairSource = full[pairInstance].instanceOf;
+
+	for (int i=0; i<report.numberOfModels && other < 0; ++i)
+	{
+		if (full[i].instanceOf < 0 && i != full[instance].instanceOf && i != pairSource)
+			other = i;
+	}
+
+	if (other < 0)
+		return false;
+
+	// unknown and repeated names are skipped
+	const char *names[6] = { full[pairInstance].name.c_str(), full[instance].name.c_str(), "not_a_model", 
+		full[other].name.c_str(), full[pairSource].name.c_str(), full[other].name.c_str() };
+
+	std::vector<int> expected;
+	expected.push_back(instance);
+	expected.push_back(pairInstance);
+	expected.push_back(other);
+	expected.push_back(pairSource);
+	std::sort( begin(expected), end(expected) );
+
+	report.nameExpected = (int) expected.size();
+
+	CGPUCachePartialVisitor		nameVisitor;
+	CGPUCacheLoader				nameLoader;
+
+	start = BenchmarkClock::now();
+	
+	if (false == nameLoader.LoadModels( PARTIAL_TEST_FILENAME, 6, names, &nameVisitor ) )
+		return false;
+
+	report.nameLoad = ElapsedMs(start);
+
+	const std::vector<PartialModel> &byName = nameVisitor.GetPartialModels();
+	report.nameLoaded = (int) byName.size();
+	report.nameMismatches = ComparePartialModels( full, expected, byName );
+	report.lodOutOfRange += nameVisitor.GetNumberOfOutOfRange();
+	report.lodMismatches += nameVisitor.GetNumberOfMismatches();
+
+	for (size_t i=0; i<byName.size() && i<expected.size(); ++i)
+	{
+		if (expected[i] == instance)
+			report.sourceCopied = (byName[i].instanceOf < 0);
+		else if (expected[i] == pairInstance)
+			report.instanceKept = (byName[i].instanceOf >= 0 && byName[byName[i].instanceOf].name == full[pairSource].name);
+	}
+
+	// box over a few grid cells, expected models come from the manifest bounds of the full load
+	const double spacing = (full.size() > 1) ? (full[1].bmin[0] - full[0].bmin[0]) : 1.0;
+	const double bmin[3] = { 1.5 * spacing, -0.5, 0.5 * spacing };
+	const double bmax[3] = { 3.2 * spacing, 0.5, 2.5 * spacing };
+
+	expected.clear();
+	for (int i=0; i<report.numberOfModels; ++i)
+	{
+		const PartialModel &model = full[i];
+
+		if (model.bmin[0] <= bmax[0] && model.bmax[0] >= bmin[0] && model.bmin[1] <= bmax[1] && model.bmax[1] >= bmin[1]
+			&& model.bmin[2] <= bmax[2] && model.bmax[2] >= bmin[2])
+		{
+			expected.push_back(i);
+		}
+	}
+
+	report.boxExpected = (int) expected.size();
+
+	CGPUCachePartialVisitor		boxVisitor;
+	CGPUCacheLoader				boxLoader;
+
+	start = BenchmarkClock::now();
+	
+	if (false == boxLoader.LoadModelsInBox( PARTIAL_TEST_FILENAME, bmin, bmax, &boxVisitor ) )
+		return false;
+
+	report.boxLoad = ElapsedMs(start);
+	report.boxLoaded = (int) boxVisitor.GetPartialModels().size();
+	report.boxMismatches = ComparePartialModels( full, expected, boxVisitor.GetPartialModels() );
+	report.lodOutOfRange += boxVisitor.GetNumberOfOutOfRange();
+	report.lodMismatches += boxVisitor.GetNumberOfMismatches();
+
+	// the same pack without the table of contents
+	CGPUCacheSaver	noTocSaver;
+	noTocSaver.SetDetectInstances(true);
+	noTocSaver.SetBuildLods(true, 2, 0.5f, 0.05f);
+
+	if (false == GenerateSyntheticCache( NOTOC_TEST_FILENAME, options, noTocSaver, nullptr ) 
+		|| false == StripGeometryToc( NOTOC_TEST_FILENAME ) )
+	{
+		return false;
+	}
+
+	printf( "  (partial loading of a pack without a table of contents fails on purpose)\n" );
+
+	CGPUCachePartialVisitor		noTocVisitor;
+	CGPUCacheLoader				noTocLoader;
+
+	const bool noTocNames = noTocLoader.LoadModels( NOTOC_TEST_FILENAME, 6, names, &noTocVisitor );
+	const bool noTocBox = noTocLoader.LoadModelsInBox( NOTOC_TEST_FILENAME, bmin, bmax, &noTocVisitor );
+
+	report.noTocRejected = (false == noTocNames && false == noTocBox && noTocVisitor.GetPartialModels().size() == 0);
+
+	CGPUCachePartialVisitor		noTocFullVisitor;
+	report.noTocFullLoad = (noTocLoader.Load( NOTOC_TEST_FILENAME, &noTocFullVisitor ) 
+		&& (int) noTocFullVisitor.GetPartialModels().size() == options.numberOfModels);
+
+	return true;
+}
+
+void PrintPartialLoadReport( const GPUCachePartialLoadReport &report )
+{
+	printf( "partial load benchmark - %d models, %d instance records\n", report.numberOfModels, report.numberOfInstances );
+	printf( "  by names           %10d of %d loaded, %d mismatches, source %s, instance %s\n", report.nameLoaded, report.nameExpected, 
+		report.nameMismatches, (report.sourceCopied) ? "copied" : "NOT COPIED", (report.instanceKept) ? "kept" : "LOST" );
+	printf( "  by box             %10d of %d loaded, %d mismatches\n", report.boxLoaded, report.boxExpected, report.boxMismatches );
+	printf( "  lods               %10d out of range, %d mismatches\n", report.lodOutOfRange, report.lodMismatches );
+	printf( "  no toc pack        %10s partial, %s full load\n", (report.noTocRejected) ? "rejected" : "LOADED", 
+		(report.noTocFullLoad) ? "ok" : "FAILED" );
+	printf( "  load               %10.2f ms full, %.2f ms names, %.2f ms box\n", report.fullLoad, report.nameLoad, report.boxLoad );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tests
+
+bool TestQuantization()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(256, 16384, 4, 0, 0, options);
+
+	GPUCacheQuantizationReport report;
+	if (false == BenchmarkQuantization( options, 5, report ) )
+		return false;
+
+	PrintQuantizationReport(report);
+
+	// models are about 10 units, 16 bit positions give 1/65535 of the model bounds
+	return (report.positionError < 0.001 && report.normalError < 0.02 && report.tangentError < 0.02 
+		&& report.tangentSignErrors == 0 && report.uvError < 0.001 && report.quantizedPackSize < report.floatPackSize);
+}
+
+bool TestIndexOptimization()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(256, 4096, 4, 0, 0, options);
+	options.patchesPerModel = 2;
+
+	GPUCacheIndexReport report;
+	if (false == BenchmarkIndexOptimization( options, 10, report ) )
+		return false;
+
+	PrintIndexReport(report);
+
+	// shuffled grid is close to 3.0, a good strip order of a grid is below 1.0
+	return (report.trianglesPreserved && report.acmrAfter < 1.0f && report.acmrAfter < 0.5f * report.acmrBefore 
+		&& report.atvrAfter < report.atvrBefore);
+}
+
+bool TestVertexMerge()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(64, 50000, 4, 0, 0, options);
+
+	GPUCacheVertexMergeReport report;
+	if (false == BenchmarkVertexMerge( options, 5, report ) )
+		return false;
+
+	PrintVertexMergeReport(report);
+
+	if (false == report.equal)
+		return false;
+
+	for (int i=0; i<VERTEX_MERGE_BENCHMARK_CONFIGS; ++i)
+	{
+		if (report.mergeBytes[i] >= report.copyChainBytes[i] || report.mergeHeap[i] >= report.copyChainHeap[i])
+			return false;
+	}
+	return true;
+}
+
+bool TestInstances()
+{
+	// models repeat 7 shapes
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(256, 4096, 4, 0, 0, options);
+
+	GPUCacheInstancesReport report;
+	if (false == BenchmarkInstances( options, 5, report ) )
+		return false;
+
+	PrintInstancesReport(report);
+
+	return (report.numberOfInstances == options.numberOfModels - options.meshVariations 
+		&& report.instancedPackSize * 10 < report.plainPackSize && report.instancedVertices * 10 < report.plainVertices);
+}
+
+bool TestClusters()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(400, 16384, 8, 0, 0, options);
+	options.patchesPerModel = 2;
+	options.meshVariations = 0;
+
+	GPUCacheClustersReport report;
+	if (false == BenchmarkClusters( options, 64, report ) )
+		return false;
+
+	PrintClustersReport(report);
+
+	for (int i=0; i<CLUSTERS_BENCHMARK_CONFIGS; ++i)
+	{
+		if (report.sphereViolations[i] > 0 || report.coneViolations[i] > 0 || false == report.covered[i])
+			return false;
+	}
+	return (report.numberOfClusters > 0 && report.clusterTriangles < report.sphereTriangles);
+}
+
+bool TestLods()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(256, 16384, 8, 0, 0, options);
+	options.patchesPerModel = 2;
+
+	GPUCacheLodsReport report;
+	if (false == BenchmarkLods( options, 4, 600, report ) )
+		return false;
+
+	PrintLodsReport(report);
+
+	if (report.outOfRange > 0 || report.mismatches > 0 || report.numberOfLods < 2 || report.simplifyError > 0.05f)
+		return false;
+
+	for (int i=1; i<report.numberOfLods; ++i)
+	{
+		if (report.levelTriangles[i] >= report.levelTriangles[i-1] || report.levelError[i] < report.levelError[i-1])
+			return false;
+	}
+
+	// the hysteresis keeps the levels of the shaking camera
+	return (report.lodTriangles[0] < 0.5 * report.fullTriangles && report.switches[1] < report.switches[0]);
+}
+
+bool TestPartialLoad()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(64, 1024, 4, 4, 64, options);
+
+	GPUCachePartialLoadReport report;
+	if (false == BenchmarkPartialLoad( options, report ) )
+		return false;
+
+	PrintPartialLoadReport(report);
+
+	return (report.nameLoaded == report.nameExpected && report.nameMismatches == 0 && report.sourceCopied && report.instanceKept
+		&& report.boxExpected > 0 && report.boxExpected < report.numberOfModels && report.boxLoaded == report.boxExpected 
+		&& report.boxMismatches == 0 && report.lodOutOfRange == 0 && report.lodMismatches == 0
+		&& report.noTocRejected && report.noTocFullLoad);
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_benchmarkGeometry.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_benchmark.h"
+#include "algorithm/MeshSimplify.h"
+
+//
+// geometry pack benchmarks and tests (quantization, index optimization, clusters, lods)
+//	only cpu code of the saver, the loader merge and the algorithm modules is used
+//
+
+//////////////////////////////////////////////////////////////////////////
+// compact vertex streams against the float ones, both packs are merged like the loader does
+
+struct GPUCacheQuantizationReport
+{
+	int			numberOfVertices;
+	int			numberOfIterations;
+
+	size_t		floatPackSize;
+	size_t		quantizedPackSize;
+
+	double		positionError;		// max distance to the float position
+	double		normalError;		// max angle in degrees
+	double		tangentError;		// max angle in degrees
+	int			tangentSignErrors;	// handedness mismatches
+	double		uvError;			// max component difference
+
+	double		floatMerge;			// ms, MergeGeometryStreams of the whole pack
+	double		quantizedMerge;
+
+	double		encodeRate;			// M vertices/s, all four streams
+	double		decodeRate;
+
+	static void Clear(GPUCacheQuantizationReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheQuantizationReport) );
+	}
+};
+
+bool BenchmarkQuantization( const GPUCacheSyntheticOptions &options, const int numberOfIterations, GPUCacheQuantizationReport &report );
+
+void PrintQuantizationReport( const GPUCacheQuantizationReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// post-transform cache efficiency of the saved index buffers, models have a shuffled triangle order
+
+struct GPUCacheIndexReport
+{
+	int			numberOfModels;
+	int			numberOfTriangles;
+	int			numberOfIterations;
+
+	float		acmrBefore;			// simulated fifo (MESH_SIMULATE_CACHE_SIZE), transformed vertices per triangle
+	float		atvrBefore;			// transformed per unique vertex
+	float		acmrAfter;
+	float		atvrAfter;
+
+	double		plainSave;			// ms, the whole export
+	double		optimizedSave;
+	double		optimizeRate;		// M triangles/s, vertex cache optimization of one model
+
+	bool		trianglesPreserved;	// same triangles (by positions and winding) in both packs
+
+	static void Clear(GPUCacheIndexReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheIndexReport) );
+	}
+};
+
+bool BenchmarkIndexOptimization( const GPUCacheSyntheticOptions &options, const int numberOfIterations, GPUCacheIndexReport &report );
+
+void PrintIndexReport( const GPUCacheIndexReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// vertex merge of the loader against the copy chain it replaced (temporary arrays of all streams,
+//	a copy into the client arrays in PrepCacheBuffers, scalar index rebase). Bytes are counted for the cpu copies
+//	(read + write) and for the client arrays which glBufferData reads, the pack is float
+
+#define VERTEX_MERGE_BENCHMARK_CONFIGS		2		// 32 and 16 bit pack indices
+
+struct GPUCacheVertexMergeReport
+{
+	int			numberOfVertices;
+	int			numberOfIndices;
+	int			numberOfThreads;
+	int			numberOfIterations;
+
+	int			indexStride[VERTEX_MERGE_BENCHMARK_CONFIGS];
+
+	double		copyChainTime[VERTEX_MERGE_BENCHMARK_CONFIGS];		// ms, best of the iterations
+	double		mergeTime[VERTEX_MERGE_BENCHMARK_CONFIGS];			// one thread
+	double		mergeThreadsTime[VERTEX_MERGE_BENCHMARK_CONFIGS];	// numberOfThreads
+
+	size_t		copyChainBytes[VERTEX_MERGE_BENCHMARK_CONFIGS];
+	size_t		mergeBytes[VERTEX_MERGE_BENCHMARK_CONFIGS];
+	size_t		copyChainHeap[VERTEX_MERGE_BENCHMARK_CONFIGS];		// peak client memory of the streams
+	size_t		mergeHeap[VERTEX_MERGE_BENCHMARK_CONFIGS];
+
+	bool		equal;			// both give the same streams
+
+	static void Clear(GPUCacheVertexMergeReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheVertexMergeReport) );
+	}
+};
+
+bool BenchmarkVertexMerge( const GPUCacheSyntheticOptions &options, const int numberOfIterations, GPUCacheVertexMergeReport &report );
+
+void PrintVertexMergeReport( const GPUCacheVertexMergeReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// instance records of the repeated meshes (same local geometry), pack size and load time
+
+struct GPUCacheInstancesReport
+{
+	int			numberOfModels;
+	int			numberOfInstances;
+	int			numberOfIterations;
+
+	size_t		plainPackSize;			// geometry pack without the instance detection
+	size_t		instancedPackSize;
+
+	double		plainSave;				// ms, the whole export
+	double		instancedSave;
+	double		plainLoad;				// ms, loader with the null visitor, average
+	double		instancedLoad;
+	double		plainMerge;				// ms, MergeGeometryStreams of all streams
+	double		instancedMerge;
+
+	int			plainVertices;			// vertices in the merged buffers
+	int			instancedVertices;
+
+	static void Clear(GPUCacheInstancesReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheInstancesReport) );
+	}
+};
+
+bool BenchmarkInstances( const GPUCacheSyntheticOptions &options, const int numberOfIterations, GPUCacheInstancesReport &report );
+
+void PrintInstancesReport( const GPUCacheInstancesReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// triangle clusters of the saver, bounds are checked against the merged streams (float and quantized pack),
+//	culling of the float pack is measured for random views against the model bounding spheres
+
+#define CLUSTERS_BENCHMARK_CONFIGS		2		// float and quantized streams
+
+struct GPUCacheClustersReport
+{
+	int			numberOfModels;
+	int			numberOfClusters;
+	int			numberOfViews;
+	float		trianglesPerCluster;
+
+	int			sphereViolations[CLUSTERS_BENCHMARK_CONFIGS];	// vertices outside of the cluster sphere
+	float		sphereWorst[CLUSTERS_BENCHMARK_CONFIGS];		// max distance outside
+	int			coneViolations[CLUSTERS_BENCHMARK_CONFIGS];		// triangles with a normal outside of the cone
+	bool		covered[CLUSTERS_BENCHMARK_CONFIGS];			// each model index is in exactly one cluster
+
+	// per view
+	double		allTriangles;
+	double		sphereTriangles;		// models in the frustum
+	double		clusterTriangles;		// visible clusters of the models in the frustum
+	double		clusterRanges;			// draw ranges after merging the neighbour clusters
+
+	double		sphereCullTime;			// ms per view
+	double		clusterCullTime;
+
+	static void Clear(GPUCacheClustersReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheClustersReport) );
+	}
+};
+
+bool BenchmarkClusters( const GPUCacheSyntheticOptions &options, const int numberOfViews, GPUCacheClustersReport &report );
+
+void PrintClustersReport( const GPUCacheClustersReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// discrete lods of the saver, the simplifier on one model and the lod selection along a camera path
+//	over the grid (1080p, 60 degrees vertical fov, 1 pixel error), with and without the hysteresis
+
+#define LODS_BENCHMARK_HYSTERESIS		2		// 0.0 and 0.25
+
+struct GPUCacheLodsReport
+{
+	int			numberOfModels;
+	int			numberOfLods;			// including the source level
+	int			numberOfFrames;
+
+	int			levelTriangles[MESH_LOD_MAX_LEVELS];	// all models
+	float		levelError[MESH_LOD_MAX_LEVELS];		// max of the models, model units
+
+	size_t		plainPackSize;
+	size_t		lodPackSize;
+	double		plainSave;				// ms, the whole export
+	double		lodSave;
+
+	int			simplifyTriangles;		// source triangles of the simplified model
+	float		simplifyError;			// half of the triangles, error of SimplifyMesh
+	double		simplifyRate;			// M source triangles/s
+
+	int			outOfRange;				// lod indices outside of the record vertices
+	int			mismatches;				// merged lod indices which differ from the pack
+
+	float		hysteresis[LODS_BENCHMARK_HYSTERESIS];
+	double		fullTriangles;			// per frame, source levels of all models
+	double		lodTriangles[LODS_BENCHMARK_HYSTERESIS];
+	double		switches[LODS_BENCHMARK_HYSTERESIS];		// level changes per frame
+	double		selectTime[LODS_BENCHMARK_HYSTERESIS];		// ms per frame
+
+	static void Clear(GPUCacheLodsReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheLodsReport) );
+	}
+};
+
+bool BenchmarkLods( const GPUCacheSyntheticOptions &options, const int numberOfLods, const int numberOfFrames, GPUCacheLodsReport &report );
+
+void PrintLodsReport( const GPUCacheLodsReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// partial loading, models selected by names and by a box are read from a pack with the instances and lods
+//	each loaded model has to carry the same streams as in the full load, an old pack without
+//	a table of contents has to fail the partial loading and still load as a whole
+
+struct GPUCachePartialLoadReport
+{
+	int			numberOfModels;
+	int			numberOfInstances;		// instance records of the full pack
+
+	int			nameExpected;			// selected names which are in the manifest
+	int			nameLoaded;
+	int			nameMismatches;			// unexpected model, missing model or different streams
+	bool		sourceCopied;			// instance without the selected source gets the source streams
+	bool		instanceKept;			// instance with the selected source stays an instance record
+
+	int			boxExpected;			// manifest bounds which intersect the box
+	int			boxLoaded;
+	int			boxMismatches;
+
+	int			lodOutOfRange;			// rebased lod indices of the partial packs
+	int			lodMismatches;
+
+	bool		noTocRejected;			// partial loading fails without any model
+	bool		noTocFullLoad;			// full loading still works
+
+	double		fullLoad;				// ms
+	double		nameLoad;
+	double		boxLoad;
+
+	static void Clear(GPUCachePartialLoadReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCachePartialLoadReport) );
+	}
+};
+
+bool BenchmarkPartialLoad( const GPUCacheSyntheticOptions &options, GPUCachePartialLoadReport &report );
+
+void PrintPartialLoadReport( const GPUCachePartialLoadReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// tests
+
+// quantization error is in the format precision, the pack is smaller
+bool TestQuantization();
+
+// optimized indices have a lower acmr / atvr and draw the same triangles
+bool TestIndexOptimization();
+
+// merge gives the same streams with fewer bytes moved
+bool TestVertexMerge();
+
+// each repeated mesh is an instance record, the pack and the merged buffers are smaller
+bool TestInstances();
+
+// cluster bounds hold the merged streams, clusters cull more triangles than the model spheres
+bool TestClusters();
+
+// lod indices are in the record vertices, levels are coarser and the camera path draws fewer triangles
+bool TestLods();
+
+// selected models carry the streams of the full load, sources of the instances are copied in, lods are rebased
+bool TestPartialLoad();
@@ -0,0 +1,2157 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_benchmarkRender.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_benchmarkRender.h"
+#include "shared_common.h"
+#include "shared_geometryHeap.h"
+#include "shared_geometryBatch.h"
+#include "graphics/GLRecorder.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <deque>
+#include <map>
+#include <algorithm>
+
+typedef std::chrono::high_resolution_clock	BenchmarkClock;
+
+static double ElapsedMs( const BenchmarkClock::time_point &start )
+{
+	return std::chrono::duration<double, std::milli>( BenchmarkClock::now() - start ).count();
+}
+
+// lcg in [0; 1)
+static float RandomFloat( unsigned int &state )
+{
+	state = state * 1664525u + 1013904223u;
+	return (float) (state >> 8) / 16777216.0f;
+}
+
+// perspective camera at (0, 0, distance) looking down the -z, 57 degrees vertical fov, 3:2
+static void MakeAxisView( const float distance, const float zFar, CFrustum &frustum )
+{
+	const float zNear = 1.0f;
+	const float t = 1.0f / tanf(0.5f);
+
+	float projection[16], modelview[16];
+	memset( projection, 0, sizeof(float) * 16 );
+	memset( modelview, 0, sizeof(float) * 16 );
+
+	projection[0] = t / 1.5f;
+	projection[5] = t;
+	projection[10] = (zFar + zNear) / (zNear - zFar);
+	projection[11] = -1.0f;
+	projection[14] = 2.0f * zFar * zNear / (zNear - zFar);
+
+	modelview[0] = modelview[5] = modelview[10] = modelview[15] = 1.0f;
+	modelview[14] = -distance;
+
+	frustum.CalculateFrustum( projection, modelview );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// frustum culling
+
+class CFrustumCullingCollector : public CFrustumCullingOutput
+{
+public:
+	//! a constructor
+	CFrustumCullingCollector(const int numberOfChunks)
+		: mChunks(numberOfChunks)
+	{}
+
+	virtual void OnVisibleChunk(const int chunk, const unsigned int *visible, const int count) override
+	{
+		mChunks[chunk].assign( visible, visible + count );
+	}
+
+	// chunks go in the sphere order
+	void Collect(std::vector<unsigned int> &visible) const
+	{
+		visible.clear();
+		for (auto iter=begin(mChunks); iter!=end(mChunks); ++iter)
+			visible.insert( end(visible), begin(*iter), end(*iter) );
+	}
+
+protected:
+	std::vector<std::vector<unsigned int>>	mChunks;
+};
+
+bool BenchmarkFrustumCulling( const int numberOfSpheres, const int numberOfIterations, GPUCacheFrustumCullingReport &report )
+{
+	GPUCacheFrustumCullingReport::Clear(report);
+
+	report.numberOfSpheres = numberOfSpheres;
+	report.numberOfIterations = std::max(1, numberOfIterations);
+
+	// flat slab of spheres in front of the camera
+	std::vector<vec4>	spheres(numberOfSpheres);
+	unsigned int state = 3;
+
+	for (auto iter=begin(spheres); iter!=end(spheres); ++iter)
+	{
+		const float x = -500.0f + 1000.0f * RandomFloat(state);
+		const float y = -500.0f + 1000.0f * RandomFloat(state);
+		const float z = -100.0f + 200.0f * RandomFloat(state);
+		*iter = vec4( x, y, z, 0.1f + 4.9f * RandomFloat(state) );
+	}
+
+	CFrustum frustum;
+	MakeAxisView( 100.0f, 800.0f, frustum );
+	const vec3 eyePos(0.0f, 0.0f, 100.0f);
+
+	// reference
+	std::vector<unsigned int>	reference;
+	float referenceFar = 0.0f;
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+
+	for (int i=0; i<report.numberOfIterations; ++i)
+	{
+		reference.clear();
+		referenceFar = 0.0f;
+
+		for (int j=0; j<numberOfSpheres; ++j)
+		{
+			const vec4 &s = spheres[j];
+			if (false == frustum.SphereInFrustum( s.x, s.y, s.z, s.w ) )
+				continue;
+
+			const float dx = s.x - eyePos.x;
+			const float dy = s.y - eyePos.y;
+			const float dz = s.z - eyePos.z;
+			referenceFar = std::max( referenceFar, s.w + sqrtf(dx*dx + dy*dy + dz*dz) );
+			reference.push_back( (unsigned int) j );
+		}
+	}
+
+	report.referenceTime = ElapsedMs(start) / (double) report.numberOfIterations;
+	report.numberOfVisible = (int) reference.size();
+	report.farDistance = referenceFar;
+
+	std::vector<unsigned int>	visible;
+
+	for (int simd=0; simd<3; ++simd)
+	{
+		for (int t=0; t<FRUSTUM_CULLING_BENCHMARK_THREADS; ++t)
+		{
+			const int numberOfThreads = 1 << t;
+			report.threads[t] = numberOfThreads;
+
+			CFrustumCulling culling;
+			culling.SetSpheres( spheres.data(), numberOfSpheres );
+			culling.SetSimd( (EFrustumCullingSimd) simd );
+			culling.SetNumberOfThreads( numberOfThreads );
+
+			report.simdUsed[simd] = (int) culling.GetSimd();
+
+			CFrustumCullingCollector collector( culling.GetNumberOfChunks() );
+			float farDistance = 0.0f;
+			int numberOfVisible = 0;
+
+			start = BenchmarkClock::now();
+
+			for (int i=0; i<report.numberOfIterations; ++i)
+				numberOfVisible = culling.Cull( frustum, eyePos, &collector, farDistance );
+
+			report.cullTime[simd][t] = ElapsedMs(start) / (double) report.numberOfIterations;
+
+			collector.Collect(visible);
+			report.equal[simd][t] = (visible == reference && numberOfVisible == (int) reference.size() 
+				&& fabsf(farDistance - referenceFar) <= 1e-3f * referenceFar);
+		}
+	}
+
+	return true;
+}
+
+void PrintFrustumCullingReport( const GPUCacheFrustumCullingReport &report )
+{
+	printf( "frustum culling benchmark - %d spheres, %d visible, far %.2f, average of %d runs\n", report.numberOfSpheres, 
+		report.numberOfVisible, report.farDistance, report.numberOfIterations );
+	printf( "  serial reference   %10.3f ms\n", report.referenceTime );
+
+	const char *names[3] = { "scalar", "sse   ", "avx   " };
+	for (int simd=0; simd<3; ++simd)
+	{
+		for (int t=0; t<FRUSTUM_CULLING_BENCHMARK_THREADS; ++t)
+		{
+			printf( "  %s (used %s) %d threads %8.3f ms, x%.1f %s\n", names[simd], names[report.simdUsed[simd]], report.threads[t], 
+				report.cullTime[simd][t], report.referenceTime / std::max(1e-6, report.cullTime[simd][t]), 
+				(report.equal[simd][t]) ? "ok" : "MISMATCH" );
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// bounding volume hierarchy
+
+// the same test as the hierarchy one, distance to the sphere surface, 0 for the origin inside
+static bool IntersectRaySphere( const vec4 &sphere, const vec3 &origin, const vec3 &dir, const float maxDistance, float &distance )
+{
+	const float ox = origin.x - sphere.x;
+	const float oy = origin.y - sphere.y;
+	const float oz = origin.z - sphere.z;
+	const float c = ox*ox + oy*oy + oz*oz - sphere.w * sphere.w;
+
+	if (c <= 0.0f)
+	{
+		distance = 0.0f;
+		return true;
+	}
+
+	const float b = ox*dir.x + oy*dir.y + oz*dir.z;
+	const float disc = b*b - c;
+	if (b > 0.0f || disc < 0.0f)
+		return false;
+
+	distance = -b - sqrtf(disc);
+	return (distance <= maxDistance);
+}
+
+static void ScanFrustum( const std::vector<vec4> &spheres, const CFrustum &frustum, std::vector<int> &items )
+{
+	items.clear();
+	for (int i=0; i<(int) spheres.size(); ++i)
+	{
+		if (frustum.SphereInFrustum( spheres[i].x, spheres[i].y, spheres[i].z, spheres[i].w ) )
+			items.push_back(i);
+	}
+}
+
+static bool EqualItems( std::vector<int> &items, const std::vector<int> &reference )
+{
+	std::sort( begin(items), end(items) );
+	return (items == reference);
+}
+
+bool BenchmarkHierarchy( const int numberOfItems, const int numberOfRays, GPUCacheHierarchyReport &report )
+{
+	GPUCacheHierarchyReport::Clear(report);
+
+	report.numberOfItems = numberOfItems;
+	report.numberOfRays = std::max(1, numberOfRays);
+
+	// items keep the same density for any number
+	const float extent = 20.0f * sqrtf( (float) numberOfItems );
+	unsigned int state = (unsigned int) numberOfItems;
+
+	std::vector<vec4>	spheres(numberOfItems);
+	for (auto iter=begin(spheres); iter!=end(spheres); ++iter)
+	{
+		const float x = extent * (2.0f * RandomFloat(state) - 1.0f);
+		const float y = 50.0f * RandomFloat(state);
+		const float z = extent * (2.0f * RandomFloat(state) - 1.0f);
+		*iter = vec4( x, y, z, 0.5f + 7.5f * RandomFloat(state) );
+	}
+
+	CFrustum frustum;
+	MakeAxisView( -20.0f, 2000.0f, frustum );
+
+	CBoundingVolumeHierarchy hierarchy;
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	hierarchy.Build( spheres.data(), numberOfItems );
+	report.buildTime = ElapsedMs(start);
+	report.buildCost = hierarchy.GetBuildCost();
+	report.numberOfNodes = hierarchy.GetNumberOfNodes();
+
+	std::vector<int> reference, items;
+	const int iterations = 10;
+
+	// frustum
+	start = BenchmarkClock::now();
+	for (int i=0; i<iterations; ++i)
+		ScanFrustum( spheres, frustum, reference );
+	report.frustumLinear = ElapsedMs(start) / (double) iterations;
+
+	start = BenchmarkClock::now();
+	for (int i=0; i<iterations; ++i)
+	{
+		items.clear();
+		hierarchy.QueryFrustum( frustum, items );
+	}
+	report.frustumTree = ElapsedMs(start) / (double) iterations;
+	report.frustumVisible = (int) reference.size();
+	report.frustumEqual = EqualItems( items, reference );
+
+	// sphere
+	const vec3 center(0.0f, 10.0f, 0.0f);
+	const float radius = 200.0f;
+
+	start = BenchmarkClock::now();
+	for (int i=0; i<iterations; ++i)
+	{
+		reference.clear();
+		for (int j=0; j<numberOfItems; ++j)
+		{
+			const float dx = spheres[j].x - center.x;
+			const float dy = spheres[j].y - center.y;
+			const float dz = spheres[j].z - center.z;
+			const float r = spheres[j].w + radius;
+
+			if (dx*dx + dy*dy + dz*dz <= r*r)
+				reference.push_back(j);
+		}
+	}
+	report.sphereLinear = ElapsedMs(start) / (double) iterations;
+
+	start = BenchmarkClock::now();
+	for (int i=0; i<iterations; ++i)
+	{
+		items.clear();
+		hierarchy.QuerySphere( center, radius, items );
+	}
+	report.sphereTree = ElapsedMs(start) / (double) iterations;
+	report.sphereEqual = EqualItems( items, reference );
+
+	// box
+	const vec3 boxMin(-300.0f, 0.0f, -100.0f);
+	const vec3 boxMax(100.0f, 30.0f, 250.0f);
+
+	reference.clear();
+	for (int j=0; j<numberOfItems; ++j)
+	{
+		const vec4 &s = spheres[j];
+		const float dx = std::max( 0.0f, std::max(boxMin.x - s.x, s.x - boxMax.x) );
+		const float dy = std::max( 0.0f, std::max(boxMin.y - s.y, s.y - boxMax.y) );
+		const float dz = std::max( 0.0f, std::max(boxMin.z - s.z, s.z - boxMax.z) );
+
+		if (dx*dx + dy*dy + dz*dz <= s.w * s.w)
+			reference.push_back(j);
+	}
+
+	items.clear();
+	hierarchy.QueryBox( boxMin, boxMax, items );
+	report.boxEqual = EqualItems( items, reference );
+
+	// horizontal rays through the items, nearest hit
+	std::vector<vec3>	origins(report.numberOfRays);
+	std::vector<vec3>	dirs(report.numberOfRays);
+	std::vector<int>	nearest(report.numberOfRays);
+
+	for (int i=0; i<report.numberOfRays; ++i)
+	{
+		origins[i] = vec3( extent * (2.0f * RandomFloat(state) - 1.0f), 25.0f, extent * (2.0f * RandomFloat(state) - 1.0f) );
+		dirs[i] = vec3( 2.0f * RandomFloat(state) - 1.0f, 0.0f, 2.0f * RandomFloat(state) - 1.0f );
+		normalize(dirs[i]);
+	}
+
+	start = BenchmarkClock::now();
+	for (int i=0; i<report.numberOfRays; ++i)
+	{
+		int best = -1;
+		float bestDistance = FLT_MAX;
+
+		for (int j=0; j<numberOfItems; ++j)
+		{
+			float distance;
+			if (IntersectRaySphere( spheres[j], origins[i], dirs[i], bestDistance, distance ) && (distance < bestDistance || best < 0) )
+			{
+				bestDistance = distance;
+				best = j;
+			}
+		}
+		nearest[i] = best;
+	}
+	report.rayLinear = ElapsedMs(start) / (double) report.numberOfRays;
+
+	report.rayEqual = true;
+	start = BenchmarkClock::now();
+	for (int i=0; i<report.numberOfRays; ++i)
+	{
+		float distance;
+		if (hierarchy.IntersectRay( origins[i], dirs[i], FLT_MAX, distance ) != nearest[i])
+			report.rayEqual = false;
+	}
+	report.rayTree = ElapsedMs(start) / (double) report.numberOfRays;
+
+	// all items along the first ray
+	reference.clear();
+	for (int j=0; j<numberOfItems; ++j)
+	{
+		float distance;
+		if (IntersectRaySphere( spheres[j], origins[0], dirs[0], 500.0f, distance ) )
+			reference.push_back(j);
+	}
+
+	items.clear();
+	hierarchy.QueryRay( origins[0], dirs[0], 500.0f, items );
+	report.rayAllEqual = EqualItems( items, reference );
+
+	// refit, 1% of the items move
+	for (int i=0; i<numberOfItems / 100; ++i)
+	{
+		const int index = (int) (RandomFloat(state) * (float) numberOfItems) % numberOfItems;
+		spheres[index].x += 5.0f;
+		spheres[index].z -= 3.0f;
+		hierarchy.UpdateItem( index, spheres[index] );
+	}
+
+	start = BenchmarkClock::now();
+	report.refitNodes = hierarchy.Refit();
+	report.refitTime = ElapsedMs(start);
+
+	ScanFrustum( spheres, frustum, reference );
+	items.clear();
+	hierarchy.QueryFrustum( frustum, items );
+	report.refitEqual = EqualItems( items, reference );
+
+	// all items move
+	for (int i=0; i<numberOfItems; ++i)
+	{
+		spheres[i].x += 1.0f;
+		hierarchy.UpdateItem( i, spheres[i] );
+	}
+
+	start = BenchmarkClock::now();
+	hierarchy.Refit();
+	report.refitAllTime = ElapsedMs(start);
+	report.refitCost = hierarchy.ComputeCost();
+
+	ScanFrustum( spheres, frustum, reference );
+	items.clear();
+	hierarchy.QueryFrustum( frustum, items );
+	report.refitEqual = report.refitEqual && EqualItems( items, reference );
+
+	return true;
+}
+
+void PrintHierarchyReport( const GPUCacheHierarchyReport &report )
+{
+	printf( "hierarchy benchmark - %d items, %d nodes, %d rays\n", report.numberOfItems, report.numberOfNodes, report.numberOfRays );
+	printf( "  build              %10.2f ms, cost %.1f (%.1f after the refits)\n", report.buildTime, report.buildCost, report.refitCost );
+	printf( "  refit              %10.3f ms for 1%% (%d nodes), %.2f ms for all items\n", report.refitTime, report.refitNodes, report.refitAllTime );
+	printf( "  frustum            %10.3f ms linear, %.4f ms tree (x%.1f), %d visible %s\n", report.frustumLinear, report.frustumTree, 
+		report.frustumLinear / std::max(1e-6, report.frustumTree), report.frustumVisible, (report.frustumEqual) ? "ok" : "MISMATCH" );
+	printf( "  sphere             %10.3f ms linear, %.4f ms tree (x%.1f) %s\n", report.sphereLinear, report.sphereTree, 
+		report.sphereLinear / std::max(1e-6, report.sphereTree), (report.sphereEqual) ? "ok" : "MISMATCH" );
+	printf( "  nearest ray        %10.3f ms linear, %.4f ms tree (x%.1f) %s\n", report.rayLinear, report.rayTree, 
+		report.rayLinear / std::max(1e-6, report.rayTree), (report.rayEqual) ? "ok" : "MISMATCH" );
+	printf( "  box %s, ray items %s, refit %s\n", (report.boxEqual) ? "ok" : "MISMATCH", (report.rayAllEqual) ? "ok" : "MISMATCH", 
+		(report.refitEqual) ? "ok" : "MISMATCH" );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// normal matrices
+
+// model record of the gpu buffer
+struct NormalMatrixRecord
+{
+	mat4	transform;
+	mat4	normalMatrix;
+};
+
+// rotation, non uniform scale and translation
+static mat4 RandomAffine( unsigned int &state )
+{
+	vec3 axis( 2.0f * RandomFloat(state) - 1.0f, 2.0f * RandomFloat(state) - 1.0f, 2.0f * RandomFloat(state) - 1.0f );
+	normalize(axis);
+
+	mat4 rotation;
+	rotation.identity();
+	rotation.set_rot( 6.0f * RandomFloat(state) - 3.0f, axis );
+
+	mat4 scale;
+	scale.identity();
+	scale.a00 = 0.5f + 2.0f * RandomFloat(state);
+	scale.a11 = 0.5f + 2.0f * RandomFloat(state);
+	scale.a22 = 0.5f + 2.0f * RandomFloat(state);
+
+	mat4 result = rotation * scale;
+	result.set_translation( vec3( 200.0f * RandomFloat(state) - 100.0f, 200.0f * RandomFloat(state) - 100.0f, 200.0f * RandomFloat(state) - 100.0f ) );
+	return result;
+}
+
+// the per model loop which is replaced by the batch
+static void ComputeNormalMatricesReference( const mat4 &view, std::vector<NormalMatrixRecord> &records )
+{
+	mat4 inv;
+	for (auto iter=begin(records); iter!=end(records); ++iter)
+	{
+		iter->normalMatrix = view * iter->transform;
+		iter->normalMatrix.set_translation( vec3(0.0f, 0.0f, 0.0f) );
+		invert( inv, iter->normalMatrix );
+		iter->normalMatrix = transpose(inv);
+	}
+}
+
+static float NormalMatrixError( const float *value, const float *reference, const int count )
+{
+	float error = 0.0f;
+	for (int i=0; i<count; ++i)
+		error = std::max( error, fabsf(value[i] - reference[i]) / (1.0f + fabsf(reference[i])) );
+	return error;
+}
+
+static float NormalMatricesError( const std::vector<NormalMatrixRecord> &records, const std::vector<NormalMatrixRecord> &reference )
+{
+	float error = 0.0f;
+	for (size_t i=0; i<records.size(); ++i)
+		error = std::max( error, NormalMatrixError( records[i].normalMatrix.mat_array, reference[i].normalMatrix.mat_array, 16 ) );
+	return error;
+}
+
+static int UpdateNormalMatrices( CNormalMatrices &matrices, const mat4 &view, std::vector<NormalMatrixRecord> &records )
+{
+	return matrices.Update( view, records[0].transform.mat_array, sizeof(NormalMatrixRecord), 
+		records[0].normalMatrix.mat_array, sizeof(NormalMatrixRecord), eNormalMatricesLayout4x4 );
+}
+
+bool BenchmarkNormalMatrices( const int numberOfModels, const int numberOfIterations, GPUCacheNormalMatricesReport &report )
+{
+	GPUCacheNormalMatricesReport::Clear(report);
+
+	if (numberOfModels <= 0)
+		return false;
+
+	report.numberOfModels = numberOfModels;
+	report.numberOfIterations = std::max(1, numberOfIterations);
+
+	unsigned int state = 1;
+
+	std::vector<NormalMatrixRecord>	models(numberOfModels);
+	for (auto iter=begin(models); iter!=end(models); ++iter)
+	{
+		iter->transform = RandomAffine(state);
+		iter->normalMatrix.identity();
+	}
+
+	// view of the camera and the parent transform of the cache
+	const mat4 view = RandomAffine(state) * RandomAffine(state);
+
+	std::vector<NormalMatrixRecord>	reference(models);
+	ComputeNormalMatricesReference( view, reference );
+
+	// correctness of each simd and layout
+	std::vector<float>	compact(numberOfModels * 24);
+
+	for (int simd=0; simd<3; ++simd)
+	{
+		for (int layout=0; layout<NORMAL_MATRICES_BENCHMARK_LAYOUTS; ++layout)
+		{
+			CNormalMatrices matrices;
+			matrices.SetSimd( (ENormalMatricesSimd) simd );
+			matrices.SetNumberOfThreads(1);
+			matrices.SetNumberOfModels(numberOfModels);
+
+			report.simdUsed[simd] = (int) matrices.GetSimd();
+
+			std::vector<NormalMatrixRecord>	records(models);
+			float error = 0.0f;
+
+			if (layout == 0)
+			{
+				report.updated[simd][layout] = UpdateNormalMatrices( matrices, view, records );
+				error = NormalMatricesError( records, reference );
+			}
+			else
+			{
+				report.updated[simd][layout] = matrices.Update( view, records[0].transform.mat_array, sizeof(NormalMatrixRecord), 
+					compact.data(), sizeof(float) * 24, eNormalMatricesLayout3x4 );
+
+				for (int i=0; i<numberOfModels; ++i)
+				{
+					const float *record = &compact[i * 24];
+					const float *transform = models[i].transform.mat_array;
+					const float *normalMatrix = reference[i].normalMatrix.mat_array;
+
+					// rows of the affine transform
+					for (int row=0; row<3; ++row)
+						for (int col=0; col<4; ++col)
+							error = std::max( error, fabsf(record[row * 4 + col] - transform[col * 4 + row]) );
+
+					// columns of the normal matrix
+					for (int col=0; col<3; ++col)
+						error = std::max( error, NormalMatrixError( record + 12 + col * 4, normalMatrix + col * 4, 4 ) );
+				}
+			}
+
+			report.maxError[simd][layout] = error;
+		}
+	}
+
+	// moved models with the view translation changed, that doesn't need a full pass
+	{
+		CNormalMatrices matrices;
+		matrices.SetNumberOfModels(numberOfModels);
+
+		std::vector<NormalMatrixRecord>	records(models);
+		UpdateNormalMatrices( matrices, view, records );
+
+		std::vector<NormalMatrixRecord>	moved(models);
+		for (int i=0; i<numberOfModels; i+=7)
+		{
+			moved[i].transform = RandomAffine(state);
+			records[i].transform = moved[i].transform;
+			matrices.SetModelDirty(i);
+			report.partialDirty += 1;
+		}
+
+		mat4 translated(view);
+		translated.set_translation( vec3(5.0f, 6.0f, 7.0f) );
+
+		report.partialUpdated = UpdateNormalMatrices( matrices, translated, records );
+
+		ComputeNormalMatricesReference( view, moved );
+		report.partialError = NormalMatricesError( records, moved );
+	}
+
+	// hardware threads
+	{
+		CNormalMatrices matrices;
+		matrices.SetNumberOfThreads(0);
+		matrices.SetNumberOfModels(numberOfModels);
+
+		std::vector<NormalMatrixRecord>	records(models);
+		report.threadsUpdated = UpdateNormalMatrices( matrices, view, records );
+		report.threadsError = NormalMatricesError( records, reference );
+	}
+
+	// timing
+	{
+		std::vector<NormalMatrixRecord>	records(models);
+
+		const BenchmarkClock::time_point start = BenchmarkClock::now();
+		for (int i=0; i<report.numberOfIterations; ++i)
+			ComputeNormalMatricesReference( view, records );
+		report.referenceTime = ElapsedMs(start) / (double) report.numberOfIterations;
+	}
+
+	const float ratios[NORMAL_MATRICES_BENCHMARK_RATIOS] = { 0.01f, 0.1f, 1.0f };
+
+	for (int simd=0; simd<3; ++simd)
+	{
+		for (int r=0; r<NORMAL_MATRICES_BENCHMARK_RATIOS; ++r)
+		{
+			report.dirtyRatio[r] = ratios[r];
+
+			CNormalMatrices matrices;
+			matrices.SetSimd( (ENormalMatricesSimd) simd );
+			matrices.SetNumberOfThreads(1);
+			matrices.SetNumberOfModels(numberOfModels);
+
+			std::vector<NormalMatrixRecord>	records(models);
+			UpdateNormalMatrices( matrices, view, records );
+
+			const int step = std::max(1, (int) (1.0f / ratios[r] + 0.5f) );
+			double total = 0.0;
+
+			for (int i=0; i<report.numberOfIterations; ++i)
+			{
+				if (step > 1)
+				{
+					for (int j=i % step; j<numberOfModels; j+=step)
+						matrices.SetModelDirty(j);
+				}
+				else
+				{
+					matrices.SetAllDirty();
+				}
+
+				const BenchmarkClock::time_point start = BenchmarkClock::now();
+				UpdateNormalMatrices( matrices, view, records );
+				total += ElapsedMs(start);
+			}
+
+			report.updateTime[simd][r] = total / (double) report.numberOfIterations;
+		}
+	}
+
+	{
+		CNormalMatrices matrices;
+		matrices.SetNumberOfModels(numberOfModels);
+
+		std::vector<NormalMatrixRecord>	records(models);
+		UpdateNormalMatrices( matrices, view, records );
+
+		const BenchmarkClock::time_point start = BenchmarkClock::now();
+		for (int i=0; i<report.numberOfIterations; ++i)
+			UpdateNormalMatrices( matrices, view, records );
+		report.idleTime = ElapsedMs(start) / (double) report.numberOfIterations;
+	}
+
+	return true;
+}
+
+void PrintNormalMatricesReport( const GPUCacheNormalMatricesReport &report )
+{
+	printf( "normal matrices benchmark - %d models, average of %d runs\n", report.numberOfModels, report.numberOfIterations );
+	printf( "  scalar loop        %10.3f ms, all models every frame\n", report.referenceTime );
+
+	const char *names[3] = { "scalar", "sse   ", "avx   " };
+	for (int simd=0; simd<3; ++simd)
+	{
+		printf( "  %s (used %s)", names[simd], names[report.simdUsed[simd]] );
+		for (int r=0; r<NORMAL_MATRICES_BENCHMARK_RATIOS; ++r)
+			printf( " %5.1f%% dirty %.3f ms,", 100.0f * report.dirtyRatio[r], report.updateTime[simd][r] );
+		printf( " error %.2g (4x4) %.2g (3x4)\n", report.maxError[simd][0], report.maxError[simd][1] );
+	}
+
+	printf( "  nothing moved      %10.4f ms\n", report.idleTime );
+	printf( "  view translation   %10d of %d dirty models updated, error %.2g\n", report.partialUpdated, report.partialDirty, report.partialError );
+	printf( "  hardware threads   %10d updated, error %.2g\n", report.threadsUpdated, report.threadsError );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// dirty ranges
+
+// size of the material record
+struct DirtyRangesRecord
+{
+	float	data[64];
+};
+
+typedef CResourceGPUModel<DirtyRangesRecord>	CDirtyRangesResource;
+
+static int RandomInt( unsigned int &state, const int count )
+{
+	return (int) (RandomFloat(state) * (float) count) % count;
+}
+
+// random adds, the ranges have to be sorted, separated, in the array and cover every added element
+static bool CheckCoalesce( unsigned int &state, const int trial, double &time )
+{
+	const int numberOfItems = 1 + RandomInt(state, 3000);
+
+	CDirtyRanges ranges;
+	if (trial % 3 == 0)
+		ranges.SetMaxRanges( 1 + RandomInt(state, 8) );
+	if (trial % 5 == 0)
+		ranges.SetMergeGap( RandomInt(state, 3) );
+
+	// adds could go past the end of the array
+	std::vector<char> dirty(numberOfItems, 0);
+	const int numberOfAdds = RandomInt(state, 200);
+
+	for (int i=0; i<numberOfAdds; ++i)
+	{
+		const int first = RandomInt(state, numberOfItems + 20);
+		const int count = (RandomInt(state, 4) == 0) ? 1 + RandomInt(state, 50) : 1;
+
+		ranges.Add(first, count);
+		for (int j=first; j<first+count && j<numberOfItems; ++j)
+			dirty[j] = 1;
+	}
+
+	const BenchmarkClock::time_point start = BenchmarkClock::now();
+	const int numberOfRanges = ranges.Coalesce(numberOfItems);
+	time += ElapsedMs(start);
+
+	if (numberOfRanges > DIRTY_RANGES_MAX_RANGES)
+		return false;
+
+	const DirtyRange *range = ranges.GetRanges();
+	int prevEnd = -1;
+
+	for (int i=0; i<numberOfRanges; ++i)
+	{
+		if (range[i].count <= 0 || range[i].first < 0 || range[i].first + range[i].count > numberOfItems || range[i].first <= prevEnd)
+			return false;
+
+		prevEnd = range[i].first + range[i].count;
+		for (int j=range[i].first; j<prevEnd; ++j)
+			dirty[j] = 0;
+	}
+
+	return (std::find( begin(dirty), end(dirty), 1 ) == end(dirty) );
+}
+
+bool BenchmarkDirtyRanges( const int numberOfTrials, const int numberOfItems, GPUCacheDirtyRangesReport &report )
+{
+	GPUCacheDirtyRangesReport::Clear(report);
+
+	report.numberOfTrials = numberOfTrials;
+	report.numberOfItems = numberOfItems;
+	report.itemSize = (int) sizeof(DirtyRangesRecord);
+
+	unsigned int state = 3;
+	double coalesceTime = 0.0;
+
+	for (int i=0; i<numberOfTrials; ++i)
+	{
+		if (false == CheckCoalesce( state, i, coalesceTime ) )
+			report.coalesceFailures += 1;
+	}
+
+	report.coalesceTime = 1000.0 * coalesceTime / (double) std::max(1, numberOfTrials);
+
+	// bytes per edit
+	CGLRecorder recorder;
+	if (false == recorder.Install() )
+	{
+		printf( "> ERROR: failed to install the gl recorder\n" );
+		return false;
+	}
+
+	{
+		CDirtyRangesResource resource;
+		resource.Allocate(numberOfItems);
+		resource.CauseAGPUUpdate();
+		resource.PrepRender();
+
+		const int edits[DIRTY_RANGES_BENCHMARK_EDITS] = { 1, 10, 100, 1000 };
+
+		recorder.BeginFrame();
+		resource.CauseAGPUUpdate();
+		resource.PrepRender();
+
+		report.fullBytes = recorder.GetFrameStats().uploadedBytes;
+		report.fullCalls = recorder.GetFrameStats().numberOfCalls;
+
+		for (int i=0; i<DIRTY_RANGES_BENCHMARK_EDITS; ++i)
+		{
+			report.edits[i] = edits[i];
+			recorder.BeginFrame();
+
+			const BenchmarkClock::time_point start = BenchmarkClock::now();
+
+			for (int j=0; j<edits[i]; ++j)
+			{
+				const int index = RandomInt(state, numberOfItems);
+				resource.GetDataItem(index).data[0] += 1.0f;
+				resource.CauseAGPUUpdate(index);
+			}
+			resource.PrepRender();
+
+			report.editTime[i] = ElapsedMs(start);
+			report.editBytes[i] = recorder.GetFrameStats().uploadedBytes;
+			report.editCalls[i] = recorder.GetFrameStats().numberOfCalls;
+		}
+
+		recorder.BeginFrame();
+		resource.GetDataItem(17).data[1] = 2.0f;
+		resource.CauseAGPUUpdate(17);
+		resource.PrepRender();
+		report.singleBytes = recorder.GetFrameStats().uploadedBytes;
+		report.singleCalls = recorder.GetFrameStats().numberOfCalls;
+
+		recorder.BeginFrame();
+		for (int i=500; i<600; ++i)
+		{
+			resource.GetDataItem(i).data[2] = (float) i;
+			resource.CauseAGPUUpdate(i);
+		}
+		resource.PrepRender();
+		report.sequentialBytes = recorder.GetFrameStats().uploadedBytes;
+		report.sequentialCalls = recorder.GetFrameStats().numberOfCalls;
+
+		recorder.BeginFrame();
+		DirtyRangesRecord record;
+		memset( &record, 0, sizeof(DirtyRangesRecord) );
+		resource.AddItem(record);
+		resource.CauseAGPUUpdate(numberOfItems);
+		resource.PrepRender();
+		report.appendBytes = recorder.GetFrameStats().uploadedBytes;
+		report.appendCalls = recorder.GetFrameStats().numberOfCalls;
+
+		// the buffer is the only one of the recorder
+		const GLuint64 address = resource.GetGPUPtr(0);
+		report.uploadedEqual = false;
+
+		for (GLuint name=1; name<16; ++name)
+		{
+			size_t size = 0;
+			const unsigned char *data = recorder.GetBufferData(name, size);
+
+			if (data != nullptr && (address == 0 || recorder.GetBufferAddress(name) == address) 
+				&& size == resource.GetDataSize() * sizeof(DirtyRangesRecord) )
+			{
+				report.uploadedEqual = (0 == memcmp( data, resource.GetDataPtr(), size ) );
+				break;
+			}
+		}
+	}
+
+	report.recorderErrors = (int) recorder.GetErrors().size();
+	recorder.Uninstall();
+
+	return true;
+}
+
+void PrintDirtyRangesReport( const GPUCacheDirtyRangesReport &report )
+{
+	printf( "dirty ranges benchmark - %d coalesce cases, %d items of %d bytes\n", report.numberOfTrials, report.numberOfItems, report.itemSize );
+	printf( "  coalesce           %10d failures, %.2f us per call\n", report.coalesceFailures, report.coalesceTime );
+	printf( "  whole array        %10zu bytes, %d calls\n", report.fullBytes, report.fullCalls );
+
+	for (int i=0; i<DIRTY_RANGES_BENCHMARK_EDITS; ++i)
+	{
+		printf( "  %4d edits         %10zu bytes, %d calls, %.1f bytes per edit, %.3f ms\n", report.edits[i], report.editBytes[i], 
+			report.editCalls[i], (double) report.editBytes[i] / (double) report.edits[i], report.editTime[i] );
+	}
+
+	printf( "  single edit        %10zu bytes, %d calls\n", report.singleBytes, report.singleCalls );
+	printf( "  100 neighbours     %10zu bytes, %d calls\n", report.sequentialBytes, report.sequentialCalls );
+	printf( "  append             %10zu bytes, %d calls\n", report.appendBytes, report.appendCalls );
+	printf( "  buffer content %s, recorder errors %d\n", (report.uploadedEqual) ? "ok" : "MISMATCH", report.recorderErrors );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// ring buffer
+
+// allocated range of the model
+struct RingModelRange
+{
+	size_t		offset;
+	size_t		size;
+};
+
+// random allocations, frames and retires, every live range owns its bytes
+static void CheckRingAllocator( unsigned int &state, GPUCacheRingBufferReport &report )
+{
+	const size_t capacity = 64 + (size_t) RandomInt(state, 4000);
+
+	CRingAllocator allocator;
+	allocator.Init(capacity);
+
+	std::vector<char> owned(capacity, 0);
+	std::deque<std::vector<RingModelRange>> frames;
+	std::vector<RingModelRange> current;
+
+	for (int step=0; step<3000; ++step)
+	{
+		const int op = RandomInt(state, 10);
+
+		if (op < 6)
+		{
+			RingModelRange range;
+			range.size = 1 + (size_t) RandomInt(state, (int) capacity / 3 + 1);
+			const size_t alignment = (size_t) 1 << RandomInt(state, 7);
+
+			if (allocator.Allocate(range.size, alignment, range.offset) )
+			{
+				if (range.offset % alignment != 0 || range.offset + range.size > capacity)
+				{
+					report.modelViolations += 1;
+					continue;
+				}
+
+				for (size_t i=range.offset; i<range.offset+range.size; ++i)
+				{
+					if (owned[i] != 0)
+						report.modelViolations += 1;
+					owned[i] = 1;
+				}
+
+				current.push_back(range);
+				report.modelAllocations += 1;
+			}
+			else
+			{
+				// an empty ring has to fit any size
+				if (frames.size() == 0 && current.size() == 0)
+					report.modelViolations += 1;
+				report.modelFailures += 1;
+			}
+		}
+		else if (op < 8)
+		{
+			allocator.EndFrame( (void*) (size_t) (step + 1) );
+			frames.push_back(current);
+			current.clear();
+		}
+		else if (frames.size() > 0)
+		{
+			allocator.RetireOldestFrame();
+
+			for (auto iter=begin(frames.front()); iter!=end(frames.front()); ++iter)
+				memset( owned.data() + iter->offset, 0, iter->size );
+			frames.pop_front();
+		}
+
+		if (allocator.GetUsed() > capacity || allocator.GetNumberOfFrames() != (int) frames.size() )
+			report.modelViolations += 1;
+	}
+
+	while (frames.size() > 0)
+	{
+		allocator.RetireOldestFrame();
+		frames.pop_front();
+	}
+
+	if (current.size() == 0 && allocator.GetUsed() != 0)
+		report.modelViolations += 1;
+}
+
+// frame data has to be at the address of the ring range
+static bool CheckRingData( const CGLRecorder &recorder, const CGPURingBuffer &ring, const GLuint64 address, const size_t count, const float value )
+{
+	size_t size = 0;
+	const unsigned char *data = recorder.GetBufferData(ring.GetBufferId(), size);
+
+	if (data == nullptr || address < ring.GetGPUPtr() || address + count * sizeof(float) > ring.GetGPUPtr() + size)
+		return false;
+
+	const float *values = (const float*) (data + (address - ring.GetGPUPtr()) );
+	return (values[0] == value && values[count-1] == value);
+}
+
+bool BenchmarkRingBuffer( const size_t ringSize, const int numberOfElements, GPUCacheRingBufferReport &report )
+{
+	GPUCacheRingBufferReport::Clear(report);
+
+	report.numberOfRounds = RING_BUFFER_BENCHMARK_ROUNDS;
+	report.numberOfFrames = RING_BUFFER_BENCHMARK_FRAMES;
+	report.ringSize = ringSize;
+	report.frameSize = sizeof(float) * (size_t) numberOfElements;
+
+	unsigned int state = 7;
+
+	for (int i=0; i<RING_BUFFER_BENCHMARK_ROUNDS; ++i)
+		CheckRingAllocator(state, report);
+
+	CGLRecorder recorder;
+	if (false == recorder.Install() )
+	{
+		printf( "> ERROR: failed to install the gl recorder\n" );
+		return false;
+	}
+
+	// fences are signaled by hand, the gpu is one frame behind
+	recorder.SetAutoSignalSyncs(false);
+
+	CGPURingBuffer ring;
+	if (false == ring.Init(ringSize, RING_BUFFER_MAX_FRAMES) || 0 == ring.GetGPUPtr() )
+	{
+		printf( "> ERROR: failed to init the ring buffer\n" );
+		recorder.Uninstall();
+		return false;
+	}
+
+	{
+		CGPUBufferDoubleNV lights;
+		CGPUBufferNV matrices;
+		CGPUBufferSSBO clusters;
+
+		// own buffers have the data of the time before the ring
+		std::vector<float> data(numberOfElements, -1.0f);
+
+		lights.UpdateData( sizeof(float), data.size(), data.data() );
+		lights.UpdateGPUPtr();
+		matrices.UpdateData( sizeof(float), data.size(), data.data() );
+		clusters.UpdateData( sizeof(float), data.size(), data.data() );
+
+		lights.SetRingBuffer(&ring);
+		matrices.SetRingBuffer(&ring);
+		clusters.SetRingBuffer(&ring);
+
+		for (int frame=0; frame<RING_BUFFER_BENCHMARK_FRAMES; ++frame)
+		{
+			std::fill( begin(data), end(data), (float) frame );
+			recorder.BeginFrame();
+
+			lights.UpdateData( sizeof(float), data.size(), data.data() );
+			lights.UpdateGPUPtr();
+			matrices.UpdateData( sizeof(float), data.size(), data.data() );
+			clusters.UpdateData( sizeof(float), data.size(), data.data() );
+
+			clusters.Bind(1);
+			lights.BindAsUniform(1, 0, 0);
+			matrices.BindAsUniform(1, 1, 0);
+
+			report.ringCalls = recorder.GetFrameStats().numberOfCalls;
+			report.ringBytes = recorder.GetFrameStats().uploadedBytes;
+
+			if (matrices.IsInRingBuffer() && clusters.IsInRingBuffer() )
+			{
+				report.ringFrames += 1;
+
+				if (false == CheckRingData(recorder, ring, lights.GetGPUPtr(), data.size(), (float) frame)
+					|| false == CheckRingData(recorder, ring, matrices.GetGPUPtr(), data.size(), (float) frame) )
+				{
+					report.dataMismatches += 1;
+				}
+			}
+
+			if (frame == RING_BUFFER_BENCHMARK_BURST)
+			{
+				std::vector<float> burstData(ringSize / sizeof(float) + 1, 1.0f);
+
+				CGPUBufferNV burst;
+				burst.SetRingBuffer(&ring);
+				burst.UpdateData( sizeof(float), burstData.size(), burstData.data() );
+
+				report.burstInRing = burst.IsInRingBuffer();
+			}
+
+			report.frameBytes = ring.GetAllocator().GetFrameBytes();
+			ring.EndFrame();
+
+			if (frame % 2 == 1)
+				recorder.SignalSyncs(1);
+		}
+
+		// nothing is uploaded in the next frame, ranges of the last one could be reused
+		//	and the own buffers are not written since the ring took over, so nothing is bound
+		recorder.SetLogging(true);
+		recorder.ClearLog();
+
+		lights.UpdateGPUPtr();
+		clusters.Bind(1);
+		lights.BindAsUniform(1, 0, 0);
+		matrices.BindAsUniform(1, 1, 0);
+
+		report.staleDropped = (false == matrices.IsInRingBuffer() && 0 == matrices.GetGPUPtr() 
+			&& false == clusters.IsInRingBuffer() && 0 == lights.GetGPUPtr() );
+
+		const std::vector<std::string> &log = recorder.GetLog();
+		int numberOfBinds = 0;
+
+		for (auto iter=begin(log); iter!=end(log); ++iter)
+		{
+			if (0 == strncmp(iter->c_str(), "glBindBufferBase", 16) )
+			{
+				numberOfBinds += 1;
+				if (iter->find(", 1, 0)") == std::string::npos)
+					report.staleDropped = false;
+			}
+			else if (0 == strncmp(iter->c_str(), "glProgramUniform1ui64NV", 23) )
+			{
+				numberOfBinds += 1;
+				if (iter->find(", 0x0)") == std::string::npos)
+					report.staleDropped = false;
+			}
+			else if (0 == strncmp(iter->c_str(), "glBindBufferRange", 17) || 0 == strncmp(iter->c_str(), "glBindBuffer(", 13) )
+			{
+				report.staleDropped = false;
+			}
+		}
+
+		// ssbo unit and the nv uniform are reset, double nv has no address to set
+		if (numberOfBinds != 2)
+			report.staleDropped = false;
+
+		recorder.SetLogging(false);
+
+		// own buffer paths of the same update
+		CGPUBufferNV ownBuffer;
+		recorder.BeginFrame();
+		ownBuffer.UpdateData( sizeof(float), data.size(), data.data() );
+		ownBuffer.BindAsUniform(1, 1, 0);
+		report.ownCalls = recorder.GetFrameStats().numberOfCalls;
+		report.ownBytes = recorder.GetFrameStats().uploadedBytes;
+
+		CGPUBufferDoubleNV doubleBuffer;
+		recorder.BeginFrame();
+		doubleBuffer.UpdateData( sizeof(float), data.size(), data.data() );
+		doubleBuffer.UpdateGPUPtr();
+		doubleBuffer.BindAsUniform(1, 0, 0);
+		report.doubleCalls = recorder.GetFrameStats().numberOfCalls;
+		report.doubleBytes = recorder.GetFrameStats().uploadedBytes;
+	}
+
+	report.numberOfWaits = ring.GetNumberOfWaits();
+	report.numberOfOverflows = ring.GetNumberOfOverflows();
+	report.numberOfStalls = recorder.GetTotalStats().numberOfStalls;
+
+	ring.Free();
+
+	report.syncObjects = recorder.GetNumberOfObjects(eGLRecordSync);
+	report.recorderErrors = (int) recorder.GetErrors().size();
+	recorder.Uninstall();
+
+	return true;
+}
+
+void PrintRingBufferReport( const GPUCacheRingBufferReport &report )
+{
+	printf( "ring buffer benchmark - %d allocator rounds, %d frames, ring %zu bytes, update %zu bytes\n", report.numberOfRounds, 
+		report.numberOfFrames, report.ringSize, report.frameSize );
+	printf( "  allocator model    %10d allocations, %d without space, %d violations\n", report.modelAllocations, report.modelFailures, report.modelViolations );
+	printf( "  frames in ring     %10d of %d, %d data mismatches, %zu bytes per frame\n", report.ringFrames, report.numberOfFrames, 
+		report.dataMismatches, report.frameBytes );
+	printf( "  burst frame        %10s, previous frame range %s\n", (report.burstInRing) ? "in ring" : "overflow", 
+		(report.staleDropped) ? "not bound" : "BOUND" );
+	printf( "  fences             %10d waits, %d overflows, %d stalls\n", report.numberOfWaits, report.numberOfOverflows, report.numberOfStalls );
+	printf( "  ring update        %10zu bytes, %d calls\n", report.ringBytes, report.ringCalls );
+	printf( "  own buffer update  %10zu bytes, %d calls\n", report.ownBytes, report.ownCalls );
+	printf( "  double nv update   %10zu bytes, %d calls\n", report.doubleBytes, report.doubleCalls );
+	printf( "  sync objects left %d, recorder errors %d\n", report.syncObjects, report.recorderErrors );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// TLSF allocator
+
+// live allocations do not overlap and stay in the capacity
+static bool CheckTLSFOverlaps( const CTLSFAllocator &allocator, const std::vector<int> &live )
+{
+	std::vector<std::pair<unsigned int, unsigned int>> ranges;
+	ranges.reserve(live.size() );
+
+	for (auto iter=begin(live); iter!=end(live); ++iter)
+		ranges.push_back( std::make_pair(allocator.GetOffset(*iter), allocator.GetSize(*iter)) );
+
+	std::sort( begin(ranges), end(ranges) );
+
+	for (size_t i=0; i<ranges.size(); ++i)
+	{
+		if (ranges[i].first + ranges[i].second > allocator.GetCapacity() )
+			return false;
+		if (i > 0 && ranges[i-1].first + ranges[i-1].second > ranges[i].first)
+			return false;
+	}
+	return true;
+}
+
+// random allocations, frees, grows and defragmentations of a small allocator
+static void CheckTLSFAllocator( unsigned int &state, GPUCacheTLSFReport &report )
+{
+	CTLSFAllocator allocator;
+	allocator.Init( 1 + (unsigned int) RandomInt(state, 5000) );
+
+	std::vector<int> live;
+	std::vector<TLSFMove> moves;
+
+	for (int step=0; step<400; ++step)
+	{
+		const int op = RandomInt(state, 10);
+
+		if (op < 5)
+		{
+			const unsigned int size = 1 + (unsigned int) RandomInt(state, (op == 0) ? 2000 : 64);
+			const int handle = allocator.Allocate(size);
+
+			if (handle != TLSF_INVALID)
+			{
+				if (allocator.GetSize(handle) != size || allocator.GetOffset(handle) + size > allocator.GetCapacity() )
+					report.modelViolations += 1;
+
+				live.push_back(handle);
+				report.modelAllocations += 1;
+			}
+		}
+		else if (op < 8)
+		{
+			if (live.size() > 0)
+			{
+				const size_t index = (size_t) RandomInt(state, (int) live.size() );
+				allocator.Free(live[index]);
+				live[index] = live.back();
+				live.pop_back();
+			}
+		}
+		else if (op == 8)
+		{
+			allocator.Grow( allocator.GetCapacity() + (unsigned int) RandomInt(state, 500) );
+		}
+		else
+		{
+			std::map<int, unsigned int> sizes;
+			for (auto iter=begin(live); iter!=end(live); ++iter)
+				sizes[*iter] = allocator.GetSize(*iter);
+
+			allocator.Defragment(moves);
+			report.modelDefrags += 1;
+
+			for (auto iter=begin(moves); iter!=end(moves); ++iter)
+			{
+				if (iter->to > iter->from || iter->size != sizes[iter->handle] || allocator.GetOffset(iter->handle) != iter->to)
+					report.modelViolations += 1;
+			}
+
+			if (allocator.GetNumberOfFreeBlocks() > 1 || allocator.GetFragmentation() != 0.0f)
+				report.modelViolations += 1;
+		}
+
+		if (false == allocator.Validate() || false == CheckTLSFOverlaps(allocator, live) )
+			report.modelViolations += 1;
+	}
+
+	for (auto iter=begin(live); iter!=end(live); ++iter)
+		allocator.Free(*iter);
+
+	if (allocator.GetUsed() != 0 || allocator.GetNumberOfFreeBlocks() != 1 || false == allocator.Validate() )
+		report.modelViolations += 1;
+}
+
+// 100 single elements fill the capacity of 100, every other freed gives no room for 2
+static bool CheckTLSFFill()
+{
+	CTLSFAllocator allocator;
+	allocator.Init(100);
+
+	int handles[100];
+	for (int i=0; i<100; ++i)
+	{
+		handles[i] = allocator.Allocate(1);
+		if (handles[i] == TLSF_INVALID)
+			return false;
+	}
+
+	if (allocator.Allocate(1) != TLSF_INVALID)
+		return false;
+
+	for (int i=0; i<100; i+=2)
+		allocator.Free(handles[i]);
+
+	return (allocator.Allocate(2) == TLSF_INVALID && allocator.Allocate(1) != TLSF_INVALID);
+}
+
+// caches of 1k - 64k vertices
+static unsigned int RandomCacheSize( unsigned int &state )
+{
+	return 1000 + (unsigned int) RandomInt(state, 64537);
+}
+
+// geometry of the cache with the id, indices are local to the range
+static void MakeHeapCache( const unsigned int id, const unsigned int numberOfVertices, const unsigned int numberOfIndices,
+	std::vector<float> &points, std::vector<unsigned int> &indices )
+{
+	points.assign(numberOfVertices * 4, 0.0f);
+	indices.resize(numberOfIndices);
+
+	for (unsigned int i=0; i<numberOfVertices; ++i)
+	{
+		points[4*i] = (float) id;
+		points[4*i+1] = (float) i;
+	}
+	for (unsigned int i=0; i<numberOfIndices; ++i)
+		indices[i] = (id * 7 + i) % numberOfVertices;
+}
+
+// recorded buffers have the cache data at the range offsets
+static bool CheckHeapCache( const CGLRecorder &recorder, const CGeometryHeap &heap, const GeometryHeapRange &range, const unsigned int id )
+{
+	size_t size = 0;
+	const float *points = (const float*) recorder.GetBufferData( heap.GetBufferId(GEOMETRY_HEAP_STREAM_POINT), size );
+	const float *tangents = (const float*) recorder.GetBufferData( heap.GetBufferId(GEOMETRY_HEAP_STREAM_TANGENT), size );
+	const float *uvs = (const float*) recorder.GetBufferData( heap.GetBufferId(GEOMETRY_HEAP_STREAM_UV), size );
+	const unsigned int *indices = (const unsigned int*) recorder.GetBufferData( heap.GetBufferId(GEOMETRY_HEAP_STREAM_INDEX), size );
+
+	if (points == nullptr || tangents == nullptr || uvs == nullptr || indices == nullptr)
+		return false;
+
+	const unsigned int baseVertex = heap.GetBaseVertex(range);
+	const unsigned int firstIndex = heap.GetFirstIndex(range);
+
+	for (unsigned int i=0; i<range.numberOfVertices; ++i)
+	{
+		const unsigned int v = baseVertex + i;
+
+		if (points[4*v] != (float) id || points[4*v+1] != (float) i || tangents[4*v+2] != (float) id || uvs[2*v+1] != (float) i)
+			return false;
+	}
+
+	for (unsigned int i=0; i<range.numberOfIndices; ++i)
+	{
+		if (indices[firstIndex + i] != (id * 7 + i) % range.numberOfVertices)
+			return false;
+	}
+	return true;
+}
+
+// caches are loaded and unloaded, the heap grows and packs the ranges
+static bool BenchmarkGeometryHeap( unsigned int &state, GPUCacheTLSFReport &report )
+{
+	CGLRecorder recorder;
+	if (false == recorder.Install() )
+	{
+		printf( "> ERROR: failed to install the gl recorder\n" );
+		return false;
+	}
+
+	{
+		CGeometryHeap heap;
+		heap.SetCapacity(20000, 60000);
+
+		std::vector<GeometryHeapRange> ranges;
+		std::vector<unsigned int> ids;
+		std::vector<float> points;
+		std::vector<unsigned int> indices;
+		unsigned int nextId = 1;
+
+		report.heapSteps = TLSF_BENCHMARK_HEAP_STEPS;
+
+		for (int step=0; step<TLSF_BENCHMARK_HEAP_STEPS; ++step)
+		{
+			if (ranges.size() < 10 || RandomInt(state, 2) == 0)
+			{
+				const unsigned int numberOfVertices = 100 + (unsigned int) RandomInt(state, 3000);
+				const unsigned int numberOfIndices = 3 * numberOfVertices;
+				const unsigned int id = nextId++;
+
+				GeometryHeapRange range;
+				if (false == heap.Allocate(numberOfVertices, numberOfIndices, range) )
+				{
+					report.heapMismatches += 1;
+					continue;
+				}
+
+				MakeHeapCache( id, numberOfVertices, numberOfIndices, points, indices );
+
+				heap.Upload( range, GEOMETRY_HEAP_STREAM_POINT, points.data() );
+				heap.Upload( range, GEOMETRY_HEAP_STREAM_NORMAL, points.data() );
+				heap.Upload( range, GEOMETRY_HEAP_STREAM_INDEX, indices.data() );
+
+				// tangents and uvs are merged through the mapped ranges
+				float *tangents = (float*) heap.Map( range, GEOMETRY_HEAP_STREAM_TANGENT );
+				if (tangents != nullptr)
+				{
+					for (unsigned int i=0; i<numberOfVertices; ++i)
+						tangents[4*i+2] = (float) id;
+					heap.UnMap(GEOMETRY_HEAP_STREAM_TANGENT);
+				}
+
+				float *uvs = (float*) heap.Map( range, GEOMETRY_HEAP_STREAM_UV );
+				if (uvs != nullptr)
+				{
+					for (unsigned int i=0; i<numberOfVertices; ++i)
+						uvs[2*i+1] = (float) i;
+					heap.UnMap(GEOMETRY_HEAP_STREAM_UV);
+				}
+
+				ranges.push_back(range);
+				ids.push_back(id);
+			}
+			else
+			{
+				const size_t index = (size_t) RandomInt(state, (int) ranges.size() );
+				heap.Release(ranges[index]);
+
+				ranges[index] = ranges.back();
+				ranges.pop_back();
+				ids[index] = ids.back();
+				ids.pop_back();
+			}
+
+			if (step % 500 == 499)
+				heap.Defragment();
+
+			if (step % 50 == 0 || step == TLSF_BENCHMARK_HEAP_STEPS-1)
+			{
+				for (size_t i=0; i<ranges.size(); ++i)
+				{
+					if (false == CheckHeapCache(recorder, heap, ranges[i], ids[i]) )
+						report.heapMismatches += 1;
+					report.heapChecks += 1;
+				}
+			}
+
+			if (false == heap.GetVertexAllocator().Validate() || false == heap.GetIndexAllocator().Validate() )
+				report.heapMismatches += 1;
+		}
+
+		report.heapGrows = heap.GetNumberOfGrows();
+		report.heapDefrags = heap.GetNumberOfDefrags();
+
+		heap.Free();
+		report.heapBuffers = recorder.GetNumberOfObjects(eGLRecordBuffer);
+	}
+
+	report.recorderErrors = (int) recorder.GetErrors().size();
+	recorder.Uninstall();
+
+	return true;
+}
+
+bool BenchmarkTLSF( const int numberOfOperations, GPUCacheTLSFReport &report )
+{
+	GPUCacheTLSFReport::Clear(report);
+
+	report.numberOfRounds = TLSF_BENCHMARK_ROUNDS;
+	unsigned int state = 7;
+
+	for (int i=0; i<TLSF_BENCHMARK_ROUNDS; ++i)
+		CheckTLSFAllocator(state, report);
+
+	report.fillExact = CheckTLSFFill();
+
+	// churn of the cache ranges with 800 and more live ones
+	CTLSFAllocator allocator;
+	allocator.Init(64u << 20);
+
+	std::vector<int> live;
+	live.reserve(2048);
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+
+	for (int i=0; i<numberOfOperations; ++i)
+	{
+		if (live.size() < 800 || RandomInt(state, 2) == 0)
+		{
+			const int handle = allocator.Allocate( RandomCacheSize(state) );
+			if (handle != TLSF_INVALID)
+				live.push_back(handle);
+		}
+		else
+		{
+			const size_t index = (size_t) RandomInt(state, (int) live.size() );
+			allocator.Free(live[index]);
+			live[index] = live.back();
+			live.pop_back();
+		}
+	}
+
+	report.churnOperations = numberOfOperations;
+	report.churnTime = 1000000.0 * ElapsedMs(start) / (double) std::max(1, numberOfOperations);
+	report.churnLive = (int) live.size();
+	report.churnUsed = 100.0f * (float) allocator.GetUsed() / (float) allocator.GetCapacity();
+	report.churnFreeBlocks = allocator.GetNumberOfFreeBlocks();
+	report.churnFragmentation = allocator.GetFragmentation();
+
+	const unsigned int used = allocator.GetUsed();
+	std::vector<TLSFMove> moves;
+
+	start = BenchmarkClock::now();
+	report.defragMoves = allocator.Defragment(moves);
+	report.defragTime = ElapsedMs(start);
+
+	size_t moved = 0;
+	for (auto iter=begin(moves); iter!=end(moves); ++iter)
+		moved += iter->size;
+
+	report.defragMoved = 100.0f * (float) moved / (float) std::max(1u, used);
+	report.defragFragmentation = allocator.GetFragmentation();
+
+	if (false == allocator.Validate() )
+		report.modelViolations += 1;
+
+	// two allocations for one free until the allocator is full
+	allocator.Init(16u << 20);
+	live.clear();
+
+	unsigned int peak = 0;
+
+	for (int i=0; i<numberOfOperations/4; ++i)
+	{
+		if (RandomInt(state, 3) > 0)
+		{
+			const int handle = allocator.Allocate( RandomCacheSize(state) );
+			if (handle != TLSF_INVALID)
+				live.push_back(handle);
+			else
+				report.pressureFailures += 1;
+		}
+		else if (live.size() > 0)
+		{
+			const size_t index = (size_t) RandomInt(state, (int) live.size() );
+			allocator.Free(live[index]);
+			live[index] = live.back();
+			live.pop_back();
+		}
+
+		peak = std::max(peak, allocator.GetUsed() );
+	}
+
+	report.pressurePeak = 100.0f * (float) peak / (float) allocator.GetCapacity();
+	report.pressureFragmentation = allocator.GetFragmentation();
+
+	return BenchmarkGeometryHeap(state, report);
+}
+
+void PrintTLSFReport( const GPUCacheTLSFReport &report )
+{
+	printf( "tlsf benchmark - %d model rounds, %d churn operations\n", report.numberOfRounds, report.churnOperations );
+	printf( "  allocator model    %10d allocations, %d defrags, %d violations, fill %s\n", report.modelAllocations, report.modelDefrags, 
+		report.modelViolations, (report.fillExact) ? "exact" : "WRONG" );
+	printf( "  churn              %10.1f ns per op, %d live, %.1f%% used, %d free blocks, fragmentation %.3f\n", report.churnTime, 
+		report.churnLive, report.churnUsed, report.churnFreeBlocks, report.churnFragmentation );
+	printf( "  defragment         %10.3f ms, %d moves, %.1f%% of used moved, fragmentation %.3f\n", report.defragTime, report.defragMoves, 
+		report.defragMoved, report.defragFragmentation );
+	printf( "  pressure           %10.1f%% peak used, %d failed allocations, fragmentation %.3f\n", report.pressurePeak, report.pressureFailures, 
+		report.pressureFragmentation );
+	printf( "  geometry heap      %10d steps, %d grows, %d defrags, %d of %d checks failed\n", report.heapSteps, report.heapGrows, 
+		report.heapDefrags, report.heapMismatches, report.heapChecks );
+	printf( "  buffers left %d, recorder errors %d\n", report.heapBuffers, report.recorderErrors );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// geometry batch
+
+struct BatchTestCache
+{
+	unsigned int		id;
+	GeometryHeapRange	range;
+	mat4				transform;
+
+	std::vector<DrawElementsIndirectCommand>	commands;
+	std::vector<DrawElementsIndirectCommand>	commandsTransparency;
+
+	std::vector<TextureGLSL>		textures;
+	std::vector<MaterialGLSL>		materials;
+	std::vector<ShaderGLSL>			shaders;
+	std::vector<MeshGLSL>			meshes;
+	std::vector<ModelGLSL>			models;
+
+	// indirect buffers of the one by one draw and the heap offsets of the uploaded commands
+	GLuint			bufferIndirect;
+	GLuint			bufferIndirectTransparency;
+	GLuint			uploadedBaseVertex;
+	GLuint			uploadedFirstIndex;
+};
+
+// geometry goes to a new heap range, commands stay relative to the range
+static bool UploadBatchCache( CGeometryHeap &heap, BatchTestCache &cache, const unsigned int numberOfVertices, const unsigned int numberOfIndices )
+{
+	if (false == heap.Allocate(numberOfVertices, numberOfIndices, cache.range) )
+		return false;
+
+	std::vector<float> points;
+	std::vector<unsigned int> indices;
+	MakeHeapCache( cache.id, numberOfVertices, numberOfIndices, points, indices );
+
+	heap.Upload( cache.range, GEOMETRY_HEAP_STREAM_POINT, points.data() );
+	heap.Upload( cache.range, GEOMETRY_HEAP_STREAM_INDEX, indices.data() );
+
+	cache.uploadedBaseVertex = 0xFFFFFFFF;
+	cache.uploadedFirstIndex = 0xFFFFFFFF;
+	return true;
+}
+
+// records of the cache keep its id, so a merged command could be followed back to the cache
+static bool MakeBatchCache( unsigned int &state, const unsigned int id, CGeometryHeap &heap, BatchTestCache &cache )
+{
+	cache.id = id;
+	cache.transform.identity();
+	cache.transform.set_translation( vec3( (float) id, 0.0f, 0.0f ) );
+	cache.bufferIndirect = 0;
+	cache.bufferIndirectTransparency = 0;
+
+	const int numberOfMeshes = 20 + RandomInt(state, 300);
+	const int numberOfModels = 1 + RandomInt(state, numberOfMeshes);
+	const int numberOfMaterials = 1 + RandomInt(state, 20);
+	const int numberOfTextures = 1 + RandomInt(state, 10);
+	const int numberOfShaders = 1 + RandomInt(state, 4);
+
+	const unsigned int numberOfVertices = 500 + (unsigned int) RandomInt(state, 5000);
+	const unsigned int numberOfIndices = 3 * numberOfVertices;
+
+	if (false == UploadBatchCache(heap, cache, numberOfVertices, numberOfIndices) )
+		return false;
+
+	cache.textures.resize(numberOfTextures);
+	for (int i=0; i<numberOfTextures; ++i)
+	{
+		TextureGLSL &texture = cache.textures[i];
+		memset( &texture, 0, sizeof(TextureGLSL) );
+		texture.width = (float) id;
+		texture.height = (float) i;
+	}
+
+	cache.materials.resize(numberOfMaterials);
+	for (int i=0; i<numberOfMaterials; ++i)
+	{
+		MaterialGLSL &mat = cache.materials[i];
+		DefaultMaterial(mat);
+
+		mat.ambient = mat.specular = mat.emissive = mat.transparency = mat.normalmap = mat.reflect = -1;
+		mat.diffuse = i % numberOfTextures;
+		mat.specexp = (float) id;
+		mat.roughness = (float) i;
+	}
+
+	// the last shader is a combination of the first one
+	cache.shaders.resize(numberOfShaders + 1);
+	for (int i=0; i<=numberOfShaders; ++i)
+	{
+		ShaderGLSL &shader = cache.shaders[i];
+		DefaultShader(shader);
+		shader.toonSteps = (float) id;
+		shader.toonDistribution = (float) i;
+	}
+	cache.shaders[numberOfShaders].shader1 = 0;
+
+	cache.models.resize(numberOfModels);
+	for (int i=0; i<numberOfModels; ++i)
+	{
+		ModelGLSL &model = cache.models[i];
+		model.transform.identity();
+		model.transform.set_translation( vec3( 0.0f, (float) i, 0.0f ) );
+		model.normalMatrix.identity();
+	}
+
+	cache.meshes.resize(numberOfMeshes);
+	for (int i=0; i<numberOfMeshes; ++i)
+	{
+		MeshGLSL &mesh = cache.meshes[i];
+		mesh.material = i % numberOfMaterials;
+		mesh.lightmap = 1;
+		mesh.model = i % numberOfModels;
+		mesh.shader = i % (numberOfShaders + 1);
+		mesh.color = vec4( (float) id, (float) i, 0.0f, 1.0f );
+
+		DrawElementsIndirectCommand command;
+		command.count = 3 * (1 + (GLuint) RandomInt(state, 100) );
+		command.primCount = 1;
+		command.firstIndex = (GLuint) RandomInt(state, (int) (numberOfIndices - command.count) );
+		command.baseVertex = 0;
+		command.baseInstance = (GLuint) i;
+
+		if (i % 4 == 0)
+			cache.commandsTransparency.push_back(command);
+		else
+			cache.commands.push_back(command);
+	}
+	return true;
+}
+
+// the way each cache draws without the batch, own indirect buffers with the rebased commands
+static void RenderBatchCache( const CGeometryHeap &heap, BatchTestCache &cache )
+{
+	const GLuint baseVertex = heap.GetBaseVertex(cache.range);
+	const GLuint firstIndex = heap.GetFirstIndex(cache.range);
+
+	auto fn_upload = [baseVertex, firstIndex] (GLuint &buffer, const std::vector<DrawElementsIndirectCommand> &commands) {
+
+		std::vector<DrawElementsIndirectCommand> rebased(commands);
+		for (auto iter=begin(rebased); iter!=end(rebased); ++iter)
+		{
+			iter->firstIndex += firstIndex;
+			iter->baseVertex += baseVertex;
+		}
+
+		if (buffer == 0)
+			glGenBuffers(1, &buffer);
+
+		glBindBuffer( GL_DRAW_INDIRECT_BUFFER, buffer );
+		glBufferData( GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * rebased.size(), rebased.data(), GL_STREAM_DRAW );
+	};
+
+	if (baseVertex != cache.uploadedBaseVertex || firstIndex != cache.uploadedFirstIndex)
+	{
+		fn_upload( cache.bufferIndirect, cache.commands );
+		fn_upload( cache.bufferIndirectTransparency, cache.commandsTransparency );
+
+		cache.uploadedBaseVertex = baseVertex;
+		cache.uploadedFirstIndex = firstIndex;
+	}
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, cache.bufferIndirect );
+	glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*) 0, (GLsizei) cache.commands.size(), 0 );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, cache.bufferIndirectTransparency );
+	glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*) 0, (GLsizei) cache.commandsTransparency.size(), 0 );
+}
+
+// merged command of the cache command goes to the same range and the records of the cache
+static bool CheckBatchCommand( const CGeometryHeap &heap, const CGeometryBatch &batch, const BatchTestCache &cache,
+	const DrawElementsIndirectCommand &local, const DrawElementsIndirectCommand &merged )
+{
+	if (merged.count != local.count || merged.primCount != local.primCount
+		|| merged.firstIndex != local.firstIndex + heap.GetFirstIndex(cache.range)
+		|| merged.baseVertex != local.baseVertex + heap.GetBaseVertex(cache.range)
+		|| merged.baseInstance >= (GLuint) batch.GetMeshes().size() )
+	{
+		return false;
+	}
+
+	const MeshGLSL &localMesh = cache.meshes[local.baseInstance];
+	const MeshGLSL &mesh = batch.GetMeshes()[merged.baseInstance];
+
+	if (mesh.color.x != (float) cache.id || mesh.color.y != (float) local.baseInstance || mesh.lightmap != localMesh.lightmap)
+		return false;
+
+	// model translation is the cache one plus the local one
+	if (mesh.model < 0 || mesh.model >= (int) batch.GetModels().size() )
+		return false;
+	const float *transform = batch.GetModels()[mesh.model].transform.mat_array;
+	if (transform[12] != (float) cache.id || transform[13] != (float) localMesh.model)
+		return false;
+
+	if (mesh.material < 0 || mesh.material >= (int) batch.GetMaterials().size() )
+		return false;
+	const MaterialGLSL &mat = batch.GetMaterials()[mesh.material];
+	if (mat.specexp != (float) cache.id || mat.roughness != (float) localMesh.material || mat.ambient != -1)
+		return false;
+
+	if (mesh.shader < 0 || mesh.shader >= (int) batch.GetShaders().size() )
+		return false;
+	const ShaderGLSL &shader = batch.GetShaders()[mesh.shader];
+	if (shader.toonSteps != (float) cache.id || shader.toonDistribution != (float) localMesh.shader)
+		return false;
+	if (shader.shader1 >= 0 && batch.GetShaders()[shader.shader1].toonSteps != (float) cache.id)
+		return false;
+
+	return true;
+}
+
+static int CheckBatchRecords( const CGeometryHeap &heap, const CGeometryBatch &batch, const std::vector<BatchTestCache> &caches, 
+	const std::vector<TextureGLSL> &textures )
+{
+	int numberOfMismatches = 0;
+	size_t opaque = 0;
+	size_t transparency = 0;
+
+	for (auto iter=begin(caches); iter!=end(caches); ++iter)
+	{
+		for (size_t i=0; i<iter->commands.size(); ++i, ++opaque)
+		{
+			if (opaque >= batch.GetCommands().size() 
+				|| false == CheckBatchCommand(heap, batch, *iter, iter->commands[i], batch.GetCommands()[opaque]) )
+			{
+				numberOfMismatches += 1;
+			}
+		}
+		for (size_t i=0; i<iter->commandsTransparency.size(); ++i, ++transparency)
+		{
+			if (transparency >= batch.GetCommandsTransparency().size() 
+				|| false == CheckBatchCommand(heap, batch, *iter, iter->commandsTransparency[i], batch.GetCommandsTransparency()[transparency]) )
+			{
+				numberOfMismatches += 1;
+			}
+		}
+	}
+
+	// textures of the merged materials belong to the same cache
+	for (auto iter=begin(batch.GetMaterials()); iter!=end(batch.GetMaterials()); ++iter)
+	{
+		if (iter->diffuse < 0 || iter->diffuse >= (int) textures.size() || textures[iter->diffuse].width != iter->specexp)
+			numberOfMismatches += 1;
+	}
+
+	if (opaque != batch.GetCommands().size() || transparency != batch.GetCommandsTransparency().size() )
+		numberOfMismatches += 1;
+
+	return numberOfMismatches;
+}
+
+static bool CheckBatchUpload( const CGLRecorder &recorder, const GLuint buffer, const std::vector<DrawElementsIndirectCommand> &commands )
+{
+	size_t size = 0;
+	const unsigned char *data = recorder.GetBufferData(buffer, size);
+
+	return (data != nullptr && size == sizeof(DrawElementsIndirectCommand) * commands.size()
+		&& 0 == memcmp(data, commands.data(), size) );
+}
+
+bool BenchmarkGeometryBatch( const int numberOfFrames, GPUCacheGeometryBatchReport &report )
+{
+	GPUCacheGeometryBatchReport::Clear(report);
+
+	CGLRecorder recorder;
+	if (false == recorder.Install() )
+	{
+		printf( "> ERROR: failed to install the gl recorder\n" );
+		return false;
+	}
+
+	unsigned int state = 11;
+
+	{
+		CGeometryHeap heap;
+		heap.SetCapacity(20000, 60000);
+
+		CGeometryBatch batch(&heap);
+
+		std::vector<BatchTestCache> caches(GEOMETRY_BATCH_BENCHMARK_CACHES);
+		for (int i=0; i<GEOMETRY_BATCH_BENCHMARK_CACHES; ++i)
+		{
+			if (false == MakeBatchCache(state, (unsigned int) i + 1, heap, caches[i]) )
+			{
+				printf( "> ERROR: failed to allocate a heap range for the cache %d\n", i );
+				return false;
+			}
+
+			report.numberOfCommands += (int) caches[i].commands.size();
+			report.numberOfCommandsTransparency += (int) caches[i].commandsTransparency.size();
+		}
+
+		report.numberOfCaches = GEOMETRY_BATCH_BENCHMARK_CACHES;
+		report.numberOfFrames = numberOfFrames;
+
+		// an item with own vertex buffers can't go into the batch
+		GeometryBatchItem item;
+		GeometryBatchItem::Clear(item);
+		report.rejectOwnBuffers = (false == batch.Add(item) && batch.GetNumberOfItems() == 0);
+
+		for (int frame=0; frame<numberOfFrames; ++frame)
+		{
+			// a cache is loaded again into the other place, the heap packs the ranges from time to time
+			if (frame > 0 && frame % 4 == 0)
+			{
+				BatchTestCache &cache = caches[ RandomInt(state, GEOMETRY_BATCH_BENCHMARK_CACHES) ];
+				const unsigned int numberOfVertices = cache.range.numberOfVertices;
+				const unsigned int numberOfIndices = cache.range.numberOfIndices;
+
+				heap.Release(cache.range);
+				if (frame % 8 == 0)
+					heap.Defragment();
+
+				if (false == UploadBatchCache(heap, cache, numberOfVertices, numberOfIndices) )
+				{
+					printf( "> ERROR: failed to allocate a heap range for the cache %u\n", cache.id );
+					return false;
+				}
+				report.rebasedFrames += 1;
+			}
+
+			// one by one
+			recorder.BeginFrame();
+
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+
+			heap.Bind();
+			for (auto iter=begin(caches); iter!=end(caches); ++iter)
+				RenderBatchCache(heap, *iter);
+			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+			heap.UnBind();
+
+			report.cachesTime += ElapsedMs(start);
+			report.cachesDrawCalls = recorder.GetFrameStats().numberOfDrawCalls;
+			report.cachesDrawCommands = recorder.GetFrameStats().numberOfDrawCommands;
+
+			// the batch
+			recorder.BeginFrame();
+
+			start = BenchmarkClock::now();
+
+			batch.Begin();
+			for (auto iter=begin(caches); iter!=end(caches); ++iter)
+			{
+				GeometryBatchItem item;
+				GeometryBatchItem::Clear(item);
+
+				item.range = &iter->range;
+				item.transform = iter->transform.mat_array;
+				item.commands = iter->commands.data();
+				item.numberOfCommands = (int) iter->commands.size();
+				item.commandsTransparency = iter->commandsTransparency.data();
+				item.numberOfCommandsTransparency = (int) iter->commandsTransparency.size();
+				item.textures = iter->textures.data();
+				item.numberOfTextures = (int) iter->textures.size();
+				item.materials = iter->materials.data();
+				item.numberOfMaterials = (int) iter->materials.size();
+				item.shaders = iter->shaders.data();
+				item.numberOfShaders = (int) iter->shaders.size();
+				item.meshes = iter->meshes.data();
+				item.numberOfMeshes = (int) iter->meshes.size();
+				item.models = iter->models.data();
+				item.numberOfModels = (int) iter->models.size();
+
+				batch.Add(item);
+			}
+
+			batch.Prepare();
+			batch.RenderBegin();
+			batch.RenderOpaque();
+
+			const GLRecordStats opaqueStats = recorder.GetFrameStats();
+
+			batch.RenderTransparency();
+			batch.RenderEnd();
+
+			report.batchTime += ElapsedMs(start);
+			report.batchDrawCalls = recorder.GetFrameStats().numberOfDrawCalls;
+			report.batchDrawCommands = recorder.GetFrameStats().numberOfDrawCommands;
+
+			// one multi draw has all opaque commands
+			if (opaqueStats.numberOfDrawCalls != 1 || opaqueStats.numberOfDrawCommands != report.numberOfCommands)
+				report.recordMismatches += 1;
+
+			if (frame % 4 == 0 || frame == numberOfFrames-1)
+			{
+				std::vector<TextureGLSL> textures;
+				for (auto iter=begin(caches); iter!=end(caches); ++iter)
+					textures.insert( end(textures), begin(iter->textures), end(iter->textures) );
+
+				report.recordMismatches += CheckBatchRecords(heap, batch, caches, textures);
+
+				if (false == CheckBatchUpload(recorder, batch.GetBufferIndirect(), batch.GetCommands() )
+					|| false == CheckBatchUpload(recorder, batch.GetBufferIndirectTransparency(), batch.GetCommandsTransparency() ) )
+				{
+					report.uploadMismatches += 1;
+				}
+			}
+		}
+
+		report.cachesTime /= (double) std::max(1, numberOfFrames);
+		report.batchTime /= (double) std::max(1, numberOfFrames);
+
+		for (auto iter=begin(caches); iter!=end(caches); ++iter)
+		{
+			glDeleteBuffers(1, &iter->bufferIndirect);
+			glDeleteBuffers(1, &iter->bufferIndirectTransparency);
+		}
+
+		batch.Free();
+		heap.Free();
+	}
+
+	report.recorderErrors = (int) recorder.GetErrors().size();
+	recorder.Uninstall();
+
+	return true;
+}
+
+void PrintGeometryBatchReport( const GPUCacheGeometryBatchReport &report )
+{
+	printf( "geometry batch benchmark - %d caches, %d frames, %d opaque and %d transparency commands\n", report.numberOfCaches, 
+		report.numberOfFrames, report.numberOfCommands, report.numberOfCommandsTransparency );
+	printf( "  one by one         %10.3f ms per frame, %d draw calls, %d commands\n", report.cachesTime, report.cachesDrawCalls, 
+		report.cachesDrawCommands );
+	printf( "  batch              %10.3f ms per frame, %d draw calls, %d commands\n", report.batchTime, report.batchDrawCalls, 
+		report.batchDrawCommands );
+	printf( "  %d rebased frames, %d record mismatches, %d upload mismatches, own buffers %s, recorder errors %d\n", 
+		report.rebasedFrames, report.recordMismatches, report.uploadMismatches, (report.rejectOwnBuffers) ? "rejected" : "ADDED", 
+		report.recorderErrors );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tests
+
+bool TestFrustumCulling()
+{
+	GPUCacheFrustumCullingReport report;
+	if (false == BenchmarkFrustumCulling( 100000, 20, report ) )
+		return false;
+
+	PrintFrustumCullingReport(report);
+
+	for (int simd=0; simd<3; ++simd)
+	{
+		for (int t=0; t<FRUSTUM_CULLING_BENCHMARK_THREADS; ++t)
+		{
+			if (false == report.equal[simd][t])
+				return false;
+		}
+	}
+
+	// tail of the padded simd block and an empty set
+	std::vector<vec4> spheres(13);
+	unsigned int state = 7;
+	for (auto iter=begin(spheres); iter!=end(spheres); ++iter)
+		*iter = vec4( -50.0f + 100.0f * RandomFloat(state), -50.0f + 100.0f * RandomFloat(state), 0.0f, 1.0f + RandomFloat(state) );
+
+	CFrustum frustum;
+	MakeAxisView( 100.0f, 800.0f, frustum );
+	const vec3 eyePos(0.0f, 0.0f, 100.0f);
+
+	int reference = 0;
+	for (auto iter=begin(spheres); iter!=end(spheres); ++iter)
+	{
+		if (frustum.SphereInFrustum( iter->x, iter->y, iter->z, iter->w ) )
+			reference += 1;
+	}
+
+	CFrustumCulling culling;
+	culling.SetSpheres( spheres.data(), (int) spheres.size() );
+
+	float farDistance = 0.0f;
+	if (culling.Cull( frustum, eyePos, nullptr, farDistance ) != reference)
+		return false;
+
+	culling.ClearSpheres();
+	return (culling.Cull( frustum, eyePos, nullptr, farDistance ) == 0 && farDistance == 0.0f);
+}
+
+bool TestHierarchy()
+{
+	const int sizes[3] = { 10000, 100000, 1000000 };
+
+	for (int i=0; i<3; ++i)
+	{
+		GPUCacheHierarchyReport report;
+		if (false == BenchmarkHierarchy( sizes[i], 200, report ) )
+			return false;
+
+		PrintHierarchyReport(report);
+
+		if (false == report.frustumEqual || false == report.sphereEqual || false == report.boxEqual || false == report.rayEqual 
+			|| false == report.rayAllEqual || false == report.refitEqual)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TestNormalMatrices()
+{
+	GPUCacheNormalMatricesReport report;
+	if (false == BenchmarkNormalMatrices( 50000, 50, report ) )
+		return false;
+
+	PrintNormalMatricesReport(report);
+
+	for (int simd=0; simd<3; ++simd)
+	{
+		for (int layout=0; layout<NORMAL_MATRICES_BENCHMARK_LAYOUTS; ++layout)
+		{
+			if (report.updated[simd][layout] != report.numberOfModels || report.maxError[simd][layout] > 1e-4f)
+				return false;
+		}
+
+		// fewer dirty models take less time
+		if (report.updateTime[simd][0] >= report.updateTime[simd][NORMAL_MATRICES_BENCHMARK_RATIOS-1])
+			return false;
+	}
+
+	return (report.partialUpdated == report.partialDirty && report.partialError < 1e-4f 
+		&& report.threadsUpdated == report.numberOfModels && report.threadsError < 1e-4f);
+}
+
+bool TestDirtyRanges()
+{
+	GPUCacheDirtyRangesReport report;
+	if (false == BenchmarkDirtyRanges( 20000, 10000, report ) )
+		return false;
+
+	PrintDirtyRangesReport(report);
+
+	const size_t itemSize = (size_t) report.itemSize;
+
+	// a few edits go as ranges, many edits turn into the whole array
+	return (report.coalesceFailures == 0 && report.recorderErrors == 0 && report.uploadedEqual
+		&& report.singleBytes == itemSize && report.sequentialBytes == 100 * itemSize
+		&& report.editBytes[0] == itemSize && report.editBytes[1] <= 10 * (DIRTY_RANGES_MERGE_GAP + 1) * itemSize 
+		&& report.editBytes[DIRTY_RANGES_BENCHMARK_EDITS-1] <= report.fullBytes 
+		&& report.appendBytes == report.fullBytes + itemSize);
+}
+
+bool TestRingBuffer()
+{
+	GPUCacheRingBufferReport report;
+	if (false == BenchmarkRingBuffer( 64 * 1024, 1000, report ) )
+		return false;
+
+	PrintRingBufferReport(report);
+
+	// three updates of 4000 bytes fit the ring with the frames in flight, only the burst goes to the own buffer
+	return (report.modelViolations == 0 && report.modelAllocations > 0 && report.dataMismatches == 0
+		&& report.ringFrames == report.numberOfFrames && false == report.burstInRing && report.numberOfOverflows > 0
+		&& report.staleDropped && report.ringBytes == 0 && report.ownBytes == report.frameSize
+		&& report.syncObjects == 0 && report.recorderErrors == 0);
+}
+
+bool TestTLSF()
+{
+	GPUCacheTLSFReport report;
+	if (false == BenchmarkTLSF( 1000000, report ) )
+		return false;
+
+	PrintTLSFReport(report);
+
+	// one free block after the defragmentation
+	return (report.modelViolations == 0 && report.modelAllocations > 0 && report.fillExact
+		&& report.defragFragmentation == 0.0f && report.heapChecks > 0 && report.heapMismatches == 0 
+		&& report.heapBuffers == 0 && report.recorderErrors == 0);
+}
+
+bool TestGeometryBatch()
+{
+	GPUCacheGeometryBatchReport report;
+	if (false == BenchmarkGeometryBatch( 64, report ) )
+		return false;
+
+	PrintGeometryBatchReport(report);
+
+	// two multi draws per cache without the batch, one for the opaque and one for the transparency with it
+	return (report.cachesDrawCalls == 2 * report.numberOfCaches && report.batchDrawCalls == 2
+		&& report.batchDrawCommands == report.numberOfCommands + report.numberOfCommandsTransparency
+		&& report.cachesDrawCommands == report.batchDrawCommands && report.rebasedFrames > 0
+		&& report.recordMismatches == 0 && report.uploadMismatches == 0 && report.rejectOwnBuffers && report.recorderErrors == 0);
+}
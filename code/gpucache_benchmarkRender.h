@@ -0,0 +1,343 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_benchmarkRender.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_benchmark.h"
+#include "algorithm/FrustumCulling.h"
+#include "algorithm/BoundingVolumeHierarchy.h"
+#include "algorithm/NormalMatrices.h"
+#include "algorithm/DirtyRanges.h"
+#include "algorithm/RingAllocator.h"
+#include "algorithm/TLSFAllocator.h"
+
+//
+// render side benchmarks and tests (culling, hierarchies, buffer updates and allocators)
+//	only the cpu part of the modules is used, gl calls are not made
+//
+
+//////////////////////////////////////////////////////////////////////////
+// frustum culling of the bounding spheres against the serial CFrustum::SphereInFrustum loop
+
+#define FRUSTUM_CULLING_BENCHMARK_THREADS		3		// 1, 2 and 4 threads
+
+struct GPUCacheFrustumCullingReport
+{
+	int			numberOfSpheres;
+	int			numberOfIterations;
+	int			numberOfVisible;
+	float		farDistance;
+
+	double		referenceTime;			// ms, serial loop
+
+	int			threads[FRUSTUM_CULLING_BENCHMARK_THREADS];
+	int			simdUsed[3];			// simd which was supported for each requested one
+	double		cullTime[3][FRUSTUM_CULLING_BENCHMARK_THREADS];		// ms, simd x threads
+	bool		equal[3][FRUSTUM_CULLING_BENCHMARK_THREADS];		// same visible set and far distance
+
+	static void Clear(GPUCacheFrustumCullingReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheFrustumCullingReport) );
+	}
+};
+
+bool BenchmarkFrustumCulling( const int numberOfSpheres, const int numberOfIterations, GPUCacheFrustumCullingReport &report );
+
+void PrintFrustumCullingReport( const GPUCacheFrustumCullingReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// bounding volume hierarchy of the random spheres, queries against the linear scans of all items
+//	refit after 1% of the items are moved, then after all of them are moved
+
+struct GPUCacheHierarchyReport
+{
+	int			numberOfItems;
+	int			numberOfNodes;
+	int			numberOfRays;
+
+	double		buildTime;			// ms
+	float		buildCost;			// surface area cost
+	float		refitCost;			// after both refits
+
+	double		refitTime;			// ms, 1% of the items
+	int			refitNodes;
+	double		refitAllTime;		// ms, all items
+
+	int			frustumVisible;
+	double		frustumLinear;		// ms per query
+	double		frustumTree;
+	double		sphereLinear;
+	double		sphereTree;
+	double		rayLinear;			// nearest hit
+	double		rayTree;
+
+	bool		frustumEqual;
+	bool		sphereEqual;
+	bool		boxEqual;
+	bool		rayEqual;			// nearest item of every ray
+	bool		rayAllEqual;		// all items along a ray
+	bool		refitEqual;			// frustum query after the refit
+
+	static void Clear(GPUCacheHierarchyReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheHierarchyReport) );
+	}
+};
+
+bool BenchmarkHierarchy( const int numberOfItems, const int numberOfRays, GPUCacheHierarchyReport &report );
+
+void PrintHierarchyReport( const GPUCacheHierarchyReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// batched normal matrices of the dirty models against the scalar loop over all models (invert and transpose),
+//	random affine transforms with a non uniform scale, records are the 4x4 or the compact 3x4 ones
+
+#define NORMAL_MATRICES_BENCHMARK_RATIOS		3		// 1%, 10% and 100% of the models are dirty
+#define NORMAL_MATRICES_BENCHMARK_LAYOUTS		2
+
+struct GPUCacheNormalMatricesReport
+{
+	int			numberOfModels;
+	int			numberOfIterations;
+
+	double		referenceTime;			// ms, scalar loop over all models
+
+	int			simdUsed[3];
+	float		dirtyRatio[NORMAL_MATRICES_BENCHMARK_RATIOS];
+	double		updateTime[3][NORMAL_MATRICES_BENCHMARK_RATIOS];	// ms, one thread, simd x dirty ratio
+	double		idleTime;				// ms, no dirty models and the same view
+
+	float		maxError[3][NORMAL_MATRICES_BENCHMARK_LAYOUTS];		// relative error to the reference, simd x layout
+	int			updated[3][NORMAL_MATRICES_BENCHMARK_LAYOUTS];		// models of the first update
+
+	int			partialDirty;			// models moved with the view translation only changed
+	int			partialUpdated;
+	float		partialError;
+
+	int			threadsUpdated;			// models of the first update with the hardware threads
+	float		threadsError;
+
+	static void Clear(GPUCacheNormalMatricesReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheNormalMatricesReport) );
+	}
+};
+
+bool BenchmarkNormalMatrices( const int numberOfModels, const int numberOfIterations, GPUCacheNormalMatricesReport &report );
+
+void PrintNormalMatricesReport( const GPUCacheNormalMatricesReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// dirty ranges of the resource buffers, random coalescing cases and the bytes uploaded per edit
+//	uploads of CResourceGPUModel (256 bytes records, like the materials) go into the gl recorder
+
+#define DIRTY_RANGES_BENCHMARK_EDITS		4		// 1, 10, 100 and 1000 random edits per frame
+
+struct GPUCacheDirtyRangesReport
+{
+	int			numberOfTrials;
+	int			coalesceFailures;		// uncovered element, overlap, out of the array or too many ranges
+	double		coalesceTime;			// microseconds per Coalesce call
+
+	int			numberOfItems;
+	int			itemSize;
+
+	size_t		fullBytes;				// whole array update, the previous behaviour for any edit
+	int			fullCalls;
+
+	int			edits[DIRTY_RANGES_BENCHMARK_EDITS];
+	size_t		editBytes[DIRTY_RANGES_BENCHMARK_EDITS];
+	int			editCalls[DIRTY_RANGES_BENCHMARK_EDITS];
+	double		editTime[DIRTY_RANGES_BENCHMARK_EDITS];		// ms, edits and PrepRender
+
+	size_t		singleBytes;			// one edit
+	int			singleCalls;
+	size_t		sequentialBytes;		// 100 neighbour edits
+	int			sequentialCalls;
+	size_t		appendBytes;			// a new item changes the buffer size
+	int			appendCalls;
+
+	bool		uploadedEqual;			// recorded buffer storage is the client array after all frames
+	int			recorderErrors;
+
+	static void Clear(GPUCacheDirtyRangesReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheDirtyRangesReport) );
+	}
+};
+
+bool BenchmarkDirtyRanges( const int numberOfTrials, const int numberOfItems, GPUCacheDirtyRangesReport &report );
+
+void PrintDirtyRangesReport( const GPUCacheDirtyRangesReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// ring of the per frame buffers
+//	the allocator is checked with a byte ownership model (random allocations, frames and retires),
+//	then CGPURingBuffer goes into the gl recorder, fences are signaled by hand one frame behind the cpu
+
+#define RING_BUFFER_BENCHMARK_ROUNDS		200
+#define RING_BUFFER_BENCHMARK_FRAMES		20
+#define RING_BUFFER_BENCHMARK_BURST			10		// frame with an update bigger than the ring
+
+struct GPUCacheRingBufferReport
+{
+	int			numberOfRounds;
+	int			modelAllocations;
+	int			modelFailures;			// no space until some frames are retired
+	int			modelViolations;		// overlap, out of the capacity, alignment, used bytes or frames count
+
+	int			numberOfFrames;
+	size_t		ringSize;
+	size_t		frameSize;				// bytes of one buffer update
+	size_t		frameBytes;				// ring bytes of the last frame with the alignment
+	int			ringFrames;				// frames when all buffers were in the ring
+	int			dataMismatches;			// frame data is not at the gpu address of the range
+	bool		burstInRing;			// burst update has to go into the own buffer
+	bool		staleDropped;			// range of an earlier frame is not bound
+
+	int			numberOfWaits;
+	int			numberOfOverflows;
+	int			numberOfStalls;
+
+	int			ringCalls;				// gl calls and uploaded bytes of one update
+	size_t		ringBytes;
+	int			ownCalls;				// CGPUBufferNV without the ring, orphaning
+	size_t		ownBytes;
+	int			doubleCalls;			// CGPUBufferDoubleNV without the ring
+	size_t		doubleBytes;
+
+	int			syncObjects;			// left after the ring Free
+	int			recorderErrors;
+
+	static void Clear(GPUCacheRingBufferReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheRingBufferReport) );
+	}
+};
+
+bool BenchmarkRingBuffer( const size_t ringSize, const int numberOfElements, GPUCacheRingBufferReport &report );
+
+void PrintRingBufferReport( const GPUCacheRingBufferReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// TLSF sub-allocator of the geometry heap
+//	random allocations, frees, grows and defragmentations against the handle sizes and the overlaps,
+//	churn of the cache sized ranges (1k - 64k vertices) for the speed and the fragmentation,
+//	then caches are loaded and unloaded into CGeometryHeap inside the gl recorder and their data is checked
+
+#define TLSF_BENCHMARK_ROUNDS			300
+#define TLSF_BENCHMARK_HEAP_STEPS		3000
+
+struct GPUCacheTLSFReport
+{
+	int			numberOfRounds;
+	int			modelAllocations;
+	int			modelDefrags;
+	int			modelViolations;		// size, capacity, overlap, move order or Validate
+	bool		fillExact;				// single elements fill the whole capacity, split holes do not fit 2
+
+	int			churnOperations;
+	double		churnTime;				// nanoseconds per Allocate or Free
+	int			churnLive;
+	float		churnUsed;				// percents of the capacity
+	int			churnFreeBlocks;
+	float		churnFragmentation;
+
+	int			defragMoves;
+	float		defragMoved;			// percents of the used elements
+	double		defragTime;				// ms
+	float		defragFragmentation;
+
+	float		pressurePeak;			// percents of the capacity used before the allocations fail
+	int			pressureFailures;
+	float		pressureFragmentation;
+
+	int			heapSteps;
+	int			heapGrows;
+	int			heapDefrags;
+	int			heapChecks;				// live range data checks
+	int			heapMismatches;
+	int			heapBuffers;			// left after the heap Free
+	int			recorderErrors;
+
+	static void Clear(GPUCacheTLSFReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheTLSFReport) );
+	}
+};
+
+bool BenchmarkTLSF( const int numberOfOperations, GPUCacheTLSFReport &report );
+
+void PrintTLSFReport( const GPUCacheTLSFReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// merged draw of the caches in the geometry heap (CGeometryBatch)
+//	synthetic caches with own records are put into one heap, then they are drawn one by one (a multi draw per cache)
+//	and by the batch inside the gl recorder, draw calls and commands are counted, merged commands are followed
+//	to the mesh, model, material and texture records of their cache, ranges are moved between the frames
+
+#define GEOMETRY_BATCH_BENCHMARK_CACHES		16
+
+struct GPUCacheGeometryBatchReport
+{
+	int			numberOfCaches;
+	int			numberOfFrames;
+	int			numberOfCommands;				// opaque commands of all caches
+	int			numberOfCommandsTransparency;
+
+	int			cachesDrawCalls;				// per frame, one by one
+	int			cachesDrawCommands;
+	int			batchDrawCalls;					// per frame, the batch
+	int			batchDrawCommands;
+
+	double		cachesTime;						// ms per frame of the cpu submit
+	double		batchTime;						// ms per frame, merge, upload and draw
+
+	int			rebasedFrames;					// frames after the heap moved the ranges
+	int			recordMismatches;				// merged command goes to a wrong record or range
+	int			uploadMismatches;				// indirect buffer is not the merged commands
+	bool		rejectOwnBuffers;				// item without a heap range is not added
+	int			recorderErrors;
+
+	static void Clear(GPUCacheGeometryBatchReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheGeometryBatchReport) );
+	}
+};
+
+bool BenchmarkGeometryBatch( const int numberOfFrames, GPUCacheGeometryBatchReport &report );
+
+void PrintGeometryBatchReport( const GPUCacheGeometryBatchReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// tests
+
+// every simd path and number of threads gives the serial result
+bool TestFrustumCulling();
+
+// hierarchy queries give the linear scan results before and after the refit
+bool TestHierarchy();
+
+// every simd path and layout gives the reference normal matrices, only dirty models are computed
+bool TestNormalMatrices();
+
+// coalesced ranges cover every edit, uploads are a small part of the whole array
+bool TestDirtyRanges();
+
+// ring ranges never overlap the frames in flight, updates go to the ring until it's full
+bool TestRingBuffer();
+
+// allocator model has no violations, heap ranges keep their data over the grows and defragmentations
+bool TestTLSF();
+
+// caches of the heap are drawn by one multi draw with all commands, every command reaches the records of its cache
+bool TestGeometryBatch();
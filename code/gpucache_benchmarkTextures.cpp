@@ -0,0 +1,1286 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_benchmarkTextures.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_benchmarkTextures.h"
+#include "algorithm/TextureCompression.h"
+#include "algorithm/MipmapGeneration.h"
+#include "IO/FileIO.h"
+#include "gpucache_loaderPipelined.h"
+#include "shared_texturesRegistry.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+typedef std::chrono::high_resolution_clock	BenchmarkClock;
+
+static double ElapsedMs( const BenchmarkClock::time_point &start )
+{
+	return std::chrono::duration<double, std::milli>( BenchmarkClock::now() - start ).count();
+}
+
+// FNV-1a of the file content, 0 if the file can't be read
+static unsigned long long HashFile( const char *filename )
+{
+	FILE *fp = nullptr;
+	if (0 != fopen_s( &fp, filename, "rb" ) || fp == nullptr)
+		return 0;
+
+	std::vector<unsigned char>	buffer(1 << 20);
+	unsigned long long hash = 14695981039346656037ULL;
+
+	size_t count = 0;
+	while ( (count = fread( buffer.data(), 1, buffer.size(), fp )) > 0)
+	{
+		for (size_t i=0; i<count; ++i)
+		{
+			hash ^= buffer[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	fclose(fp);
+	return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// textures export
+
+bool BenchmarkTextureExport( const GPUCacheSyntheticOptions &options, GPUCacheTextureExportReport &report )
+{
+	GPUCacheTextureExportReport::Clear(report);
+
+	report.numberOfImages = options.numberOfTextures;
+	report.imageSize = options.textureSize;
+	report.identical = true;
+
+	const int workers[3] = { 1, 2, 4 };
+	const size_t budgets[2] = { 16 * 1024 * 1024, TEXTURE_EXPORT_DEFAULT_BUDGET };
+
+	const std::string packFilename = MakeBenchmarkPackFilename( BENCHMARK_TEST_FILENAME, "_Textures.pck" );
+	unsigned long long firstHash = 0;
+
+	for (int i=0; i<TEXTURE_EXPORT_BENCHMARK_CONFIGS; ++i)
+	{
+		CGPUCacheSaver	saver;
+		saver.SetTextureExportWorkers( workers[i % 3] );
+		saver.SetTextureExportMemoryBudget( budgets[i / 3] );
+		saver.SetTextureMipmaps( true );
+
+		if (false == GenerateSyntheticCache( BENCHMARK_TEST_FILENAME, options, saver ) )
+			return false;
+
+		const GPUCacheTextureExportStats &stats = saver.GetTextureExportStats();
+		
+		report.numberOfWorkers[i] = stats.numberOfWorkers;
+		report.memoryBudget[i] = budgets[i / 3];
+		report.exportTime[i] = stats.total;
+		report.throughput[i] = (stats.total > 0.0) ? ((double) stats.bytesWritten / (1024.0 * 1024.0)) / (0.001 * stats.total) : 0.0;
+		report.peakMemory[i] = stats.peakMemory;
+		report.packSize[i] = GetBenchmarkFileSize( packFilename.c_str() );
+
+		const unsigned long long hash = HashFile( packFilename.c_str() );
+		if (i == 0)
+			firstHash = hash;
+		else if (hash != firstHash)
+			report.identical = false;
+	}
+
+	return true;
+}
+
+void PrintTextureExportReport( const GPUCacheTextureExportReport &report )
+{
+	printf( "textures export benchmark - %d images %dx%d with mipmaps\n", report.numberOfImages, report.imageSize, report.imageSize );
+	
+	for (int i=0; i<TEXTURE_EXPORT_BENCHMARK_CONFIGS; ++i)
+	{
+		printf( "  %d workers, %4d MB  %10.2f ms, %.2f MB/s, peak scratch %.2f MB, pack %.2f MB\n", report.numberOfWorkers[i], 
+			(int) (report.memoryBudget[i] / (1024 * 1024)), report.exportTime[i], report.throughput[i], 
+			(double) report.peakMemory[i] / (1024.0 * 1024.0), (double) report.packSize[i] / (1024.0 * 1024.0) );
+	}
+	printf( "  packs              %10s\n", (report.identical) ? "identical" : "DIFFERENT" );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// synthetic images
+
+static unsigned char ToByte( const float value )
+{
+	return (unsigned char) std::max( 0.0f, std::min( 255.0f, value + 0.5f ) );
+}
+
+// smooth gradients with a small noise and a hard edged pattern, components 3 or 4 (alpha is a radial gradient)
+static void MakeColorImage( const int side, const int components, unsigned int seed, std::vector<unsigned char> &image )
+{
+	image.resize( (size_t) side * side * components );
+
+	for (int y=0; y<side; ++y)
+	{
+		for (int x=0; x<side; ++x)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			const float noise = (float) ((seed >> 24) % 9) - 4.0f;
+
+			unsigned char *pixel = &image[ ((size_t) y * side + x) * components ];
+			pixel[0] = ToByte( 128.0f + 100.0f * sinf( 0.01f * x + 0.003f * y ) );
+			pixel[1] = ToByte( 128.0f + 90.0f * sinf( 0.02f * y ) + noise );
+			pixel[2] = ( ((x / 32) + (y / 32)) & 1 ) ? 200 : 40;
+
+			if (components == 4)
+			{
+				const float dx = (float) x / (float) side - 0.5f;
+				const float dy = (float) y / (float) side - 0.5f;
+				pixel[3] = ToByte( 255.0f * (1.0f - 2.0f * sqrtf(dx*dx + dy*dy)) );
+			}
+		}
+	}
+}
+
+// single channel soft mask
+static void MakeMaskImage( const int side, std::vector<unsigned char> &image )
+{
+	image.resize( (size_t) side * side );
+
+	for (int y=0; y<side; ++y)
+		for (int x=0; x<side; ++x)
+			image[(size_t) y * side + x] = ToByte( 127.5f + 127.5f * sinf( 0.05f * x ) * cosf( 0.031f * y ) );
+}
+
+// tangent space normals of a height field, rgb
+static void MakeNormalImage( const int side, std::vector<unsigned char> &image )
+{
+	image.resize( (size_t) side * side * 3 );
+
+	auto fn_height = [] (const float x, const float y) -> float {
+		return 20.0f * sinf( 0.05f * x ) * cosf( 0.031f * y ) + 3.0f * sinf( 0.13f * (x + y) ) + sinf( 0.7f * x + 0.3f * y );
+	};
+
+	for (int y=0; y<side; ++y)
+	{
+		for (int x=0; x<side; ++x)
+		{
+			const float nx = fn_height( (float) x - 1.0f, (float) y ) - fn_height( (float) x + 1.0f, (float) y );
+			const float ny = fn_height( (float) x, (float) y - 1.0f ) - fn_height( (float) x, (float) y + 1.0f );
+			const float nz = 2.0f;
+			const float len = sqrtf( nx*nx + ny*ny + nz*nz );
+
+			unsigned char *pixel = &image[ ((size_t) y * side + x) * 3 ];
+			pixel[0] = ToByte( 127.5f + 127.5f * nx / len );
+			pixel[1] = ToByte( 127.5f + 127.5f * ny / len );
+			pixel[2] = ToByte( 127.5f + 127.5f * nz / len );
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// block compression
+
+bool BenchmarkTextureCompression( const int imageSize, const int numberOfIterations, GPUCacheTextureCompressionReport &report )
+{
+	GPUCacheTextureCompressionReport::Clear(report);
+
+	if (imageSize <= 0)
+		return false;
+
+	report.imageSize = imageSize;
+	report.numberOfIterations = std::max(1, numberOfIterations);
+
+	std::vector<unsigned char>	images[TEXTURE_COMPRESSION_BENCHMARK_IMAGES];
+	int							components[TEXTURE_COMPRESSION_BENCHMARK_IMAGES] = { 3, 4, 1, 3 };
+
+	MakeColorImage( imageSize, 3, 1, images[0] );
+	MakeColorImage( imageSize, 4, 2, images[1] );
+	MakeMaskImage( imageSize, images[2] );
+	MakeNormalImage( imageSize, images[3] );
+
+	const char *names[TEXTURE_COMPRESSION_BENCHMARK_IMAGES] = { "color", "color alpha", "mask", "normal map" };
+	const ETextureCompressionFormat formats[TEXTURE_COMPRESSION_BENCHMARK_IMAGES] = { 
+		eTextureCompressionBC1, eTextureCompressionBC3, eTextureCompressionBC4, eTextureCompressionBC5 };
+
+	const double pixels = (double) imageSize * (double) imageSize * (double) report.numberOfIterations;
+	std::vector<unsigned char>	rgba( (size_t) imageSize * imageSize * 4 );
+
+	for (int i=0; i<TEXTURE_COMPRESSION_BENCHMARK_IMAGES; ++i)
+	{
+		report.imageName[i] = names[i];
+		report.format[i] = (int) formats[i];
+
+		std::vector<unsigned char>	compressed( GetCompressedImageSize( formats[i], imageSize, imageSize ) );
+
+		for (int quality=0; quality<TEXTURE_COMPRESSION_BENCHMARK_QUALITIES; ++quality)
+		{
+			const BenchmarkClock::time_point start = BenchmarkClock::now();
+			for (int j=0; j<report.numberOfIterations; ++j)
+			{
+				if (0 == CompressImage( images[i].data(), imageSize, imageSize, components[i], false, formats[i], 
+					(ETextureCompressionQuality) quality, compressed.data(), 1 ) )
+				{
+					return false;
+				}
+			}
+			const double time = ElapsedMs(start);
+
+			report.rate[i][quality] = (time > 0.0) ? 0.001 * pixels / time : 0.0;
+			report.psnr[i][quality] = ComputeCompressionPSNR( images[i].data(), imageSize, imageSize, components[i], false, 
+				formats[i], compressed.data() );
+		}
+
+		const BenchmarkClock::time_point start = BenchmarkClock::now();
+		for (int j=0; j<report.numberOfIterations; ++j)
+			DecompressImage( compressed.data(), imageSize, imageSize, formats[i], rgba.data() );
+		const double time = ElapsedMs(start);
+
+		report.decodeRate[i] = (time > 0.0) ? 0.001 * pixels / time : 0.0;
+	}
+
+	return true;
+}
+
+void PrintTextureCompressionReport( const GPUCacheTextureCompressionReport &report )
+{
+	const char *formatNames[4] = { "BC1", "BC3", "BC4", "BC5" };
+	const char *qualityNames[TEXTURE_COMPRESSION_BENCHMARK_QUALITIES] = { "fast", "normal", "high" };
+
+	printf( "texture compression benchmark - %dx%d, average of %d runs, one thread\n", report.imageSize, report.imageSize, 
+		report.numberOfIterations );
+
+	for (int i=0; i<TEXTURE_COMPRESSION_BENCHMARK_IMAGES; ++i)
+	{
+		for (int quality=0; quality<TEXTURE_COMPRESSION_BENCHMARK_QUALITIES; ++quality)
+		{
+			printf( "  %-12s %s %-6s %8.2f dB, %.1f M pixels/s\n", report.imageName[i], formatNames[report.format[i]], 
+				qualityNames[quality], report.psnr[i][quality], report.rate[i][quality] );
+		}
+		printf( "  %-12s %s decode %8.1f M pixels/s\n", report.imageName[i], formatNames[report.format[i]], report.decodeRate[i] );
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// mipmap filters
+
+static double SRGBToLinear( const double value )
+{
+	const double v = value / 255.0;
+	return (v <= 0.04045) ? v / 12.92 : pow( (v + 0.055) / 1.055, 2.4 );
+}
+
+static double LinearToSRGB( const double value )
+{
+	return 255.0 * ( (value <= 0.0031308) ? value * 12.92 : 1.055 * pow( value, 1.0 / 2.4 ) - 0.055 );
+}
+
+static void MakeRandomImage( const int width, const int height, const int components, unsigned int seed, std::vector<unsigned char> &image )
+{
+	image.resize( (size_t) width * height * components );
+
+	for (auto iter=begin(image); iter!=end(image); ++iter)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		*iter = (unsigned char) (seed >> 24);
+	}
+}
+
+// max |length - 1| of the decoded normals
+static double NormalLengthError( const std::vector<unsigned char> &image )
+{
+	double error = 0.0;
+
+	for (size_t i=0; i+2<image.size(); i+=3)
+	{
+		const double x = image[i] / 127.5 - 1.0;
+		const double y = image[i+1] / 127.5 - 1.0;
+		const double z = image[i+2] / 127.5 - 1.0;
+		error = std::max( error, fabs( sqrt(x*x + y*y + z*z) - 1.0 ) );
+	}
+	return error;
+}
+
+bool BenchmarkMipmapFilters( const int imageSize, const int numberOfIterations, GPUCacheMipmapReport &report )
+{
+	GPUCacheMipmapReport::Clear(report);
+
+	if (imageSize < 8)
+		return false;
+
+	const int side = imageSize;
+	const int half = side / 2;
+	report.imageSize = side;
+
+	std::vector<unsigned char>	src;
+	std::vector<unsigned char>	dst;
+
+	// every pixel of a random image against the reference, alpha (last of 2 and 4) and masks are linear
+	for (int components=1; components<=4; ++components)
+	{
+		MakeRandomImage( side, side, components, components, src );
+		dst.resize( (size_t) half * half * components );
+		
+		const int colorComponents = (components >= 3) ? 3 : 1;
+		const bool hasAlpha = (components == 2 || components == 4);
+
+		DownsampleImage( src.data(), side, side, components, eMipmapFilterSRGB, dst.data() );
+		
+		for (int y=0; y<half; ++y)
+		{
+			for (int x=0; x<half; ++x)
+			{
+				for (int c=0; c<components; ++c)
+				{
+					const unsigned char p00 = src[ ((size_t) (2*y) * side + 2*x) * components + c ];
+					const unsigned char p10 = src[ ((size_t) (2*y) * side + 2*x+1) * components + c ];
+					const unsigned char p01 = src[ ((size_t) (2*y+1) * side + 2*x) * components + c ];
+					const unsigned char p11 = src[ ((size_t) (2*y+1) * side + 2*x+1) * components + c ];
+					
+					const bool isColor = (c < colorComponents) && !(hasAlpha && c == components - 1);
+					const double reference = (isColor) 
+						? LinearToSRGB( 0.25 * (SRGBToLinear(p00) + SRGBToLinear(p10) + SRGBToLinear(p01) + SRGBToLinear(p11)) )
+						: 0.25 * (p00 + p10 + p01 + p11);
+
+					const int error = abs( (int) floor(reference + 0.5) - (int) dst[((size_t) y * half + x) * components + c] );
+					report.srgbError[components-1] = std::max( report.srgbError[components-1], error );
+				}
+			}
+		}
+
+		DownsampleImage( src.data(), side, side, components, eMipmapFilterLinear, dst.data() );
+
+		for (int y=0; y<half; ++y)
+		{
+			for (int x=0; x<half; ++x)
+			{
+				for (int c=0; c<components; ++c)
+				{
+					const int sum = src[ ((size_t) (2*y) * side + 2*x) * components + c ] + src[ ((size_t) (2*y) * side + 2*x+1) * components + c ]
+						+ src[ ((size_t) (2*y+1) * side + 2*x) * components + c ] + src[ ((size_t) (2*y+1) * side + 2*x+1) * components + c ];
+					
+					const int error = abs( ((sum + 2) >> 2) - (int) dst[((size_t) y * half + x) * components + c] );
+					report.linearError[components-1] = std::max( report.linearError[components-1], error );
+				}
+			}
+		}
+	}
+
+	// black and white checker
+	const unsigned char checker[16] = { 0, 0, 0, 255,  255, 255, 255, 255,  255, 255, 255, 255,  0, 0, 0, 255 };
+	unsigned char checkerLevel[4];
+	DownsampleImage( checker, 2, 2, 4, eMipmapFilterSRGB, checkerLevel );
+	report.checkerValue = checkerLevel[0];
+
+	// unit normals of random directions in the upper hemisphere
+	src.resize( (size_t) side * side * 3 );
+	dst.resize( (size_t) half * half * 3 );
+
+	unsigned int state = 7;
+	auto fn_random = [&state] () -> double {
+		state = state * 1664525u + 1013904223u;
+		return (double) (state >> 8) / 16777216.0;
+	};
+
+	for (size_t i=0; i<src.size(); i+=3)
+	{
+		const double angle = 6.2831853 * fn_random();
+		const double z = 0.3 + 0.7 * fn_random();
+		const double r = sqrt( 1.0 - z * z );
+
+		src[i] = (unsigned char) floor( (r * cos(angle) * 0.5 + 0.5) * 255.0 + 0.5 );
+		src[i+1] = (unsigned char) floor( (r * sin(angle) * 0.5 + 0.5) * 255.0 + 0.5 );
+		src[i+2] = (unsigned char) floor( (z * 0.5 + 0.5) * 255.0 + 0.5 );
+	}
+
+	DownsampleImage( src.data(), side, side, 3, eMipmapFilterNormalMap, dst.data() );
+	report.normalLengthError = NormalLengthError(dst);
+	DownsampleImage( src.data(), side, side, 3, eMipmapFilterLinear, dst.data() );
+	report.normalLinearError = NormalLengthError(dst);
+
+	// alpha tested pattern, coverage of each level down to 32x32 (smaller levels are averaged into a flat alpha)
+	const int alphaReference = 128;
+	src.resize( (size_t) side * side * 4 );
+
+	for (int y=0; y<side; ++y)
+	{
+		for (int x=0; x<side; ++x)
+		{
+			unsigned char *pixel = &src[ ((size_t) y * side + x) * 4 ];
+			pixel[0] = pixel[1] = pixel[2] = 100;
+			pixel[3] = (unsigned char) ( 255.0 * fabs( sin(0.05 * x) * sin(0.07 * y) ) );
+		}
+	}
+
+	report.baseCoverage = ComputeAlphaCoverage( src.data(), side, side, 4, alphaReference );
+
+	std::vector<unsigned char>	scaled(src);
+	std::vector<unsigned char>	plain(src);
+	
+	for (int levelSide=side; levelSide >= 64; levelSide /= 2)
+	{
+		const int next = levelSide / 2;
+		
+		dst.resize( (size_t) next * next * 4 );
+		DownsampleImage( scaled.data(), levelSide, levelSide, 4, eMipmapFilterSRGB, dst.data() );
+		ScaleAlphaToCoverage( dst.data(), next, next, 4, alphaReference, report.baseCoverage );
+		scaled.swap(dst);
+
+		dst.resize( (size_t) next * next * 4 );
+		DownsampleImage( plain.data(), levelSide, levelSide, 4, eMipmapFilterSRGB, dst.data() );
+		plain.swap(dst);
+
+		report.coverageError = std::max( report.coverageError, 
+			fabsf( ComputeAlphaCoverage( scaled.data(), next, next, 4, alphaReference ) - report.baseCoverage ) );
+		report.coveragePlainError = std::max( report.coveragePlainError, 
+			fabsf( ComputeAlphaCoverage( plain.data(), next, next, 4, alphaReference ) - report.baseCoverage ) );
+	}
+
+	report.oddLevels = GetNumberOfMipLevels( 3, 5 );
+
+	// whole chain of each filter
+	const int filterComponents[3] = { 1, 4, 3 };
+	const int iterations = std::max(1, numberOfIterations);
+
+	for (int filter=0; filter<3; ++filter)
+	{
+		const int components = filterComponents[filter];
+		
+		MakeRandomImage( side, side, components, 11, src );
+		std::vector<unsigned char>	chain( GetMipChainSize( side, side, components ) );
+
+		const BenchmarkClock::time_point start = BenchmarkClock::now();
+		for (int i=0; i<iterations; ++i)
+		{
+			const unsigned char *levelSrc = src.data();
+			unsigned char *levelDst = chain.data();
+
+			for (int level=1; level<GetNumberOfMipLevels(side, side); ++level)
+			{
+				int prevWidth, prevHeight, levelWidth, levelHeight;
+				GetMipLevelSize( side, side, level-1, prevWidth, prevHeight );
+				GetMipLevelSize( side, side, level, levelWidth, levelHeight );
+
+				DownsampleImage( levelSrc, prevWidth, prevHeight, components, (EMipmapFilter) filter, levelDst );
+				
+				levelSrc = levelDst;
+				levelDst += (size_t) levelWidth * levelHeight * components;
+			}
+		}
+		const double time = ElapsedMs(start) / (double) iterations;
+
+		report.chainRate[filter] = (time > 0.0) ? 0.001 * (double) side * (double) side / time : 0.0;
+	}
+
+	return true;
+}
+
+void PrintMipmapReport( const GPUCacheMipmapReport &report )
+{
+	printf( "mipmap filters benchmark - %dx%d random images\n", report.imageSize, report.imageSize );
+	printf( "  srgb error         %10d %d %d %d (1..4 components, 8 bit units)\n", report.srgbError[0], report.srgbError[1], 
+		report.srgbError[2], report.srgbError[3] );
+	printf( "  linear error       %10d %d %d %d\n", report.linearError[0], report.linearError[1], report.linearError[2], report.linearError[3] );
+	printf( "  checker            %10d (188 in linear light, 128 box average)\n", report.checkerValue );
+	printf( "  normal length      %10.4f renormalized, %.4f averaged\n", report.normalLengthError, report.normalLinearError );
+	printf( "  alpha coverage     %10.4f base, %.4f max error scaled, %.4f plain\n", report.baseCoverage, report.coverageError, 
+		report.coveragePlainError );
+	printf( "  3x5 levels         %10d\n", report.oddLevels );
+	printf( "  chain              %10.1f M pixels/s linear, %.1f srgb, %.1f normal map\n", report.chainRate[0], report.chainRate[1], 
+		report.chainRate[2] );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// sequence stream
+
+// memory source with a fixed read latency
+class CImageSequenceSlowSource : public CImageSequenceMemorySource
+{
+public:
+
+	//! a constructor
+	CImageSequenceSlowSource(const int latency)
+		: CImageSequenceMemorySource()
+		, mLatency(latency)
+	{}
+
+	virtual bool ReadFrame(const int frame, BYTE *dst) override
+	{
+		std::this_thread::sleep_for( std::chrono::milliseconds(mLatency) );
+		return CImageSequenceMemorySource::ReadFrame(frame, dst);
+	}
+
+protected:
+
+	int			mLatency;	// ms
+};
+
+// links table and frame records, header dummy and every data byte keep the frame number
+static void MakeSequenceFrames( const int numberOfFrames, const size_t frameSize, std::vector<BYTE> &frames )
+{
+	frames.resize( sizeof(ImageSequenceLink) * numberOfFrames );
+
+	for (int i=0; i<numberOfFrames; ++i)
+	{
+		ImageSequenceLink *links = (ImageSequenceLink*) frames.data();
+		links[i].link = (int64_t) frames.size();
+
+		ImageHeader2 header;
+		ImageHeader2::Set( 16, 16, 0, 0, (GLint) frameSize, 0, 1, header );
+		header.dummy = i;
+
+		const BYTE *headerData = (const BYTE*) &header;
+		frames.insert( end(frames), headerData, headerData + sizeof(ImageHeader2) );
+		frames.resize( frames.size() + frameSize, (BYTE) i );
+	}
+}
+
+static bool IsFrameRecord( const BYTE *record, const int frame, const size_t frameSize )
+{
+	if (record == nullptr || ((const ImageHeader2*) record)->dummy != frame)
+		return false;
+
+	const BYTE *data = record + sizeof(ImageHeader2);
+	return (data[0] == (BYTE) frame && data[frameSize-1] == (BYTE) frame);
+}
+
+bool BenchmarkSequenceStream( const int numberOfFrames, const size_t frameSize, const int windowFrames, GPUCacheSequenceReport &report )
+{
+	GPUCacheSequenceReport::Clear(report);
+
+	if (numberOfFrames <= 0 || frameSize == 0 || windowFrames <= 0)
+		return false;
+
+	report.numberOfFrames = numberOfFrames;
+	report.frameSize = frameSize;
+
+	std::vector<BYTE>	frames;
+	MakeSequenceFrames( numberOfFrames, frameSize, frames );
+
+	const double frameRate = 24.0;
+	ImageSequenceHeader2 header;
+	memset( &header, 0, sizeof(ImageSequenceHeader2) );
+	ImageSequenceHeader2::Set( 0.0, 0, numberOfFrames-1, frameRate, 1.0, 0, 1, 0, header );
+
+	const size_t budget = (size_t) windowFrames * (frameSize + sizeof(ImageHeader2));
+
+	// deterministic playback, times are in the middle of the frames
+	{
+		CImageSequenceMemorySource *source = new CImageSequenceMemorySource();
+		CImageSequenceStream stream;
+
+		if (false == source->Open( frames.data(), numberOfFrames, frames.size() ) 
+			|| false == stream.Open( header, source, budget, false ) )
+		{
+			return false;
+		}
+
+		report.numberOfSlots = stream.GetNumberOfSlots();
+
+		auto fn_step = [&stream, &report, numberOfFrames, frameSize, frameRate] (const int step) {
+			const int frame = stream.Evaluate( ((double) step + 0.5) / frameRate );
+			stream.ProcessRequests();
+
+			if (frame != step % numberOfFrames)
+				report.wrongFrames += 1;
+			if (false == IsFrameRecord( stream.GetFrame(frame), frame, frameSize ) )
+				report.wrongRecords += 1;
+		};
+
+		for (int i=0; i<100; ++i)
+			fn_step(i);
+		report.forward = stream.GetStats();
+
+		stream.ResetStats();
+		for (int i=100; i>=60; --i)
+			fn_step(i);
+		report.backward = stream.GetStats();
+
+		stream.ResetStats();
+		fn_step(10);
+		fn_step(30);
+		report.seek = stream.GetStats();
+	}
+
+	// reader thread
+	{
+		CImageSequenceSlowSource *source = new CImageSequenceSlowSource(2);
+		CImageSequenceStream stream;
+
+		if (false == source->Open( frames.data(), numberOfFrames, frames.size() ) 
+			|| false == stream.Open( header, source, budget, true ) )
+		{
+			return false;
+		}
+
+		auto fn_play = [&stream, &report, numberOfFrames, frameSize, frameRate] (const int step) {
+			const int frame = stream.Evaluate( ((double) step + 0.5) / frameRate );
+			std::this_thread::sleep_for( std::chrono::milliseconds(3) );
+
+			if (frame != step % numberOfFrames)
+				report.wrongFrames += 1;
+			if (false == IsFrameRecord( stream.GetFrame(frame), frame, frameSize ) )
+				report.wrongRecords += 1;
+		};
+
+		for (int i=0; i<200; ++i)
+			fn_play(i);
+		for (int i=200; i>=100; --i)
+			fn_play(i);
+
+		report.threaded = stream.GetStats();
+	}
+
+	return true;
+}
+
+void PrintSequenceReport( const GPUCacheSequenceReport &report )
+{
+	printf( "sequence stream benchmark - %d frames of %.1f KB, %d slots\n", report.numberOfFrames, (double) report.frameSize / 1024.0, 
+		report.numberOfSlots );
+
+	const char *names[4] = { "forward", "backward", "seek", "threaded" };
+	const ImageSequenceStreamStats *stats[4] = { &report.forward, &report.backward, &report.seek, &report.threaded };
+
+	for (int i=0; i<4; ++i)
+	{
+		printf( "  %-18s %4d hits, %d stalls (%.2f ms), %d prefetched, %d evicted, peak %.2f MB\n", names[i], stats[i]->hits, 
+			stats[i]->stalls, stats[i]->stallTime, stats[i]->prefetched, stats[i]->evicted, (double) stats[i]->peakMemory / (1024.0 * 1024.0) );
+	}
+	printf( "  wrong              %10d frames, %d records\n", report.wrongFrames, report.wrongRecords );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// sequence delta
+
+bool BenchmarkSequenceDelta( const int width, const int height, const int numberOfFrames, GPUCacheSequenceDeltaReport &report )
+{
+	GPUCacheSequenceDeltaReport::Clear(report);
+
+	if (width < 128 || height < 128 || numberOfFrames <= 0)
+		return false;
+
+	report.numberOfFrames = numberOfFrames;
+	report.width = width;
+	report.height = height;
+
+	const size_t frameSize = GetCompressedImageSize( eTextureCompressionBC1, width, height );
+
+	// gradients and a checker
+	std::vector<unsigned char>	background( (size_t) width * height * 3 );
+
+	for (int y=0; y<height; ++y)
+	{
+		for (int x=0; x<width; ++x)
+		{
+			unsigned char *pixel = &background[ ((size_t) y * width + x) * 3 ];
+			pixel[0] = (unsigned char) (x * 255 / width);
+			pixel[1] = (unsigned char) (y * 255 / height);
+			pixel[2] = ( ((x / 32) + (y / 32)) & 1 ) ? 200 : 40;
+		}
+	}
+
+	// links table and BC1 frame records
+	std::vector<BYTE>			frames( sizeof(ImageSequenceLink) * numberOfFrames );
+	std::vector<unsigned char>	image;
+	std::vector<unsigned char>	compressed(frameSize);
+
+	for (int i=0; i<numberOfFrames; ++i)
+	{
+		image = background;
+
+		const int startX = (50 + i * 8) % (width - 64);
+		const int startY = 100 + (i % 20) * 5;
+
+		for (int y=startY; y<startY+64 && y<height; ++y)
+		{
+			for (int x=startX; x<startX+64; ++x)
+			{
+				unsigned char *pixel = &image[ ((size_t) y * width + x) * 3 ];
+				pixel[0] = 255;
+				pixel[1] = (unsigned char) (i * 3);
+				pixel[2] = 0;
+			}
+		}
+
+		CompressImage( image.data(), width, height, 3, false, eTextureCompressionBC1, eTextureCompressionFast, compressed.data(), 1 );
+
+		((ImageSequenceLink*) frames.data())[i].link = (int64_t) frames.size();
+
+		ImageHeader2 header;
+		ImageHeader2::Set( width, height, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_RGB, (GLint) frameSize, 0, 1, header );
+		header.type = IMAGE_TYPE_STILL;
+
+		const BYTE *headerData = (const BYTE*) &header;
+		frames.insert( end(frames), headerData, headerData + sizeof(ImageHeader2) );
+		frames.insert( end(frames), begin(compressed), end(compressed) );
+	}
+
+	auto fn_source = [&frames] (const int frame) -> const BYTE* {
+		return frames.data() + ((const ImageSequenceLink*) frames.data())[frame].link + sizeof(ImageHeader2);
+	};
+
+	// full frame copy as a reference of the decode time
+	{
+		std::vector<BYTE>	copy(frameSize);
+
+		const BenchmarkClock::time_point start = BenchmarkClock::now();
+		for (int i=0; i<numberOfFrames; ++i)
+			memcpy( copy.data(), fn_source(i), frameSize );
+		report.copyTime = ElapsedMs(start) / (double) numberOfFrames;
+	}
+
+	report.fullUploadSize = frameSize * numberOfFrames;
+
+	const int keyFrameIntervals[SEQUENCE_DELTA_BENCHMARK_CONFIGS] = { 8, 32 };
+
+	for (int config=0; config<SEQUENCE_DELTA_BENCHMARK_CONFIGS; ++config)
+	{
+		report.keyFrameInterval[config] = keyFrameIntervals[config];
+
+		std::vector<BYTE>	encoded;
+
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		if (false == EncodeSequenceFrames( frames.data(), numberOfFrames, frames.size(), keyFrameIntervals[config], encoded, &report.encode[config] ) )
+			return false;
+		report.encodeTime[config] = ElapsedMs(start);
+
+		CImageSequenceDeltaDecoder	decoder;
+
+		auto fn_decode = [&decoder, &encoded, &report, &fn_source, frameSize] (const int frame, CImageSequenceStream *stream) {
+			if (false == decoder.Decode( frame, stream, (stream) ? nullptr : encoded.data() ) 
+				|| decoder.GetImageSize() < frameSize || 0 != memcmp( decoder.GetImage(), fn_source(frame), frameSize ) )
+			{
+				report.mismatches += 1;
+			}
+		};
+
+		start = BenchmarkClock::now();
+		for (int i=0; i<numberOfFrames; ++i)
+			fn_decode(i, nullptr);
+		report.decodeTime[config] = ElapsedMs(start) / (double) numberOfFrames;
+
+		for (int i=numberOfFrames-1; i>=0; --i)
+			fn_decode(i, nullptr);
+
+		unsigned int state = 3;
+		for (int i=0; i<200; ++i)
+		{
+			state = state * 1664525u + 1013904223u;
+			fn_decode( (int) ((state >> 8) % (unsigned int) numberOfFrames), nullptr );
+		}
+
+		// streamed frame records
+		ImageSequenceHeader2 header;
+		memset( &header, 0, sizeof(ImageSequenceHeader2) );
+		ImageSequenceHeader2::Set( 0.0, 0, numberOfFrames-1, 24.0, 1.0, 0, 1, 0, header );
+
+		CImageSequenceMemorySource *source = new CImageSequenceMemorySource();
+		CImageSequenceStream stream;
+
+		if (false == source->Open( encoded.data(), numberOfFrames, encoded.size() ) 
+			|| false == stream.Open( header, source, 8 * frameSize, false ) )
+		{
+			return false;
+		}
+
+		decoder.Reset();
+		for (int i=0; i<numberOfFrames + numberOfFrames/2; ++i)
+		{
+			const int frame = stream.Evaluate( ((double) i + 0.5) / 24.0 );
+			stream.ProcessRequests();
+			fn_decode(frame, &stream);
+		}
+
+		// bytes of the partial upload, delta frames upload only their runs
+		for (int i=0; i<numberOfFrames; ++i)
+		{
+			const BYTE *record = GetSequenceFrameRecord( i, nullptr, encoded.data() );
+			const ImageHeader2 *recordHeader = (const ImageHeader2*) record;
+
+			report.uploadSize[config] += recordHeader->size;
+
+			if (recordHeader->type == IMAGE_TYPE_FRAME_DELTA)
+			{
+				const ImageFrameDeltaHeader *frameDelta = (const ImageFrameDeltaHeader*) (record + sizeof(ImageHeader2));
+				report.numberOfSubImages[config] += frameDelta->numberOfRuns;
+			}
+		}
+	}
+
+	return true;
+}
+
+void PrintSequenceDeltaReport( const GPUCacheSequenceDeltaReport &report )
+{
+	printf( "sequence delta benchmark - %d BC1 frames %dx%d\n", report.numberOfFrames, report.width, report.height );
+
+	for (int i=0; i<SEQUENCE_DELTA_BENCHMARK_CONFIGS; ++i)
+	{
+		const ImageSequenceEncodeStats &encode = report.encode[i];
+
+		printf( "  key every %2d       %10.2f MB -> %.2f MB (%.1f%%), %d key, %d delta frames, encode %.2f ms\n", report.keyFrameInterval[i], 
+			(double) encode.sourceSize / (1024.0 * 1024.0), (double) encode.encodedSize / (1024.0 * 1024.0), 
+			(encode.sourceSize > 0) ? 100.0 * (double) encode.encodedSize / (double) encode.sourceSize : 0.0, 
+			encode.keyFrames, encode.deltaFrames, report.encodeTime[i] );
+		printf( "                     %10.3f ms per frame decode (%.3f ms full copy), upload %.2f MB of %.2f MB, %d sub images\n", 
+			report.decodeTime[i], report.copyTime, (double) report.uploadSize[i] / (1024.0 * 1024.0), 
+			(double) report.fullUploadSize / (1024.0 * 1024.0), report.numberOfSubImages[i] );
+	}
+	printf( "  mismatches         %10d\n", report.mismatches );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// textures sharing
+
+#define SHARING_PLAIN_TEST_FILENAME		"benchmark_test_sharing_v2.xml"
+#define SHARING_TEST_FILENAME			"benchmark_test_sharing.xml"
+#define SHARING_SECOND_TEST_FILENAME	"benchmark_test_sharing_b.xml"
+
+static GLuint				gNextTextureId = 1;
+static int					gUploads = 0;
+static size_t				gUploadBytes = 0;
+static std::vector<GLuint>	gDeletedTextures;
+
+static void DeleteFakeTexture( const GLuint texId )
+{
+	gDeletedTextures.push_back(texId);
+}
+
+static void CheckSharing( const bool condition, const char *what, int &errors )
+{
+	if (false == condition)
+	{
+		printf( "> ERROR: %s\n", what );
+		errors += 1;
+	}
+}
+
+// image part of the gl visitor (CGPUCacheLoaderVisitorImpl) with the fake texture ids
+class CGPUCacheSharingVisitor : public CGPUCacheNullVisitor
+{
+public:
+	//! a constructor
+	CGPUCacheSharingVisitor(const bool share)
+		: CGPUCacheNullVisitor(false)
+		, mShare(share)
+		, mDigest(0)
+		, mImageIndex(0)
+		, mNumberOfDigests(0)
+	{}
+
+	virtual bool OnReadTexturesBegin( const char *textures_filename, const int numberOfSamplers, const int numberOfImages ) override
+	{
+		mIds.assign(numberOfImages, 0);
+		mDigests.assign(numberOfImages, 0);
+		mSamplerVideos.clear();
+		mImageIndex = 0;
+		return true;
+	}
+	virtual void OnReadTexturesDigest(const int imageIndex, const uint64_t digest) override
+	{
+		mNumberOfDigests += 1;
+		mDigest = (mShare) ? digest : 0;
+	}
+	virtual void OnReadEmptyImage() override
+	{
+		mImageIndex += 1;
+	}
+	virtual void OnReadTexturesImage2(const BYTE type, const ImageHeader2 *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override
+	{
+		CTexturesRegistry &registry = CTexturesRegistry::GetInstance();
+		const bool shared = (type == IMAGE_TYPE_STILL && mDigest != 0);
+
+		GLuint texId = (shared) ? registry.Acquire(mDigest) : 0;
+
+		if (texId == 0)
+		{
+			texId = gNextTextureId++;
+			gUploads += 1;
+			gUploadBytes += imageSize;
+
+			if (shared && false == registry.Register(mDigest, texId, imageSize) )
+				mDigest = 0;
+		}
+
+		mIds[mImageIndex] = texId;
+		mDigests[mImageIndex] = (shared) ? mDigest : 0;
+
+		mDigest = 0;
+		mImageIndex += 1;
+	}
+	virtual void OnReadTexturesSampler(const char *samplerName, const char *clipFile, const SamplerHeader *header, const size_t fileSamplerOffset, const size_t samplerSize, const BYTE *samplerData) override
+	{
+		mSamplerVideos.push_back(header->videoIndex);
+	}
+
+	// registry references are released, own textures are deleted
+	void Free()
+	{
+		for (size_t i=0; i<mIds.size(); ++i)
+		{
+			if (mDigests[i] != 0)
+				CTexturesRegistry::GetInstance().Release(mDigests[i]);
+			else if (mIds[i] != 0)
+				DeleteFakeTexture(mIds[i]);
+		}
+		mIds.clear();
+		mDigests.clear();
+	}
+
+	const int GetNumberOfDigests() const
+	{
+		return mNumberOfDigests;
+	}
+	const GLuint GetTexture(const int index) const
+	{
+		return mIds[index];
+	}
+	const uint64_t GetDigest(const int index) const
+	{
+		return mDigests[index];
+	}
+	const std::vector<int> &GetSamplerVideos() const
+	{
+		return mSamplerVideos;
+	}
+
+protected:
+
+	bool						mShare;
+	uint64_t			mDigest;
+	int							mImageIndex;
+	int							mNumberOfDigests;
+
+	std::vector<GLuint>			mIds;
+	std::vector<uint64_t>	mDigests;
+	std::vector<int>			mSamplerVideos;
+};
+
+static bool LoadSharingCache( const char *filename, const bool pipelined, CGPUCacheLoaderVisitor *visitor )
+{
+	if (pipelined)
+	{
+		CGPUCacheLoaderPipelined	loader;
+		return loader.Load( filename, visitor );
+	}
+
+	CGPUCacheLoader	loader;
+	const bool result = loader.Load( filename, visitor );
+	loader.Close();
+	return result;
+}
+
+// a texture is deleted only once
+static bool HasDoubleDeletes()
+{
+	std::vector<GLuint> deleted(gDeletedTextures);
+	std::sort( begin(deleted), end(deleted) );
+	return (std::adjacent_find( begin(deleted), end(deleted) ) != end(deleted) );
+}
+
+bool BenchmarkTexturesSharing( const GPUCacheSyntheticOptions &options, GPUCacheTexturesSharingReport &report )
+{
+	GPUCacheTexturesSharingReport::Clear(report);
+
+	report.numberOfTextures = options.numberOfTextures;
+	report.numberOfVariations = options.textureVariations;
+	report.textureSize = options.textureSize;
+
+	const int numberOfContents = (options.textureVariations > 0) ? std::min(options.textureVariations, options.numberOfTextures) 
+		: options.numberOfTextures;
+
+	CTexturesRegistry &registry = CTexturesRegistry::GetInstance();
+	registry.SetDeleteCallback(DeleteFakeTexture);
+
+	CGPUCacheSaver	plainSaver;
+	CGPUCacheSaver	digestSaver;
+	digestSaver.SetTextureDigests(true);
+
+	if (false == GenerateSyntheticCache( SHARING_PLAIN_TEST_FILENAME, options, plainSaver ) 
+		|| false == GenerateSyntheticCache( SHARING_TEST_FILENAME, options, digestSaver ) )
+	{
+		return false;
+	}
+
+	report.numberOfDuplicates = digestSaver.GetTextureExportStats().numberOfDuplicates;
+	report.plainPackSize = GetBenchmarkFileSize( MakeBenchmarkPackFilename( SHARING_PLAIN_TEST_FILENAME, "_Textures.pck" ).c_str() );
+	report.digestPackSize = GetBenchmarkFileSize( MakeBenchmarkPackFilename( SHARING_TEST_FILENAME, "_Textures.pck" ).c_str() );
+
+	int &errors = report.lifetimeErrors;
+
+	for (int pipelined=0; pipelined<TEXTURES_SHARING_BENCHMARK_LOADERS; ++pipelined)
+	{
+		gUploads = 0;
+		gUploadBytes = 0;
+		gDeletedTextures.clear();
+
+		CGPUCacheSharingVisitor	first(true), second(true), own(false);
+
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		if (false == LoadSharingCache( SHARING_TEST_FILENAME, pipelined == 1, &first ) )
+			return false;
+		report.firstLoad[pipelined] = ElapsedMs(start);
+
+		CheckSharing( first.GetNumberOfDigests() == numberOfContents, "digest for each stored image", errors );
+		CheckSharing( gUploads == numberOfContents && registry.GetNumberOfTextures() == numberOfContents, "one upload for each content", errors );
+
+		// samplers of the repeated images refer to the first copy
+		const std::vector<int> &videos = first.GetSamplerVideos();
+		CheckSharing( (int) videos.size() == options.numberOfTextures, "sampler for each texture", errors );
+
+		for (int i=0; i<(int) videos.size(); ++i)
+		{
+			CheckSharing( videos[i] == i % numberOfContents && first.GetTexture(videos[i]) != 0, "sampler refers to the first copy", errors );
+		}
+
+		start = BenchmarkClock::now();
+		if (false == LoadSharingCache( SHARING_TEST_FILENAME, pipelined == 1, &second ) )
+			return false;
+		report.sharedLoad[pipelined] = ElapsedMs(start);
+
+		CheckSharing( gUploads == numberOfContents && registry.GetNumberOfTextures() == numberOfContents, "second cache takes the registry textures", errors );
+
+		for (int i=0; i<numberOfContents; ++i)
+		{
+			CheckSharing( first.GetTexture(i) == second.GetTexture(i) && registry.GetReferenceCount(first.GetDigest(i)) == 2, 
+				"same texture with two references", errors );
+		}
+
+		if (false == LoadSharingCache( SHARING_TEST_FILENAME, pipelined == 1, &own ) )
+			return false;
+
+		CheckSharing( gUploads == 2 * numberOfContents, "cache without the registry uploads its own textures", errors );
+
+		report.uploads[pipelined] = gUploads;
+		report.uploadBytes[pipelined] = gUploadBytes;
+
+		// lifetime, registry texture is deleted with the last reference
+		std::vector<uint64_t> digests(numberOfContents);
+		for (int i=0; i<numberOfContents; ++i)
+			digests[i] = first.GetDigest(i);
+
+		first.Free();
+		CheckSharing( gDeletedTextures.size() == 0, "no deletes while the texture is referenced", errors );
+
+		for (int i=0; i<numberOfContents; ++i)
+			CheckSharing( registry.GetReferenceCount(digests[i]) == 1, "one reference left", errors );
+
+		own.Free();
+		CheckSharing( (int) gDeletedTextures.size() == numberOfContents, "own textures are deleted", errors );
+
+		second.Free();
+		CheckSharing( (int) gDeletedTextures.size() == 2 * numberOfContents && registry.GetNumberOfTextures() == 0, 
+			"last reference deletes the texture", errors );
+		CheckSharing( false == HasDoubleDeletes(), "texture is deleted once", errors );
+	}
+
+	// partial load takes only the images of the model
+	{
+		CGPUCacheSyntheticQuery query(options);
+		query.Init(SHARING_TEST_FILENAME);
+		const char *names[1] = { query.GetModelName(options.numberOfModels / 2) };
+
+		CGPUCacheSharingVisitor	visitor(true);
+		CGPUCacheLoader			loader;
+
+		CheckSharing( loader.LoadModels( SHARING_TEST_FILENAME, 1, names, &visitor ), "partial load", errors );
+		loader.Close();
+		visitor.Free();
+
+		CheckSharing( registry.GetNumberOfTextures() == 0, "partial load releases the textures", errors );
+	}
+
+	registry.SetDeleteCallback(nullptr);
+
+	// duplicates over the plain, digest and one more digest pack
+	if (false == GenerateSyntheticCache( SHARING_SECOND_TEST_FILENAME, options, digestSaver ) )
+		return false;
+
+	const std::string packs[3] = { 
+		MakeBenchmarkPackFilename( SHARING_PLAIN_TEST_FILENAME, "_Textures.pck" ),
+		MakeBenchmarkPackFilename( SHARING_TEST_FILENAME, "_Textures.pck" ),
+		MakeBenchmarkPackFilename( SHARING_SECOND_TEST_FILENAME, "_Textures.pck" ) };
+	const char *filenames[3] = { packs[0].c_str(), packs[1].c_str(), packs[2].c_str() };
+
+	const BenchmarkClock::time_point start = BenchmarkClock::now();
+	if (false == BuildTexturesDedupReport( 3, filenames, report.dedup ) )
+		return false;
+	report.dedupTime = ElapsedMs(start);
+
+	return true;
+}
+
+void PrintTexturesSharingReport( const GPUCacheTexturesSharingReport &report )
+{
+	printf( "textures sharing benchmark - %d textures of %d contents, %dx%d\n", report.numberOfTextures, report.numberOfVariations, 
+		report.textureSize, report.textureSize );
+	printf( "  textures pack      %10.2f MB plain, %.2f MB with digests (%d duplicates)\n", (double) report.plainPackSize / (1024.0 * 1024.0), 
+		(double) report.digestPackSize / (1024.0 * 1024.0), report.numberOfDuplicates );
+
+	const char *names[TEXTURES_SHARING_BENCHMARK_LOADERS] = { "simple   ", "pipelined" };
+	for (int i=0; i<TEXTURES_SHARING_BENCHMARK_LOADERS; ++i)
+	{
+		printf( "  %s load     %10.2f ms first, %.2f ms shared, %d uploads (%.2f MB) for 3 caches\n", names[i], report.firstLoad[i], 
+			report.sharedLoad[i], report.uploads[i], (double) report.uploadBytes[i] / (1024.0 * 1024.0) );
+	}
+	printf( "  lifetime errors    %10d\n", report.lifetimeErrors );
+	printf( "  dedup report       %10.2f ms, %d unique of %d images, %d in pack and %d across packs duplicates\n", report.dedupTime, 
+		report.dedup.uniqueImages, report.dedup.numberOfImages, report.dedup.duplicatesInPack, report.dedup.duplicatesAcrossPacks );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tests
+
+bool TestTextureExport()
+{
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(16, 1024, 4, 32, 1024, options);
+
+	GPUCacheTextureExportReport report;
+	if (false == BenchmarkTextureExport( options, report ) )
+		return false;
+
+	PrintTextureExportReport(report);
+
+	if (false == report.identical)
+		return false;
+
+	// mip levels of one image (1.33 MB) fit into the smallest budget, so the budget is never exceeded
+	for (int i=0; i<TEXTURE_EXPORT_BENCHMARK_CONFIGS; ++i)
+	{
+		if (report.peakMemory[i] > report.memoryBudget[i] || report.throughput[i] <= 0.0)
+			return false;
+	}
+	return true;
+}
+
+bool TestTextureCompression()
+{
+	GPUCacheTextureCompressionReport report;
+	if (false == BenchmarkTextureCompression( 512, 3, report ) )
+		return false;
+
+	PrintTextureCompressionReport(report);
+
+	// lowest psnr of the fast mode for color, color alpha, mask and normal map
+	const double limits[TEXTURE_COMPRESSION_BENCHMARK_IMAGES] = { 38.0, 38.0, 48.0, 36.0 };
+
+	for (int i=0; i<TEXTURE_COMPRESSION_BENCHMARK_IMAGES; ++i)
+	{
+		if (report.psnr[i][eTextureCompressionFast] < limits[i])
+			return false;
+
+		for (int quality=1; quality<TEXTURE_COMPRESSION_BENCHMARK_QUALITIES; ++quality)
+		{
+			if (report.psnr[i][quality] < report.psnr[i][quality-1] - 0.05)
+				return false;
+		}
+	}
+	return true;
+}
+
+bool TestMipmapFilters()
+{
+	GPUCacheMipmapReport report;
+	if (false == BenchmarkMipmapFilters( 1024, 3, report ) )
+		return false;
+
+	PrintMipmapReport(report);
+
+	for (int i=0; i<4; ++i)
+	{
+		if (report.srgbError[i] > 1 || report.linearError[i] > 1)
+			return false;
+	}
+
+	return (abs(report.checkerValue - 188) <= 1 && report.normalLengthError < 0.02 && report.normalLengthError < report.normalLinearError 
+		&& report.coverageError < 0.02f && report.coverageError < report.coveragePlainError && report.oddLevels == 3);
+}
+
+bool TestSequenceStream()
+{
+	GPUCacheSequenceReport report;
+	if (false == BenchmarkSequenceStream( 48, 64 * 1024, 8, report ) )
+		return false;
+
+	PrintSequenceReport(report);
+
+	// requests are read before each frame is taken, so the deterministic playback never waits
+	return (report.wrongFrames == 0 && report.wrongRecords == 0 
+		&& report.forward.stalls == 0 && report.backward.stalls == 0 && report.seek.stalls == 0
+		&& report.forward.peakMemory <= (size_t) report.numberOfSlots * (report.frameSize + sizeof(ImageHeader2)) );
+}
+
+bool TestSequenceDelta()
+{
+	GPUCacheSequenceDeltaReport report;
+	if (false == BenchmarkSequenceDelta( 1024, 512, 96, report ) )
+		return false;
+
+	PrintSequenceDeltaReport(report);
+
+	if (report.mismatches > 0)
+		return false;
+
+	// the square covers less than 2% of the frame
+	for (int i=0; i<SEQUENCE_DELTA_BENCHMARK_CONFIGS; ++i)
+	{
+		if (report.encode[i].deltaFrames == 0 || report.encode[i].encodedSize * 4 > report.encode[i].sourceSize)
+			return false;
+	}
+	return true;
+}
+
+bool TestTexturesSharing()
+{
+	// registry calls without a loader
+	CTexturesRegistry &registry = CTexturesRegistry::GetInstance();
+	registry.SetDeleteCallback(DeleteFakeTexture);
+	gDeletedTextures.clear();
+
+	const uint64_t digest = 5;
+	int errors = 0;
+
+	CheckSharing( registry.Acquire(digest) == 0, "unknown content", errors );
+	CheckSharing( registry.Register(digest, 11, 100), "register", errors );
+	CheckSharing( false == registry.Register(digest, 12, 100) && false == registry.Register(0, 13, 100), "register twice", errors );
+	CheckSharing( registry.Acquire(digest) == 11 && registry.GetReferenceCount(digest) == 2, "acquire", errors );
+	CheckSharing( registry.GetResidentBytes() == 100 && registry.GetSharedBytes() >= 100, "resident bytes", errors );
+
+	registry.Release(digest);
+	CheckSharing( gDeletedTextures.size() == 0 && registry.GetReferenceCount(digest) == 1, "release", errors );
+	registry.Release(digest);
+	CheckSharing( gDeletedTextures.size() == 1 && gDeletedTextures[0] == 11 && registry.GetNumberOfTextures() == 0 
+		&& registry.GetResidentBytes() == 0, "last release", errors );
+	registry.Release(digest);
+	CheckSharing( gDeletedTextures.size() == 1 && registry.Acquire(digest) == 0, "release of the deleted content", errors );
+
+	registry.SetDeleteCallback(nullptr);
+
+	if (errors > 0)
+		return false;
+
+	GPUCacheSyntheticOptions options;
+	GPUCacheSyntheticOptions::Set(16, 1024, 8, 32, 512, options);
+	options.textureVariations = 8;
+
+	GPUCacheTexturesSharingReport report;
+	if (false == BenchmarkTexturesSharing( options, report ) )
+		return false;
+
+	PrintTexturesSharingReport(report);
+
+	const int duplicates = options.numberOfTextures - options.textureVariations;
+	return (report.lifetimeErrors == 0 && report.numberOfDuplicates == duplicates && report.digestPackSize < report.plainPackSize
+		&& report.dedup.uniqueImages == options.textureVariations && report.dedup.duplicatesInPack == duplicates 
+		&& report.dedup.duplicatesAcrossPacks == 2 * options.textureVariations);
+}
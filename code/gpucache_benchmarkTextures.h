@@ -0,0 +1,236 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_benchmarkTextures.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_benchmark.h"
+#include "shared_sequences.h"
+#include "gpucache_texturesDedup.h"
+
+//
+// textures pack benchmarks and tests (export, mipmaps, compression, sequences)
+//	only cpu code of the saver, the loader and the algorithm modules is used
+//
+
+//////////////////////////////////////////////////////////////////////////
+// streaming textures export with a different number of workers and memory budgets
+
+#define TEXTURE_EXPORT_BENCHMARK_CONFIGS		6
+
+struct GPUCacheTextureExportReport
+{
+	int			numberOfImages;
+	int			imageSize;
+
+	int			numberOfWorkers[TEXTURE_EXPORT_BENCHMARK_CONFIGS];
+	size_t		memoryBudget[TEXTURE_EXPORT_BENCHMARK_CONFIGS];
+
+	double		exportTime[TEXTURE_EXPORT_BENCHMARK_CONFIGS];		// ms, textures pack only
+	double		throughput[TEXTURE_EXPORT_BENCHMARK_CONFIGS];		// MB/s of the written pack
+	size_t		peakMemory[TEXTURE_EXPORT_BENCHMARK_CONFIGS];		// peak of the scratch buffers
+	size_t		packSize[TEXTURE_EXPORT_BENCHMARK_CONFIGS];
+
+	bool		identical;		// every config wrote the same pack
+
+	static void Clear(GPUCacheTextureExportReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheTextureExportReport) );
+	}
+};
+
+// images are exported with the generated mip levels, so the workers use the scratch buffers
+bool BenchmarkTextureExport( const GPUCacheSyntheticOptions &options, GPUCacheTextureExportReport &report );
+
+void PrintTextureExportReport( const GPUCacheTextureExportReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// block compression of the synthetic images, each image goes with the format it's made for
+//	color (BC1), color with alpha (BC3), mask (BC4), normal map (BC5)
+
+#define TEXTURE_COMPRESSION_BENCHMARK_IMAGES	4
+#define TEXTURE_COMPRESSION_BENCHMARK_QUALITIES	3
+
+struct GPUCacheTextureCompressionReport
+{
+	int			imageSize;
+	int			numberOfIterations;
+
+	const char	*imageName[TEXTURE_COMPRESSION_BENCHMARK_IMAGES];
+	int			format[TEXTURE_COMPRESSION_BENCHMARK_IMAGES];		// ETextureCompressionFormat
+
+	// indexed by the image and ETextureCompressionQuality
+	double		psnr[TEXTURE_COMPRESSION_BENCHMARK_IMAGES][TEXTURE_COMPRESSION_BENCHMARK_QUALITIES];
+	double		rate[TEXTURE_COMPRESSION_BENCHMARK_IMAGES][TEXTURE_COMPRESSION_BENCHMARK_QUALITIES];	// M pixels/s, one thread
+	double		decodeRate[TEXTURE_COMPRESSION_BENCHMARK_IMAGES];
+
+	static void Clear(GPUCacheTextureCompressionReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheTextureCompressionReport) );
+	}
+};
+
+bool BenchmarkTextureCompression( const int imageSize, const int numberOfIterations, GPUCacheTextureCompressionReport &report );
+
+void PrintTextureCompressionReport( const GPUCacheTextureCompressionReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// mip filters against a double precision reference, random images
+
+struct GPUCacheMipmapReport
+{
+	int			imageSize;
+	
+	int			srgbError[4];			// max difference in 8 bit units for 1..4 components
+	int			linearError[4];
+	int			checkerValue;			// black and white 2x2 in sRGB, 188 is the linear light average
+
+	double		normalLengthError;		// max |length - 1| of the renormalized normals
+	double		normalLinearError;		// the same with the plain average
+
+	float		baseCoverage;			// alpha tested coverage of the base level
+	float		coverageError;			// max coverage difference of the levels (down to 32x32) with ScaleAlphaToCoverage
+	float		coveragePlainError;		// and without it
+
+	int			oddLevels;				// levels of 3x5, OpenGL gives 3
+
+	double		chainRate[3];			// M source pixels/s of the whole chain for EMipmapFilter (1, 4 and 3 components)
+
+	static void Clear(GPUCacheMipmapReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheMipmapReport) );
+	}
+};
+
+bool BenchmarkMipmapFilters( const int imageSize, const int numberOfIterations, GPUCacheMipmapReport &report );
+
+void PrintMipmapReport( const GPUCacheMipmapReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// sequence streaming window, frames block in memory
+//	deterministic part has no reader thread (ProcessRequests after each Evaluate), every step checks
+//	the evaluated frame number and the frame record content. Threaded part plays against a slow source
+
+struct GPUCacheSequenceReport
+{
+	int			numberOfFrames;
+	size_t		frameSize;
+	int			numberOfSlots;
+
+	ImageSequenceStreamStats	forward;		// looped playback, 100 frames
+	ImageSequenceStreamStats	backward;		// 40 frames back
+	ImageSequenceStreamStats	seek;			// two jumps
+	ImageSequenceStreamStats	threaded;		// forward and back at 3 ms per frame, 2 ms per read
+
+	int			wrongFrames;		// evaluated frame differs from the expected one
+	int			wrongRecords;		// record content is not the one of the frame
+
+	static void Clear(GPUCacheSequenceReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheSequenceReport) );
+	}
+};
+
+bool BenchmarkSequenceStream( const int numberOfFrames, const size_t frameSize, const int windowFrames, GPUCacheSequenceReport &report );
+
+void PrintSequenceReport( const GPUCacheSequenceReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// delta coded BC1 sequence, a moving square over a static background
+
+#define SEQUENCE_DELTA_BENCHMARK_CONFIGS		2
+
+struct GPUCacheSequenceDeltaReport
+{
+	int			numberOfFrames;
+	int			width;
+	int			height;
+	
+	int			keyFrameInterval[SEQUENCE_DELTA_BENCHMARK_CONFIGS];
+	ImageSequenceEncodeStats	encode[SEQUENCE_DELTA_BENCHMARK_CONFIGS];
+	double		encodeTime[SEQUENCE_DELTA_BENCHMARK_CONFIGS];	// ms, all frames
+
+	double		decodeTime[SEQUENCE_DELTA_BENCHMARK_CONFIGS];	// ms per frame, forward playback
+	double		copyTime;										// ms per frame, memcpy of a full frame
+
+	size_t		uploadSize[SEQUENCE_DELTA_BENCHMARK_CONFIGS];	// bytes of the partial upload path, all frames
+	size_t		fullUploadSize;									// the same for the full frames
+	int			numberOfSubImages[SEQUENCE_DELTA_BENCHMARK_CONFIGS];	// glCompressedTexSubImage2D calls of the delta frames
+
+	int			mismatches;		// decoded frames (forward, backward, seek and streamed) which differ from the source
+
+	static void Clear(GPUCacheSequenceDeltaReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheSequenceDeltaReport) );
+	}
+};
+
+bool BenchmarkSequenceDelta( const int width, const int height, const int numberOfFrames, GPUCacheSequenceDeltaReport &report );
+
+void PrintSequenceDeltaReport( const GPUCacheSequenceDeltaReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// shared textures registry, the textures pack repeats the images (textureVariations)
+//	caches are loaded by a visitor which works like the gl one, texture ids are fake and deleted by the registry callback
+//	two caches share the images, the third one doesn't use the registry
+
+#define TEXTURES_SHARING_BENCHMARK_LOADERS		2		// simple and pipelined
+
+struct GPUCacheTexturesSharingReport
+{
+	int			numberOfTextures;
+	int			numberOfVariations;
+	int			textureSize;
+
+	size_t		plainPackSize;			// pack without the digests (version 2)
+	size_t		digestPackSize;
+	int			numberOfDuplicates;		// collapsed on export
+
+	int			uploads[TEXTURES_SHARING_BENCHMARK_LOADERS];		// three cache loads
+	size_t		uploadBytes[TEXTURES_SHARING_BENCHMARK_LOADERS];
+	double		firstLoad[TEXTURES_SHARING_BENCHMARK_LOADERS];		// ms, the first cache
+	double		sharedLoad[TEXTURES_SHARING_BENCHMARK_LOADERS];		// ms, the second cache takes the registry textures
+
+	int			lifetimeErrors;			// wrong references, ids or deletes
+
+	GPUCacheTexturesDedupReport		dedup;	// plain, digest and one more digest pack
+	double		dedupTime;				// ms
+
+	static void Clear(GPUCacheTexturesSharingReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheTexturesSharingReport) );
+	}
+};
+
+bool BenchmarkTexturesSharing( const GPUCacheSyntheticOptions &options, GPUCacheTexturesSharingReport &report );
+
+void PrintTexturesSharingReport( const GPUCacheTexturesSharingReport &report );
+
+//////////////////////////////////////////////////////////////////////////
+// tests
+
+// scratch memory stays in the budget, the pack doesn't depend on the number of workers
+bool TestTextureExport();
+
+// psnr of each format is over the limit and doesn't go down with a higher quality
+bool TestTextureCompression();
+
+// filters match the reference, normals stay unit, alpha coverage is kept
+bool TestMipmapFilters();
+
+// playback in both directions gives the right frames, a prefetched window has no stalls
+bool TestSequenceStream();
+
+// delta frames decode into the source frames in any order and are much smaller
+bool TestSequenceDelta();
+
+// registry reference counts, one texture for the same content of two caches, deleted with the last reference
+bool TestTexturesSharing();
@@ -13,18 +13,15 @@
 
 
 #include "gpucache_loader.h"
-#include "IO\tinyxml.h"
 
 
-#include <io.h>
-#include <fcntl.h>
-#include <sys\stat.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <share.h>
 #include <string>
+#include <stdexcept>
 
 #include <vector>
+#include <algorithm>
 
 ///////////////////////////////////
 
@@ -41,29 +38,33 @@
 CGPUCacheLoader::CGPUCacheLoader()
 {
 	mVisitor = nullptr;
+	mUseFileMapping = true;
 }
 
-//
-#define SAFE_READ(fh, data, size) \
-		if (size != _read(fh, data, size ) ) \
-			throw std::exception( "error while reading data!\n" );
+void CGPUCacheLoader::Close()
+{
+	mTexturesMapping.Close();
+	mGeometryMapping.Close();
+
+	std::vector<BYTE>().swap(mPartialGeometry);
+}
 
-int CalculateImageSize( BYTE *stream, size_t &imageSize )
+int CalculateImageSize( const BYTE *stream, size_t &imageSize )
 {
 	// retrieve a header
-	ImageHeader			*header=nullptr;
-	ImageLODHeader		*lodHeader=nullptr;
+	const ImageHeader		*header=nullptr;
+	const ImageLODHeader	*lodHeader=nullptr;
 	
-	BYTE				*lstream = stream;
+	const BYTE				*lstream = stream;
 	imageSize = 0;
 
 	try
 	{
-		header = (ImageHeader*) lstream;
+		header = (const ImageHeader*) lstream;
 		imageSize += sizeof(ImageHeader);
 
 		if (header->size <= 0 || header->height <= 0 || header->width <= 0)		
-			throw std::exception(" empty texture !" );
+			throw std::runtime_error(" empty texture !" );
 		
 		// skip main image
 		imageSize += sizeof(BYTE) * header->size;
@@ -71,7 +72,7 @@ int CalculateImageSize( BYTE *stream, size_t &imageSize )
 		for (int i=0; i<header->numberOfLODs; ++i)
 		{
 			lstream = stream + imageSize;
-			lodHeader = (ImageLODHeader*) lstream;
+			lodHeader = (const ImageLODHeader*) lstream;
 
 			imageSize += sizeof(ImageLODHeader);
 			imageSize += sizeof(BYTE) * lodHeader->size;
@@ -90,15 +91,15 @@ int CalculateImageSize( BYTE *stream, size_t &imageSize )
 }
 
 // calculate size for the second file version
-int CalculateImageSize2( BYTE *stream, size_t &imageSize )
+int CalculateImageSize2( const BYTE *stream, size_t &imageSize )
 {
 	// retrieve a header
-	BYTE					*imageType=nullptr;
-	ImageHeader2			*header=nullptr;
-	ImageLODHeader2			*lodHeader=nullptr;
-	ImageSequenceHeader2	*seqHeader=nullptr;
+	const BYTE					*imageType=nullptr;
+	const ImageHeader2			*header=nullptr;
+	const ImageLODHeader2		*lodHeader=nullptr;
+	const ImageSequenceHeader2	*seqHeader=nullptr;
 	
-	BYTE				*lstream = stream;
+	const BYTE					*lstream = stream;
 	
 	imageSize = 0;
 	
@@ -110,7 +111,7 @@ int CalculateImageSize2( BYTE *stream, size_t &imageSize )
 		if (*imageType == IMAGE_TYPE_SEQUENCE)
 		{
 			lstream = stream + imageSize;
-			seqHeader = (ImageSequenceHeader2*) lstream;
+			seqHeader = (const ImageSequenceHeader2*) lstream;
 			
 			// total size for storing all sequence information
 			imageSize += sizeof(ImageSequenceHeader2);
@@ -119,11 +120,11 @@ int CalculateImageSize2( BYTE *stream, size_t &imageSize )
 		else if (*imageType == IMAGE_TYPE_STILL)
 		{
 			lstream = stream + imageSize;
-			header = (ImageHeader2*) lstream;
+			header = (const ImageHeader2*) lstream;
 			imageSize += sizeof(ImageHeader2);
 
 			if (header->size <= 0 || header->height <= 0 || header->width <= 0)		
-				throw std::exception(" empty texture !" );
+				throw std::runtime_error(" empty texture !" );
 		
 			// skip main image
 			imageSize += sizeof(BYTE) * header->size;
@@ -132,7 +133,7 @@ int CalculateImageSize2( BYTE *stream, size_t &imageSize )
 			for (int i=1; i<header->numberOfLODs; ++i)
 			{
 				lstream = stream + imageSize;
-				lodHeader = (ImageLODHeader2*) lstream;
+				lodHeader = (const ImageLODHeader2*) lstream;
 
 				imageSize += sizeof(ImageLODHeader2);
 				imageSize += sizeof(BYTE) * lodHeader->size;
@@ -155,103 +156,74 @@ void ConvertImageHeader( ImageHeader &src, ImageHeader2 &dst )
 	ImageHeader2::Set( src.width, src.height, src.internalFormat, src.format, src.size, 0, src.numberOfLODs, dst );
 }
 
-size_t CalculateSamplerSize( BYTE *stream )
+size_t CalculateSamplerSize( const BYTE *stream )
 {
 	return sizeof(SamplerHeader);
 }
 
-#define SAFE_CALL(_POINTER, _METHOD) \
-	if (_POINTER) { _METHOD; }
-
-bool CGPUCacheLoader::ReadTextures(const char *textures_filename, TiXmlElement *parentElem)
+size_t CalculateGeometryPackSize( const BYTE *data )
 {
+	if (data == nullptr)
+		return 0;
 
-	TiXmlAttribute  *attrib = nullptr;
-	int xmlNumberOfTextures = 0;
+	const FileGeometryHeader *pHeader = (const FileGeometryHeader*) data;
+	size_t packSize = sizeof(FileGeometryHeader);
 
-	// enumerate attribs and find name for each sampler !
-	for( attrib = parentElem->FirstAttribute();
-			attrib;
-			attrib = attrib->Next() )
+	const VertexDataHeader *pVertexHeader = (const VertexDataHeader*) (data + sizeof(FileGeometryHeader));
+	for (int i=0; i<pHeader->numberOfModels; ++i)
 	{
-		if ( strcmp(attrib->Name(), "count") == 0 )
-		{
-			xmlNumberOfTextures = attrib->IntValue();
-			
-		}
+		packSize = (size_t) pVertexHeader->endOffset;
+		pVertexHeader = (const VertexDataHeader*) (data + pVertexHeader->endOffset);
 	}
 
-	//
-	if (xmlNumberOfTextures == 0)
-		return true;
-
-	//
-	// read texture names
-	std::vector<std::string>	names;
-	std::vector<std::string>	filenames;
-	names.resize(xmlNumberOfTextures);
-	filenames.resize(xmlNumberOfTextures);
-
-	TiXmlElement *texelem = parentElem->FirstChildElement( "Texture" );
+	return packSize;
+}
 
-	int index=0;
-	while(texelem)
-	{
+#define SAFE_CALL(_POINTER, _METHOD) \
+	if (_POINTER) { _METHOD; }
 
-		// enumerate attribs
-		for( attrib = texelem->FirstAttribute();
-				attrib;
-				attrib = attrib->Next() )
-		{
-			if ( strcmp(attrib->Name(), "name") == 0 )
-			{
-				names[index] = attrib->Value();
-			}
-			else if (strcmp(attrib->Name(), "filename") == 0)
-			{
-				filenames[index] = attrib->Value();
-			}
-		}
+bool CGPUCacheLoader::ReadTextures(const char *textures_filename, const CGPUCacheManifest &manifest, const std::vector<bool> *usedSamplers)
+{
+	const std::vector<ManifestTexture> &textures = manifest.GetTextures();
 
-		index++;
-		texelem = texelem->NextSiblingElement();
-	}
+	//
+	if (textures.size() == 0)
+		return true;
 
 	// 2 - for each texture read it's content in textures package
-	int fh = 0;
-
-	fh = _open( textures_filename, _O_BINARY | _O_RDONLY, 0 );
+	//	the pack is mapped into memory, visitor gets pointers straight into the mapped view
+	CFileMapping	&fileMapping = mTexturesMapping;
 
 	try
 	{
-		if (fh == -1)
-			throw std::exception("FAILED to read textures package!");
+		if (false == fileMapping.Open(textures_filename, mUseFileMapping) )
+			throw std::runtime_error("FAILED to read textures package!");
 
-		_lseeki64( fh, 0, SEEK_END );
-		size_t		totalFileSize = _telli64(fh);
+		const BYTE	*fileCache = fileMapping.GetData();
 		size_t		totalFilePos = 0;
 
-		// pre-cache all images pack into memory
-
-		std::vector<BYTE>	fileCache(totalFileSize);
+		if (fileMapping.GetSize() < sizeof(FileTexturesHeader) )
+			throw std::runtime_error("CORRUPTED FILE FORMAT");
 
-		if (fileCache.size() == 0)
-			throw std::exception( "NOT ENOUGH MEMORY FOR READING TEXTURES" );
+		// read global pack header
+		const FileTexturesHeader	*fileHeader = (const FileTexturesHeader*) fileCache;
+		
+		if (fileHeader->imagesOffset == 0 || fileHeader->samplersOffset == 0)
+			throw std::runtime_error("CORRUPTED FILE FORMAT");
 
-		_lseeki64( fh, 0, SEEK_SET );
-		SAFE_READ( fh, fileCache.data(), sizeof(BYTE)*totalFileSize );
+		// content digests of the image records
+		const uint64_t *digests = nullptr;
 
-		if (fh > 0) 
+		if (fileHeader->version >= TEXTURES_FILE_VERSION_3)
 		{
-			_close(fh);
-			fh = 0;
-		}
+			const FileTexturesHeader3 *fileHeader3 = (const FileTexturesHeader3*) fileCache;
 
-		// read global pack header
-		FileTexturesHeader	*fileHeader = (FileTexturesHeader*) fileCache.data();
-		
-		if (fileHeader->imagesOffset == 0 || fileHeader->samplersOffset == 0)
-			throw std::exception("CORRUPTED FILE FORMAT");
+			if (fileMapping.GetSize() < sizeof(FileTexturesHeader3) || fileHeader3->digestsOffset <= 0 
+				|| (size_t) fileHeader3->digestsOffset + sizeof(uint64_t) * fileHeader->numberOfImages > fileMapping.GetSize() )
+				throw std::runtime_error("CORRUPTED FILE FORMAT");
+
+			digests = (const uint64_t*) (fileCache + fileHeader3->digestsOffset);
+		}
 
 		//
 		bool proceed = false;
@@ -264,6 +236,35 @@ bool CGPUCacheLoader::ReadTextures(const char *textures_filename, TiXmlElement *
 			return true;
 		}
 
+		// partial loading - find images of the used samplers, jump to them with the table of contents
+		const FileTocEntry	*toc = nullptr;
+		std::vector<bool>	usedImages;
+
+		if (usedSamplers)
+		{
+			int numberOfEntries = 0;
+			toc = FindToc( fileMapping, numberOfEntries );
+
+			if (toc == nullptr || numberOfEntries != fileHeader->numberOfImages)
+				throw std::runtime_error("textures package doesn't have a table of contents");
+
+			usedImages.resize( fileHeader->numberOfImages, false );
+
+			for (int i=0; i<fileHeader->numberOfSamplers && i<(int) usedSamplers->size(); ++i)
+			{
+				if (false == (*usedSamplers)[i])
+					continue;
+
+				const size_t samplerOffset = (size_t) fileHeader->samplersOffset + sizeof(SamplerHeader) * i;
+				if (samplerOffset + sizeof(SamplerHeader) > fileMapping.GetSize() )
+					throw std::runtime_error("CORRUPTED FILE FORMAT");
+
+				const int videoIndex = ((const SamplerHeader*) (fileCache + samplerOffset))->videoIndex;
+				if (videoIndex >= 0 && videoIndex < fileHeader->numberOfImages)
+					usedImages[videoIndex] = true;
+			}
+		}
+
 		// 2 - load image data
 
 		totalFilePos = fileHeader->imagesOffset;
@@ -275,20 +276,31 @@ bool CGPUCacheLoader::ReadTextures(const char *textures_filename, TiXmlElement *
 		int successImages = 0;
 		for (int i=0; i<fileHeader->numberOfImages; ++i)
 		{
-			ImageHeader		*imageHeader1=nullptr;
-			ImageHeader2	*imageHeader2=nullptr;
+			const ImageHeader		*imageHeader1=nullptr;
+			const ImageHeader2		*imageHeader2=nullptr;
 			size_t imageSize = 0;
 
 #if LOADER_LOG_PRINTF <= LOG_LEVEL_INFO
 			printf ("process image %d\n", i );
 #endif
-			fileOffset = totalFilePos;
+			fileOffset = (toc) ? (size_t) toc[i].offset : totalFilePos;
+			totalFilePos = fileOffset;
+
+			if (toc && false == usedImages[i])
+			{
+				if (mVisitor)
+					mVisitor->OnReadEmptyImage();
+				continue;
+			}
+
+			if (toc && (toc[i].offset < (int64_t) sizeof(FileTexturesHeader) || (size_t) (toc[i].offset + toc[i].size) > fileMapping.GetSize()) )
+				throw std::runtime_error("CORRUPTED FILE FORMAT");
 
 			switch(fileHeader->version)
 			{
 			case 1:
 
-				if (0 == CalculateImageSize( fileCache.data() + fileOffset, imageSize ) )
+				if (0 == CalculateImageSize( fileCache + fileOffset, imageSize ) )
 				{
 					totalFilePos += imageSize;
 
@@ -299,17 +311,18 @@ bool CGPUCacheLoader::ReadTextures(const char *textures_filename, TiXmlElement *
 
 				// read full image data
 				totalFilePos += imageSize;
-				imageHeader1 = (ImageHeader*) (fileCache.data() + fileOffset);
+				imageHeader1 = (const ImageHeader*) (fileCache + fileOffset);
 				
 				if (mVisitor)
-					mVisitor->OnReadTexturesImage1( imageHeader1, fileOffset, imageSize, fileCache.data()+fileOffset );
+					mVisitor->OnReadTexturesImage1( imageHeader1, fileOffset, imageSize, fileCache+fileOffset );
 
 				//
 				successImages++;
 				break;
-			case 2:
+			case TEXTURES_FILE_VERSION_2:
+			case TEXTURES_FILE_VERSION_3:
 
-				if (0 == CalculateImageSize2( fileCache.data() + fileOffset, imageSize ) )
+				if (0 == CalculateImageSize2( fileCache + fileOffset, imageSize ) )
 				{
 					totalFilePos += imageSize;
 
@@ -320,11 +333,14 @@ bool CGPUCacheLoader::ReadTextures(const char *textures_filename, TiXmlElement *
 
 				// read full image data
 				totalFilePos += imageSize;	
-				imageHeader2 = (ImageHeader2*) (fileCache.data()+sizeof(BYTE)+fileOffset);
+				imageHeader2 = (const ImageHeader2*) (fileCache+sizeof(BYTE)+fileOffset);
 			
 				if (mVisitor)
 				{
-					BYTE *poffset = fileCache.data()+fileOffset;
+					if (digests)
+						mVisitor->OnReadTexturesDigest( i, digests[i] );
+
+					const BYTE *poffset = fileCache+fileOffset;
 					mVisitor->OnReadTexturesImage2( *poffset, imageHeader2, fileOffset, imageSize, poffset );
 				}
 
@@ -339,7 +355,7 @@ bool CGPUCacheLoader::ReadTextures(const char *textures_filename, TiXmlElement *
 
 		//
 		// 3 - load samplers
-		SamplerHeader	*samplerHeader = nullptr;
+		const SamplerHeader	*samplerHeader = nullptr;
 		size_t			samplerSize = 0;
 
 		totalFilePos = fileHeader->samplersOffset;
@@ -347,17 +363,20 @@ bool CGPUCacheLoader::ReadTextures(const char *textures_filename, TiXmlElement *
 		for (int i=0; i<fileHeader->numberOfSamplers; ++i)
 		{
 			fileOffset = totalFilePos;
-			samplerSize = CalculateSamplerSize( fileCache.data() + fileOffset );
+			samplerSize = CalculateSamplerSize( fileCache + fileOffset );
 
 			if (samplerSize == 0)
 				break;
 
 			// read full image data
 			totalFilePos += samplerSize;
-			samplerHeader = (SamplerHeader*) (fileCache.data() + fileOffset);
+			samplerHeader = (const SamplerHeader*) (fileCache + fileOffset);
 				
+			const char *samplerName = (i < (int) textures.size()) ? manifest.GetString(textures[i].name) : "";
+			const char *samplerFile = (i < (int) textures.size()) ? manifest.GetString(textures[i].filename) : "";
+
 			if (mVisitor)
-				mVisitor->OnReadTexturesSampler( names[i].c_str(), filenames[i].c_str(), samplerHeader, fileOffset, samplerSize, fileCache.data()+fileOffset );
+				mVisitor->OnReadTexturesSampler( samplerName, samplerFile, samplerHeader, fileOffset, samplerSize, fileCache+fileOffset );
 		}
 	}
 	catch (std::exception &e)
@@ -366,17 +385,12 @@ bool CGPUCacheLoader::ReadTextures(const char *textures_filename, TiXmlElement *
 		printf("ERROR in reading textures = %s\n", e.what() );
 #endif
 
-		if (fh > 0) _close(fh);
-
 		if (mVisitor)
 			mVisitor->OnReadTexturesError( e.what() );
 
 		return false;
 	}
 
-	if (fh > 0) 
-		_close(fh);
-
 	if (mVisitor)
 		mVisitor->OnReadTexturesEnd();
 
@@ -384,314 +398,56 @@ bool CGPUCacheLoader::ReadTextures(const char *textures_filename, TiXmlElement *
 }
 
 
-void CGPUCacheLoader::EmptyMaterial( MaterialGLSL &mat )
-{
-	memset( &mat, 0, sizeof(MaterialGLSL) );
-}
-
-void CGPUCacheLoader::ConstructMaterialFromXML( TiXmlElement *matelem, MaterialGLSL &mat )
-{
-	TiXmlAttribute  *attrib = nullptr;
-	TiXmlElement	*diffuse = nullptr;
-
-	EmptyMaterial( mat );
-	
-	diffuse = matelem->FirstChildElement( "Diffuse" );
-	if (diffuse)
-	{
-		// enumerate attribs
-		for( attrib = diffuse->FirstAttribute();
-				attrib;
-				attrib = attrib->Next() )
-		{
-			if ( strcmp(attrib->Name(), "r") == 0 )
-			{
-				mat.diffuseColor[0] = (float) attrib->DoubleValue();
-			}
-			else if ( strcmp(attrib->Name(), "g") == 0 )
-			{
-				mat.diffuseColor[1] = (float) attrib->DoubleValue();
-			}
-			else if ( strcmp(attrib->Name(), "b") == 0 )
-			{
-				mat.diffuseColor[2] = (float) attrib->DoubleValue();
-			}
-			else if ( strcmp(attrib->Name(), "factor") == 0 )
-			{
-				mat.diffuseColor[3] = (float) attrib->DoubleValue();
-			}
-			else if ( strcmp(attrib->Name(), "mapId") == 0 )
-			{
-				mat.diffuse = attrib->IntValue();
-				mat.useDiffuse = (mat.diffuse >= 0) ? 1.0f : 0.0f;
-			}
-		}
-	}
-}
-
-bool CGPUCacheLoader::ReadMaterials(TiXmlElement *parentElem)
+bool CGPUCacheLoader::ReadMaterials(const CGPUCacheManifest &manifest)
 {
 	if (mVisitor == nullptr)
 	{
 		return false;
 	}
 
-	TiXmlAttribute  *attrib = nullptr;
-	int numberOfMaterials = 0;
+	const std::vector<ManifestMaterial> &materials = manifest.GetMaterials();
 
-	// enumerate attribs
-	for( attrib = parentElem->FirstAttribute();
-			attrib;
-			attrib = attrib->Next() )
-	{
-		if ( strcmp(attrib->Name(), "count") == 0 )
-		{
-			numberOfMaterials = attrib->IntValue();
-		}
-	}
-
-	if (numberOfMaterials == 0)
+	if (materials.size() == 0)
 		return true;
 
-	bool proceed = mVisitor->OnReadMaterialsBegin(numberOfMaterials);
+	bool proceed = mVisitor->OnReadMaterialsBegin( (int) materials.size() );
 
 	if (proceed == false)
 		return true;
 
-	TiXmlElement *matelem = parentElem->FirstChildElement( "Material" );
-
 	MaterialGLSL	materialData;
-	std::string		materialName("");
-	bool			catchname = false;
 
-	while(matelem)
+	for (auto iter=begin(materials); iter!=end(materials); ++iter)
 	{
-		catchname = false;
-		ConstructMaterialFromXML( matelem, materialData );
-
-		// enumerate attribs
-		for( attrib = matelem->FirstAttribute();
-				attrib;
-				attrib = attrib->Next() )
-		{
-			if ( strcmp(attrib->Name(), "name") == 0 )
-			{
-				catchname = true;
-				materialName = attrib->Value();
-			}
-		}
-
-		mVisitor->OnReadMaterial( (catchname) ? materialName.c_str() : "default", materialData );
-
-		matelem = matelem->NextSiblingElement();
+		CGPUCacheManifest::ConstructMaterial( *iter, materialData );
+		mVisitor->OnReadMaterial( manifest.GetString(iter->name), materialData );
 	}
 
-
 	mVisitor->OnReadMaterialsEnd();
 	return true;
 }
-/*
-void ConstructDefaultShader( ShaderGLSL &shader )
-{
-	shader.shadingType = eShadingTypeDynamic;
-	shader.shaderType = eShaderTypeDefault;
-
-	shader.shader1 = -1;
-	shader.shader2 = -1;
-	shader.shader3 = -1;
-	shader.shader4 = -1;
-	shader.shader5 = -1;
-	
-	shader.transparency = 1.0f;
-
-	shader.toonEnabled = 0.0f;
-	shader.toonDistribution = 1.0f;
-	shader.toonShadowPosition = 0.5f;
-	shader.toonSteps = 4.0f;
-
-	shader.customColor = vec4(1.0, 1.0, 1.0, 3.0);
 
-	shader.contrast = 1.0f;
-	shader.saturation = 1.0f;
-	shader.brightness = 1.0f;
-	shader.gamma = 1.0f;
-
-	shader.depthDisplacement = 0.0f;
-}
-*/
-void ConstructShaderFromXML( TiXmlElement *shaderelem, ShaderGLSL &shader )
-{
-	DefaultShader( shader );
-	//ConstructDefaultShader( shader );
-	
-	// enumerate attribs
-	TiXmlAttribute  *attrib = nullptr;
-	for( attrib = shaderelem->FirstAttribute();
-			attrib;
-			attrib = attrib->Next() )
-	{
-		if (strcmp(attrib->Name(), "transparency") == 0)
-		{
-			shader.transparency = (float)attrib->DoubleValue();
-		}
-		else if (strcmp(attrib->Name(), "type") == 0)
-		{
-			shader.shaderType = (EShaderType) attrib->IntValue();
-		}
-	}
-
-	TiXmlElement *shadingElem = shaderelem->FirstChildElement( "Shading" );
-	if (shadingElem)
-	{
-		for( attrib = shadingElem->FirstAttribute();
-			attrib;
-			attrib = attrib->Next() )
-		{
-			if (strcmp(attrib->Name(), "type") == 0)
-			{
-				shader.shadingType = (int) attrib->IntValue();
-			}
-			else if (strcmp(attrib->Name(), "toonEnabled") == 0)
-			{
-				shader.toonEnabled = (float) attrib->IntValue();
-			}
-			else if (strcmp(attrib->Name(), "toonSteps") == 0)
-			{
-				shader.toonSteps = (float) attrib->DoubleValue();
-			}
-			else if (strcmp(attrib->Name(), "toonDistribution") == 0)
-			{
-				shader.toonDistribution = (float) attrib->DoubleValue();
-			}
-			else if (strcmp(attrib->Name(), "toonShadowPosition") == 0)
-			{
-				shader.toonShadowPosition = (float) attrib->DoubleValue();
-			}
-		}
-	}
-
-	TiXmlElement *colorCorrectionElem = shaderelem->FirstChildElement( "ColorCorrection" );
-	if (colorCorrectionElem)
-	{
-		TiXmlElement *customColorElem = colorCorrectionElem->FirstChildElement( "CustomColor" );
-		if (customColorElem)
-		{
-			for( attrib = customColorElem->FirstAttribute();
-				attrib;
-				attrib = attrib->Next() )
-			{
-				if (strcmp(attrib->Name(), "r") == 0)
-				{
-					shader.customColor[0] = (float) attrib->DoubleValue();
-				}
-				else if (strcmp(attrib->Name(), "g") == 0)
-				{
-					shader.customColor[1] = (float) attrib->DoubleValue();
-				}
-				else if (strcmp(attrib->Name(), "b") == 0)
-				{
-					shader.customColor[2] = (float) attrib->DoubleValue();
-				}
-			}
-		}
-
-		for( attrib = colorCorrectionElem->FirstAttribute();
-			attrib;
-			attrib = attrib->Next() )
-		{
-			if (strcmp(attrib->Name(), "blendType") == 0)
-			{
-				shader.customColor[3] = (float) attrib->IntValue();
-			}
-			else if (strcmp(attrib->Name(), "contrast") == 0)
-			{
-				shader.contrast = 1.0f + 0.01f * (float) attrib->DoubleValue();
-			}
-			else if (strcmp(attrib->Name(), "saturation") == 0)
-			{
-				shader.saturation = 1.0f + 0.01f * (float) attrib->DoubleValue();
-			}
-			else if (strcmp(attrib->Name(), "brightness") == 0)
-			{
-				shader.brightness = 1.0f + 0.01f * (float) attrib->DoubleValue();
-			}
-			else if (strcmp(attrib->Name(), "gamma") == 0)
-			{
-				shader.gamma = 0.01f * (float) attrib->DoubleValue();
-			}
-		}
-	}
-
-	shader.applyColorCorrection = 0.0f;
-
-	if ( 3 != (int) shader.customColor[3] )
-		shader.applyColorCorrection = 1.0f;
-	else if (shader.customColor[0] != 1.0f || shader.customColor[1] != 1.0f || shader.customColor[2] != 1.0f)
-		shader.applyColorCorrection = 1.0f;
-	else if (shader.contrast != 1.0f || shader.brightness != 1.0f || shader.saturation != 1.0f)
-		shader.applyColorCorrection = 1.0f;
-}
-
-bool CGPUCacheLoader::ReadShaders(TiXmlElement *parentElem)
+bool CGPUCacheLoader::ReadShaders(const CGPUCacheManifest &manifest)
 {
 	if (mVisitor == nullptr)
 	{
 		return false;
 	}
 
-	TiXmlAttribute  *attrib = nullptr;
-	int numberOfShaders = 0;
-
-	// enumerate attribs
-	for( attrib = parentElem->FirstAttribute();
-			attrib;
-			attrib = attrib->Next() )
-	{
-		if ( strcmp(attrib->Name(), "count") == 0 )
-		{
-			numberOfShaders = attrib->IntValue();
-		}
-	}
+	const std::vector<ManifestShader> &shaders = manifest.GetShaders();
 
-	bool proceed = mVisitor->OnReadShadersBegin(numberOfShaders);
+	bool proceed = mVisitor->OnReadShadersBegin( (int) shaders.size() );
 	if (proceed == false)
 		return true;
 
 	//
 
-	TiXmlElement *shaderelem = parentElem->FirstChildElement( "Shader" );
-
 	ShaderGLSL		shaderdata;
-	std::string		shadername("");
-	int				shaderalpha=0;
-	bool			catchname=false;
 
-	while(shaderelem)
+	for (auto iter=begin(shaders); iter!=end(shaders); ++iter)
 	{
-		catchname = false;
-		shaderalpha = 0;
-		ConstructShaderFromXML( shaderelem, shaderdata );
-
-		// enumerate attribs
-		for( attrib = shaderelem->FirstAttribute();
-				attrib;
-				attrib = attrib->Next() )
-		{
-			if ( strcmp(attrib->Name(), "name") == 0 )
-			{
-				catchname = true;
-				shadername = attrib->Value();
-			}
-			else
-				if ( strcmp(attrib->Name(), "alpha") == 0 )
-				{
-					shaderalpha = attrib->IntValue();
-				}
-		}
-
-		mVisitor->OnReadShader( (catchname) ? shadername.c_str() : "default", shaderalpha, shaderdata);
-		
-		shaderelem = shaderelem->NextSiblingElement();
+		CGPUCacheManifest::ConstructShader( *iter, shaderdata );
+		mVisitor->OnReadShader( manifest.GetString(iter->name), iter->alpha, shaderdata );
 	}
 
 	mVisitor->OnReadShadersEnd();
@@ -699,411 +455,528 @@ bool CGPUCacheLoader::ReadShaders(TiXmlElement *parentElem)
 	return true;
 }
 
-bool CGPUCacheLoader::Load(const char *filename, CGPUCacheLoaderVisitor *pVisitor)
+bool CGPUCacheLoader::ReadManifest(const char *filename, CGPUCacheManifest &manifest)
 {
-	TiXmlDocument	doc;
+	// prefer a binary manifest, old caches have only xml
+	if (manifest.LoadBinary( MakeManifestFilename(filename).c_str() ) )
+		return true;
 
-	TiXmlNode *node = nullptr;
-	TiXmlElement *headerElem = nullptr;
-	TiXmlElement *texturesElem = nullptr;
-	TiXmlElement *materialsElem = nullptr;
-	TiXmlElement *shadersElem = nullptr;
-	TiXmlElement *modelsElem = nullptr;
-	TiXmlAttribute  *attrib = nullptr;
+	return manifest.LoadFromXML( filename );
+}
 
-	std::string sourceFileName("");
+bool CGPUCacheLoader::Load(const char *filename, CGPUCacheLoaderVisitor *pVisitor)
+{
+	CGPUCacheManifest	manifest;
 
 	mVisitor = pVisitor;
 
 	try
 	{
-		if (doc.LoadFile( filename ) == false)
-			throw std::exception( "failed to load cache file" );
-	
-		// get main header attributes
-		node = doc.FirstChild( "Header" );
+		if (false == ReadManifest( filename, manifest ) )
+			throw std::runtime_error( "failed to load cache file" );
 	
-		if (node)
-		{
-			headerElem = node->ToElement();
-
-			if (headerElem)
-			{
-				// enumerate attribs
-				for( attrib = headerElem->FirstAttribute();
-						attrib;
-						attrib = attrib->Next() )
-				{
-					if ( strcmp(attrib->Name(), "filename") == 0 )
-					{
-						sourceFileName = attrib->Value();
-					}
-				}
-			}
-		}
-
 		//
 		if (mVisitor)
-			mVisitor->OnReadHeader(filename, sourceFileName.c_str() );
+			mVisitor->OnReadHeader(filename, manifest.GetSourceFilename() );
 
 		//
 		//
 		
-		node = doc.FirstChild("Textures");
-		if (node == nullptr)
-			throw std::exception("Failed to find Textures group in cache");
+		std::string textures_filename( filename );
 
-		texturesElem = node->ToElement();
-		if (texturesElem)
-		{
-			//
-			std::string textures_filename( filename );
-
-			auto iter = textures_filename.find_last_of( "." );
-			textures_filename.erase( iter );
-			textures_filename.append( "_Textures.pck" );
+		auto iter = textures_filename.find_last_of( "." );
+		textures_filename.erase( iter );
+		textures_filename.append( "_Textures.pck" );
 
-			if (false == ReadTextures( textures_filename.c_str(), texturesElem ) )
-				throw std::exception( "Failed to read textures" );
-		}
+		if (false == ReadTextures( textures_filename.c_str(), manifest ) )
+			throw std::runtime_error( "Failed to read textures" );
 
 		//
 		//
 
-		node = doc.FirstChild("Materials");
-		if (node == nullptr)
-			throw std::exception( "Failed to find materials group in cache" );
-
-		materialsElem = node->ToElement();
-		if (materialsElem)
-		{
-			if (false == ReadMaterials(materialsElem) )
-				throw std::exception( "Failed to read materials" );
-		}
+		if (false == ReadMaterials(manifest) )
+			throw std::runtime_error( "Failed to read materials" );
 
 		//
 		//
 
-		node = doc.FirstChild("Shaders");
-		if (node == nullptr)
-			throw std::exception( "Failed to find shaders group in cache" );
-
-		shadersElem = node->ToElement();
-		if (shadersElem)
-		{
-			ReadShaders( shadersElem );
-		}
+		ReadShaders( manifest );
 		
 		//
 		//
 
-		node = doc.FirstChild("Models");
-		if (node == nullptr)
-			throw std::exception( "failed to find models group in cache" );
+		std::string		geometry_filename( filename );
+
+		iter = geometry_filename.find_last_of( "." );
+		geometry_filename.erase( iter );
+		geometry_filename.append( "_Geometry.pck" );
+
+		if (false == ReadModels( geometry_filename.c_str(), manifest ) )
+			throw std::runtime_error( "failed to load model render from xml" );
+	}
+	catch (const std::exception &e)
+	{
+#if LOADER_LOG_PRINTF <= LOG_LEVEL_ERROR
+		printf ( "%s\n", e.what() );
+#endif
+		Close();
+		return false;
+	}
+
+	Close();
+	return true;
+}
+
+bool CGPUCacheLoader::LoadModels(const char *filename, const int numberOfNames, const char * const *names, CGPUCacheLoaderVisitor *pVisitor)
+{
+	mVisitor = pVisitor;
+
+	if (numberOfNames < 0 || (numberOfNames > 0 && names == nullptr) )
+		return false;
+
+	return LoadPartial( filename, numberOfNames, names, nullptr, nullptr );
+}
+
+bool CGPUCacheLoader::LoadModelsInBox(const char *filename, const double *bmin, const double *bmax, CGPUCacheLoaderVisitor *pVisitor)
+{
+	mVisitor = pVisitor;
+
+	if (bmin == nullptr || bmax == nullptr)
+		return false;
+
+	return LoadPartial( filename, 0, nullptr, bmin, bmax );
+}
+
+const FileTocEntry *CGPUCacheLoader::FindToc(const CFileMapping &mapping, int &numberOfEntries)
+{
+	numberOfEntries = 0;
+
+	const BYTE *data = mapping.GetData();
+	const size_t fileSize = mapping.GetSize();
+
+	if (data == nullptr || fileSize < sizeof(FileTocFooter) )
+		return nullptr;
+
+	const FileTocFooter *footer = (const FileTocFooter*) (data + fileSize - sizeof(FileTocFooter));
+
+	if (footer->tag != CACHE_TOC_TAG || footer->version != CACHE_TOC_VERSION || footer->numberOfEntries < 0 || footer->tocOffset <= 0)
+		return nullptr;
+
+	// entries are followed by the footer
+	if ( (size_t) footer->tocOffset + sizeof(FileTocEntry) * footer->numberOfEntries + sizeof(FileTocFooter) != fileSize)
+		return nullptr;
+
+	numberOfEntries = footer->numberOfEntries;
+	return (const FileTocEntry*) (data + footer->tocOffset);
+}
+
+bool CGPUCacheLoader::LoadPartial(const char *filename, const int numberOfNames, const char * const *names, const double *bmin, const double *bmax)
+{
+	CGPUCacheManifest	manifest;
+
+	try
+	{
+		if (false == ReadManifest( filename, manifest ) )
+			throw std::runtime_error( "failed to load cache file" );
+
+		std::string		geometry_filename( filename );
+
+		auto iter = geometry_filename.find_last_of( "." );
+		geometry_filename.erase( iter );
+		geometry_filename.append( "_Geometry.pck" );
+
+		std::vector<int>	selection;
 
-		modelsElem = node->ToElement();
-		if (modelsElem)
+		if (false == SelectModels( geometry_filename.c_str(), manifest, numberOfNames, names, bmin, bmax, selection ) )
+			throw std::runtime_error( "failed to select models, geometry package doesn't have a table of contents" );
+
+		//
+		if (mVisitor)
+			mVisitor->OnReadHeader(filename, manifest.GetSourceFilename() );
+
+		// samplers which are used by the selected models materials
+
+		const std::vector<ManifestModel>		&models = manifest.GetModels();
+		const std::vector<ManifestPatch>		&patches = manifest.GetPatches();
+		const std::vector<ManifestMaterial>		&materials = manifest.GetMaterials();
+
+		std::vector<bool>	usedSamplers( manifest.GetTextures().size(), false );
+
+		for (auto modelIter=begin(selection); modelIter!=end(selection); ++modelIter)
 		{
-			std::string		geometry_filename( filename );
+			const ManifestModel &model = models[*modelIter];
 
-			auto iter = geometry_filename.find_last_of( "." );
-			geometry_filename.erase( iter );
-			geometry_filename.append( "_Geometry.pck" );
+			for (int i=0; i<model.numberOfPatches; ++i)
+			{
+				const int materialId = patches[model.firstPatch + i].materialId;
+				if (materialId < 0 || materialId >= (int) materials.size() )
+					continue;
 
-			if (false == ReadModels( geometry_filename.c_str(), modelsElem ) )
-				throw std::exception( "failed to load model render from xml" );
+				const int samplerId = materials[materialId].diffuse;
+				if (samplerId >= 0 && samplerId < (int) usedSamplers.size() )
+					usedSamplers[samplerId] = true;
+			}
 		}
 
+		std::string textures_filename( filename );
+
+		iter = textures_filename.find_last_of( "." );
+		textures_filename.erase( iter );
+		textures_filename.append( "_Textures.pck" );
+
+		if (false == ReadTextures( textures_filename.c_str(), manifest, &usedSamplers ) )
+			throw std::runtime_error( "Failed to read textures" );
+
+		//
+		//
+
+		if (false == ReadMaterials(manifest) )
+			throw std::runtime_error( "Failed to read materials" );
+
+		ReadShaders( manifest );
+
+		//
+		//
 
+		if (false == ReadModels( geometry_filename.c_str(), manifest, &selection ) )
+			throw std::runtime_error( "failed to load selected models" );
 	}
 	catch (const std::exception &e)
 	{
 #if LOADER_LOG_PRINTF <= LOG_LEVEL_ERROR
 		printf ( "%s\n", e.what() );
 #endif
+		Close();
 		return false;
 	}
 
+	Close();
 	return true;
 }
 
-void ReadBoundingBoxFromXML(TiXmlElement *elem, double *lmin, double *lmax)
+bool CGPUCacheLoader::SelectModels(const char *geometry_filename, const CGPUCacheManifest &manifest, const int numberOfNames, const char * const *names, 
+		const double *bmin, const double *bmax, std::vector<int> &selection)
 {
-	TiXmlElement *bbElem = elem->FirstChildElement( "BoundingBox" );
-	if (bbElem == nullptr)
+	selection.clear();
+
+	// only the pack footer and the table of contents are touched here
+	if (false == mGeometryMapping.Open(geometry_filename, mUseFileMapping) )
+		return false;
+
+	const std::vector<ManifestModel>	&models = manifest.GetModels();
+
+	int numberOfEntries = 0;
+	const FileTocEntry *toc = FindToc( mGeometryMapping, numberOfEntries );
+
+	if (toc == nullptr || numberOfEntries != (int) models.size() )
 	{
-		return;
+		mGeometryMapping.Close();
+		return false;
 	}
-	// enumerate attribs
-	for( TiXmlAttribute *attrib = bbElem->FirstAttribute();
-			attrib;
-			attrib = attrib->Next() )
+
+	if (names)
 	{
-		if ( strcmp(attrib->Name(), "minx") == 0 )
+		// entries sorted by the name hash
+		std::vector<std::pair<uint64_t, int>>	hashes(numberOfEntries);
+
+		for (int i=0; i<numberOfEntries; ++i)
+			hashes[i] = std::make_pair( toc[i].nameHash, toc[i].index );
+
+		std::sort( begin(hashes), end(hashes) );
+
+		for (int i=0; i<numberOfNames; ++i)
 		{
-			lmin[0] = attrib->DoubleValue();	
+			if (names[i] == nullptr)
+				continue;
+
+			const std::pair<uint64_t, int> key( FileTocEntry::HashName(names[i]), -1 );
+
+			// confirm the name with the manifest, hashes could collide
+			for (auto iter=std::lower_bound(begin(hashes), end(hashes), key); iter!=end(hashes) && iter->first == key.first; ++iter)
+			{
+				if (iter->second >= 0 && iter->second < (int) models.size() 
+					&& 0 == strcmp( manifest.GetString(models[iter->second].name), names[i] ) )
+				{
+					selection.push_back( iter->second );
+				}
+			}
 		}
-		else if ( strcmp(attrib->Name(), "miny") == 0 )
+	}
+	else if (bmin && bmax)
+	{
+		for (int i=0; i<numberOfEntries; ++i)
 		{
-			lmin[1] = attrib->DoubleValue();	
+			const FileTocEntry &entry = toc[i];
+
+			if (entry.index < 0 || entry.index >= (int) models.size() )
+				continue;
+
+			if (entry.boundsMin[0] <= bmax[0] && entry.boundsMax[0] >= bmin[0]
+				&& entry.boundsMin[1] <= bmax[1] && entry.boundsMax[1] >= bmin[1]
+				&& entry.boundsMin[2] <= bmax[2] && entry.boundsMax[2] >= bmin[2] )
+			{
+				selection.push_back( entry.index );
+			}
 		}
-		else if ( strcmp(attrib->Name(), "minz") == 0 )
+	}
+
+	// keep the pack order
+	std::sort( begin(selection), end(selection) );
+	selection.erase( std::unique(begin(selection), end(selection)), end(selection) );
+
+	mGeometryMapping.Close();
+	return true;
+}
+
+bool CGPUCacheLoader::BuildPartialGeometry(const BYTE *geomcache, const std::vector<int> &selection)
+{
+	const FileGeometryHeader *pHeader = (const FileGeometryHeader*) geomcache;
+
+	int numberOfEntries = 0;
+	const FileTocEntry *toc = FindToc( mGeometryMapping, numberOfEntries );
+
+	if (toc == nullptr || numberOfEntries != pHeader->numberOfModels)
+		return false;
+
+	const int64_t recordsEnd = (const BYTE*) toc - geomcache;
+	const bool version3 = (pHeader->version >= GEOMETRY_FILE_VERSION_3);
+	const int64_t minRecordSize = (version3) ? sizeof(VertexDataHeader3) : sizeof(VertexDataHeader);
+
+	auto fn_validEntry = [&] (const int index) -> bool {
+		if (index < 0 || index >= numberOfEntries)
+			return false;
+		const FileTocEntry &entry = toc[index];
+		return (entry.index == index && entry.offset >= (int64_t) sizeof(FileGeometryHeader) 
+			&& entry.size >= minRecordSize && entry.offset + entry.size <= recordsEnd);
+	};
+
+	// record with the streams for each selected model, instance keeps a reference if its source is already in
+	//	the partial pack, otherwise the source record is copied in place of the instance
+	std::vector<int>		sources(selection.size());
+	std::vector<int>		partialIndex(numberOfEntries, -1);	// source record -> partial record with the streams
+	size_t partialSize = sizeof(FileGeometryHeader);
+
+	for (size_t i=0; i<selection.size(); ++i)
+	{
+		const int index = selection[i];
+
+		if (false == fn_validEntry(index) )
+			return false;
+
+		int source = VertexDataHeader3::GetInstanceOf( geomcache, (const VertexDataHeader*) (geomcache + toc[index].offset) );
+		
+		if (source < 0)
+			source = index;
+		else if (source >= index || false == fn_validEntry(source) )
+			return false;
+
+		sources[i] = source;
+
+		if (partialIndex[source] >= 0)
 		{
-			lmin[2] = attrib->DoubleValue();	
+			partialSize += sizeof(VertexDataHeader3);
 		}
-		else if ( strcmp(attrib->Name(), "maxx") == 0 )
+		else
 		{
-			lmax[0] = attrib->DoubleValue();	
+			partialIndex[source] = (int) i;
+			partialSize += (size_t) toc[source].size;
 		}
-		else if ( strcmp(attrib->Name(), "maxy") == 0 )
+	}
+
+	mPartialGeometry.resize( partialSize );
+
+	BYTE *partial = mPartialGeometry.data();
+	int64_t partialOffset = sizeof(FileGeometryHeader);
+
+	std::vector<int64_t>	recordOffsets(selection.size());
+
+	int totalNumberOfVertices = 0;
+	int totalNumberOfIndices = 0;
+
+	for (size_t i=0; i<selection.size(); ++i)
+	{
+		const int source = sources[i];
+		recordOffsets[i] = partialOffset;
+
+		if (partialIndex[source] != (int) i)
 		{
-			lmax[1] = attrib->DoubleValue();	
+			// instance of the record which is already in the partial pack
+			const int sourceIndex = partialIndex[source];
+			VertexDataHeader3 *pVertexHeader = (VertexDataHeader3*) (partial + partialOffset);
+
+			memcpy( pVertexHeader, partial + recordOffsets[sourceIndex], sizeof(VertexDataHeader3) );
+			pVertexHeader->instanceOf = sourceIndex;
+			pVertexHeader->endOffset = partialOffset + sizeof(VertexDataHeader3);
+
+			partialOffset += sizeof(VertexDataHeader3);
+			continue;
 		}
-		else if ( strcmp(attrib->Name(), "maxz") == 0 )
+
+		const FileTocEntry &entry = toc[source];
+
+		memcpy( partial + partialOffset, geomcache + entry.offset, (size_t) entry.size );
+
+		// record offsets are absolute in the pack, move them to the new place
+		VertexDataHeader *pVertexHeader = (VertexDataHeader*) (partial + partialOffset);
+
+		if (pVertexHeader->endOffset != entry.offset + entry.size)
+			return false;
+
+		const int64_t delta = partialOffset - entry.offset;
+
+		pVertexHeader->positionOffset += delta;
+		pVertexHeader->normalOffset += delta;
+		pVertexHeader->tangentOffset += delta;
+		pVertexHeader->uvOffset += delta;
+		pVertexHeader->indicesOffset += delta;
+		pVertexHeader->endOffset += delta;
+
+		if (version3 && ((VertexDataHeader3*) pVertexHeader)->numberOfClusters > 0)
+			((VertexDataHeader3*) pVertexHeader)->clustersOffset += delta;
+
+		if (version3 && ((VertexDataHeader3*) pVertexHeader)->numberOfLods > 0)
 		{
-			lmax[2] = attrib->DoubleValue();	
+			VertexDataHeader3 *pVertexHeader3 = (VertexDataHeader3*) pVertexHeader;
+			pVertexHeader3->lodsOffset += delta;
+
+			if (pVertexHeader3->lodsOffset < partialOffset 
+				|| pVertexHeader3->lodsOffset + pVertexHeader3->numberOfLods * (int64_t) sizeof(MeshLodHeader) > pVertexHeader3->endOffset)
+				return false;
+
+			MeshLodHeader *lods = (MeshLodHeader*) (partial + pVertexHeader3->lodsOffset);
+			for (int j=0; j<pVertexHeader3->numberOfLods; ++j)
+			{
+				lods[j].indicesOffset += delta;
+				lods[j].patchesOffset += delta;
+				totalNumberOfIndices += lods[j].numIndices;
+			}
 		}
+
+		totalNumberOfVertices += pVertexHeader->numVertices;
+		totalNumberOfIndices += pVertexHeader->numIndices;
+
+		partialOffset += entry.size;
 	}
+
+	FileGeometryHeader::Set( pHeader->version, (int) selection.size(), totalNumberOfVertices, totalNumberOfIndices, 
+		*(FileGeometryHeader*) partial );
+
+	return true;
 }
 
-bool CGPUCacheLoader::ReadModels(const char *geometry_filename, TiXmlElement *parentElem)
+bool CGPUCacheLoader::ReadModels(const char *geometry_filename, const CGPUCacheManifest &manifest, const std::vector<int> *selection)
 {
 	if (mVisitor == nullptr)
 	{
 		return false;
 	}
 
-	int numberOfSubModels = 0;
-	int numberOfSubMeshes = 0;
+	const FileManifestHeader				&manifestHeader = manifest.GetHeader();
+	const std::vector<ManifestModel>		&models = manifest.GetModels();
+	const std::vector<ManifestPatch>		&patches = manifest.GetPatches();
+
+	const int numberOfSubModels = (int) models.size();
+	const int numberOfSelected = (selection) ? (int) selection->size() : numberOfSubModels;
+
+	if (numberOfSelected == 0)
+		return true;
 
-	TiXmlAttribute  *attrib = nullptr;
+	int numberOfSubMeshes = manifestHeader.numberOfSubMeshes;
+	double boundingMin[3] = { manifestHeader.boundingMin[0], manifestHeader.boundingMin[1], manifestHeader.boundingMin[2] };
+	double boundingMax[3] = { manifestHeader.boundingMax[0], manifestHeader.boundingMax[1], manifestHeader.boundingMax[2] };
 
-	// enumerate attribs
-	for( attrib = parentElem->FirstAttribute();
-			attrib;
-			attrib = attrib->Next() )
+	if (selection)
 	{
-		if ( strcmp(attrib->Name(), "count") == 0 )
-		{
-			numberOfSubModels = attrib->IntValue();
-		}
-		else
-		if ( strcmp(attrib->Name(), "submeshes") == 0 )
+		// patches and bounding box of the selected models only
+		numberOfSubMeshes = 0;
+
+		for (int i=0; i<numberOfSelected; ++i)
 		{
-			numberOfSubMeshes = attrib->IntValue();
+			const ManifestModel &model = models[ (*selection)[i] ];
+			numberOfSubMeshes += model.numberOfPatches;
+
+			for (int j=0; j<3; ++j)
+			{
+				boundingMin[j] = (i == 0 || model.boundingMin[j] < boundingMin[j]) ? model.boundingMin[j] : boundingMin[j];
+				boundingMax[j] = (i == 0 || model.boundingMax[j] > boundingMax[j]) ? model.boundingMax[j] : boundingMax[j];
+			}
 		}
 	}
 
-	if (numberOfSubModels == 0)
-		return true;
-
-	double bmin[3] = {0.0, 0.0, 0.0};
-	double bmax[3] = {0.0, 0.0, 0.0};
-
-	ReadBoundingBoxFromXML( parentElem, bmin, bmax );
-	
-	bool proceed = mVisitor->OnReadModelsBegin( numberOfSubModels, numberOfSubMeshes, bmin, bmax );
+	bool proceed = mVisitor->OnReadModelsBegin( numberOfSelected, numberOfSubMeshes, boundingMin, boundingMax );
 
 	if (proceed == false)
 		return true;
 
 	// DONE: load models
-	FILE *fp = nullptr;
+	//	map the geometry pack, vertex data is passed to the visitor without an extra copy
+	CFileMapping	&fileMapping = mGeometryMapping;
 
 	try
 	{
+		if (false == fileMapping.Open(geometry_filename, mUseFileMapping) )
+			throw std::runtime_error( "failed to read geometry package" );
 
-		errno_t err = fopen_s( &fp, geometry_filename, "rb" );
-		if (err != 0)
-			throw std::exception( "failed to read geometry package" );
-			
-		_fseeki64(fp, 0, SEEK_END);
-		__int64 fileLen = _ftelli64(fp);
-
-		if (fileLen == 0)
-			throw std::exception( "geometry file length is zero!" );
-			
-		std::vector<BYTE>	geomcache(fileLen);
+		if (fileMapping.GetSize() < sizeof(FileGeometryHeader) )
+			throw std::runtime_error( "geometry file length is zero!" );
 
-		if (geomcache.size() == 0)
-			throw std::exception( "not enough memory for the geom file" );
-			
-		_fseeki64(fp, 0, SEEK_SET);
-		if (fileLen != fread_s( geomcache.data(), fileLen, sizeof(BYTE), fileLen, fp ) )
-			throw std::exception( "failed to read all geom file data!" );
-			
-		if (fp) fclose(fp);
+		const BYTE *geomcache = (const BYTE*) fileMapping.GetData();
 
 		//
-		// !!! check if package has the same number of models with xml
+		// !!! check if package has the same number of models with manifest
 
-		FileGeometryHeader *pHeader = (FileGeometryHeader*) geomcache.data();
+		const FileGeometryHeader *pHeader = (const FileGeometryHeader*) geomcache;
 
 		if (pHeader->numberOfModels != numberOfSubModels)
-			throw std::exception( "geometry package is not conform the xml information" );
-
-		mVisitor->OnReadVertexData( pHeader, geomcache.data() );
-
-		//
-		//
-
-		TiXmlElement *shaders = nullptr;
-		TiXmlElement *shaderElem = nullptr;
-		TiXmlElement *patches = nullptr;
-		TiXmlElement *patchElem = nullptr;
-		TiXmlElement *modelElem = nullptr;
-		TiXmlElement *tElem, *rElem, *sElem;
-
-		VertexDataHeader *pVertexHeader = (VertexDataHeader*) (geomcache.data() + sizeof(FileGeometryHeader));
-
-		
-		std::string						modelname("");
-		bool							catchname = false;
+			throw std::runtime_error( "geometry package is not conform the xml information" );
 
-		double tr[3];
-		double rt[3];
-		double scl[3];
-
-		modelElem = parentElem->FirstChildElement( "Model" );
-		while( modelElem )
+		if (selection)
 		{
-			catchname = false;
-
-			// enumerate attribs
-			for( attrib = modelElem->FirstAttribute();
-					attrib;
-					attrib = attrib->Next() )
-			{
-				if ( strcmp(attrib->Name(), "name") == 0 )
-				{
-					modelname = attrib->Value();
-					catchname = true;
-				}
-			}
+			// a smaller pack with the selected records, visitor reads it as a whole one
+			if (false == BuildPartialGeometry( geomcache, *selection ) )
+				throw std::runtime_error( "failed to read selected models from the geometry package" );
 
-			tElem = modelElem->FirstChildElement( "Translation" );
-			rElem = modelElem->FirstChildElement( "Rotation" );
-			sElem = modelElem->FirstChildElement( "Scaling" );
-
-			auto read_vector_func = [] (TiXmlElement *elem, double *values)
-			{
-				if (elem)
-				{
-					for( TiXmlAttribute *attrib = elem->FirstAttribute();
-					attrib;
-					attrib = attrib->Next() )
-					{
-						if ( strcmp(attrib->Name(), "x") == 0 ) values[0] = attrib->DoubleValue();
-						else if ( strcmp(attrib->Name(), "y") == 0 ) values[1] = attrib->DoubleValue();
-						else if ( strcmp(attrib->Name(), "z") == 0 ) values[2] = attrib->DoubleValue();
-					}
-				}
-			};
+			geomcache = mPartialGeometry.data();
+			pHeader = (const FileGeometryHeader*) geomcache;
+		}
 
-			read_vector_func( tElem, tr );
-			read_vector_func( rElem, rt );
-			read_vector_func( sElem, scl );
+		mVisitor->OnPrepareVertexData( pHeader, geomcache );
+		mVisitor->OnReadVertexData( pHeader, geomcache );
 
-			// read bb and compute bsphere
-			ReadBoundingBoxFromXML(modelElem, bmin, bmax);
+		//
+		//
 
-			// read shaders used by the model
-			
-			int	shaderCount = 0;
-			int shaderId[MAX_NUMBER_OF_SHADERS_PER_MODEL] = {-1, -1, -1, -1, -1};
+		const VertexDataHeader *pVertexHeader = (const VertexDataHeader*) (geomcache + sizeof(FileGeometryHeader));
 
-			shaders = modelElem->FirstChildElement( "Shaders" );
-			if (shaders)
-			{
-				shaderElem = shaders->FirstChildElement( "Shader" );
+		for (int n=0; n<numberOfSelected; ++n)
+		{
+			const ManifestModel &model = models[ (selection) ? (*selection)[n] : n ];
 
-				while(shaderElem)
-				{
-					// enumerate attribs
-					for( attrib = shaderElem->FirstAttribute();
-							attrib;
-							attrib = attrib->Next() )
-					{
-						if ( strcmp(attrib->Name(), "shaderId") == 0 )
-						{
-							shaderId[shaderCount] = attrib->IntValue();
-							
-							// TODO: check why I've commented that before ?!
-							shaderId[shaderCount] += 1;	// we have one default shader at the beginning
-
-							shaderCount++;
-							if (shaderCount >= MAX_NUMBER_OF_SHADERS_PER_MODEL)
-							{
-#if LOADER_LOG_PRINTF <= LOG_LEVEL_ERROR
-								printf("ERROR: so many shaders per model is not supported!");
-#endif
-								shaderCount=MAX_NUMBER_OF_SHADERS_PER_MODEL-1;
-							}
-						}
-					
-					}
-					shaderElem = shaderElem->NextSiblingElement("Shader");
-				}
-			}
-	
 			//
-			mVisitor->OnReadModel( (catchname) ? modelname.c_str() : "default", 
-									tr, 
-									rt, 
-									scl, 
-									bmin, 
-									bmax, 
-									shaderCount, 
-									shaderId, 
+			mVisitor->OnReadModel( manifest.GetString(model.name), 
+									model.translation, 
+									model.rotation, 
+									model.scaling, 
+									model.boundingMin, 
+									model.boundingMax, 
+									model.numberOfShaders, 
+									model.shaders, 
 									pVertexHeader, 
-									geomcache.data() );
+									geomcache );
 
 			//
 			// read patch inside the model
 
-			patches = modelElem->FirstChildElement( "Patches" );
-			if (patches)
+			for (int i=0; i<model.numberOfPatches; ++i)
 			{
-				patchElem = patches->FirstChildElement( "Patch" );
-
-				int offset=0, size=0, matId=0;
-			
-				while(patchElem)
-				{
-					// enumerate attribs
-					for( attrib = patchElem->FirstAttribute();
-							attrib;
-							attrib = attrib->Next() )
-					{
-						if ( strcmp(attrib->Name(), "offset") == 0 )
-						{
-							offset = attrib->IntValue();
-						}
-						else
-						if ( strcmp(attrib->Name(), "size") == 0 )
-						{
-							size = attrib->IntValue();
-						}
-						else
-						if ( strcmp(attrib->Name(), "materialId") == 0 )
-						{
-							matId = attrib->IntValue();
-						}
-					}
-
-					mVisitor->OnReadModelPatch( offset, size, matId );
-
-					patchElem = patchElem->NextSiblingElement("Patch");
-				}
-
+				const ManifestPatch &patch = patches[model.firstPatch + i];
+				mVisitor->OnReadModelPatch( patch.offset, patch.size, patch.materialId );
 			}
 
 			mVisitor->OnReadModelFinish();
 		
 			// go to next model
-			pVertexHeader = (VertexDataHeader*) (geomcache.data() + pVertexHeader->endOffset);
-
-			modelElem = modelElem->NextSiblingElement("Model");
+			pVertexHeader = (const VertexDataHeader*) (geomcache + pVertexHeader->endOffset);
 		}
 
 		mVisitor->OnReadModelsEnd();
@@ -1117,4 +990,4 @@ bool CGPUCacheLoader::ReadModels(const char *geometry_filename, TiXmlElement *pa
 	}
 
 	return true;
-}
\ No newline at end of file
+}
@@ -16,12 +16,18 @@
 #include "gpucache_types.h"
 #include "shared_glsl.h"
 
-#include "IO\tinyxml.h"
+#include "gpucache_manifest.h"
+#include "IO/FileMapping.h"
 
+#include <vector>
 
+struct VertexMergeStaging;	// see gpucache_vertexMerge.h
 
 ///////////////////////////////////////////////////////////////////////////
 //
+//	NOTE: image and vertex data pointers point into the mapped pack file,
+//		they are valid only until the loader returns, copy the data if you need it later
+
 class CGPUCacheLoaderVisitor
 {
 public:
@@ -40,6 +46,9 @@ public:
 	virtual void OnReadTexturesImage1(const ImageHeader *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) = 0;
 	virtual void OnReadTexturesImage2(const BYTE type, const ImageHeader2 *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) = 0;
 	virtual void OnReadEmptyImage() = 0;
+	// packs with the content digests (textures version 3), called right before OnReadTexturesImage2
+	virtual void OnReadTexturesDigest(const int imageIndex, const uint64_t digest)
+	{}
 	virtual void OnReadTexturesSampler(const char *samplerName, const char *clipFile, const SamplerHeader *header, const size_t fileSamplerOffset, const size_t samplerSize, const BYTE *samplerData) = 0;
 	virtual void OnReadTexturesError(const char *what) = 0;
 	virtual void OnReadTexturesEnd() = 0;
@@ -55,7 +64,18 @@ public:
 
 	// geometry, models
 	virtual bool OnReadModelsBegin(const int numberOfModels, const int numberOfMeshes, const double *bounding_min, const double *bounding_max) = 0;
-	virtual void OnReadVertexData( FileGeometryHeader *const pHeader, const BYTE *data ) = 0;
+	// NOTE: called right before OnReadVertexData, use it for a cpu only work (no gl calls here !)
+	//	it's not called when OnReadModelsBegin returns false
+	virtual void OnPrepareVertexData( const FileGeometryHeader *pHeader, const BYTE *data )
+	{}
+	// pipelined loader merges positions, normals and indices in a worker as soon as the pack is mapped,
+	//	the staging arrays are handed here right before OnReadVertexData (swap them to keep), instead of OnPrepareVertexData
+	//	staging is empty when the merge has failed, it's dropped when OnReadModelsBegin returns false
+	virtual void OnTakeMergedVertexData( const FileGeometryHeader *pHeader, const BYTE *data, VertexMergeStaging &staging )
+	{
+		OnPrepareVertexData(pHeader, data);
+	}
+	virtual void OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) = 0;
 
 	// NOTE: data is a global vertex data, GET from pheader local model segment
 	virtual void OnReadModel(const char *name, 
@@ -73,6 +93,12 @@ public:
 	virtual void OnReadModelsEnd() = 0;
 };
 
+// size of a geometry pack data, walk over all vertex data headers
+size_t CalculateGeometryPackSize( const BYTE *data );
+
+// size of an image record in the textures pack version 2 or 3, returns 0 for an empty record (imageSize is still valid)
+int CalculateImageSize2( const BYTE *stream, size_t &imageSize );
+
 ///////////////////////////////////////////////////////////////////////////
 //
 
@@ -85,23 +111,58 @@ public:
 
 	bool Load(const char *filename, CGPUCacheLoaderVisitor *pVisitor);
 
+	// partial loading, packs have to be saved with a table of contents (see FileTocEntry)
+	//	only selected model records and images used by their materials are read from the packs,
+	//	other images are passed as empty ones to keep the sampler indices
+	bool LoadModels(const char *filename, const int numberOfNames, const char * const *names, CGPUCacheLoaderVisitor *pVisitor);
+	// models which bounding boxes intersect a query box
+	bool LoadModelsInBox(const char *filename, const double *bmin, const double *bmax, CGPUCacheLoaderVisitor *pVisitor);
+
+	// release mapped packs, visitor data pointers are not valid after that
+	void Close();
+
+	// false - packs are read into the heap buffers instead of the mapped views
+	void SetUseFileMapping(const bool value)
+	{
+		mUseFileMapping = value;
+	}
+
 protected:
 
+	friend class CGPUCacheLoaderPipelined;
+
 	CGPUCacheLoaderVisitor *mVisitor;
 
+	bool					mUseFileMapping;
+	CFileMapping			mTexturesMapping;
+	CFileMapping			mGeometryMapping;
+
+	std::vector<BYTE>		mPartialGeometry;	// geometry pack with the selected model records only
+
 	//
 
-	bool ReadTextures(const char *textures_filename, TiXmlElement *parentElem);
+	// binary manifest if exists, xml otherwise
+	static bool ReadManifest(const char *filename, CGPUCacheManifest &manifest);
+
+	// table of contents from the pack footer, nullptr if the pack doesn't have it
+	static const FileTocEntry *FindToc(const CFileMapping &mapping, int &numberOfEntries);
+
+	// names or a bounding box, selection is a sorted list of manifest model indices
+	bool LoadPartial(const char *filename, const int numberOfNames, const char * const *names, const double *bmin, const double *bmax);
+	bool SelectModels(const char *geometry_filename, const CGPUCacheManifest &manifest, const int numberOfNames, const char * const *names, 
+		const double *bmin, const double *bmax, std::vector<int> &selection);
+	bool BuildPartialGeometry(const BYTE *geomcache, const std::vector<int> &selection);
+
+	// usedSamplers - read only images for these samplers
+	bool ReadTextures(const char *textures_filename, const CGPUCacheManifest &manifest, const std::vector<bool> *usedSamplers=nullptr);
 	bool ReadImageData();
 	bool ReadImageData2();
 	bool ReadSampler();
 
-	bool ReadMaterials(TiXmlElement *parentElem);
-	void EmptyMaterial( MaterialGLSL &mat );
-	void ConstructMaterialFromXML( TiXmlElement *matelem, MaterialGLSL &mat );
-
-	bool ReadShaders(TiXmlElement *parentElem);
+	bool ReadMaterials(const CGPUCacheManifest &manifest);
+	bool ReadShaders(const CGPUCacheManifest &manifest);
 
-	bool ReadModels(const char *models_filename, TiXmlElement *parentElem);
+	// selection - read only these manifest models
+	bool ReadModels(const char *models_filename, const CGPUCacheManifest &manifest, const std::vector<int> *selection=nullptr);
 };
 
@@ -0,0 +1,690 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_loaderPipelined.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_loaderPipelined.h"
+#include "gpucache_vertexMerge.h"
+
+#include <stdio.h>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+///////////////////////////////////
+
+#define LOG_LEVEL_INFO		1
+#define	LOG_LEVEL_WARNING	2
+#define LOG_LEVEL_ERROR		3
+#define LOG_LEVEL_NONE		4
+
+#define LOADER_LOG_PRINTF	3
+
+// read one byte from each page, so the gl thread doesn't wait for a disk
+#define PAGE_TOUCH_STEP		4096
+
+typedef std::chrono::high_resolution_clock	LoaderClock;
+
+static double ElapsedMs( const LoaderClock::time_point &start )
+{
+	return std::chrono::duration<double, std::milli>( LoaderClock::now() - start ).count();
+}
+
+static unsigned int TouchPages( const BYTE *data, const size_t size )
+{
+	unsigned int sum = 0;
+	for (size_t i=0; i<size; i+=PAGE_TOUCH_STEP)
+		sum += data[i];
+
+	if (size > 0)
+		sum += data[size-1];
+
+	return sum;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// one recorded visitor callback
+
+enum ELoaderCommand
+{
+	eLoaderCommandTexturesBegin,
+	eLoaderCommandTexturesImage1,
+	eLoaderCommandTexturesImage2,
+	eLoaderCommandEmptyImage,
+	eLoaderCommandTexturesDigest,
+	eLoaderCommandTexturesSampler,
+	eLoaderCommandTexturesError,
+	eLoaderCommandTexturesEnd,
+	eLoaderCommandMaterialsBegin,
+	eLoaderCommandMaterial,
+	eLoaderCommandMaterialsEnd,
+	eLoaderCommandShadersBegin,
+	eLoaderCommandShader,
+	eLoaderCommandShadersEnd,
+	eLoaderCommandModelsBegin,
+	eLoaderCommandVertexData,
+	eLoaderCommandModel,
+	eLoaderCommandModelPatch,
+	eLoaderCommandModelFinish,
+	eLoaderCommandModelsEnd
+};
+
+struct LoaderCommand
+{
+	ELoaderCommand		type;
+
+	std::string			name;
+	std::string			name2;
+
+	int					values[3];
+	size_t				offset;
+	size_t				size;
+	BYTE				imageType;
+	uint64_t	digest;
+
+	// pointers into the mapped pack
+	const void			*header;
+	const BYTE			*data;
+
+	std::vector<double>	doubles;
+	std::vector<int>	ints;
+	std::vector<BYTE>	blob;	// material or shader glsl data
+
+	LoaderCommand(const ELoaderCommand _type)
+		: type(_type)
+		, offset(0)
+		, size(0)
+		, imageType(0)
+		, digest(0)
+		, header(nullptr)
+		, data(nullptr)
+	{
+		values[0] = values[1] = values[2] = 0;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+// visitor that is used by a worker loader
+//	records callbacks into a queue, the gl thread takes them out and replays on a target visitor
+//	vertex streams are merged by the worker into own staging arrays without waiting for the replayed OnReadModelsBegin,
+//	the target takes them with OnTakeMergedVertexData when it has accepted the models, otherwise they are dropped
+
+class CGPUCacheLoaderVisitorQueue : public CGPUCacheLoaderVisitor
+{
+public:
+
+	//! a constructor
+	CGPUCacheLoaderVisitorQueue(CGPUCacheLoaderVisitor *target)
+		: CGPUCacheLoaderVisitor()
+		, mTarget(target)
+		, mFinished(false)
+		, mNumberOfCommands(0)
+		, mTouchSum(0)
+	{}
+
+	// no more commands from the worker
+	void Finish()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFinished = true;
+		mCondition.notify_all();
+	}
+
+	// replay commands on a target in the calling thread, returns when the worker has finished
+	void Replay(double &stallTime);
+
+	const int GetNumberOfCommands() const
+	{
+		return mNumberOfCommands;
+	}
+
+	// worker merge of the vertex streams, valid after the worker has finished
+	const bool HasMerge() const
+	{
+		return mMergeEnd > mMergeStart;
+	}
+	const LoaderClock::time_point &GetMergeStart() const
+	{
+		return mMergeStart;
+	}
+	const LoaderClock::time_point &GetMergeEnd() const
+	{
+		return mMergeEnd;
+	}
+
+	// main header is processed by the pipeline itself
+	void OnReadHeader(const char *xmlFilename, const char *sourceFilename) override
+	{}
+
+	// textures
+	bool OnReadTexturesBegin( const char *textures_filename, const int numberOfSamplers, const int numberOfImages ) override
+	{
+		LoaderCommand cmd(eLoaderCommandTexturesBegin);
+		cmd.name = textures_filename;
+		cmd.values[0] = numberOfSamplers;
+		cmd.values[1] = numberOfImages;
+		Push(cmd);
+
+		// we don't know the target answer yet, commands are skipped in Replay if needed
+		return true;
+	}
+	void OnReadTexturesImage1(const ImageHeader *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override
+	{
+		mTouchSum += TouchPages(imageData, imageSize);
+
+		LoaderCommand cmd(eLoaderCommandTexturesImage1);
+		cmd.header = header;
+		cmd.offset = fileImageOffset;
+		cmd.size = imageSize;
+		cmd.data = imageData;
+		Push(cmd);
+	}
+	void OnReadTexturesImage2(const BYTE type, const ImageHeader2 *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override
+	{
+		mTouchSum += TouchPages(imageData, imageSize);
+
+		LoaderCommand cmd(eLoaderCommandTexturesImage2);
+		cmd.imageType = type;
+		cmd.header = header;
+		cmd.offset = fileImageOffset;
+		cmd.size = imageSize;
+		cmd.data = imageData;
+		Push(cmd);
+	}
+	void OnReadEmptyImage() override
+	{
+		LoaderCommand cmd(eLoaderCommandEmptyImage);
+		Push(cmd);
+	}
+	void OnReadTexturesDigest(const int imageIndex, const uint64_t digest) override
+	{
+		LoaderCommand cmd(eLoaderCommandTexturesDigest);
+		cmd.values[0] = imageIndex;
+		cmd.digest = digest;
+		Push(cmd);
+	}
+	void OnReadTexturesSampler(const char *samplerName, const char *clipFile, const SamplerHeader *header, const size_t fileSamplerOffset, const size_t samplerSize, const BYTE *samplerData) override
+	{
+		LoaderCommand cmd(eLoaderCommandTexturesSampler);
+		cmd.name = (samplerName) ? samplerName : "";
+		cmd.name2 = (clipFile) ? clipFile : "";
+		cmd.header = header;
+		cmd.offset = fileSamplerOffset;
+		cmd.size = samplerSize;
+		cmd.data = samplerData;
+		Push(cmd);
+	}
+	void OnReadTexturesError(const char *what) override
+	{
+		LoaderCommand cmd(eLoaderCommandTexturesError);
+		cmd.name = what;
+		Push(cmd);
+	}
+	void OnReadTexturesEnd() override
+	{
+		LoaderCommand cmd(eLoaderCommandTexturesEnd);
+		Push(cmd);
+	}
+
+	// materials, shaders, etc.
+	bool OnReadMaterialsBegin(const int numberOfMaterials) override
+	{
+		LoaderCommand cmd(eLoaderCommandMaterialsBegin);
+		cmd.values[0] = numberOfMaterials;
+		Push(cmd);
+		return true;
+	}
+	void OnReadMaterial(const char *material_name, const MaterialGLSL &material ) override
+	{
+		LoaderCommand cmd(eLoaderCommandMaterial);
+		cmd.name = material_name;
+		cmd.blob.resize(sizeof(MaterialGLSL));
+		memcpy( cmd.blob.data(), &material, sizeof(MaterialGLSL) );
+		Push(cmd);
+	}
+	void OnReadMaterialsEnd() override
+	{
+		LoaderCommand cmd(eLoaderCommandMaterialsEnd);
+		Push(cmd);
+	}
+
+	bool OnReadShadersBegin(const int numberOfShaders) override
+	{
+		LoaderCommand cmd(eLoaderCommandShadersBegin);
+		cmd.values[0] = numberOfShaders;
+		Push(cmd);
+		return true;
+	}
+	void OnReadShader(const char *shader_name, const int alphatype, const ShaderGLSL &shaderData ) override
+	{
+		LoaderCommand cmd(eLoaderCommandShader);
+		cmd.name = shader_name;
+		cmd.values[0] = alphatype;
+		cmd.blob.resize(sizeof(ShaderGLSL));
+		memcpy( cmd.blob.data(), &shaderData, sizeof(ShaderGLSL) );
+		Push(cmd);
+	}
+	void OnReadShadersEnd() override
+	{
+		LoaderCommand cmd(eLoaderCommandShadersEnd);
+		Push(cmd);
+	}
+
+	// geometry, models
+	bool OnReadModelsBegin(const int numberOfModels, const int numberOfMeshes, const double *bounding_min, const double *bounding_max) override
+	{
+		LoaderCommand cmd(eLoaderCommandModelsBegin);
+		cmd.values[0] = numberOfModels;
+		cmd.values[1] = numberOfMeshes;
+		cmd.doubles.assign( bounding_min, bounding_min+3 );
+		cmd.doubles.insert( cmd.doubles.end(), bounding_max, bounding_max+3 );
+		Push(cmd);
+
+		// the worker goes on with the pack, the merge is dropped in Replay if the target rejects the models
+		return true;
+	}
+	void OnPrepareVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) override
+	{
+		// page-in and the merge are done right here in the worker thread
+		mTouchSum += TouchPages(data, CalculateGeometryPackSize(data) );
+
+		if (mTarget)
+		{
+			mMergeStart = LoaderClock::now();
+			mStaging.Merge(data);
+			mMergeEnd = LoaderClock::now();
+		}
+	}
+	void OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) override
+	{
+		LoaderCommand cmd(eLoaderCommandVertexData);
+		cmd.header = pHeader;
+		cmd.data = data;
+		Push(cmd);
+	}
+	void OnReadModel(const char *name,
+						const double *translation,
+						const double *rotation,
+						const double *scaling,
+						const double *bounding_min,
+						const double *bounding_max,
+						const int numberOfShaders,
+						const int *shaders,
+						const VertexDataHeader *pheader,
+						const BYTE *data) override
+	{
+		LoaderCommand cmd(eLoaderCommandModel);
+		cmd.name = name;
+		cmd.doubles.reserve(15);
+		cmd.doubles.insert( cmd.doubles.end(), translation, translation+3 );
+		cmd.doubles.insert( cmd.doubles.end(), rotation, rotation+3 );
+		cmd.doubles.insert( cmd.doubles.end(), scaling, scaling+3 );
+		cmd.doubles.insert( cmd.doubles.end(), bounding_min, bounding_min+3 );
+		cmd.doubles.insert( cmd.doubles.end(), bounding_max, bounding_max+3 );
+		cmd.ints.assign( shaders, shaders+MAX_NUMBER_OF_SHADERS_PER_MODEL );
+		cmd.values[0] = numberOfShaders;
+		cmd.header = pheader;
+		cmd.data = data;
+		Push(cmd);
+	}
+	void OnReadModelPatch(const int offset, const int size, const int materialId) override
+	{
+		LoaderCommand cmd(eLoaderCommandModelPatch);
+		cmd.values[0] = offset;
+		cmd.values[1] = size;
+		cmd.values[2] = materialId;
+		Push(cmd);
+	}
+	void OnReadModelFinish() override
+	{
+		LoaderCommand cmd(eLoaderCommandModelFinish);
+		Push(cmd);
+	}
+	void OnReadModelsEnd() override
+	{
+		LoaderCommand cmd(eLoaderCommandModelsEnd);
+		Push(cmd);
+	}
+
+protected:
+
+	CGPUCacheLoaderVisitor		*mTarget;
+
+	std::mutex					mMutex;
+	std::condition_variable		mCondition;
+	std::deque<LoaderCommand>	mCommands;
+	bool						mFinished;
+	int							mNumberOfCommands;
+
+	VertexMergeStaging			mStaging;			// worker merge, it's pushed before the vertex data command
+	LoaderClock::time_point		mMergeStart;
+	LoaderClock::time_point		mMergeEnd;
+
+	volatile unsigned int		mTouchSum;
+
+	void Push(const LoaderCommand &cmd)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mCommands.push_back(cmd);
+		mNumberOfCommands += 1;
+		mCondition.notify_one();
+	}
+
+	// wait for the next command, false when the worker has finished and queue is empty
+	bool Pop(LoaderCommand &cmd, double &stallTime)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+
+		if (mCommands.empty() && false == mFinished)
+		{
+			const LoaderClock::time_point start = LoaderClock::now();
+			mCondition.wait( lock, [this] () { return mFinished || false == mCommands.empty(); } );
+			stallTime += ElapsedMs(start);
+		}
+
+		if (mCommands.empty())
+			return false;
+
+		cmd = mCommands.front();
+		mCommands.pop_front();
+		return true;
+	}
+
+	// group begin returns false - skip the rest of the group, just like a sequential loader does
+	static bool IsGroupEnd(const ELoaderCommand type)
+	{
+		return (type == eLoaderCommandTexturesEnd || type == eLoaderCommandTexturesError
+			|| type == eLoaderCommandMaterialsEnd || type == eLoaderCommandShadersEnd
+			|| type == eLoaderCommandModelsEnd);
+	}
+};
+
+void CGPUCacheLoaderVisitorQueue::Replay(double &stallTime)
+{
+	LoaderCommand	cmd(eLoaderCommandEmptyImage);
+	bool			skipGroup = false;
+
+	while( Pop(cmd, stallTime) )
+	{
+		if (mTarget == nullptr)
+			continue;
+
+		if (skipGroup)
+		{
+			if (IsGroupEnd(cmd.type) )
+				skipGroup = false;
+			continue;
+		}
+
+		switch(cmd.type)
+		{
+		case eLoaderCommandTexturesBegin:
+			skipGroup = (false == mTarget->OnReadTexturesBegin( cmd.name.c_str(), cmd.values[0], cmd.values[1] ) );
+			break;
+		case eLoaderCommandTexturesImage1:
+			mTarget->OnReadTexturesImage1( (const ImageHeader*) cmd.header, cmd.offset, cmd.size, cmd.data );
+			break;
+		case eLoaderCommandTexturesImage2:
+			mTarget->OnReadTexturesImage2( cmd.imageType, (const ImageHeader2*) cmd.header, cmd.offset, cmd.size, cmd.data );
+			break;
+		case eLoaderCommandEmptyImage:
+			mTarget->OnReadEmptyImage();
+			break;
+		case eLoaderCommandTexturesDigest:
+			mTarget->OnReadTexturesDigest( cmd.values[0], cmd.digest );
+			break;
+		case eLoaderCommandTexturesSampler:
+			mTarget->OnReadTexturesSampler( cmd.name.c_str(), cmd.name2.c_str(), (const SamplerHeader*) cmd.header, cmd.offset, cmd.size, cmd.data );
+			break;
+		case eLoaderCommandTexturesError:
+			mTarget->OnReadTexturesError( cmd.name.c_str() );
+			break;
+		case eLoaderCommandTexturesEnd:
+			mTarget->OnReadTexturesEnd();
+			break;
+
+		case eLoaderCommandMaterialsBegin:
+			skipGroup = (false == mTarget->OnReadMaterialsBegin( cmd.values[0] ) );
+			break;
+		case eLoaderCommandMaterial:
+			mTarget->OnReadMaterial( cmd.name.c_str(), *(const MaterialGLSL*) cmd.blob.data() );
+			break;
+		case eLoaderCommandMaterialsEnd:
+			mTarget->OnReadMaterialsEnd();
+			break;
+
+		case eLoaderCommandShadersBegin:
+			skipGroup = (false == mTarget->OnReadShadersBegin( cmd.values[0] ) );
+			break;
+		case eLoaderCommandShader:
+			mTarget->OnReadShader( cmd.name.c_str(), cmd.values[0], *(const ShaderGLSL*) cmd.blob.data() );
+			break;
+		case eLoaderCommandShadersEnd:
+			mTarget->OnReadShadersEnd();
+			break;
+
+		case eLoaderCommandModelsBegin:
+			skipGroup = (false == mTarget->OnReadModelsBegin( cmd.values[0], cmd.values[1], &cmd.doubles[0], &cmd.doubles[3] ) );
+			break;
+		case eLoaderCommandVertexData:
+			mTarget->OnTakeMergedVertexData( (const FileGeometryHeader*) cmd.header, cmd.data, mStaging );
+			mTarget->OnReadVertexData( (const FileGeometryHeader*) cmd.header, cmd.data );
+			break;
+		case eLoaderCommandModel:
+			mTarget->OnReadModel( cmd.name.c_str(), &cmd.doubles[0], &cmd.doubles[3], &cmd.doubles[6], &cmd.doubles[9], &cmd.doubles[12],
+				cmd.values[0], cmd.ints.data(), (const VertexDataHeader*) cmd.header, cmd.data );
+			break;
+		case eLoaderCommandModelPatch:
+			mTarget->OnReadModelPatch( cmd.values[0], cmd.values[1], cmd.values[2] );
+			break;
+		case eLoaderCommandModelFinish:
+			mTarget->OnReadModelFinish();
+			break;
+		case eLoaderCommandModelsEnd:
+			mTarget->OnReadModelsEnd();
+			break;
+		}
+	}
+
+	// not taken by the target (models are rejected)
+	mStaging.Clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// GPUCacheLoaderPipelined
+
+CGPUCacheLoaderPipelined::CGPUCacheLoaderPipelined()
+{
+	GPUCacheLoaderTimings::Clear(mTimings);
+}
+
+static std::string MakePackFilename( const char *filename, const char *suffix )
+{
+	std::string pack_filename( filename );
+
+	auto iter = pack_filename.find_last_of( "." );
+	if (iter != std::string::npos)
+		pack_filename.erase( iter );
+	pack_filename.append( suffix );
+
+	return pack_filename;
+}
+
+bool CGPUCacheLoaderPipelined::Load(const char *filename, CGPUCacheLoaderVisitor *pVisitor)
+{
+	GPUCacheLoaderTimings::Clear(mTimings);
+
+	if (pVisitor == nullptr)
+		return false;
+
+	const LoaderClock::time_point loadStart = LoaderClock::now();
+
+	CGPUCacheManifest	manifest;
+
+	// each stage has it's own loader, mapped packs are alive until replay is finished
+	CGPUCacheLoader		texturesLoader;
+	CGPUCacheLoader		materialsLoader;
+	CGPUCacheLoader		geometryLoader;
+
+	CGPUCacheLoaderVisitorQueue		texturesQueue(pVisitor);
+	CGPUCacheLoaderVisitorQueue		materialsQueue(pVisitor);
+	CGPUCacheLoaderVisitorQueue		geometryQueue(pVisitor);
+
+	texturesLoader.mVisitor = &texturesQueue;
+	materialsLoader.mVisitor = &materialsQueue;
+	geometryLoader.mVisitor = &geometryQueue;
+
+	std::thread		texturesThread;
+	std::thread		geometryThread;
+
+	bool			texturesResult = true;
+	bool			geometryResult = true;
+
+	try
+	{
+		//
+		// 1 - read the manifest (binary or xml)
+
+		const LoaderClock::time_point manifestStart = LoaderClock::now();
+
+		if (false == CGPUCacheLoader::ReadManifest( filename, manifest ) )
+			throw std::runtime_error( "failed to load cache file" );
+
+		mTimings.manifestRead = ElapsedMs(manifestStart);
+
+		pVisitor->OnReadHeader(filename, manifest.GetSourceFilename() );
+
+		//
+		// 2 - start workers for both packs
+
+		const std::string textures_filename = MakePackFilename( filename, "_Textures.pck" );
+		const std::string geometry_filename = MakePackFilename( filename, "_Geometry.pck" );
+
+		texturesThread = std::thread( [&] () {
+			const LoaderClock::time_point start = LoaderClock::now();
+			texturesResult = texturesLoader.ReadTextures( textures_filename.c_str(), manifest );
+			mTimings.texturesRead = ElapsedMs(start);
+			texturesQueue.Finish();
+		} );
+
+		geometryThread = std::thread( [&] () {
+			const LoaderClock::time_point start = LoaderClock::now();
+			geometryResult = geometryLoader.ReadModels( geometry_filename.c_str(), manifest );
+			mTimings.geometryRead = ElapsedMs(start);
+			geometryQueue.Finish();
+		} );
+
+		// materials and shaders are records only, read them here while workers are busy
+
+		const LoaderClock::time_point materialsStart = LoaderClock::now();
+		
+		const bool materialsResult = materialsLoader.ReadMaterials(manifest);
+		materialsLoader.ReadShaders(manifest);
+
+		materialsQueue.Finish();
+		mTimings.materialsRead = ElapsedMs(materialsStart);
+
+		//
+		// 3 - gpu submit stage, keep the sequential order of visitor callbacks
+
+		LoaderClock::time_point submitStart = LoaderClock::now();
+		double stall = 0.0;
+
+		const LoaderClock::time_point texturesReplayStart = submitStart;
+		texturesQueue.Replay(stall);
+		const LoaderClock::time_point texturesReplayEnd = LoaderClock::now();
+		
+		texturesThread.join();
+
+		mTimings.submitTextures = ElapsedMs(submitStart) - stall;
+		mTimings.submitStall += stall;
+
+		if (false == texturesResult)
+			throw std::runtime_error( "Failed to read textures" );
+
+		submitStart = LoaderClock::now();
+		stall = 0.0;
+
+		materialsQueue.Replay(stall);
+
+		mTimings.submitMaterials = ElapsedMs(submitStart) - stall;
+		mTimings.submitStall += stall;
+
+		if (false == materialsResult)
+			throw std::runtime_error( "Failed to read materials" );
+
+		submitStart = LoaderClock::now();
+		stall = 0.0;
+
+		geometryQueue.Replay(stall);
+		geometryThread.join();
+
+		mTimings.submitModels = ElapsedMs(submitStart) - stall;
+		mTimings.submitStall += stall;
+
+		// worker merge should be hidden behind the textures replay
+		if (geometryQueue.HasMerge() )
+		{
+			const LoaderClock::time_point overlapStart = std::max( geometryQueue.GetMergeStart(), texturesReplayStart );
+			const LoaderClock::time_point overlapEnd = std::min( geometryQueue.GetMergeEnd(), texturesReplayEnd );
+
+			mTimings.geometryMerge = std::chrono::duration<double, std::milli>( geometryQueue.GetMergeEnd() - geometryQueue.GetMergeStart() ).count();
+			mTimings.mergeOverlap = (overlapEnd > overlapStart) 
+				? std::chrono::duration<double, std::milli>( overlapEnd - overlapStart ).count() : 0.0;
+		}
+
+		if (false == geometryResult)
+			throw std::runtime_error( "failed to load model render from xml" );
+	}
+	catch (const std::exception &e)
+	{
+		// workers use the manifest and visitor queues, wait for them
+		if (texturesThread.joinable() )
+			texturesThread.join();
+		if (geometryThread.joinable() )
+			geometryThread.join();
+
+#if LOADER_LOG_PRINTF <= LOG_LEVEL_ERROR
+		printf ( "%s\n", e.what() );
+#endif
+		return false;
+	}
+
+	mTimings.numberOfTexturesCommands = texturesQueue.GetNumberOfCommands();
+	mTimings.numberOfMaterialsCommands = materialsQueue.GetNumberOfCommands();
+	mTimings.numberOfModelsCommands = geometryQueue.GetNumberOfCommands();
+
+	mTimings.total = ElapsedMs(loadStart);
+
+	return true;
+}
+
+void CGPUCacheLoaderPipelined::PrintTimings() const
+{
+	printf( "gpu cache load timings (ms)\n" );
+	printf( "  manifest read      %10.2f\n", mTimings.manifestRead );
+	printf( "  textures read      %10.2f  (worker)\n", mTimings.texturesRead );
+	printf( "  materials read     %10.2f\n", mTimings.materialsRead );
+	printf( "  geometry read      %10.2f  (worker)\n", mTimings.geometryRead );
+	printf( "  geometry merge     %10.2f  (worker, %.2f during the textures replay)\n", mTimings.geometryMerge, mTimings.mergeOverlap );
+	printf( "  submit textures    %10.2f  (%d commands)\n", mTimings.submitTextures, mTimings.numberOfTexturesCommands );
+	printf( "  submit materials   %10.2f  (%d commands)\n", mTimings.submitMaterials, mTimings.numberOfMaterialsCommands );
+	printf( "  submit models      %10.2f  (%d commands)\n", mTimings.submitModels, mTimings.numberOfModelsCommands );
+	printf( "  submit stall       %10.2f\n", mTimings.submitStall );
+	printf( "  total              %10.2f\n", mTimings.total );
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_loaderPipelined.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_loader.h"
+
+//////////////////////////////////////////////////////////////////////////
+// time spent in each loading phase (in milliseconds)
+
+struct GPUCacheLoaderTimings
+{
+	double		manifestRead;		// binary manifest or TinyXML document load
+	double		texturesRead;		// worker - textures pack walk and page-in
+	double		materialsRead;		// materials and shaders records
+	double		geometryRead;		// worker - geometry pack walk and vertex merge
+	double		geometryMerge;		// worker - vertex streams merge into the staging arrays
+	double		mergeOverlap;		// part of the merge which is done while the gl thread replays textures
+
+	double		submitTextures;		// gl thread - visitor callbacks for textures
+	double		submitMaterials;	// gl thread - visitor callbacks for materials and shaders
+	double		submitModels;		// gl thread - visitor callbacks for vertex data and models
+	double		submitStall;		// gl thread is waiting for the workers
+
+	double		total;
+
+	int			numberOfTexturesCommands;
+	int			numberOfMaterialsCommands;
+	int			numberOfModelsCommands;
+
+	static void Clear(GPUCacheLoaderTimings &timings)
+	{
+		memset( &timings, 0, sizeof(GPUCacheLoaderTimings) );
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+// staged cache loader
+//	workers walk the textures and geometry packs (and merge vertex data) while the calling thread
+//	replays finished visitor callbacks in the same order as CGPUCacheLoader::Load does
+//	NOTE: all visitor callbacks are made from the calling thread, so call Load from the thread with the gl context
+//		vertex streams are merged by the geometry worker before the models are accepted,
+//		the target gets them with OnTakeMergedVertexData after the replayed OnReadModelsBegin has returned true
+
+class CGPUCacheLoaderPipelined
+{
+public:
+
+	//! a constructor
+	CGPUCacheLoaderPipelined();
+
+	bool Load(const char *filename, CGPUCacheLoaderVisitor *pVisitor);
+
+	const GPUCacheLoaderTimings &GetTimings() const
+	{
+		return mTimings;
+	}
+
+	void PrintTimings() const;
+
+protected:
+
+	GPUCacheLoaderTimings		mTimings;
+};
@@ -0,0 +1,733 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_manifest.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_manifest.h"
+#include "IO/FileMapping.h"
+#include "IO/FileIO.h"
+
+#include <stdio.h>
+#include <stdexcept>
+
+///////////////////////////////////
+
+#define LOG_LEVEL_INFO		1
+#define	LOG_LEVEL_WARNING	2
+#define LOG_LEVEL_ERROR		3
+#define LOG_LEVEL_NONE		4
+
+#define MANIFEST_LOG_PRINTF	3
+
+std::string MakeManifestFilename( const char *xmlFilename )
+{
+	std::string manifest_filename( xmlFilename );
+
+	auto iter = manifest_filename.find_last_of( "." );
+	if (iter != std::string::npos)
+		manifest_filename.erase( iter );
+	manifest_filename.append( "_Manifest.pck" );
+
+	return manifest_filename;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// CGPUCacheManifest
+
+CGPUCacheManifest::CGPUCacheManifest()
+{
+	Clear();
+}
+
+void CGPUCacheManifest::Clear()
+{
+	FileManifestHeader::Set( 0, 0, 0, 0, 0, 0, mHeader );
+
+	mStrings.clear();
+	mStringsMap.clear();
+
+	mTextures.clear();
+	mMaterials.clear();
+	mShaders.clear();
+	mModels.clear();
+	mPatches.clear();
+
+	// offset 0 is always an empty string
+	AddString("");
+}
+
+int CGPUCacheManifest::AddString( const char *str )
+{
+	if (str == nullptr)
+		str = "";
+
+	auto iter = mStringsMap.find(str);
+	if (iter != end(mStringsMap) )
+		return iter->second;
+
+	const int offset = (int) mStrings.size();
+	mStrings.insert( end(mStrings), str, str + strlen(str) + 1 );
+	mStringsMap[str] = offset;
+
+	return offset;
+}
+
+//
+// XML
+
+static void ReadBoundingBoxFromXML( const TiXmlElement *elem, double *lmin, double *lmax )
+{
+	const TiXmlElement *bbElem = elem->FirstChildElement( "BoundingBox" );
+	if (bbElem == nullptr)
+	{
+		return;
+	}
+	// enumerate attribs
+	for( const TiXmlAttribute *attrib = bbElem->FirstAttribute();
+			attrib;
+			attrib = attrib->Next() )
+	{
+		if ( strcmp(attrib->Name(), "minx") == 0 )
+		{
+			lmin[0] = attrib->DoubleValue();
+		}
+		else if ( strcmp(attrib->Name(), "miny") == 0 )
+		{
+			lmin[1] = attrib->DoubleValue();
+		}
+		else if ( strcmp(attrib->Name(), "minz") == 0 )
+		{
+			lmin[2] = attrib->DoubleValue();
+		}
+		else if ( strcmp(attrib->Name(), "maxx") == 0 )
+		{
+			lmax[0] = attrib->DoubleValue();
+		}
+		else if ( strcmp(attrib->Name(), "maxy") == 0 )
+		{
+			lmax[1] = attrib->DoubleValue();
+		}
+		else if ( strcmp(attrib->Name(), "maxz") == 0 )
+		{
+			lmax[2] = attrib->DoubleValue();
+		}
+	}
+}
+
+static int ReadCountFromXML( const TiXmlElement *elem, const char *name )
+{
+	int value = 0;
+	elem->Attribute( name, &value );
+	return value;
+}
+
+bool CGPUCacheManifest::LoadFromXML( const char *filename )
+{
+	TiXmlDocument	doc;
+
+	if (doc.LoadFile( filename ) == false)
+	{
+#if MANIFEST_LOG_PRINTF <= LOG_LEVEL_ERROR
+		printf( "failed to load cache file\n" );
+#endif
+		return false;
+	}
+
+	return ReadFromXML(doc);
+}
+
+bool CGPUCacheManifest::ReadFromXML( const TiXmlDocument &doc )
+{
+	Clear();
+
+	const TiXmlNode *node = nullptr;
+
+	try
+	{
+		// get main header attributes
+		node = doc.FirstChild( "Header" );
+		const TiXmlElement *headerElem = (node) ? node->ToElement() : nullptr;
+
+		if (headerElem)
+		{
+			mHeader.sourceFilename = AddString( headerElem->Attribute("filename") );
+		}
+
+		node = doc.FirstChild("Textures");
+		if (node == nullptr)
+			throw std::runtime_error("Failed to find Textures group in cache");
+		if (node->ToElement() )
+			ReadTexturesFromXML( node->ToElement() );
+
+		node = doc.FirstChild("Materials");
+		if (node == nullptr)
+			throw std::runtime_error( "Failed to find materials group in cache" );
+		if (node->ToElement() )
+			ReadMaterialsFromXML( node->ToElement() );
+
+		node = doc.FirstChild("Shaders");
+		if (node == nullptr)
+			throw std::runtime_error( "Failed to find shaders group in cache" );
+		if (node->ToElement() )
+			ReadShadersFromXML( node->ToElement() );
+
+		node = doc.FirstChild("Models");
+		if (node == nullptr)
+			throw std::runtime_error( "failed to find models group in cache" );
+		if (node->ToElement() )
+			ReadModelsFromXML( node->ToElement() );
+	}
+	catch (const std::exception &e)
+	{
+#if MANIFEST_LOG_PRINTF <= LOG_LEVEL_ERROR
+		printf ( "%s\n", e.what() );
+#endif
+		return false;
+	}
+
+	mHeader.numberOfTextures = (int) mTextures.size();
+	mHeader.numberOfMaterials = (int) mMaterials.size();
+	mHeader.numberOfShaders = (int) mShaders.size();
+	mHeader.numberOfModels = (int) mModels.size();
+	mHeader.numberOfPatches = (int) mPatches.size();
+
+	return true;
+}
+
+void CGPUCacheManifest::ReadTexturesFromXML( const TiXmlElement *parentElem )
+{
+	const int numberOfTextures = ReadCountFromXML( parentElem, "count" );
+	if (numberOfTextures <= 0)
+		return;
+
+	ManifestTexture	emptyTexture = {0, 0};
+	mTextures.resize( numberOfTextures, emptyTexture );
+
+	const TiXmlElement *texelem = parentElem->FirstChildElement( "Texture" );
+
+	int index=0;
+	while(texelem && index < numberOfTextures)
+	{
+		mTextures[index].name = AddString( texelem->Attribute("name") );
+		mTextures[index].filename = AddString( texelem->Attribute("filename") );
+
+		index++;
+		texelem = texelem->NextSiblingElement();
+	}
+}
+
+void CGPUCacheManifest::ReadMaterialsFromXML( const TiXmlElement *parentElem )
+{
+	if (0 == ReadCountFromXML( parentElem, "count" ) )
+		return;
+
+	const TiXmlElement *matelem = parentElem->FirstChildElement( "Material" );
+
+	while(matelem)
+	{
+		ManifestMaterial	record;
+		memset( &record, 0, sizeof(ManifestMaterial) );
+
+		const char *name = matelem->Attribute( "name" );
+		record.name = AddString( (name) ? name : "default" );
+
+		const TiXmlElement *diffuse = matelem->FirstChildElement( "Diffuse" );
+		if (diffuse)
+		{
+			// enumerate attribs
+			for( const TiXmlAttribute *attrib = diffuse->FirstAttribute();
+					attrib;
+					attrib = attrib->Next() )
+			{
+				if ( strcmp(attrib->Name(), "r") == 0 )
+				{
+					record.diffuseColor[0] = (float) attrib->DoubleValue();
+				}
+				else if ( strcmp(attrib->Name(), "g") == 0 )
+				{
+					record.diffuseColor[1] = (float) attrib->DoubleValue();
+				}
+				else if ( strcmp(attrib->Name(), "b") == 0 )
+				{
+					record.diffuseColor[2] = (float) attrib->DoubleValue();
+				}
+				else if ( strcmp(attrib->Name(), "factor") == 0 )
+				{
+					record.diffuseColor[3] = (float) attrib->DoubleValue();
+				}
+				else if ( strcmp(attrib->Name(), "mapId") == 0 )
+				{
+					record.diffuse = attrib->IntValue();
+					record.useDiffuse = (record.diffuse >= 0) ? 1.0f : 0.0f;
+				}
+			}
+		}
+
+		mMaterials.push_back(record);
+		matelem = matelem->NextSiblingElement();
+	}
+}
+
+void CGPUCacheManifest::ReadShadersFromXML( const TiXmlElement *parentElem )
+{
+	const TiXmlElement *shaderelem = parentElem->FirstChildElement( "Shader" );
+	const TiXmlAttribute  *attrib = nullptr;
+
+	while(shaderelem)
+	{
+		ShaderGLSL		shader;
+		DefaultShader( shader );
+
+		ManifestShader	record;
+		memset( &record, 0, sizeof(ManifestShader) );
+
+		const char *name = shaderelem->Attribute( "name" );
+		record.name = AddString( (name) ? name : "default" );
+
+		// enumerate attribs
+		for( attrib = shaderelem->FirstAttribute();
+				attrib;
+				attrib = attrib->Next() )
+		{
+			if (strcmp(attrib->Name(), "transparency") == 0)
+			{
+				shader.transparency = (float)attrib->DoubleValue();
+			}
+			else if (strcmp(attrib->Name(), "type") == 0)
+			{
+				shader.shaderType = (EShaderType) attrib->IntValue();
+			}
+			else if ( strcmp(attrib->Name(), "alpha") == 0 )
+			{
+				record.alpha = attrib->IntValue();
+			}
+		}
+
+		const TiXmlElement *shadingElem = shaderelem->FirstChildElement( "Shading" );
+		if (shadingElem)
+		{
+			for( attrib = shadingElem->FirstAttribute();
+				attrib;
+				attrib = attrib->Next() )
+			{
+				if (strcmp(attrib->Name(), "type") == 0)
+				{
+					shader.shadingType = (int) attrib->IntValue();
+				}
+				else if (strcmp(attrib->Name(), "toonEnabled") == 0)
+				{
+					shader.toonEnabled = (float) attrib->IntValue();
+				}
+				else if (strcmp(attrib->Name(), "toonSteps") == 0)
+				{
+					shader.toonSteps = (float) attrib->DoubleValue();
+				}
+				else if (strcmp(attrib->Name(), "toonDistribution") == 0)
+				{
+					shader.toonDistribution = (float) attrib->DoubleValue();
+				}
+				else if (strcmp(attrib->Name(), "toonShadowPosition") == 0)
+				{
+					shader.toonShadowPosition = (float) attrib->DoubleValue();
+				}
+			}
+		}
+
+		const TiXmlElement *colorCorrectionElem = shaderelem->FirstChildElement( "ColorCorrection" );
+		if (colorCorrectionElem)
+		{
+			const TiXmlElement *customColorElem = colorCorrectionElem->FirstChildElement( "CustomColor" );
+			if (customColorElem)
+			{
+				for( attrib = customColorElem->FirstAttribute();
+					attrib;
+					attrib = attrib->Next() )
+				{
+					if (strcmp(attrib->Name(), "r") == 0)
+					{
+						shader.customColor[0] = (float) attrib->DoubleValue();
+					}
+					else if (strcmp(attrib->Name(), "g") == 0)
+					{
+						shader.customColor[1] = (float) attrib->DoubleValue();
+					}
+					else if (strcmp(attrib->Name(), "b") == 0)
+					{
+						shader.customColor[2] = (float) attrib->DoubleValue();
+					}
+				}
+			}
+
+			for( attrib = colorCorrectionElem->FirstAttribute();
+				attrib;
+				attrib = attrib->Next() )
+			{
+				if (strcmp(attrib->Name(), "blendType") == 0)
+				{
+					shader.customColor[3] = (float) attrib->IntValue();
+				}
+				else if (strcmp(attrib->Name(), "contrast") == 0)
+				{
+					shader.contrast = 1.0f + 0.01f * (float) attrib->DoubleValue();
+				}
+				else if (strcmp(attrib->Name(), "saturation") == 0)
+				{
+					shader.saturation = 1.0f + 0.01f * (float) attrib->DoubleValue();
+				}
+				else if (strcmp(attrib->Name(), "brightness") == 0)
+				{
+					shader.brightness = 1.0f + 0.01f * (float) attrib->DoubleValue();
+				}
+				else if (strcmp(attrib->Name(), "gamma") == 0)
+				{
+					shader.gamma = 0.01f * (float) attrib->DoubleValue();
+				}
+			}
+		}
+
+		record.shaderType = shader.shaderType;
+		record.shadingType = shader.shadingType;
+		record.transparency = shader.transparency;
+		record.toonEnabled = shader.toonEnabled;
+		record.toonSteps = shader.toonSteps;
+		record.toonDistribution = shader.toonDistribution;
+		record.toonShadowPosition = shader.toonShadowPosition;
+		for (int i=0; i<4; ++i)
+			record.customColor[i] = shader.customColor[i];
+		record.contrast = shader.contrast;
+		record.saturation = shader.saturation;
+		record.brightness = shader.brightness;
+		record.gamma = shader.gamma;
+
+		mShaders.push_back(record);
+		shaderelem = shaderelem->NextSiblingElement();
+	}
+}
+
+void CGPUCacheManifest::ReadModelsFromXML( const TiXmlElement *parentElem )
+{
+	if (0 == ReadCountFromXML( parentElem, "count" ) )
+		return;
+
+	mHeader.numberOfSubMeshes = ReadCountFromXML( parentElem, "submeshes" );
+
+	double bmin[3] = {0.0, 0.0, 0.0};
+	double bmax[3] = {0.0, 0.0, 0.0};
+
+	ReadBoundingBoxFromXML( parentElem, bmin, bmax );
+
+	for (int i=0; i<3; ++i)
+	{
+		mHeader.boundingMin[i] = bmin[i];
+		mHeader.boundingMax[i] = bmax[i];
+	}
+
+	auto read_vector_func = [] (const TiXmlElement *elem, double *values)
+	{
+		if (elem)
+		{
+			for( const TiXmlAttribute *attrib = elem->FirstAttribute();
+			attrib;
+			attrib = attrib->Next() )
+			{
+				if ( strcmp(attrib->Name(), "x") == 0 ) values[0] = attrib->DoubleValue();
+				else if ( strcmp(attrib->Name(), "y") == 0 ) values[1] = attrib->DoubleValue();
+				else if ( strcmp(attrib->Name(), "z") == 0 ) values[2] = attrib->DoubleValue();
+			}
+		}
+	};
+
+	const TiXmlElement *modelElem = parentElem->FirstChildElement( "Model" );
+	while( modelElem )
+	{
+		ManifestModel	record;
+		memset( &record, 0, sizeof(ManifestModel) );
+
+		const char *name = modelElem->Attribute( "name" );
+		record.name = AddString( (name) ? name : "default" );
+
+		record.scaling[0] = record.scaling[1] = record.scaling[2] = 1.0;
+
+		read_vector_func( modelElem->FirstChildElement( "Translation" ), record.translation );
+		read_vector_func( modelElem->FirstChildElement( "Rotation" ), record.rotation );
+		read_vector_func( modelElem->FirstChildElement( "Scaling" ), record.scaling );
+
+		// NOTE: model without a bounding box gets a previous one
+		ReadBoundingBoxFromXML( modelElem, bmin, bmax );
+		for (int i=0; i<3; ++i)
+		{
+			record.boundingMin[i] = bmin[i];
+			record.boundingMax[i] = bmax[i];
+		}
+
+		// read shaders used by the model
+
+		for (int i=0; i<MAX_NUMBER_OF_SHADERS_PER_MODEL; ++i)
+			record.shaders[i] = -1;
+
+		const TiXmlElement *shaders = modelElem->FirstChildElement( "Shaders" );
+		if (shaders)
+		{
+			const TiXmlElement *shaderElem = shaders->FirstChildElement( "Shader" );
+
+			while(shaderElem)
+			{
+				int shaderId = 0;
+				if (nullptr != shaderElem->Attribute( "shaderId", &shaderId ) )
+				{
+					// we have one default shader at the beginning
+					record.shaders[record.numberOfShaders] = shaderId + 1;
+
+					record.numberOfShaders++;
+					if (record.numberOfShaders >= MAX_NUMBER_OF_SHADERS_PER_MODEL)
+					{
+#if MANIFEST_LOG_PRINTF <= LOG_LEVEL_ERROR
+						printf("ERROR: so many shaders per model is not supported!");
+#endif
+						record.numberOfShaders = MAX_NUMBER_OF_SHADERS_PER_MODEL-1;
+					}
+				}
+				shaderElem = shaderElem->NextSiblingElement("Shader");
+			}
+		}
+
+		//
+		// read patch inside the model
+
+		record.firstPatch = (int) mPatches.size();
+
+		const TiXmlElement *patches = modelElem->FirstChildElement( "Patches" );
+		if (patches)
+		{
+			const TiXmlElement *patchElem = patches->FirstChildElement( "Patch" );
+
+			ManifestPatch patch;
+			ManifestPatch::Set( 0, 0, 0, patch );
+
+			while(patchElem)
+			{
+				patchElem->Attribute( "offset", &patch.offset );
+				patchElem->Attribute( "size", &patch.size );
+				patchElem->Attribute( "materialId", &patch.materialId );
+
+				mPatches.push_back(patch);
+
+				patchElem = patchElem->NextSiblingElement("Patch");
+			}
+		}
+
+		record.numberOfPatches = (int) mPatches.size() - record.firstPatch;
+
+		mModels.push_back(record);
+		modelElem = modelElem->NextSiblingElement("Model");
+	}
+}
+
+//
+// BINARY
+
+bool CGPUCacheManifest::LoadBinary( const char *filename )
+{
+	Clear();
+
+	CFileMapping	fileMapping;
+
+	if (false == fileMapping.Open(filename) )
+		return false;
+
+	const BYTE *data = fileMapping.GetData();
+	const size_t size = fileMapping.GetSize();
+
+	try
+	{
+		if (size < sizeof(FileManifestHeader) )
+			throw std::runtime_error( "manifest file is too small" );
+
+		const FileManifestHeader *pHeader = (const FileManifestHeader*) data;
+
+		if (pHeader->tag != MANIFEST_FILE_TAG || pHeader->version != MANIFEST_FILE_VERSION)
+			throw std::runtime_error( "unsupported manifest version" );
+
+		auto check_block = [&size] (const int64_t offset, const int count, const size_t stride) {
+
+			if (count < 0 || offset < 0 || (size_t) offset + (size_t) count * stride > size)
+				throw std::runtime_error( "CORRUPTED MANIFEST FORMAT" );
+		};
+
+		check_block( pHeader->texturesOffset, pHeader->numberOfTextures, sizeof(ManifestTexture) );
+		check_block( pHeader->materialsOffset, pHeader->numberOfMaterials, sizeof(ManifestMaterial) );
+		check_block( pHeader->shadersOffset, pHeader->numberOfShaders, sizeof(ManifestShader) );
+		check_block( pHeader->modelsOffset, pHeader->numberOfModels, sizeof(ManifestModel) );
+		check_block( pHeader->patchesOffset, pHeader->numberOfPatches, sizeof(ManifestPatch) );
+		check_block( pHeader->stringsOffset, (int) pHeader->stringsSize, sizeof(char) );
+
+		if (pHeader->stringsSize <= 0 || data[pHeader->stringsOffset + pHeader->stringsSize - 1] != 0)
+			throw std::runtime_error( "CORRUPTED MANIFEST FORMAT" );
+
+		mHeader = *pHeader;
+
+		mTextures.assign( (const ManifestTexture*) (data + pHeader->texturesOffset),
+			(const ManifestTexture*) (data + pHeader->texturesOffset) + pHeader->numberOfTextures );
+		mMaterials.assign( (const ManifestMaterial*) (data + pHeader->materialsOffset),
+			(const ManifestMaterial*) (data + pHeader->materialsOffset) + pHeader->numberOfMaterials );
+		mShaders.assign( (const ManifestShader*) (data + pHeader->shadersOffset),
+			(const ManifestShader*) (data + pHeader->shadersOffset) + pHeader->numberOfShaders );
+		mModels.assign( (const ManifestModel*) (data + pHeader->modelsOffset),
+			(const ManifestModel*) (data + pHeader->modelsOffset) + pHeader->numberOfModels );
+		mPatches.assign( (const ManifestPatch*) (data + pHeader->patchesOffset),
+			(const ManifestPatch*) (data + pHeader->patchesOffset) + pHeader->numberOfPatches );
+
+		mStrings.assign( (const char*) (data + pHeader->stringsOffset),
+			(const char*) (data + pHeader->stringsOffset) + pHeader->stringsSize );
+
+		// patch ranges are used without checks later
+		for (auto iter=begin(mModels); iter!=end(mModels); ++iter)
+		{
+			if (iter->firstPatch < 0 || iter->numberOfPatches < 0 || iter->firstPatch + iter->numberOfPatches > pHeader->numberOfPatches)
+				throw std::runtime_error( "CORRUPTED MANIFEST FORMAT" );
+			if (iter->numberOfShaders < 0 || iter->numberOfShaders >= MAX_NUMBER_OF_SHADERS_PER_MODEL)
+				throw std::runtime_error( "CORRUPTED MANIFEST FORMAT" );
+		}
+	}
+	catch (const std::exception &e)
+	{
+#if MANIFEST_LOG_PRINTF <= LOG_LEVEL_ERROR
+		printf ( "ERROR in reading manifest %s - %s\n", filename, e.what() );
+#endif
+		Clear();
+		return false;
+	}
+
+	// lookup table is used only while building
+	mStringsMap.clear();
+
+	return true;
+}
+
+bool CGPUCacheManifest::SaveBinary( const char *filename ) const
+{
+	FILE *fp = nullptr;
+	fopen_s( &fp, filename, "wb" );
+
+	if (fp == nullptr)
+	{
+#if MANIFEST_LOG_PRINTF <= LOG_LEVEL_ERROR
+		printf( "Failed to open manifest file for writing - %s\n", filename );
+#endif
+		return false;
+	}
+
+	FileManifestHeader header = mHeader;
+
+	header.tag = MANIFEST_FILE_TAG;
+	header.version = MANIFEST_FILE_VERSION;
+	header.numberOfTextures = (int) mTextures.size();
+	header.numberOfMaterials = (int) mMaterials.size();
+	header.numberOfShaders = (int) mShaders.size();
+	header.numberOfModels = (int) mModels.size();
+	header.numberOfPatches = (int) mPatches.size();
+
+	// blocks go one by one after the header
+	int64_t offset = sizeof(FileManifestHeader);
+
+	header.texturesOffset = offset;
+	offset += sizeof(ManifestTexture) * mTextures.size();
+	header.materialsOffset = offset;
+	offset += sizeof(ManifestMaterial) * mMaterials.size();
+	header.shadersOffset = offset;
+	offset += sizeof(ManifestShader) * mShaders.size();
+	header.modelsOffset = offset;
+	offset += sizeof(ManifestModel) * mModels.size();
+	header.patchesOffset = offset;
+	offset += sizeof(ManifestPatch) * mPatches.size();
+	header.stringsOffset = offset;
+	header.stringsSize = (int64_t) mStrings.size();
+
+	bool result = true;
+
+	auto fn_writeSafe = [&fp, &result] (const void *data, const size_t size) {
+		if (size > 0 && result && 1 != fwrite( data, size, 1, fp ) )
+			result = false;
+	};
+
+	fn_writeSafe( &header, sizeof(FileManifestHeader) );
+	fn_writeSafe( mTextures.data(), sizeof(ManifestTexture) * mTextures.size() );
+	fn_writeSafe( mMaterials.data(), sizeof(ManifestMaterial) * mMaterials.size() );
+	fn_writeSafe( mShaders.data(), sizeof(ManifestShader) * mShaders.size() );
+	fn_writeSafe( mModels.data(), sizeof(ManifestModel) * mModels.size() );
+	fn_writeSafe( mPatches.data(), sizeof(ManifestPatch) * mPatches.size() );
+	fn_writeSafe( mStrings.data(), mStrings.size() );
+
+	fclose(fp);
+
+	if (false == result)
+	{
+#if MANIFEST_LOG_PRINTF <= LOG_LEVEL_ERROR
+		printf( "error while writing manifest - %s\n", filename );
+#endif
+	}
+
+	return result;
+}
+
+//
+// GPU DATA
+
+void CGPUCacheManifest::ConstructMaterial( const ManifestMaterial &record, MaterialGLSL &mat )
+{
+	memset( &mat, 0, sizeof(MaterialGLSL) );
+
+	mat.diffuseColor = vec4( record.diffuseColor[0], record.diffuseColor[1], record.diffuseColor[2], record.diffuseColor[3] );
+	mat.diffuse = record.diffuse;
+	mat.useDiffuse = record.useDiffuse;
+}
+
+void CGPUCacheManifest::ConstructShader( const ManifestShader &record, ShaderGLSL &shader )
+{
+	DefaultShader( shader );
+
+	shader.shaderType = record.shaderType;
+	shader.shadingType = record.shadingType;
+	shader.transparency = record.transparency;
+
+	shader.toonEnabled = record.toonEnabled;
+	shader.toonSteps = record.toonSteps;
+	shader.toonDistribution = record.toonDistribution;
+	shader.toonShadowPosition = record.toonShadowPosition;
+
+	shader.customColor = vec4( record.customColor[0], record.customColor[1], record.customColor[2], record.customColor[3] );
+	shader.contrast = record.contrast;
+	shader.saturation = record.saturation;
+	shader.brightness = record.brightness;
+	shader.gamma = record.gamma;
+
+	shader.applyColorCorrection = 0.0f;
+
+	if ( 3 != (int) shader.customColor[3] )
+		shader.applyColorCorrection = 1.0f;
+	else if (shader.customColor[0] != 1.0f || shader.customColor[1] != 1.0f || shader.customColor[2] != 1.0f)
+		shader.applyColorCorrection = 1.0f;
+	else if (shader.contrast != 1.0f || shader.brightness != 1.0f || shader.saturation != 1.0f)
+		shader.applyColorCorrection = 1.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// converter
+
+bool ConvertManifestToBinary( const char *xmlFilename )
+{
+	CGPUCacheManifest	manifest;
+
+	if (false == manifest.LoadFromXML(xmlFilename) )
+		return false;
+
+	return manifest.SaveBinary( MakeManifestFilename(xmlFilename).c_str() );
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_manifest.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_types.h"
+#include "shared_glsl.h"
+
+#include "IO/tinyxml.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// <cache>_Manifest.pck for the <cache>.xml
+std::string MakeManifestFilename( const char *xmlFilename );
+
+///////////////////////////////////////////////////////////////////////////
+// cache description (textures, materials, shaders, models and patches)
+//	could be read from the xml or from the binary manifest pack,
+//	loader works with records only, so both sources give the same visitor callbacks
+
+class CGPUCacheManifest
+{
+public:
+
+	//! a constructor
+	CGPUCacheManifest();
+
+	void Clear();
+
+	// parse a cache xml document
+	bool ReadFromXML( const TiXmlDocument &doc );
+	bool LoadFromXML( const char *filename );
+
+	bool LoadBinary( const char *filename );
+	bool SaveBinary( const char *filename ) const;
+
+	const char *GetString( const int offset ) const
+	{
+		return (offset >= 0 && offset < (int) mStrings.size()) ? &mStrings[offset] : "";
+	}
+
+	const char *GetSourceFilename() const
+	{
+		return GetString(mHeader.sourceFilename);
+	}
+
+	const FileManifestHeader &GetHeader() const
+	{
+		return mHeader;
+	}
+
+	const std::vector<ManifestTexture> &GetTextures() const
+	{
+		return mTextures;
+	}
+	const std::vector<ManifestMaterial> &GetMaterials() const
+	{
+		return mMaterials;
+	}
+	const std::vector<ManifestShader> &GetShaders() const
+	{
+		return mShaders;
+	}
+	const std::vector<ManifestModel> &GetModels() const
+	{
+		return mModels;
+	}
+	const std::vector<ManifestPatch> &GetPatches() const
+	{
+		return mPatches;
+	}
+
+	// construct gpu data from records
+	static void ConstructMaterial( const ManifestMaterial &record, MaterialGLSL &mat );
+	static void ConstructShader( const ManifestShader &record, ShaderGLSL &shader );
+
+protected:
+
+	FileManifestHeader				mHeader;
+
+	std::vector<char>				mStrings;
+	std::unordered_map<std::string, int>	mStringsMap;	// remove duplicates while building
+
+	std::vector<ManifestTexture>	mTextures;
+	std::vector<ManifestMaterial>	mMaterials;
+	std::vector<ManifestShader>		mShaders;
+	std::vector<ManifestModel>		mModels;
+	std::vector<ManifestPatch>		mPatches;
+
+	int		AddString( const char *str );
+
+	void	ReadTexturesFromXML( const TiXmlElement *parentElem );
+	void	ReadMaterialsFromXML( const TiXmlElement *parentElem );
+	void	ReadShadersFromXML( const TiXmlElement *parentElem );
+	void	ReadModelsFromXML( const TiXmlElement *parentElem );
+};
+
+// write a binary manifest next to the existing xml cache
+bool ConvertManifestToBinary( const char *xmlFilename );
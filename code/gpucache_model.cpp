@@ -39,6 +39,11 @@ CGPUCacheModel::CGPUCacheModel()
 	LogarithmicDepth = false;
 	SampleAlphaToCoverage = false;
 	AlphaPass = 0.25f;
+	UseLods = false;
+	LodPixelError = 1.0f;
+	LodHysteresis = 0.25f;
+	ShareTextures = false;
+	ShareGeometry = false;
 
 	//
 	mParentTransform.identity();
@@ -183,6 +188,18 @@ void CGPUCacheModel::PrepRender( const CCameraInfoCache &cameraCache,
 	if (mModelRender)
 	{
 		mat4 m4_parent (mParentTransform);
+
+		if (UseLods)
+		{
+			// model bounds are in the cache space
+			CCameraInfoCache cacheCamera(cameraCache);
+			mat4 m4_parentInv;
+			invert(m4_parentInv, m4_parent);
+			cacheCamera.pos = m4_parentInv * vec4(cameraCache.pos.x, cameraCache.pos.y, cameraCache.pos.z, 1.0f);
+
+			mModelRender->SelectLods(cacheCamera, LodPixelError, LodHysteresis);
+		}
+
 		mModelRender->UpdateGPUBuffer(&m4_parent, &mCameraCache->mv4);
 	}
 }
@@ -624,6 +641,102 @@ void CGPUCacheModel::PassLighted(const bool cubemapSetup, const bool opaque, con
 	CHECK_GL_ERROR();
 }
 
+bool CGPUCacheModel::AddToBatch( CGeometryBatch &batch )
+{
+	if (nullptr == mModelRender)
+		return false;
+
+	GeometryBatchItem item;
+	GeometryBatchItem::Clear(item);
+
+	if (false == mModelRender->FillBatchItem(item) )
+		return false;
+
+	item.transform = mParentTransform.mat_array;
+
+	item.textures = mTextures->GetDataPtr();
+	item.numberOfTextures = (int) mTextures->GetDataSize();
+	item.materials = mMaterials->GetDataPtr();
+	item.numberOfMaterials = (int) mMaterials->GetDataSize();
+	item.shaders = mShaders->GetDataPtr();
+	item.numberOfShaders = (int) mShaders->GetDataSize();
+
+	return batch.Add(item);
+}
+
+bool CGPUCacheModel::RenderBatch( CGPUCacheModel **models, const int numberOfModels, CGeometryBatch &batch,
+					Graphics::BaseMaterialShaderFX *const pMaterialShader, const bool opaque, const bool transparency )
+{
+	if (nullptr == pMaterialShader || nullptr == models || numberOfModels <= 0)
+		return false;
+
+	batch.Begin();
+
+	for (int i=0; i<numberOfModels; ++i)
+	{
+		if (false == models[i]->AddToBatch(batch) )
+			return false;
+	}
+
+	if (false == batch.Prepare() )
+		return false;
+
+	// cache matrices are in the merged model records
+	mat4 m4_identity;
+	m4_identity.identity();
+
+	pMaterialShader->UploadModelTransform(m4_identity);
+	pMaterialShader->ModifyShaderFlags( Graphics::eShaderFlag_Bindless, true );
+	pMaterialShader->ModifyShaderFlags( Graphics::eShaderFlag_EarlyZ, false );
+
+	// make textures resident, the merged texture records have the handles of the caches
+	for (int i=0; i<numberOfModels; ++i)
+		models[i]->mTextures->Lock();
+
+	BindUberShader(pMaterialShader, false, nullptr, nullptr, nullptr, vec4(0.1f, 0.1f, 0.1f, 0.0f), false);
+
+	const GLuint fragmentProgram = pMaterialShader->GetFragmentProgramId();
+	if (fragmentProgram > 0)
+	{
+		auto locPtr = pMaterialShader->GetCurrentEffectLocationsPtr()->fptr();
+		batch.BindShadersAsUniform(fragmentProgram, locPtr->GetLocation(Graphics::eCustomLocationAllTheShaders));
+		batch.BindTexturesAsUniform(fragmentProgram, locPtr->GetLocation(Graphics::eCustomLocationAllTheTextures));
+		batch.BindMaterialsAsUniform(fragmentProgram, locPtr->GetLocation(Graphics::eCustomLocationAllTheMaterials));
+	}
+
+	auto locPtr = pMaterialShader->GetCurrentEffectLocationsPtr()->vptr();
+	batch.BindModelInfoAsUniform( locPtr->GetShaderId(), locPtr->GetLocation(Graphics::eCustomVertexLocationAllTheModels));
+	batch.BindMeshInfoAsUniform( locPtr->GetShaderId(), locPtr->GetLocation(Graphics::eCustomVertexLocationAllTheMeshes));
+
+	batch.RenderBegin();
+
+	if (opaque)
+	{
+		pMaterialShader->UpdateAlphaPass(0.0f);
+		batch.RenderOpaque();
+	}
+
+	// alpha pass of the first cache is used for all of them
+	if (transparency)
+	{
+		pMaterialShader->UpdateAlphaPass( (float) models[0]->AlphaPass );
+		batch.RenderTransparency();
+	}
+
+	batch.RenderEnd();
+
+	for (int i=0; i<numberOfModels; ++i)
+		models[i]->mModelRender->ResetCulling();
+
+	UnBindUberShader(pMaterialShader, false, nullptr, false);
+
+	for (int i=0; i<numberOfModels; ++i)
+		models[i]->mTextures->UnLock();
+
+	CHECK_GL_ERROR();
+	return true;
+}
+
 const char *CGPUCacheModel::GetSourceFilename() const
 {
 	return mSourceFilename.c_str();
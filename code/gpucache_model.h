@@ -90,6 +90,14 @@ public:
 
 	void DrawGeometry( const CCameraInfoCache &cameraCache );
 
+	// records of the frame for the merged draw, false when the cache can't be batched (see CGPUModelRenderCached::FillBatchItem)
+	bool AddToBatch( CGeometryBatch &batch );
+
+	// caches of the geometry heap (after their PrepRender) are drawn by one multi draw for the opaque
+	//	and one for the transparency, returns false when any cache can't be batched, nothing is drawn then
+	static bool RenderBatch( CGPUCacheModel **models, const int numberOfModels, CGeometryBatch &batch,
+					Graphics::BaseMaterialShaderFX *const pMaterialShader, const bool opaque, const bool transparency );
+
 public:
 
 	bool			OverrideShading;
@@ -97,6 +105,19 @@ public:
 	bool			LogarithmicDepth;
 	bool			SampleAlphaToCoverage;
 	float			AlphaPass;
+
+	// distance lod of the cached models, level is chosen in PrepRender by the projected simplification error
+	bool			UseLods;
+	float			LodPixelError;
+	float			LodHysteresis;
+
+	// images of the packs with content digests are taken from the process textures registry,
+	//	the same image of the other caches is not uploaded again
+	bool			ShareTextures;
+
+	// vertex streams go to the ranges of the process geometry heap, caches share the same vertex and index buffers,
+	//	such caches could be drawn together by one multi draw with RenderBatch
+	bool			ShareGeometry;
 	
 	inline void GetBoundingBox(float *bmin, float *bmax)
 	{
@@ -13,13 +13,16 @@
 
 
 #include "gpucache_saver.h"
+#include "gpucache_manifest.h"
 
-#include <io.h>
-#include <fcntl.h>
-#include <sys\types.h>
-#include <sys\stat.h>
+#include "algorithm/VertexQuantization.h"
+#include "algorithm/MeshOptimize.h"
 
-#include "nv_dds\nv_dds.h"
+#include "IO/FileIO.h"
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // CGPUCacheSaver
@@ -27,6 +30,25 @@
 CGPUCacheSaver::CGPUCacheSaver()
 {
 	mQuery = nullptr;
+	mQuantizeVertices = false;
+	mOptimizeIndices = false;
+	mDetectInstances = false;
+	mBuildClusters = false;
+	mClusterMaxVertices = MESH_CLUSTER_MAX_VERTICES;
+	mClusterMaxTriangles = MESH_CLUSTER_MAX_TRIANGLES;
+	mNumberOfClusters = 0;
+	mBuildLods = false;
+	mNumberOfLods = 3;
+	mLodRatio = 0.5f;
+	mLodMaxError = 0.05f;
+	mNumberOfLodIndices = 0;
+
+	mNumberOfInstances = 0;
+	mUniqueNumberOfVertices = 0;
+	mUniqueNumberOfIndices = 0;
+
+	VertexCacheStatistics::Clear(mCacheStatsBefore);
+	VertexCacheStatistics::Clear(mCacheStatsAfter);
 }
 
 bool CGPUCacheSaver::Save(const char *filename, CGPUCacheSaverQuery *pQuery )
@@ -125,6 +147,17 @@ bool CGPUCacheSaver::Save(const char *filename, CGPUCacheSaverQuery *pQuery )
 		return false;
 	}
 
+	// binary manifest with the same content, loader prefers it to the xml
+	const std::string manifest_filename = MakeManifestFilename(filename);
+
+	CGPUCacheManifest	manifest;
+	if (false == manifest.ReadFromXML(doc) || false == manifest.SaveBinary( manifest_filename.c_str() ) )
+	{
+		// don't leave an old manifest, it would be loaded instead of the new xml
+		remove( manifest_filename.c_str() );
+		printf( "Cache Error - failed to write a binary manifest\n" );
+	}
+
 	// store geometry and texture resources
 	std::string		geometry_filename( filename );
 
@@ -132,22 +165,85 @@ bool CGPUCacheSaver::Save(const char *filename, CGPUCacheSaverQuery *pQuery )
 	geometry_filename.erase( iter );
 	geometry_filename.append( "_Geometry.pck" );
 	
+	// written records are read back to compare the instance candidates
 	FILE *modelFile = nullptr;
-	int err = fopen_s( &modelFile, geometry_filename.c_str(), "wb" );
+	int err = fopen_s( &modelFile, geometry_filename.c_str(), (mDetectInstances) ? "w+b" : "wb" );
 	try
 	{
 		if (err != 0)
 			throw "Failed to open geometry file for writing";
 
 		FileGeometryHeader geomHeader;
-		FileGeometryHeader::Set( 1, numberOfModels, verticesCount, indicesCount, geomHeader );
+		const short geomVersion = (mDetectInstances || mBuildClusters || mBuildLods) ? GEOMETRY_FILE_VERSION_3 
+			: (mQuantizeVertices || mOptimizeIndices) ? GEOMETRY_FILE_VERSION_2 : GEOMETRY_FILE_VERSION;
+		FileGeometryHeader::Set( geomVersion, numberOfModels, verticesCount, indicesCount, geomHeader );
 
 		fwrite( &geomHeader, sizeof(FileGeometryHeader), 1, modelFile );
 
+		VertexCacheStatistics::Clear(mCacheStatsBefore);
+		VertexCacheStatistics::Clear(mCacheStatsAfter);
+
+		mRecordHeaders.clear();
+		mRecordHashes.clear();
+		mNumberOfInstances = 0;
+		mNumberOfClusters = 0;
+		mNumberOfLodIndices = 0;
+		mUniqueNumberOfVertices = 0;
+		mUniqueNumberOfIndices = 0;
+
+		std::vector<FileTocEntry>	toc(numberOfModels);
+
 		for (int i=0; i<numberOfModels; ++i)
 		{
+			const int64_t recordOffset = _ftelli64(modelFile);
+
 			if (false == WriteModelGeometry(  modelFile, i ) )
 				throw "Failed to save geometry model to cache";
+
+			// the same bounds as in the manifest model
+			vec4 bmin, bmax;
+			mQuery->GetModelBoundingBox(i, bmin, bmax);
+
+			const float tocMin[3] = { (float) bmin[0], (float) bmin[1], (float) bmin[2] };
+			const float tocMax[3] = { (float) bmax[0], (float) bmax[1], (float) bmax[2] };
+
+			FileTocEntry::Set( mQuery->GetModelName(i), recordOffset, _ftelli64(modelFile) - recordOffset, i, tocMin, tocMax, toc[i] );
+		}
+
+		// table of contents for a partial loading
+		if (false == WriteToc( modelFile, toc ) )
+			throw "Failed to write geometry table of contents";
+
+		// merged streams of the loader are allocated for the records with own streams only, lod levels are included
+		if (geomVersion >= GEOMETRY_FILE_VERSION_3)
+		{
+			FileGeometryHeader::Set( geomVersion, numberOfModels, (int) mUniqueNumberOfVertices, (int) mUniqueNumberOfIndices, geomHeader );
+
+			_fseeki64( modelFile, 0, SEEK_SET );
+			if (1 != fwrite( &geomHeader, sizeof(FileGeometryHeader), 1, modelFile ) )
+				throw "Failed to write geometry file header";
+		}
+
+		if (mDetectInstances)
+		{
+			printf( "Cache - %d instance records of %d models, unique vertices %u of %u, indices %u of %u\n", mNumberOfInstances, numberOfModels,
+				mUniqueNumberOfVertices, verticesCount, mUniqueNumberOfIndices - mNumberOfLodIndices, indicesCount );
+		}
+
+		if (mBuildClusters)
+		{
+			printf( "Cache - %d triangle clusters, %.1f triangles per cluster\n", mNumberOfClusters, 
+				(mNumberOfClusters > 0) ? (double) (mUniqueNumberOfIndices - mNumberOfLodIndices) / 3.0 / (double) mNumberOfClusters : 0.0 );
+		}
+		if (mBuildLods)
+		{
+			printf( "Cache - lod levels %u indices, %.1f%% of the source indices\n", mNumberOfLodIndices,
+				(mUniqueNumberOfIndices > mNumberOfLodIndices) ? 100.0 * mNumberOfLodIndices / (double) (mUniqueNumberOfIndices - mNumberOfLodIndices) : 0.0 );
+		}
+		if (mOptimizeIndices)
+		{
+			printf( "Cache - vertex cache (fifo %d) ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", MESH_SIMULATE_CACHE_SIZE,
+				mCacheStatsBefore.acmr, mCacheStatsAfter.acmr, mCacheStatsBefore.atvr, mCacheStatsAfter.atvr );
 		}
 	}
 	catch (const char *error)
@@ -173,8 +269,6 @@ bool CGPUCacheSaver::SaveTextures(const char *filename, CGPUCacheSaverQuery *pQu
 	//
 	// store samplers/image data
 	
-	BYTE *localImageBuffer = new BYTE[16384 * 16384 * 4];
-	
 	int fh=0;
 
 	printf ("try to open a file\n" );
@@ -182,14 +276,18 @@ bool CGPUCacheSaver::SaveTextures(const char *filename, CGPUCacheSaverQuery *pQu
 	//
 	
 
-	errno_t err = _sopen_s( &fh, filename, _O_BINARY | _O_CREAT | _O_WRONLY | _O_TRUNC, _SH_DENYRW, _S_IREAD | _S_IWRITE);
+	// duplicate candidates are read back to compare them
+	const bool digests = mTextureExporter.IsDigests();
+	const int accessMode = (digests) ? _O_RDWR : _O_WRONLY;
+
+	errno_t err = _sopen_s( &fh, filename, _O_BINARY | _O_CREAT | accessMode | _O_TRUNC, _SH_DENYRW, _S_IREAD | _S_IWRITE);
 
 	try
 	{
 
 		printf ("%d %d\n", err, fh );
 		if ( err != 0)
-			throw std::exception("Failed to open textures file for writing\n");
+			throw std::runtime_error("Failed to open textures file for writing\n");
 
 		_lseeki64( fh, 0, 0 );
 
@@ -199,48 +297,31 @@ bool CGPUCacheSaver::SaveTextures(const char *filename, CGPUCacheSaverQuery *pQu
 		// !!!
 		// added version 2 format - support image sequences
 
-		FileTexturesHeader texHeader;
-		FileTexturesHeader::Set( 2, numberOfMedias, numberOfSamplers, texHeader );
-		texHeader.imagesOffset = 0;
-		texHeader.samplersOffset = 0;
+		// version 3 - content digests of the images
 
-		int bytteswritten = _write( fh, &texHeader, sizeof(texHeader) );
+		FileTexturesHeader3 texHeader;
+		FileTexturesHeader3::Set( numberOfMedias, numberOfSamplers, texHeader );
+
+		if (false == digests)
+			texHeader.version = TEXTURES_FILE_VERSION_2;
+
+		const int texHeaderSize = (digests) ? sizeof(FileTexturesHeader3) : sizeof(FileTexturesHeader);
+		int bytteswritten = _write( fh, &texHeader, texHeaderSize );
 		
-		if (bytteswritten != sizeof(texHeader))
-			throw std::exception("Failed to save texture file header");
+		if (bytteswritten != texHeaderSize)
+			throw std::runtime_error("Failed to save texture file header");
 
 		// STORE image data first of all
 		//
 
 		texHeader.imagesOffset = _telli64(fh);
 
-		for (int i=0; i<numberOfMedias; ++i)
-		{
-			const char *szVideoName = pQuery->GetVideoName(i);
-			printf( "save video data %d - %s\n", i, szVideoName );
+		// image records are prepared by workers and written here in the same order
+		if (false == mTextureExporter.WriteImages( fh, pQuery, filename ) )
+			throw std::runtime_error("Failed to save image data - ");
 
-			const char *szFilename = pQuery->GetVideoFilename(i);
-			if (szFilename && strstr( (char*)filename, ".dds" ) != nullptr )
-			{
-				
-				if (false == SaveDDSData( fh, filename ) )
-					throw std::exception("Failed to save DDS data - ");
-	
-			}
-			else if (nullptr != szFilename)
-			{
-				if (false == SaveImageSimple( fh, i ) )
-					throw std::exception("Failed to save simple image data - ");
-			}
-			else
-			{
-				
+		mTextureExporter.PrintStats();
 
-				// write empty texture
-				if (false == SaveImageEmpty( fh ) )
-					throw std::exception("Failed to save empty image data - ");
-			}
-		}
 		/*
 		if (canDoCompression == false)
 		{
@@ -254,19 +335,61 @@ bool CGPUCacheSaver::SaveTextures(const char *filename, CGPUCacheSaverQuery *pQu
 
 		for (int i=0; i<numberOfSamplers; ++i)
 		{
-			const int videoId = pQuery->GetSamplerVideoIndex(i);
+			int videoId = pQuery->GetSamplerVideoIndex(i);
+
+			// duplicated image refers to the first copy
+			if (digests && videoId >= 0 && videoId < numberOfMedias)
+				videoId = mTextureExporter.GetImageRemap()[videoId];
 
 			if (false == SaveSampler( fh, i, videoId ) )
-				throw std::exception("Failed to save sampler for texture\n");
+				throw std::runtime_error("Failed to save sampler for texture\n");
+		}
+
+		const char digestsPadding[8] = { 0 };
+
+		if (digests)
+		{
+			const int paddingSize = (int) ((8 - _telli64(fh) % 8) % 8);
+
+			if (paddingSize > 0 && paddingSize != _write( fh, digestsPadding, paddingSize ) )
+				throw std::runtime_error("Failed to write textures digests\n");
+
+			texHeader.digestsOffset = _telli64(fh);
+
+			const std::vector<uint64_t> &imageDigests = mTextureExporter.GetDigests();
+			const int digestsSize = (int) (sizeof(uint64_t) * imageDigests.size());
+
+			if (digestsSize > 0 && digestsSize != _write( fh, imageDigests.data(), digestsSize ) )
+				throw std::runtime_error("Failed to write textures digests\n");
 		}
 
+		// table of contents for a partial loading
+		const std::vector<FileTocEntry> &toc = mTextureExporter.GetToc();
+
+		const char tocPadding[8] = { 0 };
+		const int tocPaddingSize = (int) ((8 - _telli64(fh) % 8) % 8);
+
+		if (tocPaddingSize > 0 && tocPaddingSize != _write( fh, tocPadding, tocPaddingSize ) )
+			throw std::runtime_error("Failed to write textures table of contents\n");
+
+		FileTocFooter	tocFooter;
+		FileTocFooter::Set( (int) toc.size(), _telli64(fh), tocFooter );
+
+		const int tocSize = (int) (sizeof(FileTocEntry) * toc.size());
+
+		if (tocSize > 0 && tocSize != _write( fh, toc.data(), tocSize ) )
+			throw std::runtime_error("Failed to write textures table of contents\n");
+		
+		if (sizeof(FileTocFooter) != _write( fh, &tocFooter, sizeof(FileTocFooter) ) )
+			throw std::runtime_error("Failed to write textures table of contents\n");
+
 		// rewrite header with offsets
 		_lseeki64(fh, 0, 0);
 		
-		bytteswritten = _write( fh, &texHeader, sizeof(FileTexturesHeader) );
+		bytteswritten = _write( fh, &texHeader, texHeaderSize );
 
-		if (bytteswritten != sizeof(FileTexturesHeader) )
-			throw std::exception("Failed to write textures file header\n");
+		if (bytteswritten != texHeaderSize )
+			throw std::runtime_error("Failed to write textures file header\n");
 
 		printf ( "images offset - %u, samplers offset - %u\n", texHeader.imagesOffset, texHeader.samplersOffset );
 	}
@@ -277,15 +400,27 @@ bool CGPUCacheSaver::SaveTextures(const char *filename, CGPUCacheSaverQuery *pQu
 
 	if (fh > 0) _close(fh);
 
-	if (localImageBuffer)
-	{
-		delete [] localImageBuffer;
-		localImageBuffer = nullptr;
-	}
-
 	return true;
 }
 
+bool CGPUCacheSaver::WriteToc( FILE *modelFile, const std::vector<FileTocEntry> &toc )
+{
+	// align entries to 8 bytes
+	const char padding[8] = { 0 };
+	const size_t paddingSize = (size_t) ((8 - _ftelli64(modelFile) % 8) % 8);
+
+	if (paddingSize > 0 && 1 != fwrite( padding, paddingSize, 1, modelFile ) )
+		return false;
+
+	FileTocFooter	footer;
+	FileTocFooter::Set( (int) toc.size(), _ftelli64(modelFile), footer );
+
+	if (toc.size() > 0 && toc.size() != fwrite( toc.data(), sizeof(FileTocEntry), toc.size(), modelFile ) )
+		return false;
+
+	return (1 == fwrite( &footer, sizeof(FileTocFooter), 1, modelFile ) );
+}
+
 bool CGPUCacheSaver::WriteLightsToXML( TiXmlElement *parentElem )
 {
 	if (parentElem == nullptr)
@@ -305,83 +440,6 @@ bool CGPUCacheSaver::WriteLightsToXML( TiXmlElement *parentElem )
 }
 
 
-bool CGPUCacheSaver::SaveDDSData( int fh, const char *filename )
-{
-	nv_dds::CDDSImage	image;
-
-	if (false == image.load( filename ) )
-		return false;
-
-	const short width = (short) image.get_width();
-	const short height = (short) image.get_height();
-
-	const GLint internalFormat = image.get_format();
-	const GLint format = (image.get_components() == 4) ? GL_RGBA : GL_RGB;
-
-	const GLint imageSize = (GLint) image.get_size();
-	const unsigned char numberOfLods = (unsigned char) image.get_num_mipmaps();
-
-	// store header
-	ImageHeader2 header;
-	ImageHeader2::Set( width, height, internalFormat, format, imageSize, 0, numberOfLods, header);
-	
-	long long pos = _telli64(fh);
-	printf( "current file position - %u\n", pos );
-
-	printf( "writing dds - %d, %d, size %d\n", width, height, imageSize );
-
-	int byttesWritten = 0;
-
-	try
-	{
-		byttesWritten = _write(fh, &header, sizeof(header) );
-
-		if (byttesWritten != sizeof(header))
-			throw std::exception( "error while writing a texture header!\n" );
-			
-		const unsigned char *imageData = image;
-
-		// store texture
-		if (imageSize > 0 && imageData != nullptr)
-		{
-			byttesWritten = _write( fh, imageData, sizeof(BYTE) * imageSize );
-	
-			if (byttesWritten != imageSize * sizeof(BYTE))
-				throw std::exception( "error while writing a texture data\n" );
-		}
-
-		// store lods
-		for (int i=0; i<numberOfLods; ++i)
-		{
-
-			nv_dds::CSurface mipmap = image.get_mipmap(i);
-
-			// get lod and save it
-			ImageLODHeader2	lodHeader;
-			ImageLODHeader2::Set( mipmap.get_width(), mipmap.get_height(), mipmap.get_size(), lodHeader );
-
-			byttesWritten = _write( fh, &lodHeader, sizeof(lodHeader) );
-			if (byttesWritten != sizeof(lodHeader) )
-				throw std::exception( "error while writing a mipmap header!\n" );
-				
-			//
-			const unsigned char *mipmapData = mipmap;
-			byttesWritten = _write( fh, mipmapData, mipmap.get_size() );
-	
-			if (byttesWritten != (int) mipmap.get_size() )
-				throw std::exception( "error while writing a mipmap data\n" );
-		}
-	}
-	catch (std::exception &e)
-	{
-		printf( "%s\n", e.what() );
-		return false;
-	}
-
-	return true;
-}
-
-
 bool CGPUCacheSaver::SaveSampler( int fh, const int index, const int videoIndex )
 {
 	mat4 mf;
@@ -435,125 +493,6 @@ bool CGPUCacheSaver::WriteTexturesToXML( TiXmlElement *parentItem )
 	return true;
 }
 
-bool CGPUCacheSaver::SaveImageEmpty( int fh )
-{
-	//
-	auto fn_writeSafe = [] (const int fh, void *data, const int size) {
-
-		if (size != _write(fh, data, size ) )
-			throw std::exception( "error while writing data!\n" );
-
-	};
-
-	int numberOfFrames = 0;
-	int imageSize=0;
-
-	ImageHeader2			header;
-	ImageSequenceHeader2	seqHeader;
-
-	__int64 pos = _telli64(fh);
-	printf( "current file position - %u\n", pos );
-	printf( "writing image - size %d\n", imageSize );
-
-	BYTE imageType = IMAGE_TYPE_STILL;
-
-	try
-	{
-		imageType = IMAGE_TYPE_STILL;
-
-		GLubyte	*imageData = nullptr;
-
-		fn_writeSafe( fh, &imageType, sizeof(BYTE) );
-			
-		if (imageData == nullptr)
-		{
-			header.width = 0;
-			header.height = 0;
-			header.size = 0;
-			header.numberOfLODs = 0;
-		}
-
-			
-		fn_writeSafe( fh, &header, sizeof(header) );
-
-		// OpenGL texture limitation
-		if (imageData != nullptr)
-			fn_writeSafe( fh, imageData, sizeof(BYTE) * header.size );
-			
-	}
-	catch (std::exception &e)
-	{
-		printf( "%s\n", e.what() );
-		return false;
-	}
-
-	return true;
-}
-
-
-bool CGPUCacheSaver::SaveImageSimple( int fh, const int index )
-{
-	//
-	auto fn_writeSafe = [] (const int fh, const void *data, const int size) {
-
-		if (size != _write(fh, data, size ) )
-			throw std::exception( "error while writing data!\n" );
-
-	};
-
-	int numberOfFrames = 0;
-	int imageSize=mQuery->GetVideoSize(index);
-
-	ImageHeader2			header;
-	ImageSequenceHeader2	seqHeader;
-
-	__int64 pos = _telli64(fh);
-	printf( "current file position - %u\n", pos );
-	printf( "writing image - size %d\n", imageSize );
-
-	BYTE imageType = IMAGE_TYPE_STILL;
-
-	try
-	{
-		imageType = IMAGE_TYPE_STILL;
-
-		const GLubyte	*imageData = mQuery->GetVideoData(index);
-
-		fn_writeSafe( fh, &imageType, sizeof(BYTE) );
-			
-		if (imageData == nullptr)
-		{
-			header.width = 0;
-			header.height = 0;
-			header.size = 0;
-			header.numberOfLODs = 0;
-		}
-		else
-		{
-			GLint internalFormat, format;
-			mQuery->GetVideoFormat( index, internalFormat, format );
-			
-			ImageHeader2::Set(mQuery->GetVideoWidth(index), mQuery->GetVideoHeight(index),
-				internalFormat, format, mQuery->GetVideoSize(index), 0, 1, header );
-		}
-
-			
-		fn_writeSafe( fh, &header, sizeof(header) );
-
-		// OpenGL texture limitation
-		if (imageData != nullptr)
-			fn_writeSafe( fh, imageData, sizeof(BYTE) * header.size );
-			
-	}
-	catch (std::exception &e)
-	{
-		printf( "%s\n", e.what() );
-		return false;
-	}
-
-	return true;
-}
-
 bool CGPUCacheSaver::WriteModelToXML( const int modelIndex, TiXmlElement *models )
 {
 	TiXmlElement modelItem("Model");
@@ -641,6 +580,54 @@ bool CGPUCacheSaver::WriteModelToXML( const int modelIndex, TiXmlElement *models
 	return true;
 }
 
+// copy of the vertex stream in a new vertex order
+static const float *RemapStream( const float *data, const int stride, const int count, const unsigned int *remap, std::vector<BYTE> &buffer )
+{
+	if (data == nullptr || stride <= 0)
+		return data;
+
+	buffer.resize( (size_t) stride * count );
+	RemapVertexBuffer( buffer.data(), data, count, stride, remap );
+	return (const float*) buffer.data();
+}
+
+// 64 bit FNV-1a of the stored streams and the header fields which define their layout
+//	streams are hashed by 8 byte words, candidates are compared byte by byte anyway
+//	local points are hashed as they are, so the same mesh with a different baked transform gives a different hash
+static uint64_t HashStreams( const VertexDataHeader3 &header, const void **streams, const size_t *streamSizes )
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	auto fn_hash = [&hash] (const void *data, const size_t size) {
+		const BYTE *ptr = (const BYTE*) data;
+		size_t i = 0;
+		for ( ; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			memcpy( &word, ptr + i, 8 );
+			hash ^= word;
+			hash *= 1099511628211ULL;
+		}
+		for ( ; i<size; ++i)
+		{
+			hash ^= (uint64_t) ptr[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+
+	fn_hash( &header.numVertices, sizeof(int) );
+	fn_hash( &header.numIndices, sizeof(int) );
+	fn_hash( header.boundsMin, sizeof(float) * 3 );
+	fn_hash( header.boundsSize, sizeof(float) * 3 );
+
+	for (int i=0; i<5; ++i)
+	{
+		if (streams[i] != nullptr)
+			fn_hash( streams[i], streamSizes[i] );
+	}
+	return hash;
+}
+
 bool CGPUCacheSaver::WriteModelGeometry( FILE *modelFile, const int index )
 {	
 //bool CGPUVertexData::SaveModel( FILE *fp, FBModelVertexData *pVertexData, FBMatrix *tm )
@@ -672,10 +659,7 @@ bool CGPUCacheSaver::WriteModelGeometry( FILE *modelFile, const int index )
 		int offset, size, matId;
 		mQuery->GetModelSubPatchInfo( index, i, offset, size, matId );
 		
-#ifndef max
-#define max(a,b) (a>b)?a:b
-#endif
-		numberOfIndices = max( numberOfIndices, offset+size );
+		numberOfIndices = std::max( numberOfIndices, offset+size );
 	}
 
 	// we have strong specified strides for arrays
@@ -684,20 +668,175 @@ bool CGPUCacheSaver::WriteModelGeometry( FILE *modelFile, const int index )
 	if (tangentStride != gTangentStride) tangentStride = 0;
 	if (uvStride != gUVStride) uvStride = 0;
 
+	// indices are stored as unsigned int or unsigned short
+	std::vector<unsigned int>	newIndices(numberOfIndices);
+	for (int i=0; i<numberOfIndices; ++i)
+		newIndices[i] = (unsigned int) indices[i];
+
+	std::vector<BYTE>	remappedPoints;
+	std::vector<BYTE>	remappedNormals;
+	std::vector<BYTE>	remappedTangents;
+	std::vector<BYTE>	remappedUVs;
+
+	if (mOptimizeIndices)
+	{
+		std::vector<unsigned int>	remap;
+		if (true == OptimizeModelIndices( index, numberOfVertices, pVertices, pointStride, newIndices, remap ) )
+		{
+			pVertices = RemapStream( pVertices, pointStride, numberOfVertices, remap.data(), remappedPoints );
+			pNormals = RemapStream( pNormals, normalStride, numberOfVertices, remap.data(), remappedNormals );
+			pTangents = RemapStream( pTangents, tangentStride, numberOfVertices, remap.data(), remappedTangents );
+			pUVs = RemapStream( pUVs, uvStride, numberOfVertices, remap.data(), remappedUVs );
+		}
+	}
+
+	// triangles are reordered into clusters inside each patch, bounds are computed from the float positions
+	std::vector<MeshCluster>	clusters;
+
+	if (mBuildClusters && pVertices != nullptr && pointStride == gPointStride)
+	{
+		std::vector<std::pair<int, int>>	patches;
+		if (GetModelPatchRanges( index, patches ) )
+		{
+			for (auto iter=begin(patches); iter!=end(patches); ++iter)
+			{
+				BuildMeshClusters( newIndices.data(), iter->first, iter->second, pVertices, pointStride, numberOfVertices, 
+					mClusterMaxVertices, mClusterMaxTriangles, clusters );
+			}
+		}
+	}
+
+	// less than 65536 vertices could be addressed with 16 bit indices (0xFFFF is left for primitive restart)
+	const short indexStride = (mOptimizeIndices && numberOfVertices < 65536) ? gIndexStride16 : gIndexStride;
+
+	std::vector<unsigned short>	newIndices16;
+	if (indexStride == gIndexStride16)
+	{
+		newIndices16.resize(numberOfIndices);
+		for (int i=0; i<numberOfIndices; ++i)
+			newIndices16[i] = (unsigned short) newIndices[i];
+	}
+
+	// compact streams, quantize only the arrays with supported strides
+	float boundsMin[3] = {0.0f, 0.0f, 0.0f};
+	float boundsSize[3] = {0.0f, 0.0f, 0.0f};
+
+	const BYTE pointFormat = (mQuantizeVertices && pointStride > 0) ? VERTEX_STREAM_FORMAT_QUANTIZED : VERTEX_STREAM_FORMAT_FLOAT;
+	const BYTE normalFormat = (mQuantizeVertices && normalStride > 0) ? VERTEX_STREAM_FORMAT_QUANTIZED : VERTEX_STREAM_FORMAT_FLOAT;
+	const BYTE tangentFormat = (mQuantizeVertices && tangentStride > 0) ? VERTEX_STREAM_FORMAT_QUANTIZED : VERTEX_STREAM_FORMAT_FLOAT;
+	const BYTE uvFormat = (mQuantizeVertices && uvStride > 0) ? VERTEX_STREAM_FORMAT_QUANTIZED : VERTEX_STREAM_FORMAT_FLOAT;
+
+	std::vector<unsigned short>	quantizedPoints;
+	std::vector<short>			quantizedNormals;
+	std::vector<short>			quantizedTangents;
+	std::vector<unsigned short>	quantizedUVs;
+
+	const void *pPointsData = pVertices;
+	const void *pNormalsData = pNormals;
+	const void *pTangentsData = pTangents;
+	const void *pUVsData = pUVs;
+
+	if (pointFormat == VERTEX_STREAM_FORMAT_QUANTIZED)
+	{
+		ComputePointsBounds( pVertices, pointStride, numberOfVertices, boundsMin, boundsSize );
+		quantizedPoints.resize( 4 * numberOfVertices );
+		QuantizePositions( pVertices, pointStride, numberOfVertices, boundsMin, boundsSize, quantizedPoints.data() );
+
+		// cluster spheres have to hold the dequantized positions
+		const float step = sqrtf( boundsSize[0]*boundsSize[0] + boundsSize[1]*boundsSize[1] + boundsSize[2]*boundsSize[2] ) / 65535.0f;
+		for (auto iter=begin(clusters); iter!=end(clusters); ++iter)
+			iter->radius += step;
+		
+		pPointsData = quantizedPoints.data();
+		pointStride = gPointStrideQuantized;
+	}
+	if (normalFormat == VERTEX_STREAM_FORMAT_QUANTIZED)
+	{
+		quantizedNormals.resize( 2 * numberOfVertices );
+		QuantizeNormals( pNormals, normalStride, numberOfVertices, quantizedNormals.data() );
+
+		pNormalsData = quantizedNormals.data();
+		normalStride = gNormalStrideQuantized;
+	}
+	if (tangentFormat == VERTEX_STREAM_FORMAT_QUANTIZED)
+	{
+		quantizedTangents.resize( 2 * numberOfVertices );
+		QuantizeTangents( pTangents, tangentStride, numberOfVertices, quantizedTangents.data() );
+
+		pTangentsData = quantizedTangents.data();
+		tangentStride = gTangentStrideQuantized;
+	}
+	if (uvFormat == VERTEX_STREAM_FORMAT_QUANTIZED)
+	{
+		quantizedUVs.resize( 2 * numberOfVertices );
+		QuantizeUVs( pUVs, uvStride, numberOfVertices, quantizedUVs.data() );
+
+		pUVsData = quantizedUVs.data();
+		uvStride = gUVStrideQuantized;
+	}
+
 	// store header
-	VertexDataHeader header;
+	VertexDataHeader3 header;
 	VertexDataHeader::Set( numberOfVertices, numberOfIndices, pointStride, normalStride, tangentStride, uvStride, header );
+	VertexDataHeader2::Set( pointFormat, normalFormat, tangentFormat, uvFormat, indexStride, boundsMin, boundsSize, header );
+	VertexDataHeader3::Set( -1, (int) clusters.size(), 0, header );
 	
+	// version 1 pack has a base header only
+	const size_t headerSize = (mDetectInstances || mBuildClusters || mBuildLods) ? sizeof(VertexDataHeader3) 
+		: (mQuantizeVertices || mOptimizeIndices) ? sizeof(VertexDataHeader2) : sizeof(VertexDataHeader);
 	size_t elementsWritten = 0;
 
+	const void *pIndicesData = (indexStride == gIndexStride16) ? (const void*) newIndices16.data() : (const void*) newIndices.data();
+
+	const void *streams[5] = { pPointsData, pNormalsData, pTangentsData, pUVsData, pIndicesData };
+	const size_t streamSizes[5] = { (size_t) pointStride * numberOfVertices, (size_t) normalStride * numberOfVertices, 
+		(size_t) tangentStride * numberOfVertices, (size_t) uvStride * numberOfVertices, (size_t) indexStride * numberOfIndices };
+
+	uint64_t hash = 0;
+
 	try
 	{
 		long long pos = _ftelli64(modelFile);
-		elementsWritten = fwrite( &header, sizeof(header), 1, modelFile );
+
+		if (mDetectInstances)
+		{
+			hash = HashStreams( header, streams, streamSizes );
+
+			const int source = FindInstanceSource( modelFile, header, hash, streams, streamSizes );
+
+			if (source >= 0)
+			{
+				// the same counts and stream offsets, no own data
+				VertexDataHeader3 instance = mRecordHeaders[source];
+				instance.instanceOf = source;
+				instance.endOffset = pos + sizeof(VertexDataHeader3);
+
+				elementsWritten = fwrite( &instance, sizeof(VertexDataHeader3), 1, modelFile );
+				if (elementsWritten != 1)
+					throw std::runtime_error( "ERROR: failed to write model header!\n" );
+
+				mRecordHeaders.push_back(instance);
+				mNumberOfInstances += 1;
+				return true;
+			}
+		}
+
+		// lod levels are the same for the instances, so they are built for the records with own streams only
+		std::vector<MeshLodHeader>	lods;
+		std::vector<unsigned int>	lodIndices;
+		std::vector<int>			lodPatches;
+
+		if (mBuildLods && pVertices != nullptr && pointStride > 0)
+		{
+			BuildModelLods( index, numberOfVertices, pVertices, (pointFormat == VERTEX_STREAM_FORMAT_QUANTIZED) ? gPointStride : pointStride, 
+				newIndices, lods, lodIndices, lodPatches );
+			header.numberOfLods = (int) lods.size();
+		}
+
+		elementsWritten = fwrite( &header, headerSize, 1, modelFile );
 		if (elementsWritten != 1)
-			throw std::exception( "ERROR: failed to write model header!\n" );
+			throw std::runtime_error( "ERROR: failed to write model header!\n" );
 
-		float *pNewArray = (float*) pVertices;
 		/*
 		if (tm)
 		{
@@ -714,56 +853,115 @@ bool CGPUCacheSaver::WriteModelGeometry( FILE *modelFile, const int index )
 		//
 		// store data into the file storage
 		header.positionOffset = _ftelli64(modelFile);
-		elementsWritten = fwrite( (pNewArray) ? pNewArray : pVertices, pointStride, numberOfVertices, modelFile );
-		
-		//SAFE_ARRAY_DELETE(pNewArray);
+		elementsWritten = fwrite( pPointsData, pointStride, numberOfVertices, modelFile );
 		
 		if (elementsWritten != numberOfVertices)
-			throw std::exception( "ERROR: failed to write vertices!\n" );
+			throw std::runtime_error( "ERROR: failed to write vertices!\n" );
 		
 		header.normalOffset = _ftelli64(modelFile);
-		elementsWritten = fwrite( pNormals, normalStride, numberOfVertices, modelFile );
+		elementsWritten = fwrite( pNormalsData, normalStride, numberOfVertices, modelFile );
 		if (elementsWritten != numberOfVertices)
-			throw std::exception( "ERROR: failed to write vertices!\n" );
+			throw std::runtime_error( "ERROR: failed to write vertices!\n" );
 		
 		header.tangentOffset = _ftelli64(modelFile);
-		elementsWritten = fwrite( pTangents, tangentStride, numberOfVertices, modelFile );
+		elementsWritten = fwrite( pTangentsData, tangentStride, numberOfVertices, modelFile );
 		if (elementsWritten != numberOfVertices)
-			throw std::exception( "ERROR: failed to write vertices!\n" );
+			throw std::runtime_error( "ERROR: failed to write vertices!\n" );
 			
 		header.uvOffset = _ftelli64(modelFile);
-		elementsWritten = fwrite( pUVs, uvStride, numberOfVertices, modelFile );
+		elementsWritten = fwrite( pUVsData, uvStride, numberOfVertices, modelFile );
 		if (elementsWritten != numberOfVertices)
-			throw std::exception( "ERROR: failed to write vertices!\n" );
+			throw std::runtime_error( "ERROR: failed to write vertices!\n" );
 			
 
-		unsigned int *newIndices = new unsigned int[numberOfIndices];
-		if (newIndices == nullptr)
-			throw std::exception( "Failed to allocate memoryfor indices\n" );
-
-		for (int i=0; i<numberOfIndices; ++i)
-			newIndices[i] = (unsigned int) indices[i];
-
 		header.indicesOffset = _ftelli64(modelFile);
-		elementsWritten = fwrite( newIndices, sizeof(unsigned int), numberOfIndices, modelFile );
+		elementsWritten = fwrite( pIndicesData, indexStride, numberOfIndices, modelFile );
 
-		if(newIndices)
+		if (elementsWritten != numberOfIndices)
+			throw std::runtime_error( "ERROR: failed to write indices!\n" );
+
+		if (clusters.size() > 0)
 		{
-			delete [] newIndices;
-			newIndices = nullptr;
+			// 16 bit indices could leave the records unaligned
+			const char padding[4] = { 0 };
+			const size_t paddingSize = (size_t) ((4 - _ftelli64(modelFile) % 4) % 4);
+
+			if (paddingSize > 0 && 1 != fwrite( padding, paddingSize, 1, modelFile ) )
+				throw std::runtime_error( "ERROR: failed to write clusters!\n" );
+
+			header.clustersOffset = _ftelli64(modelFile);
+			elementsWritten = fwrite( clusters.data(), sizeof(MeshCluster), clusters.size(), modelFile );
+			if (elementsWritten != clusters.size() )
+				throw std::runtime_error( "ERROR: failed to write clusters!\n" );
 		}
 
-		if (elementsWritten != numberOfIndices)
-			throw std::exception( "ERROR: failed to write indices!\n" );
+		if (lods.size() > 0)
+		{
+			// level indices with the record index stride, then patch tables and level headers
+			const unsigned int *levelIndices = lodIndices.data();
+			const int *levelPatches = lodPatches.data();
+			const char padding[4] = { 0 };
+
+			for (auto iter=begin(lods); iter!=end(lods); ++iter)
+			{
+				iter->indicesOffset = _ftelli64(modelFile);
+
+				if (indexStride == gIndexStride16)
+				{
+					std::vector<unsigned short> levelIndices16(levelIndices, levelIndices + iter->numIndices);
+					elementsWritten = fwrite( levelIndices16.data(), indexStride, iter->numIndices, modelFile );
+				}
+				else
+				{
+					elementsWritten = fwrite( levelIndices, indexStride, iter->numIndices, modelFile );
+				}
+
+				if (elementsWritten != iter->numIndices)
+					throw std::runtime_error( "ERROR: failed to write lod indices!\n" );
+
+				levelIndices += iter->numIndices;
+			}
+
+			const size_t paddingSize = (size_t) ((4 - _ftelli64(modelFile) % 4) % 4);
+			if (paddingSize > 0 && 1 != fwrite( padding, paddingSize, 1, modelFile ) )
+				throw std::runtime_error( "ERROR: failed to write lod patches!\n" );
+
+			for (auto iter=begin(lods); iter!=end(lods); ++iter)
+			{
+				iter->patchesOffset = _ftelli64(modelFile);
+				
+				elementsWritten = fwrite( levelPatches, sizeof(int) * 2, iter->numberOfPatches, modelFile );
+				if (elementsWritten != iter->numberOfPatches)
+					throw std::runtime_error( "ERROR: failed to write lod patches!\n" );
+
+				levelPatches += 2 * iter->numberOfPatches;
+			}
+
+			header.lodsOffset = _ftelli64(modelFile);
+			elementsWritten = fwrite( lods.data(), sizeof(MeshLodHeader), lods.size(), modelFile );
+			if (elementsWritten != lods.size() )
+				throw std::runtime_error( "ERROR: failed to write lods!\n" );
+		}
 
 		// now store header with offsets
 		header.endOffset = _ftelli64(modelFile);
 		_fseeki64(modelFile, pos, 0);
-		elementsWritten = fwrite( &header, sizeof(header), 1, modelFile );
+		elementsWritten = fwrite( &header, headerSize, 1, modelFile );
 		if (elementsWritten != 1)
-			throw std::exception( "ERROR: failed to write model header!\n" );
+			throw std::runtime_error( "ERROR: failed to write model header!\n" );
 
 		_fseeki64(modelFile, header.endOffset, 0);
+
+		if (mDetectInstances)
+		{
+			mRecordHashes.insert( std::make_pair(hash, (int) mRecordHeaders.size()) );
+			mRecordHeaders.push_back(header);
+		}
+
+		mNumberOfClusters += (int) clusters.size();
+		mUniqueNumberOfVertices += (unsigned int) numberOfVertices;
+		mUniqueNumberOfIndices += (unsigned int) (numberOfIndices + lodIndices.size());
+		mNumberOfLodIndices += (unsigned int) lodIndices.size();
 	}
 	catch (const std::exception &e)
 	{
@@ -775,6 +973,223 @@ bool CGPUCacheSaver::WriteModelGeometry( FILE *modelFile, const int index )
 
 }
 
+int CGPUCacheSaver::FindInstanceSource( FILE *modelFile, const VertexDataHeader3 &header, const uint64_t hash, 
+	const void **streams, const size_t *streamSizes )
+{
+	auto range = mRecordHashes.equal_range(hash);
+	if (range.first == range.second)
+		return -1;
+
+	const int64_t pos = _ftelli64(modelFile);
+	int result = -1;
+
+	std::vector<BYTE>	buffer(65536);
+
+	for (auto iter=range.first; iter!=range.second && result < 0; ++iter)
+	{
+		const VertexDataHeader3 &source = mRecordHeaders[iter->second];
+
+		if (source.numVertices != header.numVertices || source.numIndices != header.numIndices
+			|| source.pointStride != header.pointStride || source.normalStride != header.normalStride
+			|| source.tangentStride != header.tangentStride || source.uvStride != header.uvStride
+			|| source.pointFormat != header.pointFormat || source.normalFormat != header.normalFormat
+			|| source.tangentFormat != header.tangentFormat || source.uvFormat != header.uvFormat
+			|| source.indexStride != header.indexStride || source.numberOfClusters != header.numberOfClusters
+			|| 0 != memcmp(source.boundsMin, header.boundsMin, sizeof(float) * 3)
+			|| 0 != memcmp(source.boundsSize, header.boundsSize, sizeof(float) * 3) )
+			continue;
+
+		// hashes are equal, compare the written bytes
+		const int64_t offsets[5] = { source.positionOffset, source.normalOffset, source.tangentOffset, source.uvOffset, source.indicesOffset };
+		bool equal = true;
+
+		for (int i=0; i<5 && equal; ++i)
+		{
+			const BYTE *ptr = (const BYTE*) streams[i];
+			
+			_fseeki64( modelFile, offsets[i], SEEK_SET );
+
+			for (size_t done=0; done<streamSizes[i] && equal; )
+			{
+				const size_t count = std::min( buffer.size(), streamSizes[i] - done );
+				
+				equal = (1 == fread( buffer.data(), count, 1, modelFile ) && 0 == memcmp( buffer.data(), ptr + done, count ) );
+				done += count;
+			}
+		}
+
+		if (equal)
+			result = iter->second;
+	}
+
+	_fseeki64( modelFile, pos, SEEK_SET );
+	return result;
+}
+
+
+bool CGPUCacheSaver::GetModelPatchRanges( const int index, std::vector<std::pair<int, int>> &patches )
+{
+	patches.clear();
+
+	for (int i=0; i<mQuery->GetModelSubPatchCount(index); ++i)
+	{
+		int offset, size, matId;
+		mQuery->GetModelSubPatchInfo( index, i, offset, size, matId );
+		
+		if (offset < 0 || size < 0 || offset % 3 != 0 || size % 3 != 0)
+			return false;
+
+		patches.push_back( std::make_pair(offset, size) );
+	}
+
+	std::sort( begin(patches), end(patches) );
+
+	for (size_t i=1; i<patches.size(); ++i)
+	{
+		if (patches[i-1].first + patches[i-1].second > patches[i].first)
+			return false;
+	}
+	return true;
+}
+
+bool CGPUCacheSaver::BuildModelLods( const int index, const int numberOfVertices, const float *positions, const int positionStride, 
+		const std::vector<unsigned int> &indices, std::vector<MeshLodHeader> &lods, std::vector<unsigned int> &lodIndices, 
+		std::vector<int> &lodPatches )
+{
+	lods.clear();
+	lodIndices.clear();
+	lodPatches.clear();
+
+	std::vector<std::pair<int, int>>	patches;
+
+	if (numberOfVertices <= 0 || indices.size() < 3 || false == GetModelPatchRanges( index, patches ) )
+		return false;
+
+	// error limit in the model units
+	float boundsMin[3], boundsSize[3];
+	ComputePointsBounds( positions, positionStride, numberOfVertices, boundsMin, boundsSize );
+
+	const float maxError = mLodMaxError 
+		* sqrtf( boundsSize[0]*boundsSize[0] + boundsSize[1]*boundsSize[1] + boundsSize[2]*boundsSize[2] );
+
+	const int numberOfPatches = mQuery->GetModelSubPatchCount(index);
+
+	// sorted patch position of the every manifest patch
+	std::vector<int>	patchOrder(numberOfPatches);
+	for (int i=0; i<numberOfPatches; ++i)
+	{
+		int offset, size, matId;
+		mQuery->GetModelSubPatchInfo( index, i, offset, size, matId );
+		
+		patchOrder[i] = (int) (std::lower_bound( begin(patches), end(patches), std::make_pair(offset, size) ) - begin(patches));
+	}
+
+	std::vector<unsigned int>			source(indices);
+	std::vector<unsigned int>			level;
+	std::vector<std::pair<int, int>>	levelRanges;
+
+	size_t sourceCount = 0;
+	for (auto iter=begin(patches); iter!=end(patches); ++iter)
+		sourceCount += iter->second;
+
+	float error = 0.0f;
+
+	for (int i=0; i<mNumberOfLods && error < maxError; ++i)
+	{
+		level.clear();
+		levelRanges.clear();
+
+		float levelError = 0.0f;
+
+		for (auto iter=begin(patches); iter!=end(patches); ++iter)
+		{
+			const int targetCount = (int) (mLodRatio * iter->second) / 3 * 3;
+
+			level.resize( level.size() + iter->second );
+			unsigned int *dst = level.data() + level.size() - iter->second;
+
+			float patchError = 0.0f;
+			const int count = SimplifyMesh( dst, source.data() + iter->first, iter->second, positions, positionStride, numberOfVertices, 
+				targetCount, maxError - error, &patchError );
+
+			if (mOptimizeIndices && count > 0)
+				OptimizeVertexCache( dst, dst, count, numberOfVertices );
+
+			levelRanges.push_back( std::make_pair( (int) (level.size() - iter->second), count ) );
+			level.resize( level.size() - iter->second + count );
+			levelError = std::max(levelError, patchError);
+		}
+
+		// level has to remove at least 10 percent of triangles
+		if (level.size() * 10 > sourceCount * 9)
+			break;
+
+		error += levelError;
+
+		MeshLodHeader lod;
+		MeshLodHeader::Set( (int) level.size(), numberOfPatches, error, lod );
+		lods.push_back(lod);
+
+		for (int j=0; j<numberOfPatches; ++j)
+		{
+			const std::pair<int, int> &range = levelRanges[patchOrder[j]];
+			lodPatches.push_back(range.first);
+			lodPatches.push_back(range.second);
+		}
+		lodIndices.insert( end(lodIndices), begin(level), end(level) );
+
+		// next level is simplified from this one
+		source.swap(level);
+		patches.swap(levelRanges);
+		sourceCount = source.size();
+	}
+
+	return (lods.size() > 0);
+}
+
+bool CGPUCacheSaver::OptimizeModelIndices( const int index, const int numberOfVertices, const float *positions, const int positionStride, 
+		std::vector<unsigned int> &indices, std::vector<unsigned int> &remap )
+{
+	const int numberOfIndices = (int) indices.size();
+
+	if (numberOfVertices <= 0 || numberOfIndices < 3)
+		return false;
+
+	for (auto iter=begin(indices); iter!=end(indices); ++iter)
+	{
+		if (*iter >= (unsigned int) numberOfVertices)
+			return false;
+	}
+
+	// triangles are reordered inside each sub patch, so patches have to be separate triangle ranges
+	std::vector<std::pair<int, int>>	patches;
+
+	if (false == GetModelPatchRanges( index, patches ) )
+		return false;
+
+	VertexCacheStatistics stats;
+	AnalyzeVertexCache( indices.data(), numberOfIndices, numberOfVertices, MESH_SIMULATE_CACHE_SIZE, stats );
+	VertexCacheStatistics::Accumulate( mCacheStatsBefore, stats );
+
+	for (auto iter=begin(patches); iter!=end(patches); ++iter)
+	{
+		unsigned int *patchIndices = indices.data() + iter->first;
+
+		OptimizeVertexCache( patchIndices, patchIndices, iter->second, numberOfVertices );
+		
+		if (positions != nullptr && positionStride > 0)
+			OptimizeOverdraw( patchIndices, patchIndices, iter->second, positions, positionStride, numberOfVertices );
+	}
+
+	remap.resize(numberOfVertices);
+	OptimizeVertexFetchRemap( remap.data(), indices.data(), numberOfIndices, numberOfVertices );
+	RemapIndexBuffer( indices.data(), indices.data(), numberOfIndices, remap.data() );
+
+	AnalyzeVertexCache( indices.data(), numberOfIndices, numberOfVertices, MESH_SIMULATE_CACHE_SIZE, stats );
+	VertexCacheStatistics::Accumulate( mCacheStatsAfter, stats );
+
+	return true;
+}
 
 bool CGPUCacheSaver::WriteShadersToXML( TiXmlElement *parentElem )
 {
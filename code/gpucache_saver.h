@@ -17,7 +17,15 @@
 #include "gpucache_types.h"
 #include "shared_glsl.h"
 
-#include "IO\tinyxml.h"
+#include "IO/tinyxml.h"
+#include "gpucache_saverTextures.h"
+#include "algorithm/MeshOptimize.h"
+#include "algorithm/MeshClusters.h"
+#include "algorithm/MeshSimplify.h"
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
 
 //////////////////////////////////////////////////////////////////////////
 //
@@ -76,6 +84,21 @@ public:
 	virtual const double GetVideoSize(const int index) = 0;
 	virtual const bool IsVideoUsedMipmaps(const int index) = 0;
 	virtual const unsigned char *GetVideoData(const int index) = 0;
+	// video data could be fetched from the texture export workers at the same time
+	virtual const bool IsVideoDataThreadSafe() {
+		return false;
+	}
+	// how the image is sampled, choose a block format for the export compression
+	//	normal map keeps only x and y (BC5), z has to be reconstructed in the shader
+	enum EVideoUsage
+	{
+		eVideoUsageColor,
+		eVideoUsageMask,
+		eVideoUsageNormalMap
+	};
+	virtual const EVideoUsage GetVideoUsage(const int index) {
+		return eVideoUsageColor;
+	}
 
 	// information about media
 	virtual double GetTotalUncompressedSize()
@@ -177,12 +200,168 @@ public:
 	bool Save(const char *filename, CGPUCacheSaverQuery *pQuery );
 	bool SaveTextures(const char *filename, CGPUCacheSaverQuery *pQuery);
 
+	// store compact vertex streams (geometry file version 2), off by default
+	void SetQuantizeVertices(const bool value)
+	{
+		mQuantizeVertices = value;
+	}
+	const bool IsQuantizeVertices() const
+	{
+		return mQuantizeVertices;
+	}
+
+	// reorder triangles for the vertex cache and overdraw, vertices for the fetch locality
+	//	and store 16 bit indices where possible (geometry file version 2), off by default
+	void SetOptimizeIndices(const bool value)
+	{
+		mOptimizeIndices = value;
+	}
+	const bool IsOptimizeIndices() const
+	{
+		return mOptimizeIndices;
+	}
+
+	// store models with the same geometry as instance records of the first one (geometry file version 3), off by default
+	//	streams are compared after quantization and optimization, so instances share the exact stored data
+	//	NOTE: only identical local geometry is detected, the mesh is not canonicalized before hashing.
+	//		Duplicated models (model transform in the xml) are found, a copy with the transform baked into
+	//		the vertices (moved, rotated or mirrored points) is a different mesh and keeps own streams
+	void SetDetectInstances(const bool value)
+	{
+		mDetectInstances = value;
+	}
+	const bool IsDetectInstances() const
+	{
+		return mDetectInstances;
+	}
+	// number of instance records in the last saved geometry pack
+	const int GetNumberOfInstances() const
+	{
+		return mNumberOfInstances;
+	}
+
+	// split sub patches into triangle clusters with bounds for the culling (geometry file version 3), off by default
+	//	triangles are reordered inside each patch, cluster is a continuous range of the index buffer
+	void SetBuildClusters(const bool value, const int maxVertices=MESH_CLUSTER_MAX_VERTICES, const int maxTriangles=MESH_CLUSTER_MAX_TRIANGLES)
+	{
+		mBuildClusters = value;
+		mClusterMaxVertices = maxVertices;
+		mClusterMaxTriangles = maxTriangles;
+	}
+	const bool IsBuildClusters() const
+	{
+		return mBuildClusters;
+	}
+	// number of clusters in the last saved geometry pack
+	const int GetNumberOfClusters() const
+	{
+		return mNumberOfClusters;
+	}
+
+	// store a chain of simplified index buffers per model for the distance lod (geometry file version 3), off by default
+	//	every level has about ratio of the previous level triangles, the chain stops when the error reaches
+	//	maxError (part of the model bounds diagonal) or when the level doesn't remove enough triangles
+	void SetBuildLods(const bool value, const int numberOfLods=3, const float ratio=0.5f, const float maxError=0.05f)
+	{
+		mBuildLods = value;
+		mNumberOfLods = std::max(1, std::min(numberOfLods, MESH_LOD_MAX_LEVELS-1));
+		mLodRatio = ratio;
+		mLodMaxError = maxError;
+	}
+	const bool IsBuildLods() const
+	{
+		return mBuildLods;
+	}
+	// number of indices in all lod levels of the last saved geometry pack
+	const unsigned int GetNumberOfLodIndices() const
+	{
+		return mNumberOfLodIndices;
+	}
+
+	// textures export, 0 workers - use number of hardware threads
+	void SetTextureExportWorkers(const int count)
+	{
+		mTextureExporter.SetNumberOfWorkers(count);
+	}
+	// total size of the image scratch buffers
+	void SetTextureExportMemoryBudget(const size_t bytes)
+	{
+		mTextureExporter.SetMemoryBudget(bytes);
+	}
+	// write mip levels of the images which use mipmaps, off by default
+	//	alphaCoverageReference - alpha test value (1..255) to keep the coverage of color images on all levels
+	void SetTextureMipmaps(const bool enabled, const int alphaCoverageReference=0)
+	{
+		mTextureExporter.SetMipmaps(enabled, alphaCoverageReference);
+	}
+	// compress images into BC1, BC3, BC4 or BC5 blocks on export, off by default
+	void SetTextureCompression(const bool enabled, const ETextureCompressionQuality quality=eTextureCompressionNormal)
+	{
+		mTextureExporter.SetCompression(enabled, quality);
+	}
+	// content digests of the images (textures pack version 3), duplicated images are stored once
+	//	and the caches could share them in the process textures registry, off by default
+	void SetTextureDigests(const bool enabled)
+	{
+		mTextureExporter.SetDigests(enabled);
+	}
+	const GPUCacheTextureExportStats &GetTextureExportStats() const
+	{
+		return mTextureExporter.GetStats();
+	}
+
+	// simulated post-transform cache of all saved models, before and after the optimization
+	void GetCacheStatistics(VertexCacheStatistics &before, VertexCacheStatistics &after) const
+	{
+		before = mCacheStatsBefore;
+		after = mCacheStatsAfter;
+	}
+
 protected:
 
 	CGPUCacheSaverQuery		*mQuery;
+	bool					mQuantizeVertices;
+	bool					mOptimizeIndices;
+	bool					mDetectInstances;
+	bool					mBuildClusters;
+	int						mClusterMaxVertices;
+	int						mClusterMaxTriangles;
+	int						mNumberOfClusters;
+	bool					mBuildLods;
+	int						mNumberOfLods;
+	float					mLodRatio;
+	float					mLodMaxError;
+	unsigned int			mNumberOfLodIndices;
+
+	// written records of the geometry pack, hash of the stored streams -> record index
+	std::vector<VertexDataHeader3>							mRecordHeaders;
+	std::unordered_multimap<uint64_t, int>			mRecordHashes;
+	int						mNumberOfInstances;
+	unsigned int			mUniqueNumberOfVertices;
+	unsigned int			mUniqueNumberOfIndices;
+
+	VertexCacheStatistics	mCacheStatsBefore;
+	VertexCacheStatistics	mCacheStatsAfter;
+
+	CGPUCacheTextureExporter	mTextureExporter;
 
 	bool WriteModelToXML( const int index, TiXmlElement *parentElem );
 	bool WriteModelGeometry( FILE *modelFile, const int index );
+	// previous record with the same header and stream bytes, -1 if there is no one
+	int FindInstanceSource( FILE *modelFile, const VertexDataHeader3 &header, const uint64_t hash, 
+		const void **streams, const size_t *streamSizes );
+	// entries and the footer at the current file position
+	bool WriteToc( FILE *modelFile, const std::vector<FileTocEntry> &toc );
+	// sorted index ranges of the model sub patches, false if patches are not separate triangle ranges
+	bool GetModelPatchRanges( const int index, std::vector<std::pair<int, int>> &patches );
+	// simplified levels of the model, every level is simplified from the previous one patch by patch
+	//	lodPatches - (offset, size) pairs of the manifest patches for every level
+	bool BuildModelLods( const int index, const int numberOfVertices, const float *positions, const int positionStride, 
+		const std::vector<unsigned int> &indices, std::vector<MeshLodHeader> &lods, std::vector<unsigned int> &lodIndices, 
+		std::vector<int> &lodPatches );
+	// optimize indices in place and fill a vertices remap table
+	bool OptimizeModelIndices( const int index, const int numberOfVertices, const float *positions, const int positionStride, 
+		std::vector<unsigned int> &indices, std::vector<unsigned int> &remap );
 
 	bool WriteMaterialsToXML( TiXmlElement *parentElem );
 	bool WriteTexturesToXML( TiXmlElement *parentElem );
@@ -190,11 +369,6 @@ protected:
 	bool WriteOneShaderToXML( TiXmlElement *parentElem, const int index );
 	bool WriteLightsToXML( TiXmlElement *parentElem );
 
-	bool SaveDDSData( int fh, const char *filename );
 	// index in samplers array
 	bool SaveSampler( int fh, const int index, const int videoIndex );
-	// index in video clips array
-	bool SaveImageEmpty( int fh );
-
-	bool SaveImageSimple( int fh, const int index );
 };
\ No newline at end of file
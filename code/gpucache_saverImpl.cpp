@@ -13,6 +13,7 @@
 
 
 #include "gpucache_saverImpl.h"
+#include "IO\FileIO.h"
 
 ///////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,804 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_saverTextures.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_saverTextures.h"
+#include "gpucache_saver.h"
+
+#include "IO/FileIO.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "nv_dds/nv_dds.h"
+
+typedef std::chrono::high_resolution_clock	ExportClock;
+
+static double ElapsedMs( const ExportClock::time_point &start )
+{
+	return std::chrono::duration<double, std::milli>( ExportClock::now() - start ).count();
+}
+
+static void AppendData( std::vector<BYTE> &record, const void *data, const size_t size )
+{
+	const BYTE *ptr = (const BYTE*) data;
+	record.insert( record.end(), ptr, ptr + size );
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CGPUCacheTextureExporter::CGPUCacheTextureExporter()
+{
+	mNumberOfWorkers = 0;
+	mMemoryBudget = TEXTURE_EXPORT_DEFAULT_BUDGET;
+
+	mMipmaps = false;
+	mAlphaCoverageReference = 0;
+
+	mCompression = false;
+	mCompressionQuality = eTextureCompressionNormal;
+	mCompressionThreads = 1;
+
+	mNextJob = 0;
+	mAbort = false;
+	mAllocatedMemory = 0;
+	mBuffersInUse = 0;
+
+	mQuery = nullptr;
+	mFilename = nullptr;
+
+	mDigests = false;
+
+	GPUCacheTextureExportStats::Clear(mStats);
+}
+
+bool CGPUCacheTextureExporter::WriteImages( int fh, CGPUCacheSaverQuery *pQuery, const char *filename )
+{
+	GPUCacheTextureExportStats::Clear(mStats);
+
+	if (pQuery == nullptr)
+		return false;
+
+	const ExportClock::time_point exportStart = ExportClock::now();
+
+	mQuery = pQuery;
+	mFilename = filename;
+
+	const int numberOfImages = pQuery->GetVideoCount();
+
+	mToc.clear();
+	mToc.reserve(numberOfImages);
+
+	mRecordDigests.assign( numberOfImages, 0 );
+	mImageRemap.resize( numberOfImages );
+	mWrittenDigests.clear();
+
+	for (int i=0; i<numberOfImages; ++i)
+		mImageRemap[i] = i;
+
+	int numberOfWorkers = mNumberOfWorkers;
+	if (numberOfWorkers <= 0)
+	{
+		// one hardware thread is left for the writer
+		numberOfWorkers = (int) std::thread::hardware_concurrency() - 1;
+	}
+	numberOfWorkers = std::max( 1, std::min(numberOfWorkers, numberOfImages) );
+
+	// image is split between threads when there are less workers than hardware threads
+	mCompressionThreads = std::max( 1, (int) std::thread::hardware_concurrency() / numberOfWorkers );
+
+	ImageJob emptyJob = { nullptr, false, false, 0, nullptr, 0, 0, 0 };
+	mJobs.assign( numberOfImages, emptyJob );
+
+	for (int i=0; i<numberOfImages; ++i)
+		mJobs[i].estimate = EstimateRecordSize(i);
+
+	mNextJob = 0;
+	mAbort = false;
+	mAllocatedMemory = 0;
+	mBuffersInUse = 0;
+
+	mStats.numberOfImages = numberOfImages;
+	mStats.numberOfWorkers = numberOfWorkers;
+
+	std::vector<std::thread>	workers;
+	bool result = true;
+
+	try
+	{
+		for (int i=0; i<numberOfImages && i<numberOfWorkers; ++i)
+			workers.push_back( std::thread( &CGPUCacheTextureExporter::WorkerThread, this ) );
+
+		// writer - append records in the image order
+		for (int i=0; i<numberOfImages; ++i)
+		{
+			std::vector<BYTE> *buffer = nullptr;
+
+			{
+				const ExportClock::time_point stallStart = ExportClock::now();
+				std::unique_lock<std::mutex> lock(mMutex);
+
+				while (false == mJobs[i].ready)
+					mWriterCondition.wait(lock);
+
+				mStats.writerStall += ElapsedMs(stallStart);
+
+				buffer = mJobs[i].buffer;
+				if (mJobs[i].failed)
+					throw std::runtime_error("Failed to prepare image data - ");
+			}
+
+			// the same record is already in the file, write an empty one instead
+			if (mDigests)
+			{
+				const uint64_t digest = mJobs[i].digest;
+				const int64_t recordSize = (int64_t) (buffer->size() + mJobs[i].externalSize);
+
+				auto range = mWrittenDigests.equal_range(digest);
+				for (auto iter=range.first; iter!=range.second; ++iter)
+				{
+					const FileTocEntry &entry = mToc[iter->second];
+
+					if (entry.size == recordSize && CompareWrittenRecord( fh, entry.offset, *buffer, mJobs[i] ) )
+					{
+						mImageRemap[i] = iter->second;
+						break;
+					}
+				}
+
+				if (mImageRemap[i] != i)
+				{
+					mStats.numberOfDuplicates += 1;
+					mStats.duplicateBytes += recordSize;
+
+					buffer->clear();
+					BuildImageEmpty( *buffer );
+					mJobs[i].externalSize = 0;
+				}
+				else
+				{
+					mRecordDigests[i] = digest;
+					mWrittenDigests.insert( std::make_pair(digest, i) );
+				}
+			}
+
+			const int size = (int) buffer->size();
+			const int externalSize = (int) mJobs[i].externalSize;
+			const int externalOffset = (externalSize > 0) ? (int) mJobs[i].externalOffset : size;
+
+			FileTocEntry	tocEntry;
+
+			{
+				std::unique_lock<std::mutex> lock( mQueryMutex, std::defer_lock );
+				if (false == pQuery->IsVideoDataThreadSafe() )
+					lock.lock();
+
+				printf( "save video data %d - %s\n", i, pQuery->GetVideoName(i) );
+				FileTocEntry::Set( pQuery->GetVideoName(i), _telli64(fh), size + externalSize, i, nullptr, nullptr, tocEntry );
+			}
+			mToc.push_back(tocEntry);
+
+			const ExportClock::time_point writeStart = ExportClock::now();
+
+			if (externalOffset != _write( fh, buffer->data(), externalOffset ) )
+				throw std::runtime_error( "error while writing image data!\n" );
+
+			if (externalSize > 0 && externalSize != _write( fh, mJobs[i].externalData, externalSize ) )
+				throw std::runtime_error( "error while writing image data!\n" );
+
+			// mip levels after the base one
+			if (size > externalOffset && (size - externalOffset) != _write( fh, buffer->data() + externalOffset, size - externalOffset ) )
+				throw std::runtime_error( "error while writing image data!\n" );
+
+			mStats.writeTime += ElapsedMs(writeStart);
+			mStats.bytesWritten += size + externalSize;
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mJobs[i].buffer = nullptr;
+				ReleaseBuffer(buffer);
+			}
+			mJobsCondition.notify_all();
+		}
+	}
+	catch (const std::exception &e)
+	{
+		printf( "%s\n", e.what() );
+		result = false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mAbort = true;
+	}
+	mJobsCondition.notify_all();
+
+	for (auto iter=begin(workers); iter!=end(workers); ++iter)
+		iter->join();
+
+	// records which were not written after the failure
+	for (auto iter=begin(mJobs); iter!=end(mJobs); ++iter)
+	{
+		if (iter->buffer)
+		{
+			ReleaseBuffer(iter->buffer);
+			iter->buffer = nullptr;
+		}
+	}
+
+	FreeBuffers();
+	mJobs.clear();
+
+	mQuery = nullptr;
+	mFilename = nullptr;
+
+	mStats.total = ElapsedMs(exportStart);
+	return result;
+}
+
+void CGPUCacheTextureExporter::WorkerThread()
+{
+	for (;;)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+
+		// buffers are taken in the image order, so the writer always gets a next record
+		while (false == mAbort && mNextJob < (int) mJobs.size() && false == CanAcquireBuffer(mJobs[mNextJob].estimate) )
+			mJobsCondition.wait(lock);
+
+		if (mAbort || mNextJob >= (int) mJobs.size() )
+			return;
+
+		const int index = mNextJob;
+		mNextJob += 1;
+
+		std::vector<BYTE> *buffer = AcquireBuffer( mJobs[index].estimate );
+		const size_t capacity = buffer->capacity();
+
+		lock.unlock();
+
+		const ExportClock::time_point buildStart = ExportClock::now();
+		ImageJob job = { nullptr, false, false, 0, nullptr, 0, 0, 0 };
+		const bool result = BuildImageRecord( index, job, *buffer );
+		
+		if (result && mDigests)
+			job.digest = ComputeRecordDigest( *buffer, job );
+
+		const double buildTime = ElapsedMs(buildStart);
+
+		lock.lock();
+
+		// record could be bigger than estimated
+		mAllocatedMemory += buffer->capacity() - capacity;
+		mStats.peakMemory = std::max( mStats.peakMemory, mAllocatedMemory );
+		mStats.buildTime += buildTime;
+
+		mJobs[index].buffer = buffer;
+		mJobs[index].externalData = job.externalData;
+		mJobs[index].externalSize = job.externalSize;
+		mJobs[index].externalOffset = job.externalOffset;
+		mJobs[index].digest = job.digest;
+		mJobs[index].failed = !result;
+		mJobs[index].ready = true;
+
+		lock.unlock();
+		mWriterCondition.notify_one();
+	}
+}
+
+size_t CGPUCacheTextureExporter::EstimateRecordSize( const int index )
+{
+	size_t size = sizeof(BYTE) + sizeof(ImageHeader2);
+
+	ImagePlan plan;
+	PlanImage( index, plan );
+
+	if (plan.components > 0)
+	{
+		size += ComputeImageDataSize(plan);
+
+		// raw base level is not copied, it's written from the query memory
+		if (false == plan.compress)
+			size -= (size_t) plan.width * plan.height * plan.components;
+	}
+
+	return size;
+}
+
+bool CGPUCacheTextureExporter::CanAcquireBuffer( const size_t size ) const
+{
+	size_t freeMemory = 0;
+
+	for (auto iter=begin(mFreeBuffers); iter!=end(mFreeBuffers); ++iter)
+	{
+		if ( (*iter)->capacity() >= size )
+			return true;
+
+		freeMemory += (*iter)->capacity();
+	}
+
+	// free buffers could be dropped, a single record could go over the budget
+	return (mAllocatedMemory - freeMemory + size <= mMemoryBudget) || (mBuffersInUse == 0);
+}
+
+std::vector<BYTE> *CGPUCacheTextureExporter::AcquireBuffer( const size_t size )
+{
+	std::vector<BYTE> *buffer = nullptr;
+
+	// the smallest free buffer which fits
+	auto bestIter = end(mFreeBuffers);
+	for (auto iter=begin(mFreeBuffers); iter!=end(mFreeBuffers); ++iter)
+	{
+		if ( (*iter)->capacity() >= size && (bestIter == end(mFreeBuffers) || (*iter)->capacity() < (*bestIter)->capacity()) )
+			bestIter = iter;
+	}
+
+	if (bestIter != end(mFreeBuffers) )
+	{
+		buffer = *bestIter;
+		mFreeBuffers.erase(bestIter);
+	}
+	else
+	{
+		// drop smaller buffers until the biggest one could be grown in budget
+		std::sort( begin(mFreeBuffers), end(mFreeBuffers), [] (const std::vector<BYTE> *a, const std::vector<BYTE> *b) {
+			return a->capacity() > b->capacity();
+		} );
+
+		while (mFreeBuffers.size() > 1 && mAllocatedMemory - mFreeBuffers.front()->capacity() + size > mMemoryBudget)
+		{
+			std::vector<BYTE> *last = mFreeBuffers.back();
+			mAllocatedMemory -= last->capacity();
+			delete last;
+			mFreeBuffers.pop_back();
+		}
+
+		if (mFreeBuffers.size() > 0)
+		{
+			buffer = mFreeBuffers.front();
+			mFreeBuffers.erase( begin(mFreeBuffers) );
+			mAllocatedMemory -= buffer->capacity();
+		}
+		else
+		{
+			buffer = new std::vector<BYTE>();
+		}
+
+		buffer->reserve(size);
+		mAllocatedMemory += buffer->capacity();
+	}
+
+	buffer->clear();
+	mBuffersInUse += 1;
+	mStats.peakMemory = std::max( mStats.peakMemory, mAllocatedMemory );
+
+	return buffer;
+}
+
+void CGPUCacheTextureExporter::ReleaseBuffer( std::vector<BYTE> *buffer )
+{
+	mFreeBuffers.push_back(buffer);
+	mBuffersInUse -= 1;
+}
+
+void CGPUCacheTextureExporter::FreeBuffers()
+{
+	for (auto iter=begin(mFreeBuffers); iter!=end(mFreeBuffers); ++iter)
+		delete *iter;
+
+	mFreeBuffers.clear();
+	mAllocatedMemory = 0;
+}
+
+void CGPUCacheTextureExporter::PrintStats() const
+{
+	const double seconds = 0.001 * mStats.total;
+	const double megabytes = (double) mStats.bytesWritten / (1024.0 * 1024.0);
+
+	printf( "textures export - %d images, %d workers\n", mStats.numberOfImages, mStats.numberOfWorkers );
+	printf( "  build (workers)    %10.2f ms\n", mStats.buildTime );
+	printf( "  write              %10.2f ms\n", mStats.writeTime );
+	printf( "  writer stall       %10.2f ms\n", mStats.writerStall );
+	printf( "  total              %10.2f ms\n", mStats.total );
+	printf( "  written            %10.2f MB, %.2f MB/s\n", megabytes, (seconds > 0.0) ? megabytes / seconds : 0.0 );
+	if (mStats.numberOfMipmapped > 0)
+	{
+		printf( "  mipmapped          %10d images\n", mStats.numberOfMipmapped );
+	}
+	if (mStats.numberOfCompressed > 0)
+	{
+		printf( "  compressed         %10d images, %.2f MB source\n", mStats.numberOfCompressed, 
+			(double) mStats.uncompressedBytes / (1024.0 * 1024.0) );
+	}
+	if (mStats.numberOfDuplicates > 0)
+	{
+		printf( "  duplicates         %10d images, %.2f MB not written\n", mStats.numberOfDuplicates, 
+			(double) mStats.duplicateBytes / (1024.0 * 1024.0) );
+	}
+	printf( "  peak memory        %10.2f MB (budget %.2f MB)\n", (double) mStats.peakMemory / (1024.0 * 1024.0),
+		(double) mMemoryBudget / (1024.0 * 1024.0) );
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// image records
+
+bool CGPUCacheTextureExporter::BuildImageRecord( const int index, ImageJob &job, std::vector<BYTE> &record )
+{
+	record.clear();
+
+	const char *szFilename = nullptr;
+	{
+		std::unique_lock<std::mutex> lock( mQueryMutex, std::defer_lock );
+		if (false == mQuery->IsVideoDataThreadSafe() )
+			lock.lock();
+
+		szFilename = mQuery->GetVideoFilename(index);
+	}
+
+	if (szFilename && strstr( (char*)mFilename, ".dds" ) != nullptr )
+	{
+		return BuildImageDDS( record );
+	}
+	else if (nullptr != szFilename)
+	{
+		return BuildImageSimple( index, job, record );
+	}
+
+	// write empty texture
+	BuildImageEmpty( record );
+	return true;
+}
+
+bool CGPUCacheTextureExporter::BuildImageDDS( std::vector<BYTE> &record )
+{
+	nv_dds::CDDSImage	image;
+
+	if (false == image.load( mFilename ) )
+		return false;
+
+	const short width = (short) image.get_width();
+	const short height = (short) image.get_height();
+
+	const GLint internalFormat = image.get_format();
+	const GLint format = (image.get_components() == 4) ? GL_RGBA : GL_RGB;
+
+	const GLint imageSize = (GLint) image.get_size();
+	const unsigned char numberOfLods = (unsigned char) image.get_num_mipmaps();
+
+	// store header
+	ImageHeader2 header;
+	ImageHeader2::Set( width, height, internalFormat, format, imageSize, 0, numberOfLods, header);
+
+	AppendData( record, &header, sizeof(header) );
+
+	const unsigned char *imageData = image;
+
+	// store texture
+	if (imageSize > 0 && imageData != nullptr)
+		AppendData( record, imageData, sizeof(BYTE) * imageSize );
+
+	// store lods
+	for (int i=0; i<numberOfLods; ++i)
+	{
+		nv_dds::CSurface mipmap = image.get_mipmap(i);
+
+		// get lod and save it
+		ImageLODHeader2	lodHeader;
+		ImageLODHeader2::Set( mipmap.get_width(), mipmap.get_height(), mipmap.get_size(), lodHeader );
+
+		AppendData( record, &lodHeader, sizeof(lodHeader) );
+
+		const unsigned char *mipmapData = mipmap;
+		AppendData( record, mipmapData, mipmap.get_size() );
+	}
+
+	return true;
+}
+
+void CGPUCacheTextureExporter::PlanImage( const int index, ImagePlan &plan )
+{
+	plan.width = mQuery->GetVideoWidth(index);
+	plan.height = mQuery->GetVideoHeight(index);
+	mQuery->GetVideoFormat( index, plan.internalFormat, plan.format );
+
+	plan.components = 0;
+	plan.bgr = false;
+	plan.compress = false;
+	plan.compressionFormat = eTextureCompressionBC1;
+	plan.compressedFormat = 0;
+	plan.numberOfLevels = 1;
+	plan.filter = eMipmapFilterSRGB;
+
+	switch(plan.format)
+	{
+	case GL_RGB: plan.components = 3;
+		break;
+	case GL_RGBA: plan.components = 4;
+		break;
+	case GL_BGR: plan.components = 3; plan.bgr = true;
+		break;
+	case GL_BGRA: plan.components = 4; plan.bgr = true;
+		break;
+	case GL_RED:
+	case GL_LUMINANCE: plan.components = 1;
+		break;
+	}
+
+	// only 8 bit uncompressed pixels could be filtered and compressed
+	if ( plan.components == 0 || (double) plan.width * plan.height * plan.components != mQuery->GetVideoSize(index) )
+	{
+		plan.components = 0;
+		return;
+	}
+
+	const CGPUCacheSaverQuery::EVideoUsage usage = mQuery->GetVideoUsage(index);
+
+	if (usage == CGPUCacheSaverQuery::eVideoUsageMask)
+		plan.filter = eMipmapFilterLinear;
+	else if (usage == CGPUCacheSaverQuery::eVideoUsageNormalMap)
+		plan.filter = (plan.components >= 3) ? eMipmapFilterNormalMap : eMipmapFilterLinear;
+
+	if (mMipmaps && mQuery->IsVideoUsedMipmaps(index) )
+		plan.numberOfLevels = GetNumberOfMipLevels( plan.width, plan.height );
+
+	// too small for the blocks or nothing to gain
+	if (false == mCompression || plan.width < TEXTURE_COMPRESSION_BLOCK_SIZE || plan.height < TEXTURE_COMPRESSION_BLOCK_SIZE)
+		return;
+
+	switch(usage)
+	{
+	case CGPUCacheSaverQuery::eVideoUsageMask:
+		plan.compress = true;
+		plan.compressionFormat = eTextureCompressionBC4;
+		plan.compressedFormat = GL_COMPRESSED_RED_RGTC1;
+		break;
+	case CGPUCacheSaverQuery::eVideoUsageNormalMap:
+		plan.compress = (plan.components >= 3);
+		plan.compressionFormat = eTextureCompressionBC5;
+		plan.compressedFormat = GL_COMPRESSED_RG_RGTC2;
+		break;
+	default:
+		// single channel color image would be sampled as red only
+		plan.compress = (plan.components >= 3);
+		plan.compressionFormat = (plan.components == 4) ? eTextureCompressionBC3 : eTextureCompressionBC1;
+		plan.compressedFormat = (plan.components == 4) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	}
+}
+
+size_t CGPUCacheTextureExporter::ComputeImageDataSize( const ImagePlan &plan ) const
+{
+	size_t size = 0;
+
+	for (int level=0; level<plan.numberOfLevels; ++level)
+	{
+		int levelWidth, levelHeight;
+		GetMipLevelSize( plan.width, plan.height, level, levelWidth, levelHeight );
+
+		if (level > 0)
+			size += sizeof(ImageLODHeader2);
+
+		size += (plan.compress) ? GetCompressedImageSize( plan.compressionFormat, levelWidth, levelHeight )
+			: (size_t) levelWidth * levelHeight * plan.components;
+	}
+	return size;
+}
+
+bool CGPUCacheTextureExporter::BuildImageSimple( const int index, ImageJob &job, std::vector<BYTE> &record )
+{
+	std::unique_lock<std::mutex> lock( mQueryMutex, std::defer_lock );
+	if (false == mQuery->IsVideoDataThreadSafe() )
+		lock.lock();
+
+	const BYTE imageType = IMAGE_TYPE_STILL;
+	ImageHeader2	header;
+
+	const GLubyte	*imageData = mQuery->GetVideoData(index);
+
+	ImagePlan		plan;
+	plan.components = 0;
+
+	if (imageData == nullptr)
+	{
+		ImageHeader2::Set( 0, 0, 0, 0, 0, 0, 0, header );
+	}
+	else
+	{
+		PlanImage( index, plan );
+
+		if (plan.compress)
+		{
+			// source format is kept to tell the image channels
+			ImageHeader2::Set( plan.width, plan.height, plan.compressedFormat, plan.format, 
+				(GLint) GetCompressedImageSize(plan.compressionFormat, plan.width, plan.height), 0, plan.numberOfLevels, header );
+			header.compressed = 1;
+		}
+		else
+		{
+			ImageHeader2::Set( plan.width, plan.height, plan.internalFormat, plan.format, 
+				(GLint) mQuery->GetVideoSize(index), 0, plan.numberOfLevels, header );
+		}
+	}
+
+	// source data stays valid until the export is finished, query is not needed for the levels
+	if (lock.owns_lock() )
+		lock.unlock();
+
+	AppendData( record, &imageType, sizeof(BYTE) );
+	AppendData( record, &header, sizeof(header) );
+
+	if (imageData == nullptr)
+		return true;
+
+	// OpenGL texture limitation
+	if (false == plan.compress)
+	{
+		job.externalData = imageData;
+		job.externalSize = sizeof(BYTE) * header.size;
+		job.externalOffset = record.size();
+	}
+
+	if (plan.compress || plan.numberOfLevels > 1)
+	{
+		if (false == BuildImageLevels( imageData, plan, record ) )
+			return false;
+
+		std::lock_guard<std::mutex> statsLock(mMutex);
+		if (plan.numberOfLevels > 1)
+			mStats.numberOfMipmapped += 1;
+		if (plan.compress)
+		{
+			mStats.numberOfCompressed += 1;
+			mStats.uncompressedBytes += (int64_t) plan.width * plan.height * plan.components;
+		}
+	}
+
+	return true;
+}
+
+bool CGPUCacheTextureExporter::BuildImageLevels( const BYTE *imageData, const ImagePlan &plan, std::vector<BYTE> &record )
+{
+	// reserve all levels, uncompressed level is filtered from the previous one inside the record
+	//	raw base level is written from the query memory, it's not a part of the record (see EstimateRecordSize)
+	size_t dataSize = ComputeImageDataSize(plan);
+	if (false == plan.compress)
+		dataSize -= (size_t) plan.width * plan.height * plan.components;
+
+	record.reserve( record.size() + dataSize );
+
+	const bool useCoverage = (mAlphaCoverageReference > 0 && plan.filter == eMipmapFilterSRGB);
+	const float coverage = (useCoverage) 
+		? ComputeAlphaCoverage( imageData, plan.width, plan.height, plan.components, mAlphaCoverageReference ) : 0.0f;
+
+	// uncompressed pixels of the levels which are stored compressed
+	std::vector<BYTE>	scratch[2];
+
+	const BYTE *prevLevel = imageData;
+	int prevWidth = plan.width;
+	int prevHeight = plan.height;
+
+	for (int level=0; level<plan.numberOfLevels; ++level)
+	{
+		int levelWidth, levelHeight;
+		GetMipLevelSize( plan.width, plan.height, level, levelWidth, levelHeight );
+
+		const BYTE *levelData = imageData;
+
+		if (level > 0)
+		{
+			const size_t pixelsSize = (size_t) levelWidth * levelHeight * plan.components;
+			const size_t dataSize = (plan.compress) ? GetCompressedImageSize( plan.compressionFormat, levelWidth, levelHeight ) : pixelsSize;
+
+			ImageLODHeader2	lodHeader;
+			ImageLODHeader2::Set( (short) levelWidth, (short) levelHeight, (GLint) dataSize, lodHeader );
+			AppendData( record, &lodHeader, sizeof(lodHeader) );
+
+			BYTE *pixels = nullptr;
+			if (plan.compress)
+			{
+				scratch[level & 1].resize(pixelsSize);
+				pixels = scratch[level & 1].data();
+			}
+			else
+			{
+				const size_t offset = record.size();
+				record.resize( offset + pixelsSize );
+				pixels = record.data() + offset;
+			}
+
+			DownsampleImage( prevLevel, prevWidth, prevHeight, plan.components, plan.filter, pixels );
+
+			if (coverage > 0.0f)
+				ScaleAlphaToCoverage( pixels, levelWidth, levelHeight, plan.components, mAlphaCoverageReference, coverage );
+
+			levelData = pixels;
+		}
+
+		if (plan.compress)
+		{
+			const size_t offset = record.size();
+			record.resize( offset + GetCompressedImageSize(plan.compressionFormat, levelWidth, levelHeight) );
+
+			if (0 == CompressImage( levelData, levelWidth, levelHeight, plan.components, plan.bgr, 
+				plan.compressionFormat, mCompressionQuality, record.data() + offset, mCompressionThreads ) )
+			{
+				return false;
+			}
+		}
+
+		prevLevel = levelData;
+		prevWidth = levelWidth;
+		prevHeight = levelHeight;
+	}
+
+	return true;
+}
+
+void CGPUCacheTextureExporter::BuildImageEmpty( std::vector<BYTE> &record )
+{
+	const BYTE imageType = IMAGE_TYPE_STILL;
+
+	ImageHeader2	header;
+	ImageHeader2::Set( 0, 0, 0, 0, 0, 0, 0, header );
+
+	AppendData( record, &imageType, sizeof(BYTE) );
+	AppendData( record, &header, sizeof(header) );
+}
+
+uint64_t CGPUCacheTextureExporter::ComputeRecordDigest( const std::vector<BYTE> &record, const ImageJob &job )
+{
+	const size_t size = record.size();
+	const size_t externalOffset = (job.externalSize > 0) ? job.externalOffset : size;
+
+	TextureDigest digest;
+	TextureDigest::Begin(digest);
+	TextureDigest::Append( digest, record.data(), externalOffset );
+	
+	if (job.externalSize > 0)
+		TextureDigest::Append( digest, job.externalData, job.externalSize );
+	
+	TextureDigest::Append( digest, record.data() + externalOffset, size - externalOffset );
+	return TextureDigest::Finish(digest);
+}
+
+bool CGPUCacheTextureExporter::CompareWrittenRecord( int fh, const int64_t offset, const std::vector<BYTE> &record, const ImageJob &job )
+{
+	const size_t size = record.size();
+	const size_t externalOffset = (job.externalSize > 0) ? job.externalOffset : size;
+
+	// record pieces in the written order
+	const BYTE *pieces[3] = { record.data(), job.externalData, record.data() + externalOffset };
+	const size_t pieceSizes[3] = { externalOffset, job.externalSize, size - externalOffset };
+
+	const int64_t position = _telli64(fh);
+	bool result = (_lseeki64( fh, offset, SEEK_SET ) == offset);
+
+	BYTE chunk[65536];
+
+	for (int i=0; result && i<3; ++i)
+	{
+		for (size_t pos=0; result && pos<pieceSizes[i]; )
+		{
+			const int count = (int) std::min( sizeof(chunk), pieceSizes[i] - pos );
+
+			result = (count == _read( fh, chunk, count ) && 0 == memcmp( chunk, pieces[i] + pos, count ) );
+			pos += count;
+		}
+	}
+
+	_lseeki64( fh, position, SEEK_SET );
+	return result;
+}
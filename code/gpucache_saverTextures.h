@@ -0,0 +1,232 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_saverTextures.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_types.h"
+#include "algorithm/TextureCompression.h"
+#include "algorithm/MipmapGeneration.h"
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+
+// forward
+class CGPUCacheSaverQuery;
+
+#define TEXTURE_EXPORT_DEFAULT_BUDGET		(256 * 1024 * 1024)
+
+//////////////////////////////////////////////////////////////////////////
+// textures pack export statistics
+
+struct GPUCacheTextureExportStats
+{
+	double		buildTime;		// workers - fetch and convert images (sum of all workers, ms)
+	double		writeTime;		// writer - file writes (ms)
+	double		writerStall;	// writer is waiting for the workers (ms)
+	double		total;			// ms
+
+	int64_t		bytesWritten;
+	size_t		peakMemory;		// peak size of all scratch buffers
+
+	int			numberOfImages;
+	int			numberOfWorkers;
+	int			numberOfCompressed;	// images which were block compressed on export
+	int			numberOfMipmapped;	// images with the generated mip levels
+
+	int64_t		uncompressedBytes;	// source size of the compressed images
+
+	int			numberOfDuplicates;	// images which are stored as a reference to the same content
+	int64_t		duplicateBytes;		// record bytes which were not written for them
+
+	static void Clear(GPUCacheTextureExportStats &stats)
+	{
+		memset( &stats, 0, sizeof(GPUCacheTextureExportStats) );
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+// streaming export of the image records
+//	workers fetch and convert images into the scratch buffers, writer appends finished records
+//	to the pack in the image order. Scratch buffers are reused and their total size is kept in the memory budget
+//	(only a single record which is bigger than the budget could go over it)
+//	NOTE: image data which is stored as is, is written from the query memory without a copy,
+//		so the query video data has to be valid until the export is finished
+
+class CGPUCacheTextureExporter
+{
+public:
+
+	//! a constructor
+	CGPUCacheTextureExporter();
+
+	// 0 - use number of hardware threads
+	void SetNumberOfWorkers(const int count)
+	{
+		mNumberOfWorkers = count;
+	}
+	void SetMemoryBudget(const size_t bytes)
+	{
+		mMemoryBudget = bytes;
+	}
+	// generate mip levels for the images which use mipmaps, off by default (loader generates them on GPU)
+	//	alphaCoverageReference - alpha test value to keep the coverage of color images with alpha, 0 - not used
+	void SetMipmaps(const bool enabled, const int alphaCoverageReference=0)
+	{
+		mMipmaps = enabled;
+		mAlphaCoverageReference = alphaCoverageReference;
+	}
+	// block compress 8 bit rgb(a) / single channel images (BC1, BC3, BC4, BC5 by the video usage), off by default
+	void SetCompression(const bool enabled, const ETextureCompressionQuality quality)
+	{
+		mCompression = enabled;
+		mCompressionQuality = quality;
+	}
+
+	// content digest for each image record, images with the same record are written once, off by default
+	//	NOTE: the written records are read back to compare the candidates, file has to be opened for reading as well
+	void SetDigests(const bool enabled)
+	{
+		mDigests = enabled;
+	}
+	const bool IsDigests() const
+	{
+		return mDigests;
+	}
+
+	// write all image records from the current file position
+	bool WriteImages( int fh, CGPUCacheSaverQuery *pQuery, const char *filename );
+
+	const GPUCacheTextureExportStats &GetStats() const
+	{
+		return mStats;
+	}
+
+	void PrintStats() const;
+
+	// table of contents entries of the last written image records
+	const std::vector<FileTocEntry> &GetToc() const
+	{
+		return mToc;
+	}
+
+	// digests of the last written image records, 0 for the empty ones (see FileTexturesHeader3)
+	const std::vector<uint64_t> &GetDigests() const
+	{
+		return mRecordDigests;
+	}
+	// image which record holds the data of a given image, it's the image itself if it's not a duplicate
+	const std::vector<int> &GetImageRemap() const
+	{
+		return mImageRemap;
+	}
+
+protected:
+
+	int							mNumberOfWorkers;
+	size_t						mMemoryBudget;
+
+	bool						mMipmaps;
+	int							mAlphaCoverageReference;
+
+	bool						mCompression;
+	ETextureCompressionQuality	mCompressionQuality;
+	int							mCompressionThreads;	// threads per image, hardware threads are shared between workers
+
+	GPUCacheTextureExportStats	mStats;
+	std::vector<FileTocEntry>	mToc;
+
+	bool										mDigests;
+	std::vector<uint64_t>				mRecordDigests;
+	std::vector<int>							mImageRemap;
+	std::unordered_multimap<uint64_t, int>	mWrittenDigests;	// digest - image with a written record
+
+	//
+	// jobs and the buffers pool, guarded by mMutex
+
+	struct ImageJob
+	{
+		std::vector<BYTE>		*buffer;
+		bool					ready;
+		bool					failed;
+		size_t					estimate;	// record size to reserve a buffer before fetching
+
+		// image data which doesn't need a conversion is written straight from the query memory
+		const BYTE				*externalData;
+		size_t					externalSize;
+		size_t					externalOffset;	// position of the external data in the record
+
+		uint64_t		digest;
+	};
+
+	// how the image data is stored
+	struct ImagePlan
+	{
+		int							width;
+		int							height;
+		int							components;		// 0 - not an 8 bit uncompressed image, it's stored as is
+		bool						bgr;
+		GLint						internalFormat;
+		GLint						format;
+
+		bool						compress;
+		ETextureCompressionFormat	compressionFormat;
+		GLint						compressedFormat;
+
+		int							numberOfLevels;
+		EMipmapFilter				filter;
+	};
+
+	std::mutex					mMutex;
+	std::condition_variable		mJobsCondition;		// workers wait for a buffer
+	std::condition_variable		mWriterCondition;	// writer waits for a next record
+
+	std::mutex					mQueryMutex;		// query access when it's not thread safe
+
+	std::vector<ImageJob>		mJobs;
+	int							mNextJob;
+	bool						mAbort;
+
+	std::vector<std::vector<BYTE>*>		mFreeBuffers;
+	size_t						mAllocatedMemory;
+	int							mBuffersInUse;
+
+	CGPUCacheSaverQuery			*mQuery;
+	const char					*mFilename;
+
+	void		WorkerThread();
+
+	size_t		EstimateRecordSize( const int index );
+	bool		CanAcquireBuffer( const size_t size ) const;
+	std::vector<BYTE>	*AcquireBuffer( const size_t size );
+	void		ReleaseBuffer( std::vector<BYTE> *buffer );
+	void		FreeBuffers();
+
+	// choose a block format and mip levels for the image, query has to be locked
+	void		PlanImage( const int index, ImagePlan &plan );
+	// size of all levels with lod headers
+	size_t		ComputeImageDataSize( const ImagePlan &plan ) const;
+
+	// serialize one image record (type, header, data and lods) into the buffer
+	bool		BuildImageRecord( const int index, ImageJob &job, std::vector<BYTE> &record );
+	bool		BuildImageDDS( std::vector<BYTE> &record );
+	bool		BuildImageSimple( const int index, ImageJob &job, std::vector<BYTE> &record );
+	// base level (when it's compressed) and mip levels
+	bool		BuildImageLevels( const BYTE *imageData, const ImagePlan &plan, std::vector<BYTE> &record );
+	void		BuildImageEmpty( std::vector<BYTE> &record );
+
+	// digest of the record pieces, as they are written to the file
+	static uint64_t ComputeRecordDigest( const std::vector<BYTE> &record, const ImageJob &job );
+	// compare the record with the one which is already written at the offset, file position is kept
+	static bool CompareWrittenRecord( int fh, const int64_t offset, const std::vector<BYTE> &record, const ImageJob &job );
+};
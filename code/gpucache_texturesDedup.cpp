@@ -0,0 +1,155 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_texturesDedup.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_texturesDedup.h"
+#include "gpucache_loader.h"
+#include "IO/FileMapping.h"
+
+#include <stdio.h>
+#include <unordered_map>
+#include <stdexcept>
+
+struct DedupContent
+{
+	int			pack;		// first pack with the content
+	int64_t		size;
+};
+
+bool BuildTexturesDedupReport( const int numberOfPacks, const char * const *filenames, GPUCacheTexturesDedupReport &report )
+{
+	GPUCacheTexturesDedupReport::Clear(report);
+
+	std::unordered_map<uint64_t, DedupContent>	contents;
+	bool result = true;
+
+	for (int i=0; i<numberOfPacks; ++i)
+	{
+		CFileMapping	mapping;
+
+		try
+		{
+			if (false == mapping.Open(filenames[i]) )
+				throw std::runtime_error("failed to open a textures pack");
+
+			const BYTE *data = mapping.GetData();
+			const size_t fileSize = mapping.GetSize();
+
+			if (fileSize < sizeof(FileTexturesHeader) )
+				throw std::runtime_error("corrupted file format");
+
+			const FileTexturesHeader *header = (const FileTexturesHeader*) data;
+
+			if (header->version < TEXTURES_FILE_VERSION_2)
+				throw std::runtime_error("textures pack version 1 is not supported");
+			if (header->imagesOffset <= 0 || (size_t) header->imagesOffset > fileSize)
+				throw std::runtime_error("corrupted file format");
+
+			const uint64_t *digests = nullptr;
+
+			if (header->version >= TEXTURES_FILE_VERSION_3)
+			{
+				const FileTexturesHeader3 *header3 = (const FileTexturesHeader3*) data;
+
+				if (fileSize < sizeof(FileTexturesHeader3) || header3->digestsOffset <= 0
+					|| (size_t) header3->digestsOffset + sizeof(uint64_t) * header->numberOfImages > fileSize)
+					throw std::runtime_error("corrupted file format");
+
+				digests = (const uint64_t*) (data + header3->digestsOffset);
+			}
+
+			int packImages = 0;
+			int packEmpty = 0;
+			int packInPack = 0;
+			int packAcross = 0;
+			int64_t packBytes = 0;
+			int64_t packDuplicateBytes = 0;
+
+			size_t offset = (size_t) header->imagesOffset;
+
+			for (int j=0; j<header->numberOfImages; ++j)
+			{
+				size_t imageSize = 0;
+				const bool empty = (0 == CalculateImageSize2( data + offset, imageSize ) );
+
+				if (offset + imageSize > fileSize)
+					throw std::runtime_error("corrupted file format");
+
+				const uint64_t digest = (empty) ? 0
+					: (digests) ? digests[j] : TextureDigest::Compute( data + offset, imageSize );
+
+				offset += imageSize;
+
+				if (digest == 0)
+				{
+					packEmpty += 1;
+					continue;
+				}
+
+				packImages += 1;
+				packBytes += (int64_t) imageSize;
+
+				auto iter = contents.find(digest);
+				if (iter == end(contents) )
+				{
+					DedupContent content = { i, (int64_t) imageSize };
+					contents.insert( std::make_pair(digest, content) );
+					report.uniqueBytes += (int64_t) imageSize;
+					continue;
+				}
+
+				if (iter->second.pack == i)
+					packInPack += 1;
+				else
+					packAcross += 1;
+
+				packDuplicateBytes += (int64_t) imageSize;
+			}
+
+			printf( "%s - version %d, %d images, %d empty, %d duplicates, %d in other packs, %.2f of %.2f MB are duplicated\n",
+				filenames[i], (int) header->version, packImages, packEmpty, packInPack, packAcross,
+				(double) packDuplicateBytes / (1024.0 * 1024.0), (double) packBytes / (1024.0 * 1024.0) );
+
+			report.numberOfPacks += 1;
+			report.numberOfImages += packImages;
+			report.numberOfEmpty += packEmpty;
+			report.duplicatesInPack += packInPack;
+			report.duplicatesAcrossPacks += packAcross;
+			report.totalBytes += packBytes;
+		}
+		catch (const std::exception &e)
+		{
+			printf( "%s - %s\n", filenames[i], e.what() );
+			result = false;
+		}
+
+		mapping.Close();
+	}
+
+	report.uniqueImages = (int) contents.size();
+	return result;
+}
+
+void PrintTexturesDedupReport( const GPUCacheTexturesDedupReport &report )
+{
+	const double totalMb = (double) report.totalBytes / (1024.0 * 1024.0);
+	const double uniqueMb = (double) report.uniqueBytes / (1024.0 * 1024.0);
+
+	printf( "textures dedup - %d packs\n", report.numberOfPacks );
+	printf( "  images             %10d (%d empty records)\n", report.numberOfImages, report.numberOfEmpty );
+	printf( "  unique contents    %10d\n", report.uniqueImages );
+	printf( "  duplicates in pack %10d\n", report.duplicatesInPack );
+	printf( "  across packs       %10d\n", report.duplicatesAcrossPacks );
+	printf( "  total              %10.2f MB\n", totalMb );
+	printf( "  unique             %10.2f MB (%.1f%% could be shared)\n", uniqueMb,
+		(totalMb > 0.0) ? 100.0 * (totalMb - uniqueMb) / totalMb : 0.0 );
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_texturesDedup.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_types.h"
+
+#include <string.h>
+
+//
+// duplicated images report for a set of textures packs
+//	packs version 3 use the stored digests, digests of the older packs are computed from the records,
+//	so the report shows how much a shared textures registry would save before the caches are exported again
+//
+
+struct GPUCacheTexturesDedupReport
+{
+	int			numberOfPacks;
+	int			numberOfImages;			// non empty image records of all packs
+	int			numberOfEmpty;			// empty records, including the duplicates collapsed on export
+	int			uniqueImages;			// different contents
+
+	int			duplicatesInPack;		// content is already in the same pack
+	int			duplicatesAcrossPacks;	// content is already in a previous pack
+
+	int64_t		totalBytes;				// records of all non empty images
+	int64_t		uniqueBytes;			// records of the unique contents
+
+	static void Clear(GPUCacheTexturesDedupReport &report)
+	{
+		memset( &report, 0, sizeof(GPUCacheTexturesDedupReport) );
+	}
+};
+
+// walk over image records of the packs (_Textures.pck files), statistics of each pack are printed
+bool BuildTexturesDedupReport( const int numberOfPacks, const char * const *filenames, GPUCacheTexturesDedupReport &report );
+
+void PrintTexturesDedupReport( const GPUCacheTexturesDedupReport &report );
@@ -14,10 +14,16 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-#include <GL\glew.h>
+#include <GL/glew.h>
+#include <stdint.h>
+#include <string.h>
 #include <memory>
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+typedef unsigned char BYTE;
+#endif
 
 #define MAX_NUMBER_OF_SHADERS_PER_MODEL		5
 
@@ -28,6 +34,23 @@ const short gNormalStride = 16;
 const short gTangentStride = 16;
 const short gUVStride = 8;
 const short gIndexStride = 4;
+const short gIndexStride16 = 2;		// version 2 pack, models with less than 65536 vertices
+
+// strides for the compact (quantized) vertex streams, see VertexDataHeader2
+const short gPointStrideQuantized = 8;		// 4 x unorm16, normalized to the model bounds
+const short gNormalStrideQuantized = 4;		// 2 x snorm16, octahedral
+const short gTangentStrideQuantized = 4;	// 2 x snorm16, octahedral, handedness in the lowest bit
+const short gUVStrideQuantized = 4;			// 2 x half float
+
+#define GEOMETRY_FILE_VERSION				1
+#define GEOMETRY_FILE_VERSION_2				2	// VertexDataHeader2 per model (compact streams, 16 bit indices)
+#define GEOMETRY_FILE_VERSION_3				3	// VertexDataHeader3 per model (instance records, triangle clusters, lods)
+
+#define TEXTURES_FILE_VERSION_2				2	// image sequences
+#define TEXTURES_FILE_VERSION_3				3	// FileTexturesHeader3 (content digests of the image records)
+
+#define VERTEX_STREAM_FORMAT_FLOAT			0
+#define VERTEX_STREAM_FORMAT_QUANTIZED		1
 
 ///////////////////////////////////////////////////////////////////////////// MODELS
 //
@@ -62,12 +85,12 @@ struct VertexDataHeader
 	short		tangentStride;
 	short		uvStride;
 	
-	__int64		positionOffset;
-	__int64		normalOffset;
-	__int64		tangentOffset;
-	__int64		uvOffset;
-	__int64		indicesOffset;
-	__int64		endOffset;
+	int64_t		positionOffset;
+	int64_t		normalOffset;
+	int64_t		tangentOffset;
+	int64_t		uvOffset;
+	int64_t		indicesOffset;
+	int64_t		endOffset;
 
 	static void Set(	const int _numVertices, 
 						const int _numIndices, 
@@ -94,6 +117,129 @@ struct VertexDataHeader
 	}
 };
 
+// vertex data header for the geometry file version 2
+//	each stream could be stored in a compact format, it's decoded into float arrays on merge
+
+struct VertexDataHeader2 : public VertexDataHeader
+{
+	BYTE		pointFormat;
+	BYTE		normalFormat;
+	BYTE		tangentFormat;
+	BYTE		uvFormat;
+
+	short		indexStride;	// gIndexStride or gIndexStride16
+
+	// positions dequantize - bmin + q * bsize / 65535
+	float		boundsMin[3];
+	float		boundsSize[3];
+
+	static void Set(	const BYTE _pointFormat,
+						const BYTE _normalFormat,
+						const BYTE _tangentFormat,
+						const BYTE _uvFormat,
+						const short _indexStride,
+						const float *_boundsMin,
+						const float *_boundsSize,
+						VertexDataHeader2 &header )
+	{
+		header.pointFormat = _pointFormat;
+		header.normalFormat = _normalFormat;
+		header.tangentFormat = _tangentFormat;
+		header.uvFormat = _uvFormat;
+		header.indexStride = _indexStride;
+
+		for (int i=0; i<3; ++i)
+		{
+			header.boundsMin[i] = _boundsMin[i];
+			header.boundsSize[i] = _boundsSize[i];
+		}
+	}
+};
+
+// vertex data header for the geometry file version 3
+//	a model with the same geometry as one of the previous models is stored as an instance record,
+//	the record has no streams, offsets and counts are the ones of the source record
+//	instance has no transform of its own, the geometry is the same in the local space of both models
+//	triangle clusters (MeshCluster, see algorithm\MeshClusters.h) are stored after the indices
+
+struct VertexDataHeader3 : public VertexDataHeader2
+{
+	int			instanceOf;			// source record index in the pack, -1 - record has own streams
+	int			numberOfClusters;	// 0 - model has no clusters
+	int64_t		clustersOffset;
+	int			numberOfLods;		// simplified index buffers after the source one, 0 - model has no lods
+	int			dummy;
+	int64_t		lodsOffset;			// numberOfLods x MeshLodHeader
+
+	static void Set(	const int _instanceOf,
+						const int _numberOfClusters,
+						const int _numberOfLods,
+						VertexDataHeader3 &header )
+	{
+		header.instanceOf = _instanceOf;
+		header.numberOfClusters = _numberOfClusters;
+		header.clustersOffset = 0;
+		header.numberOfLods = _numberOfLods;
+		header.dummy = 0;
+		header.lodsOffset = 0;
+	}
+
+	// source record index, -1 for the own streams or for the packs before version 3
+	static int GetInstanceOf( const BYTE *models_data, const VertexDataHeader *header )
+	{
+		const FileGeometryHeader *fileHeader = (const FileGeometryHeader*) models_data;
+		
+		if (fileHeader->version < GEOMETRY_FILE_VERSION_3)
+			return -1;
+
+		return ((const VertexDataHeader3*) header)->instanceOf;
+	}
+
+	// number of indices in the lod index buffers of the record, they go after the source indices in the merged buffer
+	static int GetLodsNumberOfIndices( const BYTE *models_data, const VertexDataHeader *header );
+};
+
+// simplified index buffer of the model (version 3), indexes the vertices of the record with the record index stride
+struct MeshLodHeader
+{
+	int			numIndices;
+	int			numberOfPatches;	// in the order of the manifest patches
+	float		error;				// simplification error in the model units
+	int			dummy;
+
+	int64_t		indicesOffset;
+	int64_t		patchesOffset;		// numberOfPatches x (int offset, int size) in the lod index buffer
+
+	static void Set(	const int _numIndices,
+						const int _numberOfPatches,
+						const float _error,
+						MeshLodHeader &header )
+	{
+		header.numIndices = _numIndices;
+		header.numberOfPatches = _numberOfPatches;
+		header.error = _error;
+		header.dummy = 0;
+		header.indicesOffset = 0;
+		header.patchesOffset = 0;
+	}
+};
+
+inline int VertexDataHeader3::GetLodsNumberOfIndices( const BYTE *models_data, const VertexDataHeader *header )
+{
+	const FileGeometryHeader *fileHeader = (const FileGeometryHeader*) models_data;
+
+	if (fileHeader->version < GEOMETRY_FILE_VERSION_3)
+		return 0;
+
+	const VertexDataHeader3 *header3 = (const VertexDataHeader3*) header;
+	const MeshLodHeader *lods = (const MeshLodHeader*) (models_data + header3->lodsOffset);
+
+	int count = 0;
+	for (int i=0; i<header3->numberOfLods; ++i)
+		count += lods[i].numIndices;
+	return count;
+}
+
 
 
 
@@ -104,8 +250,8 @@ struct FileTexturesHeader
 	short	version;
 	int		numberOfImages;
 	int		numberOfSamplers;
-	__int64	imagesOffset;
-	__int64	samplersOffset;	
+	int64_t	imagesOffset;
+	int64_t	samplersOffset;	
 
 	static void Set(	const short _version, 
 						const int _numberOfImages, 
@@ -118,6 +264,98 @@ struct FileTexturesHeader
 	}
 };
 
+// version 3 pack, each image record has a content digest (see TextureDigest), duplicated images
+//	of one export are stored once, samplers refer to the first copy and other copies are empty records
+struct FileTexturesHeader3 : public FileTexturesHeader
+{
+	int64_t	digestsOffset;		// numberOfImages digests, 0 for an empty record
+
+	static void Set(	const int _numberOfImages, 
+						const int _numberOfSamplers, 
+						FileTexturesHeader3 &header )
+	{
+		FileTexturesHeader::Set( TEXTURES_FILE_VERSION_3, _numberOfImages, _numberOfSamplers, header );
+		header.imagesOffset = 0;
+		header.samplersOffset = 0;
+		header.digestsOffset = 0;
+	}
+};
+
+// 64 bit FNV-1a of the image record bytes, data is hashed by 8 byte words
+//	record could be appended in pieces, the result doesn't depend on the piece boundaries
+struct TextureDigest
+{
+	uint64_t	hash;
+	int64_t				size;
+	BYTE				tail[8];
+	int					tailSize;
+
+	static void Begin(TextureDigest &digest)
+	{
+		digest.hash = 14695981039346656037ULL;
+		digest.size = 0;
+		digest.tailSize = 0;
+	}
+
+	static void Append(TextureDigest &digest, const void *data, const size_t size)
+	{
+		const BYTE *ptr = (const BYTE*) data;
+		const BYTE *end = ptr + size;
+
+		digest.size += (int64_t) size;
+
+		// complete a word from the previous piece
+		while (digest.tailSize > 0 && digest.tailSize < 8 && ptr < end)
+			digest.tail[digest.tailSize++] = *ptr++;
+
+		if (digest.tailSize == 8)
+		{
+			AppendWord( digest, digest.tail );
+			digest.tailSize = 0;
+		}
+
+		for ( ; end - ptr >= 8; ptr += 8)
+			AppendWord( digest, ptr );
+
+		while (ptr < end)
+			digest.tail[digest.tailSize++] = *ptr++;
+	}
+
+	// 0 is reserved for the empty records
+	static uint64_t Finish(TextureDigest &digest)
+	{
+		for (int i=0; i<digest.tailSize; ++i)
+		{
+			digest.hash ^= (uint64_t) digest.tail[i];
+			digest.hash *= 1099511628211ULL;
+		}
+		digest.tailSize = 0;
+
+		digest.hash ^= (uint64_t) digest.size;
+		digest.hash *= 1099511628211ULL;
+
+		return (digest.hash != 0) ? digest.hash : 1;
+	}
+
+	static uint64_t Compute(const void *data, const size_t size)
+	{
+		TextureDigest digest;
+		Begin(digest);
+		Append(digest, data, size);
+		return Finish(digest);
+	}
+
+private:
+
+	static void AppendWord(TextureDigest &digest, const BYTE *word)
+	{
+		uint64_t value;
+		memcpy( &value, word, 8 );
+		digest.hash ^= value;
+		digest.hash *= 1099511628211ULL;
+	}
+};
+
 struct ImageHeader
 {
 	short		width;
@@ -146,6 +384,7 @@ struct ImageHeader
 
 #define IMAGE_TYPE_STILL		1
 #define IMAGE_TYPE_SEQUENCE		2
+#define IMAGE_TYPE_FRAME_DELTA	3		// sequence frame which stores changed blocks against the previous frame
 
 struct ImageHeader2
 {
@@ -173,6 +412,8 @@ struct ImageHeader2
 						const unsigned char lods, 
 						ImageHeader2 &header )
 	{
+		// padding bytes are stored as well, keep the records of the same image equal (see TextureDigest)
+		memset( &header, 0, sizeof(ImageHeader2) );
 		header.width = _width;
 		header.height = _height;
 		header.internalFormat = _internalFormat;
@@ -221,9 +462,27 @@ struct ImageSequenceHeader2 : public ImageHeader2
 	}
 };
 
+// delta frame data (ImageHeader2::size bytes), level 0 only
+//	header, runs of changed blocks (BlockDeltaRun) and the blocks of all runs one by one
+struct ImageFrameDeltaHeader
+{
+	GLint		keyFrame;		// full frame to start the decoding from
+	GLint		blockSize;		// bytes of one compressed block
+	GLint		blocksPerRow;
+	GLint		numberOfRuns;
+
+	static void Set( const GLint _keyFrame, const GLint _blockSize, const GLint _blocksPerRow, const GLint _runs, ImageFrameDeltaHeader &header )
+	{
+		header.keyFrame = _keyFrame;
+		header.blockSize = _blockSize;
+		header.blocksPerRow = _blocksPerRow;
+		header.numberOfRuns = _runs;
+	}
+};
+
 struct ImageSequenceLink
 {
-	__int64		link;	// link to a specified frame in stream
+	int64_t		link;	// link to a specified frame in stream
 };
 
 // for image or for frame
@@ -293,4 +552,205 @@ struct SamplerHeader
 		header.minFilter = _minFilter;
 		header.magFilter = _magFilter;
 	}
-};
\ No newline at end of file
+};
+
+///////////////////////////////////////////////////////////////// TABLE OF CONTENTS
+//
+//	optional index at the end of the geometry and textures packs, one entry per model / image record
+//	 old readers walk the records from the pack header and never reach it
+//	 footer is the last bytes of the pack, entries are stored at tocOffset
+
+#define CACHE_TOC_TAG			0x43544347		// GCTC
+#define CACHE_TOC_VERSION		1
+
+struct FileTocEntry
+{
+	uint64_t	nameHash;		// see HashName
+	int64_t				offset;			// record offset in the pack
+	int64_t				size;			// record size in bytes
+	int					index;			// model or image index in the pack order
+	
+	float				boundsMin[3];	// model world bounds, zero for images
+	float				boundsMax[3];
+
+	int					dummy;
+
+	static void Set(	const char *name,
+						const int64_t _offset,
+						const int64_t _size,
+						const int _index,
+						const float *_boundsMin,
+						const float *_boundsMax,
+						FileTocEntry &entry )
+	{
+		memset( &entry, 0, sizeof(FileTocEntry) );
+		entry.nameHash = HashName(name);
+		entry.offset = _offset;
+		entry.size = _size;
+		entry.index = _index;
+
+		if (_boundsMin && _boundsMax)
+		{
+			for (int i=0; i<3; ++i)
+			{
+				entry.boundsMin[i] = _boundsMin[i];
+				entry.boundsMax[i] = _boundsMax[i];
+			}
+		}
+	}
+
+	// 64 bit FNV-1a of the name string
+	static uint64_t HashName(const char *name)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+
+		if (name)
+		{
+			for (const unsigned char *c = (const unsigned char*) name; *c; ++c)
+			{
+				hash ^= (uint64_t) *c;
+				hash *= 1099511628211ULL;
+			}
+		}
+		return hash;
+	}
+};
+
+struct FileTocFooter
+{
+	int			tag;
+	int			version;
+	int			numberOfEntries;
+	int			dummy;
+	int64_t		tocOffset;
+
+	static void Set( const int _numberOfEntries, const int64_t _tocOffset, FileTocFooter &footer )
+	{
+		footer.tag = CACHE_TOC_TAG;
+		footer.version = CACHE_TOC_VERSION;
+		footer.numberOfEntries = _numberOfEntries;
+		footer.dummy = 0;
+		footer.tocOffset = _tocOffset;
+	}
+};
+
+///////////////////////////////////////////////////////////////// MANIFEST
+//
+//	binary version of the xml manifest, fixed size records and a string table
+//	 strings are stored as offsets in the string table
+
+#define MANIFEST_FILE_TAG		0x464D4347		// GCMF
+#define MANIFEST_FILE_VERSION	1
+
+struct FileManifestHeader
+{
+	int			tag;
+	short		version;
+
+	int			sourceFilename;		// string offset
+
+	int			numberOfTextures;
+	int			numberOfMaterials;
+	int			numberOfShaders;
+	int			numberOfModels;
+	int			numberOfSubMeshes;
+	int			numberOfPatches;
+
+	double		boundingMin[3];		// models bounding box
+	double		boundingMax[3];
+
+	int64_t		texturesOffset;
+	int64_t		materialsOffset;
+	int64_t		shadersOffset;
+	int64_t		modelsOffset;
+	int64_t		patchesOffset;
+	int64_t		stringsOffset;
+	int64_t		stringsSize;
+
+	static void Set(	const int _numberOfTextures, 
+						const int _numberOfMaterials, 
+						const int _numberOfShaders, 
+						const int _numberOfModels, 
+						const int _numberOfSubMeshes, 
+						const int _numberOfPatches, 
+						FileManifestHeader &header )
+	{
+		memset( &header, 0, sizeof(FileManifestHeader) );
+		header.tag = MANIFEST_FILE_TAG;
+		header.version = MANIFEST_FILE_VERSION;
+		header.numberOfTextures = _numberOfTextures;
+		header.numberOfMaterials = _numberOfMaterials;
+		header.numberOfShaders = _numberOfShaders;
+		header.numberOfModels = _numberOfModels;
+		header.numberOfSubMeshes = _numberOfSubMeshes;
+		header.numberOfPatches = _numberOfPatches;
+	}
+};
+
+struct ManifestTexture
+{
+	int			name;
+	int			filename;
+};
+
+struct ManifestMaterial
+{
+	int			name;
+
+	float		diffuseColor[4];
+	int			diffuse;			// diffuse map id
+	float		useDiffuse;
+};
+
+struct ManifestShader
+{
+	int			name;
+	int			alpha;
+
+	int			shaderType;
+	int			shadingType;
+	float		transparency;
+
+	float		toonEnabled;
+	float		toonSteps;
+	float		toonDistribution;
+	float		toonShadowPosition;
+
+	float		customColor[4];
+	float		contrast;
+	float		saturation;
+	float		brightness;
+	float		gamma;
+};
+
+struct ManifestModel
+{
+	int			name;
+
+	int			numberOfShaders;
+	int			shaders[MAX_NUMBER_OF_SHADERS_PER_MODEL];	// NOTE: ids are shifted by one, zero is a default shader
+
+	int			firstPatch;
+	int			numberOfPatches;
+
+	double		translation[3];
+	double		rotation[3];
+	double		scaling[3];
+
+	double		boundingMin[3];
+	double		boundingMax[3];
+};
+
+struct ManifestPatch
+{
+	int			offset;
+	int			size;
+	int			materialId;
+
+	static void Set( const int _offset, const int _size, const int _materialId, ManifestPatch &patch )
+	{
+		patch.offset = _offset;
+		patch.size = _size;
+		patch.materialId = _materialId;
+	}
+};
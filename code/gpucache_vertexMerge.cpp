@@ -0,0 +1,336 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_vertexMerge.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_vertexMerge.h"
+#include "algorithm/VertexQuantization.h"
+
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define VERTEX_MERGE_SSE2
+#include <emmintrin.h>
+#endif
+
+// work is split into chunks, so one big model is merged by all threads
+#define MERGE_CHUNK_VERTICES	65536
+#define MERGE_CHUNK_INDICES		262144
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// indices
+
+void RebaseIndices( const unsigned int *src, const int count, const unsigned int base, unsigned int *dst )
+{
+	int i = 0;
+
+#ifdef VERTEX_MERGE_SSE2
+	const __m128i offset = _mm_set1_epi32( (int) base );
+
+	for ( ; i + 8 <= count; i += 8)
+	{
+		const __m128i a = _mm_loadu_si128( (const __m128i*) (src + i) );
+		const __m128i b = _mm_loadu_si128( (const __m128i*) (src + i + 4) );
+
+		_mm_storeu_si128( (__m128i*) (dst + i), _mm_add_epi32(a, offset) );
+		_mm_storeu_si128( (__m128i*) (dst + i + 4), _mm_add_epi32(b, offset) );
+	}
+#endif
+
+	for ( ; i < count; ++i)
+		dst[i] = src[i] + base;
+}
+
+void RebaseIndices( const unsigned short *src, const int count, const unsigned int base, unsigned int *dst )
+{
+	int i = 0;
+
+#ifdef VERTEX_MERGE_SSE2
+	const __m128i offset = _mm_set1_epi32( (int) base );
+	const __m128i zero = _mm_setzero_si128();
+
+	// 8 short indices are widened into two registers
+	for ( ; i + 8 <= count; i += 8)
+	{
+		const __m128i a = _mm_loadu_si128( (const __m128i*) (src + i) );
+
+		_mm_storeu_si128( (__m128i*) (dst + i), _mm_add_epi32(_mm_unpacklo_epi16(a, zero), offset) );
+		_mm_storeu_si128( (__m128i*) (dst + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(a, zero), offset) );
+	}
+#endif
+
+	for ( ; i < count; ++i)
+		dst[i] = (unsigned int) src[i] + base;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// streams
+
+struct MergeModel
+{
+	const VertexDataHeader		*header;
+	const VertexDataHeader2		*header2;	// version 2 only
+
+	unsigned int	firstVertex;	// in the merged streams
+	unsigned int	firstIndex;
+	short			indexStride;
+};
+
+struct MergeChunk
+{
+	int		model;
+	int		first;			// vertex or index in the model
+	int		count;
+	bool	indices;
+
+	int64_t			indicesOffset;	// source index buffer of the record or of the lod level
+	unsigned int	firstIndex;		// index buffer start in the merged indices
+};
+
+static void MergeVertexChunk( const BYTE *models_data, const MergeModel &model, const int first, const int count, const VertexMergeTarget &target )
+{
+	const VertexDataHeader *header = model.header;
+	const VertexDataHeader2 *header2 = model.header2;
+
+	const size_t dstVertex = (size_t) model.firstVertex + first;
+
+	if (target.positions)
+	{
+		const BYTE *src = models_data + header->positionOffset + (size_t) first * header->pointStride;
+		float *dst = target.positions + dstVertex * 4;
+
+		if (header2 && header2->pointFormat == VERTEX_STREAM_FORMAT_QUANTIZED)
+			DequantizePositions( (const unsigned short*) src, count, header2->boundsMin, header2->boundsSize, dst );
+		else
+			memcpy( dst, src, (size_t) gPointStride * count );
+	}
+
+	if (target.normals)
+	{
+		const BYTE *src = models_data + header->normalOffset + (size_t) first * header->normalStride;
+		float *dst = target.normals + dstVertex * 4;
+
+		if (header2 && header2->normalFormat == VERTEX_STREAM_FORMAT_QUANTIZED)
+			DequantizeNormals( (const short*) src, count, dst );
+		else
+			memcpy( dst, src, (size_t) gNormalStride * count );
+	}
+
+	if (target.tangents)
+	{
+		const BYTE *src = models_data + header->tangentOffset + (size_t) first * header->tangentStride;
+		float *dst = target.tangents + dstVertex * 4;
+
+		if (header2 && header2->tangentFormat == VERTEX_STREAM_FORMAT_QUANTIZED)
+			DequantizeTangents( (const short*) src, count, dst );
+		else
+			memcpy( dst, src, (size_t) gTangentStride * count );
+	}
+
+	if (target.uvs)
+	{
+		const BYTE *src = models_data + header->uvOffset + (size_t) first * header->uvStride;
+		float *dst = target.uvs + dstVertex * 2;
+
+		if (header2 && header2->uvFormat == VERTEX_STREAM_FORMAT_QUANTIZED)
+			DequantizeUVs( (const unsigned short*) src, count, dst );
+		else
+			memcpy( dst, src, (size_t) gUVStride * count );
+	}
+}
+
+static void MergeIndexChunk( const BYTE *models_data, const MergeModel &model, const MergeChunk &chunk, const VertexMergeTarget &target )
+{
+	unsigned int *dst = target.indices + (size_t) chunk.firstIndex + chunk.first;
+
+	if (model.indexStride == gIndexStride16)
+		RebaseIndices( (const unsigned short*) (models_data + chunk.indicesOffset) + chunk.first, chunk.count, model.firstVertex, dst );
+	else
+		RebaseIndices( (const unsigned int*) (models_data + chunk.indicesOffset) + chunk.first, chunk.count, model.firstVertex, dst );
+}
+
+bool MergeGeometryStreams( const BYTE *models_data, const VertexMergeTarget &target, const int numberOfThreads )
+{
+	if (models_data == nullptr)
+		return false;
+
+	const FileGeometryHeader *fileHeader = (const FileGeometryHeader*) models_data;
+	const bool version2 = (fileHeader->version >= GEOMETRY_FILE_VERSION_2);
+
+	// destination offsets of the models and the chunks of work
+
+	std::vector<MergeModel>		models;
+	std::vector<MergeChunk>		chunks;
+
+	models.reserve( fileHeader->numberOfModels );
+
+	const BYTE *ptr = models_data + sizeof(FileGeometryHeader);
+
+	unsigned int accumNumberOfVertices = 0;
+	unsigned int accumNumberOfIndices = 0;
+
+	const bool hasVertexStreams = (target.positions || target.normals || target.tangents || target.uvs);
+
+	for (int i=0; i<fileHeader->numberOfModels; ++i)
+	{
+		MergeModel model;
+		model.header = (const VertexDataHeader*) ptr;
+		model.header2 = (version2) ? (const VertexDataHeader2*) ptr : nullptr;
+
+		const VertexDataHeader *header = model.header;
+		const VertexDataHeader2 *header2 = model.header2;
+
+		const BYTE pointFormat = (header2) ? header2->pointFormat : VERTEX_STREAM_FORMAT_FLOAT;
+		const BYTE normalFormat = (header2) ? header2->normalFormat : VERTEX_STREAM_FORMAT_FLOAT;
+		const BYTE tangentFormat = (header2) ? header2->tangentFormat : VERTEX_STREAM_FORMAT_FLOAT;
+		const BYTE uvFormat = (header2) ? header2->uvFormat : VERTEX_STREAM_FORMAT_FLOAT;
+		model.indexStride = (header2) ? header2->indexStride : gIndexStride;
+
+		// check if strides are supported
+		if (header->pointStride != ((pointFormat == VERTEX_STREAM_FORMAT_QUANTIZED) ? gPointStrideQuantized : gPointStride)
+			|| header->normalStride != ((normalFormat == VERTEX_STREAM_FORMAT_QUANTIZED) ? gNormalStrideQuantized : gNormalStride)
+			|| header->tangentStride != ((tangentFormat == VERTEX_STREAM_FORMAT_QUANTIZED) ? gTangentStrideQuantized : gTangentStride)
+			|| header->uvStride != ((uvFormat == VERTEX_STREAM_FORMAT_QUANTIZED) ? gUVStrideQuantized : gUVStride)
+			|| (model.indexStride != gIndexStride && model.indexStride != gIndexStride16) )
+			return false;
+
+		// go to next model
+		ptr = models_data + header->endOffset;
+
+		// skip zero geometry and instance records, they share the streams of the source record
+		if (header->numVertices <= 0 || header->numIndices <= 0
+			|| VertexDataHeader3::GetInstanceOf(models_data, header) >= 0)
+			continue;
+
+		model.firstVertex = accumNumberOfVertices;
+		model.firstIndex = accumNumberOfIndices;
+
+		// lod levels go right after the record indices
+		const int lodsNumberOfIndices = VertexDataHeader3::GetLodsNumberOfIndices(models_data, header);
+
+		accumNumberOfVertices += header->numVertices;
+		accumNumberOfIndices += header->numIndices + lodsNumberOfIndices;
+
+		if (accumNumberOfVertices > (unsigned int) fileHeader->totalNumberOfVertices
+			|| accumNumberOfIndices > (unsigned int) fileHeader->totalNumberOfIndices)
+			return false;
+
+		const int modelIndex = (int) models.size();
+		models.push_back(model);
+
+		if (hasVertexStreams)
+		{
+			for (int first=0; first<header->numVertices; first+=MERGE_CHUNK_VERTICES)
+			{
+				MergeChunk chunk = { modelIndex, first, std::min(MERGE_CHUNK_VERTICES, header->numVertices - first), false, 0, 0 };
+				chunks.push_back(chunk);
+			}
+		}
+		if (target.indices)
+		{
+			for (int first=0; first<header->numIndices; first+=MERGE_CHUNK_INDICES)
+			{
+				MergeChunk chunk = { modelIndex, first, std::min(MERGE_CHUNK_INDICES, header->numIndices - first), true, 
+					header->indicesOffset, model.firstIndex };
+				chunks.push_back(chunk);
+			}
+
+			if (lodsNumberOfIndices > 0)
+			{
+				const VertexDataHeader3 *header3 = (const VertexDataHeader3*) header;
+				const MeshLodHeader *lods = (const MeshLodHeader*) (models_data + header3->lodsOffset);
+				unsigned int levelFirstIndex = model.firstIndex + header->numIndices;
+
+				for (int i=0; i<header3->numberOfLods; ++i)
+				{
+					for (int first=0; first<lods[i].numIndices; first+=MERGE_CHUNK_INDICES)
+					{
+						MergeChunk chunk = { modelIndex, first, std::min(MERGE_CHUNK_INDICES, lods[i].numIndices - first), true, 
+							lods[i].indicesOffset, levelFirstIndex };
+						chunks.push_back(chunk);
+					}
+					levelFirstIndex += lods[i].numIndices;
+				}
+			}
+		}
+	}
+
+	// chunks write into the separate ranges of the destination, no locks are needed
+	std::atomic<int>	nextChunk(0);
+
+	auto fn_worker = [&] () {
+		for (int i=nextChunk++; i<(int) chunks.size(); i=nextChunk++)
+		{
+			const MergeChunk &chunk = chunks[i];
+
+			if (chunk.indices)
+				MergeIndexChunk( models_data, models[chunk.model], chunk, target );
+			else
+				MergeVertexChunk( models_data, models[chunk.model], chunk.first, chunk.count, target );
+		}
+	};
+
+	int threads = (numberOfThreads > 0) ? numberOfThreads : (int) std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, (int) chunks.size()) );
+
+	std::vector<std::thread>	workers;
+	for (int i=1; i<threads; ++i)
+		workers.push_back( std::thread(fn_worker) );
+
+	fn_worker();
+
+	for (auto iter=begin(workers); iter!=end(workers); ++iter)
+		iter->join();
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// VertexMergeStaging
+
+bool VertexMergeStaging::Merge( const BYTE *models_data, const int numberOfThreads )
+{
+	Clear();
+
+	if (models_data == nullptr)
+		return false;
+
+	const FileGeometryHeader *fileHeader = (const FileGeometryHeader*) models_data;
+
+	if (fileHeader->numberOfModels == 0 || fileHeader->totalNumberOfIndices == 0 || fileHeader->totalNumberOfVertices == 0)
+		return false;
+
+	positions.resize( fileHeader->totalNumberOfVertices );
+	normals.resize( fileHeader->totalNumberOfVertices );
+	indices.resize( fileHeader->totalNumberOfIndices );
+
+	VertexMergeTarget	target;
+	VertexMergeTarget::Set( (float*) positions.data(), (float*) normals.data(), nullptr, nullptr, indices.data(), target );
+
+	if (false == MergeGeometryStreams( models_data, target, numberOfThreads ) )
+	{
+		Clear();
+		return false;
+	}
+
+	return true;
+}
+
+void VertexMergeStaging::Clear()
+{
+	std::vector<vec4>().swap(positions);
+	std::vector<vec4>().swap(normals);
+	std::vector<unsigned int>().swap(indices);
+}
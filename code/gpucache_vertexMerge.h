@@ -0,0 +1,69 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_vertexMerge.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_types.h"
+#include "algorithm/nv_math.h"
+
+#include <vector>
+
+//
+// merge vertex records of the geometry pack into global streams
+//	every stream is written once into the destination (client arrays, mapped gpu buffers),
+//	compact streams are dequantized on the way and indices are rebased to the global vertex index
+//	instance records are not merged, they use the range of their source record
+//	lod levels of a record are merged right after its indices, in the order of levels
+//
+
+// destination of the merged streams, nullptr - skip the stream
+//	positions, normals, tangents - 4 floats per vertex, uvs - 2 floats, indices - unsigned int
+struct VertexMergeTarget
+{
+	float			*positions;
+	float			*normals;
+	float			*tangents;
+	float			*uvs;
+	unsigned int	*indices;
+
+	static void Set(float *_positions, float *_normals, float *_tangents, float *_uvs, unsigned int *_indices, VertexMergeTarget &target)
+	{
+		target.positions = _positions;
+		target.normals = _normals;
+		target.tangents = _tangents;
+		target.uvs = _uvs;
+		target.indices = _indices;
+	}
+};
+
+// vertex and index streams are split into chunks between the threads, 0 - number of hardware threads
+//	returns false if the pack has unsupported strides or it's not conform to the header totals
+bool MergeGeometryStreams( const BYTE *models_data, const VertexMergeTarget &target, const int numberOfThreads=0 );
+
+// dst[i] = src[i] + base
+void RebaseIndices( const unsigned int *src, const int count, const unsigned int base, unsigned int *dst );
+void RebaseIndices( const unsigned short *src, const int count, const unsigned int base, unsigned int *dst );
+
+// client side streams merged ahead of the upload (pipelined loader worker), the same layout as the CGPUVertexData arrays
+//	tangents and uvs are not staged, they are merged on upload straight into the mapped buffers
+struct VertexMergeStaging
+{
+	std::vector<vec4>			positions;
+	std::vector<vec4>			normals;
+	std::vector<unsigned int>	indices;
+
+	// resize to the pack totals and merge, the arrays are empty when the pack is not supported
+	bool Merge( const BYTE *models_data, const int numberOfThreads=0 );
+
+	// free the memory
+	void Clear();
+};
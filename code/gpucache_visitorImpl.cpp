@@ -13,6 +13,7 @@
 
 
 #include "gpucache_visitorImpl.h"
+#include "shared_texturesRegistry.h"
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -47,8 +48,22 @@ CGPUCacheLoaderVisitorImpl::CGPUCacheLoaderVisitorImpl(CGPUCacheModel *pModel)
 
 	mImageIndex = 0;
 	mSamplerIndex = 0;
+	mImageDigest = 0;
 	mMaterialIndex = 0;
 	mShaderIndex = 0;
+
+	mVertexDataMerged = false;
+
+	mModelFirstIndex = 0;
+	mInstanceModel = false;
+	mModelClusters = nullptr;
+	mModelNumberOfClusters = 0;
+	mModelsData = nullptr;
+	mModelLods = nullptr;
+	mModelNumberOfLods = 0;
+	mModelLodsFirstIndex = 0;
+	mModelLodsNumberOfIndices = 0;
+	mModelPatchIndex = 0;
 }
 
 
@@ -73,14 +88,22 @@ bool CGPUCacheLoaderVisitorImpl::OnReadTexturesBegin( const char *textures_filen
 	mTextures->Clear();
 	mTextures->Allocate(numberOfSamplers, numberOfImages);
 
+	mTexturesFilename = (textures_filename) ? textures_filename : "";
+
 	mImageIndex = 0;
 	mSamplerIndex = 0;
+	mImageDigest = 0;
 #ifdef _DEBUG
 	gCountLock = 0;
 #endif
 	return true;
 }
 
+void CGPUCacheLoaderVisitorImpl::OnReadTexturesDigest(const int imageIndex, const uint64_t digest)
+{
+	mImageDigest = (mModel->ShareTextures) ? digest : 0;
+}
+
 void CGPUCacheLoaderVisitorImpl::OnReadEmptyImage()
 {
 	mImageIndex += 1;
@@ -232,6 +255,25 @@ void CGPUCacheLoaderVisitorImpl::OnReadTexturesImage2(const BYTE type, const Ima
 	BYTE *stream = (BYTE*) imageData;
 	GLuint texId=0;
 
+	CTexturesRegistry &registry = CTexturesRegistry::GetInstance();
+
+	// the same image is already uploaded by another cache
+	if (type == IMAGE_TYPE_STILL && mImageDigest != 0)
+	{
+		texId = registry.Acquire(mImageDigest);
+
+		if (texId > 0)
+		{
+			mTextures->mResourceIds[mImageIndex] = texId;
+			mTextures->mResourceDigests[mImageIndex] = mImageDigest;
+			mTextures->mTextureDimentions[mImageIndex] = vec2(header->width, header->height);
+
+			mImageDigest = 0;
+			mImageIndex += 1;
+			return;
+		}
+	}
+
 	// skip image type
 	stream += sizeof(BYTE);
 
@@ -245,13 +287,15 @@ void CGPUCacheLoaderVisitorImpl::OnReadTexturesImage2(const BYTE type, const Ima
 		
 		glGenTextures(1, &texId); 
 
-		if (header->size == (header->width * header->height * components) )
+		if (header->compressed == 0 && header->size == (header->width * header->height * components) )
 		{
 			glBindTexture(GL_TEXTURE_2D, texId);
 
 			if (header->numberOfLODs > 1)
 			{
 				glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header->numberOfLODs-1 );
+				// rows of the small rgb levels are not 4 bytes aligned
+				glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
 			}
 
 			glTexImage2D(GL_TEXTURE_2D, 0, header->internalFormat, header->width, header->height, 0, header->format, GL_UNSIGNED_BYTE, stream);
@@ -271,6 +315,10 @@ void CGPUCacheLoaderVisitorImpl::OnReadTexturesImage2(const BYTE type, const Ima
 			{
 				glGenerateMipmap(GL_TEXTURE_2D);
 			}
+			else
+			{
+				glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+			}
 
 			glBindTexture(GL_TEXTURE_2D, 0);
 		}
@@ -319,10 +367,41 @@ void CGPUCacheLoaderVisitorImpl::OnReadTexturesImage2(const BYTE type, const Ima
 			printf( "%d\n", handle );
 		}
 	}
+	else if (type == IMAGE_TYPE_SEQUENCE)
+	{
+		const ImageSequenceHeader2 *seqHeader = (const ImageSequenceHeader2*) stream;
+		stream += sizeof(ImageSequenceHeader2);
+
+		CGPUImageSequencer &sequencer = mTextures->mResourceFrames[mImageIndex];
+		sequencer.GetHeader() = *seqHeader;
+
+		// only a window of frames is resident, they are read from the pack by the sequencer stream
+		const int numberOfFrames = (seqHeader->numberOfFrames > 0) ? seqHeader->numberOfFrames : seqHeader->stopFrame + 1;
+		const int64_t framesOffset = (int64_t) (fileImageOffset + sizeof(BYTE) + sizeof(ImageSequenceHeader2));
+
+		CImageSequenceFileSource *source = new CImageSequenceFileSource();
+
+		if (false == source->Open( mTexturesFilename.c_str(), framesOffset, numberOfFrames, (const ImageSequenceLink*) stream, (size_t) seqHeader->size ) )
+		{
+			printf( "failed to open image sequence frames\n" );
+			delete source;
+		}
+		else if (sequencer.OpenStream( source, mTextures->GetSequenceMemoryBudget() ) )
+		{
+			sequencer.Evaluate(0.0);
+			sequencer.UpdateTexture( &texId, false, false );
+		}
+	}
 
 	mTextures->mResourceIds[mImageIndex] = texId;
 	mTextures->mTextureDimentions[mImageIndex] = vec2(header->width, header->height);
 
+	// sequences are not shared, their frames are streamed into the texture
+	if (type == IMAGE_TYPE_STILL && mImageDigest != 0 && registry.Register(mImageDigest, texId, imageSize) )
+		mTextures->mResourceDigests[mImageIndex] = mImageDigest;
+	
+	mImageDigest = 0;
+
 	CHECK_GL_ERROR();
 
 	mImageIndex += 1;
@@ -457,12 +536,34 @@ bool CGPUCacheLoaderVisitorImpl::OnReadModelsBegin(const int numberOfModels, con
 	mAccumNumberOfIndices = 0;
 	mSubmodelIndex = 0;
 
+	mRecordFirstIndex.clear();
+	mRecordFirstIndex.reserve(numberOfModels);
+
 	return true;
 }
 
-void CGPUCacheLoaderVisitorImpl::OnReadVertexData( FileGeometryHeader *const pHeader, const BYTE *data )
+void CGPUCacheLoaderVisitorImpl::OnPrepareVertexData( const FileGeometryHeader *pHeader, const BYTE *data )
+{
+	// cpu part only, could be called from a loader worker thread
+	mVertexDataMerged = mVertexData->MergeFromCache(data);
+}
+
+void CGPUCacheLoaderVisitorImpl::OnTakeMergedVertexData( const FileGeometryHeader *pHeader, const BYTE *data, VertexMergeStaging &staging )
+{
+	// merged by the pipelined loader worker, otherwise it's merged again on upload
+	mVertexDataMerged = mVertexData->TakeMergedData(staging);
+}
+
+void CGPUCacheLoaderVisitorImpl::OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data )
 {
-	mVertexData->UpdateFromCache(data);
+	mVertexData->SetGeometryHeap( (mModel->ShareGeometry) ? &CGeometryHeap::GetInstance() : nullptr );
+
+	if (mVertexDataMerged)
+		mVertexData->UploadMergedData(data);
+	else
+		mVertexData->UpdateFromCache(data);
+
+	mVertexDataMerged = false;
 }
 
 void CGPUCacheLoaderVisitorImpl::OnReadModel(const char *name, 
@@ -479,6 +580,38 @@ void CGPUCacheLoaderVisitorImpl::OnReadModel(const char *name,
 	mModelRender->mSubModelNames.push_back(name);
 	mNumberOfIndices = 0;
 
+	const int instanceOf = VertexDataHeader3::GetInstanceOf(data, pheader);
+	
+	mInstanceModel = (instanceOf >= 0 && instanceOf < (int) mRecordFirstIndex.size() );
+	mModelFirstIndex = (mInstanceModel) ? mRecordFirstIndex[instanceOf] : mAccumNumberOfIndices;
+	mRecordFirstIndex.push_back(mModelFirstIndex);
+
+	mModelClusters = nullptr;
+	mModelNumberOfClusters = 0;
+
+	mModelsData = data;
+	mModelLods = nullptr;
+	mModelNumberOfLods = 0;
+	mModelLodsFirstIndex = mModelFirstIndex + (unsigned int) pheader->numIndices;
+	mModelLodsNumberOfIndices = 0;
+	mModelPatchIndex = 0;
+
+	if ( ((const FileGeometryHeader*) data)->version >= GEOMETRY_FILE_VERSION_3)
+	{
+		const VertexDataHeader3 *pheader3 = (const VertexDataHeader3*) pheader;
+		if (pheader3->numberOfClusters > 0)
+		{
+			mModelClusters = (const MeshCluster*) (data + pheader3->clustersOffset);
+			mModelNumberOfClusters = pheader3->numberOfClusters;
+		}
+		if (pheader3->numberOfLods > 0)
+		{
+			mModelLods = (const MeshLodHeader*) (data + pheader3->lodsOffset);
+			mModelNumberOfLods = std::min( pheader3->numberOfLods, MESH_LOD_MAX_LEVELS-1 );
+			mModelLodsNumberOfIndices = (unsigned int) VertexDataHeader3::GetLodsNumberOfIndices(data, pheader);
+		}
+	}
+
 	mModelShaderId = 0;
 	mOpaqueModel = 0.0f;
 
@@ -546,6 +679,16 @@ void CGPUCacheLoaderVisitorImpl::OnReadModel(const char *name,
 
 	const double dist = sqrt( ldiff[0]*ldiff[0] + ldiff[1]*ldiff[1] + ldiff[2]*ldiff[2] );
 	mBSphere = vec4( (float)lcenter[0], (float)lcenter[1], (float)lcenter[2], (float)dist );
+
+	CGPUModelRenderCached::ModelLodInfo	lodInfo;
+	memset( &lodInfo, 0, sizeof(CGPUModelRenderCached::ModelLodInfo) );
+
+	lodInfo.bsphere = mBSphere;
+	lodInfo.numberOfLods = 1 + mModelNumberOfLods;
+	for (int i=0; i<mModelNumberOfLods; ++i)
+		lodInfo.errors[i+1] = mModelLods[i].error;
+
+	mModelRender->mModelLods.push_back(lodInfo);
 }
 
 void CGPUCacheLoaderVisitorImpl::OnReadModelPatch(const int offset, const int size, const int materialId)
@@ -555,7 +698,7 @@ void CGPUCacheLoaderVisitorImpl::OnReadModelPatch(const int offset, const int si
 	command.primCount = 1;
 
 	command.count = size;
-	command.firstIndex = offset + mAccumNumberOfIndices; // DONE: shift this value by prev meshes numberOfIndices
+	command.firstIndex = offset + mModelFirstIndex; // DONE: shift this value by prev meshes numberOfIndices
 	command.baseInstance = (GLuint) mModelRender->mMeshInfos.size();
 	command.primCount = (mOpaqueModel > 0.0f) ? 0 : 1;
 	mModelRender->mCommands.push_back(command);
@@ -564,6 +707,44 @@ void CGPUCacheLoaderVisitorImpl::OnReadModelPatch(const int offset, const int si
 
 	mModelRender->mBSphereCoords.push_back(mBSphere);
 	mModelRender->mBShaderInfo.push_back(vec4(mOpaqueModel, 0.0f, 0.0f, 0.0f));
+
+	// clusters are built inside the patches, move them into the merged index buffer
+	const int firstCluster = (int) mModelRender->mClusters.size();
+
+	for (int i=0; i<mModelNumberOfClusters; ++i)
+	{
+		MeshCluster cluster = mModelClusters[i];
+		if (cluster.firstIndex >= offset && cluster.firstIndex + cluster.numIndices <= offset + size)
+		{
+			cluster.firstIndex += (int) mModelFirstIndex;
+			mModelRender->mClusters.push_back(cluster);
+		}
+	}
+	mModelRender->mMeshClusters.push_back( std::make_pair(firstCluster, (int) mModelRender->mClusters.size() - firstCluster) );
+
+	// index range of every level, the source level is the patch itself
+	const int firstLodRange = (int) mModelRender->mLodRanges.size();
+	mModelRender->mLodRanges.push_back( std::make_pair( command.firstIndex, command.count ) );
+
+	unsigned int levelFirstIndex = mModelLodsFirstIndex;
+
+	for (int i=0; i<mModelNumberOfLods; ++i)
+	{
+		const MeshLodHeader &lod = mModelLods[i];
+		
+		if (mModelPatchIndex < lod.numberOfPatches)
+		{
+			const int *patch = (const int*) (mModelsData + lod.patchesOffset) + 2 * mModelPatchIndex;
+			mModelRender->mLodRanges.push_back( std::make_pair( levelFirstIndex + (GLuint) patch[0], (GLuint) patch[1] ) );
+		}
+		else
+		{
+			mModelRender->mLodRanges.push_back( std::make_pair( command.firstIndex, command.count ) );
+		}
+		levelFirstIndex += (unsigned int) lod.numIndices;
+	}
+	mModelRender->mMeshLods.push_back( std::make_pair(firstLodRange, (int) mModelRender->mLodRanges.size() - firstLodRange) );
+	mModelPatchIndex += 1;
 	
 	//TClientMeshDATA clientMeshData;
 	//clientMeshData.material = matId;
@@ -586,7 +767,8 @@ void CGPUCacheLoaderVisitorImpl::OnReadModelPatch(const int offset, const int si
 
 void CGPUCacheLoaderVisitorImpl::OnReadModelFinish()
 {
-	mAccumNumberOfIndices += mNumberOfIndices;
+	if (false == mInstanceModel)
+		mAccumNumberOfIndices += mNumberOfIndices + mModelLodsNumberOfIndices;
 	mSubmodelIndex += 1;
 }
 
@@ -594,6 +776,9 @@ void CGPUCacheLoaderVisitorImpl::OnReadModelsEnd()
 {
 	mShaders->CauseAGPUUpdate();
 
+	// instances of one mesh go one after another, so they could be drawn by one instanced command
+	mModelRender->GroupInstancedMeshes();
+
 	// DONE: update per mesh pointers to models
 	mModelRender->PrepRender();
 
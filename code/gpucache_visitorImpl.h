@@ -37,6 +37,7 @@ public:
 	void OnReadTexturesImage1(const ImageHeader *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override;
 	void OnReadTexturesImage2(const BYTE type, const ImageHeader2 *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override;
 	void OnReadEmptyImage() override;
+	void OnReadTexturesDigest(const int imageIndex, const uint64_t digest) override;
 	void OnReadTexturesSampler(const char *sampler_name, const char *sampler_file, const SamplerHeader *header, const size_t fileSamplerOffset, const size_t samplerSize, const BYTE *samplerData) override;
 	void OnReadTexturesError(const char *what) override;
 	void OnReadTexturesEnd() override;
@@ -52,7 +53,9 @@ public:
 
 	// geometry, models
 	bool OnReadModelsBegin(const int numberOfModels, const int numberOfMeshes, const double *bounding_min, const double *bounding_max) override;
-	void OnReadVertexData( FileGeometryHeader *const pHeader, const BYTE *data ) override;
+	void OnPrepareVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) override;
+	void OnTakeMergedVertexData( const FileGeometryHeader *pHeader, const BYTE *data, VertexMergeStaging &staging ) override;
+	void OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) override;
 	void OnReadModel(const char *name, 
 						const double *translation, 
 						const double *rotation, 
@@ -74,14 +77,17 @@ protected:
 	CMaterialsReference		*mMaterials;
 	CShadersReference		*mShaders;
 
+	std::string				mTexturesFilename;	// image sequence frames are streamed from the pack
 	int						mImageIndex;
 	int						mSamplerIndex;
+	uint64_t		mImageDigest;		// next image content, when it's shared in the textures registry
 
 	int						mShaderIndex;
 	int						mMaterialIndex;
 
 	CGPUModelRenderCached	*mModelRender;
 	CGPUVertexData			*mVertexData;
+	bool					mVertexDataMerged;	// merge is done in OnPrepareVertexData
 
 	int						mSubmodelIndex;
 	int						mModelShaderId;
@@ -90,6 +96,23 @@ protected:
 	unsigned int			mNumberOfIndices;
 	unsigned int			mAccumNumberOfIndices;
 
+	// instance records draw the index range of their source record
+	std::vector<unsigned int>	mRecordFirstIndex;
+	unsigned int				mModelFirstIndex;
+	bool						mInstanceModel;
+
+	// triangle clusters of the current model record
+	const MeshCluster			*mModelClusters;
+	int							mModelNumberOfClusters;
+
+	// lod levels of the current model record, they follow the record indices in the merged index buffer
+	const BYTE					*mModelsData;
+	const MeshLodHeader			*mModelLods;
+	int							mModelNumberOfLods;
+	unsigned int				mModelLodsFirstIndex;
+	unsigned int				mModelLodsNumberOfIndices;
+	int							mModelPatchIndex;
+
 	static bool LoadImageData( int fh, GLuint &texId, vec2 &dimentions, BYTE *localImageBuffer, bool &isComporessed );
 	static bool LoadImageData2( int fh, GLuint &texId, vec2 &dimentions, BYTE *localImageBuffer, CGPUImageSequencer &sequencer, bool &isComporessed );
 
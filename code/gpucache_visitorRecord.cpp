@@ -0,0 +1,232 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_visitorRecord.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_visitorRecord.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+CGPUCacheLoaderVisitorRecord::CGPUCacheLoaderVisitorRecord()
+	: CGPUCacheLoaderVisitor()
+{
+}
+
+CGPUCacheLoaderVisitorRecord::~CGPUCacheLoaderVisitorRecord()
+{
+}
+
+void CGPUCacheLoaderVisitorRecord::Clear()
+{
+	mEvents.clear();
+}
+
+const int CGPUCacheLoaderVisitorRecord::Compare(const CGPUCacheLoaderVisitorRecord &other) const
+{
+	const size_t count = std::min( mEvents.size(), other.mEvents.size() );
+
+	for (size_t i=0; i<count; ++i)
+	{
+		if (mEvents[i] != other.mEvents[i])
+			return (int) i;
+	}
+
+	if (mEvents.size() != other.mEvents.size() )
+		return (int) count;
+
+	return -1;
+}
+
+bool CGPUCacheLoaderVisitorRecord::SaveToFile(const char *filename) const
+{
+	FILE *fp = nullptr;
+	fopen_s(&fp, filename, "w");
+
+	if (fp == nullptr)
+		return false;
+
+	for (auto iter=begin(mEvents); iter!=end(mEvents); ++iter)
+	{
+		fputs( iter->c_str(), fp );
+		fputs( "\n", fp );
+	}
+
+	fclose(fp);
+	return true;
+}
+
+void CGPUCacheLoaderVisitorRecord::AddEvent(const char *format, ...)
+{
+	char buffer[1024];
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf( buffer, sizeof(buffer), format, args );
+	va_end(args);
+
+	buffer[sizeof(buffer)-1] = 0;
+	mEvents.push_back(buffer);
+}
+
+// FNV-1a
+unsigned int CGPUCacheLoaderVisitorRecord::HashData(const void *data, const size_t size)
+{
+	if (data == nullptr)
+		return 0;
+
+	const BYTE *ptr = (const BYTE*) data;
+	unsigned int hash = 2166136261U;
+
+	for (size_t i=0; i<size; ++i)
+	{
+		hash ^= ptr[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+// main header
+void CGPUCacheLoaderVisitorRecord::OnReadHeader(const char *xmlFilename, const char *sourceFilename)
+{
+	AddEvent( "header %s %s", xmlFilename, sourceFilename );
+}
+
+// textures
+bool CGPUCacheLoaderVisitorRecord::OnReadTexturesBegin( const char *textures_filename, const int numberOfSamplers, const int numberOfImages )
+{
+	AddEvent( "textures begin %s samplers %d images %d", textures_filename, numberOfSamplers, numberOfImages );
+	return true;
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadTexturesImage1(const ImageHeader *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData)
+{
+	AddEvent( "image1 %dx%d lods %d offset %u size %u hash %08x", header->width, header->height, header->numberOfLODs,
+		(unsigned int) fileImageOffset, (unsigned int) imageSize, HashData(imageData, imageSize) );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadTexturesImage2(const BYTE type, const ImageHeader2 *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData)
+{
+	AddEvent( "image2 type %d %dx%d lods %d offset %u size %u hash %08x", (int) type, header->width, header->height, header->numberOfLODs,
+		(unsigned int) fileImageOffset, (unsigned int) imageSize, HashData(imageData, imageSize) );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadEmptyImage()
+{
+	AddEvent( "image empty" );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadTexturesDigest(const int imageIndex, const uint64_t digest)
+{
+	AddEvent( "image digest %d %08x%08x", imageIndex, (unsigned int) (digest >> 32), (unsigned int) digest );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadTexturesSampler(const char *sampler_name, const char *sampler_file, const SamplerHeader *header, const size_t fileSamplerOffset, const size_t samplerSize, const BYTE *samplerData)
+{
+	AddEvent( "sampler %s %s video %d offset %u hash %08x", sampler_name, sampler_file, header->videoIndex,
+		(unsigned int) fileSamplerOffset, HashData(samplerData, samplerSize) );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadTexturesError(const char *what)
+{
+	AddEvent( "textures error %s", what );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadTexturesEnd()
+{
+	AddEvent( "textures end" );
+}
+
+// materials, shaders, etc.
+bool CGPUCacheLoaderVisitorRecord::OnReadMaterialsBegin(const int numberOfMaterials)
+{
+	AddEvent( "materials begin %d", numberOfMaterials );
+	return true;
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadMaterial(const char *material_name, const MaterialGLSL &material )
+{
+	AddEvent( "material %s hash %08x", material_name, HashData(&material, sizeof(MaterialGLSL)) );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadMaterialsEnd()
+{
+	AddEvent( "materials end" );
+}
+
+bool CGPUCacheLoaderVisitorRecord::OnReadShadersBegin(const int numberOfShaders)
+{
+	AddEvent( "shaders begin %d", numberOfShaders );
+	return true;
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadShader(const char *shader_name, const int alphatype, const ShaderGLSL &shaderData )
+{
+	AddEvent( "shader %s alpha %d hash %08x", shader_name, alphatype, HashData(&shaderData, sizeof(ShaderGLSL)) );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadShadersEnd()
+{
+	AddEvent( "shaders end" );
+}
+
+// geometry, models
+bool CGPUCacheLoaderVisitorRecord::OnReadModelsBegin(const int numberOfModels, const int numberOfMeshes, const double *bounding_min, const double *bounding_max)
+{
+	AddEvent( "models begin %d meshes %d bbox %g %g %g - %g %g %g", numberOfModels, numberOfMeshes,
+		bounding_min[0], bounding_min[1], bounding_min[2], bounding_max[0], bounding_max[1], bounding_max[2] );
+	return true;
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data )
+{
+	const size_t packSize = CalculateGeometryPackSize(data);
+
+	AddEvent( "vertex data models %d vertices %d indices %d size %u hash %08x", pHeader->numberOfModels,
+		pHeader->totalNumberOfVertices, pHeader->totalNumberOfIndices, (unsigned int) packSize, HashData(data, packSize) );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadModel(const char *name,
+					const double *translation,
+					const double *rotation,
+					const double *scaling,
+					const double *bounding_min,
+					const double *bounding_max,
+					const int numberOfShaders,
+					const int *shaders,
+					const VertexDataHeader *pheader,
+					const BYTE *data)
+{
+	AddEvent( "model %s t %g %g %g r %g %g %g s %g %g %g bbox %g %g %g - %g %g %g shaders %d [%d %d %d %d %d] vertices %d indices %d",
+		name, translation[0], translation[1], translation[2], rotation[0], rotation[1], rotation[2],
+		scaling[0], scaling[1], scaling[2], bounding_min[0], bounding_min[1], bounding_min[2],
+		bounding_max[0], bounding_max[1], bounding_max[2], numberOfShaders,
+		shaders[0], shaders[1], shaders[2], shaders[3], shaders[4], pheader->numVertices, pheader->numIndices );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadModelPatch(const int offset, const int size, const int materialId)
+{
+	AddEvent( "patch %d %d material %d", offset, size, materialId );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadModelFinish()
+{
+	AddEvent( "model finish" );
+}
+
+void CGPUCacheLoaderVisitorRecord::OnReadModelsEnd()
+{
+	AddEvent( "models end" );
+}
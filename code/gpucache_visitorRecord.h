@@ -0,0 +1,93 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: gpucache_visitorRecord.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_loader.h"
+
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////
+// visitor without any gl calls, stores a text line for each callback
+//	data blocks are stored as a hash, so two loads of the same cache (sequential and pipelined)
+//	could be compared line by line
+
+class CGPUCacheLoaderVisitorRecord : public CGPUCacheLoaderVisitor
+{
+public:
+
+	//! a constructor
+	CGPUCacheLoaderVisitorRecord();
+
+	//! a destructor
+	virtual ~CGPUCacheLoaderVisitorRecord();
+
+	void Clear();
+
+	const std::vector<std::string> &GetEvents() const
+	{
+		return mEvents;
+	}
+
+	// returns index of a first different event or -1 if records are equal
+	const int Compare(const CGPUCacheLoaderVisitorRecord &other) const;
+
+	bool SaveToFile(const char *filename) const;
+
+	// main header
+	void OnReadHeader(const char *xmlFilename, const char *sourceFilename) override;
+
+	// textures
+	bool OnReadTexturesBegin( const char *textures_filename, const int numberOfSamplers, const int numberOfImages ) override;
+	void OnReadTexturesImage1(const ImageHeader *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override;
+	void OnReadTexturesImage2(const BYTE type, const ImageHeader2 *header, const size_t fileImageOffset, const size_t imageSize, const BYTE *imageData) override;
+	void OnReadEmptyImage() override;
+	void OnReadTexturesDigest(const int imageIndex, const uint64_t digest) override;
+	void OnReadTexturesSampler(const char *sampler_name, const char *sampler_file, const SamplerHeader *header, const size_t fileSamplerOffset, const size_t samplerSize, const BYTE *samplerData) override;
+	void OnReadTexturesError(const char *what) override;
+	void OnReadTexturesEnd() override;
+
+	// materials, shaders, etc.
+	bool OnReadMaterialsBegin(const int numberOfMaterials) override;
+	void OnReadMaterial(const char *material_name, const MaterialGLSL &material ) override;
+	void OnReadMaterialsEnd() override;
+
+	bool OnReadShadersBegin(const int numberOfShaders) override;
+	void OnReadShader(const char *shader_name, const int alphatype, const ShaderGLSL &shaderData ) override;
+	void OnReadShadersEnd() override;
+
+	// geometry, models
+	bool OnReadModelsBegin(const int numberOfModels, const int numberOfMeshes, const double *bounding_min, const double *bounding_max) override;
+	void OnReadVertexData( const FileGeometryHeader *pHeader, const BYTE *data ) override;
+	void OnReadModel(const char *name,
+						const double *translation,
+						const double *rotation,
+						const double *scaling,
+						const double *bounding_min,
+						const double *bounding_max,
+						const int numberOfShaders,
+						const int *shaders,
+						const VertexDataHeader *pheader,
+						const BYTE *data) override;
+	void OnReadModelPatch(const int offset, const int size, const int materialId) override;
+	void OnReadModelFinish() override;
+	void OnReadModelsEnd() override;
+
+protected:
+
+	std::vector<std::string>	mEvents;
+
+	void AddEvent(const char *format, ...);
+
+	static unsigned int HashData(const void *data, const size_t size);
+};
@@ -0,0 +1,1378 @@
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <algorithm>
+#include <type_traits>
+
+#include "GLRecorder.h"
+#include "glewContext.h"
+
+// glew keeps the entry points in the global variables, or in the context for the multi context build
+#ifdef GLEW_MX
+#define GL_RECORDER_SLOT(name)		(glewGetContext()->__glew##name)
+#else
+#define GL_RECORDER_SLOT(name)		__glew##name
+#endif
+
+// recorded entry points in the order of EGLRecordCall
+#define GL_RECORDER_FUNCTIONS(X) \
+	X(GenBuffers) X(DeleteBuffers) X(BindBuffer) X(BindBufferBase) X(BindBufferRange) \
+	X(BufferData) X(BufferSubData) X(CopyBufferSubData) X(BufferStorage) X(NamedBufferData) X(NamedBufferSubData) \
+	X(NamedBufferDataEXT) X(NamedBufferSubDataEXT) X(MapBuffer) X(MapBufferRange) X(MapNamedBuffer) \
+	X(UnmapBuffer) X(UnmapNamedBuffer) X(FlushMappedBufferRange) X(GetBufferParameteriv) \
+	X(GetBufferParameterui64vNV) X(MakeBufferResidentNV) X(MakeBufferNonResidentNV) X(IsBufferResidentNV) \
+	X(MakeNamedBufferResidentNV) X(MakeNamedBufferNonResidentNV) X(BufferAddressRangeNV) X(ProgramUniform1ui64NV) \
+	X(GenFramebuffers) X(DeleteFramebuffers) X(BindFramebuffer) X(CheckFramebufferStatus) \
+	X(GenRenderbuffers) X(DeleteRenderbuffers) X(BindRenderbuffer) \
+	X(GenVertexArrays) X(DeleteVertexArrays) X(BindVertexArray) \
+	X(VertexAttribPointer) X(EnableVertexAttribArray) X(DisableVertexAttribArray) X(GenSamplers) X(DeleteSamplers) \
+	X(GetTextureHandleNV) X(GetTextureHandleARB) X(GetTextureSamplerHandleNV) X(GetTextureSamplerHandleARB) \
+	X(MakeTextureHandleResidentNV) X(MakeTextureHandleResidentARB) \
+	X(MakeTextureHandleNonResidentNV) X(MakeTextureHandleNonResidentARB) \
+	X(IsTextureHandleResidentNV) X(IsTextureHandleResidentARB) \
+	X(CompressedTexImage2D) X(CompressedTexSubImage2D) \
+	X(MultiDrawElementsIndirect) X(MultiDrawElementsIndirectBindlessNV) X(DispatchCompute) \
+	X(FenceSync) X(ClientWaitSync) X(WaitSync) X(DeleteSync) X(MemoryBarrier)
+
+#define GL_RECORDER_ADDRESS_BASE		0x0000000100000000ULL	// fake gpu addresses start above 4Gb
+#define GL_RECORDER_ADDRESS_ALIGN		256						// and have a guard gap between the buffers
+#define GL_RECORDER_HANDLE_BASE			0x0000100000000000ULL
+#define GL_RECORDER_LOG_LINE			256
+
+static CGLRecorder		*gRecorder = nullptr;
+
+static const char *gCallNames[eGLRecordCallCount] = {
+#define GL_RECORDER_NAME(name)	"gl" #name,
+	GL_RECORDER_FUNCTIONS(GL_RECORDER_NAME)
+#undef GL_RECORDER_NAME
+};
+
+// the same layouts as in shared_models.h
+struct RecordDrawCommand
+{
+	GLuint		count;
+	GLuint		instanceCount;
+	GLuint		firstIndex;
+	GLint		baseVertex;
+	GLuint		baseInstance;
+};
+
+struct RecordBindlessPtr
+{
+	GLuint		index;
+	GLuint		reserved;
+	GLuint64	address;
+	GLuint64	length;
+};
+
+static size_t GetIndexSize(const GLenum type)
+{
+	switch(type)
+	{
+	case GL_UNSIGNED_BYTE: return 1;
+	case GL_UNSIGNED_SHORT: return 2;
+	}
+	return 4;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// recording entry points, they forward the calls into the installed recorder
+
+class CGLRecorderDispatch
+{
+public:
+
+	// names
+
+	static void GLAPIENTRY RecordGenBuffers(GLsizei n, GLuint *buffers)
+	{
+		gRecorder->Call( eGLRecordGenBuffers, "glGenBuffers(%d)", n );
+		for (GLsizei i=0; i<n; ++i)
+		{
+			buffers[i] = gRecorder->NewName(eGLRecordBuffer);
+
+			CGLRecorder::BufferRecord &record = gRecorder->mBuffers[buffers[i]];
+			record.hasStorage = false;
+			record.immutable = false;
+			record.usage = 0;
+			record.storageFlags = 0;
+			record.address = 0;
+			record.resident = false;
+			record.mapped = false;
+			record.mapOffset = 0;
+			record.mapLength = 0;
+			record.mapAccess = 0;
+		}
+	}
+
+	static void GLAPIENTRY RecordDeleteBuffers(GLsizei n, const GLuint *buffers)
+	{
+		gRecorder->Call( eGLRecordDeleteBuffers, "glDeleteBuffers(%d)", n );
+		for (GLsizei i=0; i<n; ++i)
+		{
+			// unused names are silently ignored as in gl
+			if (buffers[i] == 0)
+				continue;
+
+			gRecorder->UnbindBuffer(buffers[i]);
+			gRecorder->mBuffers.erase(buffers[i]);
+		}
+	}
+
+	static void GLAPIENTRY RecordBindBuffer(GLenum target, GLuint buffer)
+	{
+		gRecorder->Call( eGLRecordBindBuffer, "glBindBuffer(0x%04x, %u)", target, buffer );
+		if (buffer > 0 && nullptr == gRecorder->FindBuffer(buffer, "glBindBuffer") )
+			return;
+
+		gRecorder->mBufferBindings[target] = buffer;
+		if (target == GL_ELEMENT_ARRAY_BUFFER)
+			gRecorder->mElementBuffers[gRecorder->mVertexArray] = buffer;
+	}
+
+	static void GLAPIENTRY RecordBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		gRecorder->Call( eGLRecordBindBufferBase, "glBindBufferBase(0x%04x, %u, %u)", target, index, buffer );
+		if (buffer > 0 && nullptr == gRecorder->FindBuffer(buffer, "glBindBufferBase") )
+			return;
+
+		// generic binding point is changed as well
+		gRecorder->mBufferBindings[target] = buffer;
+	}
+
+	static void GLAPIENTRY RecordBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		gRecorder->Call( eGLRecordBindBufferRange, "glBindBufferRange(0x%04x, %u, %u, %lld, %lld)", target, index, buffer,
+			(long long) offset, (long long) size );
+		if (buffer == 0)
+		{
+			gRecorder->mBufferBindings[target] = 0;
+			return;
+		}
+
+		CGLRecorder::BufferRecord *record = gRecorder->FindBuffer(buffer, "glBindBufferRange");
+		if (nullptr == record)
+			return;
+
+		if (offset < 0 || size <= 0 || (size_t) (offset + size) > record->data.size() )
+			gRecorder->Error( "glBindBufferRange: range [%lld, %lld) is out of the buffer %u size %u",
+				(long long) offset, (long long) (offset + size), buffer, (unsigned int) record->data.size() );
+
+		gRecorder->mBufferBindings[target] = buffer;
+	}
+
+	// storage
+
+	static void GLAPIENTRY RecordBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+	{
+		gRecorder->Call( eGLRecordBufferData, "glBufferData(0x%04x, %lld, %p, 0x%04x)", target, (long long) size, data, usage );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glBufferData");
+		if (record)
+			gRecorder->SetStorage( *record, size, data, usage, "glBufferData" );
+	}
+
+	static void GLAPIENTRY RecordBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+	{
+		gRecorder->Call( eGLRecordBufferSubData, "glBufferSubData(0x%04x, %lld, %lld, %p)", target, (long long) offset, (long long) size, data );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glBufferSubData");
+		if (record)
+			gRecorder->SubData( *record, offset, size, data, "glBufferSubData" );
+	}
+
+	static void GLAPIENTRY RecordCopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+	{
+		gRecorder->Call( eGLRecordCopyBufferSubData, "glCopyBufferSubData(0x%04x, 0x%04x, %lld, %lld, %lld)", readTarget, writeTarget,
+			(long long) readOffset, (long long) writeOffset, (long long) size );
+		CGLRecorder::BufferRecord *readRecord = gRecorder->FindBoundBuffer(readTarget, "glCopyBufferSubData");
+		CGLRecorder::BufferRecord *writeRecord = gRecorder->FindBoundBuffer(writeTarget, "glCopyBufferSubData");
+		if (readRecord && writeRecord)
+			gRecorder->CopySubData( *readRecord, *writeRecord, readOffset, writeOffset, size, "glCopyBufferSubData" );
+	}
+
+	static void GLAPIENTRY RecordBufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags)
+	{
+		gRecorder->Call( eGLRecordBufferStorage, "glBufferStorage(0x%04x, %lld, %p, 0x%x)", target, (long long) size, data, flags );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glBufferStorage");
+		if (record)
+			gRecorder->SetImmutableStorage( *record, size, data, flags, "glBufferStorage" );
+	}
+
+	static void GLAPIENTRY RecordNamedBufferData(GLuint buffer, GLsizeiptr size, const void *data, GLenum usage)
+	{
+		gRecorder->Call( eGLRecordNamedBufferData, "glNamedBufferData(%u, %lld, %p, 0x%04x)", buffer, (long long) size, data, usage );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBuffer(buffer, "glNamedBufferData");
+		if (record)
+			gRecorder->SetStorage( *record, size, data, usage, "glNamedBufferData" );
+	}
+
+	static void GLAPIENTRY RecordNamedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data)
+	{
+		gRecorder->Call( eGLRecordNamedBufferSubData, "glNamedBufferSubData(%u, %lld, %lld, %p)", buffer, (long long) offset, (long long) size, data );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBuffer(buffer, "glNamedBufferSubData");
+		if (record)
+			gRecorder->SubData( *record, offset, size, data, "glNamedBufferSubData" );
+	}
+
+	static void GLAPIENTRY RecordNamedBufferDataEXT(GLuint buffer, GLsizeiptr size, const void *data, GLenum usage)
+	{
+		gRecorder->Call( eGLRecordNamedBufferDataEXT, "glNamedBufferDataEXT(%u, %lld, %p, 0x%04x)", buffer, (long long) size, data, usage );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBuffer(buffer, "glNamedBufferDataEXT");
+		if (record)
+			gRecorder->SetStorage( *record, size, data, usage, "glNamedBufferDataEXT" );
+	}
+
+	static void GLAPIENTRY RecordNamedBufferSubDataEXT(GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data)
+	{
+		gRecorder->Call( eGLRecordNamedBufferSubDataEXT, "glNamedBufferSubDataEXT(%u, %lld, %lld, %p)", buffer, (long long) offset, (long long) size, data );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBuffer(buffer, "glNamedBufferSubDataEXT");
+		if (record)
+			gRecorder->SubData( *record, offset, size, data, "glNamedBufferSubDataEXT" );
+	}
+
+	// mapping
+
+	static GLbitfield AccessToBits(const GLenum access)
+	{
+		switch(access)
+		{
+		case GL_READ_ONLY: return GL_MAP_READ_BIT;
+		case GL_WRITE_ONLY: return GL_MAP_WRITE_BIT;
+		case GL_READ_WRITE: return GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
+		}
+		return 0;
+	}
+
+	static void *GLAPIENTRY RecordMapBuffer(GLenum target, GLenum access)
+	{
+		gRecorder->Call( eGLRecordMapBuffer, "glMapBuffer(0x%04x, 0x%04x)", target, access );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glMapBuffer");
+		if (nullptr == record)
+			return nullptr;
+		return gRecorder->Map( *record, 0, (GLsizeiptr) record->data.size(), AccessToBits(access), "glMapBuffer" );
+	}
+
+	static void *GLAPIENTRY RecordMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+	{
+		gRecorder->Call( eGLRecordMapBufferRange, "glMapBufferRange(0x%04x, %lld, %lld, 0x%x)", target, (long long) offset, (long long) length, access );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glMapBufferRange");
+		if (nullptr == record)
+			return nullptr;
+		return gRecorder->Map( *record, offset, length, access, "glMapBufferRange" );
+	}
+
+	static void *GLAPIENTRY RecordMapNamedBuffer(GLuint buffer, GLenum access)
+	{
+		gRecorder->Call( eGLRecordMapNamedBuffer, "glMapNamedBuffer(%u, 0x%04x)", buffer, access );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBuffer(buffer, "glMapNamedBuffer");
+		if (nullptr == record)
+			return nullptr;
+		return gRecorder->Map( *record, 0, (GLsizeiptr) record->data.size(), AccessToBits(access), "glMapNamedBuffer" );
+	}
+
+	static GLboolean GLAPIENTRY RecordUnmapBuffer(GLenum target)
+	{
+		gRecorder->Call( eGLRecordUnmapBuffer, "glUnmapBuffer(0x%04x)", target );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glUnmapBuffer");
+		if (nullptr == record)
+			return GL_FALSE;
+		return gRecorder->Unmap( *record, "glUnmapBuffer" );
+	}
+
+	static GLboolean GLAPIENTRY RecordUnmapNamedBuffer(GLuint buffer)
+	{
+		gRecorder->Call( eGLRecordUnmapNamedBuffer, "glUnmapNamedBuffer(%u)", buffer );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBuffer(buffer, "glUnmapNamedBuffer");
+		if (nullptr == record)
+			return GL_FALSE;
+		return gRecorder->Unmap( *record, "glUnmapNamedBuffer" );
+	}
+
+	static void GLAPIENTRY RecordFlushMappedBufferRange(GLenum target, GLintptr offset, GLsizeiptr length)
+	{
+		gRecorder->Call( eGLRecordFlushMappedBufferRange, "glFlushMappedBufferRange(0x%04x, %lld, %lld)", target, (long long) offset, (long long) length );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glFlushMappedBufferRange");
+		if (nullptr == record)
+			return;
+
+		if (false == record->mapped || 0 == (record->mapAccess & GL_MAP_FLUSH_EXPLICIT_BIT) )
+		{
+			gRecorder->Error( "glFlushMappedBufferRange: buffer is not mapped with GL_MAP_FLUSH_EXPLICIT_BIT" );
+			return;
+		}
+		if (offset < 0 || length < 0 || offset + length > record->mapLength)
+		{
+			gRecorder->Error( "glFlushMappedBufferRange: range [%lld, %lld) is out of the mapped length %lld",
+				(long long) offset, (long long) (offset + length), (long long) record->mapLength );
+			return;
+		}
+		gRecorder->Upload( (size_t) length );
+	}
+
+	static void GLAPIENTRY RecordGetBufferParameteriv(GLenum target, GLenum pname, GLint *params)
+	{
+		gRecorder->Call( eGLRecordGetBufferParameteriv, "glGetBufferParameteriv(0x%04x, 0x%04x)", target, pname );
+		*params = 0;
+
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glGetBufferParameteriv");
+		if (nullptr == record)
+			return;
+
+		switch(pname)
+		{
+		case GL_BUFFER_SIZE: *params = (GLint) record->data.size(); break;
+		case GL_BUFFER_USAGE: *params = (GLint) record->usage; break;
+		case GL_BUFFER_MAPPED: *params = (record->mapped) ? GL_TRUE : GL_FALSE; break;
+		case GL_BUFFER_ACCESS_FLAGS: *params = (GLint) record->mapAccess; break;
+		case GL_BUFFER_IMMUTABLE_STORAGE: *params = (record->immutable) ? GL_TRUE : GL_FALSE; break;
+		case GL_BUFFER_STORAGE_FLAGS: *params = (GLint) record->storageFlags; break;
+		default:
+			gRecorder->Error( "glGetBufferParameteriv: parameter 0x%04x is not supported", pname );
+		}
+	}
+
+	// bindless buffers
+
+	static void GLAPIENTRY RecordGetBufferParameterui64vNV(GLenum target, GLenum pname, GLuint64EXT *params)
+	{
+		gRecorder->Call( eGLRecordGetBufferParameterui64vNV, "glGetBufferParameterui64vNV(0x%04x, 0x%04x)", target, pname );
+		*params = 0;
+
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glGetBufferParameterui64vNV");
+		if (nullptr == record)
+			return;
+
+		if (pname != GL_BUFFER_GPU_ADDRESS_NV)
+		{
+			gRecorder->Error( "glGetBufferParameterui64vNV: parameter 0x%04x is not supported", pname );
+			return;
+		}
+		if (false == record->hasStorage)
+		{
+			gRecorder->Error( "glGetBufferParameterui64vNV: buffer %u has no storage", gRecorder->GetBoundBuffer(target) );
+			return;
+		}
+		*params = gRecorder->GetAddress(*record);
+	}
+
+	static void GLAPIENTRY RecordMakeBufferResidentNV(GLenum target, GLenum access)
+	{
+		gRecorder->Call( eGLRecordMakeBufferResidentNV, "glMakeBufferResidentNV(0x%04x, 0x%04x)", target, access );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glMakeBufferResidentNV");
+		if (record)
+			gRecorder->MakeResident( *record, "glMakeBufferResidentNV" );
+	}
+
+	static void GLAPIENTRY RecordMakeBufferNonResidentNV(GLenum target)
+	{
+		gRecorder->Call( eGLRecordMakeBufferNonResidentNV, "glMakeBufferNonResidentNV(0x%04x)", target );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glMakeBufferNonResidentNV");
+		if (record)
+			gRecorder->MakeNonResident( *record, "glMakeBufferNonResidentNV" );
+	}
+
+	static GLboolean GLAPIENTRY RecordIsBufferResidentNV(GLenum target)
+	{
+		gRecorder->Call( eGLRecordIsBufferResidentNV, "glIsBufferResidentNV(0x%04x)", target );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBoundBuffer(target, "glIsBufferResidentNV");
+		return (record && record->resident) ? GL_TRUE : GL_FALSE;
+	}
+
+	static void GLAPIENTRY RecordMakeNamedBufferResidentNV(GLuint buffer, GLenum access)
+	{
+		gRecorder->Call( eGLRecordMakeNamedBufferResidentNV, "glMakeNamedBufferResidentNV(%u, 0x%04x)", buffer, access );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBuffer(buffer, "glMakeNamedBufferResidentNV");
+		if (record)
+			gRecorder->MakeResident( *record, "glMakeNamedBufferResidentNV" );
+	}
+
+	static void GLAPIENTRY RecordMakeNamedBufferNonResidentNV(GLuint buffer)
+	{
+		gRecorder->Call( eGLRecordMakeNamedBufferNonResidentNV, "glMakeNamedBufferNonResidentNV(%u)", buffer );
+		CGLRecorder::BufferRecord *record = gRecorder->FindBuffer(buffer, "glMakeNamedBufferNonResidentNV");
+		if (record)
+			gRecorder->MakeNonResident( *record, "glMakeNamedBufferNonResidentNV" );
+	}
+
+	static void GLAPIENTRY RecordBufferAddressRangeNV(GLenum pname, GLuint index, GLuint64EXT address, GLsizeiptr length)
+	{
+		gRecorder->Call( eGLRecordBufferAddressRangeNV, "glBufferAddressRangeNV(0x%04x, %u, 0x%llx, %lld)", pname, index,
+			(unsigned long long) address, (long long) length );
+		if (address > 0 && false == gRecorder->IsAddressRangeResident(address, (GLuint64) length) )
+			gRecorder->Error( "glBufferAddressRangeNV: range 0x%llx + %lld is not in a resident buffer", (unsigned long long) address, (long long) length );
+	}
+
+	static void GLAPIENTRY RecordProgramUniform1ui64NV(GLuint program, GLint location, GLuint64EXT x)
+	{
+		gRecorder->Call( eGLRecordProgramUniform1ui64NV, "glProgramUniform1ui64NV(%u, %d, 0x%llx)", program, location, (unsigned long long) x );
+		if (x > 0 && false == gRecorder->IsAddressRangeResident(x, 1) )
+			gRecorder->Error( "glProgramUniform1ui64NV: address 0x%llx is not in a resident buffer", (unsigned long long) x );
+	}
+
+	// framebuffers, vertex arrays and samplers
+
+	static void GenNames(const EGLRecordObject type, GLsizei n, GLuint *names, std::set<GLuint> &objects)
+	{
+		for (GLsizei i=0; i<n; ++i)
+		{
+			names[i] = gRecorder->NewName(type);
+			objects.insert(names[i]);
+		}
+	}
+
+	static void GLAPIENTRY RecordGenFramebuffers(GLsizei n, GLuint *framebuffers)
+	{
+		gRecorder->Call( eGLRecordGenFramebuffers, "glGenFramebuffers(%d)", n );
+		GenNames( eGLRecordFramebuffer, n, framebuffers, gRecorder->mFramebuffers );
+	}
+
+	static void GLAPIENTRY RecordDeleteFramebuffers(GLsizei n, const GLuint *framebuffers)
+	{
+		gRecorder->Call( eGLRecordDeleteFramebuffers, "glDeleteFramebuffers(%d)", n );
+		for (GLsizei i=0; i<n; ++i)
+		{
+			if (gRecorder->mDrawFramebuffer == framebuffers[i])
+				gRecorder->mDrawFramebuffer = 0;
+			if (gRecorder->mReadFramebuffer == framebuffers[i])
+				gRecorder->mReadFramebuffer = 0;
+			gRecorder->mFramebuffers.erase(framebuffers[i]);
+		}
+	}
+
+	static void GLAPIENTRY RecordBindFramebuffer(GLenum target, GLuint framebuffer)
+	{
+		gRecorder->Call( eGLRecordBindFramebuffer, "glBindFramebuffer(0x%04x, %u)", target, framebuffer );
+		if (framebuffer > 0 && gRecorder->mFramebuffers.find(framebuffer) == end(gRecorder->mFramebuffers) )
+		{
+			gRecorder->Error( "glBindFramebuffer: %u is not a framebuffer name", framebuffer );
+			return;
+		}
+
+		if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER)
+			gRecorder->mDrawFramebuffer = framebuffer;
+		if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER)
+			gRecorder->mReadFramebuffer = framebuffer;
+	}
+
+	static GLenum GLAPIENTRY RecordCheckFramebufferStatus(GLenum target)
+	{
+		gRecorder->Call( eGLRecordCheckFramebufferStatus, "glCheckFramebufferStatus(0x%04x)", target );
+		return GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	static void GLAPIENTRY RecordGenRenderbuffers(GLsizei n, GLuint *renderbuffers)
+	{
+		gRecorder->Call( eGLRecordGenRenderbuffers, "glGenRenderbuffers(%d)", n );
+		GenNames( eGLRecordRenderbuffer, n, renderbuffers, gRecorder->mRenderbuffers );
+	}
+
+	static void GLAPIENTRY RecordDeleteRenderbuffers(GLsizei n, const GLuint *renderbuffers)
+	{
+		gRecorder->Call( eGLRecordDeleteRenderbuffers, "glDeleteRenderbuffers(%d)", n );
+		for (GLsizei i=0; i<n; ++i)
+			gRecorder->mRenderbuffers.erase(renderbuffers[i]);
+	}
+
+	static void GLAPIENTRY RecordBindRenderbuffer(GLenum target, GLuint renderbuffer)
+	{
+		gRecorder->Call( eGLRecordBindRenderbuffer, "glBindRenderbuffer(0x%04x, %u)", target, renderbuffer );
+		if (renderbuffer > 0 && gRecorder->mRenderbuffers.find(renderbuffer) == end(gRecorder->mRenderbuffers) )
+			gRecorder->Error( "glBindRenderbuffer: %u is not a renderbuffer name", renderbuffer );
+	}
+
+	static void GLAPIENTRY RecordGenVertexArrays(GLsizei n, GLuint *arrays)
+	{
+		gRecorder->Call( eGLRecordGenVertexArrays, "glGenVertexArrays(%d)", n );
+		GenNames( eGLRecordVertexArray, n, arrays, gRecorder->mVertexArrays );
+	}
+
+	static void GLAPIENTRY RecordDeleteVertexArrays(GLsizei n, const GLuint *arrays)
+	{
+		gRecorder->Call( eGLRecordDeleteVertexArrays, "glDeleteVertexArrays(%d)", n );
+		for (GLsizei i=0; i<n; ++i)
+		{
+			if (arrays[i] == 0)
+				continue;
+			if (gRecorder->mVertexArray == arrays[i])
+				gRecorder->mVertexArray = 0;
+			gRecorder->mVertexArrays.erase(arrays[i]);
+			gRecorder->mElementBuffers.erase(arrays[i]);
+		}
+	}
+
+	static void GLAPIENTRY RecordBindVertexArray(GLuint array)
+	{
+		gRecorder->Call( eGLRecordBindVertexArray, "glBindVertexArray(%u)", array );
+		if (array > 0 && gRecorder->mVertexArrays.find(array) == end(gRecorder->mVertexArrays) )
+		{
+			gRecorder->Error( "glBindVertexArray: %u is not a vertex array name", array );
+			return;
+		}
+		gRecorder->mVertexArray = array;
+	}
+
+	// attributes are not tracked, the pointer has to come from a buffer
+	static void GLAPIENTRY RecordVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, 
+		const void *pointer)
+	{
+		gRecorder->Call( eGLRecordVertexAttribPointer, "glVertexAttribPointer(%u, %d, 0x%04x, %d, %d, %p)", index, size, type, 
+			(int) normalized, stride, pointer );
+		if (gRecorder->GetBoundBuffer(GL_ARRAY_BUFFER) == 0)
+			gRecorder->Error( "glVertexAttribPointer: no buffer is bound to GL_ARRAY_BUFFER" );
+	}
+
+	static void GLAPIENTRY RecordEnableVertexAttribArray(GLuint index)
+	{
+		gRecorder->Call( eGLRecordEnableVertexAttribArray, "glEnableVertexAttribArray(%u)", index );
+	}
+
+	static void GLAPIENTRY RecordDisableVertexAttribArray(GLuint index)
+	{
+		gRecorder->Call( eGLRecordDisableVertexAttribArray, "glDisableVertexAttribArray(%u)", index );
+	}
+
+	static void GLAPIENTRY RecordGenSamplers(GLsizei count, GLuint *samplers)
+	{
+		gRecorder->Call( eGLRecordGenSamplers, "glGenSamplers(%d)", count );
+		GenNames( eGLRecordSampler, count, samplers, gRecorder->mSamplers );
+	}
+
+	static void GLAPIENTRY RecordDeleteSamplers(GLsizei count, const GLuint *samplers)
+	{
+		gRecorder->Call( eGLRecordDeleteSamplers, "glDeleteSamplers(%d)", count );
+		for (GLsizei i=0; i<count; ++i)
+			gRecorder->mSamplers.erase(samplers[i]);
+	}
+
+	// bindless textures
+
+	static GLuint64 GLAPIENTRY RecordGetTextureHandleNV(GLuint texture)
+	{
+		gRecorder->Call( eGLRecordGetTextureHandleNV, "glGetTextureHandleNV(%u)", texture );
+		return gRecorder->GetTextureHandle( texture, 0, "glGetTextureHandleNV" );
+	}
+
+	static GLuint64 GLAPIENTRY RecordGetTextureHandleARB(GLuint texture)
+	{
+		gRecorder->Call( eGLRecordGetTextureHandleARB, "glGetTextureHandleARB(%u)", texture );
+		return gRecorder->GetTextureHandle( texture, 0, "glGetTextureHandleARB" );
+	}
+
+	static GLuint64 GLAPIENTRY RecordGetTextureSamplerHandleNV(GLuint texture, GLuint sampler)
+	{
+		gRecorder->Call( eGLRecordGetTextureSamplerHandleNV, "glGetTextureSamplerHandleNV(%u, %u)", texture, sampler );
+		return gRecorder->GetTextureHandle( texture, sampler, "glGetTextureSamplerHandleNV" );
+	}
+
+	static GLuint64 GLAPIENTRY RecordGetTextureSamplerHandleARB(GLuint texture, GLuint sampler)
+	{
+		gRecorder->Call( eGLRecordGetTextureSamplerHandleARB, "glGetTextureSamplerHandleARB(%u, %u)", texture, sampler );
+		return gRecorder->GetTextureHandle( texture, sampler, "glGetTextureSamplerHandleARB" );
+	}
+
+	static void GLAPIENTRY RecordMakeTextureHandleResidentNV(GLuint64 handle)
+	{
+		gRecorder->Call( eGLRecordMakeTextureHandleResidentNV, "glMakeTextureHandleResidentNV(0x%llx)", (unsigned long long) handle );
+		gRecorder->MakeTextureHandleResident( handle, true, "glMakeTextureHandleResidentNV" );
+	}
+
+	static void GLAPIENTRY RecordMakeTextureHandleResidentARB(GLuint64 handle)
+	{
+		gRecorder->Call( eGLRecordMakeTextureHandleResidentARB, "glMakeTextureHandleResidentARB(0x%llx)", (unsigned long long) handle );
+		gRecorder->MakeTextureHandleResident( handle, true, "glMakeTextureHandleResidentARB" );
+	}
+
+	static void GLAPIENTRY RecordMakeTextureHandleNonResidentNV(GLuint64 handle)
+	{
+		gRecorder->Call( eGLRecordMakeTextureHandleNonResidentNV, "glMakeTextureHandleNonResidentNV(0x%llx)", (unsigned long long) handle );
+		gRecorder->MakeTextureHandleResident( handle, false, "glMakeTextureHandleNonResidentNV" );
+	}
+
+	static void GLAPIENTRY RecordMakeTextureHandleNonResidentARB(GLuint64 handle)
+	{
+		gRecorder->Call( eGLRecordMakeTextureHandleNonResidentARB, "glMakeTextureHandleNonResidentARB(0x%llx)", (unsigned long long) handle );
+		gRecorder->MakeTextureHandleResident( handle, false, "glMakeTextureHandleNonResidentARB" );
+	}
+
+	static GLboolean IsTextureHandleResident(GLuint64 handle)
+	{
+		auto iter = gRecorder->mTextureHandles.find(handle);
+		return (iter != end(gRecorder->mTextureHandles) && iter->second.resident) ? GL_TRUE : GL_FALSE;
+	}
+
+	static GLboolean GLAPIENTRY RecordIsTextureHandleResidentNV(GLuint64 handle)
+	{
+		gRecorder->Call( eGLRecordIsTextureHandleResidentNV, "glIsTextureHandleResidentNV(0x%llx)", (unsigned long long) handle );
+		return IsTextureHandleResident(handle);
+	}
+
+	static GLboolean GLAPIENTRY RecordIsTextureHandleResidentARB(GLuint64 handle)
+	{
+		gRecorder->Call( eGLRecordIsTextureHandleResidentARB, "glIsTextureHandleResidentARB(0x%llx)", (unsigned long long) handle );
+		return IsTextureHandleResident(handle);
+	}
+
+	// compressed images, data is an offset when the pixel unpack buffer is bound
+
+	static void GLAPIENTRY RecordCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height,
+		GLint border, GLsizei imageSize, const void *data)
+	{
+		gRecorder->Call( eGLRecordCompressedTexImage2D, "glCompressedTexImage2D(0x%04x, %d, 0x%04x, %d, %d, %d, %d, %p)",
+			target, level, internalformat, width, height, border, imageSize, data );
+		if (data && gRecorder->GetBoundBuffer(GL_PIXEL_UNPACK_BUFFER) == 0)
+			gRecorder->Upload( (size_t) imageSize );
+	}
+
+	static void GLAPIENTRY RecordCompressedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+		GLenum format, GLsizei imageSize, const void *data)
+	{
+		gRecorder->Call( eGLRecordCompressedTexSubImage2D, "glCompressedTexSubImage2D(0x%04x, %d, %d, %d, %d, %d, 0x%04x, %d, %p)",
+			target, level, xoffset, yoffset, width, height, format, imageSize, data );
+		if (data && gRecorder->GetBoundBuffer(GL_PIXEL_UNPACK_BUFFER) == 0)
+			gRecorder->Upload( (size_t) imageSize );
+	}
+
+	// draws
+
+	static void GLAPIENTRY RecordMultiDrawElementsIndirect(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride)
+	{
+		gRecorder->Call( eGLRecordMultiDrawElementsIndirect, "glMultiDrawElementsIndirect(0x%04x, 0x%04x, %p, %d, %d)",
+			mode, type, indirect, drawcount, stride );
+		gRecorder->ValidateIndirectDraw( type, indirect, drawcount, stride, 0, false, "glMultiDrawElementsIndirect" );
+	}
+
+	static void GLAPIENTRY RecordMultiDrawElementsIndirectBindlessNV(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount,
+		GLsizei stride, GLint vertexBufferCount)
+	{
+		gRecorder->Call( eGLRecordMultiDrawElementsIndirectBindlessNV, "glMultiDrawElementsIndirectBindlessNV(0x%04x, 0x%04x, %p, %d, %d, %d)",
+			mode, type, indirect, drawCount, stride, vertexBufferCount );
+		gRecorder->ValidateIndirectDraw( type, indirect, drawCount, stride, vertexBufferCount, true, "glMultiDrawElementsIndirectBindlessNV" );
+	}
+
+	static void GLAPIENTRY RecordDispatchCompute(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z)
+	{
+		gRecorder->Call( eGLRecordDispatchCompute, "glDispatchCompute(%u, %u, %u)", num_groups_x, num_groups_y, num_groups_z );
+	}
+
+	// sync objects are signaled at once, there is no gpu behind them
+
+	static bool IsSync(GLsync sync, const char *function)
+	{
+		if (gRecorder->mSyncs.find( (size_t) sync ) == end(gRecorder->mSyncs) )
+		{
+			gRecorder->Error( "%s: %p is not a sync object", function, sync );
+			return false;
+		}
+		return true;
+	}
+
+	static GLsync GLAPIENTRY RecordFenceSync(GLenum condition, GLbitfield flags)
+	{
+		gRecorder->Call( eGLRecordFenceSync, "glFenceSync(0x%04x, 0x%x)", condition, flags );
+
+		const size_t sync = gRecorder->NewName(eGLRecordSync);
+		gRecorder->mSyncs[sync] = gRecorder->mAutoSignalSyncs;
+		return (GLsync) sync;
+	}
+
+	static GLenum GLAPIENTRY RecordClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+	{
+		gRecorder->Call( eGLRecordClientWaitSync, "glClientWaitSync(%p, 0x%x, %llu)", sync, flags, (unsigned long long) timeout );
+		if (false == IsSync(sync, "glClientWaitSync") )
+			return GL_WAIT_FAILED;
+
+		bool &signaled = gRecorder->mSyncs[(size_t) sync];
+		if (signaled)
+			return GL_ALREADY_SIGNALED;
+		if (timeout == 0)
+			return GL_TIMEOUT_EXPIRED;
+
+		// the client waits for the gpu to catch up, the older syncs are signaled as well
+		gRecorder->mFrameStats.numberOfStalls += 1;
+		gRecorder->mTotalStats.numberOfStalls += 1;
+
+		for (auto iter=begin(gRecorder->mSyncs); iter!=end(gRecorder->mSyncs) && iter->first <= (size_t) sync; ++iter)
+			iter->second = true;
+
+		return GL_CONDITION_SATISFIED;
+	}
+
+	static void GLAPIENTRY RecordWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+	{
+		gRecorder->Call( eGLRecordWaitSync, "glWaitSync(%p, 0x%x, %llu)", sync, flags, (unsigned long long) timeout );
+		IsSync(sync, "glWaitSync");
+	}
+
+	static void GLAPIENTRY RecordDeleteSync(GLsync sync)
+	{
+		gRecorder->Call( eGLRecordDeleteSync, "glDeleteSync(%p)", sync );
+		if (sync != 0 && IsSync(sync, "glDeleteSync") )
+			gRecorder->mSyncs.erase( (size_t) sync );
+	}
+
+	static void GLAPIENTRY RecordMemoryBarrier(GLbitfield barriers)
+	{
+		gRecorder->Call( eGLRecordMemoryBarrier, "glMemoryBarrier(0x%x)", barriers );
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// CGLRecorder
+
+CGLRecorder::CGLRecorder()
+{
+	mLogging = false;
+	mAutoSignalSyncs = true;
+	memset( mSaved, 0, sizeof(mSaved) );
+
+	Reset();
+}
+
+CGLRecorder::~CGLRecorder()
+{
+	Uninstall();
+}
+
+CGLRecorder *CGLRecorder::GetInstalled()
+{
+	return gRecorder;
+}
+
+const bool CGLRecorder::IsInstalled() const
+{
+	return (gRecorder == this);
+}
+
+bool CGLRecorder::Install()
+{
+	if (gRecorder != nullptr)
+		return (gRecorder == this);
+
+#define GL_RECORDER_INSTALL(name) \
+	mSaved[eGLRecord##name] = (void*) GL_RECORDER_SLOT(name); \
+	GL_RECORDER_SLOT(name) = &CGLRecorderDispatch::Record##name;
+
+	GL_RECORDER_FUNCTIONS(GL_RECORDER_INSTALL)
+#undef GL_RECORDER_INSTALL
+
+	gRecorder = this;
+	return true;
+}
+
+void CGLRecorder::Uninstall()
+{
+	if (gRecorder != this)
+		return;
+
+#define GL_RECORDER_UNINSTALL(name) \
+	GL_RECORDER_SLOT(name) = (std::remove_reference<decltype(GL_RECORDER_SLOT(name))>::type) mSaved[eGLRecord##name];
+
+	GL_RECORDER_FUNCTIONS(GL_RECORDER_UNINSTALL)
+#undef GL_RECORDER_UNINSTALL
+
+	gRecorder = nullptr;
+}
+
+void CGLRecorder::Reset()
+{
+	mBuffers.clear();
+	mFramebuffers.clear();
+	mRenderbuffers.clear();
+	mVertexArrays.clear();
+	mSamplers.clear();
+	mSyncs.clear();
+	mTextureHandles.clear();
+	mTextureHandleKeys.clear();
+
+	for (int i=0; i<eGLRecordObjectCount; ++i)
+		mNextName[i] = 1;
+	mNextAddress = GL_RECORDER_ADDRESS_BASE;
+	mNextHandle = GL_RECORDER_HANDLE_BASE;
+
+	mBufferBindings.clear();
+	mVertexArray = 0;
+	mElementBuffers.clear();
+	mDrawFramebuffer = 0;
+	mReadFramebuffer = 0;
+
+	mLog.clear();
+	mErrors.clear();
+
+	GLRecordStats::Clear(mFrameStats);
+	GLRecordStats::Clear(mTotalStats);
+}
+
+void CGLRecorder::BeginFrame()
+{
+	GLRecordStats::Clear(mFrameStats);
+}
+
+void CGLRecorder::SignalSyncs(const int count)
+{
+	int left = count;
+	for (auto iter=begin(mSyncs); iter!=end(mSyncs) && left != 0; ++iter)
+	{
+		if (false == iter->second)
+		{
+			iter->second = true;
+			left -= 1;
+		}
+	}
+}
+
+int CGLRecorder::GetNumberOfPendingSyncs() const
+{
+	int count = 0;
+	for (auto iter=begin(mSyncs); iter!=end(mSyncs); ++iter)
+		if (false == iter->second)
+			count += 1;
+	return count;
+}
+
+const char *CGLRecorder::GetCallName(const EGLRecordCall call)
+{
+	return (call >= 0 && call < eGLRecordCallCount) ? gCallNames[call] : "unknown";
+}
+
+int CGLRecorder::GetNumberOfObjects(const EGLRecordObject type) const
+{
+	switch(type)
+	{
+	case eGLRecordBuffer: return (int) mBuffers.size();
+	case eGLRecordFramebuffer: return (int) mFramebuffers.size();
+	case eGLRecordRenderbuffer: return (int) mRenderbuffers.size();
+	case eGLRecordVertexArray: return (int) mVertexArrays.size();
+	case eGLRecordSampler: return (int) mSamplers.size();
+	case eGLRecordSync: return (int) mSyncs.size();
+	case eGLRecordTextureHandle: return (int) mTextureHandles.size();
+	}
+	return 0;
+}
+
+int CGLRecorder::GetNumberOfResidentBuffers() const
+{
+	int count = 0;
+	for (auto iter=begin(mBuffers); iter!=end(mBuffers); ++iter)
+		if (iter->second.resident)
+			count += 1;
+	return count;
+}
+
+int CGLRecorder::GetNumberOfResidentTextureHandles() const
+{
+	int count = 0;
+	for (auto iter=begin(mTextureHandles); iter!=end(mTextureHandles); ++iter)
+		if (iter->second.resident)
+			count += 1;
+	return count;
+}
+
+const unsigned char *CGLRecorder::GetBufferData(const GLuint buffer, size_t &size) const
+{
+	auto iter = mBuffers.find(buffer);
+	if (iter == end(mBuffers) )
+	{
+		size = 0;
+		return nullptr;
+	}
+
+	size = iter->second.data.size();
+	return iter->second.data.data();
+}
+
+GLuint64 CGLRecorder::GetBufferAddress(const GLuint buffer) const
+{
+	auto iter = mBuffers.find(buffer);
+	return (iter != end(mBuffers) ) ? iter->second.address : 0;
+}
+
+void CGLRecorder::PrintSummary() const
+{
+	printf( "> gl recorder - %d calls, %d draw calls (%d commands), %.2f Mb uploaded, %d stalls, %d errors\n",
+		mTotalStats.numberOfCalls, mTotalStats.numberOfDrawCalls, mTotalStats.numberOfDrawCommands,
+		(double) mTotalStats.uploadedBytes / 1024.0 / 1024.0, mTotalStats.numberOfStalls, mTotalStats.numberOfErrors );
+
+	printf( "> live objects - buffers %d (%d resident), framebuffers %d, renderbuffers %d, vertex arrays %d, samplers %d, syncs %d, texture handles %d (%d resident)\n",
+		(int) mBuffers.size(), GetNumberOfResidentBuffers(), (int) mFramebuffers.size(), (int) mRenderbuffers.size(),
+		(int) mVertexArrays.size(), (int) mSamplers.size(), (int) mSyncs.size(), (int) mTextureHandles.size(), GetNumberOfResidentTextureHandles() );
+
+	for (int i=0; i<eGLRecordCallCount; ++i)
+	{
+		if (mTotalStats.calls[i] > 0)
+			printf( "\t%s - %d\n", gCallNames[i], mTotalStats.calls[i] );
+	}
+
+	for (auto iter=begin(mErrors); iter!=end(mErrors); ++iter)
+		printf( "> ERROR: %s\n", iter->c_str() );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// recording
+
+void CGLRecorder::Call(const EGLRecordCall call, const char *format, ...)
+{
+	mFrameStats.numberOfCalls += 1;
+	mFrameStats.calls[call] += 1;
+	mTotalStats.numberOfCalls += 1;
+	mTotalStats.calls[call] += 1;
+
+	if (mLogging)
+	{
+		char line[GL_RECORDER_LOG_LINE];
+
+		va_list args;
+		va_start(args, format);
+		vsnprintf( line, GL_RECORDER_LOG_LINE, format, args );
+		va_end(args);
+
+		line[GL_RECORDER_LOG_LINE-1] = 0;
+		mLog.push_back(line);
+	}
+}
+
+void CGLRecorder::Error(const char *format, ...)
+{
+	mFrameStats.numberOfErrors += 1;
+	mTotalStats.numberOfErrors += 1;
+
+	if (mErrors.size() >= GL_RECORDER_MAX_ERRORS && false == mLogging)
+		return;
+
+	char line[GL_RECORDER_LOG_LINE];
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf( line, GL_RECORDER_LOG_LINE, format, args );
+	va_end(args);
+
+	line[GL_RECORDER_LOG_LINE-1] = 0;
+
+	if (mErrors.size() < GL_RECORDER_MAX_ERRORS)
+		mErrors.push_back(line);
+	if (mLogging)
+		mLog.push_back( std::string("! ") + line );
+}
+
+void CGLRecorder::Upload(const size_t bytes)
+{
+	mFrameStats.uploadedBytes += bytes;
+	mTotalStats.uploadedBytes += bytes;
+}
+
+GLuint CGLRecorder::NewName(const EGLRecordObject type)
+{
+	const size_t name = mNextName[type];
+	mNextName[type] += 1;
+	return (GLuint) name;
+}
+
+CGLRecorder::BufferRecord *CGLRecorder::FindBuffer(const GLuint buffer, const char *function)
+{
+	auto iter = mBuffers.find(buffer);
+	if (iter == end(mBuffers) )
+	{
+		Error( "%s: %u is not a buffer name", function, buffer );
+		return nullptr;
+	}
+	return &iter->second;
+}
+
+GLuint CGLRecorder::GetBoundBuffer(const GLenum target) const
+{
+	auto iter = mBufferBindings.find(target);
+	if (target == GL_ELEMENT_ARRAY_BUFFER)
+	{
+		auto elementIter = mElementBuffers.find(mVertexArray);
+		return (elementIter != end(mElementBuffers) ) ? elementIter->second : 0;
+	}
+	return (iter != end(mBufferBindings) ) ? iter->second : 0;
+}
+
+CGLRecorder::BufferRecord *CGLRecorder::FindBoundBuffer(const GLenum target, const char *function)
+{
+	const GLuint buffer = GetBoundBuffer(target);
+	if (buffer == 0)
+	{
+		Error( "%s: no buffer is bound to the target 0x%04x", function, target );
+		return nullptr;
+	}
+	return FindBuffer(buffer, function);
+}
+
+void CGLRecorder::UnbindBuffer(const GLuint buffer)
+{
+	for (auto iter=begin(mBufferBindings); iter!=end(mBufferBindings); ++iter)
+		if (iter->second == buffer)
+			iter->second = 0;
+
+	for (auto iter=begin(mElementBuffers); iter!=end(mElementBuffers); ++iter)
+		if (iter->second == buffer)
+			iter->second = 0;
+}
+
+void CGLRecorder::SetStorage(BufferRecord &record, const GLsizeiptr size, const void *data, const GLenum usage, const char *function)
+{
+	if (record.immutable)
+	{
+		Error( "%s: buffer has an immutable storage", function );
+		return;
+	}
+	if (size < 0)
+	{
+		Error( "%s: negative size %lld", function, (long long) size );
+		return;
+	}
+
+	// a new storage gets a new address and it's not resident
+	record.data.assign( (size_t) size, 0 );
+	if (data && size > 0)
+		memcpy( record.data.data(), data, (size_t) size );
+
+	record.hasStorage = true;
+	record.usage = usage;
+	record.address = 0;
+	record.resident = false;
+	record.mapped = false;
+
+	if (data)
+		Upload( (size_t) size );
+}
+
+void CGLRecorder::SetImmutableStorage(BufferRecord &record, const GLsizeiptr size, const void *data, const GLbitfield flags, const char *function)
+{
+	if (record.immutable)
+	{
+		Error( "%s: buffer has an immutable storage already", function );
+		return;
+	}
+	if (size <= 0)
+	{
+		Error( "%s: size %lld is not positive", function, (long long) size );
+		return;
+	}
+	if ( (flags & GL_MAP_PERSISTENT_BIT) && 0 == (flags & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT)) )
+		Error( "%s: persistent storage without read or write access", function );
+	if ( (flags & GL_MAP_COHERENT_BIT) && 0 == (flags & GL_MAP_PERSISTENT_BIT) )
+		Error( "%s: coherent storage has to be persistent", function );
+
+	SetStorage( record, size, data, 0, function );
+	record.immutable = true;
+	record.storageFlags = flags;
+}
+
+void CGLRecorder::SubData(BufferRecord &record, const GLintptr offset, const GLsizeiptr size, const void *data, const char *function)
+{
+	if (false == record.hasStorage)
+	{
+		Error( "%s: buffer has no storage", function );
+		return;
+	}
+	if (offset < 0 || size < 0 || (size_t) (offset + size) > record.data.size() )
+	{
+		Error( "%s: range [%lld, %lld) is out of the buffer size %u", function,
+			(long long) offset, (long long) (offset + size), (unsigned int) record.data.size() );
+		return;
+	}
+	if (record.immutable && 0 == (record.storageFlags & GL_DYNAMIC_STORAGE_BIT) )
+	{
+		Error( "%s: immutable storage without GL_DYNAMIC_STORAGE_BIT", function );
+		return;
+	}
+	if (record.mapped && 0 == (record.mapAccess & GL_MAP_PERSISTENT_BIT) )
+	{
+		Error( "%s: buffer is mapped", function );
+		return;
+	}
+
+	if (data && size > 0)
+		memcpy( record.data.data() + offset, data, (size_t) size );
+	Upload( (size_t) size );
+}
+
+void CGLRecorder::CopySubData(BufferRecord &readRecord, BufferRecord &writeRecord, const GLintptr readOffset, const GLintptr writeOffset, const GLsizeiptr size, const char *function)
+{
+	if (false == readRecord.hasStorage || false == writeRecord.hasStorage)
+	{
+		Error( "%s: buffer has no storage", function );
+		return;
+	}
+	if (readOffset < 0 || writeOffset < 0 || size < 0
+		|| (size_t) (readOffset + size) > readRecord.data.size() || (size_t) (writeOffset + size) > writeRecord.data.size() )
+	{
+		Error( "%s: range of %lld bytes from %lld to %lld is out of the buffers", function,
+			(long long) size, (long long) readOffset, (long long) writeOffset );
+		return;
+	}
+	if (&readRecord == &writeRecord && readOffset < writeOffset + size && writeOffset < readOffset + size)
+	{
+		Error( "%s: source and destination ranges overlap", function );
+		return;
+	}
+	if ( (readRecord.mapped && 0 == (readRecord.mapAccess & GL_MAP_PERSISTENT_BIT) )
+		|| (writeRecord.mapped && 0 == (writeRecord.mapAccess & GL_MAP_PERSISTENT_BIT) ) )
+	{
+		Error( "%s: buffer is mapped", function );
+		return;
+	}
+
+	// server side copy, it's not an upload
+	if (size > 0)
+		memcpy( writeRecord.data.data() + writeOffset, readRecord.data.data() + readOffset, (size_t) size );
+}
+
+void *CGLRecorder::Map(BufferRecord &record, const GLintptr offset, const GLsizeiptr length, const GLbitfield access, const char *function)
+{
+	if (false == record.hasStorage)
+	{
+		Error( "%s: buffer has no storage", function );
+		return nullptr;
+	}
+	if (record.mapped)
+	{
+		Error( "%s: buffer is mapped already", function );
+		return nullptr;
+	}
+	if (offset < 0 || length <= 0 || (size_t) (offset + length) > record.data.size() )
+	{
+		Error( "%s: range [%lld, %lld) is out of the buffer size %u", function,
+			(long long) offset, (long long) (offset + length), (unsigned int) record.data.size() );
+		return nullptr;
+	}
+	if (0 == (access & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT)) )
+	{
+		Error( "%s: neither read nor write access", function );
+		return nullptr;
+	}
+	if (record.immutable)
+	{
+		const GLbitfield required = access & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+		if ( (record.storageFlags & required) != required )
+		{
+			Error( "%s: access 0x%x is not allowed by the storage flags 0x%x", function, access, record.storageFlags );
+			return nullptr;
+		}
+	}
+	if ( (access & GL_MAP_FLUSH_EXPLICIT_BIT) && 0 == (access & GL_MAP_WRITE_BIT) )
+	{
+		Error( "%s: explicit flush without write access", function );
+		return nullptr;
+	}
+
+	record.mapped = true;
+	record.mapOffset = offset;
+	record.mapLength = length;
+	record.mapAccess = access;
+
+	return record.data.data() + offset;
+}
+
+GLboolean CGLRecorder::Unmap(BufferRecord &record, const char *function)
+{
+	if (false == record.mapped)
+	{
+		Error( "%s: buffer is not mapped", function );
+		return GL_FALSE;
+	}
+
+	// written range goes to the gpu, explicit flushes are counted already
+	if ( (record.mapAccess & GL_MAP_WRITE_BIT) && 0 == (record.mapAccess & GL_MAP_FLUSH_EXPLICIT_BIT) )
+		Upload( (size_t) record.mapLength );
+
+	record.mapped = false;
+	record.mapOffset = 0;
+	record.mapLength = 0;
+	record.mapAccess = 0;
+
+	return GL_TRUE;
+}
+
+GLuint64 CGLRecorder::GetAddress(BufferRecord &record)
+{
+	if (record.address == 0)
+	{
+		record.address = mNextAddress;
+
+		const GLuint64 size = (GLuint64) record.data.size() + GL_RECORDER_ADDRESS_ALIGN;
+		mNextAddress += (size + GL_RECORDER_ADDRESS_ALIGN - 1) & ~( (GLuint64) GL_RECORDER_ADDRESS_ALIGN - 1);
+	}
+	return record.address;
+}
+
+void CGLRecorder::MakeResident(BufferRecord &record, const char *function)
+{
+	if (false == record.hasStorage)
+	{
+		Error( "%s: buffer has no storage", function );
+		return;
+	}
+	if (record.resident)
+	{
+		Error( "%s: buffer is resident already", function );
+		return;
+	}
+	GetAddress(record);
+	record.resident = true;
+}
+
+void CGLRecorder::MakeNonResident(BufferRecord &record, const char *function)
+{
+	if (false == record.resident)
+	{
+		Error( "%s: buffer is not resident", function );
+		return;
+	}
+	record.resident = false;
+}
+
+bool CGLRecorder::IsAddressRangeResident(const GLuint64 address, const GLuint64 length) const
+{
+	for (auto iter=begin(mBuffers); iter!=end(mBuffers); ++iter)
+	{
+		const BufferRecord &record = iter->second;
+
+		if (record.resident && address >= record.address
+			&& address + length <= record.address + (GLuint64) record.data.size() )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+GLuint64 CGLRecorder::GetTextureHandle(const GLuint texture, const GLuint sampler, const char *function)
+{
+	if (texture == 0)
+	{
+		Error( "%s: texture name is zero", function );
+		return 0;
+	}
+	if (sampler > 0 && mSamplers.find(sampler) == end(mSamplers) )
+	{
+		Error( "%s: %u is not a sampler name", function, sampler );
+		return 0;
+	}
+
+	// the same pair returns the same handle
+	const std::pair<GLuint, GLuint> key(texture, sampler);
+	auto iter = mTextureHandleKeys.find(key);
+	if (iter != end(mTextureHandleKeys) )
+		return iter->second;
+
+	const GLuint64 handle = mNextHandle;
+	mNextHandle += 1;
+
+	TextureHandleRecord record;
+	record.texture = texture;
+	record.sampler = sampler;
+	record.resident = false;
+
+	mTextureHandles[handle] = record;
+	mTextureHandleKeys[key] = handle;
+	return handle;
+}
+
+void CGLRecorder::MakeTextureHandleResident(const GLuint64 handle, const bool resident, const char *function)
+{
+	auto iter = mTextureHandles.find(handle);
+	if (iter == end(mTextureHandles) )
+	{
+		Error( "%s: 0x%llx is not a texture handle", function, (unsigned long long) handle );
+		return;
+	}
+	if (iter->second.resident == resident)
+	{
+		Error( "%s: handle 0x%llx is %s already", function, (unsigned long long) handle, (resident) ? "resident" : "not resident" );
+		return;
+	}
+	iter->second.resident = resident;
+}
+
+void CGLRecorder::ValidateIndirectDraw(const GLenum type, const void *indirect, const GLsizei drawCount, const GLsizei stride,
+		const GLint vertexBufferCount, const bool bindless, const char *function)
+{
+	mFrameStats.numberOfDrawCalls += 1;
+	mTotalStats.numberOfDrawCalls += 1;
+	mFrameStats.numberOfDrawCommands += drawCount;
+	mTotalStats.numberOfDrawCommands += drawCount;
+
+	if (drawCount <= 0)
+		return;
+
+	// commands come from the indirect buffer
+	BufferRecord *commands = FindBoundBuffer(GL_DRAW_INDIRECT_BUFFER, function);
+	if (nullptr == commands)
+		return;
+
+	const size_t commandSize = (bindless) ? sizeof(RecordDrawCommand) + sizeof(GLuint) + sizeof(RecordBindlessPtr) * (1 + vertexBufferCount)
+		: sizeof(RecordDrawCommand);
+	const size_t commandStride = (stride > 0) ? (size_t) stride : commandSize;
+	const size_t offset = (size_t) indirect;
+
+	if (offset + commandStride * (drawCount - 1) + commandSize > commands->data.size() )
+	{
+		Error( "%s: %d commands from the offset %u are out of the indirect buffer size %u", function, drawCount,
+			(unsigned int) offset, (unsigned int) commands->data.size() );
+		return;
+	}
+
+	const size_t indexSize = GetIndexSize(type);
+	size_t elementSize = 0;
+
+	if (false == bindless)
+	{
+		BufferRecord *elements = FindBoundBuffer(GL_ELEMENT_ARRAY_BUFFER, function);
+		if (nullptr == elements)
+			return;
+		elementSize = elements->data.size();
+	}
+
+	// the first broken command is reported only
+	for (GLsizei i=0; i<drawCount; ++i)
+	{
+		const unsigned char *command = commands->data.data() + offset + commandStride * i;
+
+		RecordDrawCommand cmd;
+		memcpy( &cmd, command, sizeof(RecordDrawCommand) );
+
+		const GLuint64 lastIndexByte = ( (GLuint64) cmd.firstIndex + cmd.count ) * indexSize;
+
+		if (false == bindless)
+		{
+			if (lastIndexByte > (GLuint64) elementSize)
+			{
+				Error( "%s: command %d indices [%u, %u) are out of the element buffer size %u", function, i,
+					cmd.firstIndex, cmd.firstIndex + cmd.count, (unsigned int) elementSize );
+				return;
+			}
+			continue;
+		}
+
+		RecordBindlessPtr ptr;
+		const unsigned char *pointers = command + sizeof(RecordDrawCommand) + sizeof(GLuint);
+		memcpy( &ptr, pointers, sizeof(RecordBindlessPtr) );
+
+		if (cmd.count > 0 && (lastIndexByte > ptr.length || false == IsAddressRangeResident(ptr.address, ptr.length)) )
+		{
+			Error( "%s: command %d index range 0x%llx + %llu is not resident or too short", function, i,
+				(unsigned long long) ptr.address, (unsigned long long) ptr.length );
+			return;
+		}
+
+		for (GLint j=0; j<vertexBufferCount; ++j)
+		{
+			memcpy( &ptr, pointers + sizeof(RecordBindlessPtr) * (1 + j), sizeof(RecordBindlessPtr) );
+
+			if (ptr.length > 0 && false == IsAddressRangeResident(ptr.address, ptr.length) )
+			{
+				Error( "%s: command %d vertex buffer %d range 0x%llx + %llu is not resident", function, i, j,
+					(unsigned long long) ptr.address, (unsigned long long) ptr.length );
+				return;
+			}
+		}
+	}
+}
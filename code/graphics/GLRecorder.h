@@ -0,0 +1,305 @@
+#pragma once
+
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+//--
+#include <GL/glew.h>
+
+#include <string.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////////////////
+// recording back-end of the gl dispatch
+//
+// glew entry points are replaced by the recording functions, so buffers, framebuffers, bindless addresses
+//	and indirect draws work without a context and a gpu (build machines, tests, benchmarks).
+//	Calls are counted and validated, object lifetimes and uploaded bytes are tracked, buffer storages are kept
+//	in the client memory, gpu addresses and texture handles are faked.
+//	GL 1.1 functions (glGenTextures, glTexImage2D, glDrawElements, state) are exported by opengl32 directly,
+//	they are not in the glew dispatch and they are not recorded
+
+#define GL_RECORDER_MAX_ERRORS			1024
+
+enum EGLRecordCall
+{
+	// buffers
+	eGLRecordGenBuffers,
+	eGLRecordDeleteBuffers,
+	eGLRecordBindBuffer,
+	eGLRecordBindBufferBase,
+	eGLRecordBindBufferRange,
+	eGLRecordBufferData,
+	eGLRecordBufferSubData,
+	eGLRecordCopyBufferSubData,
+	eGLRecordBufferStorage,
+	eGLRecordNamedBufferData,
+	eGLRecordNamedBufferSubData,
+	eGLRecordNamedBufferDataEXT,
+	eGLRecordNamedBufferSubDataEXT,
+	eGLRecordMapBuffer,
+	eGLRecordMapBufferRange,
+	eGLRecordMapNamedBuffer,
+	eGLRecordUnmapBuffer,
+	eGLRecordUnmapNamedBuffer,
+	eGLRecordFlushMappedBufferRange,
+	eGLRecordGetBufferParameteriv,
+
+	// bindless buffers
+	eGLRecordGetBufferParameterui64vNV,
+	eGLRecordMakeBufferResidentNV,
+	eGLRecordMakeBufferNonResidentNV,
+	eGLRecordIsBufferResidentNV,
+	eGLRecordMakeNamedBufferResidentNV,
+	eGLRecordMakeNamedBufferNonResidentNV,
+	eGLRecordBufferAddressRangeNV,
+	eGLRecordProgramUniform1ui64NV,
+
+	// framebuffers, vertex arrays and samplers
+	eGLRecordGenFramebuffers,
+	eGLRecordDeleteFramebuffers,
+	eGLRecordBindFramebuffer,
+	eGLRecordCheckFramebufferStatus,
+	eGLRecordGenRenderbuffers,
+	eGLRecordDeleteRenderbuffers,
+	eGLRecordBindRenderbuffer,
+	eGLRecordGenVertexArrays,
+	eGLRecordDeleteVertexArrays,
+	eGLRecordBindVertexArray,
+	eGLRecordVertexAttribPointer,
+	eGLRecordEnableVertexAttribArray,
+	eGLRecordDisableVertexAttribArray,
+	eGLRecordGenSamplers,
+	eGLRecordDeleteSamplers,
+
+	// bindless textures
+	eGLRecordGetTextureHandleNV,
+	eGLRecordGetTextureHandleARB,
+	eGLRecordGetTextureSamplerHandleNV,
+	eGLRecordGetTextureSamplerHandleARB,
+	eGLRecordMakeTextureHandleResidentNV,
+	eGLRecordMakeTextureHandleResidentARB,
+	eGLRecordMakeTextureHandleNonResidentNV,
+	eGLRecordMakeTextureHandleNonResidentARB,
+	eGLRecordIsTextureHandleResidentNV,
+	eGLRecordIsTextureHandleResidentARB,
+
+	// compressed images
+	eGLRecordCompressedTexImage2D,
+	eGLRecordCompressedTexSubImage2D,
+
+	// draws and sync
+	eGLRecordMultiDrawElementsIndirect,
+	eGLRecordMultiDrawElementsIndirectBindlessNV,
+	eGLRecordDispatchCompute,
+	eGLRecordFenceSync,
+	eGLRecordClientWaitSync,
+	eGLRecordWaitSync,
+	eGLRecordDeleteSync,
+	eGLRecordMemoryBarrier,
+
+	eGLRecordCallCount
+};
+
+enum EGLRecordObject
+{
+	eGLRecordBuffer,
+	eGLRecordFramebuffer,
+	eGLRecordRenderbuffer,
+	eGLRecordVertexArray,
+	eGLRecordSampler,
+	eGLRecordSync,
+	eGLRecordTextureHandle,
+
+	eGLRecordObjectCount
+};
+
+struct GLRecordStats
+{
+	int			numberOfCalls;
+	int			numberOfDrawCalls;		// one multi draw is one call
+	int			numberOfDrawCommands;	// commands of the indirect draws
+	size_t		uploadedBytes;			// buffer data, sub data, flushed or unmapped ranges, compressed images
+	int			numberOfStalls;			// client waits on the syncs which are not signaled yet
+	int			numberOfErrors;
+
+	int			calls[eGLRecordCallCount];
+
+	static void Clear(GLRecordStats &stats)
+	{
+		memset( &stats, 0, sizeof(GLRecordStats) );
+	}
+};
+
+class CGLRecorder
+{
+public:
+
+	//! a constructor
+	CGLRecorder();
+	//! a destructor
+	~CGLRecorder();
+
+	// replace glew entry points with the recording ones, only one recorder could be installed at a time
+	bool	Install();
+	// restore the previous entry points
+	void	Uninstall();
+
+	const bool IsInstalled() const;
+	static CGLRecorder *GetInstalled();
+
+	// forget all objects, stats and messages
+	void	Reset();
+
+	// keep a text line of each call
+	void	SetLogging(const bool logging)
+	{
+		mLogging = logging;
+	}
+	const std::vector<std::string> &GetLog() const
+	{
+		return mLog;
+	}
+	void	ClearLog()
+	{
+		mLog.clear();
+	}
+	// validation messages, the first GL_RECORDER_MAX_ERRORS are kept
+	const std::vector<std::string> &GetErrors() const
+	{
+		return mErrors;
+	}
+
+	// syncs are signaled at creation by default, otherwise they stay pending until SignalSyncs
+	//	or a client wait with a timeout (counted as a stall), a zero timeout wait gets GL_TIMEOUT_EXPIRED
+	void	SetAutoSignalSyncs(const bool value)
+	{
+		mAutoSignalSyncs = value;
+	}
+	// gpu progress, signal the oldest pending syncs, -1 for all of them
+	void	SignalSyncs(const int count=-1);
+	int		GetNumberOfPendingSyncs() const;
+
+	// start counting the stats of a new frame
+	void	BeginFrame();
+
+	const GLRecordStats &GetFrameStats() const
+	{
+		return mFrameStats;
+	}
+	const GLRecordStats &GetTotalStats() const
+	{
+		return mTotalStats;
+	}
+
+	// live objects of the type
+	int		GetNumberOfObjects(const EGLRecordObject type) const;
+	int		GetNumberOfResidentBuffers() const;
+	int		GetNumberOfResidentTextureHandles() const;
+
+	// client copy of the buffer storage, nullptr for an unknown name
+	const unsigned char *GetBufferData(const GLuint buffer, size_t &size) const;
+	// fake gpu address, 0 if it was not queried yet
+	GLuint64 GetBufferAddress(const GLuint buffer) const;
+
+	static const char *GetCallName(const EGLRecordCall call);
+
+	// stats and live objects into the console
+	void	PrintSummary() const;
+
+protected:
+
+	struct BufferRecord
+	{
+		std::vector<unsigned char>	data;
+		bool			hasStorage;
+		bool			immutable;
+		GLenum			usage;
+		GLbitfield		storageFlags;
+
+		GLuint64		address;
+		bool			resident;
+
+		bool			mapped;
+		GLintptr		mapOffset;
+		GLsizeiptr		mapLength;
+		GLbitfield		mapAccess;
+	};
+
+	struct TextureHandleRecord
+	{
+		GLuint			texture;
+		GLuint			sampler;
+		bool			resident;
+	};
+
+	std::map<GLuint, BufferRecord>			mBuffers;
+	std::set<GLuint>						mFramebuffers;
+	std::set<GLuint>						mRenderbuffers;
+	std::set<GLuint>						mVertexArrays;
+	std::set<GLuint>						mSamplers;
+	std::map<size_t, bool>					mSyncs;			// signaled flag, names go in the creation order
+	std::map<GLuint64, TextureHandleRecord>	mTextureHandles;
+	std::map<std::pair<GLuint, GLuint>, GLuint64>	mTextureHandleKeys;		// texture and sampler
+
+	size_t						mNextName[eGLRecordObjectCount];
+	GLuint64					mNextAddress;
+	GLuint64					mNextHandle;
+
+	// bindings
+	std::map<GLenum, GLuint>	mBufferBindings;
+	GLuint						mVertexArray;
+	std::map<GLuint, GLuint>	mElementBuffers;	// element array binding of each vertex array
+	GLuint						mDrawFramebuffer;
+	GLuint						mReadFramebuffer;
+
+	bool						mAutoSignalSyncs;
+	bool						mLogging;
+	std::vector<std::string>	mLog;
+	std::vector<std::string>	mErrors;
+
+	GLRecordStats				mFrameStats;
+	GLRecordStats				mTotalStats;
+
+	// entry points before the install, in the order of EGLRecordCall
+	void						*mSaved[eGLRecordCallCount];
+
+	void	Call(const EGLRecordCall call, const char *format, ...);
+	void	Error(const char *format, ...);
+	void	Upload(const size_t bytes);
+
+	GLuint	NewName(const EGLRecordObject type);
+
+	BufferRecord *FindBuffer(const GLuint buffer, const char *function);
+	BufferRecord *FindBoundBuffer(const GLenum target, const char *function);
+	GLuint	GetBoundBuffer(const GLenum target) const;
+	void	UnbindBuffer(const GLuint buffer);
+
+	void	SetStorage(BufferRecord &record, const GLsizeiptr size, const void *data, const GLenum usage, const char *function);
+	void	SetImmutableStorage(BufferRecord &record, const GLsizeiptr size, const void *data, const GLbitfield flags, const char *function);
+	void	SubData(BufferRecord &record, const GLintptr offset, const GLsizeiptr size, const void *data, const char *function);
+	void	CopySubData(BufferRecord &readRecord, BufferRecord &writeRecord, const GLintptr readOffset, const GLintptr writeOffset, const GLsizeiptr size, const char *function);
+	void	*Map(BufferRecord &record, const GLintptr offset, const GLsizeiptr length, const GLbitfield access, const char *function);
+	GLboolean Unmap(BufferRecord &record, const char *function);
+	void	MakeResident(BufferRecord &record, const char *function);
+	void	MakeNonResident(BufferRecord &record, const char *function);
+	GLuint64 GetAddress(BufferRecord &record);
+
+	// the range is inside of one resident buffer
+	bool	IsAddressRangeResident(const GLuint64 address, const GLuint64 length) const;
+
+	GLuint64 GetTextureHandle(const GLuint texture, const GLuint sampler, const char *function);
+	void	MakeTextureHandleResident(const GLuint64 handle, const bool resident, const char *function);
+
+	void	ValidateIndirectDraw(const GLenum type, const void *indirect, const GLsizei drawCount, const GLsizei stride,
+		const GLint vertexBufferCount, const bool bindless, const char *function);
+
+	friend class CGLRecorderDispatch;
+};
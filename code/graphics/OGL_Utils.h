@@ -9,7 +9,7 @@
 */
 
 //-- 
-#include <GL\glew.h>
+#include <GL/glew.h>
 
 // Calculates log2 of number.  
 double log2( double n );
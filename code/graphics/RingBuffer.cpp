@@ -0,0 +1,245 @@
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "RingBuffer.h"
+#include "CheckGLError.h"
+
+static CGPURingBuffer	gRingBuffer;
+
+////////////////////////////////////////////////////////////////////////////////////
+//
+
+CGPURingBuffer &CGPURingBuffer::GetInstance()
+{
+	return gRingBuffer;
+}
+
+CGPURingBuffer::CGPURingBuffer()
+{
+	mBuffer = 0;
+	mBufferPtr = 0;
+	mMapped = nullptr;
+	mAlignment = RING_BUFFER_MIN_ALIGNMENT;
+	mMaxFrames = RING_BUFFER_MAX_FRAMES;
+	mFrameId = 0;
+
+	mNumberOfFrames = 0;
+	mNumberOfOverflows = 0;
+	mNumberOfWaits = 0;
+}
+
+CGPURingBuffer::~CGPURingBuffer()
+{
+	// gl context is already destroyed on the process exit, the host calls Free before that
+	mAllocator.Init(0);
+}
+
+bool CGPURingBuffer::Init(const size_t size, const int maxFrames)
+{
+	Free();
+
+	if (size == 0 || glBufferStorage == nullptr)
+	{
+		printf( "> ERROR: persistent mapped ring buffer is not supported\n" );
+		return false;
+	}
+
+	// one alignment fits the ssbo, ubo and bindless ranges
+	GLint ssboAlignment = 0;
+	GLint uboAlignment = 0;
+	glGetIntegerv( GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssboAlignment );
+	glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlignment );
+
+	mAlignment = RING_BUFFER_MIN_ALIGNMENT;
+	mAlignment = std::max( mAlignment, (size_t) std::max(ssboAlignment, 0) );
+	mAlignment = std::max( mAlignment, (size_t) std::max(uboAlignment, 0) );
+
+	mMaxFrames = std::max(1, maxFrames);
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, (GLsizeiptr) size, nullptr, flags);
+	mMapped = (unsigned char*) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr) size, flags);
+
+	if (mMapped != nullptr && glGetBufferParameterui64vNV != nullptr && glMakeBufferResidentNV != nullptr)
+	{
+		glGetBufferParameterui64vNV(GL_COPY_WRITE_BUFFER, GL_BUFFER_GPU_ADDRESS_NV, &mBufferPtr);
+		glMakeBufferResidentNV(GL_COPY_WRITE_BUFFER, GL_READ_ONLY);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	CHECK_GL_ERROR();
+
+	if (mMapped == nullptr)
+	{
+		printf( "> ERROR: failed to map the ring buffer\n" );
+		Free();
+		return false;
+	}
+
+	mAllocator.Init(size);
+
+	mFrameId += 1;
+	mNumberOfFrames = 0;
+	mNumberOfOverflows = 0;
+	mNumberOfWaits = 0;
+
+	return true;
+}
+
+void CGPURingBuffer::Free()
+{
+	if (mBuffer > 0)
+	{
+		// gpu could still read the frames in flight
+		RetireFrames(true);
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+		if (mBufferPtr > 0)
+			glMakeBufferNonResidentNV(GL_COPY_WRITE_BUFFER);
+		if (mMapped != nullptr)
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		glDeleteBuffers(1, &mBuffer);
+		mBuffer = 0;
+	}
+
+	mBufferPtr = 0;
+	mMapped = nullptr;
+	mAllocator.Init(0);
+}
+
+bool CGPURingBuffer::Allocate(const size_t size, RingBufferRange &range)
+{
+	return Allocate(size, mAlignment, range);
+}
+
+bool CGPURingBuffer::Allocate(const size_t size, const size_t alignment, RingBufferRange &range)
+{
+	if (false == IsReady() || size == 0)
+		return false;
+
+	size_t offset = 0;
+
+	if (false == mAllocator.Allocate(size, alignment, offset) )
+	{
+		// try again with the space of the finished frames
+		RetireFrames(false);
+
+		if (false == mAllocator.Allocate(size, alignment, offset) )
+		{
+			mNumberOfOverflows += 1;
+			return false;
+		}
+	}
+
+	range.buffer = mBuffer;
+	range.offset = offset;
+	range.size = size;
+	range.ptr = mMapped + offset;
+	range.address = (mBufferPtr > 0) ? mBufferPtr + offset : 0;
+	range.frame = mFrameId;
+
+	return true;
+}
+
+bool CGPURingBuffer::Upload(const size_t size, const void *data, RingBufferRange &range)
+{
+	if (false == Allocate(size, range) )
+		return false;
+
+	if (data != nullptr)
+		memcpy( range.ptr, data, size );
+	return true;
+}
+
+bool CGPURingBuffer::Upload(const size_t size1, const void *data1, const size_t size2, const void *data2, RingBufferRange &range)
+{
+	if (false == Allocate(size1 + size2, range) )
+		return false;
+
+	unsigned char *dst = (unsigned char*) range.ptr;
+
+	if (data1 != nullptr && size1 > 0)
+		memcpy( dst, data1, size1 );
+	if (data2 != nullptr && size2 > 0)
+		memcpy( dst + size1, data2, size2 );
+	return true;
+}
+
+void CGPURingBuffer::EndFrame()
+{
+	if (false == IsReady() )
+		return;
+
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mAllocator.EndFrame(fence);
+	mNumberOfFrames += 1;
+	mFrameId += 1;
+
+	RetireFrames(false);
+
+	// cpu is too far ahead of the gpu
+	while (mAllocator.GetNumberOfFrames() > mMaxFrames)
+	{
+		GLsync oldest = (GLsync) mAllocator.GetOldestFence();
+		WaitFence(oldest, true);
+
+		glDeleteSync(oldest);
+		mAllocator.RetireOldestFrame();
+	}
+}
+
+void CGPURingBuffer::RetireFrames(const bool wait)
+{
+	while (mAllocator.GetNumberOfFrames() > 0)
+	{
+		GLsync oldest = (GLsync) mAllocator.GetOldestFence();
+		if (false == WaitFence(oldest, wait) )
+			break;
+
+		glDeleteSync(oldest);
+		mAllocator.RetireOldestFrame();
+	}
+}
+
+bool CGPURingBuffer::WaitFence(GLsync fence, const bool wait)
+{
+	if (fence == 0)
+		return true;
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+
+	if (result == GL_TIMEOUT_EXPIRED && wait)
+	{
+		mNumberOfWaits += 1;
+
+		// the first wait flushes the commands, so the fence is sure to be signaled
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		do
+		{
+			result = glClientWaitSync(fence, flags, RING_BUFFER_WAIT_TIMEOUT);
+			flags = 0;
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+
+	if (result == GL_WAIT_FAILED)
+	{
+		// there is nothing to wait for, the space is given back
+		printf( "> ERROR: ring buffer fence wait failed\n" );
+		return true;
+	}
+
+	return (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED);
+}
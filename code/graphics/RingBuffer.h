@@ -0,0 +1,137 @@
+#pragma once
+
+/*
+	Sergey Solokhin (Neill3d)
+
+	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+*/
+
+//--
+#include <GL/glew.h>
+#include "algorithm/RingAllocator.h"
+
+//////////////////////////////////////////////////////////////////////////////////////
+// one persistently mapped buffer for the per frame gpu data
+//
+// per frame buffers (lights, clusters, light matrices) take a range of the ring and write into it,
+//	instead of orphaning their own buffers with glBufferData. A fence is put after the frame commands
+//	and the ring space of the frame is reused only when the fence is signaled.
+//	Data of a range is valid only in the frame it's written, the space is reused once the frame is retired,
+//	so only buffers which are uploaded every frame should use the ring. Nothing is bound for a range of an earlier frame
+//	When the ring is full or not initialized, the buffer falls back to its own gl buffer (overflow)
+//	NOTE: all calls have to be done in a gl thread, host calls EndFrame after the frame commands
+
+#define RING_BUFFER_DEFAULT_SIZE		(8 * 1024 * 1024)
+#define RING_BUFFER_MAX_FRAMES			3			// frames in flight, the next EndFrame waits for the oldest one
+#define RING_BUFFER_MIN_ALIGNMENT		16			// vec4 of the std430 and bindless structs
+#define RING_BUFFER_WAIT_TIMEOUT		1000000		// nanoseconds of one client wait
+
+struct RingBufferRange
+{
+	GLuint		buffer;
+	size_t		offset;
+	size_t		size;
+	void		*ptr;		// mapped memory of the range
+	GLuint64	address;	// bindless gpu address of the range, 0 when NV_shader_buffer_load is not supported
+	unsigned int	frame;	// ring frame the range is written in
+
+	static void Clear(RingBufferRange &range)
+	{
+		range.buffer = 0;
+		range.offset = 0;
+		range.size = 0;
+		range.ptr = nullptr;
+		range.address = 0;
+		range.frame = 0;
+	}
+};
+
+class CGPURingBuffer
+{
+public:
+
+	// a ring of the process, it's empty until Init
+	static CGPURingBuffer &GetInstance();
+
+	//! a constructor
+	CGPURingBuffer();
+	//! a destructor
+	~CGPURingBuffer();
+
+	// create and map the buffer, waits for the frames in flight of a previous buffer
+	bool	Init(const size_t size=RING_BUFFER_DEFAULT_SIZE, const int maxFrames=RING_BUFFER_MAX_FRAMES);
+	void	Free();
+
+	const bool IsReady() const
+	{
+		return (mBuffer > 0 && mMapped != nullptr);
+	}
+
+	// range with the ring alignment (ssbo, ubo offset alignment), returns false on overflow
+	bool	Allocate(const size_t size, RingBufferRange &range);
+	bool	Allocate(const size_t size, const size_t alignment, RingBufferRange &range);
+	// allocate and copy the data
+	bool	Upload(const size_t size, const void *data, RingBufferRange &range);
+	bool	Upload(const size_t size1, const void *data1, const size_t size2, const void *data2, RingBufferRange &range);
+
+	// range is written in the current frame, earlier ranges could be overwritten already
+	const bool IsRangeCurrent(const RingBufferRange &range) const
+	{
+		return (range.size > 0 && range.buffer == mBuffer && range.frame == mFrameId && IsReady() );
+	}
+
+	// put a fence after the frame commands, waits for the oldest frame when too many are in flight
+	void	EndFrame();
+	// retire the frames with signaled fences, wait for all of them if needed
+	void	RetireFrames(const bool wait);
+
+	const GLuint GetBufferId() const
+	{
+		return mBuffer;
+	}
+	const GLuint64 GetGPUPtr() const
+	{
+		return mBufferPtr;
+	}
+	const size_t GetAlignment() const
+	{
+		return mAlignment;
+	}
+	const CRingAllocator &GetAllocator() const
+	{
+		return mAllocator;
+	}
+
+	// counted since Init
+	const int GetNumberOfFrames() const
+	{
+		return mNumberOfFrames;
+	}
+	const int GetNumberOfOverflows() const
+	{
+		return mNumberOfOverflows;
+	}
+	const int GetNumberOfWaits() const
+	{
+		return mNumberOfWaits;
+	}
+
+protected:
+
+	GLuint				mBuffer;
+	GLuint64			mBufferPtr;
+	unsigned char		*mMapped;
+	size_t				mAlignment;
+	int					mMaxFrames;
+	unsigned int		mFrameId;		// stamp of the ranges, not reset by Init so the ranges of a previous buffer are not current
+
+	CRingAllocator		mAllocator;
+
+	int					mNumberOfFrames;
+	int					mNumberOfOverflows;
+	int					mNumberOfWaits;
+
+	// true when the fence is signaled
+	bool	WaitFence(GLsync fence, const bool wait);
+};
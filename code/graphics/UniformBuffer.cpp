@@ -79,6 +79,9 @@ CGPUBuffer::CGPUBuffer()
 	mBuffer = 0;
 	mBufferSize = 0;
 	mBufferCount = 0;
+
+	mRingBuffer = nullptr;
+	RingBufferRange::Clear(mRingRange);
 }
 
 void CGPUBuffer::Free()
@@ -110,6 +113,14 @@ CGPUBufferSSBO::~CGPUBufferSSBO()
 
 void CGPUBufferSSBO::UpdateData(const size_t _size, const size_t _count, const void *data)
 {
+	mBufferSize = _size;
+	mBufferCount = _count;
+
+	// no driver reallocation, the range is bound on Bind
+	if (mRingBuffer && mRingBuffer->Upload(_size * _count, data, mRingRange) )
+		return;
+
+	RingBufferRange::Clear(mRingRange);
 
 	if (mBuffer == 0)
 	{
@@ -128,14 +139,20 @@ void CGPUBufferSSBO::UpdateData(const size_t _size, const size_t _count, const v
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0 );
 		CHECK_GL_ERROR();
 	}
-
-	mBufferSize = _size;
-	mBufferCount = _count;
 }
 
 void CGPUBufferSSBO::Bind(const GLuint unitId)
 {
-	if (mBuffer > 0)
+	// not updated in this frame, the own buffer is not written since the ring took over
+	if (IsRingRangeRetired() )
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, unitId, 0);
+	}
+	else if (mRingRange.size > 0)
+	{
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, unitId, mRingRange.buffer, (GLintptr) mRingRange.offset, (GLsizeiptr) mRingRange.size);
+	}
+	else if (mBuffer > 0)
 	{
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, unitId, mBuffer);
 	}
@@ -179,8 +196,27 @@ void CGPUBufferNV::MakeBufferResident()
 	*/
 }
 
+bool CGPUBufferNV::UploadToRing(const size_t size1, const void *buffer1, const size_t size2, const void *buffer2)
+{
+	if (mRingBuffer == nullptr || mRingBuffer->GetGPUPtr() == 0
+		|| false == mRingBuffer->Upload(size1, buffer1, size2, buffer2, mRingRange) )
+	{
+		RingBufferRange::Clear(mRingRange);
+		return false;
+	}
+
+	mBufferPtr = mRingRange.address;
+	return true;
+}
+
 void CGPUBufferNV::UpdateData(const size_t _size, const size_t _count, const void *data)
 {
+	if (_size > 0 && _count > 0 && UploadToRing(_size * _count, data, 0, nullptr) )
+	{
+		mBufferSize = _size;
+		mBufferCount = _count;
+		return;
+	}
 
 	if (mBuffer == 0)
 	{
@@ -230,10 +266,27 @@ void CGPUBufferNV::UpdateData(const size_t elemSize, const size_t count1, const
 {
 	bool firstTime = false;
 
+	if (elemSize > 0 && count1 > 0)
+	{
+		const bool wasInRing = (mRingRange.size > 0);
+
+		if (UploadToRing(elemSize * count1, buffer1, elemSize * count2, buffer2) )
+		{
+			mBufferSize = elemSize;
+			mBufferCount = count1 + count2;
+			return;
+		}
+
+		// own buffer address has to be queried again
+		if (wasInRing)
+			mBufferCount = 0;
+	}
+
 	// update data in SSBO
 	if (elemSize == 0 || count1 == 0)
 	{
 		mBufferPtr = 0;
+		RingBufferRange::Clear(mRingRange);
 
 		glDeleteBuffers(1, &mBuffer);
 		mBuffer = 0;
@@ -305,11 +358,44 @@ void CGPUBufferNV::UpdateData(const size_t elemSize, const size_t count1, const
 	}
 }
 
+void CGPUBufferNV::UpdateRanges(const size_t elemSize, const size_t count, const void *data, 
+		const DirtyRange *ranges, const int numberOfRanges)
+{
+	// ring range could be read by the gpu, the data goes into a new one
+	if (mBuffer == 0 || mBufferPtr == 0 || mBufferSize != elemSize || mBufferCount != count || mRingRange.size > 0)
+	{
+		UpdateData(elemSize, count, data);
+		return;
+	}
+
+	if (numberOfRanges <= 0 || ranges == nullptr)
+		return;
+
+	// buffer stays resident, the address is not changed by the sub data
+	glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+
+	const char *bytes = (const char*) data;
+
+	for (int i=0; i<numberOfRanges; ++i)
+	{
+		const GLintptr offset = (GLintptr) (elemSize * ranges[i].first);
+		const GLsizeiptr size = (GLsizeiptr) (elemSize * ranges[i].count);
+
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, size, bytes + offset);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	CHECK_GL_ERROR();
+}
+
 void CGPUBufferNV::BindAsAttribute(const GLuint attribIndex, const GLuint offset) const
 {
-	if (mBufferPtr > 0)
+	const GLuint64 bufferPtr = GetBindPtr();
+
+	if (bufferPtr > 0)
 	{
-		const GLuint64 uniformGPUPtr = mBufferPtr + offset;
+		const GLuint64 uniformGPUPtr = bufferPtr + offset;
 		glVertexAttribI2iEXT( attribIndex, (int)(uniformGPUPtr & 0xFFFFFFFF), (int) (uniformGPUPtr>>32) & (0xFFFFFFFF) );
 	}
 }
@@ -322,9 +408,11 @@ void CGPUBufferNV::BindAsUniform(const GLuint programId, const GLint uniformLoc,
 		if (lprogram == 0)
 			glGetIntegerv( GL_CURRENT_PROGRAM, &lprogram );
 
-		if (mBufferPtr > 0)
+		const GLuint64 bufferPtr = GetBindPtr();
+
+		if (bufferPtr > 0)
 		{
-			GLuint64 uniformGPUPtr = mBufferPtr + offset;
+			GLuint64 uniformGPUPtr = bufferPtr + offset;
 			glProgramUniform1ui64NV( lprogram, uniformLoc, uniformGPUPtr );		
 		}
 		else
@@ -353,6 +441,9 @@ CGPUBufferDoubleNV::CGPUBufferDoubleNV()
 	mBufferPtr = 0;
 	mCount = 0;
 
+	mRingBuffer = nullptr;
+	RingBufferRange::Clear(mRingRange);
+
 	//mCriticalSection.Init();
 }
 
@@ -371,10 +462,21 @@ void CGPUBufferDoubleNV::Free()
 	}
 	mCount = 0;
 	mBufferPtr = 0;
+	RingBufferRange::Clear(mRingRange);
 }
 
 void CGPUBufferDoubleNV::UpdateData(const size_t _size, const size_t _count, const void *data)
 {
+	// the ring keeps the frames in flight, so there is nothing to ping-pong
+	if (mRingBuffer && mRingBuffer->GetGPUPtr() > 0 && _count > 0 && _size > 0
+		&& mRingBuffer->Upload(_size * _count, data, mRingRange) )
+	{
+		mHasUpdated = true;
+		mCount = (int) _count;
+		return;
+	}
+
+	RingBufferRange::Clear(mRingRange);
 
 	if (mBuffers[0] == 0)
 	{
@@ -405,6 +507,22 @@ void CGPUBufferDoubleNV::UpdateData(const size_t _size, const size_t _count, con
 
 void CGPUBufferDoubleNV::UpdateGPUPtr()
 {
+	if (mRingRange.size > 0)
+	{
+		if (mRingBuffer && mRingBuffer->IsRangeCurrent(mRingRange) )
+		{
+			if (mHasUpdated)
+				mBufferPtr = mRingRange.address;
+			mHasUpdated = false;
+			return;
+		}
+
+		// not updated in this frame, the own buffers are not written since the ring took over
+		mHasUpdated = false;
+		mBufferPtr = 0;
+		return;
+	}
+
 	if (mBuffers[0] == 0) return;
 
 	// swap free and render buffer
@@ -443,22 +561,26 @@ void CGPUBufferDoubleNV::UpdateGPUPtr()
 
 void CGPUBufferDoubleNV::BindAsAttribute(const GLuint attribIndex, const GLuint offset)
 {
-	if (mBufferPtr > 0)
+	const GLuint64 bufferPtr = GetBindPtr();
+
+	if (bufferPtr > 0)
 	{
-		const GLuint64 uniformGPUPtr = mBufferPtr + offset;
+		const GLuint64 uniformGPUPtr = bufferPtr + offset;
 		glVertexAttribI2iEXT( attribIndex, (int)(uniformGPUPtr & 0xFFFFFFFF), (int) (uniformGPUPtr>>32) & (0xFFFFFFFF) );
 	}
 }
 
 void CGPUBufferDoubleNV::BindAsUniform(const GLuint programId, const GLint uniformLoc, const GLuint offset) const
 {
-	if (mBufferPtr > 0 && uniformLoc >= 0)
+	const GLuint64 bufferPtr = GetBindPtr();
+
+	if (bufferPtr > 0 && uniformLoc >= 0)
 	{
 		GLint lprogram = programId;
 		if (lprogram == 0)
 			glGetIntegerv( GL_CURRENT_PROGRAM, &lprogram );
 
-		GLuint64 uniformGPUPtr = mBufferPtr + offset;
+		GLuint64 uniformGPUPtr = bufferPtr + offset;
 		glProgramUniform1ui64NV( lprogram, uniformLoc, uniformGPUPtr );		
 	}
 }
\ No newline at end of file
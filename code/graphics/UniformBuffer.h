@@ -9,10 +9,12 @@
 */
 
 //-- 
-#include <GL\glew.h>
+#include <GL/glew.h>
+#include "algorithm/DirtyRanges.h"
+#include "RingBuffer.h"
 
 #ifdef USE_CG
-#include <Cg\cgGL.h>
+#include <Cg/cgGL.h>
 #endif
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -42,6 +44,14 @@ public:
 	{
 	}
 
+	// upload only the element ranges of the data (data is the whole array)
+	//	the whole array is uploaded when the buffer has a different size
+	virtual void UpdateRanges(const size_t elemSize, const size_t count, const void *data, 
+		const DirtyRange *ranges, const int numberOfRanges)
+	{
+		UpdateData(elemSize, count, data);
+	}
+
 	virtual void Bind(const GLuint unitId)
 	{}
 	virtual void UnBind()
@@ -60,12 +70,32 @@ public:
 		return mBuffer;
 	}
 
+	// per frame data goes into a range of the ring, nullptr to use the own buffer only
+	//	the data has to be updated every frame, own buffer is used when the ring is full
+	void SetRingBuffer(CGPURingBuffer *ringBuffer)
+	{
+		mRingBuffer = ringBuffer;
+	}
+	const bool IsInRingBuffer() const
+	{
+		return (mRingRange.size > 0 && false == IsRingRangeRetired() );
+	}
+
 protected:
 	// SSBO for texture addresses
 	GLuint							mBuffer; // TODO: SSBO or texture buffer pointer
 
 	size_t			mBufferSize;	// one element size
 	size_t			mBufferCount;	// number of elements in the buffer
+
+	CGPURingBuffer		*mRingBuffer;
+	RingBufferRange		mRingRange;		// range of the last update, empty when the own buffer is used
+
+	// range is not updated in this frame, its ring space could be reused already
+	const bool IsRingRangeRetired() const
+	{
+		return (mRingRange.size > 0 && (mRingBuffer == nullptr || false == mRingBuffer->IsRangeCurrent(mRingRange) ) );
+	}
 };
 
 #ifdef USE_CG
@@ -137,6 +167,8 @@ public:
 	virtual void UpdateData(const size_t size, const size_t count, const void *data) override;
 	virtual void UpdateData(const size_t elemSize, const size_t count1, const void *buffer1,
 		const size_t count2, const void *buffer2) override;
+	virtual void UpdateRanges(const size_t elemSize, const size_t count, const void *data, 
+		const DirtyRange *ranges, const int numberOfRanges) override;
 
 	virtual void BindAsAttribute(const GLuint attribIndex, const GLuint offset) const;
 	virtual void BindAsUniform(const GLuint programId, const GLint uniformLoc, const GLuint offset) const;
@@ -146,12 +178,21 @@ public:
 
 	const GLuint64 GetGPUPtr() const
 	{
-		return mBufferPtr;
+		return GetBindPtr();
 	}
 
 private:
 
 	GLuint64		mBufferPtr;
+
+	// address of a retired ring range is not bound
+	const GLuint64 GetBindPtr() const
+	{
+		return (IsRingRangeRetired() ) ? 0 : mBufferPtr;
+	}
+
+	// bindless ring has a gpu address
+	bool	UploadToRing(const size_t size1, const void *buffer1, const size_t size2, const void *buffer2);
 };
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -177,13 +218,19 @@ public:
 
 	const GLuint64 GetGPUPtr() const
 	{
-		return mBufferPtr;
+		return GetBindPtr();
 	}
 
 	const int GetCount() const {
 		return mCount;
 	}
 
+	// evaluated data goes into a range of the ring instead of the ping-pong buffers, see CGPUBuffer::SetRingBuffer
+	void SetRingBuffer(CGPURingBuffer *ringBuffer)
+	{
+		mRingBuffer = ringBuffer;
+	}
+
 private:
 
 	//FBCriticalSection	mCriticalSection;
@@ -199,5 +246,16 @@ private:
 
 	GLuint64		mBufferPtr;
 
+	CGPURingBuffer		*mRingBuffer;
+	RingBufferRange		mRingRange;		// evaluated range, empty when the own buffers are used
+
 	void		Free();
+
+	// address of a ring range from an earlier frame is not bound until the next UpdateData
+	const GLuint64 GetBindPtr() const
+	{
+		if (mRingRange.size > 0 && (mRingBuffer == nullptr || false == mRingBuffer->IsRangeCurrent(mRingRange) ) )
+			return 0;
+		return mBufferPtr;
+	}
 };
\ No newline at end of file
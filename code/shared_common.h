@@ -1,8 +1,8 @@
 
 #pragma once
 
-#include "graphics\OGL_Utils.h"
-#include "graphics\UniformBuffer.h"
+#include "graphics/OGL_Utils.h"
+#include "graphics/UniformBuffer.h"
 #include <vector>
 #include <map>
 
@@ -69,7 +69,18 @@ public:
 	{
 		if (mNeedGPUUpdate)
 		{
-			mBuffer.UpdateData( sizeof(T), mGPUData.size(), mGPUData.data() );
+			// only changed items are uploaded, a new size goes into a new buffer
+			if (mDirtyRanges.IsEmpty() )
+				mDirtyRanges.AddAll();
+
+			const int numberOfRanges = mDirtyRanges.Coalesce( (int) mGPUData.size() );
+
+			if (mDirtyRanges.IsFull() )
+				mBuffer.UpdateData( sizeof(T), mGPUData.size(), mGPUData.data() );
+			else
+				mBuffer.UpdateRanges( sizeof(T), mGPUData.size(), mGPUData.data(), mDirtyRanges.GetRanges(), numberOfRanges );
+
+			mDirtyRanges.Clear();
 			mNeedGPUUpdate = false;
 		}
 	}
@@ -155,6 +166,13 @@ public:
 	void		CauseAGPUUpdate()
 	{
 		mNeedGPUUpdate = true;
+		mDirtyRanges.AddAll();
+	}
+	// upload only the changed items on the next PrepRender
+	void		CauseAGPUUpdate(const int index, const int count=1)
+	{
+		mNeedGPUUpdate = true;
+		mDirtyRanges.Add(index, count);
 	}
 	const bool IsNeedAGPUUpdate() const {
 		return mNeedGPUUpdate;
@@ -163,6 +181,7 @@ public:
 protected:
 
 	bool							mNeedGPUUpdate;
+	CDirtyRanges					mDirtyRanges;	// changed items since the last upload
 
 	size_t							mNumberOfBaseShaders;
 	std::vector<T>					mGPUData;
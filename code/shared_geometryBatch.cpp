@@ -0,0 +1,253 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: shared_geometryBatch.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+
+#include "shared_geometryBatch.h"
+#include "graphics/CheckGLError.h"
+
+// index of the record of the cache, negative is an empty reference
+static int MoveIndex(const int index, const int offset)
+{
+	return (index >= 0) ? index + offset : index;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+//
+
+CGeometryBatch::CGeometryBatch(CGeometryHeap *heap)
+	: mHeap(heap)
+{
+	mBufferIndirect = 0;
+	mBufferIndirectTransparency = 0;
+}
+
+CGeometryBatch::~CGeometryBatch()
+{
+	Free();
+}
+
+void CGeometryBatch::Free()
+{
+	if (mBufferIndirect > 0)
+	{
+		glDeleteBuffers(1, &mBufferIndirect);
+		mBufferIndirect = 0;
+	}
+	if (mBufferIndirectTransparency > 0)
+	{
+		glDeleteBuffers(1, &mBufferIndirectTransparency);
+		mBufferIndirectTransparency = 0;
+	}
+
+	mBufferTextures.Free();
+	mBufferMaterials.Free();
+	mBufferShaders.Free();
+	mBufferPerMesh.Free();
+	mBufferPerModel.Free();
+
+	Begin();
+}
+
+void CGeometryBatch::Begin()
+{
+	mItems.clear();
+}
+
+bool CGeometryBatch::Add(const GeometryBatchItem &item)
+{
+	if (nullptr == mHeap || nullptr == item.range || false == GeometryHeapRange::IsValid(*item.range) )
+	{
+		printf( "> ERROR: batch item has to be in the geometry heap\n" );
+		return false;
+	}
+
+	mItems.push_back(item);
+	return true;
+}
+
+void CGeometryBatch::AppendCommands(const DrawElementsIndirectCommand *commands, const int numberOfCommands,
+		const GLuint baseVertex, const GLuint firstIndex, const GLuint meshOffset, std::vector<DrawElementsIndirectCommand> &merged)
+{
+	for (int i=0; i<numberOfCommands; ++i)
+	{
+		DrawElementsIndirectCommand command = commands[i];
+		command.firstIndex += firstIndex;
+		command.baseVertex += baseVertex;
+		command.baseInstance += meshOffset;
+
+		merged.push_back(command);
+	}
+}
+
+void CGeometryBatch::UploadCommands(GLuint &buffer, const std::vector<DrawElementsIndirectCommand> &commands)
+{
+	if (commands.size() == 0)
+		return;
+
+	if (buffer == 0)
+		glGenBuffers(1, &buffer);
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, buffer );
+	glBufferData( GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * commands.size(), commands.data(), GL_STREAM_DRAW );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+}
+
+bool CGeometryBatch::Prepare()
+{
+	mCommands.clear();
+	mCommandsTransparency.clear();
+	mTextures.clear();
+	mMaterials.clear();
+	mShaders.clear();
+	mMeshes.clear();
+	mModels.clear();
+
+	if (mItems.size() == 0)
+		return false;
+
+	for (auto iter=begin(mItems); iter!=end(mItems); ++iter)
+	{
+		const GeometryBatchItem &item = *iter;
+
+		const int textureOffset = (int) mTextures.size();
+		const int materialOffset = (int) mMaterials.size();
+		const int shaderOffset = (int) mShaders.size();
+		const int meshOffset = (int) mMeshes.size();
+		const int modelOffset = (int) mModels.size();
+
+		mTextures.insert( end(mTextures), item.textures, item.textures + item.numberOfTextures );
+
+		for (int i=0; i<item.numberOfMaterials; ++i)
+		{
+			MaterialGLSL mat = item.materials[i];
+
+			mat.ambient = MoveIndex(mat.ambient, textureOffset);
+			mat.diffuse = MoveIndex(mat.diffuse, textureOffset);
+			mat.specular = MoveIndex(mat.specular, textureOffset);
+			mat.emissive = MoveIndex(mat.emissive, textureOffset);
+			mat.transparency = MoveIndex(mat.transparency, textureOffset);
+			mat.normalmap = MoveIndex(mat.normalmap, textureOffset);
+			mat.reflect = MoveIndex(mat.reflect, textureOffset);
+
+			mMaterials.push_back(mat);
+		}
+
+		// combinations keep the indices of the base shaders
+		for (int i=0; i<item.numberOfShaders; ++i)
+		{
+			ShaderGLSL shader = item.shaders[i];
+
+			shader.shader1 = MoveIndex(shader.shader1, shaderOffset);
+			shader.shader2 = MoveIndex(shader.shader2, shaderOffset);
+			shader.shader3 = MoveIndex(shader.shader3, shaderOffset);
+			shader.shader4 = MoveIndex(shader.shader4, shaderOffset);
+			shader.shader5 = MoveIndex(shader.shader5, shaderOffset);
+
+			mShaders.push_back(shader);
+		}
+
+		// lightmap holds the receive shadows flag, it's not an index
+		for (int i=0; i<item.numberOfMeshes; ++i)
+		{
+			MeshGLSL mesh = item.meshes[i];
+
+			mesh.material = MoveIndex(mesh.material, materialOffset);
+			mesh.shader = MoveIndex(mesh.shader, shaderOffset);
+			mesh.model = MoveIndex(mesh.model, modelOffset);
+
+			mMeshes.push_back(mesh);
+		}
+
+		// normal matrices are computed with the cache matrix already
+		if (nullptr == item.transform)
+		{
+			mModels.insert( end(mModels), item.models, item.models + item.numberOfModels );
+		}
+		else
+		{
+			mat4 m4_parent;
+			memcpy( m4_parent.mat_array, item.transform, sizeof(float) * 16 );
+
+			for (int i=0; i<item.numberOfModels; ++i)
+			{
+				ModelGLSL model = item.models[i];
+				model.transform = m4_parent * item.models[i].transform;
+
+				mModels.push_back(model);
+			}
+		}
+
+		const GLuint baseVertex = mHeap->GetBaseVertex(*item.range);
+		const GLuint firstIndex = mHeap->GetFirstIndex(*item.range);
+
+		AppendCommands( item.commands, item.numberOfCommands, baseVertex, firstIndex, (GLuint) meshOffset, mCommands );
+		AppendCommands( item.commandsTransparency, item.numberOfCommandsTransparency, baseVertex, firstIndex, (GLuint) meshOffset,
+			mCommandsTransparency );
+	}
+
+	if (mTextures.size() > 0)
+		mBufferTextures.UpdateData( sizeof(TextureGLSL), mTextures.size(), mTextures.data() );
+	if (mMaterials.size() > 0)
+		mBufferMaterials.UpdateData( sizeof(MaterialGLSL), mMaterials.size(), mMaterials.data() );
+	if (mShaders.size() > 0)
+		mBufferShaders.UpdateData( sizeof(ShaderGLSL), mShaders.size(), mShaders.data() );
+	if (mMeshes.size() > 0)
+		mBufferPerMesh.UpdateData( sizeof(MeshGLSL), mMeshes.size(), mMeshes.data() );
+	if (mModels.size() > 0)
+		mBufferPerModel.UpdateData( sizeof(ModelGLSL), mModels.size(), mModels.data() );
+
+	UploadCommands( mBufferIndirect, mCommands );
+	UploadCommands( mBufferIndirectTransparency, mCommandsTransparency );
+
+	CHECK_GL_ERROR();
+	return true;
+}
+
+void CGeometryBatch::RenderBegin()
+{
+	mHeap->Bind();
+
+	glEnableVertexAttribArray(0);		// position
+	glEnableVertexAttribArray(1);		// tex coords
+	glEnableVertexAttribArray(2);		// normal
+}
+
+void CGeometryBatch::RenderOpaque()
+{
+	if (mCommands.size() > 0)
+	{
+		glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBufferIndirect );
+		glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*) 0, (GLsizei) mCommands.size(), 0 );
+	}
+}
+
+void CGeometryBatch::RenderTransparency()
+{
+	if (mCommandsTransparency.size() > 0)
+	{
+		glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBufferIndirectTransparency );
+		glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*) 0, (GLsizei) mCommandsTransparency.size(), 0 );
+	}
+}
+
+void CGeometryBatch::RenderEnd()
+{
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+	mHeap->UnBind();
+
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(2);
+	glDisableVertexAttribArray(3);		// tangent is enabled by the heap
+}
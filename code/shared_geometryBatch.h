@@ -0,0 +1,180 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: shared_geometryBatch.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <string.h>
+
+#include "shared_glsl.h"
+#include "shared_geometryHeap.h"
+#include "graphics/UniformBuffer.h"
+
+//////////////////////////////////////////////////////////////////////////////////
+// one multi draw of the caches in the geometry heap
+//	records of the caches (textures, materials, shaders, meshes and models) are merged into the shared buffers,
+//	indices of the records are moved by the offsets of the cache in the merged arrays,
+//	commands get the heap range offsets and the mesh offset in the base instance, so the caches draw
+//	with one glMultiDrawElementsIndirect for the opaque and one for the transparency
+//	The cache transform is multiplied into the model transforms, the world transform of the shader is identity
+//	NOTE: the batch is collected every frame (Begin, Add, Prepare), all calls have to be done in a gl thread
+
+struct GeometryBatchItem
+{
+	const GeometryHeapRange				*range;				// range of the cache in the batch heap
+
+	const float							*transform;			// cache matrix (16 floats), nullptr for the identity
+
+	// commands are relative to the range, base instance is the mesh index of the cache
+	const DrawElementsIndirectCommand	*commands;
+	int									numberOfCommands;
+	const DrawElementsIndirectCommand	*commandsTransparency;
+	int									numberOfCommandsTransparency;
+
+	const TextureGLSL					*textures;
+	int									numberOfTextures;
+	const MaterialGLSL					*materials;
+	int									numberOfMaterials;
+	const ShaderGLSL					*shaders;
+	int									numberOfShaders;
+	const MeshGLSL						*meshes;
+	int									numberOfMeshes;
+	const ModelGLSL						*models;
+	int									numberOfModels;
+
+	static void Clear(GeometryBatchItem &item)
+	{
+		memset( &item, 0, sizeof(GeometryBatchItem) );
+	}
+};
+
+class CGeometryBatch
+{
+public:
+
+	//! a constructor
+	CGeometryBatch(CGeometryHeap *heap);
+	//! a destructor
+	~CGeometryBatch();
+
+	// delete the buffers
+	void	Free();
+
+	// start a new set of the caches
+	void	Begin();
+	// records are copied on Prepare, the item arrays have to live until then
+	bool	Add(const GeometryBatchItem &item);
+	// merge the records and the commands, upload them into the shared buffers
+	bool	Prepare();
+
+	// bind the heap streams and enable the attributes, the merged records are bound by the shader with the Bind*AsUniform
+	void	RenderBegin();
+	void	RenderOpaque();
+	void	RenderTransparency();
+	void	RenderEnd();
+
+	void BindTexturesAsUniform( const GLuint programId, const GLint uniformLoc ) {
+		mBufferTextures.BindAsUniform( programId, uniformLoc, 0 );
+	}
+	void BindMaterialsAsUniform( const GLuint programId, const GLint uniformLoc ) {
+		mBufferMaterials.BindAsUniform( programId, uniformLoc, 0 );
+	}
+	void BindShadersAsUniform( const GLuint programId, const GLint uniformLoc ) {
+		mBufferShaders.BindAsUniform( programId, uniformLoc, 0 );
+	}
+	void BindMeshInfoAsUniform( const GLuint programId, const GLint uniformLoc ) {
+		mBufferPerMesh.BindAsUniform( programId, uniformLoc, 0 );
+	}
+	void BindModelInfoAsUniform( const GLuint programId, const GLint uniformLoc ) {
+		mBufferPerModel.BindAsUniform( programId, uniformLoc, 0 );
+	}
+
+	const int GetNumberOfItems() const
+	{
+		return (int) mItems.size();
+	}
+	const int GetNumberOfCommands() const
+	{
+		return (int) mCommands.size();
+	}
+	const int GetNumberOfCommandsTransparency() const
+	{
+		return (int) mCommandsTransparency.size();
+	}
+
+	// merged arrays of the last Prepare
+	const std::vector<DrawElementsIndirectCommand> &GetCommands() const
+	{
+		return mCommands;
+	}
+	const std::vector<DrawElementsIndirectCommand> &GetCommandsTransparency() const
+	{
+		return mCommandsTransparency;
+	}
+	const std::vector<MaterialGLSL> &GetMaterials() const
+	{
+		return mMaterials;
+	}
+	const std::vector<ShaderGLSL> &GetShaders() const
+	{
+		return mShaders;
+	}
+	const std::vector<MeshGLSL> &GetMeshes() const
+	{
+		return mMeshes;
+	}
+	const std::vector<ModelGLSL> &GetModels() const
+	{
+		return mModels;
+	}
+
+	const GLuint GetBufferIndirect() const
+	{
+		return mBufferIndirect;
+	}
+	const GLuint GetBufferIndirectTransparency() const
+	{
+		return mBufferIndirectTransparency;
+	}
+
+protected:
+
+	CGeometryHeap							*mHeap;
+
+	std::vector<GeometryBatchItem>			mItems;
+
+	std::vector<DrawElementsIndirectCommand>	mCommands;
+	std::vector<DrawElementsIndirectCommand>	mCommandsTransparency;
+
+	std::vector<TextureGLSL>				mTextures;
+	std::vector<MaterialGLSL>				mMaterials;
+	std::vector<ShaderGLSL>					mShaders;
+	std::vector<MeshGLSL>					mMeshes;
+	std::vector<ModelGLSL>					mModels;
+
+	GLuint									mBufferIndirect;
+	GLuint									mBufferIndirectTransparency;
+
+	CGPUBufferNV							mBufferTextures;
+	CGPUBufferNV							mBufferMaterials;
+	CGPUBufferNV							mBufferShaders;
+	CGPUBufferNV							mBufferPerMesh;
+	CGPUBufferNV							mBufferPerModel;
+
+	// the range offsets and the mesh offset are added to the commands of the item
+	void	AppendCommands(const DrawElementsIndirectCommand *commands, const int numberOfCommands,
+		const GLuint baseVertex, const GLuint firstIndex, const GLuint meshOffset, std::vector<DrawElementsIndirectCommand> &merged);
+
+	void	UploadCommands(GLuint &buffer, const std::vector<DrawElementsIndirectCommand> &commands);
+};
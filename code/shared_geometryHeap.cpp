@@ -0,0 +1,342 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: shared_geometryHeap.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "shared_geometryHeap.h"
+#include "gpucache_types.h"
+#include "graphics/CheckGLError.h"
+
+// NOTE: a global object, function local statics are not thread safe with vs2013
+static CGeometryHeap	gGeometryHeap;
+
+CGeometryHeap &CGeometryHeap::GetInstance()
+{
+	return gGeometryHeap;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+//
+
+CGeometryHeap::CGeometryHeap()
+{
+	for (int i=0; i<GEOMETRY_HEAP_STREAM_COUNT; ++i)
+		mBuffers[i] = 0;
+
+	mInitialVertices = GEOMETRY_HEAP_DEFAULT_VERTICES;
+	mInitialIndices = GEOMETRY_HEAP_DEFAULT_INDICES;
+
+	mGeneration = 0;
+	mNumberOfGrows = 0;
+	mNumberOfDefrags = 0;
+}
+
+CGeometryHeap::~CGeometryHeap()
+{
+	// gl context is already destroyed on the process exit, the host calls Free before that
+	mVertices.Init(0);
+	mIndices.Init(0);
+}
+
+void CGeometryHeap::SetCapacity(const unsigned int numberOfVertices, const unsigned int numberOfIndices)
+{
+	mInitialVertices = std::max(1U, numberOfVertices);
+	mInitialIndices = std::max(1U, numberOfIndices);
+}
+
+void CGeometryHeap::Free()
+{
+	for (int i=0; i<GEOMETRY_HEAP_STREAM_COUNT; ++i)
+	{
+		if (mBuffers[i] > 0)
+		{
+			glDeleteBuffers(1, &mBuffers[i]);
+			mBuffers[i] = 0;
+		}
+	}
+
+	mVertices.Init(0);
+	mIndices.Init(0);
+	mGeneration += 1;
+}
+
+const GLsizeiptr CGeometryHeap::GetStride(const EGeometryHeapStream stream)
+{
+	switch(stream)
+	{
+	case GEOMETRY_HEAP_STREAM_POINT: return gPointStride;
+	case GEOMETRY_HEAP_STREAM_UV: return gUVStride;
+	case GEOMETRY_HEAP_STREAM_NORMAL: return gNormalStride;
+	case GEOMETRY_HEAP_STREAM_TANGENT: return gTangentStride;
+	case GEOMETRY_HEAP_STREAM_INDEX: return gIndexStride;
+	default: return 0;
+	}
+}
+
+bool CGeometryHeap::Allocate(const unsigned int numberOfVertices, const unsigned int numberOfIndices, GeometryHeapRange &range)
+{
+	GeometryHeapRange::Clear(range);
+
+	if (numberOfVertices == 0 || numberOfIndices == 0)
+		return false;
+
+	if (mBuffers[GEOMETRY_HEAP_STREAM_POINT] == 0)
+	{
+		if (false == Grow( std::max(mInitialVertices, numberOfVertices), std::max(mInitialIndices, numberOfIndices) ) )
+			return false;
+	}
+
+	// when the free space is there, but it's split into small blocks, pack the heap first
+	//	grow otherwise, old buffers are copied
+	int vertices = mVertices.Allocate(numberOfVertices);
+	int indices = mIndices.Allocate(numberOfIndices);
+
+	if (vertices == TLSF_INVALID || indices == TLSF_INVALID)
+	{
+		const bool vertexSpace = (mVertices.GetCapacity() - mVertices.GetUsed() >= numberOfVertices);
+		const bool indexSpace = (mIndices.GetCapacity() - mIndices.GetUsed() >= numberOfIndices);
+
+		if ( (vertices == TLSF_INVALID && vertexSpace && mVertices.GetFragmentation() >= GEOMETRY_HEAP_DEFRAG_THRESHOLD)
+			|| (indices == TLSF_INVALID && indexSpace && mIndices.GetFragmentation() >= GEOMETRY_HEAP_DEFRAG_THRESHOLD) )
+		{
+			Defragment();
+
+			if (vertices == TLSF_INVALID)
+				vertices = mVertices.Allocate(numberOfVertices);
+			if (indices == TLSF_INVALID)
+				indices = mIndices.Allocate(numberOfIndices);
+		}
+	}
+
+	if (vertices == TLSF_INVALID || indices == TLSF_INVALID)
+	{
+		unsigned int vertexCapacity = mVertices.GetCapacity();
+		unsigned int indexCapacity = mIndices.GetCapacity();
+
+		if (vertices == TLSF_INVALID)
+			vertexCapacity = std::max(vertexCapacity * 2, vertexCapacity + numberOfVertices);
+		if (indices == TLSF_INVALID)
+			indexCapacity = std::max(indexCapacity * 2, indexCapacity + numberOfIndices);
+
+		if (Grow(vertexCapacity, indexCapacity) )
+		{
+			if (vertices == TLSF_INVALID)
+				vertices = mVertices.Allocate(numberOfVertices);
+			if (indices == TLSF_INVALID)
+				indices = mIndices.Allocate(numberOfIndices);
+		}
+	}
+
+	if (vertices == TLSF_INVALID || indices == TLSF_INVALID)
+	{
+		printf( "> ERROR: geometry heap failed to allocate %u vertices and %u indices\n", numberOfVertices, numberOfIndices );
+
+		mVertices.Free(vertices);
+		mIndices.Free(indices);
+		return false;
+	}
+
+	range.vertices = vertices;
+	range.indices = indices;
+	range.numberOfVertices = numberOfVertices;
+	range.numberOfIndices = numberOfIndices;
+
+	return true;
+}
+
+void CGeometryHeap::Release(GeometryHeapRange &range)
+{
+	mVertices.Free(range.vertices);
+	mIndices.Free(range.indices);
+
+	GeometryHeapRange::Clear(range);
+}
+
+bool CGeometryHeap::Upload(const GeometryHeapRange &range, const EGeometryHeapStream stream, const void *data)
+{
+	if (false == GeometryHeapRange::IsValid(range) || data == nullptr)
+		return false;
+
+	const GLsizeiptr stride = GetStride(stream);
+	const GLintptr offset = (stream == GEOMETRY_HEAP_STREAM_INDEX) ? GetFirstIndex(range) * stride : GetBaseVertex(range) * stride;
+	const GLsizeiptr size = (stream == GEOMETRY_HEAP_STREAM_INDEX) ? range.numberOfIndices * stride : range.numberOfVertices * stride;
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffers[stream]);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	return true;
+}
+
+void *CGeometryHeap::Map(const GeometryHeapRange &range, const EGeometryHeapStream stream)
+{
+	if (false == GeometryHeapRange::IsValid(range) )
+		return nullptr;
+
+	const GLsizeiptr stride = GetStride(stream);
+	const GLintptr offset = (stream == GEOMETRY_HEAP_STREAM_INDEX) ? GetFirstIndex(range) * stride : GetBaseVertex(range) * stride;
+	const GLsizeiptr size = (stream == GEOMETRY_HEAP_STREAM_INDEX) ? range.numberOfIndices * stride : range.numberOfVertices * stride;
+
+	// other ranges of the buffer could be in use by the gpu, only the range is invalidated
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffers[stream]);
+	void *ptr = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	return ptr;
+}
+
+bool CGeometryHeap::UnMap(const EGeometryHeapStream stream)
+{
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffers[stream]);
+	const GLboolean result = glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	return (result == GL_TRUE);
+}
+
+void CGeometryHeap::Bind()
+{
+	if (mBuffers[GEOMETRY_HEAP_STREAM_POINT] == 0)
+		return;
+
+	glBindBuffer( GL_ARRAY_BUFFER, mBuffers[GEOMETRY_HEAP_STREAM_POINT] );
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid*) 0 );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mBuffers[GEOMETRY_HEAP_STREAM_UV] );
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*) 0 );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mBuffers[GEOMETRY_HEAP_STREAM_NORMAL] );
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid*) 0 );
+
+	glEnableVertexAttribArray(3);		// tangent
+	glBindBuffer( GL_ARRAY_BUFFER, mBuffers[GEOMETRY_HEAP_STREAM_TANGENT] );
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid*) 0 );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mBuffers[GEOMETRY_HEAP_STREAM_INDEX] );
+}
+
+void CGeometryHeap::UnBind()
+{
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+}
+
+int CGeometryHeap::Defragment()
+{
+	if (mBuffers[GEOMETRY_HEAP_STREAM_POINT] == 0)
+		return 0;
+
+	int numberOfMoves = 0;
+
+	if (mVertices.Defragment(mMoves) > 0)
+	{
+		numberOfMoves += (int) mMoves.size();
+
+		for (int i=GEOMETRY_HEAP_STREAM_POINT; i<GEOMETRY_HEAP_STREAM_INDEX; ++i)
+			Reallocate( (EGeometryHeapStream) i, mVertices.GetCapacity(), &mMoves );
+	}
+
+	if (mIndices.Defragment(mMoves) > 0)
+	{
+		numberOfMoves += (int) mMoves.size();
+		Reallocate( GEOMETRY_HEAP_STREAM_INDEX, mIndices.GetCapacity(), &mMoves );
+	}
+
+	if (numberOfMoves > 0)
+	{
+		mGeneration += 1;
+		mNumberOfDefrags += 1;
+	}
+
+	CHECK_GL_ERROR();
+	return numberOfMoves;
+}
+
+bool CGeometryHeap::Grow(const unsigned int numberOfVertices, const unsigned int numberOfIndices)
+{
+	// sizes in bytes have to fit the signed GLsizeiptr of a 32 bit build
+	const unsigned long long maxElements = 0x7FFFFFFFULL / gPointStride;
+	if (numberOfVertices > maxElements || numberOfIndices > maxElements)
+		return false;
+
+	if (numberOfVertices > mVertices.GetCapacity() )
+	{
+		for (int i=GEOMETRY_HEAP_STREAM_POINT; i<GEOMETRY_HEAP_STREAM_INDEX; ++i)
+			Reallocate( (EGeometryHeapStream) i, numberOfVertices, nullptr );
+
+		mVertices.Grow(numberOfVertices);
+	}
+
+	if (numberOfIndices > mIndices.GetCapacity() )
+	{
+		Reallocate( GEOMETRY_HEAP_STREAM_INDEX, numberOfIndices, nullptr );
+		mIndices.Grow(numberOfIndices);
+	}
+
+	mNumberOfGrows += 1;
+
+	CHECK_GL_ERROR();
+	return true;
+}
+
+void CGeometryHeap::Reallocate(const EGeometryHeapStream stream, const unsigned int capacity, const std::vector<TLSFMove> *moves)
+{
+	const GLsizeiptr stride = GetStride(stream);
+	const GLuint oldBuffer = mBuffers[stream];
+
+	GLuint buffer = 0;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity * stride, nullptr, GL_STATIC_DRAW);
+
+	if (oldBuffer > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+
+		if (moves == nullptr)
+		{
+			// grow, offsets are the same
+			const unsigned int oldCapacity = (stream == GEOMETRY_HEAP_STREAM_INDEX) ? mIndices.GetCapacity() : mVertices.GetCapacity();
+			if (oldCapacity > 0)
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldCapacity * stride);
+		}
+		else if (moves->size() > 0)
+		{
+			// ranges before the first move are in place, the moved ones are copied in the runs
+			const TLSFMove *move = moves->data();
+			const TLSFMove *last = move + moves->size();
+
+			if (move->to > 0)
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, move->to * stride);
+
+			while (move != last)
+			{
+				const unsigned int from = move->from;
+				const unsigned int to = move->to;
+				unsigned int size = move->size;
+
+				for (++move; move != last && move->from == from + size && move->to == to + size; ++move)
+					size += move->size;
+
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from * stride, to * stride, size * stride);
+			}
+		}
+
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &oldBuffer);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	mBuffers[stream] = buffer;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: shared_geometryHeap.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "algorithm/TLSFAllocator.h"
+
+//////////////////////////////////////////////////////////////////////////////////
+// process wide vertex and index buffers, vertex data of each cache takes a range of them
+//	ranges are sub-allocated (TLSF) in vertices and indices, draw commands of a cache add the range
+//	base vertex and first index, so caches share the buffers and the vao setup
+//	CGeometryBatch merges the records and commands of such caches, so they draw with one multi draw (shared_geometryBatch.h)
+//	When the heap is full, it grows into the bigger buffers (offsets stay), Defragment packs the ranges
+//	and changes the offsets, the generation tells the owners to rebase their commands
+//	NOTE: all calls have to be done in a gl thread
+
+#define GEOMETRY_HEAP_DEFAULT_VERTICES		(1 << 20)
+#define GEOMETRY_HEAP_DEFAULT_INDICES		(3 << 20)
+#define GEOMETRY_HEAP_DEFRAG_THRESHOLD		0.5f		// fragmentation of the free space to pack the heap on a failed allocation
+
+enum EGeometryHeapStream
+{
+	GEOMETRY_HEAP_STREAM_POINT,
+	GEOMETRY_HEAP_STREAM_UV,
+	GEOMETRY_HEAP_STREAM_NORMAL,
+	GEOMETRY_HEAP_STREAM_TANGENT,
+	GEOMETRY_HEAP_STREAM_INDEX,
+	GEOMETRY_HEAP_STREAM_COUNT
+};
+
+struct GeometryHeapRange
+{
+	int				vertices;		// allocator handles
+	int				indices;
+	unsigned int	numberOfVertices;
+	unsigned int	numberOfIndices;
+
+	static void Clear(GeometryHeapRange &range)
+	{
+		range.vertices = TLSF_INVALID;
+		range.indices = TLSF_INVALID;
+		range.numberOfVertices = 0;
+		range.numberOfIndices = 0;
+	}
+
+	static bool IsValid(const GeometryHeapRange &range)
+	{
+		return (range.vertices != TLSF_INVALID && range.indices != TLSF_INVALID);
+	}
+};
+
+class CGeometryHeap
+{
+public:
+
+	// a heap of the process, buffers are created on the first allocation
+	static CGeometryHeap &GetInstance();
+
+	//! a constructor
+	CGeometryHeap();
+	//! a destructor
+	~CGeometryHeap();
+
+	// initial capacity, it's used when the buffers are created
+	void	SetCapacity(const unsigned int numberOfVertices, const unsigned int numberOfIndices);
+	// delete the buffers, all ranges are lost
+	void	Free();
+
+	bool	Allocate(const unsigned int numberOfVertices, const unsigned int numberOfIndices, GeometryHeapRange &range);
+	void	Release(GeometryHeapRange &range);
+
+	const unsigned int GetBaseVertex(const GeometryHeapRange &range) const
+	{
+		return mVertices.GetOffset(range.vertices);
+	}
+	const unsigned int GetFirstIndex(const GeometryHeapRange &range) const
+	{
+		return mIndices.GetOffset(range.indices);
+	}
+
+	// data of the whole stream of the range, indices are local to the range (base vertex is added on draw)
+	bool	Upload(const GeometryHeapRange &range, const EGeometryHeapStream stream, const void *data);
+	// write-only map of the stream range, buffer is left bound to GL_COPY_WRITE_BUFFER until UnMap
+	void	*Map(const GeometryHeapRange &range, const EGeometryHeapStream stream);
+	bool	UnMap(const EGeometryHeapStream stream);
+
+	// attributes 0-3 and the element buffer, ranges are selected by the command base vertex and first index
+	void	Bind();
+	void	UnBind();
+
+	// pack the ranges into the new buffers, returns the number of moved ranges
+	int		Defragment();
+
+	// changed when the offsets of the ranges are changed
+	const int GetGeneration() const
+	{
+		return mGeneration;
+	}
+	const GLuint GetBufferId(const EGeometryHeapStream stream) const
+	{
+		return mBuffers[stream];
+	}
+	const CTLSFAllocator &GetVertexAllocator() const
+	{
+		return mVertices;
+	}
+	const CTLSFAllocator &GetIndexAllocator() const
+	{
+		return mIndices;
+	}
+
+	const int GetNumberOfGrows() const
+	{
+		return mNumberOfGrows;
+	}
+	const int GetNumberOfDefrags() const
+	{
+		return mNumberOfDefrags;
+	}
+
+protected:
+
+	GLuint				mBuffers[GEOMETRY_HEAP_STREAM_COUNT];
+
+	unsigned int		mInitialVertices;
+	unsigned int		mInitialIndices;
+
+	CTLSFAllocator		mVertices;
+	CTLSFAllocator		mIndices;
+
+	int					mGeneration;
+	int					mNumberOfGrows;
+	int					mNumberOfDefrags;
+
+	std::vector<TLSFMove>	mMoves;
+
+	static const GLsizeiptr GetStride(const EGeometryHeapStream stream);
+
+	// create the buffers of the capacity (in elements) and copy the data of the current ones
+	bool	Grow(const unsigned int numberOfVertices, const unsigned int numberOfIndices);
+	void	Reallocate(const EGeometryHeapStream stream, const unsigned int capacity, const std::vector<TLSFMove> *moves);
+};
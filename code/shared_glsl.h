@@ -15,10 +15,10 @@
 
 
 //-- 
-#include <GL\glew.h>
+#include <GL/glew.h>
 
 //
-#include "algorithm\nv_math.h"
+#include "algorithm/nv_math.h"
 
 // !!! TODO: add information about shader alpha type values
 
@@ -140,6 +140,16 @@ struct ModelGLSL
 	// total 128 bytes
 };
 
+// optional compact layout of the model record (see CGPUModelRenderCached::SetCompactModelLayout)
+//	transform = transpose( mat4(transformRows[0], transformRows[1], transformRows[2], vec4(0,0,0,1)) )
+//	normalMatrix = mat3( normalColumns[0].xyz, normalColumns[1].xyz, normalColumns[2].xyz )
+struct ModelCompactGLSL
+{
+	vec4		transformRows[3];	// affine transform, translation in w
+	vec4		normalColumns[3];	// inverse transpose of the world view rotation and scale
+	// total 96 bytes
+};
+
 
 struct MeshGLSL
 {
@@ -159,6 +169,15 @@ struct MeshGLSL
 };
 
 
+// command of the indirect draws, base instance selects the mesh record
+typedef  struct {
+        GLuint  count;
+        GLuint  primCount;
+        GLuint  firstIndex;
+        GLuint  baseVertex;
+        GLuint  baseInstance;
+    } DrawElementsIndirectCommand;
+
 struct ProjectorGLSL
 {
 	mat4		matrix;				// texture projection matrix
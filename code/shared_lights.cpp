@@ -47,6 +47,15 @@ CGPULightsManager::CGPULightsManager()
 
 	mDebugDisplay = false;
 
+	// MapOnGPU uploads lights and clusters every frame, the ring is used once the host inits it
+	//	light matrices are updated only when shadows are prepared, so they stay in the own buffer
+	CGPURingBuffer *ringBuffer = &CGPURingBuffer::GetInstance();
+
+	mBufferLights.SetRingBuffer(ringBuffer);
+	mBufferDirLights.SetRingBuffer(ringBuffer);
+	mBufferClusterIndex.SetRingBuffer(ringBuffer);
+	mBufferClusterGrid.SetRingBuffer(ringBuffer);
+
 	mFrustumSegmentCount = 4;
 	mSplitWeight = 0.8f;
 }
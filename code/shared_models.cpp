@@ -16,6 +16,11 @@
 #include "shared_models.h"
 
 #include "graphics\CheckGLError.h"
+#include "gpucache_vertexMerge.h"
+
+#include <map>
+#include <algorithm>
+#include <float.h>
 //#include "graphics\particlesDrawHelper.h"
 
 
@@ -66,9 +71,23 @@ CGPUModelRenderCached::CGPUModelRenderCached(CGPUVertexData *vertexdata)
 	mBufferIndirect = 0;
 	mBufferIndirectTransparency = 0;
 	mBufferIndirectBindless = 0;
+	mBufferIndirectInstanced = 0;
+	mBufferIndirectInstancedTransparency = 0;
+	mUploadedBaseVertex = 0;
+	mUploadedFirstIndex = 0;
+	mCommandsCulled = false;
+	mBufferIndirectCulled = 0;
+	mBufferIndirectCulledTransparency = 0;
+	mCommandsCulledCPU = false;
+	mCullingSpheresDirty = true;
+	mHierarchyDirty = true;
+	mHierarchyMovedItems = 0;
+	mTriangleHierarchyDirty = true;
 	mBufferInfos = 0;
+	mCompactModelLayout = false;
 
 	mBufferBSphere = 0;
+	mBSphereMoved = false;
 	mBufferBShader = 0;
 	mBufferAz = 0;
 
@@ -79,6 +98,7 @@ CGPUModelRenderCached::CGPUModelRenderCached(CGPUVertexData *vertexdata)
 CGPUModelRenderCached::~CGPUModelRenderCached()
 {
 	Free();
+	FreeTriangleHierarchies();
 }
 
 void CGPUModelRenderCached::Free()
@@ -98,6 +118,26 @@ void CGPUModelRenderCached::Free()
 		glDeleteBuffers(1, &mBufferIndirectBindless);
 		mBufferIndirectBindless = 0;
 	}
+	if (mBufferIndirectInstanced)
+	{
+		glDeleteBuffers(1, &mBufferIndirectInstanced);
+		mBufferIndirectInstanced = 0;
+	}
+	if (mBufferIndirectInstancedTransparency)
+	{
+		glDeleteBuffers(1, &mBufferIndirectInstancedTransparency);
+		mBufferIndirectInstancedTransparency = 0;
+	}
+	if (mBufferIndirectCulled)
+	{
+		glDeleteBuffers(1, &mBufferIndirectCulled);
+		mBufferIndirectCulled = 0;
+	}
+	if (mBufferIndirectCulledTransparency)
+	{
+		glDeleteBuffers(1, &mBufferIndirectCulledTransparency);
+		mBufferIndirectCulledTransparency = 0;
+	}
 	if (mBufferInfos)
 	{
 		glDeleteBuffers(1, &mBufferInfos);
@@ -120,13 +160,33 @@ void CGPUModelRenderCached::Clear()
 	mSubModelNames.clear();
 	mCommands.clear();
 	mCommandsTransparency.clear();
+	mInstancedCommands.clear();
+	mInstancedCommandsTransparency.clear();
 	mBindlessCommands.clear();
 	mMeshInfos.clear();
 	mModelInfos.clear();
+	mCompactModelInfos.clear();
+	mMeshRanges.Clear();
+	mModelRanges.Clear();
+	mNormalMatrices.SetNumberOfModels(0);
 	//mClientModelInfos.clear();
 	//mClientMeshInfos.clear();
 	mBSphereCoords.clear();
 	mBShaderInfo.clear();
+	mClusters.clear();
+	mMeshClusters.clear();
+	mModelLods.clear();
+	mLodRanges.clear();
+	mMeshLods.clear();
+	mCulledCommands.clear();
+	mCulledCommandsTransparency.clear();
+	mCulling.ClearSpheres();
+	mCullingSpheresDirty = true;
+	mHierarchy.Clear();
+	mHierarchyDirty = true;
+	mModelMeshesFirst.clear();
+	mModelMeshes.clear();
+	FreeTriangleHierarchies();
 }
 
 
@@ -139,8 +199,11 @@ void CGPUModelRenderCached::Reserve(const int numberOfModels, const int numberOf
 
 	mBSphereCoords.reserve( numberOfMeshes );
 	mBShaderInfo.reserve( numberOfMeshes );
+	mMeshClusters.reserve( numberOfMeshes );
+	mMeshLods.reserve( numberOfMeshes );
 
 	mModelInfos.reserve( numberOfModels );
+	mModelLods.reserve( numberOfModels );
 	//mClientModelInfos.reserve( numberOfSubModels );
 
 	mMeshInfos.reserve( numberOfMeshes );
@@ -226,6 +289,7 @@ void CGPUModelRenderCached::PrepareBufferBSphere()
 		glBufferData(GL_ARRAY_BUFFER, sizeof(vec4)*mBSphereCoords.size(), mBSphereCoords.data(), GL_STATIC_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0 );
 	}
+	mBSphereMoved = false;
 
 	if (mBShaderInfo.size() > 0)
 	{
@@ -258,8 +322,146 @@ void CGPUModelRenderCached::BindBufferBSphere()
 	}
 }
 
+void CGPUModelRenderCached::GroupInstancedMeshes()
+{
+	const size_t numberOfMeshes = mMeshInfos.size();
+
+	if (numberOfMeshes < 2 || mCommands.size() != numberOfMeshes || mCommandsTransparency.size() != numberOfMeshes
+		|| mBSphereCoords.size() != numberOfMeshes || mBShaderInfo.size() != numberOfMeshes)
+		return;
+
+	// groups in order of their first mesh, key - index range and the opaque list visibility
+	typedef std::pair<uint64_t, GLuint>	MeshKey;
+
+	std::map<MeshKey, int>			groupIndex;
+	std::vector<std::vector<int>>	groups;
+
+	for (size_t i=0; i<numberOfMeshes; ++i)
+	{
+		const DrawElementsIndirectCommand &command = mCommands[i];
+		const MeshKey key( ((uint64_t) command.firstIndex << 32) | command.count, command.primCount );
+
+		auto iter = groupIndex.find(key);
+		if (iter == end(groupIndex) )
+		{
+			groupIndex.insert( std::make_pair(key, (int) groups.size()) );
+			groups.push_back( std::vector<int>(1, (int) i) );
+		}
+		else
+		{
+			groups[iter->second].push_back( (int) i );
+		}
+	}
+
+	if (groups.size() == numberOfMeshes)
+		return;
+
+	std::vector<int>	order;
+	order.reserve(numberOfMeshes);
+
+	for (auto iter=begin(groups); iter!=end(groups); ++iter)
+		order.insert( end(order), begin(*iter), end(*iter) );
+
+	// the same permutation for all per mesh arrays, base instance is the new mesh index
+	std::vector<DrawElementsIndirectCommand>	commands(numberOfMeshes);
+	std::vector<DrawElementsIndirectCommand>	commandsTransparency(numberOfMeshes);
+	std::vector<vec4>							bsphereCoords(numberOfMeshes);
+	std::vector<vec4>							bshaderInfo(numberOfMeshes);
+	std::vector<MeshGLSL>						meshInfos(numberOfMeshes);
+	std::vector<std::pair<int, int>>			meshClusters( (mMeshClusters.size() == numberOfMeshes) ? numberOfMeshes : 0 );
+	std::vector<std::pair<int, int>>			meshLods( (mMeshLods.size() == numberOfMeshes) ? numberOfMeshes : 0 );
+
+	for (size_t i=0; i<numberOfMeshes; ++i)
+	{
+		const int src = order[i];
+
+		commands[i] = mCommands[src];
+		commands[i].baseInstance = (GLuint) i;
+		commandsTransparency[i] = mCommandsTransparency[src];
+		commandsTransparency[i].baseInstance = (GLuint) i;
+		bsphereCoords[i] = mBSphereCoords[src];
+		bshaderInfo[i] = mBShaderInfo[src];
+		meshInfos[i] = mMeshInfos[src];
+
+		if (meshClusters.size() > 0)
+			meshClusters[i] = mMeshClusters[src];
+		if (meshLods.size() > 0)
+			meshLods[i] = mMeshLods[src];
+	}
+
+	mCommands.swap(commands);
+	mCommandsTransparency.swap(commandsTransparency);
+	mBSphereCoords.swap(bsphereCoords);
+	mBShaderInfo.swap(bshaderInfo);
+	mMeshInfos.swap(meshInfos);
+
+	if (meshClusters.size() > 0)
+		mMeshClusters.swap(meshClusters);
+	if (meshLods.size() > 0)
+		mMeshLods.swap(meshLods);
+
+	mCullingSpheresDirty = true;
+	mHierarchyDirty = true;
+	mTriangleHierarchyDirty = true;
+}
+
+void CGPUModelRenderCached::BuildInstancedCommands()
+{
+	auto fn_build = [] (const std::vector<DrawElementsIndirectCommand> &commands, std::vector<DrawElementsIndirectCommand> &instanced) {
+		
+		instanced.clear();
+
+		for (auto iter=begin(commands); iter!=end(commands); ++iter)
+		{
+			// mesh is drawn from the other list
+			if (iter->primCount == 0)
+				continue;
+
+			if (instanced.size() > 0)
+			{
+				DrawElementsIndirectCommand &last = instanced.back();
+
+				if (last.firstIndex == iter->firstIndex && last.count == iter->count && last.baseVertex == iter->baseVertex
+					&& last.baseInstance + last.primCount == iter->baseInstance)
+				{
+					last.primCount += 1;
+					continue;
+				}
+			}
+			instanced.push_back(*iter);
+		}
+	};
+
+	fn_build( mCommands, mInstancedCommands );
+	fn_build( mCommandsTransparency, mInstancedCommandsTransparency );
+}
+
+const DrawElementsIndirectCommand *CGPUModelRenderCached::RebaseCommands(const std::vector<DrawElementsIndirectCommand> &commands)
+{
+	const GLuint baseVertex = mVertexData->GetBaseVertex();
+	const GLuint firstIndex = mVertexData->GetFirstIndex();
+
+	if (baseVertex == 0 && firstIndex == 0)
+		return commands.data();
+
+	mRebasedCommands.resize( commands.size() );
+
+	for (size_t i=0; i<commands.size(); ++i)
+	{
+		DrawElementsIndirectCommand &command = mRebasedCommands[i];
+		command = commands[i];
+		command.firstIndex += firstIndex;
+		command.baseVertex += baseVertex;
+	}
+
+	return mRebasedCommands.data();
+}
+
 void CGPUModelRenderCached::PrepareBufferIndirect()
 {
+	mUploadedBaseVertex = mVertexData->GetBaseVertex();
+	mUploadedFirstIndex = mVertexData->GetFirstIndex();
+
 	if (mBindlessCommands.size() > 0)
 	{
 		if (mBufferIndirectBindless == 0)
@@ -277,7 +479,7 @@ void CGPUModelRenderCached::PrepareBufferIndirect()
 				glGenBuffers(1, &mBufferIndirect);
 		
 			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBufferIndirect );
-			glBufferData( GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * mCommands.size(), mCommands.data(), GL_STREAM_DRAW );
+			glBufferData( GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * mCommands.size(), RebaseCommands(mCommands), GL_STREAM_DRAW );
 			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
 		}
 		if (mCommandsTransparency.size() > 0)
@@ -286,7 +488,29 @@ void CGPUModelRenderCached::PrepareBufferIndirect()
 				glGenBuffers(1, &mBufferIndirectTransparency);
 		
 			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBufferIndirectTransparency );
-			glBufferData( GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * mCommandsTransparency.size(), mCommandsTransparency.data(), GL_STREAM_DRAW );
+			glBufferData( GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * mCommandsTransparency.size(), RebaseCommands(mCommandsTransparency), GL_STREAM_DRAW );
+			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+		}
+
+		// instanced commands are not written by the culling, so they are static
+		BuildInstancedCommands();
+
+		if (mInstancedCommands.size() > 0)
+		{
+			if (mBufferIndirectInstanced == 0)
+				glGenBuffers(1, &mBufferIndirectInstanced);
+		
+			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBufferIndirectInstanced );
+			glBufferData( GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * mInstancedCommands.size(), RebaseCommands(mInstancedCommands), GL_STATIC_DRAW );
+			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+		}
+		if (mInstancedCommandsTransparency.size() > 0)
+		{
+			if (mBufferIndirectInstancedTransparency == 0)
+				glGenBuffers(1, &mBufferIndirectInstancedTransparency);
+		
+			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBufferIndirectInstancedTransparency );
+			glBufferData( GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * mInstancedCommandsTransparency.size(), RebaseCommands(mInstancedCommandsTransparency), GL_STATIC_DRAW );
 			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
 		}
 	}
@@ -340,12 +564,44 @@ void CGPUModelRenderCached::PrepareBufferInfosSSBO()
 
 void CGPUModelRenderCached::UpdatePerModelGPUBuffer()
 {
-	mBufferPerModel.UpdateData( sizeof(ModelGLSL), mModelInfos.size(), mModelInfos.data() );
+	if (mCompactModelLayout)
+		mBufferPerModel.UpdateData( sizeof(ModelCompactGLSL), mCompactModelInfos.size(), mCompactModelInfos.data() );
+	else
+		mBufferPerModel.UpdateData( sizeof(ModelGLSL), mModelInfos.size(), mModelInfos.data() );
+	mModelRanges.Clear();
 }
 
 void CGPUModelRenderCached::UpdatePerMeshGPUBuffer()
 {
 	mBufferPerMesh.UpdateData( sizeof(MeshGLSL), mMeshInfos.size(), mMeshInfos.data() );
+	mMeshRanges.Clear();
+}
+
+void CGPUModelRenderCached::UpdatePerModelGPURanges()
+{
+	if (mModelRanges.IsEmpty() )
+		return;
+
+	const int numberOfRanges = mModelRanges.Coalesce( (int) mModelInfos.size() );
+
+	if (mCompactModelLayout)
+		mBufferPerModel.UpdateRanges( sizeof(ModelCompactGLSL), mCompactModelInfos.size(), mCompactModelInfos.data(), 
+			mModelRanges.GetRanges(), numberOfRanges );
+	else
+		mBufferPerModel.UpdateRanges( sizeof(ModelGLSL), mModelInfos.size(), mModelInfos.data(), 
+			mModelRanges.GetRanges(), numberOfRanges );
+	
+	mModelRanges.Clear();
+}
+
+void CGPUModelRenderCached::UpdatePerMeshGPURanges()
+{
+	if (mMeshRanges.IsEmpty() )
+		return;
+
+	const int numberOfRanges = mMeshRanges.Coalesce( (int) mMeshInfos.size() );
+	mBufferPerMesh.UpdateRanges( sizeof(MeshGLSL), mMeshInfos.size(), mMeshInfos.data(), mMeshRanges.GetRanges(), numberOfRanges );
+	mMeshRanges.Clear();
 }
 
 void CGPUModelRenderCached::BindBufferInfos(const GLuint location)
@@ -395,10 +651,22 @@ void CGPUModelRenderCached::PrepRender()
 	}
 	PrepareBufferIndirect();
 	PrepareBufferBSphere();
+
+	mCullingSpheresDirty = true;
+	mHierarchyDirty = true;
+	mTriangleHierarchyDirty = true;
 }
 
 void CGPUModelRenderCached::RenderCulling()
 {
+	if (mBSphereMoved && mBufferBSphere > 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, mBufferBSphere);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vec4)*mBSphereCoords.size(), mBSphereCoords.data() );
+		glBindBuffer(GL_ARRAY_BUFFER, 0 );
+		mBSphereMoved = false;
+	}
+
 	if (mBSphereCoords.size() > 0)
 	{
 
@@ -409,6 +677,7 @@ void CGPUModelRenderCached::RenderCulling()
 
 		// bind indirect buffer to write data to
 		BindBufferIndirectToWrite();
+		mCommandsCulled = true;
 
 		//checkGlError( "bind buffers" );
 
@@ -445,7 +714,7 @@ void CGPUModelRenderCached::RenderNormals()
 		mVertexData->Bind();
 		CGPUVertexData::renderPrep();
 
-		glDrawArrays( GL_POINTS, 0, numberOfVertices );
+		glDrawArrays( GL_POINTS, (GLint) mVertexData->GetBaseVertex(), numberOfVertices );
 
 		mVertexData->UnBind();
 		CGPUVertexData::renderFinish();
@@ -457,6 +726,10 @@ void CGPUModelRenderCached::RenderSelection(const int index)
 	const int numberOfVertices = mVertexData->GetNumberOfVertices();
 	if (numberOfVertices > 0)
 	{
+		// offset of the element buffer is in bytes
+		const GLuint baseVertex = mVertexData->GetBaseVertex();
+		const GLuint firstIndex = mVertexData->GetFirstIndex();
+
 		if (index <= 0)
 		{
 			for (size_t i=0; i<mCommands.size(); ++i)
@@ -464,13 +737,15 @@ void CGPUModelRenderCached::RenderSelection(const int index)
 				glLoadName(i+1);
 
 				DrawElementsIndirectCommand	&command = mCommands[i];
-				glDrawElements( GL_TRIANGLES, command.count, GL_UNSIGNED_INT, (GLvoid*) command.firstIndex ); 
+				glDrawElementsBaseVertex( GL_TRIANGLES, command.count, GL_UNSIGNED_INT, 
+					(GLvoid*) (sizeof(GLuint) * (firstIndex + command.firstIndex) ), (GLint) (baseVertex + command.baseVertex) ); 
 			}
 		}
 		else
 		{
 			DrawElementsIndirectCommand	&command = mCommands[index-1];
-			glDrawElements( GL_TRIANGLES, command.count, GL_UNSIGNED_INT, (GLvoid*) command.firstIndex ); 
+			glDrawElementsBaseVertex( GL_TRIANGLES, command.count, GL_UNSIGNED_INT, 
+				(GLvoid*) (sizeof(GLuint) * (firstIndex + command.firstIndex) ), (GLint) (baseVertex + command.baseVertex) ); 
 		}
 	}
 }
@@ -559,33 +834,71 @@ void CGPUModelRenderCached::UpdateReceiveShadows(const int flag)
 	UpdatePerMeshGPUBuffer();
 }
 
+void CGPUModelRenderCached::UpdateColorId(const int mesh, const vec3 &colorId)
+{
+	if (mesh < 0 || mesh >= (int) mMeshInfos.size() )
+		return;
+
+	mMeshInfos[mesh].color = vec4(colorId.x, colorId.y, colorId.z, 1.0f);
+	mMeshRanges.Add(mesh);
+}
+
+void CGPUModelRenderCached::UpdateReceiveShadows(const int mesh, const int flag)
+{
+	if (mesh < 0 || mesh >= (int) mMeshInfos.size() )
+		return;
+
+	mMeshInfos[mesh].lightmap = flag;
+	mMeshRanges.Add(mesh);
+}
 
 void CGPUModelRenderCached::UpdateGPUBuffer(const mat4 *m4_parent, const mat4 *modelview)
 {
-	// update per mesh uniforms
-	const bool updateEachFrame = true;
+	UpdatePerMeshGPURanges();
 
-	const size_t numberOfModels = mModelInfos.size();
-	// numberOfModels != mBufferPerModel.GetCount() 
-	if (updateEachFrame && m4_parent != nullptr && modelview != nullptr)
+	const int numberOfModels = (int) mModelInfos.size();
+	
+	if (numberOfModels == 0 || m4_parent == nullptr || modelview == nullptr)
+		return;
+
+	// models are added by the loader, records are computed again for a new set
+	if (mNormalMatrices.GetNumberOfModels() != numberOfModels)
+		mNormalMatrices.SetNumberOfModels(numberOfModels);
+
+	if (mCompactModelLayout && (int) mCompactModelInfos.size() != numberOfModels)
 	{
-		mat4 m4_World, inv;
-		ModelGLSL *pData = mModelInfos.data();
+		mCompactModelInfos.resize(numberOfModels);
+		mNormalMatrices.SetAllDirty();
+	}
 
-		for (size_t i=0; i<numberOfModels; ++i, ++pData)
-		{
-			m4_World = pData->transform;
-
-			pData->normalMatrix = (*m4_parent) * m4_World;
-			pData->normalMatrix = (*modelview) * pData->normalMatrix;
-			//data.transform = m4_World;
-			pData->normalMatrix.set_translation( vec3(0.0f, 0.0f, 0.0f) );
-			invert(inv, pData->normalMatrix);
-			pData->normalMatrix = transpose(inv);
-		}
-		
-		UpdatePerModelGPUBuffer();
+	const mat4 view = (*modelview) * (*m4_parent);
+	int numberOfUpdated = 0;
+
+	if (mCompactModelLayout)
+	{
+		numberOfUpdated = mNormalMatrices.Update( view, mModelInfos[0].transform.mat_array, sizeof(ModelGLSL),
+			(float*) mCompactModelInfos.data(), sizeof(ModelCompactGLSL), eNormalMatricesLayout3x4, &mModelRanges );
+	}
+	else
+	{
+		numberOfUpdated = mNormalMatrices.Update( view, mModelInfos[0].transform.mat_array, sizeof(ModelGLSL),
+			mModelInfos[0].normalMatrix.mat_array, sizeof(ModelGLSL), eNormalMatricesLayout4x4, &mModelRanges );
 	}
+
+	if (numberOfUpdated > 0)
+		UpdatePerModelGPURanges();
+}
+
+void CGPUModelRenderCached::SetCompactModelLayout(const bool compact)
+{
+	if (mCompactModelLayout == compact)
+		return;
+
+	mCompactModelLayout = compact;
+	
+	if (false == compact)
+		mCompactModelInfos.clear();
+	mNormalMatrices.SetAllDirty();
 }
 
 bool CGPUModelRenderCached::RenderBegin()
@@ -602,6 +915,18 @@ bool CGPUModelRenderCached::RenderBegin()
 	*/
 	
 	
+	// the heap range is moved (defragmentation), commands have to point to the new place
+	if (mVertexData->GetBaseVertex() != mUploadedBaseVertex || mVertexData->GetFirstIndex() != mUploadedFirstIndex)
+	{
+		PrepareBufferIndirect();
+
+		if (mCommandsCulledCPU)
+		{
+			UploadCulledCommands( mBufferIndirectCulled, mCulledCommands );
+			UploadCulledCommands( mBufferIndirectCulledTransparency, mCulledCommandsTransparency );
+		}
+	}
+
 	mVertexData->Bind();		// <<== ERROR HERE ??!!
 	CGPUVertexData::renderPrep();
 	
@@ -627,6 +952,21 @@ void CGPUModelRenderCached::RenderOpaque()
 		glMultiDrawElementsIndirectBindlessNV( GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*) 0, (GLsizei) mBindlessCommands.size(), 0, 1 );
 	}
 	else
+	if (mCommandsCulledCPU)
+	{
+		if (mCulledCommands.size() > 0)
+		{
+			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBufferIndirectCulled );
+			glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*) 0, (GLsizei) mCulledCommands.size(), 0 );
+		}
+	}
+	else
+	if (false == mCommandsCulled && mInstancedCommands.size() > 0)
+	{
+		glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBufferIndirectInstanced );
+		glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*) 0, (GLsizei) mInstancedCommands.size(), 0 );
+	}
+	else
 	if (mCommands.size() > 0)
 	{
 		//
@@ -660,6 +1000,21 @@ void CGPUModelRenderCached::RenderTransparency()
 	//const GLuint perMeshLocation = 5;
 	//const GLuint perModelLocation = 6;
 	
+	if (mCommandsCulledCPU)
+	{
+		if (mCulledCommandsTransparency.size() > 0)
+		{
+			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBufferIndirectCulledTransparency );
+			glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*) 0, (GLsizei) mCulledCommandsTransparency.size(), 0 );
+		}
+	}
+	else
+	if (false == mCommandsCulled && mInstancedCommandsTransparency.size() > 0)
+	{
+		glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mBufferIndirectInstancedTransparency );
+		glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*) 0, (GLsizei) mInstancedCommandsTransparency.size(), 0 );
+	}
+	else
 	if (mCommandsTransparency.size() > 0)
 	{
 		//
@@ -674,32 +1029,499 @@ void CGPUModelRenderCached::RenderEnd()
 {
 	mVertexData->UnBind();
 	CGPUVertexData::renderFinish();
+
+	ResetCulling();
+}
+
+bool CGPUModelRenderCached::FillBatchItem(GeometryBatchItem &item) const
+{
+	if (false == mVertexData->IsInGeometryHeap() || mCommandsCulled || mBindlessCommands.size() > 0 || mCompactModelLayout)
+		return false;
+
+	item.range = mVertexData->GetHeapRange();
+
+	// the same choice as RenderOpaque and RenderTransparency
+	if (mCommandsCulledCPU)
+	{
+		item.commands = mCulledCommands.data();
+		item.numberOfCommands = (int) mCulledCommands.size();
+		item.commandsTransparency = mCulledCommandsTransparency.data();
+		item.numberOfCommandsTransparency = (int) mCulledCommandsTransparency.size();
+	}
+	else
+	{
+		const std::vector<DrawElementsIndirectCommand> &commands = (mInstancedCommands.size() > 0) ? mInstancedCommands : mCommands;
+		const std::vector<DrawElementsIndirectCommand> &commandsTransparency = (mInstancedCommandsTransparency.size() > 0) 
+			? mInstancedCommandsTransparency : mCommandsTransparency;
+
+		item.commands = commands.data();
+		item.numberOfCommands = (int) commands.size();
+		item.commandsTransparency = commandsTransparency.data();
+		item.numberOfCommandsTransparency = (int) commandsTransparency.size();
+	}
+
+	item.meshes = mMeshInfos.data();
+	item.numberOfMeshes = (int) mMeshInfos.size();
+	item.models = mModelInfos.data();
+	item.numberOfModels = (int) mModelInfos.size();
+
+	return true;
 }
 
 const float CGPUModelRenderCached::CalculateFarDistance(const CFrustum &frustum, const vec3 &eyePos)
 {
+	if (mCullingSpheresDirty || mCulling.GetNumberOfSpheres() != (int) mBSphereCoords.size() )
+	{
+		mCulling.SetSpheres( mBSphereCoords.data(), (int) mBSphereCoords.size() );
+		mCullingSpheresDirty = false;
+	}
+
+	float realFarDistance = 0.0f;
+	mCulling.Cull( frustum, eyePos, nullptr, realFarDistance );
+
+	return std::max( 1000.0f, realFarDistance );
+}
+
+// collect commands of the visible meshes, every chunk has an own storage, so workers don't share anything
+class CCulledMeshesOutput : public CFrustumCullingOutput
+{
+public:
 
-	float realFarDistance = 1000.0f;
+	CCulledMeshesOutput(const DrawElementsIndirectCommand *commands, const DrawElementsIndirectCommand *commandsTransparency,
+		std::vector<std::vector<DrawElementsIndirectCommand>> &chunkCommands, 
+		std::vector<std::vector<DrawElementsIndirectCommand>> &chunkCommandsTransparency)
+		: mCommands(commands)
+		, mCommandsTransparency(commandsTransparency)
+		, mChunkCommands(chunkCommands)
+		, mChunkCommandsTransparency(chunkCommandsTransparency)
+	{}
 
-	for (size_t i=0; i<mBSphereCoords.size(); ++i)
+	virtual void OnVisibleChunk(const int chunk, const unsigned int *visible, const int count) override
 	{
-		vec4 bsphere = mBSphereCoords[i];
-		vec3 pos(bsphere.x, bsphere.y, bsphere.z);
-		const float radius = bsphere.w;
+		std::vector<DrawElementsIndirectCommand> &dst = mChunkCommands[chunk];
+		std::vector<DrawElementsIndirectCommand> &dstTransparency = mChunkCommandsTransparency[chunk];
 
-		bool IsVisible = frustum.SphereInFrustum( pos.x, pos.y, pos.z, radius );
+		dst.clear();
+		dstTransparency.clear();
 
-		if (IsVisible)
+		// a mesh is in one of the lists, another one has a zero primCount
+		for (int i=0; i<count; ++i)
 		{
-			vec3 dir = pos - eyePos;
-			float len = radius + sqrt(dir.x*dir.x + dir.y*dir.y + dir.z*dir.z);
+			const unsigned int index = visible[i];
 
-			if (len > realFarDistance)
-				realFarDistance = len;
+			if (mCommands[index].primCount > 0)
+				dst.push_back( mCommands[index] );
+			if (mCommandsTransparency[index].primCount > 0)
+				dstTransparency.push_back( mCommandsTransparency[index] );
 		}
 	}
 
-	return realFarDistance;
+protected:
+	const DrawElementsIndirectCommand		*mCommands;
+	const DrawElementsIndirectCommand		*mCommandsTransparency;
+
+	std::vector<std::vector<DrawElementsIndirectCommand>>	&mChunkCommands;
+	std::vector<std::vector<DrawElementsIndirectCommand>>	&mChunkCommandsTransparency;
+};
+
+int CGPUModelRenderCached::CullMeshes(const CFrustum &frustum, const vec3 &eyePos, float *farDistance)
+{
+	const size_t numberOfMeshes = mBSphereCoords.size();
+
+	mCulledCommands.clear();
+	mCulledCommandsTransparency.clear();
+
+	if (numberOfMeshes == 0 || mCommands.size() != numberOfMeshes || mCommandsTransparency.size() != numberOfMeshes)
+		return 0;
+
+	if (mCullingSpheresDirty || mCulling.GetNumberOfSpheres() != (int) numberOfMeshes)
+	{
+		mCulling.SetSpheres( mBSphereCoords.data(), (int) numberOfMeshes );
+		mCullingSpheresDirty = false;
+	}
+
+	const int numberOfChunks = mCulling.GetNumberOfChunks();
+	if ( (int) mChunkCommands.size() < numberOfChunks)
+	{
+		mChunkCommands.resize(numberOfChunks);
+		mChunkCommandsTransparency.resize(numberOfChunks);
+	}
+
+	CCulledMeshesOutput	output( mCommands.data(), mCommandsTransparency.data(), mChunkCommands, mChunkCommandsTransparency );
+
+	float realFarDistance = 0.0f;
+	const int numberOfVisible = mCulling.Cull( frustum, eyePos, &output, realFarDistance );
+
+	if (farDistance)
+		*farDistance = realFarDistance;
+
+	// chunks go in the order of meshes, so the lists are the same as a serial pass
+	for (int i=0; i<numberOfChunks; ++i)
+	{
+		mCulledCommands.insert( end(mCulledCommands), begin(mChunkCommands[i]), end(mChunkCommands[i]) );
+		mCulledCommandsTransparency.insert( end(mCulledCommandsTransparency), begin(mChunkCommandsTransparency[i]), end(mChunkCommandsTransparency[i]) );
+	}
+
+	UploadCulledCommands( mBufferIndirectCulled, mCulledCommands );
+	UploadCulledCommands( mBufferIndirectCulledTransparency, mCulledCommandsTransparency );
+
+	mCommandsCulledCPU = true;
+	return numberOfVisible;
+}
+
+void CGPUModelRenderCached::UploadCulledCommands(GLuint &buffer, const std::vector<DrawElementsIndirectCommand> &commands)
+{
+	if (commands.size() == 0)
+		return;
+
+	if (buffer == 0)
+		glGenBuffers(1, &buffer);
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, buffer );
+	glBufferData( GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * commands.size(), RebaseCommands(commands), GL_STREAM_DRAW );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+}
+
+int CGPUModelRenderCached::CullClusters(const CFrustum &frustum, const vec3 &eyePos, std::vector<DrawElementsIndirectCommand> &commands, 
+		std::vector<DrawElementsIndirectCommand> &commandsTransparency)
+{
+	const size_t numberOfMeshes = mMeshInfos.size();
+
+	if (mCommands.size() != numberOfMeshes || mBSphereCoords.size() != numberOfMeshes)
+		return 0;
+
+	const bool hasClusters = (mMeshClusters.size() == numberOfMeshes);
+	const bool hasLods = (mMeshLods.size() == numberOfMeshes);
+	int numberOfVisible = 0;
+
+	std::vector<MeshClusterRange>	ranges;
+
+	for (size_t i=0; i<numberOfMeshes; ++i)
+	{
+		const DrawElementsIndirectCommand &meshCommand = mCommands[i];
+		std::vector<DrawElementsIndirectCommand> &dst = (meshCommand.primCount > 0) ? commands : commandsTransparency;
+
+		std::pair<int, int> meshClusters = (hasClusters) ? mMeshClusters[i] : std::make_pair(0, 0);
+
+		// clusters are built for the source level only
+		if (hasLods && mMeshLods[i].second > 0 && mLodRanges[mMeshLods[i].first].first != meshCommand.firstIndex)
+			meshClusters.second = 0;
+
+		if (meshClusters.second == 0)
+		{
+			const vec4 &bsphere = mBSphereCoords[i];
+			if (frustum.SphereInFrustum( bsphere.x, bsphere.y, bsphere.z, bsphere.w ) )
+			{
+				DrawElementsIndirectCommand command = meshCommand;
+				command.primCount = 1;
+				dst.push_back(command);
+			}
+			continue;
+		}
+
+		ranges.clear();
+		numberOfVisible += CullMeshClusters( mClusters.data() + meshClusters.first, meshClusters.second, 0, 
+			mModelInfos[mMeshInfos[i].model].transform, frustum, eyePos, ranges );
+
+		for (auto iter=begin(ranges); iter!=end(ranges); ++iter)
+		{
+			DrawElementsIndirectCommand command = meshCommand;
+			command.count = iter->count;
+			command.firstIndex = iter->firstIndex;
+			command.primCount = 1;
+			dst.push_back(command);
+		}
+	}
+
+	return numberOfVisible;
+}
+
+int CGPUModelRenderCached::SelectLods(const CCameraInfoCache &cameraInfo, const float pixelError, const float hysteresis)
+{
+	const size_t numberOfMeshes = mMeshInfos.size();
+
+	if (mModelLods.size() != mModelInfos.size() || mMeshLods.size() != numberOfMeshes 
+		|| mCommands.size() != numberOfMeshes || mCommandsTransparency.size() != numberOfMeshes)
+		return 0;
+
+	const vec3 eyePos( cameraInfo.pos.x, cameraInfo.pos.y, cameraInfo.pos.z );
+	const float projScaleY = cameraInfo.p4.mat_array[5];
+	int numberOfChanged = 0;
+
+	for (size_t i=0; i<mModelLods.size(); ++i)
+	{
+		ModelLodInfo &info = mModelLods[i];
+		if (info.numberOfLods <= 1)
+			continue;
+
+		// errors are in the model units, distance is to the sphere surface
+		const float *m = mModelInfos[i].transform.mat_array;
+
+		const float sx = sqrtf(m[0]*m[0] + m[1]*m[1] + m[2]*m[2]);
+		const float sy = sqrtf(m[4]*m[4] + m[5]*m[5] + m[6]*m[6]);
+		const float sz = sqrtf(m[8]*m[8] + m[9]*m[9] + m[10]*m[10]);
+		const float scale = std::max(sx, std::max(sy, sz));
+
+		const vec3 dir( info.bsphere.x - eyePos.x, info.bsphere.y - eyePos.y, info.bsphere.z - eyePos.z );
+		const float distance = sqrtf(dir.x*dir.x + dir.y*dir.y + dir.z*dir.z) - info.bsphere.w;
+
+		const float pixelsPerUnit = scale * ComputePixelsPerUnit( distance, projScaleY, (float) cameraInfo.height );
+		const int lod = SelectMeshLod( info.errors, info.numberOfLods, pixelsPerUnit, pixelError, hysteresis, info.currentLod );
+
+		if (lod != info.currentLod)
+		{
+			info.currentLod = lod;
+			numberOfChanged += 1;
+		}
+	}
+
+	if (numberOfChanged == 0)
+		return 0;
+
+	for (size_t i=0; i<numberOfMeshes; ++i)
+	{
+		const std::pair<int, int> &meshLods = mMeshLods[i];
+		if (meshLods.second == 0)
+			continue;
+
+		const int lod = std::min( mModelLods[mMeshInfos[i].model].currentLod, meshLods.second - 1 );
+		const std::pair<GLuint, GLuint> &range = mLodRanges[meshLods.first + lod];
+
+		mCommands[i].firstIndex = range.first;
+		mCommands[i].count = range.second;
+		mCommandsTransparency[i].firstIndex = range.first;
+		mCommandsTransparency[i].count = range.second;
+	}
+
+	PrepareBufferIndirect();
+	mTriangleHierarchyDirty = true;
+	return numberOfChanged;
+}
+
+void CGPUModelRenderCached::BuildHierarchy()
+{
+	const int numberOfModels = (int) mModelInfos.size();
+	const int numberOfMeshes = (int) mMeshInfos.size();
+
+	// meshes of each model, the order could be changed by GroupInstancedMeshes
+	mModelMeshesFirst.assign( numberOfModels + 1, 0 );
+	mModelMeshes.resize( numberOfMeshes );
+
+	for (int i=0; i<numberOfMeshes; ++i)
+		mModelMeshesFirst[mMeshInfos[i].model + 1] += 1;
+	for (int i=0; i<numberOfModels; ++i)
+		mModelMeshesFirst[i + 1] += mModelMeshesFirst[i];
+
+	std::vector<int> offsets( mModelMeshesFirst.begin(), mModelMeshesFirst.end() - 1 );
+	for (int i=0; i<numberOfMeshes; ++i)
+		mModelMeshes[offsets[mMeshInfos[i].model]++] = i;
+
+	mHierarchy.Build( mBSphereCoords.data(), (int) mBSphereCoords.size() );
+	mHierarchyDirty = false;
+	mHierarchyMovedItems = 0;
+}
+
+const CBoundingVolumeHierarchy &CGPUModelRenderCached::UpdateHierarchy()
+{
+	if (mHierarchyDirty || mHierarchy.GetNumberOfItems() != (int) mBSphereCoords.size() )
+	{
+		BuildHierarchy();
+	}
+	else if (mHierarchy.IsRefitNeeded() )
+	{
+		mHierarchy.Refit();
+
+		// the cost is computed over all nodes, so it's checked after a noticeable part of the meshes is moved
+		if (mHierarchyMovedItems > mHierarchy.GetNumberOfItems() / 8)
+		{
+			if (mHierarchy.ComputeCost() > 2.0f * mHierarchy.GetBuildCost() )
+				BuildHierarchy();
+			else
+				mHierarchyMovedItems = 0;
+		}
+	}
+
+	return mHierarchy;
+}
+
+int CGPUModelRenderCached::PickMesh(const vec3 &origin, const vec3 &dir, float &distance)
+{
+	return UpdateHierarchy().IntersectRay( origin, dir, FLT_MAX, distance );
+}
+
+void CGPUModelRenderCached::SetModelTransform(const int index, const mat4 &transform)
+{
+	if (index < 0 || index >= (int) mModelInfos.size() )
+		return;
+
+	if (mHierarchyDirty || (int) mModelMeshesFirst.size() != (int) mModelInfos.size() + 1)
+		BuildHierarchy();
+
+	// spheres are moved by the difference between the previous and the new transform
+	mat4 inv, delta;
+	invert( inv, mModelInfos[index].transform );
+	delta = transform * inv;
+
+	const float *m = delta.mat_array;
+
+	const float sx = sqrtf(m[0]*m[0] + m[1]*m[1] + m[2]*m[2]);
+	const float sy = sqrtf(m[4]*m[4] + m[5]*m[5] + m[6]*m[6]);
+	const float sz = sqrtf(m[8]*m[8] + m[9]*m[9] + m[10]*m[10]);
+	const float scale = std::max(sx, std::max(sy, sz));
+
+	auto fn_move = [m, scale] (const vec4 &sphere) -> vec4 {
+		return vec4( m[0]*sphere.x + m[4]*sphere.y + m[8]*sphere.z + m[12],
+			m[1]*sphere.x + m[5]*sphere.y + m[9]*sphere.z + m[13],
+			m[2]*sphere.x + m[6]*sphere.y + m[10]*sphere.z + m[14],
+			sphere.w * scale );
+	};
+
+	for (int i=mModelMeshesFirst[index]; i<mModelMeshesFirst[index+1]; ++i)
+	{
+		const int mesh = mModelMeshes[i];
+
+		mBSphereCoords[mesh] = fn_move( mBSphereCoords[mesh] );
+		mHierarchy.UpdateItem( mesh, mBSphereCoords[mesh] );
+		mHierarchyMovedItems += 1;
+	}
+
+	if (index < (int) mModelLods.size() )
+		mModelLods[index].bsphere = fn_move( mModelLods[index].bsphere );
+
+	mModelInfos[index].transform = transform;
+	mNormalMatrices.SetModelDirty(index);
+	mCullingSpheresDirty = true;
+	mBSphereMoved = true;
+}
+
+void CGPUModelRenderCached::FreeTriangleHierarchies()
+{
+	for (auto iter=begin(mTriangleHierarchies); iter!=end(mTriangleHierarchies); ++iter)
+		delete *iter;
+
+	mTriangleHierarchies.clear();
+	mRangeTriangleHierarchy.clear();
+	mMeshTriangleHierarchy.clear();
+	mTriangleHierarchyDirty = true;
+}
+
+bool CGPUModelRenderCached::BuildPickingHierarchy(const int numberOfThreads)
+{
+	const int numberOfMeshes = (int) mCommands.size();
+
+	const float *positions = mVertexData->MapPositionBuffer();
+	const unsigned int *indices = mVertexData->MapIndexBuffer();
+
+	if (positions == nullptr || indices == nullptr)
+	{
+		mVertexData->UnMapPositionBuffer();
+		mVertexData->UnMapIndexBuffer();
+		return false;
+	}
+
+	// only new index ranges are built, the lod switch keeps the hierarchies of other levels
+	std::vector<TriangleMeshSource>		sources;
+	std::vector<CTriangleHierarchy*>	added;
+
+	mMeshTriangleHierarchy.resize(numberOfMeshes);
+
+	for (int i=0; i<numberOfMeshes; ++i)
+	{
+		const DrawElementsIndirectCommand &command = mCommands[i];
+		const uint64_t key = ((uint64_t) command.firstIndex << 32) | command.count;
+
+		auto iter = mRangeTriangleHierarchy.find(key);
+		if (iter != end(mRangeTriangleHierarchy) )
+		{
+			mMeshTriangleHierarchy[i] = iter->second;
+			continue;
+		}
+
+		const int index = (int) mTriangleHierarchies.size();
+		mTriangleHierarchies.push_back( new CTriangleHierarchy() );
+		mRangeTriangleHierarchy.insert( std::make_pair(key, index) );
+		mMeshTriangleHierarchy[i] = index;
+
+		TriangleMeshSource source;
+		TriangleMeshSource::Set( positions, sizeof(vec4), indices, (int) command.firstIndex, (int) command.count, source );
+
+		sources.push_back(source);
+		added.push_back(mTriangleHierarchies.back() );
+	}
+
+	if (sources.size() > 0)
+		BuildTriangleHierarchies( sources.data(), added.data(), (int) sources.size(), numberOfThreads );
+
+	mVertexData->UnMapPositionBuffer();
+	mVertexData->UnMapIndexBuffer();
+
+	mTriangleHierarchyDirty = false;
+	return true;
+}
+
+bool CGPUModelRenderCached::PickTriangle(const vec3 &origin, const vec3 &dir, MeshRayHit &hit)
+{
+	MeshRayHit::Clear(hit);
+
+	if (mTriangleHierarchyDirty || mMeshTriangleHierarchy.size() != mCommands.size() )
+	{
+		if (false == BuildPickingHierarchy() )
+			return false;
+	}
+
+	// candidate meshes in order of their bounding spheres
+	std::vector<int>	meshes;
+	std::vector<float>	distances;
+
+	UpdateHierarchy().QueryRay( origin, dir, FLT_MAX, meshes, &distances );
+
+	std::vector<std::pair<float, int>>	candidates(meshes.size());
+	for (size_t i=0; i<meshes.size(); ++i)
+		candidates[i] = std::make_pair(distances[i], meshes[i]);
+
+	std::sort( begin(candidates), end(candidates) );
+
+	float best = FLT_MAX;
+	mat4 inv;
+
+	for (auto iter=begin(candidates); iter!=end(candidates); ++iter)
+	{
+		if (iter->first > best)
+			break;
+
+		const int mesh = iter->second;
+		const int model = mMeshInfos[mesh].model;
+
+		// triangles are in the model space, the ray is moved there with the same distance units
+		invert( inv, mModelInfos[model].transform );
+		const float *m = inv.mat_array;
+
+		const vec3 localOrigin( m[0]*origin.x + m[4]*origin.y + m[8]*origin.z + m[12],
+			m[1]*origin.x + m[5]*origin.y + m[9]*origin.z + m[13],
+			m[2]*origin.x + m[6]*origin.y + m[10]*origin.z + m[14] );
+		const vec3 localDir( m[0]*dir.x + m[4]*dir.y + m[8]*dir.z,
+			m[1]*dir.x + m[5]*dir.y + m[9]*dir.z,
+			m[2]*dir.x + m[6]*dir.y + m[10]*dir.z );
+
+		TriangleRayHit triangleHit;
+		if (mTriangleHierarchies[mMeshTriangleHierarchy[mesh]]->IntersectRay( localOrigin, localDir, best, triangleHit ) )
+		{
+			best = triangleHit.distance;
+
+			hit.model = model;
+			hit.mesh = mesh;
+			hit.triangle = triangleHit.triangle;
+			hit.u = triangleHit.u;
+			hit.v = triangleHit.v;
+			hit.distance = triangleHit.distance;
+		}
+	}
+
+	if (hit.mesh < 0)
+		return false;
+
+	hit.point = vec3( origin.x + dir.x * hit.distance, origin.y + dir.y * hit.distance, origin.z + dir.z * hit.distance );
+	return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -723,6 +1545,9 @@ CGPUVertexData::CGPUVertexData()
 
 	for (int i=0; i<VERTEX_BUFFER_MAX; ++i)
 		mBuffersOffsets[i] = nullptr;
+
+	mGeometryHeap = nullptr;
+	GeometryHeapRange::Clear(mHeapRange);
 }
 
 CGPUVertexData::~CGPUVertexData()
@@ -738,6 +1563,34 @@ CGPUVertexData::~CGPUVertexData()
 	{
 		glDeleteBuffers( VERTEX_BUFFER_MAX, mBuffersId );
 	}
+
+	if (mGeometryHeap != nullptr)
+	{
+		mGeometryHeap->Release(mHeapRange);
+	}
+}
+
+void CGPUVertexData::SetGeometryHeap(CGeometryHeap *heap)
+{
+	if (heap == mGeometryHeap)
+		return;
+
+	if (mGeometryHeap != nullptr)
+	{
+		mGeometryHeap->Release(mHeapRange);
+	}
+
+	mGeometryHeap = heap;
+}
+
+bool CGPUVertexData::AllocateHeapRange(const int numberOfVertices, const int numberOfIndices)
+{
+	if (GeometryHeapRange::IsValid(mHeapRange) 
+		&& mHeapRange.numberOfVertices == (unsigned int) numberOfVertices && mHeapRange.numberOfIndices == (unsigned int) numberOfIndices)
+		return true;
+
+	mGeometryHeap->Release(mHeapRange);
+	return mGeometryHeap->Allocate( (unsigned int) numberOfVertices, (unsigned int) numberOfIndices, mHeapRange );
 }
 
 void CGPUVertexData::QueryAttributes(const GLuint handle)
@@ -801,125 +1654,210 @@ void UpdateFromTempArrays( const unsigned int vertexCount, const unsigned int in
 }
 
 bool CGPUVertexData::UpdateFromCache( const unsigned char *models_data )
+{
+	if (false == MergeFromCache(models_data) )
+		return false;
+
+	// DONE: gpu work
+	return UploadMergedData(models_data);
+}
+
+bool CGPUVertexData::MergeFromCache( const unsigned char *models_data )
 {
 	if (models_data == nullptr) return false;
 
 	// read global pack header
-	FileGeometryHeader *fileHeader = (FileGeometryHeader*) models_data;
-
-	BYTE *points=nullptr;
-	BYTE *normals=nullptr;
-	BYTE *tangents=nullptr;
-	BYTE *uvs = nullptr;
-	BYTE *indices = nullptr;
+	const FileGeometryHeader *fileHeader = (const FileGeometryHeader*) models_data;
 
 	try
 	{
 		if (fileHeader->numberOfModels == 0 || fileHeader->totalNumberOfIndices == 0 || fileHeader->totalNumberOfVertices == 0)
 			throw "> geometry file is empty\n";
 	
+		// merge straight into the client side arrays, they are kept for ray casting
+		//	tangents and uvs are merged on upload into the mapped gpu buffers
+		mPositions.resize( fileHeader->totalNumberOfVertices );
+		mNormals.resize( fileHeader->totalNumberOfVertices );
+		mIndices.resize( fileHeader->totalNumberOfIndices );
 
-		// check if strides are supported
-		BYTE *ptr = (BYTE*) models_data + sizeof(FileGeometryHeader);
+		VertexMergeTarget	target;
+		VertexMergeTarget::Set( (float*) mPositions.data(), (float*) mNormals.data(), nullptr, nullptr, mIndices.data(), target );
 
-		points = new BYTE[gPointStride * fileHeader->totalNumberOfVertices];
-		if (!points) throw "failed to allocate memory for points\n";	
-		
-		normals = new BYTE[gNormalStride * fileHeader->totalNumberOfVertices];
-		if (!normals) throw "failed to allocate memory for normals\n";
-		
-		tangents = new BYTE[gTangentStride * fileHeader->totalNumberOfVertices];
-		if (!tangents) throw "failed to allocate memory for tangents\n";
-		
-		uvs = new BYTE[gUVStride * fileHeader->totalNumberOfVertices];
-		if (!uvs) throw "failed to allocate memory for uvs\n";
+		if (false == MergeGeometryStreams( models_data, target ) )
+			throw " strides from geom file are not supported!\n";
 
-		indices = new BYTE[gIndexStride * fileHeader->totalNumberOfIndices];
-		if (!indices) throw "failed to allocate memory for indices\n";
-	
-		BYTE *lp = points;
-		BYTE *ln = normals;
-		BYTE *lt = tangents;
-		BYTE *lu = uvs;
-		BYTE *li = indices;
+		mNumberOfVertices = fileHeader->totalNumberOfVertices;
+		mNumberOfIndices = fileHeader->totalNumberOfIndices;
+	}
+	catch( const char *msg )
+	{
+		mPositions.clear();
+		mNormals.clear();
+		mIndices.clear();
 
-		unsigned int accumNumberOfVertices = 0;
+		printf( "ERROR - %s\n", msg );
+		return false;
+	}
 
-		for (int i=0; i<fileHeader->numberOfModels; ++i)
-		{
-			VertexDataHeader	*header = (VertexDataHeader*) ptr;
-		
-			// WTF - different strides ?!
-			if (header->normalStride != gNormalStride || header->pointStride != gPointStride || header->tangentStride != gTangentStride || header->uvStride != gUVStride )
-			{
-				printf (" strides from geom file are not supported!\n" );
-				return false;
-			}
-			// skip zero geometry
-			if (header->numVertices == 0 || header->numIndices == 0)
-			{
-				continue;
-			}
+	return true;
+}
 
-			memcpy( lp, models_data + header->positionOffset, gPointStride * header->numVertices );
-			memcpy( ln, models_data + header->normalOffset, gNormalStride * header->numVertices );
-			memcpy( lt, models_data + header->tangentOffset, gTangentStride * header->numVertices );
-			memcpy( lu, models_data + header->uvOffset, gUVStride * header->numVertices );
+bool CGPUVertexData::TakeMergedData( VertexMergeStaging &staging )
+{
+	if (staging.positions.empty() || staging.positions.size() != staging.normals.size() || staging.indices.empty() )
+		return false;
 
-			memcpy( li, models_data + header->indicesOffset, gIndexStride * header->numIndices );
+	mPositions.swap( staging.positions );
+	mNormals.swap( staging.normals );
+	mIndices.swap( staging.indices );
 
-			// DONE: we need to add some offset to indices elements
-			unsigned int *pIndex = (unsigned int*) li;
-			for (int i=0; i<header->numIndices; ++i)
-			{
-				*pIndex += accumNumberOfVertices;
-				pIndex++;
-			}
+	mNumberOfVertices = (int) mPositions.size();
+	mNumberOfIndices = (int) mIndices.size();
+
+	staging.Clear();
+	return true;
+}
 
-			accumNumberOfVertices += header->numVertices;
+bool CGPUVertexData::UploadMergedData( const unsigned char *models_data )
+{
+	const int numberOfVertices = (int) mPositions.size();
+	const int numberOfIndices = (int) mIndices.size();
 
-			lp += gPointStride * header->numVertices;
-			ln += gNormalStride * header->numVertices;
-			lt += gTangentStride * header->numVertices;
-			lu += gUVStride * header->numVertices;
-			li += gIndexStride * header->numIndices;
+	if (models_data == nullptr || numberOfVertices == 0 || numberOfIndices == 0)
+		return false;
 
-			//
-			ptr = (BYTE*) models_data + header->endOffset;
-		}
+	if (mGeometryHeap != nullptr)
+		return UploadMergedDataToHeap(models_data);
 
-		//
-		// move arrays to gpu !
-	
-		mNumberOfVertices = fileHeader->totalNumberOfVertices;
-		mNumberOfIndices = fileHeader->totalNumberOfIndices;
-		// DONE: gpu work
-		PrepCacheBuffers( fileHeader->totalNumberOfVertices, fileHeader->totalNumberOfIndices, points, normals, tangents, uvs, indices );
+	if (mBuffersId[0] == 0)
+	{
+		glGenBuffers( VERTEX_BUFFER_MAX, mBuffersId );
+		mBuffersAllocated = true;
 	}
-	catch( const char *msg )
+
+	//
+	// move arrays to gpu !
+
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffersId[VERTEX_BUFFER_POINT] );
+	glBufferData(GL_ARRAY_BUFFER, gPointStride * numberOfVertices, mPositions.data(), GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffersId[VERTEX_BUFFER_NORMAL] );
+	glBufferData(GL_ARRAY_BUFFER, gNormalStride * numberOfVertices, mNormals.data(), GL_STATIC_DRAW);
+
+	// tangents and uvs are written once, from the pack into the buffer storage
+	const GLsizeiptr tangentsSize = gTangentStride * numberOfVertices;
+	const GLsizeiptr uvsSize = gUVStride * numberOfVertices;
+
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffersId[VERTEX_BUFFER_TANGENT] );
+	glBufferData(GL_ARRAY_BUFFER, tangentsSize, nullptr, GL_STATIC_DRAW);
+	float *tangents = (float*) glMapBufferRange(GL_ARRAY_BUFFER, 0, tangentsSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffersId[VERTEX_BUFFER_UV] );
+	glBufferData(GL_ARRAY_BUFFER, uvsSize, nullptr, GL_STATIC_DRAW);
+	float *uvs = (float*) glMapBufferRange(GL_ARRAY_BUFFER, 0, uvsSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	bool merged = false;
+
+	if (tangents != nullptr && uvs != nullptr)
 	{
-		//
-		// free
-	
-		SAFE_ARRAY_DELETE (points);
-		SAFE_ARRAY_DELETE (normals);
-		SAFE_ARRAY_DELETE (tangents);
-		SAFE_ARRAY_DELETE (uvs);
-		SAFE_ARRAY_DELETE (indices);
+		VertexMergeTarget	target;
+		VertexMergeTarget::Set( nullptr, nullptr, tangents, uvs, nullptr, target );
 
-		printf( "ERROR - %s\n", msg );
+		merged = MergeGeometryStreams( models_data, target );
+	}
+
+	// unmap could fail when the storage is lost (mode switch), then it's uploaded from the client side
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffersId[VERTEX_BUFFER_UV] );
+	if (uvs != nullptr && GL_FALSE == glUnmapBuffer(GL_ARRAY_BUFFER) )
+		merged = false;
+
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffersId[VERTEX_BUFFER_TANGENT] );
+	if (tangents != nullptr && GL_FALSE == glUnmapBuffer(GL_ARRAY_BUFFER) )
+		merged = false;
+
+	if (false == merged)
+	{
+		mMergedTangents.resize( numberOfVertices );
+		mMergedUVs.resize( numberOfVertices );
+
+		VertexMergeTarget	target;
+		VertexMergeTarget::Set( nullptr, nullptr, (float*) mMergedTangents.data(), (float*) mMergedUVs.data(), nullptr, target );
+
+		if (MergeGeometryStreams( models_data, target ) )
+		{
+			glBufferData(GL_ARRAY_BUFFER, tangentsSize, mMergedTangents.data(), GL_STATIC_DRAW);
+
+			glBindBuffer(GL_ARRAY_BUFFER, mBuffersId[VERTEX_BUFFER_UV] );
+			glBufferData(GL_ARRAY_BUFFER, uvsSize, mMergedUVs.data(), GL_STATIC_DRAW);
+		}
+
+		std::vector<vec4>().swap(mMergedTangents);
+		std::vector<vec2>().swap(mMergedUVs);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mBuffersId[VERTEX_BUFFER_INDEX] );
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, gIndexStride * numberOfIndices, mIndices.data(), GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	CHECK_GL_ERROR();
+
+	return true;
+}
+
+bool CGPUVertexData::UploadMergedDataToHeap( const unsigned char *models_data )
+{
+	const int numberOfVertices = (int) mPositions.size();
+	const int numberOfIndices = (int) mIndices.size();
+
+	if (false == AllocateHeapRange(numberOfVertices, numberOfIndices) )
 		return false;
+
+	mGeometryHeap->Upload( mHeapRange, GEOMETRY_HEAP_STREAM_POINT, mPositions.data() );
+	mGeometryHeap->Upload( mHeapRange, GEOMETRY_HEAP_STREAM_NORMAL, mNormals.data() );
+	mGeometryHeap->Upload( mHeapRange, GEOMETRY_HEAP_STREAM_INDEX, mIndices.data() );
+
+	// the same as own buffers, tangents and uvs are merged into the mapped ranges
+	float *tangents = (float*) mGeometryHeap->Map( mHeapRange, GEOMETRY_HEAP_STREAM_TANGENT );
+	float *uvs = (float*) mGeometryHeap->Map( mHeapRange, GEOMETRY_HEAP_STREAM_UV );
+
+	bool merged = false;
+
+	if (tangents != nullptr && uvs != nullptr)
+	{
+		VertexMergeTarget	target;
+		VertexMergeTarget::Set( nullptr, nullptr, tangents, uvs, nullptr, target );
+
+		merged = MergeGeometryStreams( models_data, target );
 	}
 
-	//
-	// free
-	
-	SAFE_ARRAY_DELETE (points);
-	SAFE_ARRAY_DELETE (normals);
-	SAFE_ARRAY_DELETE (tangents);
-	SAFE_ARRAY_DELETE (uvs);
-	SAFE_ARRAY_DELETE (indices);
-	
+	if (uvs != nullptr && false == mGeometryHeap->UnMap(GEOMETRY_HEAP_STREAM_UV) )
+		merged = false;
+	if (tangents != nullptr && false == mGeometryHeap->UnMap(GEOMETRY_HEAP_STREAM_TANGENT) )
+		merged = false;
+
+	if (false == merged)
+	{
+		mMergedTangents.resize( numberOfVertices );
+		mMergedUVs.resize( numberOfVertices );
+
+		VertexMergeTarget	target;
+		VertexMergeTarget::Set( nullptr, nullptr, (float*) mMergedTangents.data(), (float*) mMergedUVs.data(), nullptr, target );
+
+		if (MergeGeometryStreams( models_data, target ) )
+		{
+			mGeometryHeap->Upload( mHeapRange, GEOMETRY_HEAP_STREAM_TANGENT, mMergedTangents.data() );
+			mGeometryHeap->Upload( mHeapRange, GEOMETRY_HEAP_STREAM_UV, mMergedUVs.data() );
+		}
+
+		std::vector<vec4>().swap(mMergedTangents);
+		std::vector<vec2>().swap(mMergedUVs);
+	}
+
+	CHECK_GL_ERROR();
+
 	return true;
 }
 
@@ -938,6 +1876,21 @@ bool CGPUVertexData::PrepCacheBuffers( const int numberOfVertices, const int num
 	mIndices.resize(numberOfIndices);
 	memcpy( mIndices.data(), indexData, sizeof(unsigned int) * numberOfIndices );
 
+	if (mGeometryHeap != nullptr)
+	{
+		if (false == AllocateHeapRange(numberOfVertices, numberOfIndices) )
+			return false;
+
+		mGeometryHeap->Upload( mHeapRange, GEOMETRY_HEAP_STREAM_POINT, pointData );
+		mGeometryHeap->Upload( mHeapRange, GEOMETRY_HEAP_STREAM_UV, uvData );
+		mGeometryHeap->Upload( mHeapRange, GEOMETRY_HEAP_STREAM_NORMAL, normalData );
+		mGeometryHeap->Upload( mHeapRange, GEOMETRY_HEAP_STREAM_TANGENT, tangentData );
+		mGeometryHeap->Upload( mHeapRange, GEOMETRY_HEAP_STREAM_INDEX, indexData );
+
+		CHECK_GL_ERROR();
+		return true;
+	}
+
 	if (mBuffersId[0] == 0)
 	{
 		glGenBuffers( VERTEX_BUFFER_MAX, mBuffersId );
@@ -973,7 +1926,7 @@ bool CGPUVertexData::PrepCacheBuffers( const int numberOfVertices, const int num
 
 const float *CGPUVertexData::MapPositionBuffer()
 {
-	if (mBuffersId[VERTEX_BUFFER_POINT] == 0)
+	if (false == IsReady() )
 		return nullptr;
 
 	//return (float*) glMapNamedBuffer(mBuffersId[VERTEX_BUFFER_POINT], GL_READ_ONLY);
@@ -987,7 +1940,7 @@ void CGPUVertexData::UnMapPositionBuffer()
 
 const float *CGPUVertexData::MapNormalBuffer()
 {
-	if (mBuffersId[VERTEX_BUFFER_NORMAL] == 0)
+	if (false == IsReady() )
 		return nullptr;
 
 	//return (float*) glMapNamedBuffer(mBuffersId[VERTEX_BUFFER_NORMAL], GL_READ_ONLY);
@@ -1001,7 +1954,7 @@ void CGPUVertexData::UnMapNormalBuffer()
 
 const unsigned int *CGPUVertexData::MapIndexBuffer()
 {
-	if (mBuffersId[VERTEX_BUFFER_INDEX] == 0)
+	if (false == IsReady() )
 		return nullptr;
 
 	//return (unsigned int*) glMapNamedBuffer(mBuffersId[VERTEX_BUFFER_INDEX], GL_READ_ONLY);
@@ -1049,6 +2002,13 @@ void CGPUVertexData::renderFinish()
 // DONE: make bind and unbind functions
 void CGPUVertexData::Bind()
 {
+	// the heap buffers have all ranges, commands select this one
+	if (mGeometryHeap != nullptr)
+	{
+		mGeometryHeap->Bind();
+		return;
+	}
+
 	/*
 	if (mVao > 0)
 	{
@@ -20,10 +20,19 @@
 //
 #include "algorithm\nv_math.h"
 #include "algorithm\math3d.h"
+#include "algorithm\MeshClusters.h"
+#include "algorithm\MeshSimplify.h"
+#include "algorithm\FrustumCulling.h"
+#include "algorithm\BoundingVolumeHierarchy.h"
+#include "algorithm\TriangleHierarchy.h"
+#include "algorithm\NormalMatrices.h"
 
 #include "shared_glsl.h"
 #include "shared_common.h"
 #include "shared_misc.h"
+#include "shared_camera.h"
+#include "shared_geometryHeap.h"
+#include "shared_geometryBatch.h"
 
 #include "shared_textures.h"
 #include "shared_materials.h"
@@ -32,10 +41,12 @@
 #include "graphics\OGL_Utils.h"
 
 #include <vector>
+#include <map>
 
 ////////////////////////////////////////////////////////////////////////////////
 // forward declaration
 class CGPUCacheLoaderVisitorImpl;
+struct VertexMergeStaging;
 
 //////////////////////////////////////////////////////////////////////
 
@@ -106,14 +117,6 @@ public:
 
 ///////////////////////////////////////////
 
-typedef  struct {
-        GLuint  count;
-        GLuint  primCount;
-        GLuint  firstIndex;
-        GLuint  baseVertex;
-        GLuint  baseInstance;
-    } DrawElementsIndirectCommand;
-
 typedef struct {
           GLuint   index;
           GLuint   reserved; 
@@ -131,6 +134,26 @@ typedef struct {
 //////////////////////////////////////////////////////////////////////////
 // render model from cached values (indirect commands)
 //  this models consists of all cached models as sub-models
+// result of the triangle picking
+struct MeshRayHit
+{
+	int			model;
+	int			mesh;
+	int			triangle;		// first index of the triangle in the merged index buffer
+	float		u;				// barycentric weights of the second and the third triangle vertex
+	float		v;
+	float		distance;		// along the ray from the origin
+	vec3		point;
+
+	static void Clear(MeshRayHit &hit)
+	{
+		hit.model = hit.mesh = hit.triangle = -1;
+		hit.u = hit.v = 0.0f;
+		hit.distance = 0.0f;
+		hit.point = vec3(0.0f, 0.0f, 0.0f);
+	}
+};
+
 class CGPUModelRenderCached : public CGPUModelRender
 {
 public:
@@ -144,14 +167,27 @@ public:
 	virtual void Free();
 	virtual void Clear();
 
+	// reorder meshes, so the instances of one index range go one after another and could be drawn
+	//	by one instanced command (baseInstance + gl_InstanceID selects the mesh info), other meshes keep their order
+	void GroupInstancedMeshes();
+
 	void PrepRender();
 
+	// per mesh visibility is written into the indirect buffers, they are used instead of instanced commands until RenderEnd
 	void RenderCulling();
 
 	void RenderNormals();
 
 	void RenderSelection(const int index);	// make a render for the picking (selection) buffer
 
+	// triangle hierarchies of the drawn index ranges (from the client side vertex data), meshes with the same range share one
+	//	numberOfThreads - 0 to use the hardware threads
+	bool BuildPickingHierarchy(const int numberOfThreads=0);
+
+	// cpu alternative of the selection render, the nearest triangle hit by the ray (dir is normalized)
+	//	meshes come from the hierarchy of bounding spheres, missed index ranges are built on the call
+	bool PickTriangle(const vec3 &origin, const vec3 &dir, MeshRayHit &hit);
+
 	void	ReCalculatePerModelInfo(CMaterialsReference *materials, CShadersReference *shaders);
 	void	ReCalculatePerMeshInfo(CMaterialsReference *materials, CShadersReference *shaders);
 
@@ -165,16 +201,90 @@ public:
 	//
 	void		UpdateColorId(const vec3 &colorId);
 	void		UpdateReceiveShadows(const int flag);
+	// change one mesh, changed records are uploaded by the next UpdateGPUBuffer
+	void		UpdateColorId(const int mesh, const vec3 &colorId);
+	void		UpdateReceiveShadows(const int mesh, const int flag);
+	// normal matrices of the moved models are computed (all of them when the view rotation is changed),
+	//	the model buffer is uploaded only when any record is updated
 	void		UpdateGPUBuffer(const mat4 *m4_parent, const mat4 *modelview);
+
+	// upload models as ModelCompactGLSL records (96 bytes instead of 128), shaders have to read the same layout
+	void		SetCompactModelLayout(const bool compact);
+	const bool	IsCompactModelLayout() const
+	{
+		return mCompactModelLayout;
+	}
+	CNormalMatrices &GetNormalMatrices()
+	{
+		return mNormalMatrices;
+	}
 	bool			RenderBegin();
 	void			RenderOpaque();
 	void			RenderTransparency();
 	void			RenderEnd();
+
+	// commands and records of the frame for the merged draw of the heap caches (see CGeometryBatch), the cache
+	//	fills its textures, materials, shaders and matrix, false for the own vertex buffers, the gpu culled or bindless
+	//	commands and the compact model layout, such a cache draws with RenderOpaque and RenderTransparency
+	bool			FillBatchItem(GeometryBatchItem &item) const;
+	// the batch draw ends the frame of the culled commands instead of RenderEnd
+	void			ResetCulling()
+	{
+		mCommandsCulled = false;
+		mCommandsCulledCPU = false;
+	}
 	
 	//
 
 	const float CalculateFarDistance(const CFrustum &frustum, const vec3 &eyePos);
 
+	// cpu alternative of RenderCulling (for non nvidia cards), compacted lists of the visible meshes are uploaded into
+	//	separate indirect buffers and used until RenderEnd, returns the number of visible meshes
+	//	farDistance - optional, the farthest point of the visible meshes from the eye
+	int CullMeshes(const CFrustum &frustum, const vec3 &eyePos, float *farDistance=nullptr);
+
+	// result of the last CullMeshes, a reference to validate the gpu culling
+	const std::vector<DrawElementsIndirectCommand> &GetCulledCommands() const
+	{
+		return mCulledCommands;
+	}
+	const std::vector<DrawElementsIndirectCommand> &GetCulledCommandsTransparency() const
+	{
+		return mCulledCommandsTransparency;
+	}
+	CFrustumCulling &GetFrustumCulling()
+	{
+		return mCulling;
+	}
+
+	// hierarchy over the mesh bounding spheres for frustum, sphere, box and ray queries (items are mesh indices)
+	//	it's built on the first use, moved meshes are refitted and a new build is made when the tree quality drops
+	const CBoundingVolumeHierarchy &UpdateHierarchy();
+
+	// nearest mesh hit by the ray (bounding spheres only), returns -1 for no hit
+	int PickMesh(const vec3 &origin, const vec3 &dir, float &distance);
+
+	// cpu culling of the mesh triangle clusters, visible index ranges are added as commands (baseInstance is the mesh index)
+	//	meshes without clusters are tested by their bounding sphere, returns the number of visible clusters
+	//	NOTE: commands are relative to the vertex data, add its GetFirstIndex and GetBaseVertex when it's in the geometry heap
+	int CullClusters(const CFrustum &frustum, const vec3 &eyePos, std::vector<DrawElementsIndirectCommand> &commands, 
+		std::vector<DrawElementsIndirectCommand> &commandsTransparency);
+
+	const int GetNumberOfClusters() const
+	{
+		return (int) mClusters.size();
+	}
+
+	// choose the lod level of every model by the projected error of its simplified levels, draw commands are
+	//	updated and uploaded when any model changes the level, returns the number of changed models
+	//	pixelError - allowed error on the screen in pixels, hysteresis - band around it to keep the current level
+	int SelectLods(const CCameraInfoCache &cameraInfo, const float pixelError, const float hysteresis=0.25f);
+
+	const int GetModelLod(const int index) const
+	{
+		return (index < (int) mModelLods.size()) ? mModelLods[index].currentLod : 0;
+	}
+
 	const int GetNumberOfSubModels()
 	{
 		return (int) mSubModelNames.size();
@@ -187,6 +297,8 @@ public:
 	{
 		return mModelInfos[index].transform;
 	}
+	// move the model, bounding spheres of its meshes follow the change of the transform
+	void SetModelTransform(const int index, const mat4 &transform);
 
 	//
 	// MESHES (each model could has several meshes inside)
@@ -241,9 +353,48 @@ protected:
 	// draw culling
 	GLuint					mBufferBSphere;		// buffer with bspehere coords for frustum culling of gpu
 	std::vector<vec4>		mBSphereCoords;		// store xyz position and radius in w for each mesh or for each submodel
+	bool					mBSphereMoved;		// spheres are changed by SetModelTransform, gpu buffer is updated on culling
 	GLuint					mBufferBShader;
 	std::vector<vec4>		mBShaderInfo;	// store x (0.0 - opaque, 1.0 - transparency shader for this mesh)
 
+	// cpu culling, spheres are copied into the SoA layout when the meshes are changed
+	CFrustumCulling			mCulling;
+	bool					mCullingSpheresDirty;
+
+	std::vector<std::vector<DrawElementsIndirectCommand>>	mChunkCommands;		// visible commands of each culling chunk
+	std::vector<std::vector<DrawElementsIndirectCommand>>	mChunkCommandsTransparency;
+
+	// hierarchical queries, meshes of each model are stored to refit them on a transform change
+	CBoundingVolumeHierarchy	mHierarchy;
+	bool						mHierarchyDirty;		// meshes are changed, a new build is needed
+	int							mHierarchyMovedItems;	// refitted meshes since the last build
+
+	std::vector<int>			mModelMeshesFirst;		// for each model and one more at the end
+	std::vector<int>			mModelMeshes;
+
+	// triangle picking, key is the first index and the count of the range
+	std::vector<CTriangleHierarchy*>			mTriangleHierarchies;
+	std::map<uint64_t, int>				mRangeTriangleHierarchy;
+	std::vector<int>							mMeshTriangleHierarchy;		// for each mesh
+	bool										mTriangleHierarchyDirty;
+
+	// triangle clusters of the meshes, first index is in the merged index buffer
+	std::vector<MeshCluster>				mClusters;
+	std::vector<std::pair<int, int>>		mMeshClusters;	// first cluster and number of clusters for each mesh
+
+	// discrete lod levels, the source level is the first one
+	struct ModelLodInfo
+	{
+		vec4		bsphere;		// model bounding sphere
+		float		errors[MESH_LOD_MAX_LEVELS];	// simplification error of every level in the model units
+		int			numberOfLods;	// including the source level
+		int			currentLod;
+	};
+
+	std::vector<ModelLodInfo>					mModelLods;		// for each model
+	std::vector<std::pair<GLuint, GLuint>>		mLodRanges;		// first index and count in the merged index buffer
+	std::vector<std::pair<int, int>>			mMeshLods;		// first range and number of levels for each mesh
+
 	// atomic counter for calculating real far distance (for cluster lighting)
 	GLuint					mBufferAz;
 
@@ -255,8 +406,28 @@ protected:
 	GLuint													mBufferIndirect;
 	GLuint													mBufferIndirectTransparency;
 
+	// neighbour meshes with the same index range are merged into one command with a number of instances
+	std::vector<DrawElementsIndirectCommand>				mInstancedCommands;
+	std::vector<DrawElementsIndirectCommand>				mInstancedCommandsTransparency;
+
+	GLuint													mBufferIndirectInstanced;
+	GLuint													mBufferIndirectInstancedTransparency;
+	bool													mCommandsCulled;	// RenderCulling was made for this frame
+
+	std::vector<DrawElementsIndirectCommand>				mCulledCommands;
+	std::vector<DrawElementsIndirectCommand>				mCulledCommandsTransparency;
+
+	GLuint													mBufferIndirectCulled;
+	GLuint													mBufferIndirectCulledTransparency;
+	bool													mCommandsCulledCPU;	// CullMeshes was made for this frame
+
 	std::vector<DrawElementsIndirectBindlessCommandNV>		mBindlessCommands;
 	GLuint													mBufferIndirectBindless;
+
+	// heap offsets of the uploaded commands, commands are uploaded again when the heap moves the range
+	GLuint													mUploadedBaseVertex;
+	GLuint													mUploadedFirstIndex;
+	std::vector<DrawElementsIndirectCommand>				mRebasedCommands;
 	/*
 	std::vector<TClientModelDATA>					mClientModelInfos;	// hold each mesh transformation to prepare per mesh normal matrix
 	std::vector<TClientMeshDATA>					mClientMeshInfos;	// hold each mesh transformation to prepare per mesh normal matrix
@@ -264,16 +435,39 @@ protected:
 	// this one is assigned as a attribute (location=4)
 	std::vector<MeshGLSL>						mMeshInfos;	// allocate and collect all information about meshes for render
 	std::vector<ModelGLSL>						mModelInfos;
+	std::vector<ModelCompactGLSL>				mCompactModelInfos;
+	bool										mCompactModelLayout;
+
+	// normal matrices of the models, transform changes are marked as dirty
+	CNormalMatrices								mNormalMatrices;
 	GLuint										mBufferInfos;	// SSBO with submeshes data
 
 	CGPUBufferNV				mBufferPerMesh;
 	CGPUBufferNV				mBufferPerModel;
 
+	// changed records since the last upload
+	CDirtyRanges				mMeshRanges;
+	CDirtyRanges				mModelRanges;
+
 	void	PrepareBufferIndirect();
 	void	PrepareBufferInfosSSBO();
 
+	void	BuildInstancedCommands();
+
+	void	UploadCulledCommands(GLuint &buffer, const std::vector<DrawElementsIndirectCommand> &commands);
+
+	// commands are kept relative to the vertex data, heap offsets are added on upload
+	//	returns the commands itself when the vertex data has own buffers
+	const DrawElementsIndirectCommand *RebaseCommands(const std::vector<DrawElementsIndirectCommand> &commands);
+
+	void	BuildHierarchy();
+	void	FreeTriangleHierarchies();
+
 	void	UpdatePerModelGPUBuffer();
 	void	UpdatePerMeshGPUBuffer();	// UBO for nvidia gpu pointer
+	// upload the changed records only
+	void	UpdatePerModelGPURanges();
+	void	UpdatePerMeshGPURanges();
 
 	void	PrepareBufferBSphere();
 	void	BindBufferBSphere();
@@ -320,6 +514,15 @@ public:
 
 	virtual bool UpdateFromCache( const unsigned char *models_data );
 
+	// UpdateFromCache in two steps
+	//	merge is a pure cpu work (could be done in a worker thread), it fills the client side streams (positions, normals, indices)
+	//	upload makes gl calls, tangents and uvs are merged from the same pack straight into the mapped buffers
+	bool	MergeFromCache( const unsigned char *models_data );
+	bool	UploadMergedData( const unsigned char *models_data );
+
+	// instead of MergeFromCache, client side streams are swapped from the staging merged ahead (pipelined loader)
+	bool	TakeMergedData( VertexMergeStaging &staging );
+
 	const int GetNumberOfVertices()
 	{
 		return mNumberOfVertices;
@@ -372,7 +575,33 @@ public:
 	}
 
 	bool IsReady() {
-		return (mBuffersId[VERTEX_BUFFER_POINT] > 0);
+		return (mBuffersId[VERTEX_BUFFER_POINT] > 0 || IsInGeometryHeap() );
+	}
+
+	// streams go to a range of the shared heap buffers instead of own ones, it has to be set before the upload
+	void SetGeometryHeap(CGeometryHeap *heap);
+
+	const bool IsInGeometryHeap() const
+	{
+		return (mGeometryHeap != nullptr && GeometryHeapRange::IsValid(mHeapRange) );
+	}
+	// offsets of the range in the heap buffers, draw commands add them to the firstIndex and baseVertex
+	//	they are changed when the heap is defragmented
+	const GLuint GetBaseVertex() const
+	{
+		return (IsInGeometryHeap() ) ? mGeometryHeap->GetBaseVertex(mHeapRange) : 0;
+	}
+	const GLuint GetFirstIndex() const
+	{
+		return (IsInGeometryHeap() ) ? mGeometryHeap->GetFirstIndex(mHeapRange) : 0;
+	}
+	CGeometryHeap *GetGeometryHeap() const
+	{
+		return mGeometryHeap;
+	}
+	const GeometryHeapRange *GetHeapRange() const
+	{
+		return (IsInGeometryHeap() ) ? &mHeapRange : nullptr;
 	}
 
 protected:
@@ -383,6 +612,9 @@ protected:
 	GLuint			mBuffersId[VERTEX_BUFFER_MAX];	// do we need to free gpu buffers from this class destructor
 	GLvoid			*mBuffersOffsets[VERTEX_BUFFER_MAX];
 
+	CGeometryHeap		*mGeometryHeap;
+	GeometryHeapRange	mHeapRange;
+
 	//BYTE			*points;
 
 	int				mNumberOfVertices;
@@ -407,7 +639,13 @@ protected:
 
 	std::vector<unsigned int>	mIndices;
 
-	
+	// upload fallback when the buffers could not be mapped
+	std::vector<vec4>	mMergedTangents;
+	std::vector<vec2>	mMergedUVs;
+
+	// keep the heap range when the size is the same
+	bool	AllocateHeapRange(const int numberOfVertices, const int numberOfIndices);
+	bool	UploadMergedDataToHeap( const unsigned char *models_data );
 };
 
 
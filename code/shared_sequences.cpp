@@ -0,0 +1,777 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: shared_sequences.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "shared_sequences.h"
+#include "algorithm/BlockDelta.h"
+#include "IO/FileIO.h"
+
+#include <limits>
+#include <chrono>
+#include <algorithm>
+
+typedef std::chrono::high_resolution_clock	StreamClock;
+
+int ComputeSequenceFrame( const ImageSequenceHeader2 &header, const double time, double &firstRunningTime, double &frameTime )
+{
+	double currentTime = time;
+
+	if (header.freeRunning > 0)
+	{
+		if (firstRunningTime == std::numeric_limits<double>::infinity() )
+			firstRunningTime = currentTime;
+
+		currentTime = currentTime - firstRunningTime;
+	}
+
+	const double playSpeed = header.playSpeed;
+
+	if (playSpeed == 0.0)
+		return header.startFrame;
+
+	double timeStep = (header.useSystemFrameRate) ? 1.0 / 25.0 : 1.0 / header.frameRate;
+	timeStep = timeStep * (1.0 / playSpeed);
+
+	if (header.freeRunning == 0)
+		currentTime -= header.timeOffset;
+
+	if (header.loop > 0)
+	{
+		const double duration = timeStep * (header.stopFrame - header.startFrame + 1);
+
+		while (duration > 0.0 && currentTime > duration)
+		{
+			currentTime -= duration;
+
+			if (header.freeRunning > 0)
+				firstRunningTime += duration;
+		}
+	}
+
+	frameTime = currentTime;
+
+	int frame = header.startFrame;
+	if (timeStep != 0.0)
+		frame = (int) (currentTime / timeStep);
+
+	if (frame > header.stopFrame) frame = header.stopFrame;
+	if (frame < header.startFrame) frame = header.startFrame;
+
+	return frame;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// sources
+
+const size_t CImageSequenceSource::GetMaxFrameSize() const
+{
+	size_t maxSize = 0;
+	for (auto iter=begin(mFrameSizes); iter!=end(mFrameSizes); ++iter)
+		maxSize = std::max(maxSize, *iter);
+
+	return maxSize;
+}
+
+bool CImageSequenceSource::SetLinks(const int numberOfFrames, const ImageSequenceLink *links, const size_t framesSize)
+{
+	mFrameOffsets.clear();
+	mFrameSizes.clear();
+
+	if (numberOfFrames <= 0 || links == nullptr)
+		return false;
+
+	const int64_t tableSize = (int64_t) sizeof(ImageSequenceLink) * numberOfFrames;
+
+	for (int i=0; i<numberOfFrames; ++i)
+	{
+		const int64_t offset = links[i].link;
+		const int64_t next = (i < numberOfFrames-1) ? links[i+1].link : (int64_t) framesSize;
+
+		// frame records follow the links table one by one
+		if (offset < tableSize || next > (int64_t) framesSize || next - offset < (int64_t) sizeof(ImageHeader2) )
+		{
+			mFrameOffsets.clear();
+			mFrameSizes.clear();
+			return false;
+		}
+
+		mFrameOffsets.push_back(offset);
+		mFrameSizes.push_back( (size_t) (next - offset) );
+	}
+
+	return true;
+}
+
+CImageSequenceMemorySource::CImageSequenceMemorySource()
+{
+	mFrames = nullptr;
+}
+
+bool CImageSequenceMemorySource::Open(const BYTE *frames, const int numberOfFrames, const size_t framesSize)
+{
+	mFrames = frames;
+
+	if (frames == nullptr || framesSize < sizeof(ImageSequenceLink) * numberOfFrames)
+		return false;
+
+	return SetLinks( numberOfFrames, (const ImageSequenceLink*) frames, framesSize );
+}
+
+bool CImageSequenceMemorySource::ReadFrame(const int frame, BYTE *dst)
+{
+	if (mFrames == nullptr || frame < 0 || frame >= GetNumberOfFrames() )
+		return false;
+
+	memcpy( dst, mFrames + mFrameOffsets[frame], mFrameSizes[frame] );
+	return true;
+}
+
+CImageSequenceFileSource::CImageSequenceFileSource()
+{
+	mFile = nullptr;
+	mFramesOffset = 0;
+}
+
+CImageSequenceFileSource::~CImageSequenceFileSource()
+{
+	Close();
+}
+
+bool CImageSequenceFileSource::Open(const char *filename, const int64_t framesOffset, const int numberOfFrames, const ImageSequenceLink *links, const size_t framesSize)
+{
+	Close();
+
+	if (false == SetLinks( numberOfFrames, links, framesSize ) )
+		return false;
+
+	if (0 != fopen_s( &mFile, filename, "rb" ) )
+	{
+		mFile = nullptr;
+		return false;
+	}
+
+	mFramesOffset = framesOffset;
+	return true;
+}
+
+void CImageSequenceFileSource::Close()
+{
+	if (mFile)
+	{
+		fclose(mFile);
+		mFile = nullptr;
+	}
+}
+
+bool CImageSequenceFileSource::ReadFrame(const int frame, BYTE *dst)
+{
+	if (mFile == nullptr || frame < 0 || frame >= GetNumberOfFrames() )
+		return false;
+
+	if (0 != _fseeki64( mFile, mFramesOffset + mFrameOffsets[frame], SEEK_SET ) )
+		return false;
+
+	return (mFrameSizes[frame] == fread( dst, sizeof(BYTE), mFrameSizes[frame], mFile ) );
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// stream
+
+CImageSequenceStream::CImageSequenceStream()
+{
+	memset( &mHeader, 0, sizeof(ImageSequenceHeader2) );
+	mSource = nullptr;
+
+	mPinnedFrame = -1;
+	mDirection = 1;
+	mLastTime = -std::numeric_limits<double>::infinity();
+	mFirstRunningTime = std::numeric_limits<double>::infinity();
+	mFrameTime = 0.0;
+
+	mUseReader = false;
+	mAbort = false;
+
+	ImageSequenceStreamStats::Clear(mStats);
+}
+
+CImageSequenceStream::~CImageSequenceStream()
+{
+	Close();
+}
+
+bool CImageSequenceStream::Open( const ImageSequenceHeader2 &header, CImageSequenceSource *source, const size_t memoryBudget, const bool readerThread )
+{
+	Close();
+
+	if (source == nullptr)
+		return false;
+
+	const int numberOfFrames = source->GetNumberOfFrames();
+	const size_t maxFrameSize = source->GetMaxFrameSize();
+
+	if (numberOfFrames <= 0 || maxFrameSize == 0)
+	{
+		delete source;
+		return false;
+	}
+
+	mHeader = header;
+	mSource = source;
+
+	// window needs at least the current and the next frame, plus the frame which is on the screen
+	int numberOfSlots = (int) std::min( memoryBudget / maxFrameSize, (size_t) numberOfFrames + 1 );
+	numberOfSlots = std::max( 3, numberOfSlots );
+
+	mSlots.resize(numberOfSlots);
+	for (auto iter=begin(mSlots); iter!=end(mSlots); ++iter)
+	{
+		iter->frame = -1;
+		iter->ready = false;
+		iter->loading = false;
+	}
+
+	mWindow.clear();
+	mPinnedFrame = -1;
+	mDirection = 1;
+	mLastTime = -std::numeric_limits<double>::infinity();
+	mFirstRunningTime = std::numeric_limits<double>::infinity();
+	mFrameTime = 0.0;
+
+	ImageSequenceStreamStats::Clear(mStats);
+
+	mAbort = false;
+	mUseReader = readerThread;
+
+	if (mUseReader)
+		mReader = std::thread( &CImageSequenceStream::ReaderThread, this );
+
+	return true;
+}
+
+void CImageSequenceStream::Close()
+{
+	if (mReader.joinable() )
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mAbort = true;
+		}
+		mReaderCondition.notify_all();
+		mFrameCondition.notify_all();
+
+		mReader.join();
+	}
+
+	if (mSource)
+	{
+		delete mSource;
+		mSource = nullptr;
+	}
+
+	mSlots.clear();
+	mWindow.clear();
+	mUseReader = false;
+}
+
+int CImageSequenceStream::ClampFrame( const int frame ) const
+{
+	return std::max( 0, std::min(frame, mSource->GetNumberOfFrames()-1) );
+}
+
+int CImageSequenceStream::Evaluate( const double time )
+{
+	if (mSource == nullptr)
+		return 0;
+
+	const int frame = ClampFrame( ComputeSequenceFrame( mHeader, time, mFirstRunningTime, mFrameTime ) );
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		// keep the last direction when the time stays
+		if (time > mLastTime)
+			mDirection = 1;
+		else if (time < mLastTime)
+			mDirection = -1;
+
+		mLastTime = time;
+
+		BuildWindow(frame);
+	}
+
+	mReaderCondition.notify_one();
+	return frame;
+}
+
+void CImageSequenceStream::BuildWindow( const int frame )
+{
+	const int direction = (mHeader.playSpeed < 0.0) ? -mDirection : mDirection;
+
+	// play range which has frame records
+	const int firstFrame = ClampFrame(mHeader.startFrame);
+	const int lastFrame = std::max( firstFrame, ClampFrame(mHeader.stopFrame) );
+	const int length = lastFrame - firstFrame + 1;
+
+	// one slot is left for the frame on the screen
+	const int windowSize = std::min( (int) mSlots.size() - 1, length );
+
+	mWindow.clear();
+	mWindow.push_back(frame);
+
+	int next = frame;
+	for (int i=1; i<windowSize; ++i)
+	{
+		next += direction;
+
+		if (next > lastFrame || next < firstFrame)
+		{
+			if (mHeader.loop == 0)
+				break;
+
+			next = (next > lastFrame) ? firstFrame : lastFrame;
+		}
+
+		if (next == frame)
+			break;
+
+		mWindow.push_back(next);
+	}
+}
+
+int CImageSequenceStream::FindSlot( const int frame ) const
+{
+	for (int i=0, count=(int) mSlots.size(); i<count; ++i)
+	{
+		if (mSlots[i].frame == frame)
+			return i;
+	}
+	return -1;
+}
+
+bool CImageSequenceStream::IsInWindow( const int frame ) const
+{
+	return std::find( begin(mWindow), end(mWindow), frame ) != end(mWindow);
+}
+
+int CImageSequenceStream::FindVictim() const
+{
+	int victim = -1;
+
+	for (int i=0, count=(int) mSlots.size(); i<count; ++i)
+	{
+		const FrameSlot &slot = mSlots[i];
+
+		if (slot.frame < 0)
+			return i;
+
+		if (false == slot.loading && slot.frame != mPinnedFrame && false == IsInWindow(slot.frame) && victim < 0)
+			victim = i;
+	}
+
+	return victim;
+}
+
+bool CImageSequenceStream::FindRequest( int &frame, int &slot )
+{
+	for (auto iter=begin(mWindow); iter!=end(mWindow); ++iter)
+	{
+		if (FindSlot(*iter) >= 0)
+			continue;
+
+		// frames go by priority, if there is no room for this one, there is no room for the next
+		slot = FindVictim();
+		if (slot < 0)
+			return false;
+
+		frame = *iter;
+		return true;
+	}
+
+	return false;
+}
+
+bool CImageSequenceStream::ReadSlot( std::unique_lock<std::mutex> &lock, const int frame, const int slot )
+{
+	FrameSlot &frameSlot = mSlots[slot];
+
+	if (frameSlot.frame >= 0)
+		mStats.evicted += 1;
+
+	frameSlot.frame = frame;
+	frameSlot.ready = false;
+	frameSlot.loading = true;
+
+	lock.unlock();
+
+	// slot data is not touched by anyone else while it's loading
+	frameSlot.data.resize( mSource->GetFrameSize(frame) );
+	const bool result = mSource->ReadFrame( frame, frameSlot.data.data() );
+
+	lock.lock();
+
+	// failed frame stays in the slot, so it's not requested again
+	frameSlot.loading = false;
+	frameSlot.ready = result;
+
+	UpdateMemoryStats();
+	mFrameCondition.notify_all();
+
+	return result;
+}
+
+void CImageSequenceStream::UpdateMemoryStats()
+{
+	size_t memory = 0;
+	for (auto iter=begin(mSlots); iter!=end(mSlots); ++iter)
+		memory += iter->data.capacity();
+
+	mStats.residentMemory = memory;
+	mStats.peakMemory = std::max( mStats.peakMemory, memory );
+}
+
+void CImageSequenceStream::ReaderThread()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	while (false == mAbort)
+	{
+		int frame, slot;
+
+		if (FindRequest(frame, slot) )
+		{
+			const bool prefetch = (frame != mPinnedFrame);
+			ReadSlot( lock, frame, slot );
+
+			if (prefetch)
+				mStats.prefetched += 1;
+		}
+		else
+		{
+			mReaderCondition.wait(lock);
+		}
+	}
+}
+
+int CImageSequenceStream::ProcessRequests( const int maxFrames )
+{
+	if (mSource == nullptr || mUseReader)
+		return 0;
+
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	int count = 0;
+	int frame, slot;
+
+	while ( (maxFrames <= 0 || count < maxFrames) && FindRequest(frame, slot) )
+	{
+		ReadSlot( lock, frame, slot );
+		mStats.prefetched += 1;
+		count += 1;
+	}
+
+	return count;
+}
+
+const BYTE *CImageSequenceStream::GetFrame( const int frame )
+{
+	if (mSource == nullptr)
+		return nullptr;
+
+	const int index = ClampFrame(frame);
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mPinnedFrame = index;
+
+	int slot = FindSlot(index);
+
+	if (slot >= 0 && mSlots[slot].ready)
+	{
+		mStats.hits += 1;
+		return mSlots[slot].data.data();
+	}
+
+	const StreamClock::time_point stallStart = StreamClock::now();
+	mStats.stalls += 1;
+
+	// seek without the evaluation
+	if (mWindow.empty() || mWindow.front() != index)
+		BuildWindow(index);
+
+	if (mUseReader)
+	{
+		mReaderCondition.notify_one();
+
+		for (;;)
+		{
+			slot = FindSlot(index);
+			if (mAbort || (slot >= 0 && false == mSlots[slot].loading) )
+				break;
+
+			mFrameCondition.wait(lock);
+		}
+	}
+	else if (slot < 0)
+	{
+		slot = FindVictim();
+		if (slot >= 0)
+			ReadSlot( lock, index, slot );
+	}
+
+	mStats.stallTime += std::chrono::duration<double, std::milli>( StreamClock::now() - stallStart ).count();
+
+	return (slot >= 0 && mSlots[slot].ready) ? mSlots[slot].data.data() : nullptr;
+}
+
+bool CImageSequenceStream::IsResident( const int frame )
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const int slot = FindSlot(frame);
+	return (slot >= 0 && mSlots[slot].ready);
+}
+
+const ImageSequenceStreamStats CImageSequenceStream::GetStats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
+
+void CImageSequenceStream::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const size_t memory = mStats.residentMemory;
+	ImageSequenceStreamStats::Clear(mStats);
+	mStats.residentMemory = memory;
+	mStats.peakMemory = memory;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// delta coding
+
+// bytes in one block of the compressed internal format, 0 - format is not block compressed
+static int GetFormatBlockSize( const GLint internalFormat )
+{
+	switch(internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RED_RGTC1:
+	case GL_COMPRESSED_SIGNED_RED_RGTC1:
+		return 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RG_RGTC2:
+	case GL_COMPRESSED_SIGNED_RG_RGTC2:
+		return 16;
+	}
+	return 0;
+}
+
+// frame could be stored as a difference of the previous one
+static bool CanStoreDelta( const ImageHeader2 *header, const ImageHeader2 *prevHeader )
+{
+	if (header->numberOfLODs > 1 || prevHeader->numberOfLODs > 1)
+		return false;
+
+	if (header->width != prevHeader->width || header->height != prevHeader->height 
+		|| header->internalFormat != prevHeader->internalFormat || header->size != prevHeader->size)
+		return false;
+
+	const int blockSize = GetFormatBlockSize(header->internalFormat);
+	const int blocksPerRow = (header->width + 3) / 4;
+	const int numberOfRows = (header->height + 3) / 4;
+
+	return (blockSize > 0 && header->size == blockSize * blocksPerRow * numberOfRows);
+}
+
+bool EncodeSequenceFrames( const BYTE *frames, const int numberOfFrames, const size_t framesSize, const int keyFrameInterval,
+	std::vector<BYTE> &dst, ImageSequenceEncodeStats *stats )
+{
+	CImageSequenceMemorySource	source;
+
+	if (false == source.Open( frames, numberOfFrames, framesSize ) )
+		return false;
+
+	if (stats)
+	{
+		ImageSequenceEncodeStats::Clear(*stats);
+		stats->sourceSize = framesSize;
+	}
+
+	dst.clear();
+	dst.resize( sizeof(ImageSequenceLink) * numberOfFrames, 0 );
+	dst.reserve(framesSize);
+
+	std::vector<BlockDeltaRun>	runs;
+
+	const ImageHeader2 *prevHeader = nullptr;
+	int keyFrame = 0;
+
+	for (int i=0; i<numberOfFrames; ++i)
+	{
+		const BYTE *record = source.GetFrameRecord(i);
+		const ImageHeader2 *header = (const ImageHeader2*) record;
+
+		// already encoded
+		if (header->type == IMAGE_TYPE_FRAME_DELTA)
+			return false;
+
+		( (ImageSequenceLink*) dst.data() )[i].link = (int64_t) dst.size();
+
+		bool storeDelta = false;
+
+		if (prevHeader != nullptr && i - keyFrame < keyFrameInterval && CanStoreDelta(header, prevHeader) )
+		{
+			const BYTE *prevData = (const BYTE*) prevHeader + sizeof(ImageHeader2);
+			const BYTE *data = record + sizeof(ImageHeader2);
+
+			const int blockSize = GetFormatBlockSize(header->internalFormat);
+			const int blocksPerRow = (header->width + 3) / 4;
+			const int numberOfRows = (header->height + 3) / 4;
+
+			// neighbour runs with one block between are merged to save the run and the upload call
+			const int numberOfBlocks = FindChangedBlocks( prevData, data, blockSize, blocksPerRow, numberOfRows, 1, runs );
+			const size_t deltaSize = sizeof(ImageFrameDeltaHeader) + sizeof(BlockDeltaRun) * runs.size() + (size_t) blockSize * numberOfBlocks;
+
+			if (deltaSize * 2 < (size_t) header->size)
+			{
+				ImageHeader2 deltaHeader = *header;
+				deltaHeader.type = IMAGE_TYPE_FRAME_DELTA;
+				deltaHeader.size = (GLint) deltaSize;
+
+				ImageFrameDeltaHeader	frameDelta;
+				ImageFrameDeltaHeader::Set( keyFrame, blockSize, blocksPerRow, (GLint) runs.size(), frameDelta );
+
+				const BYTE *ptr = (const BYTE*) &deltaHeader;
+				dst.insert( dst.end(), ptr, ptr + sizeof(ImageHeader2) );
+				ptr = (const BYTE*) &frameDelta;
+				dst.insert( dst.end(), ptr, ptr + sizeof(ImageFrameDeltaHeader) );
+				ptr = (const BYTE*) runs.data();
+				dst.insert( dst.end(), ptr, ptr + sizeof(BlockDeltaRun) * runs.size() );
+
+				const size_t offset = dst.size();
+				dst.resize( offset + (size_t) blockSize * numberOfBlocks );
+				GatherRunBlocks( data, runs.data(), (int) runs.size(), blockSize, dst.data() + offset );
+
+				storeDelta = true;
+
+				if (stats)
+				{
+					stats->deltaFrames += 1;
+					stats->changedBlocks += numberOfBlocks;
+				}
+			}
+		}
+
+		if (false == storeDelta)
+		{
+			dst.insert( dst.end(), record, record + source.GetFrameSize(i) );
+			keyFrame = i;
+
+			if (stats)
+				stats->keyFrames += 1;
+		}
+
+		prevHeader = header;
+	}
+
+	if (stats)
+		stats->encodedSize = dst.size();
+
+	return true;
+}
+
+const BYTE *GetSequenceFrameRecord( const int frame, CImageSequenceStream *stream, const void *frames )
+{
+	if (stream != nullptr)
+		return stream->GetFrame(frame);
+
+	if (frames != nullptr)
+	{
+		const ImageSequenceLink *link = (const ImageSequenceLink*) frames;
+		return (const BYTE*) frames + link[frame].link;
+	}
+
+	return nullptr;
+}
+
+CImageSequenceDeltaDecoder::CImageSequenceDeltaDecoder()
+{
+	mFrame = -1;
+}
+
+void CImageSequenceDeltaDecoder::Reset()
+{
+	mImage.clear();
+	mFrame = -1;
+}
+
+bool CImageSequenceDeltaDecoder::Decode( const int frame, CImageSequenceStream *stream, const void *frames )
+{
+	if (frame == mFrame)
+		return true;
+
+	const BYTE *record = GetSequenceFrameRecord( frame, stream, frames );
+	if (record == nullptr)
+		return false;
+
+	const ImageHeader2 *header = (const ImageHeader2*) record;
+
+	int firstFrame = frame;
+
+	if (header->type == IMAGE_TYPE_FRAME_DELTA)
+	{
+		const ImageFrameDeltaHeader *frameDelta = (const ImageFrameDeltaHeader*) (record + sizeof(ImageHeader2));
+
+		// continue from the last decoded frame when it's on the way from the key frame
+		if (mFrame >= frameDelta->keyFrame && mFrame < frame)
+			firstFrame = mFrame + 1;
+		else
+			firstFrame = frameDelta->keyFrame;
+	}
+
+	// NOTE: record of the stream is valid until the next frame request
+	for (int i=firstFrame; i<=frame; ++i)
+	{
+		record = GetSequenceFrameRecord( i, stream, frames );
+		if (record == nullptr)
+		{
+			Reset();
+			return false;
+		}
+
+		header = (const ImageHeader2*) record;
+		const BYTE *data = record + sizeof(ImageHeader2);
+
+		if (header->type != IMAGE_TYPE_FRAME_DELTA)
+		{
+			mImage.assign( data, data + header->size );
+		}
+		else
+		{
+			const ImageFrameDeltaHeader *frameDelta = (const ImageFrameDeltaHeader*) data;
+			const BlockDeltaRun *runs = (const BlockDeltaRun*) (data + sizeof(ImageFrameDeltaHeader));
+			const BYTE *blocks = (const BYTE*) (runs + frameDelta->numberOfRuns);
+
+			if (mImage.empty() )
+			{
+				Reset();
+				return false;
+			}
+			ApplyRunBlocks( runs, frameDelta->numberOfRuns, blocks, frameDelta->blockSize, mImage.data() );
+		}
+	}
+
+	mFrame = frame;
+	return true;
+}
@@ -0,0 +1,275 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: shared_sequences.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gpucache_types.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define IMAGE_SEQUENCE_DEFAULT_BUDGET		(64 * 1024 * 1024)
+
+// frame of the sequence for the time, same rules as the sequencer evaluation
+//	firstRunningTime - start time of the free running sequence (infinity - not started yet)
+//	frameTime - local time of the sequence, it's not changed when the play speed is 0
+int ComputeSequenceFrame( const ImageSequenceHeader2 &header, const double time, double &firstRunningTime, double &frameTime );
+
+//////////////////////////////////////////////////////////////////////////
+// where frame records (ImageHeader2, image data and lods) are coming from
+
+class CImageSequenceSource
+{
+public:
+	//! a destructor
+	virtual ~CImageSequenceSource()
+	{}
+
+	const int GetNumberOfFrames() const
+	{
+		return (int) mFrameSizes.size();
+	}
+	const size_t GetFrameSize(const int frame) const
+	{
+		return mFrameSizes[frame];
+	}
+	const size_t GetMaxFrameSize() const;
+
+	// copy a frame record into dst (GetFrameSize bytes), it's called from the reader thread
+	virtual bool ReadFrame(const int frame, BYTE *dst) = 0;
+
+protected:
+
+	std::vector<int64_t>		mFrameOffsets;		// from the frames block start
+	std::vector<size_t>			mFrameSizes;
+
+	// frame sizes from the links table in front of the frames block
+	bool SetLinks(const int numberOfFrames, const ImageSequenceLink *links, const size_t framesSize);
+};
+
+// frames block which is loaded in memory (ImageSequenceHeader2::size bytes after the sequence header)
+class CImageSequenceMemorySource : public CImageSequenceSource
+{
+public:
+	//! a constructor
+	CImageSequenceMemorySource();
+
+	// frames is not copied and has to be valid while the source is used
+	bool Open(const BYTE *frames, const int numberOfFrames, const size_t framesSize);
+
+	virtual bool ReadFrame(const int frame, BYTE *dst) override;
+
+	const BYTE *GetFrameRecord(const int frame) const
+	{
+		return mFrames + mFrameOffsets[frame];
+	}
+
+protected:
+
+	const BYTE		*mFrames;
+};
+
+// frames block of the textures pack
+class CImageSequenceFileSource : public CImageSequenceSource
+{
+public:
+	//! a constructor
+	CImageSequenceFileSource();
+	//! a destructor
+	virtual ~CImageSequenceFileSource();
+
+	// framesOffset - file position of the frames block, links - links table of the block
+	bool Open(const char *filename, const int64_t framesOffset, const int numberOfFrames, const ImageSequenceLink *links, const size_t framesSize);
+	void Close();
+
+	virtual bool ReadFrame(const int frame, BYTE *dst) override;
+
+protected:
+
+	FILE			*mFile;
+	int64_t			mFramesOffset;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// streaming statistics
+
+struct ImageSequenceStreamStats
+{
+	int			hits;			// frame was resident when it was requested
+	int			stalls;			// frame had to be waited for
+	int			prefetched;		// frames read ahead of the playback
+	int			evicted;		// resident frames replaced by the window
+	double		stallTime;		// ms
+
+	size_t		residentMemory;
+	size_t		peakMemory;
+
+	static void Clear(ImageSequenceStreamStats &stats)
+	{
+		memset( &stats, 0, sizeof(ImageSequenceStreamStats) );
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+// sliding window of the sequence frames
+//	only the current frame and the frames ahead in the play direction are resident, number of frames in the window
+//	comes from the memory budget. A background reader fills the window, playback waits only when the frame
+//	is not read yet (seek, reverse or the reader is behind).
+//	Without the reader thread, requests are read in ProcessRequests (deterministic update for the tools and tests)
+
+class CImageSequenceStream
+{
+public:
+
+	//! a constructor
+	CImageSequenceStream();
+	//! a destructor
+	~CImageSequenceStream();
+
+	// source is owned by the stream
+	bool Open( const ImageSequenceHeader2 &header, CImageSequenceSource *source, const size_t memoryBudget, const bool readerThread=true );
+	void Close();
+
+	bool IsOpen() const
+	{
+		return mSource != nullptr;
+	}
+
+	// compute a frame for the time and request the window in the play direction
+	int Evaluate( const double time );
+
+	// frame record (ImageHeader2, data and lods), waits for the reader on a miss
+	//	pointer is valid until the next GetFrame call
+	const BYTE *GetFrame( const int frame );
+
+	// read requested frames in the calling thread when there is no reader thread, 0 - all requests
+	int ProcessRequests( const int maxFrames=0 );
+
+	bool IsResident( const int frame );
+
+	const int GetNumberOfSlots() const
+	{
+		return (int) mSlots.size();
+	}
+	const ImageSequenceStreamStats GetStats();
+	void ResetStats();
+
+protected:
+
+	struct FrameSlot
+	{
+		int					frame;		// -1 - empty
+		bool				ready;
+		bool				loading;
+		std::vector<BYTE>	data;
+	};
+
+	ImageSequenceHeader2		mHeader;
+	CImageSequenceSource		*mSource;
+
+	std::vector<FrameSlot>		mSlots;
+	std::vector<int>			mWindow;		// requested frames, current one goes first
+
+	int							mPinnedFrame;	// returned by GetFrame, it's not replaced
+	int							mDirection;		// 1 - forward, -1 - backward
+	double						mLastTime;
+	double						mFirstRunningTime;
+	double						mFrameTime;
+
+	ImageSequenceStreamStats	mStats;
+
+	std::mutex					mMutex;
+	std::condition_variable		mReaderCondition;	// reader waits for the requests
+	std::condition_variable		mFrameCondition;	// playback waits for a frame
+
+	std::thread					mReader;
+	bool						mUseReader;
+	bool						mAbort;
+
+	void		ReaderThread();
+
+	int			ClampFrame( const int frame ) const;
+
+	// under the lock
+	int			FindSlot( const int frame ) const;
+	bool		IsInWindow( const int frame ) const;
+	int			FindVictim() const;
+	bool		FindRequest( int &frame, int &slot );
+	void		BuildWindow( const int frame );
+	void		UpdateMemoryStats();
+
+	// read the frame into the slot which is marked as loading, lock is released for the read
+	bool		ReadSlot( std::unique_lock<std::mutex> &lock, const int frame, const int slot );
+};
+
+//////////////////////////////////////////////////////////////////////////
+// temporal delta coding of the sequence frames
+//	frames with a single block compressed level (DXT / RGTC) could be stored as the changed blocks
+//	against the previous frame (IMAGE_TYPE_FRAME_DELTA records), decoding goes from the last full frame
+
+struct ImageSequenceEncodeStats
+{
+	int			keyFrames;
+	int			deltaFrames;
+	int			changedBlocks;
+
+	size_t		sourceSize;
+	size_t		encodedSize;
+
+	static void Clear(ImageSequenceEncodeStats &stats)
+	{
+		memset( &stats, 0, sizeof(ImageSequenceEncodeStats) );
+	}
+};
+
+// re-encode a frames block (links table and frame records), a full frame is stored at least every keyFrameInterval frames
+//	and when the delta is bigger than a half of the full frame. Sequence header size has to be updated with the dst size
+bool EncodeSequenceFrames( const BYTE *frames, const int numberOfFrames, const size_t framesSize, const int keyFrameInterval,
+	std::vector<BYTE> &dst, ImageSequenceEncodeStats *stats=nullptr );
+
+// frame record from the stream or from the frames block in memory
+const BYTE *GetSequenceFrameRecord( const int frame, CImageSequenceStream *stream, const void *frames );
+
+// level 0 of the delta coded frames, the last decoded frame is kept to continue the decoding
+class CImageSequenceDeltaDecoder
+{
+public:
+	//! a constructor
+	CImageSequenceDeltaDecoder();
+
+	void Reset();
+
+	// frame records are taken from the stream or from the frames block
+	bool Decode( const int frame, CImageSequenceStream *stream, const void *frames );
+
+	const int GetFrame() const
+	{
+		return mFrame;
+	}
+	const BYTE *GetImage() const
+	{
+		return mImage.data();
+	}
+	const size_t GetImageSize() const
+	{
+		return mImage.size();
+	}
+
+protected:
+
+	std::vector<BYTE>		mImage;
+	int						mFrame;		// -1 - nothing is decoded
+};
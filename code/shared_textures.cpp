@@ -13,9 +13,11 @@
 
 
 #include "shared_textures.h"
+#include "shared_texturesRegistry.h"
 
 #include "graphics\CheckGLError.h"
 #include "graphics\OGL_Utils.h"
+#include "algorithm\BlockDelta.h"
 
 #include <io.h>
 #include <fcntl.h>
@@ -23,6 +25,7 @@
 #include <sys\stat.h>
 
 #include <limits>
+#include <algorithm>
 
 const bool gGenereateMipMaps = true;
 
@@ -37,7 +40,7 @@ bool CTexturesReference::EvaluateFrameAnimation(const double time)
 {
 	for (auto it=mResourceFrames.begin(); it!=mResourceFrames.end(); ++it)
 	{
-		if (it->GetFrames() != nullptr)
+		if (it->IsSequence() )
 			it->Evaluate(time);
 	}
 
@@ -48,7 +51,7 @@ void CTexturesReference::UpdateSequences()
 {
 	for (auto it=mResourceFrames.begin(); it!=mResourceFrames.end(); ++it)
 	{
-		if (it->GetFrames() != nullptr)
+		if (it->IsSequence() )
 			it->UpdateTexture(nullptr, false, false);
 	}
 }
@@ -56,6 +59,7 @@ void CTexturesReference::UpdateSequences()
 CTexturesReference::CTexturesReference()
 	: CResourceGPUModel<TextureGLSL>()
 {
+	mSequenceMemoryBudget = IMAGE_SEQUENCE_DEFAULT_BUDGET;
 }
 
 CTexturesReference::~CTexturesReference()
@@ -81,10 +85,16 @@ void CTexturesReference::Free()
 	for (size_t i=0; i<mResourceIds.size(); ++i)
 	{
 		GLuint id = mResourceIds[i];
-		if (id > 0)
+		const uint64_t digest = (i < mResourceDigests.size()) ? mResourceDigests[i] : 0;
+
+		// shared texture is deleted with the last reference
+		if (digest != 0)
+			CTexturesRegistry::GetInstance().Release(digest);
+		else if (id > 0)
 			glDeleteTextures( 1, &id );
 	}
 	mResourceIds.clear();
+	mResourceDigests.clear();
 
 	for (size_t i=0; i<mResourceFrames.size(); ++i)
 	{
@@ -236,6 +246,7 @@ void CTexturesReference::Allocate(const int numberOfSamplers, const int numberOf
 	CGPUImageSequencer	defSequencer;
 
 	mResourceIds.resize( numberOfImages, 0 );
+	mResourceDigests.resize( numberOfImages, 0 );
 	mResourceFrames.resize( numberOfImages, defSequencer );
 	mTextureDimentions.resize( numberOfImages );
 	mTextureResources.resize( numberOfSamplers );
@@ -263,6 +274,7 @@ CGPUImageSequencer::CGPUImageSequencer()
 	mLastUpdateFrame = -1;
 	mTextureId = 0;
 	mFirstRunningTime = std::numeric_limits<double>::infinity();
+	mStream = nullptr;
 }
 //! a copy constructor
 CGPUImageSequencer::CGPUImageSequencer( const CGPUImageSequencer &sequencer )
@@ -273,6 +285,7 @@ CGPUImageSequencer::CGPUImageSequencer( const CGPUImageSequencer &sequencer )
 	mTextureId = sequencer.mTextureId;
 	mLastUpdateFrame = -1;
 	mFirstRunningTime = std::numeric_limits<double>::infinity();
+	mStream = nullptr;
 }
 //! a destructor
 CGPUImageSequencer::~CGPUImageSequencer()
@@ -287,6 +300,12 @@ void CGPUImageSequencer::Clear()
 		delete [] frames;
 		frames = nullptr;
 	}
+	if (mStream)
+	{
+		delete mStream;
+		mStream = nullptr;
+	}
+	mDecoder.Reset();
 
 	currentFrame = 0;
 }
@@ -301,66 +320,35 @@ void *&CGPUImageSequencer::GetFrames()
 	return frames;
 }
 
-void CGPUImageSequencer::Evaluate( const double time )
+bool CGPUImageSequencer::OpenStream( CImageSequenceSource *source, const size_t memoryBudget )
 {
-	if (frames == nullptr)
-		return;
-
-	double currentTime;
-	double timeStep, timeOffset;
-
-	if (seqHeader.freeRunning > 0)
-	{
-		currentTime = time;
-		
-		if (mFirstRunningTime == std::numeric_limits<double>::infinity() )
-			mFirstRunningTime = currentTime;
+	if (mStream == nullptr)
+		mStream = new CImageSequenceStream();
 
-		currentTime = currentTime - mFirstRunningTime;
-	}
-	else
+	if (false == mStream->Open( seqHeader, source, memoryBudget ) )
 	{
-		currentTime = time; // pInfo->GetLocalTime();
+		delete mStream;
+		mStream = nullptr;
+		return false;
 	}
 
-	double playSpeed = seqHeader.playSpeed;
-		
-	if (playSpeed == 0.0) currentFrame = seqHeader.startFrame;
-	else
-	{
-		if (seqHeader.useSystemFrameRate)
-			timeStep = 1.0 / 25.0; // .SetFrame( 1 );
-		else
-			timeStep = 1.0 / seqHeader.frameRate;
-		timeStep = timeStep * (1.0 / playSpeed);
-
-		if (seqHeader.freeRunning == 0)
-		{
-			timeOffset = seqHeader.timeOffset;
-			currentTime -= timeOffset;
-		}
-
-		if (seqHeader.loop > 0)
-		{
-			timeOffset = timeStep * (seqHeader.stopFrame - seqHeader.startFrame + 1);
+	mLastUpdateFrame = -1;
+	mDecoder.Reset();
+	return true;
+}
 
-			while (currentTime > timeOffset)
-			{
-				currentTime -= timeOffset;
+void CGPUImageSequencer::Evaluate( const double time )
+{
+	if (mStream != nullptr)
+	{
+		currentFrame = mStream->Evaluate(time);
+		return;
+	}
 
-				if (seqHeader.freeRunning > 0)
-					mFirstRunningTime += timeOffset;
-			}
-		}
+	if (frames == nullptr)
+		return;
 
-		currentFrameTime = currentTime;
-		if (timeStep != 0.0)
-			currentFrame = (int) (currentTime / timeStep);
-
-		if (currentFrame > seqHeader.stopFrame) currentFrame = seqHeader.stopFrame;
-		if (currentFrame < seqHeader.startFrame) currentFrame = seqHeader.startFrame;
-	}
-	
+	currentFrame = ComputeSequenceFrame( seqHeader, time, mFirstRunningTime, currentFrameTime );
 
 	// DONE: calculate current frame index and time
 }
@@ -371,11 +359,24 @@ void CGPUImageSequencer::UpdateTexture( GLuint *texId, const bool needCompressOn
 	if (currentFrame == mLastUpdateFrame)
 		return;
 
-	BYTE *currFrameData = (BYTE*) frames;
-	ImageSequenceLink *link = (ImageSequenceLink*) (frames);
-	link += currentFrame;
+	BYTE *currFrameData = nullptr;
+
+	if (mStream != nullptr)
+	{
+		// waits only when the reader didn't prefetch the frame
+		currFrameData = (BYTE*) mStream->GetFrame(currentFrame);
+	}
+	else if (frames != nullptr)
+	{
+		ImageSequenceLink *link = (ImageSequenceLink*) (frames);
+		link += currentFrame;
 		
-	currFrameData = (BYTE*)frames + link->link;
+		currFrameData = (BYTE*)frames + link->link;
+	}
+
+	if (currFrameData == nullptr)
+		return;
+
 	ImageHeader2 *frameHeader = (ImageHeader2*) currFrameData;
 	currFrameData += sizeof(ImageHeader2);
 
@@ -403,7 +404,12 @@ void CGPUImageSequencer::UpdateTexture( GLuint *texId, const bool needCompressOn
 	const int uncompress_size = frameHeader->width * frameHeader->height * ((frameHeader->format == GL_RGBA) ? 4 : 3);
 	bool isCompressed = (uncompress_size != frameHeader->size);
 
-	if (isCompressed)
+	if (frameHeader->type == IMAGE_TYPE_FRAME_DELTA)
+	{
+		// NOTE: header is copied, the stream record could be replaced while decoding
+		UpdateDeltaFrame( *frameHeader, currFrameData, firstTime );
+	}
+	else if (isCompressed)
 	{ 
 		// load already compressed
 		//glCompressedTextureSubImage2D(theTextureObject, 0, 0, 0, frameHeader->width, frameHeader->height, frameHeader->format, frameHeader->size, currFrameData );
@@ -494,4 +500,50 @@ void CGPUImageSequencer::UpdateTexture( GLuint *texId, const bool needCompressOn
 	//
 
 	mLastUpdateFrame = currentFrame;
-}
\ No newline at end of file
+}
+
+void CGPUImageSequencer::UpdateDeltaFrame( const ImageHeader2 &frameHeader, const BYTE *frameData, const bool firstTime )
+{
+	const ImageFrameDeltaHeader *frameDelta = (const ImageFrameDeltaHeader*) frameData;
+
+	if (false == firstTime && mLastUpdateFrame >= 0 && mLastUpdateFrame == currentFrame-1)
+	{
+		// texture has the previous frame, upload only changed rectangles
+		const BlockDeltaRun *runs = (const BlockDeltaRun*) (frameData + sizeof(ImageFrameDeltaHeader));
+		const BYTE *blocks = (const BYTE*) (runs + frameDelta->numberOfRuns);
+
+		for (int i=0; i<frameDelta->numberOfRuns; ++i)
+		{
+			const int x = (runs[i].firstBlock % frameDelta->blocksPerRow) * 4;
+			const int y = (runs[i].firstBlock / frameDelta->blocksPerRow) * 4;
+			const int w = std::min(runs[i].count * 4, frameHeader.width - x);
+			const int h = std::min(4, frameHeader.height - y);
+			const int size = runs[i].count * frameDelta->blockSize;
+
+			glCompressedTexSubImage2D( GL_TEXTURE_2D, 0, x, y, w, h, frameHeader.internalFormat, size, blocks );
+			blocks += size;
+		}
+	}
+	else
+	{
+		// seek or first upload, restore the full image from the key frame
+		if (false == mDecoder.Decode( currentFrame, mStream, frames ) )
+		{
+			printf( "failed to decode a sequence frame %d\n", currentFrame );
+			return;
+		}
+
+		const GLsizei size = (GLsizei) mDecoder.GetImageSize();
+
+		if (firstTime)
+			glCompressedTexImage2D( GL_TEXTURE_2D, 0, frameHeader.internalFormat, frameHeader.width, frameHeader.height, 0, size, mDecoder.GetImage() );
+		else
+			glCompressedTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, frameHeader.width, frameHeader.height, frameHeader.internalFormat, size, mDecoder.GetImage() );
+	}
+
+	if (frameHeader.numberOfLODs == 0)
+	{
+		glHint( GL_GENERATE_MIPMAP_HINT, GL_FASTEST );
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+}
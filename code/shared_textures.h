@@ -27,6 +27,7 @@
 #include "shared_common.h"
 
 #include "gpucache_types.h"
+#include "shared_sequences.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +53,19 @@ public:
 	ImageSequenceHeader2 &GetHeader();
 	
 	void *&GetFrames();
+
+	// stream frames from the source instead of the frames block, source is owned by the sequencer
+	bool OpenStream( CImageSequenceSource *source, const size_t memoryBudget );
+	CImageSequenceStream *GetStream()
+	{
+		return mStream;
+	}
+
+	// frames are in memory or streamed
+	bool IsSequence() const
+	{
+		return (frames != nullptr || mStream != nullptr);
+	}
 	
 public:
 
@@ -78,6 +92,11 @@ private:
 
 	GLuint		mTextureId;
 
+	CImageSequenceStream	*mStream;
+	CImageSequenceDeltaDecoder	mDecoder;	// full image of the delta coded frames
+
+	// upload changed blocks when the previous frame is in the texture, otherwise the decoded image
+	void UpdateDeltaFrame( const ImageHeader2 &frameHeader, const BYTE *frameData, const bool firstTime );
 };
 
 ////////////////////////////////////////////////////////////////////////////////////
@@ -140,12 +159,24 @@ public:
 	bool	EvaluateFrameAnimation(const double time);
 	void	UpdateSequences();
 
+	// resident frames of each streamed image sequence
+	void SetSequenceMemoryBudget(const size_t bytes)
+	{
+		mSequenceMemoryBudget = bytes;
+	}
+	const size_t GetSequenceMemoryBudget() const
+	{
+		return mSequenceMemoryBudget;
+	}
+
 protected:
 
 	//
 	// OR - local pre-cached texture storage
 	std::vector<GLuint>				mResourceIds;	// source image data for textures
+	std::vector<uint64_t>	mResourceDigests;	// non zero - texture is owned by the textures registry
 	std::vector<CGPUImageSequencer>	mResourceFrames;
+	size_t							mSequenceMemoryBudget;
 
 	// each parameter per texture (sampler, source image, matrix, dimentions, names)
 
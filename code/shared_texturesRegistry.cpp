@@ -0,0 +1,124 @@
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: shared_texturesRegistry.cpp
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "shared_texturesRegistry.h"
+
+static void DeleteTexture(const GLuint texId)
+{
+	glDeleteTextures( 1, &texId );
+}
+
+// NOTE: a global object, function local statics are not thread safe with vs2013
+static CTexturesRegistry	gTexturesRegistry;
+
+CTexturesRegistry &CTexturesRegistry::GetInstance()
+{
+	return gTexturesRegistry;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+//
+
+CTexturesRegistry::CTexturesRegistry()
+{
+	mResidentBytes = 0;
+	mSharedBytes = 0;
+	mDeleteCallback = DeleteTexture;
+}
+
+CTexturesRegistry::~CTexturesRegistry()
+{
+	// gl context is already destroyed on the process exit, just forget the textures
+	mTextures.clear();
+}
+
+GLuint CTexturesRegistry::Acquire(const uint64_t digest)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto iter = mTextures.find(digest);
+	if (iter == end(mTextures) )
+		return 0;
+
+	iter->second.refCount += 1;
+	mSharedBytes += (int64_t) iter->second.bytes;
+
+	return iter->second.texId;
+}
+
+bool CTexturesRegistry::Register(const uint64_t digest, const GLuint texId, const size_t bytes)
+{
+	if (digest == 0 || texId == 0)
+		return false;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (mTextures.find(digest) != end(mTextures) )
+		return false;
+
+	TextureEntry entry = { texId, 1, bytes };
+	mTextures.insert( std::make_pair(digest, entry) );
+	mResidentBytes += bytes;
+
+	return true;
+}
+
+void CTexturesRegistry::Release(const uint64_t digest)
+{
+	GLuint texId = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto iter = mTextures.find(digest);
+		if (iter == end(mTextures) )
+			return;
+
+		iter->second.refCount -= 1;
+		if (iter->second.refCount > 0)
+			return;
+
+		texId = iter->second.texId;
+		mResidentBytes -= iter->second.bytes;
+		mTextures.erase(iter);
+	}
+
+	if (texId > 0 && mDeleteCallback)
+		(*mDeleteCallback)(texId);
+}
+
+const int CTexturesRegistry::GetNumberOfTextures() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return (int) mTextures.size();
+}
+
+const int CTexturesRegistry::GetReferenceCount(const uint64_t digest) const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto iter = mTextures.find(digest);
+	return (iter != end(mTextures)) ? iter->second.refCount : 0;
+}
+
+const size_t CTexturesRegistry::GetResidentBytes() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mResidentBytes;
+}
+
+const int64_t CTexturesRegistry::GetSharedBytes() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mSharedBytes;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// file: shared_texturesRegistry.h
+//
+//	Author Sergey Solokhin (Neill3d)
+//
+//
+//	GitHub page - https://github.com/Neill3d/MoPlugs_Framework
+//	Licensed under BSD 3-Clause - https://github.com/Neill3d/MoPlugs_Framework/blob/master/LICENSE
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <GL/glew.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <mutex>
+
+//////////////////////////////////////////////////////////////////////////////////
+// process wide store of the loaded still images, they are keyed by the content digest of the image record
+//	(textures pack version 3), so the same image of a different cache or export is uploaded only once
+//	each texture reference holds one count, gl texture is deleted with the last reference
+//	NOTE: all calls which could create or delete a texture have to be done in a gl thread
+
+class CTexturesRegistry
+{
+public:
+
+	typedef void (*DeleteTextureCallback)(const GLuint texId);
+
+	// a registry of the process
+	static CTexturesRegistry &GetInstance();
+
+	//! a constructor
+	CTexturesRegistry();
+	//! a destructor
+	~CTexturesRegistry();
+
+	// texture with the content, a reference is added, returns 0 if the content is not loaded yet
+	GLuint Acquire(const uint64_t digest);
+	// add a new loaded texture with one reference, bytes - size of the image data
+	//	returns false if the digest is already registered, texture is not taken in that case
+	bool Register(const uint64_t digest, const GLuint texId, const size_t bytes);
+	// remove a reference, texture is deleted when it was the last one
+	void Release(const uint64_t digest);
+
+	const int GetNumberOfTextures() const;
+	const int GetReferenceCount(const uint64_t digest) const;
+	// image data of the registered textures
+	const size_t GetResidentBytes() const;
+	// image data which was not uploaded, because it's already in the registry
+	const int64_t GetSharedBytes() const;
+
+	// textures are deleted with glDeleteTextures, replace to use the registry without a gl context
+	void SetDeleteCallback(DeleteTextureCallback callback)
+	{
+		mDeleteCallback = callback;
+	}
+
+protected:
+
+	struct TextureEntry
+	{
+		GLuint		texId;
+		int			refCount;
+		size_t		bytes;
+	};
+
+	mutable std::mutex								mMutex;
+	std::unordered_map<uint64_t, TextureEntry>	mTextures;
+
+	size_t					mResidentBytes;
+	int64_t					mSharedBytes;
+
+	DeleteTextureCallback	mDeleteCallback;
+};